@@ -208,7 +208,7 @@ event *gistka_mapper::map_api_receive_message(
 	 */
 	nslpdata *data = apimsg->get_data();
 
-	if ( data == NULL ) {
+	if ( data == NULL || data->get_size() == 0 ) {
 		LogInfo("received message contains no NSLP payload");
 
 		// The NTLP instance asks us if we want to setup routing state.
@@ -232,7 +232,7 @@ event *gistka_mapper::map_api_receive_message(
 	 * Parse the NSLP payload (the NTLP's body).
 	 */
 	MP(benchmark_journal::PRE_DESERIALIZE);
-	NetMsg payload(data->get_buffer(), data->get_size()); // copies the data
+	NetMsg payload(*data->get_netmsg(), 0, data->get_size()); // shares the data
 	NATFW_IEManager *mgr = NATFW_IEManager::instance();
 
 	IEErrorList errlist;
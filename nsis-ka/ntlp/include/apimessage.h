@@ -235,7 +235,8 @@ public:
 	void set_networknotification(uint32 nslpid, sessionid* sid, mri* mr, error_t notify, uint32 sii_handle=0);
 	void set_networknotification(nslpdata* data, uint32 nslpid, sessionid* sid, mri* mr, error_t notify, uint32 sii_handle=0);
         void set_setstatelifetime(mri* mr, uint32 state_lifetime);
-	void set_invalidateroutingstate(uint32 nslpid, mri* mr, status_t status, bool urgent);
+	/// sid restricts the invalidation to one session (used between the state module shards)
+	void set_invalidateroutingstate(uint32 nslpid, mri* mr, status_t status, bool urgent, sessionid* sid= NULL);
 	void set_register(uint32 nslpid, uint32 rao);
 	// @}
 	/// clear pointers
@@ -420,18 +421,25 @@ private:
     typedef hashmap_t<uint32, message::qaddr_t>  nslptable_t;
     typedef nslptable_t::iterator api_iter;
 
+    // registered NSLPs, looked up concurrently by the state module shards
     class NSLPtable {
 	
     public:
 	// return Message Queue address of fitting API caller or qaddr_unknown if there's none
-	inline message::qaddr_t get_address(uint32 nslpid) { 
+	inline message::qaddr_t get_address(uint32 nslpid) const { 
 	    
-	    api_iter cur = nslptable.find(nslpid);
+	    message::qaddr_t address = message::qaddr_unknown;
 
-	    if (cur != nslptable.end()){
+	    pthread_rwlock_rdlock(&lock);
+	    nslptable_t::const_iterator cur = nslptable.find(nslpid);
+	    if (cur != nslptable.end())
+		address = (*cur).second;
+	    pthread_rwlock_unlock(&lock);
+
+	    if (address != message::qaddr_unknown){
 		
 		DLog("NSLPtable", "Successfully looked up API caller address for NSLPID " << nslpid);
-		return ((*cur).second);    
+		return address;
 	    
 	    } 
 
@@ -444,16 +452,33 @@ private:
 	inline void save_address(uint32 nslpid, message::qaddr_t address)
 	{
 	    DLog("NSLPtable", "Saving address for NSLP ID " << nslpid << " at " << address);
+	    pthread_rwlock_wrlock(&lock);
 	    nslptable[nslpid] = address;
+	    pthread_rwlock_unlock(&lock);
         }
+
+	// copy of all registrations, to be iterated without holding the lock
+	inline nslptable_t get_registrations() const
+	{
+	    pthread_rwlock_rdlock(&lock);
+	    nslptable_t copy(nslptable);
+	    pthread_rwlock_unlock(&lock);
+
+	    return copy;
+	}
+
 	inline
-	NSLPtable() {}
+	NSLPtable() { pthread_rwlock_init(&lock, NULL); }
 	inline
-	~NSLPtable() {}
+	~NSLPtable() { pthread_rwlock_destroy(&lock); }
 	
-/* XXX:   private: */
+    private:
 	nslptable_t nslptable;
-	
+	mutable pthread_rwlock_t lock;
+
+	// not copyable
+	NSLPtable(const NSLPtable&);
+	NSLPtable& operator=(const NSLPtable&);
     };
 
 
@@ -79,6 +79,7 @@ namespace ntlp {
     gistconf_tls_client_cert,
     gistconf_tls_client_privkey,
     gistconf_tls_cacert,
+    gistconf_statemodule_shards,
     gistconf_maxparno
   };
 
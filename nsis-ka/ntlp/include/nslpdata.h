@@ -31,6 +31,7 @@
 
 #include "ntlp_object.h"
 #include "address.h"
+#include "network_message.h"
 #include "protlib_types.h"
 
 
@@ -60,8 +61,8 @@ public:
 
 
  private:
-	/// buffer for data
-	uchar *buf;
+	/// data, possibly sharing the buffer of the PDU it was received in
+	NetMsg *data;
 	/// buffer length
 	uint32 buf_length;
 
@@ -79,7 +80,7 @@ public:
 inline
 nslpdata () :
 	known_ntlp_object(Nslpdata, Mandatory),
-	buf(NULL),
+	data(NULL),
 	buf_length(0) {
 };
 
@@ -87,7 +88,13 @@ nslpdata () :
 // get a handle to the buffer
 inline
 uchar* get_buffer() const {
-    return buf;
+    return data ? data->get_buffer() : NULL;
+}
+
+// get the NetMsg holding the data, NULL if empty
+inline
+const NetMsg* get_netmsg() const {
+    return data;
 }
 
 //get size of buffer
@@ -101,42 +108,32 @@ uint32 get_size() const {
 inline
 nslpdata (const uchar *buffer, uint32 l):
 	known_ntlp_object(Nslpdata, Mandatory),
+	data(NULL),
 	buf_length(l) 
 {
-	buf = new(nothrow) uchar[l];
-	if (!buf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
-	if (buffer) {
-	    memcpy(buf,buffer,l);
-	} else {
-	   throw NetMsgError(NetMsgError::ERROR_NULL_POINTER); 
-	}
+	if (!buffer) throw NetMsgError(NetMsgError::ERROR_NULL_POINTER); 
+	if (l > 0) data = new NetMsg(const_cast<uchar*>(buffer), l, true);
+};
+
+
+/// constructor for l bytes of msg starting at offset start, shares the buffer of msg without copying
+inline
+nslpdata (const NetMsg& msg, uint32 start, uint32 l):
+	known_ntlp_object(Nslpdata, Mandatory),
+	data(l > 0 ? new NetMsg(msg, start, l) : NULL),
+	buf_length(l)
+{
 };
 
 
 
-/// copy constructor
+/// copy constructor, shares the buffer since the data is not modified anymore
 inline
 nslpdata(const nslpdata& n): 
-	known_ntlp_object(Nslpdata, Mandatory)
+	known_ntlp_object(Nslpdata, Mandatory),
+	data(n.data ? new NetMsg(*n.data, 0, n.buf_length) : NULL),
+	buf_length(n.buf_length)
 {
-	buf_length=n.buf_length;
-	
-	if (buf_length > 0)
-	{
-	    buf = new(nothrow) uchar[buf_length];
-	    if (!buf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
-	    if (buf) {
-		if (n.buf) {
-		    memcpy(buf,n.buf,buf_length);
-		} else {
-		    throw NetMsgError(NetMsgError::ERROR_NULL_POINTER); 
-		}
-	    } else {
-		throw NetMsgError(NetMsgError::ERROR_NULL_POINTER); 
-	    }
-	} else {
-	    buf = NULL;
-	}
 };
 
 
@@ -144,7 +141,7 @@ virtual
 inline
 ~nslpdata()
 {
-	if (buf) delete buf;
+	delete data;
 }
 
 }; // end class nslp_data
@@ -57,6 +57,7 @@ namespace ntlp
   const uint32 secrets_refreshtime_default = 300;  // [s] Secrets Roll-Over Time, 5 mins should be OK?
   const uint32 secrets_count_default = 2;     // count of local secrets hold at one time
   const uint32 secrets_length_default = 256;  // length of local secrets in bit  
+  const uint32 statemodule_shards_default = 1; // number of GIST processing threads owning a partition of the sessions
   const bool delayedstate_default= true;      // is Delayed State Installation to be used?
   const bool senddatainquery_default= true;   // send data in query?
   const bool confirmrequired_default= true;   // always perform a full handshake?
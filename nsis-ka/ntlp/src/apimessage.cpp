@@ -319,13 +319,14 @@ namespace ntlp {
 
     }
 
-    void APIMsg::set_invalidateroutingstate(uint32 nslpid, mri* mr, status_t status, bool urgent){
+    void APIMsg::set_invalidateroutingstate(uint32 nslpid, mri* mr, status_t status, bool urgent, sessionid* sid){
 
 	// set fitting subtype
 	subtype=InvalidateRoutingState;
 
 	// take over given objects/pointers
 	payload_nslpid=nslpid;
+	payload_sid=sid;
 	payload_mr=mr;
 	payload_status=status;
 	payload_urgent=urgent;
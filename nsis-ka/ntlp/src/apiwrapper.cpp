@@ -30,6 +30,7 @@
 #include "queuemanager.h"
 #include "logfile.h"
 #include "ntlp_proto.h"
+#include "ntlp_statemodule.h"
 #include <net/if.h>
 #include <cerrno>
 #include <iomanip>
@@ -294,7 +295,11 @@ APIWrapper::process_tp_msg(TPMsg* tpmsg)
 	//peer is copied into registry, delete the original one
 	delete peer;
 	apimsg->set_source(message::qaddr_api_0);
-	apimsg->send_to(param.clientqueue);
+	// the state module may be sharded, pass the message to the owning shard
+	if (param.clientqueue == message::qaddr_coordination)
+	  Statemodule::send_to_shard(apimsg);
+	else
+	  apimsg->send_to(param.clientqueue);
  
    
     }
@@ -339,7 +344,10 @@ APIWrapper::process_api_msg(APIMsg* apimsg)
 		answer->set_source(message::qaddr_api_0);
 		answer->set_recvmessageanswer(apimsg->get_nslpid(), apimsg->get_sessionid()->copy(), apimsg->get_mri()->copy(), NULL, APIMsg::directive_establish);
 		
-		answer->send_to(param.clientqueue);
+		if (param.clientqueue == message::qaddr_coordination)
+		  Statemodule::send_to_shard(answer);
+		else
+		  answer->send_to(param.clientqueue);
 
 	    }
 	}
@@ -970,7 +978,8 @@ APIMsg* APIWrapper::decode_netmsg(NetMsg* m) {
 
 	    //DLog("API decoding", "before reading NSLP data get_pos()= " << m->get_pos());
 	    // read NSLP data
-	    mydata = new nslpdata(m->get_buffer()+m->get_pos(), s.nd_size);
+	    // the NSLP data shares the buffer of the API message
+	    mydata = new nslpdata(*m, m->get_pos(), s.nd_size);
 	    // advance buffer pointer
 	    m->set_pos_r(s.nd_size);
 
@@ -1166,9 +1175,9 @@ APIMsg* APIWrapper::decode_netmsg(NetMsg* m) {
 	    //cout << "IP TTL:           " << (int) s.ip_ttl     << endl;
 	    //cout << "IP Distance:      " << (int) s.ip_distance<< endl;
 	    
-	    uchar* buf = new uchar[s.nd_size];
-	    m->decode(buf, s.nd_size);
-	    mydata = new nslpdata(buf, s.nd_size);
+	    // the NSLP data shares the buffer of the API message
+	    mydata = new nslpdata(*m, m->get_pos(), s.nd_size);
+	    m->set_pos_r(s.nd_size);
 
 	    
 	    //Fill Goettingen's MRI structure
@@ -73,7 +73,7 @@ gistconf::registerAllPars()
   registerPar( new configpar<uint32>(gist_realm, gistconf_secrets_refreshtime, "secrets-refreshtime", "Local secrets rollover time (s)", true, secrets_refreshtime_default, "s") );
   registerPar( new configpar<uint32>(gist_realm, gistconf_secrets_count,   "secrets-count", "Amount of local secrets", false, secrets_count_default) );
   registerPar( new configpar<uint16>(gist_realm, gistconf_secrets_length,  "secrets-length","Length of local secrets in bit", false, secrets_length_default, "bit" ) );
-  registerPar( new configpar<string>(gist_realm, gistconf_cookie_digest,  "cookie-digest","Hash algorithm to be used for cookie creation", false, "SHA1") );
+  registerPar( new configpar<string>(gist_realm, gistconf_cookie_digest,  "cookie-digest","MAC algorithm to be used for cookie creation (HMAC-<digest>, SipHash or a plain digest name)", false, "HMAC-SHA1") );
   registerPar( new configpar<bool>(  gist_realm, gistconf_delayedstate,       "delayed-state-installation", "Use delayed state installation (bool)", true, delayedstate_default) );
   registerPar( new configpar<bool>(  gist_realm, gistconf_confirmrequired, "confirm-required", "Require a full handshake at any time (bool)", true, confirmrequired_default) );
   registerPar( new configpar<bool>(  gist_realm, gistconf_senddatainquery, "send-data-in-query", "Send NSLP data also in query (bool)", true, senddatainquery_default) );
@@ -88,6 +88,7 @@ gistconf::registerAllPars()
   registerPar( new configpar<string>(gist_realm, gistconf_tls_client_cert, "tls-cert",  "filename pointing to the SSL/TLS client certificate (may contain absolute path)", false, "client_cert.pem") );
   registerPar( new configpar<string>(gist_realm, gistconf_tls_client_privkey, "tls-privkey",  "filename pointing to the SSL/TLS client private key file (may contain absolute path)", false, "client_privkey.pem") );
   registerPar( new configpar<string>(gist_realm, gistconf_tls_cacert, "tls-cacert",  "filename pointing to the SSL/TLS CA cert file (may contain absolute path)", false, "root_cert.pem") );
+  registerPar( new configpar<uint32>(gist_realm, gistconf_statemodule_shards, "statemodule-shards", "number of GIST processing threads, each owning a partition of the sessions (1: single thread)", false, statemodule_shards_default) );
 
   DLog("gistconf::registerAllPars", "finished registering gist parameters.");
 } 
@@ -367,10 +367,11 @@ NTLPStarter::main_loop(uint32 n)
 			 secrets, 
 			 nslptable, 
 			 raovec, 
-			 10 // default sleep time
+			 10, // default sleep time
+			 gconf.getpar<uint32>(gistconf_statemodule_shards)
 			);
 
-  ThreadStarter<Statemodule,StatemoduleParam> smthread(1,smpar);
+  ThreadStarter<Statemodule,StatemoduleParam> smthread(smpar.get_thread_count(),smpar);
   statemodule_p= smthread.get_thread_object();
 
   // APIWrapper needs an IPv4 and an IPv6 Address, we cannot take those
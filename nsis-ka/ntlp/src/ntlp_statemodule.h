@@ -38,6 +38,7 @@
 #include "threads.h"
 #include "signalingmodule_ntlp.h"
 #include "secretmanager.h"
+#include "respcookie_engine.h"
 #include "ntlp_errorobject.h"
 #include "routingtable.h"
 #include "nli.h"
@@ -84,7 +85,8 @@ struct StatemoduleParam : public ThreadParam {
 		   secretmanager& secrets,
 		   NSLPtable& nslptable,
 		   vector<uint32>& raovec,
-		   uint32 sleep = ThreadParam::default_sleep_time
+		   uint32 sleep = ThreadParam::default_sleep_time,
+		   uint32 shards = 1
 		   );
   const message::qaddr_t qaddr_ext;
   const message::qaddr_t qaddr_int;
@@ -109,6 +111,12 @@ struct StatemoduleParam : public ThreadParam {
   protocol_t udp;
   protocol_t tcp;
   protocol_t sctp;
+
+  /// number of session partitions, each processed by a thread of its own (1: not sharded)
+  const uint32 shards;
+
+  /// number of threads the state module needs
+  uint32 get_thread_count() const { return shards > 1 ? shards + 2 : 2; }
   
 }; // end StatemoduleParam
   
@@ -132,9 +140,19 @@ public:
   /// check a responder cookie, use local secrets and resp_cookie generation function
   bool evaluate_resp_cookie(const nli* querier_nli, const routingkey* r_key, const respcookie* resp);
 
+  /// MAC algorithm used for responder cookies
+  const respcookie_engine& get_cookie_engine() const { return cookie_engine; }
+
   ///calculation of refresh times. Give maximum time allowed and the factor to apply
   static uint32 randomized(uint32 value, float factor);
 
+  /// shard owning the state of session sid for NSLP nslpid
+  static uint32 get_shard(const sessionid* sid, uint32 nslpid, uint32 shards);
+  /// shard owning the state msg refers to (0 for messages without session)
+  static uint32 get_shard(const message* msg, uint32 shards);
+  /// send msg directly to the queue of its shard (to qaddr_coordination if not sharded)
+  static bool send_to_shard(message* msg, bool exp= false);
+
   const StatemoduleParam& getParam() const { return param; }
 
 private:
@@ -155,6 +173,10 @@ private:
   const StatemoduleParam& param;
   /// additional queue
   FastQueue* external_fq;
+  /// input queues of the shards (empty if not sharded)
+  vector<FastQueue*> shard_fq;
+  /// computes and checks responder cookie MACs
+  respcookie_engine cookie_engine;
   //@{ message processing
 
 protected:
@@ -168,6 +190,9 @@ private:
   /// get messages from queue
   void process_queue(uint32 nr);
 
+  /// pass messages from qaddr_coordination on to the owning shard
+  void dispatch_queue(FastQueue* fq);
+
   /// process messages from signaling module, incorporate Node State Machine
   void process_sig_msg(SignalingMsgNTLP* msg);
 
@@ -244,6 +269,9 @@ private:
   void process_handover_msg(HandoverMsg* homsg);
 #endif
 	
+  /// serialize the responder cookie MAC input into a new NetMsg
+  NetMsg* resp_cookie_input(const nli* querier_nli, const routingkey* key, uint32 gennumber, uint16 if_index, const uchar* transparent_data, uint16 transparent_data_len) const;
+
   /// check a responder cookie, use local secrets and resp_cookie generation function
   bool evaluate_query_cookie(routingkey* r_key, respcookie* resp);
 
@@ -259,6 +287,9 @@ private:
   /// send enqueued Data
   void sendqueue(routingkey* key, routingentry* entry);
 
+  /// apply InvalidateRoutingState to (MRI, NSLPID), each session by its own shard
+  void invalidate_routing_state(const mri* mr, uint32 nslpid, APIMsg::status_t status, bool urgency, const sessionid* sid);
+
   /// Notify NSLP via NetworkNotification
   void networknotification(const routingkey* r_key, routingentry* r_entry, APIMsg::error_t status, bool force);
 	
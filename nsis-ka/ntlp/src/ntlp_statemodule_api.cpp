@@ -62,8 +62,9 @@ using namespace protlib;
 void 
 Statemodule::process_api_msg(APIMsg* apimsg) 
 {
-  // Putting Message Source and NSLPID into nslptable
-  param.nslptable.save_address(apimsg->get_nslpid(), apimsg->get_source());
+  // Putting Message Source and NSLPID into nslptable (not for messages between the shards)
+  if (apimsg->get_source() != message::qaddr_coordination)
+    param.nslptable.save_address(apimsg->get_nslpid(), apimsg->get_source());
 
   EVLog(param.name, color[blue] << "API call received: " << color[off] 
 	<< apimsg->get_subtype_name() << " msg#" << apimsg->get_id() << " from NSLPID " << apimsg->get_nslpid() 
@@ -125,14 +126,23 @@ Statemodule::process_api_msg(APIMsg* apimsg)
       if (apimsg->get_status_change()==APIMsg::bad) 
       {
 	DLog(param.name, "We are requested to put state to BAD, this means we put it to state DEAD");
-	param.rt.invalidate_routing_state(apimsg->get_mri()->copy(), apimsg->get_nslpid(), apimsg->get_status_change(), apimsg->get_urgency());
       }
 	
       if (apimsg->get_status_change()==APIMsg::tentative) 
       {
 	DLog(param.name, "We are requested to put state to TENTATIVE, this means we put it to state REFRESH and carry out a Refresh, even if we are not requested via 'urgency' flag");
-	param.rt.invalidate_routing_state(apimsg->get_mri()->copy(), apimsg->get_nslpid(), apimsg->get_status_change(), apimsg->get_urgency());
-	
+      }
+
+      if ((apimsg->get_status_change()==APIMsg::bad) || (apimsg->get_status_change()==APIMsg::tentative))
+      {
+	if (apimsg->get_sessionid())
+	{
+	  // passed on by another shard, this shard owns the session
+	  routingkey key(apimsg->get_mri(), apimsg->get_sessionid(), apimsg->get_nslpid());
+	  param.rt.invalidate_routing_state(key, apimsg->get_status_change(), apimsg->get_urgency());
+	}
+	else
+	  invalidate_routing_state(apimsg->get_mri(), apimsg->get_nslpid(), apimsg->get_status_change(), apimsg->get_urgency(), NULL);
       }
 
       if ((apimsg->get_status_change()!=APIMsg::bad) && (apimsg->get_status_change()!=APIMsg::tentative)) {
@@ -86,7 +86,8 @@ StatemoduleParam::StatemoduleParam(routingtable& rt,
 				   secretmanager& secrets, 
 				   NSLPtable& nslptable, 
 				   vector<uint32>& raovec, 
-				   uint32 sleep)
+				   uint32 sleep,
+				   uint32 shards)
   : ThreadParam(sleep,"GIST Processing",2),       ///< common thread parameter
     qaddr_ext(message::qaddr_coordination),          ///< queue for messages to coordinator
     qaddr_int(message::qaddr_coordination_internal), ///< queue for self messages
@@ -98,7 +99,8 @@ StatemoduleParam::StatemoduleParam(routingtable& rt,
     nslptable(nslptable),
     raovec(raovec),
     timermsgsource(message::qaddr_coordination),
-    requesttimererrors(true) 
+    requesttimererrors(true),
+    shards(shards > 0 ? shards : 1)
 {
 
   qenc = prot_query_encap;
@@ -120,15 +122,34 @@ StatemoduleParam::StatemoduleParam(routingtable& rt,
 
 /***** class Statemodule *****/
 
+// state module whose shard queues are used by send_to_shard()
+static Statemodule* sharded_statemodule_p= 0;
+
 Statemodule::Statemodule(const StatemoduleParam& p)
   : Thread(p), 
     cap(gconf.getpar<uint16>(gistconf_udpport), gconf.getpar<uint16>(gistconf_tcpport), gconf.getpar<uint16>(gistconf_tlsport), gconf.getpar<uint16>(gistconf_sctpport)),
     param(p),
-    external_fq(new FastQueue(message::get_qaddr_name(p.qaddr_ext),true))
+    external_fq(new FastQueue(message::get_qaddr_name(p.qaddr_ext),true)),
+    cookie_engine(p.secrets, gconf.getparref<string>(gistconf_cookie_digest))
 {
   // register queues
   QueueManager::instance()->register_queue(get_fqueue(),p.qaddr_int);
   QueueManager::instance()->register_queue(external_fq,p.qaddr_ext);
+
+  // shard queues are not known to the QueueManager, messages reach them
+  // via send_to_shard() or via the dispatcher thread reading qaddr_ext
+  if (p.shards > 1)
+  {
+    for (uint32 i= 0; i < p.shards; i++)
+    {
+      ostringstream name;
+      name << message::get_qaddr_name(p.qaddr_ext) << " shard " << i;
+      shard_fq.push_back(new FastQueue(name.str().c_str(), true));
+    }
+    __atomic_store_n(&sharded_statemodule_p, this, __ATOMIC_RELEASE);
+    ILog(param.name, "Sessions are partitioned into " << p.shards << " shards");
+  }
+
   DLog(param.name, "Created " << p.name << " object");	
 } // end constructor
 
@@ -138,6 +159,13 @@ Statemodule::~Statemodule()
   DLog(param.name, "Destroying " << param.name << " object");
   QueueManager::instance()->unregister_queue(param.qaddr_int);
   QueueManager::instance()->unregister_queue(param.qaddr_ext);
+
+  if (__atomic_load_n(&sharded_statemodule_p, __ATOMIC_ACQUIRE) == this)
+    __atomic_store_n(&sharded_statemodule_p, (Statemodule*) 0, __ATOMIC_RELEASE);
+
+  for (uint32 i= 0; i < shard_fq.size(); i++)
+    delete shard_fq[i];
+  shard_fq.clear();
   
   if (external_fq)
   {
@@ -147,6 +175,158 @@ Statemodule::~Statemodule()
 } // end destructor
 
 
+/**
+ * Shard owning the state of a session. All messages and timers for the
+ * routing state (MRI, SID, NSLPID) are processed by this shard, so the
+ * MRI is not needed here.
+ */
+uint32
+Statemodule::get_shard(const sessionid* sid, uint32 nslpid, uint32 shards)
+{
+  if (shards <= 1 || sid == NULL)
+    return 0;
+
+  // spread the bits of the session hash before reducing it
+  uint32 h= (uint32) sid->get_hash() ^ (nslpid * 0x9e3779b9U);
+  h^= h >> 16;
+  h*= 0x85ebca6bU;
+  h^= h >> 13;
+
+  return h % shards;
+}
+
+
+/**
+ * Shard owning the state a message refers to. Messages that do not
+ * belong to a session (e.g. MA Hellos, NSLP registration, MA and secrets
+ * timers) are processed by shard 0.
+ */
+uint32
+Statemodule::get_shard(const message* msg, uint32 shards)
+{
+  if (shards <= 1 || msg == NULL)
+    return 0;
+
+  switch (msg->get_type())
+  {
+    case message::type_signaling:
+      {
+	const SignalingMsgNTLP* sigmsg= dynamic_cast<const SignalingMsgNTLP*>(msg);
+	if (sigmsg == NULL)
+	  break;
+	// error indications from signaling refer to the PDU that could not be sent
+	const known_ntlp_pdu* pdu= sigmsg->get_pdu() ? sigmsg->get_pdu() : sigmsg->get_encap_pdu();
+	if (pdu == NULL)
+	  break;
+	if (pdu->get_sessionid())
+	  return get_shard(pdu->get_sessionid(), pdu->get_nslpid(), shards);
+	// GIST errors carry the session of the PDU they refer to
+	if (pdu->is_error() && pdu->get_errorobject())
+	  return get_shard(pdu->get_errorobject()->get_embedded_sessionid(), pdu->get_errorobject()->get_referring_nslpid(), shards);
+      }
+      break;
+
+    case message::type_API:
+      {
+	const APIMsg* apimsg= dynamic_cast<const APIMsg*>(msg);
+	if (apimsg)
+	  return get_shard(apimsg->get_sessionid(), apimsg->get_nslpid(), shards);
+      }
+      break;
+
+    case message::type_timer:
+      {
+	const TimerMsg* timermsg= dynamic_cast<const TimerMsg*>(msg);
+	if (timermsg == NULL || timermsg->get_param1() == NULL)
+	  break;
+	switch (*static_cast<uint32*>(timermsg->get_param1()))
+	{
+	  // timers of a routing entry carry its key
+	  case expire_rnode:
+	  case noconfirm:
+	  case noresponse:
+	  case inactive_qnode:
+	  case refresh_qnode:
+	  case queue_poll:
+	    {
+	      const routingkey* rk= static_cast<const routingkey*>(timermsg->get_param2());
+	      if (rk)
+		return get_shard(rk->sid, rk->nslpid, shards);
+	    }
+	    break;
+	  default:
+	    break;
+	}
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  return 0;
+}
+
+
+/**
+ * Send a message to the state module. If the state module is sharded,
+ * the message is put directly into the queue of the owning shard, which
+ * saves the detour via the dispatcher thread.
+ */
+bool
+Statemodule::send_to_shard(message* msg, bool exp)
+{
+  Statemodule* sm= __atomic_load_n(&sharded_statemodule_p, __ATOMIC_ACQUIRE);
+
+  if (sm == NULL)
+    return msg->send_to(message::qaddr_coordination, exp);
+
+  return msg->send_to(sm->shard_fq[get_shard(msg, sm->shard_fq.size())], exp);
+}
+
+
+/**
+ * Invalidate the routing state of all sessions sharing an MRI. The entries
+ * of sessions owned by other shards may be in use by them, so these shards
+ * get an InvalidateRoutingState for the single session instead.
+ * @param sid -- session the calling shard is processing (NULL: none, shard 0)
+ */
+void
+Statemodule::invalidate_routing_state(const mri* mr, uint32 nslpid, APIMsg::status_t status, bool urgency, const sessionid* sid)
+{
+  if (shard_fq.empty())
+  {
+    param.rt.invalidate_routing_state(mr, nslpid, status, urgency);
+    return;
+  }
+
+  const uint32 own_shard= get_shard(sid, nslpid, shard_fq.size());
+
+  vector<routingkey> keys;
+  param.rt.find_keys(mr, nslpid, keys);
+
+  for (vector<routingkey>::iterator kit= keys.begin(); kit != keys.end(); kit++)
+  {
+    if (get_shard(kit->sid, nslpid, shard_fq.size()) == own_shard)
+    {
+      param.rt.invalidate_routing_state(*kit, status, urgency);
+      continue;
+    }
+
+    APIMsg* msg= new APIMsg;
+    msg->set_source(message::qaddr_coordination);
+    msg->set_invalidateroutingstate(nslpid, kit->mr->copy(), status, urgency, kit->sid->copy());
+    if (!send_to_shard(msg))
+    {
+      ERRLog(param.name, "Cannot pass InvalidateRoutingState on to the shard of session " << kit->sid->to_string());
+      delete msg;
+    }
+  }
+
+  routingtable::free_keys(keys);
+}
+
+
 
 void 
 Statemodule::main_loop(uint32 nr) 
@@ -321,8 +501,10 @@ Statemodule::process_queue(uint32 number)
   FastQueue* fq = NULL;
   if (number==1) 
     fq= QueueManager::instance()->get_queue(param.qaddr_ext); // message::qaddr_statemodule
-  else 
+  else if (number==2 || shard_fq.empty())
     fq= QueueManager::instance()->get_queue(param.qaddr_int); // message::qaddr_statemodule_internal
+  else if (number-3 < shard_fq.size())
+    fq= shard_fq[number-3];
 
   if (!fq) 
   {
@@ -331,6 +513,13 @@ Statemodule::process_queue(uint32 number)
     return;
   } // end if not fq
 
+  // in sharded mode thread #1 only distributes the messages
+  if (number==1 && !shard_fq.empty())
+  {
+    dispatch_queue(fq);
+    return;
+  }
+
   message* msg = NULL;
   // maximum wait period (in ms) at queue
   uint32 wait= param.sleep_time;
@@ -350,6 +539,34 @@ Statemodule::process_queue(uint32 number)
 } // end process_queue
 
 
+/**
+ * pass messages that were sent to qaddr_coordination (by the timer module,
+ * NSLPs, etc.) on to the queue of the shard owning their session
+ * @param fq -- the queue of qaddr_coordination
+ */
+void
+Statemodule::dispatch_queue(FastQueue* fq)
+{
+  const unsigned int batchsize= 64;
+  message* msgs[batchsize];
+
+  ILog(param.name, "Dispatching messages to " << shard_fq.size() << " shards");
+
+  while (get_state()==STATE_RUN) 
+  {
+    unsigned int n= fq->dequeue_batch_timedwait(msgs, batchsize, param.sleep_time);
+    for (unsigned int i= 0; i < n; i++)
+    {
+      if (!msgs[i]->send_to(shard_fq[get_shard(msgs[i], shard_fq.size())]))
+      {
+	ERRLog(param.name, "Cannot pass message from " << msgs[i]->get_qaddr_name() << " to its shard, dropping it");
+	delete msgs[i];
+      }
+    }
+  } // end while running
+} // end dispatch_queue
+
+
 
 
 
@@ -462,8 +679,9 @@ Statemodule::process_mobility_msg(MobilityMsg* mobmsg)
   case Flowstatus::fs_home:
   {
     // Send a NetworkNotification to all registered NSLPs
-    api_iter cur = param.nslptable.nslptable.begin();
-    while (cur != param.nslptable.nslptable.end()) {
+    nslptable_t nslps = param.nslptable.get_registrations();
+    api_iter cur = nslps.begin();
+    while (cur != nslps.end()) {
       mri* mymri = fs->orig_mri.copy();
       APIMsg* msg = new APIMsg;
 	
@@ -482,8 +700,9 @@ Statemodule::process_mobility_msg(MobilityMsg* mobmsg)
   case Flowstatus::fs_normal:
   {
     // Send a NetworkNotification to all registered NSLPs
-    api_iter cur = param.nslptable.nslptable.begin();
-    while (cur != param.nslptable.nslptable.end()) {
+    nslptable_t nslps = param.nslptable.get_registrations();
+    api_iter cur = nslps.begin();
+    while (cur != nslps.end()) {
       mri* mymri = fs->orig_mri.copy();
       APIMsg* msg = new APIMsg;
 	
@@ -517,8 +736,9 @@ Statemodule::process_handover_msg(HandoverMsg* homsg)
   const struct nwn_uds_msg uds_msg = homsg->get_uds_msg();
 
   // Send a NetworkNotification to all registered NSLPs
-  api_iter cur = param.nslptable.nslptable.begin();
-  while (cur != param.nslptable.nslptable.end()) {
+  nslptable_t nslps = param.nslptable.get_registrations();
+  api_iter cur = nslps.begin();
+  while (cur != nslps.end()) {
 		APIMsg* msg = new APIMsg;
 		msg->set_source(message::qaddr_coordination);
 
@@ -664,7 +884,7 @@ Statemodule::handle_error_pdu(const known_ntlp_pdu* errpdu)
 		networknotification(&tmpkey, tmpentry, APIMsg::last_node, false);
 
 		// invalidate routing state, not urgent
-		param.rt.invalidate_routing_state(tmpmri, tmp->get_referring_nslpid(), APIMsg::bad, false);
+		invalidate_routing_state(tmpmri, tmp->get_referring_nslpid(), APIMsg::bad, false, tmpsid);
 	}
 	
 	param.rt.unlock(&tmpkey);
@@ -1591,8 +1811,8 @@ void
 Statemodule::to_secrets_refresh() 
 {
   //DLog(param.name, color[magenta] << "Secret Generation Timer went off");
-  // Forward Secrets
-  param.secrets.forward();
+  // Forward Secrets, via the cookie engine that caches state derived from them
+  cookie_engine.forward();
   
   
   TimerMsg* msg = new TimerMsg(message::qaddr_coordination, true);
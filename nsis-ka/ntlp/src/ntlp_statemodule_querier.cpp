@@ -473,7 +473,7 @@ Statemodule::handle_response_in_awaiting_response(known_ntlp_pdu* incoming_pdu,
     { // confirm could not be sent, e.g. if stack proposal doesn't match, responder cookie not valid etc.
       ERRLog(param.name, "No Confirm sent. Invalidating routing state." );
       // probably tear down MRS and notify application, otherwise ...
-      param.rt.invalidate_routing_state(r_key->mr, incoming_pdu->get_nslpid(), APIMsg::bad, false);
+      invalidate_routing_state(r_key->mr, incoming_pdu->get_nslpid(), APIMsg::bad, false, r_key->sid);
       // Notify NSLP about Routing State Change
       networknotification(r_key, r_entry, APIMsg::route_changed_status_bad, false);
 
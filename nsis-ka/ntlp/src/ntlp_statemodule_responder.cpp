@@ -51,12 +51,6 @@
 #include <interface_manager.h>
 #endif
 
-extern "C"
-{
-// hashing functions from OpenSSL
-#include <openssl/evp.h>
-}
-
 namespace ntlp {
 
 /** @defgroup responder Responder Actions
@@ -534,7 +528,7 @@ Statemodule::handle_confirm_in_awaiting_confirm(const known_ntlp_pdu* cnfpdu, ro
 	  // the best thing now is to do invalidate the message routing state
 	  ERRLog(param.name, color[red] << "State not installed.");
 	  
-	  param.rt.invalidate_routing_state(cnfpdu->get_mri()->copy(), cnfpdu->get_nslpid(), APIMsg::bad, false);
+	  invalidate_routing_state(cnfpdu->get_mri(), cnfpdu->get_nslpid(), APIMsg::bad, false, cnfpdu->get_sessionid());
   }
 }
 
@@ -1343,224 +1337,169 @@ Statemodule::send_response(const known_ntlp_pdu* pdu, const routingkey* r_key, r
 
 
 /**
- * Generate a Responder cookie by using OpenSSL Hash function and hashing over objects in key
- * Our cookie is currently constructed as follows:
- * Secret generation number(32 bit) + 
- * query receiving interface index +
- * MAC Data Offset +
- * MAC Data= Hash(Q-Node Peer-ID, Q-Node i/f address, MRI, Session-ID, NSLPID, generation number, secret)
+ * Serialize the data protected by the responder cookie MAC:
+ * query receiving interface index, Q-Node Peer-ID, Q-Node i/f address,
+ * NSLPID, MRI, Session-ID, generation number and transparent data.
+ * The secret itself is added by the cookie engine.
  *
  * @param querier_nli -- the nli (peer-id, ip address) of the querier
- * @param key -- The key containing the objects to hash over 
- * @param gennumber -- the generation number to use, if 0 use the current generation number
+ * @param key -- The key containing the objects to hash over
+ * @param gennumber -- the generation number of the secret
  * @param if_index -- interface index
- * @param transparent_data -- e.g., nattraversal object if used, this must be included in the responder cookie if present
- * @return responder cookie or NULL if secret not available (wrong generation number)
+ * @param transparent_data -- transparent data carried in the cookie (may be NULL)
+ * @param transparent_data_len -- its length
+ * @return NetMsg holding exactly the MAC input
  */
-respcookie*
-Statemodule::create_resp_cookie(const nli* querier_nli, const routingkey* key, uint32 gennumber, uint16 if_index, const NetMsg* transparent_data)
+NetMsg*
+Statemodule::resp_cookie_input(const nli* querier_nli, const routingkey* key, uint32 gennumber, uint16 if_index, const uchar* transparent_data, uint16 transparent_data_len) const
 {
-
-  //============================================
-  // take our secrets
-  //============================================
-  
-  uchar* secret=NULL;
-  uint32 secretsize = param.secrets.get_secret_size();
-
-  uint32 generationnumber= gennumber;
-  // we generate a cookie with a previous generationnumber
-  if (generationnumber) { 
-    secret = param.secrets.get_secret(generationnumber);
-  } else {
-    // create a current one
-    secret = param.secrets.get_secret();
-    generationnumber = param.secrets.get_generation_number();
-  }  
-
-  if (secret == NULL)
-  {
-    // this should not happen
-    ERRLog(param.name,"secret for generation number 0x" << hex << gennumber << dec << " is not available");
-    return NULL;
-  }
-
-
-  //===================================================================
-  // Now put our input data into a byte buffer for calculating the hash
-  //===================================================================
-  
-         mri* mr= key->mr;
-  sessionid* sid= key->sid;
-   uint16 nslpid= key->nslpid;
-   uint8  pi_len= querier_nli->get_pi()->get_length();
-   uint16 transparent_data_len= (transparent_data && transparent_data->get_buffer()) ? transparent_data->get_size() : 0; 
-
-  // compute size needed for data in NetMsg (note: just used for computing the hash)
-
-  // generation number (4 byte) in clear text (not hashed)
-   uint32 buffersize = sizeof(generationnumber);
-
-  buffersize+= sizeof(if_index);
-
-  // NLI (querier peer identity)
-  if(querier_nli->get_pi())
-    buffersize+= pi_len;
-
-  // NLI (interface address)
-  buffersize+= querier_nli->get_if_address().is_ipv6() ? 32 : 4;
-  
-  // MRI without header
+  const mri* mr= key->mr;
+  const sessionid* sid= key->sid;
+  const peer_identity* pi= querier_nli->get_pi();
+  uint8 pi_len= pi ? pi->get_length() : 0;
+  bool ipv6= querier_nli->get_if_address().is_ipv6();
+
+  // compute the exact size of the input
+  uint32 buffersize= sizeof(if_index) + pi_len + (ipv6 ? sizeof(struct in6_addr) : sizeof(struct in_addr));
+  // NSLPID
+  buffersize+= sizeof(key->nslpid);
+  // MRI and SessionID without header
   buffersize+= mr->get_serialized_size(IE::protocol_v1)-4;
-  
-  // SessionID without header
   buffersize+= sid->get_serialized_size(IE::protocol_v1)-4;
+  // generation number and any transparent data
+  buffersize+= sizeof(gennumber) + transparent_data_len;
 
-  // NSLPID
-  buffersize+=sizeof(nslpid);
-  
-  // generation number (4 byte)
-  buffersize+=sizeof(generationnumber);
-  
-  // secret
-  buffersize+=secretsize;
-
-  // if any transparent data given
-  buffersize+= transparent_data_len;
-    
-  // build NetMsg of sufficient size -> used for calculating the hash
   NetMsg* msg = new NetMsg(buffersize);
   uint32 written= 0;
 
   // include interface index into hash
   msg->encode16(if_index);
-  written+= 2;
 
   // serialize peer ID
-  msg->copy_from(querier_nli->get_pi()->get_buffer(), msg->get_pos(), pi_len);
-  msg->set_pos_r(pi_len);
-  written+= pi_len;
+  if (pi_len)
+  {
+    msg->copy_from(pi->get_buffer(), msg->get_pos(), pi_len);
+    msg->set_pos_r(pi_len);
+  }
 
   // serialize IP address
-  struct in_addr ip4addr;
-  if ( querier_nli->get_if_address().is_ipv6() ) 
+  if (ipv6)
   {
-      const struct in6_addr *ip6addr=querier_nli->get_if_address().get_ip();
-      if (ip6addr)
-	msg->encode(*ip6addr);
-      else
-      {
-	ERRCLog("nli::serialize()", "No valid IPv6 address in if_address");
-	msg->encode(in6addr_any);
-      }
-  } 
-  else 
+    const struct in6_addr *ip6addr=querier_nli->get_if_address().get_ip();
+    if (ip6addr)
+      msg->encode(*ip6addr);
+    else
+    {
+      ERRCLog("nli::serialize()", "No valid IPv6 address in if_address");
+      msg->encode(in6addr_any);
+    }
+  }
+  else
   {
+    struct in_addr ip4addr;
     querier_nli->get_if_address().get_ip(ip4addr);
     msg->encode(ip4addr);
   }
 
   // NSLPID
-  msg->copy_from(reinterpret_cast<uchar*>(&nslpid), msg->get_pos(), sizeof(nslpid));
-  msg->set_pos_r(sizeof(nslpid));
+  msg->encode16(key->nslpid);
 
-  // serialize MRI into NetMsg buffer
+  // serialize MRI and SessionID into NetMsg buffer
   mr->serializeNoHead(*msg, IE::protocol_v1, written);
-
-  // serialize SessionID into NetMsg buffer
   sid->serializeNoHead(*msg, IE::protocol_v1, written);
 
   // generation number
-  msg->copy_from(reinterpret_cast<uchar*>(&generationnumber), msg->get_pos(), sizeof(generationnumber));
-  msg->set_pos_r(sizeof(generationnumber));
-  
-  // serialize secret into NetMsg buffer
-  msg->copy_from(secret, msg->get_pos(), secretsize);
-  msg->set_pos_r(secretsize);
+  msg->encode32(gennumber);
 
   // put transparent_data into hash if present
   if (transparent_data_len > 0)
   {
-	  memcpy(msg->get_buffer()+msg->get_pos(), transparent_data->get_buffer(), transparent_data_len);
+    msg->copy_from(transparent_data, msg->get_pos(), transparent_data_len);
+    msg->set_pos_r(transparent_data_len);
   }
 
-    
-  //============================================
-  // From here on we compute the Hash
-  //============================================
-  
-  // 1st: define datastructures necessary for OpenSSL hashing functions
-  EVP_MD_CTX mdctx;
-  const EVP_MD *md;
-  unsigned char md_value[EVP_MAX_MD_SIZE];
-  unsigned int md_len;
-    
-  // 2nd: We want SHA1 (maybe we make this a command line option)
-  md = EVP_get_digestbyname(gconf.getparref<string>(gistconf_cookie_digest).c_str());
-  
-  if(!md) {
-	  ERRCLog(param.name, "Hash algorithm " << gconf.getparref<string>(gistconf_cookie_digest) << " not available. Please update your OpenSSL library!");
-    abort();
-  }
-  
-  // 3rd: Initialize hasher
-  EVP_MD_CTX_init(&mdctx);
-  EVP_DigestInit_ex(&mdctx, md, NULL);
-  // 4th: give input to hasher
-  EVP_DigestUpdate(&mdctx, msg->get_buffer(), msg->get_size());
-    
-  // 5th: Finalize message digest
-  EVP_DigestFinal_ex(&mdctx, md_value, &md_len);
+  return msg;
+}
+
+
+/**
+ * Generate a Responder cookie by using the cookie engine and hashing over objects in key
+ * Our cookie is currently constructed as follows:
+ * Secret generation number(32 bit) + 
+ * query receiving interface index +
+ * MAC Data Offset +
+ * MAC Data= MAC(secret; Q-Node Peer-ID, Q-Node i/f address, MRI, Session-ID, NSLPID, generation number)
+ *
+ * @param querier_nli -- the nli (peer-id, ip address) of the querier
+ * @param key -- The key containing the objects to hash over 
+ * @param gennumber -- the generation number to use, if 0 use the current generation number
+ * @param if_index -- interface index
+ * @param transparent_data -- e.g., nattraversal object if used, this must be included in the responder cookie if present
+ * @return responder cookie or NULL if secret not available (wrong generation number)
+ */
+respcookie*
+Statemodule::create_resp_cookie(const nli* querier_nli, const routingkey* key, uint32 gennumber, uint16 if_index, const NetMsg* transparent_data)
+{
+  // we generate a cookie with a previous generationnumber or a current one
+  uint32 generationnumber= gennumber ? gennumber : param.secrets.get_generation_number();
+
+  const uchar* td= (transparent_data && transparent_data->get_buffer()) ? transparent_data->get_buffer() : NULL;
+  uint16 transparent_data_len= td ? transparent_data->get_size() : 0;
 
-  // 6th: Cleanup datastructures
-  EVP_MD_CTX_cleanup(&mdctx);
+  NetMsg* msg= resp_cookie_input(querier_nli, key, generationnumber, if_index, td, transparent_data_len);
 
   //==============================================
-  // From here on we put the cookie value together
+  // Put the cookie value together
   //==============================================
 
-  // 7.1: Put together result buffer
+  uint32 md_len= cookie_engine.get_mac_size();
   uint16 totallen= sizeof(generationnumber) + 2*sizeof(uint16) + transparent_data_len + md_len;
   uchar* buf = new uchar[totallen];
   uchar* pbuf= buf;
 
-  // 7.2: Put in Generation Number first
+  // Generation Number first
   *((uint32*)pbuf) = htonl(generationnumber);
   pbuf+= sizeof(generationnumber);
 
-  // 7.3: interface index next (16 bit)
+  // interface index next (16 bit)
   *((uint16*)pbuf) = htons(if_index);
   pbuf+= sizeof(uint16);
 
-  // 7.4: byte offset pointing to HMAC data behind optional NTO
+  // byte offset pointing to HMAC data behind optional NTO
   *((uint16*)pbuf) = htons( transparent_data_len );
   pbuf+= sizeof(uint16);
 
   // put transparent data into buffer if present, currently it could be the NAT traversal object
-  if (transparent_data && transparent_data->get_buffer() && transparent_data_len > 0)
+  if (transparent_data_len > 0)
   {
-	  memcpy(pbuf, transparent_data->get_buffer(), transparent_data_len);
+	  memcpy(pbuf, td, transparent_data_len);
 	  pbuf+= transparent_data_len;
   }
 
-  // 7.4th: Copy Resulting Hash/MD into buffer
-  memcpy(pbuf, md_value, md_len);
-  
-  // 8th: Put into Responder Cookie
+  // MAC at the end
+  if (!cookie_engine.mac(generationnumber, msg->get_buffer(), msg->get_size(), pbuf))
+  {
+    // this should not happen
+    ERRLog(param.name,"secret for generation number 0x" << hex << generationnumber << dec << " is not available");
+    delete[] buf;
+    delete msg;
+    return NULL;
+  }
+  delete msg;
+
+  // Put into Responder Cookie
   respcookie* cookie = new respcookie(buf, totallen);
 
   DLog(param.name, "Computed Responder Cookie, length "<< totallen*8 << " Bit: " << cookie->to_str());
 
   // delete temporary buffer now
-  delete buf;
-  // delete netmsg buffer
-  delete msg;
+  delete[] buf;
 
   return cookie;
 }
 
 /**
- * Evaluate a Responder Cookie, regenerate it by using the included Generation number and the Key objects in pdu
+ * Evaluate a Responder Cookie, recompute its MAC by using the included Generation number and the Key objects in pdu
  * @param querier_nli -- the NLI of the querier which must match
  * @param r_key -- the routing key specifying the routing entry (may NOT be NULL)
  * @param responder_cookie -- the responder cookie to check
@@ -1570,46 +1509,42 @@ bool
 Statemodule::evaluate_resp_cookie(const nli* querier_nli, const routingkey* r_key, const respcookie* responder_cookie)
 {
   // if any argument is missing (probably in incoming pdu, we cannot recalc the responder cookie, so it is invalid)
-  if (querier_nli==NULL || r_key==NULL || responder_cookie==NULL)
+  if (querier_nli==NULL || r_key==NULL || responder_cookie==NULL || responder_cookie->get_buffer()==NULL)
     return false;
 
   // First decode generation number
-  
   uint32 generationnumber= responder_cookie->get_generationnumber();
 
   // decode interface id (16bit)
   uint16 if_index= responder_cookie->get_if_index();
 
   uint16 td_len= responder_cookie->get_transparent_data_len();
-  // check for any transparent objects carried in the responder cookie
-  // and make sure that we don't read behind the end of the buffer
-  NetMsg* transparent_data_msgbuf= ( (td_len > 0) && ( (uint32)(td_len+4+2+2) < responder_cookie->get_size()) ) ? 
-	  new NetMsg(responder_cookie->get_transparent_data(), td_len, false) : NULL;
-
-  // Now generate fitting cookie with decoded generation number of secret
-  const respcookie* ourcookie= create_resp_cookie(querier_nli, r_key, generationnumber, if_index, transparent_data_msgbuf);
-  delete transparent_data_msgbuf;
-  
-  if (ourcookie==NULL)
-  { // this will happen if the generation number is wrong
+
+  // header, transparent data and MAC must fill the cookie exactly,
+  // this also makes sure that we don't read behind the end of the buffer
+  uint32 md_len= cookie_engine.get_mac_size();
+  if (responder_cookie->get_size() != sizeof(generationnumber) + 2*sizeof(uint16) + td_len + md_len)
+  {
+    DLog(param.name, color[red] << "Responder Cookie has wrong length" << color[off]);
     return false;
   }
 
-  DLog(param.name, "Recomputed Responder Cookie, length "<< ourcookie->get_size()*8 << " Bit: " << ourcookie->to_str()); 
-
   DLog(param.name, "Given Responder Cookie, length "<< responder_cookie->get_size()*8 << " Bit: " << responder_cookie->to_str());
 
-  // perform actual comparison
-  if (*responder_cookie != *ourcookie) {
-      DLog(param.name, color[red] << "Responder Cookie did not match!" << color[off]);
+  NetMsg* msg= resp_cookie_input(querier_nli, r_key, generationnumber, if_index, responder_cookie->get_transparent_data(), td_len);
+  const uchar* md_value= responder_cookie->get_buffer() + sizeof(generationnumber) + 2*sizeof(uint16) + td_len;
 
-      delete ourcookie;
+  // perform actual comparison, fails as well if the generation number is wrong
+  bool match= cookie_engine.verify(generationnumber, msg->get_buffer(), msg->get_size(), md_value, md_len);
+  delete msg;
+
+  if (!match) {
+      DLog(param.name, color[red] << "Responder Cookie did not match!" << color[off]);
       return false;
   } else {
     DLog(param.name, color[green] << "Responder Cookie matched" << color[off]);
   }
 
-  delete ourcookie;
   return true;
 }
 
@@ -99,12 +99,14 @@ nslpdata::deserializeEXT(NetMsg& msg, coding_t cod, IEErrorList& errorlist, uint
     if (!decode_header_ntlpv1(msg,len,ielen,saved_pos,resume,errorlist,bread,skip)) 
 	return NULL;
 
-    // initialize our buffer (len is only object length)
+    // share the buffer of msg instead of copying the data (len is only object length)
+    delete data;
+    data= NULL;
     buf_length=len;
-    buf = new(nothrow) uchar[buf_length];
-
-    // copy data into our buffer, padding is of no concern
-    msg.decode(buf, len);
+    if (len > 0) {
+	data = new NetMsg(msg, msg.get_pos(), len);
+	msg.set_pos_r(len);
+    }
 
     // There is no padding.
     bread = ielen;
@@ -154,7 +156,8 @@ void nslpdata::serializeEXT(NetMsg& msg, coding_t cod, uint32& wbytes, bool head
 
 	uint32 position = msg.get_pos();
 	// copy data into our buffer, padding is of no concern
-	msg.copy_from(buf, position, buf_length);
+	if (data)
+		msg.copy_from(data->get_buffer(), position, buf_length);
 	
 	msg.set_pos_r(round_up4(buf_length));
 
@@ -208,12 +211,14 @@ istream& nslpdata::input(istream& is, bool istty, uint32 level, const uint32 ind
 		cout<<"<"<<get_ie_name()<<"> Enter some fake data: ";
 	} // end if istty
 	
-	uchar *buffer = new uchar[128];
-	
+	uchar buffer[128];
+	memset(buffer, 0, sizeof(buffer));
+
 	is>>buffer;
 
-	buf=buffer;
-	buf_length=128;
+	delete data;
+	data= new NetMsg(buffer, sizeof(buffer), true);
+	buf_length=sizeof(buffer);
 
 
 	return is;
@@ -0,0 +1,459 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file respcookie_engine.cpp
+/// Computation and verification of responder cookie MACs
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2010, all rights reserved by
+// - Institute of Telematics, Karlsruhe Institute of Technology
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include <openssl/crypto.h>
+
+#include "respcookie_engine.h"
+#include "logfile.h"
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_new EVP_MD_CTX_create
+#define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#endif
+
+using namespace protlib;
+using namespace protlib::log;
+using namespace ntlp;
+
+
+namespace {
+
+const char* const logname= "GIST cookies";
+
+/// free the scratch context of a terminating thread
+void free_thread_ctx(void* ctx)
+{
+  EVP_MD_CTX_free(static_cast<EVP_MD_CTX*>(ctx));
+}
+
+inline uint64 rotl64(uint64 x, unsigned int b)
+{
+  return (x << b) | (x >> (64 - b));
+}
+
+inline uint64 load64_le(const uchar* p)
+{
+  uint64 v= 0;
+  for (int i= 7; i >= 0; i--)
+    v= (v << 8) | p[i];
+  return v;
+}
+
+inline void store64_le(uchar* p, uint64 v)
+{
+  for (int i= 0; i < 8; i++, v>>= 8)
+    p[i]= v & 0xff;
+}
+
+inline void sipround(uint64& v0, uint64& v1, uint64& v2, uint64& v3)
+{
+  v0+= v1; v1= rotl64(v1, 13); v1^= v0; v0= rotl64(v0, 32);
+  v2+= v3; v3= rotl64(v3, 16); v3^= v2;
+  v0+= v3; v3= rotl64(v3, 21); v3^= v0;
+  v2+= v1; v1= rotl64(v1, 17); v1^= v2; v2= rotl64(v2, 32);
+}
+
+} // end anonymous namespace
+
+
+respcookie_engine::respcookie_engine(secretmanager& secrets, const std::string& algorithm)
+  : secrets(secrets),
+    algo(algo_digest),
+    md(NULL),
+    mac_size(0),
+    slots(secrets.get_table_size())
+{
+  const char* name= algorithm.c_str();
+
+  if (strcasecmp(name, "SipHash") == 0 || strcasecmp(name, "SipHash-2-4") == 0)
+  {
+    algo= algo_siphash;
+    mac_size= 16;
+  }
+  else
+  {
+    if (strncasecmp(name, "HMAC-", 5) == 0)
+    {
+      algo= algo_hmac;
+      name+= 5;
+    }
+
+    md= EVP_get_digestbyname(name);
+    if (!md)
+    {
+      ERRCLog(logname, "Hash algorithm " << algorithm << " not available. Please update your OpenSSL library!");
+      abort();
+    }
+    mac_size= EVP_MD_size(md);
+  }
+
+  for (std::vector<gen_state_t>::iterator it= slots.begin(); it != slots.end(); ++it)
+  {
+    it->gen= 0;
+    it->valid= false;
+    it->inner= (algo == algo_hmac) ? EVP_MD_CTX_new() : NULL;
+    it->outer= (algo == algo_hmac) ? EVP_MD_CTX_new() : NULL;
+  }
+
+  pthread_rwlock_init(&lock, NULL);
+  if (pthread_key_create(&ctx_key, free_thread_ctx) != 0)
+  {
+    ERRCLog(logname, "could not create thread specific key for hash contexts");
+    abort();
+  }
+
+  DLog(logname, "Responder cookies use " << algorithm << ", MAC length " << mac_size*8 << " Bit");
+}
+
+
+respcookie_engine::~respcookie_engine()
+{
+  // contexts of other threads are freed when these terminate
+  EVP_MD_CTX* ctx= static_cast<EVP_MD_CTX*>(pthread_getspecific(ctx_key));
+  if (ctx)
+  {
+    pthread_setspecific(ctx_key, NULL);
+    EVP_MD_CTX_free(ctx);
+  }
+  pthread_key_delete(ctx_key);
+
+  for (std::vector<gen_state_t>::iterator it= slots.begin(); it != slots.end(); ++it)
+  {
+    if (it->inner)
+      EVP_MD_CTX_free(it->inner);
+    if (it->outer)
+      EVP_MD_CTX_free(it->outer);
+    // don't leave copies of the secrets behind
+    if (!it->key.empty())
+      OPENSSL_cleanse(&it->key[0], it->key.size());
+  }
+
+  pthread_rwlock_destroy(&lock);
+}
+
+
+EVP_MD_CTX*
+respcookie_engine::get_ctx()
+{
+  EVP_MD_CTX* ctx= static_cast<EVP_MD_CTX*>(pthread_getspecific(ctx_key));
+  if (ctx == NULL)
+  {
+    ctx= EVP_MD_CTX_new();
+    pthread_setspecific(ctx_key, ctx);
+  }
+  return ctx;
+}
+
+
+const respcookie_engine::gen_state_t*
+respcookie_engine::lookup(uint32 gen) const
+{
+  const gen_state_t& st= slots[gen % slots.size()];
+  return (st.valid && st.gen == gen) ? &st : NULL;
+}
+
+
+bool
+respcookie_engine::load(uint32 gen)
+{
+  pthread_rwlock_wrlock(&lock);
+
+  // another thread may have been faster
+  bool ok= lookup(gen) || prepare(gen);
+
+  pthread_rwlock_unlock(&lock);
+
+  return ok;
+}
+
+
+void
+respcookie_engine::forward()
+{
+  pthread_rwlock_wrlock(&lock);
+
+  secrets.forward();
+  // the slot of the new generation still holds the state of the secret it replaced
+  uint32 gen= secrets.get_generation_number();
+  slots[gen % slots.size()].valid= false;
+  prepare(gen);
+
+  pthread_rwlock_unlock(&lock);
+}
+
+
+bool
+respcookie_engine::prepare(uint32 gen)
+{
+  // a copy, the secrets may also be rolled over without the engine
+  uint32 secretsize= secrets.get_secret_size();
+  std::vector<uchar> secretbuf(secretsize);
+  if (!secrets.copy_secret(gen, &secretbuf[0]))
+    return false;
+  const uchar* secret= &secretbuf[0];
+
+  gen_state_t& st= slots[gen % slots.size()];
+  if (!st.key.empty())
+    OPENSSL_cleanse(&st.key[0], st.key.size());
+
+  switch (algo)
+  {
+    case algo_digest:
+      st.key.assign(secret, secret + secretsize);
+      break;
+
+    case algo_hmac:
+      {
+	// RFC 2104: keys longer than a block are hashed first
+	uint32 blocksize= EVP_MD_block_size(md);
+	std::vector<uchar> pad(blocksize, 0);
+	if (secretsize > blocksize)
+	  EVP_Digest(secret, secretsize, &pad[0], NULL, md, NULL);
+	else
+	  memcpy(&pad[0], secret, secretsize);
+
+	for (uint32 i= 0; i < blocksize; i++)
+	  pad[i]^= 0x36;
+	EVP_DigestInit_ex(st.inner, md, NULL);
+	EVP_DigestUpdate(st.inner, &pad[0], blocksize);
+
+	for (uint32 i= 0; i < blocksize; i++)
+	  pad[i]^= 0x36 ^ 0x5c;
+	EVP_DigestInit_ex(st.outer, md, NULL);
+	EVP_DigestUpdate(st.outer, &pad[0], blocksize);
+
+	OPENSSL_cleanse(&pad[0], blocksize);
+	st.key.clear();
+      }
+      break;
+
+    case algo_siphash:
+      {
+	uchar digest[EVP_MAX_MD_SIZE];
+	EVP_Digest(secret, secretsize, digest, NULL, EVP_sha256(), NULL);
+	st.key.assign(digest, digest + 16);
+	OPENSSL_cleanse(digest, sizeof(digest));
+      }
+      break;
+  }
+
+  OPENSSL_cleanse(&secretbuf[0], secretsize);
+
+  st.gen= gen;
+  st.valid= true;
+
+  DLog(logname, "Prepared MAC state for generation number 0x" << std::hex << gen << std::dec);
+
+  return true;
+}
+
+
+void
+respcookie_engine::compute(const gen_state_t& st, const uchar* data, uint32 len, uchar* out)
+{
+  if (algo == algo_siphash)
+  {
+    siphash24(&st.key[0], data, len, out, mac_size);
+    return;
+  }
+
+  EVP_MD_CTX* ctx= get_ctx();
+
+  if (algo == algo_digest)
+  {
+    EVP_DigestInit_ex(ctx, md, NULL);
+    EVP_DigestUpdate(ctx, data, len);
+    EVP_DigestUpdate(ctx, &st.key[0], st.key.size());
+    EVP_DigestFinal_ex(ctx, out, NULL);
+    return;
+  }
+
+  // HMAC: H(key^opad, H(key^ipad, data)) starting from the precomputed contexts
+  uchar inner_md[EVP_MAX_MD_SIZE];
+  unsigned int inner_len= 0;
+
+  EVP_MD_CTX_copy_ex(ctx, st.inner);
+  EVP_DigestUpdate(ctx, data, len);
+  EVP_DigestFinal_ex(ctx, inner_md, &inner_len);
+
+  EVP_MD_CTX_copy_ex(ctx, st.outer);
+  EVP_DigestUpdate(ctx, inner_md, inner_len);
+  EVP_DigestFinal_ex(ctx, out, NULL);
+}
+
+
+bool
+respcookie_engine::mac(uint32 gen, const uchar* data, uint32 len, uchar* out)
+{
+  // at most one rebuild is needed, the slot of a valid generation is
+  // only taken over by a later generation after it became invalid
+  for (int tries= 0; tries < 2; tries++)
+  {
+    pthread_rwlock_rdlock(&lock);
+    // the secretmanager decides whether the generation is (still) valid,
+    // asked under the lock that forward() holds while rolling over
+    if (!secrets.is_valid(gen))
+    {
+      pthread_rwlock_unlock(&lock);
+      return false;
+    }
+    const gen_state_t* st= lookup(gen);
+    if (st)
+    {
+      compute(*st, data, len, out);
+      pthread_rwlock_unlock(&lock);
+      return true;
+    }
+    pthread_rwlock_unlock(&lock);
+
+    if (!load(gen))
+      return false;
+  }
+
+  return false;
+}
+
+
+bool
+respcookie_engine::verify(uint32 gen, const uchar* data, uint32 len, const uchar* mac_value, uint32 maclen)
+{
+  if (maclen != mac_size)
+    return false;
+
+  uchar md_value[EVP_MAX_MD_SIZE];
+  if (!mac(gen, data, len, md_value))
+    return false;
+
+  return CRYPTO_memcmp(md_value, mac_value, mac_size) == 0;
+}
+
+
+uint32
+respcookie_engine::verify_batch(const verify_req_t* reqs, uint32 n, bool* result)
+{
+  uchar md_value[EVP_MAX_MD_SIZE];
+  std::vector<uint32> missing;
+  uint32 valid= 0;
+
+  // one lock round trip for all MACs of generations already prepared
+  pthread_rwlock_rdlock(&lock);
+  for (uint32 i= 0; i < n; i++)
+  {
+    const verify_req_t& req= reqs[i];
+
+    result[i]= false;
+    if (req.maclen != mac_size || !secrets.is_valid(req.gen))
+      continue;
+
+    const gen_state_t* st= lookup(req.gen);
+    if (st == NULL)
+    {
+      missing.push_back(i);
+      continue;
+    }
+
+    compute(*st, req.data, req.len, md_value);
+    if (CRYPTO_memcmp(md_value, req.mac, mac_size) == 0)
+    {
+      result[i]= true;
+      valid++;
+    }
+  }
+  pthread_rwlock_unlock(&lock);
+
+  for (std::vector<uint32>::const_iterator it= missing.begin(); it != missing.end(); ++it)
+  {
+    const verify_req_t& req= reqs[*it];
+    if (verify(req.gen, req.data, req.len, req.mac, req.maclen))
+    {
+      result[*it]= true;
+      valid++;
+    }
+  }
+
+  return valid;
+}
+
+
+/**
+ * SipHash-2-4 (Aumasson, Bernstein) of data
+ * @param key -- 128 bit key
+ * @param out -- receives outlen byte
+ * @param outlen -- 8 for the original 64 bit output or 16 for 128 bit output
+ */
+void
+respcookie_engine::siphash24(const uchar* key, const uchar* data, size_t len, uchar* out, uint32 outlen)
+{
+  uint64 k0= load64_le(key);
+  uint64 k1= load64_le(key + 8);
+
+  uint64 v0= 0x736f6d6570736575ULL ^ k0;
+  uint64 v1= 0x646f72616e646f6dULL ^ k1;
+  uint64 v2= 0x6c7967656e657261ULL ^ k0;
+  uint64 v3= 0x7465646279746573ULL ^ k1;
+
+  if (outlen == 16)
+    v1^= 0xee;
+
+  const uchar* end= data + (len & ~(size_t)7);
+  for (; data != end; data+= 8)
+  {
+    uint64 m= load64_le(data);
+    v3^= m;
+    sipround(v0, v1, v2, v3);
+    sipround(v0, v1, v2, v3);
+    v0^= m;
+  }
+
+  // last block: remaining bytes and the length in the top byte
+  uint64 b= ((uint64) len) << 56;
+  for (int i= (len & 7) - 1; i >= 0; i--)
+    b|= ((uint64) data[i]) << (8*i);
+
+  v3^= b;
+  sipround(v0, v1, v2, v3);
+  sipround(v0, v1, v2, v3);
+  v0^= b;
+
+  v2^= (outlen == 16) ? 0xee : 0xff;
+  for (int i= 0; i < 4; i++)
+    sipround(v0, v1, v2, v3);
+  store64_le(out, v0 ^ v1 ^ v2 ^ v3);
+
+  if (outlen != 16)
+    return;
+
+  v1^= 0xdd;
+  for (int i= 0; i < 4; i++)
+    sipround(v0, v1, v2, v3);
+  store64_le(out + 8, v0 ^ v1 ^ v2 ^ v3);
+}
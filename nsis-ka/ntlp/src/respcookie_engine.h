@@ -0,0 +1,164 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file respcookie_engine.h
+/// Computation and verification of responder cookie MACs
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2010, all rights reserved by
+// - Institute of Telematics, Karlsruhe Institute of Technology
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+/*
+  Computes the MAC of responder cookies with the local secrets.
+
+  The algorithm is selected by the cookie-digest parameter:
+  - "HMAC-<digest>" (e.g. HMAC-SHA1, HMAC-SHA256): HMAC keyed with the secret
+  - "SipHash": SipHash-2-4 with 128 bit output, keyed with SHA-256(secret)
+  - any other OpenSSL digest name (e.g. SHA1): Hash(data, secret)
+
+  Everything that only depends on the secret of a generation (the HMAC
+  contexts after hashing the padded key, the SipHash key) is computed once
+  per generation and cached, so a cookie just clones these contexts. The
+  secretmanager is still asked for every cookie whether the generation is
+  valid, thus expired secrets are rejected as before.
+
+  Secrets are rolled over with forward() of the engine, which holds the
+  write lock of the engine while it changes the secrets and prepares the
+  state of the new generation. A MAC thus never sees a generation that is
+  valid for the secretmanager but cached from an earlier secret.
+*/
+#ifndef _NTLP__RESPCOOKIE_ENGINE_H_
+#define _NTLP__RESPCOOKIE_ENGINE_H_
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include "protlib_types.h"
+#include "secretmanager.h"
+
+
+namespace ntlp {
+    using namespace protlib;
+
+    class respcookie_engine {
+
+    public:
+
+	/// MAC construction
+	enum algo_t {
+	    algo_digest,
+	    algo_hmac,
+	    algo_siphash
+	};
+
+	/// a MAC to be checked by verify_batch()
+	struct verify_req_t {
+	    /// generation number of the secret
+	    uint32 gen;
+	    /// MAC input
+	    const uchar* data;
+	    uint32 len;
+	    /// MAC to check
+	    const uchar* mac;
+	    uint32 maclen;
+	};
+
+	/// constructor, aborts if the algorithm is not available
+	respcookie_engine(secretmanager& secrets, const std::string& algorithm);
+
+	~respcookie_engine();
+
+	/// MAC construction in use
+	algo_t get_algorithm() const { return algo; }
+
+	/// roll the secrets over and prepare the state of the new generation
+	void forward();
+
+	/// length of a MAC in byte
+	uint32 get_mac_size() const { return mac_size; }
+
+	/// compute the MAC of data with the secret of generation gen into out (get_mac_size() byte)
+	/// @return false if there is no valid secret for generation gen
+	bool mac(uint32 gen, const uchar* data, uint32 len, uchar* out);
+
+	/// check mac against the MAC of data with the secret of generation gen
+	bool verify(uint32 gen, const uchar* data, uint32 len, const uchar* mac, uint32 maclen);
+
+	/// check n MACs at once, result[i] tells whether reqs[i] is valid
+	/// @return number of valid MACs
+	uint32 verify_batch(const verify_req_t* reqs, uint32 n, bool* result);
+
+	/// SipHash-2-4 of data with a 128 bit key, outlen must be 8 or 16
+	static void siphash24(const uchar* key, const uchar* data, size_t len, uchar* out, uint32 outlen);
+
+    private:
+
+	/// precomputed state for the secret of one generation
+	struct gen_state_t {
+	    uint32 gen;
+	    bool valid;
+	    /// secret (algo_digest) or SipHash key (algo_siphash)
+	    std::vector<uchar> key;
+	    /// HMAC contexts after hashing key^ipad and key^opad (algo_hmac)
+	    EVP_MD_CTX* inner;
+	    EVP_MD_CTX* outer;
+	};
+
+	/// (re)build the state of generation gen, takes the write lock
+	bool load(uint32 gen);
+
+	/// build the state of generation gen from its secret, write lock must be held
+	bool prepare(uint32 gen);
+
+	/// returns the cached state of generation gen if present, read lock must be held
+	const gen_state_t* lookup(uint32 gen) const;
+
+	/// compute a MAC with the state of a generation, read lock must be held
+	void compute(const gen_state_t& st, const uchar* data, uint32 len, uchar* out);
+
+	/// scratch context of the calling thread
+	EVP_MD_CTX* get_ctx();
+
+	secretmanager& secrets;
+
+	algo_t algo;
+	const EVP_MD* md;
+	uint32 mac_size;
+
+	/// one slot per secret of the secretmanager
+	std::vector<gen_state_t> slots;
+	pthread_rwlock_t lock;
+
+	/// per thread EVP_MD_CTX, avoids an allocation per cookie
+	pthread_key_t ctx_key;
+
+	// not copyable
+	respcookie_engine(const respcookie_engine&);
+	respcookie_engine& operator=(const respcookie_engine&);
+    };
+
+}
+
+
+#endif
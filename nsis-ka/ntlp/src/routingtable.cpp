@@ -92,23 +92,37 @@ ma_entry::get_new_hello_id()
 
 /// give the routing table an initial size
 routingtable::routingtable() :
-  classname("GIST Routing"), sii_counter(0)
+  classname("GIST Routing"), sii_counter(0), rt_entries(0)
 {
   // init mutex
   pthread_mutexattr_init(&mutex_attr);
   pthread_mutexattr_settype(&mutex_attr,PTHREAD_MUTEX_ERRORCHECK);
   pthread_mutex_init(&mutex,&mutex_attr);
 
+  for (unsigned int i= 0; i < rt_stripes; i++)
+  {
+    pthread_mutex_init(&rtable[i].mutex,&mutex_attr);
+    pthread_mutex_init(&mri_index[i].mutex,&mutex_attr);
+  }
+
 #ifndef USE_UNORDERED_MAP
   peer_to_sii_table.resize(128);
   sii_to_peer_table.resize(128);
-  rtable.resize(128);
+  for (unsigned int i= 0; i < rt_stripes; i++)
+  {
+    rtable[i].table.resize(128);
+    mri_index[i].index.resize(128);
+  }
   ma_table.resize(128);
   rao_table.resize(128);
 #else
   peer_to_sii_table.rehash(128);
   sii_to_peer_table.rehash(128);
-  rtable.rehash(128);
+  for (unsigned int i= 0; i < rt_stripes; i++)
+  {
+    rtable[i].table.rehash(128);
+    mri_index[i].index.rehash(128);
+  }
   ma_table.rehash(128);
   rao_table.rehash(128);
 #endif
@@ -119,7 +133,19 @@ routingtable::~routingtable()
 {
   sii_to_peer_table.clear();
   peer_to_sii_table.clear();
-  rtable.clear();
+  for (unsigned int i= 0; i < rt_stripes; i++)
+  {
+    rtable[i].table.clear();
+    // the index owns the copies of the MRIs used as keys, iterating needs them
+    vector<const mri*> index_mris;
+    for (mri_index_iter it= mri_index[i].index.begin(); it != mri_index[i].index.end(); it++)
+      index_mris.push_back(it->first.mr);
+    mri_index[i].index.clear();
+    for (vector<const mri*>::iterator mit= index_mris.begin(); mit != index_mris.end(); mit++)
+      delete *mit;
+    pthread_mutex_destroy(&rtable[i].mutex);
+    pthread_mutex_destroy(&mri_index[i].mutex);
+  }
   ma_table.clear();
   rao_table.clear();
   // destroy mutex
@@ -132,18 +158,122 @@ routingtable::~routingtable()
 void 
 routingtable::add(const routingkey* key, routingentry* entry) 
 {
-  locktable(); //   >=>=>  LOCK  >=>=>
-
   entry->unlock();
-  if (key)
+  if (key == NULL)
   {
-    // should add a key and an entry
-    rtable[*key]= entry;
+    ERRLog("routingtable::add()","key is not available (NULL)");
+    return;
+  }
+
+  rt_stripe_t& stripe= get_stripe(*key);
+  lockstripe(stripe.mutex); //   >=>=>  LOCK  >=>=>
+
+  // should add a key and an entry
+  pair<rt_iter,bool> res= stripe.table.insert(make_pair(*key, entry));
+  if (res.second)
+  {
+    index_add(*key);
+    __atomic_add_fetch(&rt_entries, 1, __ATOMIC_RELAXED);
   }
   else
-    ERRLog("routingtable::add()","key is not available (NULL)");
+    res.first->second= entry;
 
-  unlocktable(); // <=<=< UNLOCK <=<=<
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
+}
+
+
+/// add a routing key to the (MRI, NSLPID) index
+void
+routingtable::index_add(const routingkey& key)
+{
+  if (key.mr == NULL)
+    return;
+
+  mrikey mkey(key.mr, key.nslpid);
+  mri_index_stripe_t& istripe= get_index_stripe(mkey);
+  lockstripe(istripe.mutex);
+
+  mri_index_iter it= istripe.index.find(mkey);
+  if (it == istripe.index.end())
+  { // the MRI of key may be deleted before other keys using it, so the index needs a copy
+    it= istripe.index.insert(make_pair(mrikey(key.mr->copy(), key.nslpid), routingkey_list_t())).first;
+  }
+  it->second.push_back(key);
+
+  unlockstripe(istripe.mutex);
+}
+
+
+/// remove a routing key from the (MRI, NSLPID) index
+void
+routingtable::index_remove(const routingkey& key)
+{
+  if (key.mr == NULL)
+    return;
+
+  mrikey mkey(key.mr, key.nslpid);
+  mri_index_stripe_t& istripe= get_index_stripe(mkey);
+  lockstripe(istripe.mutex);
+
+  mri_index_iter it= istripe.index.find(mkey);
+  if (it != istripe.index.end())
+  {
+    eqroutingkey eq;
+    for (routingkey_list_t::iterator kit= it->second.begin(); kit != it->second.end(); kit++)
+    {
+      if (eq(*kit, key))
+      {
+	it->second.erase(kit);
+	break;
+      }
+    }
+    if (it->second.empty())
+    {
+      const mri* mr= it->first.mr;
+      istripe.index.erase(it);
+      delete mr;
+    }
+  }
+  else
+    ERRCLog(classname, "Routing key for Session-ID " << ((key.sid) ? key.sid->to_string() : "NULL") << " missing in MRI index");
+
+  unlockstripe(istripe.mutex);
+}
+
+
+/**
+ * Copy all routing keys for (MRI, NSLPID) out of the index. The copies do
+ * not depend on the lifetime of the entries, so they can be used after the
+ * index is unlocked again.
+ */
+void
+routingtable::find_keys(const mri* mr, uint32 nslpid, vector<routingkey>& keys)
+{
+  mrikey mkey(mr, nslpid);
+  mri_index_stripe_t& istripe= get_index_stripe(mkey);
+  lockstripe(istripe.mutex);
+
+  mri_index_iter it= istripe.index.find(mkey);
+  if (it != istripe.index.end())
+  {
+    keys.reserve(it->second.size());
+    for (routingkey_list_t::const_iterator kit= it->second.begin(); kit != it->second.end(); kit++)
+      keys.push_back(routingkey(kit->mr->copy(), kit->sid ? kit->sid->copy() : NULL, kit->nslpid));
+  }
+
+  unlockstripe(istripe.mutex);
+}
+
+
+void
+routingtable::free_keys(vector<routingkey>& keys)
+{
+  for (vector<routingkey>::iterator it= keys.begin(); it != keys.end(); it++)
+  {
+    delete it->mr;
+    delete it->sid;
+  }
+  keys.clear();
 }
   
 /** add MA
@@ -371,15 +501,16 @@ routingtable::get_sii_handle(const routingkey* key)
 {
   uint32 sii_handle= 0;
 
-  locktable();   // >=>=>  LOCK  >=>=>
-  rt_citer cur = rtable.find(*key);
-  if (cur != rtable.end()) 
+  rt_stripe_t& stripe= get_stripe(*key);
+  lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
+  rt_citer cur = stripe.table.find(*key);
+  if (cur != stripe.table.end()) 
   {
     const routingentry* rtentry= cur->second;
     if (rtentry)
 	    sii_handle= rtentry->get_sii_handle();
   }
-  unlocktable(); // <=<=< UNLOCK <=<=<
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
 
   return sii_handle;
 }
@@ -430,12 +561,13 @@ routingtable::generate_sii_handle(const nli* nli)
 bool 
 routingtable::exists(const routingkey* key) 
 {
-  locktable();   // >=>=>  LOCK  >=>=>
+  rt_stripe_t& stripe= get_stripe(*key);
+  lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
 
-  rt_citer cur  = rtable.find(*key);
-  bool result= (cur != rtable.end());
+  rt_citer cur  = stripe.table.find(*key);
+  bool result= (cur != stripe.table.end());
 
-  unlocktable(); // <=<=< UNLOCK <=<=<
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
 
   return result;
 }
@@ -448,17 +580,18 @@ routingtable::lookup(const routingkey* key)
 {
   routingentry* entry = NULL;      
  
-  locktable();   // >=>=>  LOCK  >=>=>
+  rt_stripe_t& stripe= get_stripe(*key);
+  lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
       
-  rt_iter cur  = rtable.find(*key);
+  rt_iter cur  = stripe.table.find(*key);
       
-  if (cur != rtable.end()) 
+  if (cur != stripe.table.end()) 
   { 
     entry = (*cur).second;
 	  
     if (entry->is_locked()) {
       ERRCLog(classname, "Tried to access LOCKED ENTRY!");
-      unlocktable(); // <=<=< UNLOCK <=<=<
+      unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
       return NULL; 
     }
     entry->set_lock();
@@ -470,7 +603,7 @@ routingtable::lookup(const routingkey* key)
   {
     DLog(classname, "Lookup not successful");
   }
-  unlocktable(); // <=<=< UNLOCK <=<=<
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
 
   return entry;   
 }    
@@ -480,11 +613,12 @@ routingtable::lookup(const routingkey* key)
 void 
 routingtable::unlock(const routingkey* key) 
 {
-  locktable();   // >=>=>  LOCK  >=>=>
+  rt_stripe_t& stripe= get_stripe(*key);
+  lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
 
-  rt_iter rt_it= rtable.find(*key);
+  rt_iter rt_it= stripe.table.find(*key);
       
-  if (rt_it != rtable.end()) 
+  if (rt_it != stripe.table.end()) 
   { 
     routingentry* tmp = rt_it->second;
     if (tmp) 
@@ -495,7 +629,7 @@ routingtable::unlock(const routingkey* key)
     else
       ERRCLog(classname,"while unlocking(): routing entry for Session-ID "<< ((key->sid) ? key->sid->to_string() : "NULL") << " exists, but routing entry is NULL");
   }
-  unlocktable(); // <=<=< UNLOCK <=<=<
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
 }
  
 
@@ -503,33 +637,36 @@ routingtable::unlock(const routingkey* key)
 void 
 routingtable::update_unlock(routingkey* key, routingentry* entry) 
 {
-  locktable();   // >=>=>  LOCK  >=>=>
+  rt_stripe_t& stripe= get_stripe(*key);
+  lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
 
   entry->unlock();
   // lookup
-  rt_iter rt_it= rtable.find(*key);
-  if (rt_it != rtable.end())
+  rt_iter rt_it= stripe.table.find(*key);
+  if (rt_it != stripe.table.end())
     rt_it->second= entry;
 
-  unlocktable(); // <=<=< UNLOCK <=<=<
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
 }
   
 /**
  * we invalidate routing data, return true if succesfully done
  * key is deleted from rkey_to_sii_table, but entry is still accessible via sii-handle
  * @param key                      routing entry to be deleted
- * @param table_already_locked     table will not be locked because already locked
+ * @param table_already_locked     stripe of key will not be locked because already locked
  **/
 bool 
 routingtable::delete_entry(const routingkey* key, bool table_already_locked)
 {
+  rt_stripe_t& stripe= get_stripe(*key);
+
   if (!table_already_locked) 
-    locktable();   // >=>=>  LOCK  >=>=>
+    lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
 
-  rt_iter rt_it= rtable.find(*key);
+  rt_iter rt_it= stripe.table.find(*key);
 
   routingentry* rt_entry= 0;
-  if (rt_it != rtable.end()) 
+  if (rt_it != stripe.table.end()) 
   {
     rt_entry= rt_it->second;
   }
@@ -537,7 +674,7 @@ routingtable::delete_entry(const routingkey* key, bool table_already_locked)
   {
     ERRCLog(classname,"Trying to delete a non-existing entry (Session-ID "<< ((key->sid) ? key->sid->to_string() : "NULL") << ")!");
     if (!table_already_locked) 
-      unlocktable(); // <=<=< UNLOCK <=<=<
+      unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
     
     return false;
   }
@@ -545,23 +682,24 @@ routingtable::delete_entry(const routingkey* key, bool table_already_locked)
   if (!rt_entry->is_locked()) {
     ERRCLog(classname,"You should ACQUIRE A LOCK PRIOR TO DELETING an entry!");
     if (!table_already_locked) 
-      unlocktable(); // <=<=< UNLOCK <=<=<
+      unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
     
     return false;
   }
 
-  remove_entry(rt_it);
+  remove_entry(stripe, rt_it);
 
-  unlocktable(); // <=<=< UNLOCK <=<=<
+  if (!table_already_locked) 
+    unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
   
   return true;
 }
 
 void
-routingtable::remove_entry(rt_iter &it)
+routingtable::remove_entry(rt_stripe_t& stripe, rt_iter &it)
 {
   routingentry* rt_entry;
-  if (it == rtable.end()) 
+  if (it == stripe.table.end()) 
     return;
 
   rt_entry= it->second;
@@ -576,8 +714,11 @@ routingtable::remove_entry(rt_iter &it)
   const routingkey* key = &it->first;
   DLog(classname, "Deleted Routing Key w/ Session-ID "<< ((key->sid) ? key->sid->to_string() : "NULL") );
 
+  index_remove(*key);
+
   // delete entry in routing table, note that this will probably make the iterator invalid
-  rtable.erase(it);
+  stripe.table.erase(it);
+  __atomic_sub_fetch(&rt_entries, 1, __ATOMIC_RELAXED);
   status();
 }
 
@@ -586,36 +727,37 @@ routingtable::remove_entry(rt_iter &it)
 // 
 bool routingtable::destroy_entry(const routingkey* key) 
 {
-  locktable();   // >=>=>  LOCK  >=>=>
+  rt_stripe_t& stripe= get_stripe(*key);
+  lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
 
-  rt_iter rt_it= rtable.find(*key);
+  rt_iter rt_it= stripe.table.find(*key);
   routingentry* rt_entry= 0;
-  if (rt_it != rtable.end()) 
+  if (rt_it != stripe.table.end()) 
   {
     rt_entry= rt_it->second;
   }
   else
   {
     ERRCLog(classname,"Trying to delete a non-existing entry (Session-ID "<< ((key->sid) ? key->sid->to_string() : "NULL") << ")!");
-    unlocktable(); // <=<=< UNLOCK <=<=<
+    unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
     
     return false;
   }
   
   if (!rt_entry->is_locked()) {
     ERRCLog(classname,"You should ACQUIRE A LOCK PRIOR TO DELETING an entry!");
-    unlocktable(); // <=<=< UNLOCK <=<=<
+    unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
     
     return false;
   }
 
-  remove_entry(rt_it);
+  remove_entry(stripe, rt_it);
+
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
 
   delete key;
   DLog(classname, "Destroyed Routing Key, key is unusable");
   
-  unlocktable(); // <=<=< UNLOCK <=<=<
-  
   return true;
 }
 
@@ -626,7 +768,7 @@ void
 routingtable::status() const
 {
   // routing holds size()-1 valid entries! (first is NULL)
-  DLog(classname, color[red] << "Active Routing Entries: " << rtable.size() << " MAs: " << ma_table.size() << " SII handles: " << peer_to_sii_table.size() <<color[off]);
+  DLog(classname, color[red] << "Active Routing Entries: " << size() << " MAs: " << ma_table.size() << " SII handles: " << peer_to_sii_table.size() <<color[off]);
 }
 
 // dump some status about routing states to log file
@@ -638,20 +780,27 @@ routingtable::print_routingtable() const
 
   const routingentry* entry= NULL;
   
-  rt_citer entryit= rtable.begin();
-  while(entryit !=rtable.end())
+  for (unsigned int i= 0; i < rt_stripes; i++)
   {
-    if ( (entry= (*entryit).second) != NULL )
+    lockstripe(rtable[i].mutex);
+
+    rt_citer entryit= rtable[i].table.begin();
+    while(entryit !=rtable[i].table.end())
     {
+      if ( (entry= (*entryit).second) != NULL )
+      {
 
-	    const routingkey& rkey= (*entryit).first;
-	    os << "sid:" << (rkey.sid ? rkey.sid->to_string() : "-") 
-	       << " NSLPID:" << rkey.nslpid << endl << " MRI/Flow:" << (rkey.mr ? rkey.mr->to_string() : "NULL") << endl;
+	      const routingkey& rkey= (*entryit).first;
+	      os << "sid:" << (rkey.sid ? rkey.sid->to_string() : "-") 
+		 << " NSLPID:" << rkey.nslpid << endl << " MRI/Flow:" << (rkey.mr ? rkey.mr->to_string() : "NULL") << endl;
 
-	    os << entry->to_string() << endl << "---------------------------------------------" << endl;
-    }
-    entryit++;
-  } // end while
+	      os << entry->to_string() << endl << "---------------------------------------------" << endl;
+      }
+      entryit++;
+    } // end while
+
+    unlockstripe(rtable[i].mutex);
+  } // end for
  
   return os.str();  
 }
@@ -900,204 +1049,182 @@ routingtable::hello_ind_ma(const appladdress* peer, bool r_flag, uint32 hid)
 void 
 routingtable::invalidate_routing_state(const mri* mymr, const uint32 nslpid, const APIMsg::status_t status, const bool urgency) 
 {
-
-  DLog(classname, color[red] << "Iterating over Routing Key table to find the entries we must apply InvalidateRoutingState" << color[off]);
-
   if (!mymr) {
     ERRCLog(classname, "Attempt was undertaken to Invalidate Routing State with no MRI given");
     return;
   }
 
-  const routingkey* key = NULL;
+  // only the entries for this MRI are visited, found via the MRI index
+  vector<routingkey> keys;
+  find_keys(mymr, nslpid, keys);
 
-  locktable();   // >=>=>  LOCK  >=>=>
+  DLog(classname, color[red] << "Found " << keys.size() << " Routing Keys we must apply InvalidateRoutingState to" << color[off]);
+
+  for (vector<routingkey>::iterator kit= keys.begin(); kit != keys.end(); kit++)
+    invalidate_routing_state(*kit, status, urgency);
+
+  free_keys(keys);
+}
 
-  rt_iter cur = rtable.begin();
 
-  while (!(cur == rtable.end())) 
+/**
+ * Invalidate the routing state entry of a single session. With a sharded
+ * state module, only the shard owning the session may call this, since
+ * the entry may be replaced or removed.
+ * @param key    routing key of the entry
+ */
+void
+routingtable::invalidate_routing_state(const routingkey& key, const APIMsg::status_t status, const bool urgency)
+{
+  rt_stripe_t& stripe= get_stripe(key);
+  lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
+
+  // entry may have been removed since the index was searched
+  rt_iter cur= stripe.table.find(key);
+  if (cur != stripe.table.end())
   {
-    Log(DEBUG_LOG,LOG_NORMAL, classname, color[red] << "Inspecting key" << color[off]);
-    
-    key=&(*cur).first;
-    
-    if ((*(key->mr) == *mymr) && (key->nslpid == nslpid)) {
-      DLog(classname, color[red] << "Found a matching entry, Invalidating Routing State" << color[off]);
-      
-      routingentry* entry = (*cur).second;
-      
-      if (entry)
-      {
-	// check for status and set
-	
-	// ****************** BAD ***********************************+++
-	if (status==APIMsg::bad) 
-	{ // Routing state must be set to 'BAD', which means killing state
-	  DLog(classname, color[red] << "Routing state must be set to 'BAD', which means killing state" << color[off]);
+    if (cur->second)
+      invalidate_entry(stripe, cur, status, urgency);
+    else 
+      ERRCLog(classname, "There is a key for which there is no routing state anymore?!?!");
+  }
+
+  unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
+}
+
+
+/**
+ * apply InvalidateRoutingState to a single routing state entry
+ * @param stripe  locked stripe containing the entry
+ * @param cur     the entry, may be removed from the stripe
+ */
+void
+routingtable::invalidate_entry(rt_stripe_t& stripe, rt_iter& cur, const APIMsg::status_t status, const bool urgency)
+{
+  DLog(classname, color[red] << "Found a matching entry, Invalidating Routing State" << color[off]);
+
+  routingentry* entry = cur->second;
+  const routingkey key= cur->first;
+
+  // ****************** BAD ***********************************+++
+  if (status==APIMsg::bad) 
+  { // Routing state must be set to 'BAD', which means killing state
+    DLog(classname, color[red] << "Routing state must be set to 'BAD', which means killing state" << color[off]);
 	  
-	  entry->set_errstate(APIMsg::route_changed_status_bad);
+    entry->set_errstate(APIMsg::route_changed_status_bad);
 	  
-	  if (urgency) 
-	  { // Immediate re-installation is requested, starting new handshake
-	    DLog(classname, color[red] << "Immediate re-installation is requested, starting new handshake" << color[off]);
+    if (urgency) 
+    { // Immediate re-installation is requested, starting new handshake
+      DLog(classname, color[red] << "Immediate re-installation is requested, starting new handshake" << color[off]);
 			    
-	    if (entry->get_state() == qn_established) 
-	    {
-			    
-	      DLog(classname, "I am QN for this state, going ahead and starting new handshake in QN_AWAITING_RESPONSE (no communication possible)");
-
-	      // Make a COPY of the routing entry, invalidate the old one by remove_entry()
-	      routingentry* tmpentry = new routingentry(*entry);
-	      remove_entry(cur);
-	      // XXX: after removing the entry from the table the iterator is no longer valid!
-	      //      starting from the begining again, though this is not 100% correct, as the
-	      //      cur++ at the bottom will make us start from beginning+1
-	      //      It seems unlikely, however, that we have more than one match in a hash_map
-	      //      so this whole while-loop is probably bogus anyway.  For the moment this is
-	      //      good enough.
-	      cur = rtable.begin();
-
-	      add(key, tmpentry);
-	      if (entry) delete entry;
-	      entry = lookup(key);
-	      // unlock. this is not safe. shhhh...
-	      entry->unlock();
+      if (entry->get_state() == qn_established) 
+      {
+	DLog(classname, "I am QN for this state, going ahead and starting new handshake in QN_AWAITING_RESPONSE (no communication possible)");
+
+	// Make a COPY of the routing entry and replace the old one by it
+	routingentry* tmpentry = new routingentry(*entry);
+	tmpentry->unlock();
+	cur->second= tmpentry;
+	delete entry;
+	entry= tmpentry;
 				
-	      // drop to AWAITING_RESPONSE
-	      entry->set_state(qn_awaiting_response);
-	      //start NoResponse timer
-	      TimerMsg* msg = new TimerMsg(message::qaddr_coordination,true);
-	      // starting timer, give pointer to routingkey
-	      entry->set_timer_type_2(noresponse);
-				    
-	      uint32* timer_type = new uint32;
-	      *timer_type = entry->get_timer_type_2();
+	// drop to AWAITING_RESPONSE
+	entry->set_state(qn_awaiting_response);
+	// starting NoResponse timer, the timer message carries a copy of the routing key
+	entry->set_timer_type_2(noresponse);
 
-	      // set retry timeout back to initial value
-	      entry->reset_retry_timeout();
-				    
-	      // start for 500msec (or whatever retryperiod is set to)
-	      msg->start_relative(0, entry->get_retry_timeout(),(void*) timer_type, (void*) key);
-	      entry->set_timer_id_2(msg->get_id());
+	// set retry timeout back to initial value
+	entry->reset_retry_timeout();
+
+	// start for 500msec (or whatever retryperiod is set to)
+	TimerMsg* msg = new RoutingTableTimerMsg(key, noresponse, 0, entry->get_retry_timeout());
+	entry->set_timer_id_2(msg->get_id());
 				    
-	      DLog(classname, "NoResponse timer started");
-				
-	      // send timer msg to Timer Module
-	      msg->send_to(message::qaddr_timer);
+	DLog(classname, "NoResponse timer started");
 				
-	    } // endif state==qn_established
-			    
-	    if (entry->get_state() == rn_established) 
-	    {
-	      DLog(classname, "I am RN, I cannot re-install state, even though it was requested simply going to 'DEAD'");
+	// send timer msg to Timer Module
+	msg->send_to(message::qaddr_timer);
+      } // endif state==qn_established
+      else
+      if (entry->get_state() == rn_established) 
+      {
+	DLog(classname, "I am RN, I cannot re-install state, even though it was requested simply going to 'DEAD'");
 	      
-	      remove_entry(cur);
-	      // XXX: see above
-	      cur = rtable.begin();
-	    }
-	  } // endif urgency
-	  else 
-	  { // No immediate re-installation is requested, just killing the state
-	    DLog(classname, color[red] << "No immediate re-installation is requested, just killing the state" << color[off]);
+	remove_entry(stripe, cur);
+      }
+    } // endif urgency
+    else 
+    { // No immediate re-installation is requested, just killing the state
+      DLog(classname, color[red] << "No immediate re-installation is requested, just killing the state" << color[off]);
 	    
-	    remove_entry(cur);
-	    // XXX: see above
-	    cur = rtable.begin();
-	  }
-	}
-
+      remove_entry(stripe, cur);
+    }
+  }
 
-	//************************* TENTATIVE *********************
+  //************************* TENTATIVE *********************
 
-	if (status==APIMsg::tentative) 
-	{	  
-	  EVLog(classname, "Set Routingstate to 'tentative', GIST will notify on change");
-	  entry->set_errstate(APIMsg::route_changed_status_tentative);
+  if (status==APIMsg::tentative) 
+  {	  
+    EVLog(classname, "Set Routingstate to 'tentative', GIST will notify on change");
+    entry->set_errstate(APIMsg::route_changed_status_tentative);
 	  
-	  // Drop only to qn_awaiting_refresh
-	  if (urgency) 
-	  {
-	    DLog(classname, color[red] << "Immediate re-installation is requested, starting new handshake" << color[off]);
-			    
-	    // we can do so if we are Querier and there is nothing else going on
-	    if (entry->get_state() == qn_established) 
-	    {
+    // Drop only to qn_awaiting_refresh
+    if (urgency) 
+    {
+      DLog(classname, color[red] << "Immediate re-installation is requested, starting new handshake" << color[off]);
 			    
-	      DLog(classname, "I am QN for this state, going ahead and starting new handshake in QN_AWAITING_REFRESH (communication possible)");
+      // we can do so if we are Querier and there is nothing else going on
+      if (entry->get_state() == qn_established) 
+      {
+	DLog(classname, "I am QN for this state, going ahead and starting new handshake in QN_AWAITING_REFRESH (communication possible)");
 				
-	      // drop to AWAITING_RESPONSE
-	      entry->set_state(qn_awaiting_refresh);
-	      //start NoResponse timer
-	      TimerMsg* msg = new TimerMsg(message::qaddr_coordination,true);
-	      // starting timer, give pointer to routingkey
-	      entry->set_timer_type_2(noresponse);
-				    
-	      uint32* timer_type = new uint32;
-	      *timer_type = entry->get_timer_type_2();
+	// drop to AWAITING_RESPONSE
+	entry->set_state(qn_awaiting_refresh);
+	// starting NoResponse timer, the timer message carries a copy of the routing key
+	entry->set_timer_type_2(noresponse);
 				    
-	      // set retry timeout back to initial value
-	      entry->reset_retry_timeout();
+	// set retry timeout back to initial value
+	entry->reset_retry_timeout();
 
-	      // start for 500msec (or whatever retryperiod is set to)
-	      msg->start_relative(0, entry->get_retry_timeout(),(void*) timer_type, (void*) key);
-	      entry->set_timer_id_2(msg->get_id());
+	// start for 500msec (or whatever retryperiod is set to)
+	TimerMsg* msg = new RoutingTableTimerMsg(key, noresponse, 0, entry->get_retry_timeout());
+	entry->set_timer_id_2(msg->get_id());
 				    
-	      DLog(classname, "NoResponse timer started");
-				
-	      // send timer msg to Timer Module
-	      msg->send_to(message::qaddr_timer);
+	DLog(classname, "NoResponse timer started");
 				
-	    }
+	// send timer msg to Timer Module
+	msg->send_to(message::qaddr_timer);
+      }
 			    
-	    if (entry->get_state() == rn_established) {
-	      DLog(classname, "I am RN, I cannot start a state refresh");
-				
-
-	    }
-	  } // end if URGENT
-	} // end if TENTATIVE
-
-      } 
-      else 
-	ERRCLog(classname, "There is a key for which there is no routing state anymore?!?!");
-    } // end if key matches
-
-    // XXX: in case we just killed the last one
-    if (cur == rtable.end())
-    	break;
-
-    cur++;
-  } // end while
-
-  unlocktable(); // <=<=< UNLOCK <=<=<
-
+      if (entry->get_state() == rn_established) {
+	DLog(classname, "I am RN, I cannot start a state refresh");
+      }
+    } // end if URGENT
+  } // end if TENTATIVE
 }
 
 
-/// iterates over routing table and sets lifetime for every routing table entry
+/// sets lifetime for every routing table entry of the MRI
 void 
 routingtable::set_state_lifetime(const mri* mymr, const uint32 nslpid, const uint32 lifetime) 
 {
-  // we must iterate over the full table and cannot use a lookup since routing key contains
-  // additionally the session ID which is not given here
-  DLog(classname, color[red] << "Iterating over Routing Key table to find the entries we must apply SetStateLifetime" << color[off]);
+  // the routing key contains additionally the session ID which is not given here,
+  // so the entries are found via the MRI index
+  vector<routingkey> keys;
+  find_keys(mymr, nslpid, keys);
 
-  const routingkey* key = NULL;
+  DLog(classname, color[red] << "Found " << keys.size() << " Routing Keys we must apply SetStateLifetime to" << color[off]);
 
-  locktable();   // >=>=>  LOCK  >=>=>
-
-  routingentry* rte= NULL;
-  rt_iter rt_it= rtable.begin();
-
-  while (rt_it != rtable.end()) 
+  for (vector<routingkey>::iterator kit= keys.begin(); kit != keys.end(); kit++)
   {
-    Log(DEBUG_LOG,LOG_NORMAL, classname, color[red] << "Inspecting key" << color[off]);
-    
-    key=&(*rt_it).first;
-    
-    if ((*(key->mr) == *mymr) && (key->nslpid == nslpid)) 
+    rt_stripe_t& stripe= get_stripe(*kit);
+    lockstripe(stripe.mutex);   // >=>=>  LOCK  >=>=>
+
+    rt_iter rt_it= stripe.table.find(*kit);
+    if (rt_it != stripe.table.end())
     {
       DLog(classname, color[red] << "Found a matching entry, setting State Lifetime (RS Time) to " << lifetime << "sec" << color[off]);
-      rte= (*rt_it).second;
+      routingentry* rte= rt_it->second;
       if (rte!=NULL) 
       {
 	      rte->set_rs_validity_time(lifetime);
@@ -1105,11 +1232,11 @@ routingtable::set_state_lifetime(const mri* mymr, const uint32 nslpid, const uin
       else 
 	ERRCLog(classname, "Found no appropriate Routing data entry for given Routing Key");
     }
-      
-    rt_it++;
-  } // end while
 
-  unlocktable(); // <=<=< UNLOCK <=<=<
+    unlockstripe(stripe.mutex); // <=<=< UNLOCK <=<=<
+  }
+
+  free_keys(keys);
 }
 
 
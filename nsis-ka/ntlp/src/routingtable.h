@@ -41,6 +41,8 @@
 */
 
 #include <cerrno>
+#include <list>
+#include <vector>
 #include "hashmap"
 
 #include "sessionid.h"
@@ -103,6 +105,45 @@ struct eqroutingkey
   }
 };
 
+/// the key for the secondary routing table index: MRI and NSLPID of routing keys
+/// @note MRI is a pointer
+struct mrikey
+{
+  mrikey(const mri* mr= NULL, uint32 nslpid= 0) :
+    mr(mr),
+    nslpid(nslpid)
+  {
+  }
+
+  const mri* mr;
+  uint32 nslpid;
+};
+
+/// a hash function operating on the MRI key, uses only fields compared by all MRMs
+struct hash_mrikey
+{
+  size_t operator()(const mrikey& in) const
+  {
+    if (in.mr == NULL)
+      return in.nslpid;
+
+    return (in.mr->get_sourceaddress().get_hash() * 31 + in.mr->get_destaddress().get_hash())
+      ^ in.mr->get_mrm() ^ (in.nslpid << 8);
+  }
+};
+
+/// a comparison function for the MRI key
+struct eqmrikey
+{
+  bool operator()(const mrikey& k1, const mrikey& k2) const
+  {
+    if (k1.mr && k2.mr)
+      return (k1.nslpid==k2.nslpid) && (*(k1.mr) == *(k2.mr));
+    else
+      return false;
+  }
+};
+
 /// a comparison function for Message Association table key (NLI)
 /// only peer_identity and if_address should be used for this
 struct eqnli
@@ -256,11 +297,22 @@ class RoutingTableTimerMsg : public TimerMsg {
 
 
     
-/// the object encapsulating the routing data structures, provides lookup methods and storage
+/** the object encapsulating the routing data structures, provides lookup methods and storage
+ *
+ * The routing state is partitioned into rt_stripes independently locked
+ * stripes, selected by the hash of the routing key, so lookups for different
+ * sessions do not contend for a common lock. A secondary index maps
+ * (MRI, NSLPID) to the routing keys using it, so InvalidateRoutingState and
+ * SetStateLifetime only visit the affected entries. Locks are always taken in
+ * the order stripe, index; the index is never held while locking a stripe.
+ * The MA and SII handle tables are still protected by a single mutex.
+ */
 class routingtable 
 {
  public:
   typedef hashmap_t<routingkey, routingentry*, hash_routingkey, eqroutingkey> rkey_to_rentry_hashmap_t;
+  typedef list<routingkey> routingkey_list_t;
+  typedef hashmap_t<mrikey, routingkey_list_t, hash_mrikey, eqmrikey> mri_to_rkeys_hashmap_t;
   typedef hashmap_t<nli, ma_entry, hash_nli, eqnli> ma_hashmap_t;
   typedef hashmap_t<nli, uint32, hash_nli, eqnli> peer_to_sii_hashmap_t;
   typedef hashmap_t<uint32, nli> sii_to_peer_hashmap_t;
@@ -287,6 +339,9 @@ class routingtable
   /// rt_citer
   typedef rkey_to_rentry_hashmap_t::const_iterator rt_citer;
   
+  /// mri_index_iter
+  typedef mri_to_rkeys_hashmap_t::iterator mri_index_iter;
+
   /// sii_iter
   typedef sii_to_peer_hashmap_t::iterator siipeer_iter;
   /// sii_citer
@@ -317,9 +372,18 @@ class routingtable
   bool destroy_entry(const routingkey* key);
       
   void invalidate_routing_state(const mri*, const uint32 nslpid, const APIMsg::status_t, const bool urgency);
+  /// invalidate the routing state of a single session
+  void invalidate_routing_state(const routingkey& key, const APIMsg::status_t, const bool urgency);
+
+  /// copies of all routing keys for (MRI, NSLPID), must be freed with free_keys()
+  void find_keys(const mri* mr, uint32 nslpid, vector<routingkey>& keys);
+  static void free_keys(vector<routingkey>& keys);
       
   void set_state_lifetime(const mri*, const uint32 nslpid, const uint32 lifetime);
       
+  /// number of routing entries
+  uint32 size() const { return __atomic_load_n(&rt_entries, __ATOMIC_RELAXED); }
+
   /// prints some status information (rough number statistics) about the routing table and MA table
   void status() const; 
 
@@ -378,20 +442,49 @@ class routingtable
   uint32 get_rao(uint32 nslpid) { return rao_table[nslpid]; }
       
  private:
+  /// number of independently locked partitions of the routing state
+  static const unsigned int rt_stripes= 64;
+
+  /// a partition of the routing state
+  struct rt_stripe_t
+  {
+    mutable pthread_mutex_t mutex;
+    rkey_to_rentry_hashmap_t table;
+  };
+
+  /// a partition of the (MRI, NSLPID) index
+  struct mri_index_stripe_t
+  {
+    pthread_mutex_t mutex;
+    mri_to_rkeys_hashmap_t index;
+  };
+
   const char* const classname;
 
   void locktable();
   void unlocktable();
 
-  /// delete entry, still accessible via sii-handle
-  void remove_entry(rt_iter &it);
+  rt_stripe_t& get_stripe(const routingkey& key);
+  mri_index_stripe_t& get_index_stripe(const mrikey& key);
+  void lockstripe(pthread_mutex_t& m) const;
+  void unlockstripe(pthread_mutex_t& m) const;
+
+  /// add key to the (MRI, NSLPID) index, stripe of key must be locked
+  void index_add(const routingkey& key);
+  /// remove key from the (MRI, NSLPID) index, stripe of key must be locked
+  void index_remove(const routingkey& key);
+  /// apply InvalidateRoutingState to the entry at it, stripe must be locked
+  void invalidate_entry(rt_stripe_t& stripe, rt_iter& it, const APIMsg::status_t status, const bool urgency);
+
+  /// delete entry, still accessible via sii-handle, stripe must be locked
+  void remove_entry(rt_stripe_t& stripe, rt_iter &it);
 
   void inc_sii_handle() { sii_counter++;
     // do not use 0 as valid handle
     if (sii_counter==0) sii_counter++;
   }
 
-  // mutex for lock
+  // mutex for lock of MA and SII handle tables
   pthread_mutexattr_t mutex_attr;
   pthread_mutex_t mutex;
        
@@ -403,7 +496,13 @@ class routingtable
   uint32 sii_counter;
 
   /// this is the routing table
-  rkey_to_rentry_hashmap_t rtable;
+  rt_stripe_t rtable[rt_stripes];
+
+  /// index (MRI, NSLPID) -> routing keys
+  mri_index_stripe_t mri_index[rt_stripes];
+
+  /// number of routing entries in all stripes
+  uint32 rt_entries;
       
   /// hash map for key lookup from peerid,if (routingkey) to SII handle
   peer_to_sii_hashmap_t peer_to_sii_table;
@@ -437,6 +536,38 @@ ntlp::routingtable::unlocktable()
     ERRCLog("routingtable::unlocktable()", "Mutex Unlock failed. Error: " << strerror(errno));
 }
 
+inline
+void 
+ntlp::routingtable::lockstripe(pthread_mutex_t& m) const
+{
+  if (pthread_mutex_lock(&m))
+    ERRCLog("routingtable::lockstripe()", "Mutex Lock failed. Error: " << strerror(errno));
+}
+
+inline
+void 
+ntlp::routingtable::unlockstripe(pthread_mutex_t& m) const
+{
+  if (pthread_mutex_unlock(&m))
+    ERRCLog("routingtable::unlockstripe()", "Mutex Unlock failed. Error: " << strerror(errno));
+}
+
+inline
+ntlp::routingtable::rt_stripe_t&
+ntlp::routingtable::get_stripe(const routingkey& key)
+{
+  size_t h= hash_routingkey()(key);
+  return rtable[(h ^ (h >> 16)) % rt_stripes];
+}
+
+inline
+ntlp::routingtable::mri_index_stripe_t&
+ntlp::routingtable::get_index_stripe(const mrikey& key)
+{
+  size_t h= hash_mrikey()(key);
+  return mri_index[(h ^ (h >> 16)) % rt_stripes];
+}
+
     
 }// end namespace
 
@@ -28,6 +28,8 @@
 // ===========================================================
 #include <secretmanager.h>
 #include <openssl/rand.h>
+#include <openssl/crypto.h>
+#include <cstring>
 #include <iostream>
 #include <iomanip>
 
@@ -45,6 +47,8 @@ secretmanager::secretmanager(uint32 tablesize, uint32 secretsize) :
 	DLog("GIST secrets", color[blue] <<  "Initially filling random seed, "
 		<< tablesize << " secrets of length " << secretsize << "bit" << color[off]);
 
+	pthread_rwlock_init(&lock, NULL);
+
 	// clear
 	secrets.clear();
 	secrets.reserve(tablesize);
@@ -80,12 +84,41 @@ secretmanager::secretmanager(uint32 tablesize, uint32 secretsize) :
 }
   
   
+/// true if there is a secret with generation number n
+bool
+secretmanager::is_valid(uint32 n) const
+{
+	pthread_rwlock_rdlock(&lock);
+	bool valid= (gen_numbers[n%tablesize] == n);
+	pthread_rwlock_unlock(&lock);
+
+	return valid;
+}
+
+
+/// copy the secret with generation number n into buf, false if generation number is not valid
+bool
+secretmanager::copy_secret(uint32 n, uchar* buf) const
+{
+	bool valid= false;
+
+	pthread_rwlock_rdlock(&lock);
+	// generation number must fit
+	if (gen_numbers[n%tablesize] == n)
+	{
+		memcpy(buf, secrets[n%tablesize], secretsize/8);
+		valid= true;
+	}
+	pthread_rwlock_unlock(&lock);
+
+	return valid;
+}
+
+
 /// go to next secret generation
 void 
 secretmanager::forward() 
 {
-	generation_number++;
-
 	// fill in new secret
 	uchar* tmp = new uchar[secretsize/8];
 
@@ -94,17 +127,26 @@ secretmanager::forward()
 		abort();
 	}
 
-	gen_numbers[generation_number%tablesize]= generation_number;
+	// readers never see a half replaced generation
+	pthread_rwlock_wrlock(&lock);
 
-	// free old secret
-	uchar* oldsecret= secrets.at(generation_number%tablesize);
-	delete [] oldsecret;
+	uint32 gen= generation_number + 1;
+
+	gen_numbers[gen%tablesize]= gen;
+	uchar* oldsecret= secrets[gen%tablesize];
 	// write the new one
-	secrets[generation_number%tablesize] = tmp;
+	secrets[gen%tablesize] = tmp;
+	__atomic_store_n(&generation_number, gen, __ATOMIC_RELEASE);
+
+	pthread_rwlock_unlock(&lock);
+
+	// free old secret, it was only used under the lock
+	OPENSSL_cleanse(oldsecret, secretsize/8);
+	delete [] oldsecret;
 
 	DLog("GIST secrets", color[magenta]
-		<< "Secret number: " << dec << (int) generation_number % tablesize << " replaced."
-		<< " New Generation Number: 0x" << hex << (int) generation_number
+		<< "Secret number: " << dec << (int) gen % tablesize << " replaced."
+		<< " New Generation Number: 0x" << hex << (int) gen
 		<< " Secret length: " << dec << secretsize << " Bit" << color[off]); 	
 }
 
@@ -114,7 +156,9 @@ secretmanager::~secretmanager()
 	// free the secrets
 	for (vector<uchar*>::iterator it= secrets.begin(); it != secrets.end(); it++)
 	{
-		delete *it;
+		delete [] *it;
 	}
+
+	pthread_rwlock_destroy(&lock);
 }
 
@@ -35,6 +35,8 @@
 #define _NTLP__SECRETMANAGER_H_
 
 
+#include <pthread.h>
+
 #include "ntlp_object.h"
 #include "address.h"
 #include "protlib_types.h"
@@ -56,6 +58,7 @@ namespace ntlp {
  
    
     // the object encapsulating the secret data structure, provides lookup and manipulation
+    // (thread safe: the state module shards use it while secrets are rolled over)
     class secretmanager {
 	
 	
@@ -67,32 +70,25 @@ namespace ntlp {
 	~secretmanager();
 	
 	/// Returns current generation number, needed on cookie generation
-	inline uint32 get_generation_number() { return generation_number; };
+	inline uint32 get_generation_number() const { return __atomic_load_n(&generation_number, __ATOMIC_ACQUIRE); };
 
 	/// Returns secret size in Byte
 	inline
-	    uint32 get_secret_size() {
+	    uint32 get_secret_size() const {
 	    return secretsize/8;
 
 	};
 
+	/// Returns number of secrets (generations) kept
+	inline uint32 get_table_size() const { return tablesize; };
 
-	/// Returns current secret
-	inline
-	    uchar* get_secret() {
-	    return secrets.at(generation_number % tablesize);
-	};
-	
-	/// Returns secret with generation number n
-        /// @return either pointer to secret or NULL if generation number is not valid
-	inline
-	    uchar* get_secret(uint32 n) {
-	  // generation number must fit
-	  if (gen_numbers.at(n%tablesize) == n)
-	    return secrets.at(n%tablesize);
-	  else // generation number not valid
-	    return NULL;
-	};
+
+	/// Returns whether there is a secret with generation number n
+	bool is_valid(uint32 n) const;
+
+	/// Copies the secret with generation number n into buf (get_secret_size() Byte)
+	/// @return false if generation number is not valid
+	bool copy_secret(uint32 n, uchar* buf) const;
 
 	/// performs rapid rollover
 	void forward();
@@ -113,6 +109,13 @@ namespace ntlp {
 	/// Table Size (Secret Count)
 	uint32 secretsize;
 
+	/// read lock for lookups, write lock for rollover
+	mutable pthread_rwlock_t lock;
+
+	// not copyable
+	secretmanager(const secretmanager&);
+	secretmanager& operator=(const secretmanager&);
+
 
     };    
     
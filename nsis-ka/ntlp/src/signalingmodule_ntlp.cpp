@@ -39,6 +39,7 @@
 #include "queuemanager.h"
 #include "logfile.h"
 #include "ntlp_proto.h"
+#include "ntlp_statemodule.h"
 #include "rfc5014_hack.h"
 
 #ifndef NSIS_OMNETPP_SIM
@@ -246,7 +247,7 @@ bool
 SignalingMsgNTLP::send(bool exp) 
 {
   qaddr_t s = get_source();
-  if (s==qaddr_signaling) return send_to(qaddr_coordination,exp);
+  if (s==qaddr_signaling) return Statemodule::send_to_shard(this,exp);
   else if (s!=qaddr_unknown) return send_to(qaddr_signaling,exp);
   else return false;
 } // end send
@@ -617,7 +618,7 @@ SignalingNTLP::process_tp_msg(TPMsg* tpmsg)
 	  peer = NULL;
 	  result_pdu = NULL;
 	  encappdu = NULL;
-	  if (!sigmsg->send_to(message::qaddr_coordination,false)) 
+	  if (!Statemodule::send_to_shard(sigmsg,false)) 
 	  {
 	    Log(ERROR_LOG,LOG_NORMAL, param.name, "Cannot send a message to " << message::get_qaddr_name(message::qaddr_coordination));
 	   
@@ -0,0 +1,202 @@
+/*
+ * test/respcookie_bench.cpp - Measure responder cookie MAC throughput.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ * Computes and verifies MACs over a typical responder cookie input
+ * (interface index, peer identity, IPv4 address, NSLPID, path-coupled
+ * MRI, session ID and generation number) with every algorithm of the
+ * cookie engine. For comparison the "per call" line does what cookie
+ * creation did before: look up the digest and set up a fresh context
+ * for every cookie. T threads share one engine. Run as
+ *
+ *   ./respcookie_bench [cookies per thread] [threads]
+ */
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <openssl/evp.h>
+
+#include "logfile.h"
+#include "respcookie_engine.h"
+
+using namespace protlib;
+using namespace protlib::log;
+using namespace ntlp;
+
+// needed for linking
+logfile commonlog("", false, true);
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_new EVP_MD_CTX_create
+#define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#endif
+
+// size of the MAC input of a cookie for an IPv4 path-coupled MRI
+static const uint32 input_size = 2 + 20 + 4 + 2 + 16 + 16 + 4;
+static const uint32 batch_size = 32;
+
+static secretmanager *secrets;
+static respcookie_engine *engine;
+static unsigned long cookies = 200000;
+static unsigned int threads = 1;
+
+enum bench_mode_t { mode_percall, mode_mac, mode_verify, mode_batch };
+static bench_mode_t mode;
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// the cookie computation of earlier versions, secret has get_secret_size() byte
+static void percall_mac(uint32 gen, const uchar *data, uint32 len, uchar *out, uchar *secret) {
+	const EVP_MD *md = EVP_get_digestbyname("SHA1");
+	EVP_MD_CTX *ctx = EVP_MD_CTX_new();
+	secrets->copy_secret(gen, secret);
+
+	EVP_DigestInit_ex(ctx, md, NULL);
+	EVP_DigestUpdate(ctx, data, len);
+	EVP_DigestUpdate(ctx, secret, secrets->get_secret_size());
+	EVP_DigestFinal_ex(ctx, out, NULL);
+	EVP_MD_CTX_free(ctx);
+}
+
+
+static void *bench_thread(void *arg) {
+	unsigned long tid = (unsigned long) arg;
+	uint32 gen = secrets->get_generation_number();
+	uint32 maclen = engine->get_mac_size();
+	unsigned long failed = 0;
+
+	// a batch of different inputs and their MACs
+	std::vector<uchar> data(batch_size * input_size);
+	std::vector<uchar> macs(batch_size * EVP_MAX_MD_SIZE);
+	respcookie_engine::verify_req_t reqs[batch_size];
+	bool result[batch_size];
+	std::vector<uchar> secret(secrets->get_secret_size());
+
+	for (uint32 i = 0; i < data.size(); i++)
+		data[i] = (i * 131 + tid) & 0xff;
+	for (uint32 i = 0; i < batch_size; i++) {
+		reqs[i].gen = gen;
+		reqs[i].data = &data[i * input_size];
+		reqs[i].len = input_size;
+		reqs[i].mac = &macs[i * EVP_MAX_MD_SIZE];
+		reqs[i].maclen = maclen;
+		engine->mac(gen, reqs[i].data, input_size,
+			&macs[i * EVP_MAX_MD_SIZE]);
+	}
+
+	uchar out[EVP_MAX_MD_SIZE];
+	for (unsigned long i = 0; i < cookies; i += batch_size) {
+		switch (mode) {
+		case mode_percall:
+			for (uint32 j = 0; j < batch_size; j++)
+				percall_mac(gen, reqs[j].data, input_size, out, &secret[0]);
+			break;
+		case mode_mac:
+			for (uint32 j = 0; j < batch_size; j++)
+				if ( !engine->mac(gen, reqs[j].data, input_size, out) )
+					failed++;
+			break;
+		case mode_verify:
+			for (uint32 j = 0; j < batch_size; j++)
+				if ( !engine->verify(gen, reqs[j].data, input_size,
+						reqs[j].mac, maclen) )
+					failed++;
+			break;
+		case mode_batch:
+			failed += batch_size
+				- engine->verify_batch(reqs, batch_size, result);
+			break;
+		}
+	}
+
+	if ( failed )
+		std::cerr << "thread " << tid << ": " << failed
+			<< " cookies failed" << std::endl;
+
+	return NULL;
+}
+
+
+static void run(const char *name, bench_mode_t m) {
+	std::vector<pthread_t> tids(threads);
+
+	mode = m;
+	double start = now();
+	for (unsigned long i = 0; i < threads; i++)
+		pthread_create(&tids[i], NULL, bench_thread, (void *) i);
+	for (unsigned int i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+	double secs = now() - start;
+
+	unsigned long total = threads
+		* ((cookies + batch_size - 1) / batch_size) * batch_size;
+	std::cout << "  " << std::left << std::setw(16) << name
+		<< std::right << std::setw(10) << total / secs / 1000
+		<< " k cookies/s" << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+	if ( argc > 1 )
+		cookies = strtoul(argv[1], NULL, 10);
+	if ( argc > 2 )
+		threads = strtoul(argv[2], NULL, 10);
+
+	if ( threads == 0 || cookies == 0 ) {
+		std::cerr << "usage: " << argv[0]
+			<< " [cookies per thread] [threads]" << std::endl;
+		return 1;
+	}
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	OpenSSL_add_all_digests();
+
+	// defaults of secrets-count and secrets-length
+	secrets = new secretmanager(2, 256);
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << threads << " threads, " << input_size
+		<< " byte input" << std::endl;
+
+	const char *algorithms[] =
+		{ "SHA1", "HMAC-SHA1", "HMAC-SHA256", "SipHash" };
+
+	for (unsigned int i = 0; i < sizeof(algorithms) / sizeof(*algorithms); i++) {
+		engine = new respcookie_engine(*secrets, algorithms[i]);
+		std::cout << algorithms[i] << ":" << std::endl;
+
+		if ( i == 0 )
+			run("per call", mode_percall);
+		run("mac", mode_mac);
+		run("verify", mode_verify);
+		run("verify_batch", mode_batch);
+
+		delete engine;
+	}
+
+	delete secrets;
+
+	return 0;
+}
+
+// EOF
@@ -0,0 +1,273 @@
+/*
+ * Test the MAC algorithms of the responder cookie engine.
+ *
+ * $Id$
+ * $HeadURL$
+ */
+#include "test_suite.h"
+
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+
+#include "respcookie_engine.h"
+
+using namespace ntlp;
+
+
+namespace {
+
+struct mac_worker_arg {
+	secretmanager *secrets;
+	respcookie_engine *engine;
+	const uchar *data;
+	bool stop;
+	unsigned long macs;
+	unsigned long mismatches;
+};
+
+/*
+ * Computes MACs with the current generation while it is rolled over and
+ * compares them to HMAC() keyed with the secret of that generation.
+ */
+void *mac_worker(void *p) {
+	mac_worker_arg *arg = static_cast<mac_worker_arg *>(p);
+	uchar secret[32];
+	uchar mac[EVP_MAX_MD_SIZE];
+	uchar expected[EVP_MAX_MD_SIZE];
+	unsigned int len = 0;
+
+	while ( !__atomic_load_n(&arg->stop, __ATOMIC_ACQUIRE) ) {
+		uint32 gen = arg->secrets->get_generation_number();
+
+		if ( !arg->engine->mac(gen, arg->data, 64, mac) )
+			continue;
+		// gone meanwhile, the MAC cannot be checked anymore
+		if ( !arg->secrets->copy_secret(gen, secret) )
+			continue;
+
+		HMAC(EVP_sha256(), secret, arg->secrets->get_secret_size(),
+			arg->data, 64, expected, &len);
+		arg->macs++;
+		if ( memcmp(mac, expected, len) != 0 )
+			arg->mismatches++;
+	}
+
+	return NULL;
+}
+
+}
+
+
+class respcookie_engine_test : public CppUnit::TestCase {
+
+  CPPUNIT_TEST_SUITE( respcookie_engine_test );
+
+  CPPUNIT_TEST( test_siphash );
+  CPPUNIT_TEST( test_hmac );
+  CPPUNIT_TEST( test_algorithms );
+  CPPUNIT_TEST( test_rollover );
+  CPPUNIT_TEST( test_batch );
+  CPPUNIT_TEST( test_concurrent_rollover );
+  // Add more tests here.
+
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void setUp() {
+		OpenSSL_add_all_digests();
+		for (unsigned int i = 0; i < sizeof(data); i++)
+			data[i] = i;
+	}
+
+	void test_siphash() {
+		uchar key[16];
+		uchar out[16];
+		for (unsigned int i = 0; i < sizeof(key); i++)
+			key[i] = i;
+
+		// test vector of the SipHash paper, message 00 01 .. 0e
+		respcookie_engine::siphash24(key, data, 15, out, 8);
+		const uchar expected[8] =
+			{ 0xe5, 0x45, 0xbe, 0x49, 0x61, 0xca, 0x29, 0xa1 };
+		CPPUNIT_ASSERT( memcmp(out, expected, 8) == 0 );
+
+		// empty message, 128 bit output of the reference implementation
+		respcookie_engine::siphash24(key, data, 0, out, 16);
+		const uchar expected128[16] =
+			{ 0xa3, 0x81, 0x7f, 0x04, 0xba, 0x25, 0xa8, 0xe6,
+			  0x6d, 0xf6, 0x72, 0x14, 0xc7, 0x55, 0x02, 0x93 };
+		CPPUNIT_ASSERT( memcmp(out, expected128, 16) == 0 );
+	}
+
+	void test_hmac() {
+		secretmanager secrets(2, 256);
+		respcookie_engine engine(secrets, "HMAC-SHA256");
+		uint32 gen = secrets.get_generation_number();
+		uchar secret[32];
+		uchar mac[EVP_MAX_MD_SIZE];
+		uchar expected[EVP_MAX_MD_SIZE];
+		unsigned int len = 0;
+
+		CPPUNIT_ASSERT( secrets.copy_secret(gen, secret) );
+
+		CPPUNIT_ASSERT_EQUAL( 32U, engine.get_mac_size() );
+
+		// the precomputed contexts must give the same result as HMAC()
+		for (uint32 n = 0; n < sizeof(data); n += 37) {
+			CPPUNIT_ASSERT( engine.mac(gen, data, n, mac) );
+			HMAC(EVP_sha256(), secret, secrets.get_secret_size(),
+				data, n, expected, &len);
+			CPPUNIT_ASSERT_EQUAL( 32U, len );
+			CPPUNIT_ASSERT( memcmp(mac, expected, len) == 0 );
+		}
+	}
+
+	void test_algorithms() {
+		check_algorithm("SHA1", respcookie_engine::algo_digest, 20);
+		check_algorithm("HMAC-SHA1", respcookie_engine::algo_hmac, 20);
+		check_algorithm("hmac-sha256", respcookie_engine::algo_hmac, 32);
+		check_algorithm("SipHash", respcookie_engine::algo_siphash, 16);
+	}
+
+	void test_rollover() {
+		secretmanager secrets(2, 128);
+		respcookie_engine engine(secrets, "SipHash");
+		uchar mac[16];
+		uchar mac2[16];
+
+		uint32 gen = secrets.get_generation_number();
+		CPPUNIT_ASSERT( engine.mac(gen, data, sizeof(data), mac) );
+
+		// the previous generation is still accepted after one rollover
+		secrets.forward();
+		CPPUNIT_ASSERT( engine.verify(gen, data, sizeof(data), mac, 16) );
+		CPPUNIT_ASSERT( engine.mac(secrets.get_generation_number(),
+			data, sizeof(data), mac2) );
+		CPPUNIT_ASSERT( memcmp(mac, mac2, 16) != 0 );
+
+		// but not after the second one, although its state is cached
+		secrets.forward();
+		CPPUNIT_ASSERT( !engine.verify(gen, data, sizeof(data), mac, 16) );
+		CPPUNIT_ASSERT( !engine.mac(gen, data, sizeof(data), mac2) );
+		CPPUNIT_ASSERT( !engine.mac(gen + 7, data, sizeof(data), mac2) );
+	}
+
+	void test_batch() {
+		const uint32 n = 8;
+		secretmanager secrets(4, 256);
+		respcookie_engine engine(secrets, "HMAC-SHA1");
+		uchar mac[n][EVP_MAX_MD_SIZE];
+		respcookie_engine::verify_req_t reqs[n];
+		bool result[n];
+
+		uint32 old_gen = secrets.get_generation_number();
+		secrets.forward();
+		uint32 gen = secrets.get_generation_number();
+
+		for (uint32 i = 0; i < n; i++) {
+			reqs[i].gen = (i % 3 == 0) ? old_gen : gen;
+			reqs[i].data = data + i;
+			reqs[i].len = 64;
+			reqs[i].mac = mac[i];
+			reqs[i].maclen = engine.get_mac_size();
+			CPPUNIT_ASSERT( engine.mac(reqs[i].gen, reqs[i].data,
+				reqs[i].len, mac[i]) );
+		}
+
+		CPPUNIT_ASSERT_EQUAL( n, engine.verify_batch(reqs, n, result) );
+		for (uint32 i = 0; i < n; i++)
+			CPPUNIT_ASSERT( result[i] );
+
+		// tampered MAC, wrong generation, truncated MAC
+		mac[1][3] ^= 0x40;
+		reqs[2].gen = gen + 1;
+		reqs[4].maclen--;
+		CPPUNIT_ASSERT_EQUAL( n - 3, engine.verify_batch(reqs, n, result) );
+		CPPUNIT_ASSERT( !result[1] && !result[2] && !result[4] );
+		CPPUNIT_ASSERT( result[0] && result[3] && result[7] );
+
+		// generations not prepared yet are handled as well
+		respcookie_engine fresh(secrets, "HMAC-SHA1");
+		CPPUNIT_ASSERT_EQUAL( n - 3, fresh.verify_batch(reqs, n, result) );
+	}
+
+	void test_concurrent_rollover() {
+		const unsigned int threads = 4;
+		secretmanager secrets(4, 256);
+		respcookie_engine engine(secrets, "HMAC-SHA256");
+		pthread_t tid[threads];
+		mac_worker_arg args[threads];
+
+		for (unsigned int i = 0; i < threads; i++) {
+			mac_worker_arg arg = { &secrets, &engine, data, false, 0, 0 };
+			args[i] = arg;
+			pthread_create(&tid[i], NULL, mac_worker, &args[i]);
+		}
+
+		// the state of a new generation is prepared by the rollover
+		for (unsigned int i = 0; i < 500; i++) {
+			engine.forward();
+			sched_yield();
+		}
+
+		for (unsigned int i = 0; i < threads; i++) {
+			__atomic_store_n(&args[i].stop, true, __ATOMIC_RELEASE);
+			pthread_join(tid[i], NULL);
+			CPPUNIT_ASSERT_EQUAL( 0UL, args[i].mismatches );
+		}
+
+		uint32 gen = secrets.get_generation_number();
+		uchar mac[EVP_MAX_MD_SIZE];
+		CPPUNIT_ASSERT( engine.mac(gen, data, sizeof(data), mac) );
+		CPPUNIT_ASSERT( engine.verify(gen, data, sizeof(data), mac,
+			engine.get_mac_size()) );
+		CPPUNIT_ASSERT( !engine.mac(gen - 4, data, sizeof(data), mac) );
+	}
+
+  private:
+	void check_algorithm(const char *name, respcookie_engine::algo_t algo,
+			uint32 size) {
+		secretmanager secrets(2, 256);
+		respcookie_engine engine(secrets, name);
+		uint32 gen = secrets.get_generation_number();
+		uchar mac[EVP_MAX_MD_SIZE];
+		uchar mac2[EVP_MAX_MD_SIZE];
+
+		CPPUNIT_ASSERT_EQUAL( algo, engine.get_algorithm() );
+		CPPUNIT_ASSERT_EQUAL( size, engine.get_mac_size() );
+
+		CPPUNIT_ASSERT( engine.mac(gen, data, sizeof(data), mac) );
+		CPPUNIT_ASSERT( engine.verify(gen, data, sizeof(data), mac, size) );
+		// deterministic
+		CPPUNIT_ASSERT( engine.mac(gen, data, sizeof(data), mac2) );
+		CPPUNIT_ASSERT( memcmp(mac, mac2, size) == 0 );
+
+		// every input byte counts
+		data[17] ^= 1;
+		CPPUNIT_ASSERT( !engine.verify(gen, data, sizeof(data), mac, size) );
+		data[17] ^= 1;
+		CPPUNIT_ASSERT( !engine.verify(gen, data, sizeof(data) - 1, mac, size) );
+
+		mac[size - 1] ^= 0x80;
+		CPPUNIT_ASSERT( !engine.verify(gen, data, sizeof(data), mac, size) );
+		mac[size - 1] ^= 0x80;
+		CPPUNIT_ASSERT( !engine.verify(gen, data, sizeof(data), mac, size - 1) );
+
+		// the MAC depends on the secret
+		secretmanager other(2, 256);
+		respcookie_engine engine2(other, name);
+		CPPUNIT_ASSERT( engine2.mac(other.get_generation_number(), data,
+			sizeof(data), mac2) );
+		CPPUNIT_ASSERT( memcmp(mac, mac2, size) != 0 );
+	}
+
+	uchar data[200];
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( respcookie_engine_test );
+
+// EOF
@@ -171,12 +171,15 @@ private:
 
 	void test_secret_manager() {
 
+		uint32 secretsize= secrets.get_secret_size();
+		std::vector<uchar> current_secret(secretsize);
+		std::vector<uchar> previous_secret(secretsize);
+		std::vector<uchar> new_secret(secretsize);
+
 		uint32 current_generation_number= secrets.get_generation_number();
 
-		uchar* current_secret1= secrets.get_secret();
-		uchar* current_secret2= secrets.get_secret(current_generation_number);
-		
-		CPPUNIT_ASSERT (current_secret1 == current_secret2 );
+		CPPUNIT_ASSERT (secrets.is_valid(current_generation_number));
+		CPPUNIT_ASSERT (secrets.copy_secret(current_generation_number, &current_secret[0]));
 
 		uint32 old_generation_number= current_generation_number;
 
@@ -184,15 +187,17 @@ private:
 		secrets.forward();
 
 		// old secret should be still available!
-		uchar* previous_secret= secrets.get_secret(old_generation_number);
-		CPPUNIT_ASSERT (previous_secret == current_secret2 );
+		CPPUNIT_ASSERT (secrets.copy_secret(old_generation_number, &previous_secret[0]));
+		CPPUNIT_ASSERT (previous_secret == current_secret );
 		
 		// new secret should also work
 		current_generation_number= secrets.get_generation_number();
-		current_secret1= secrets.get_secret();
-		current_secret2= secrets.get_secret(current_generation_number);
+		CPPUNIT_ASSERT (current_generation_number == old_generation_number + 1);
+		CPPUNIT_ASSERT (secrets.copy_secret(current_generation_number, &new_secret[0]));
+		CPPUNIT_ASSERT (new_secret != current_secret );
 
-		CPPUNIT_ASSERT (current_secret1 == current_secret2 );
+		// a generation that was rolled over is gone
+		CPPUNIT_ASSERT (!secrets.is_valid(old_generation_number - secrets.get_table_size() + 1));
 	}
 
 	void test_resp_cookie() {
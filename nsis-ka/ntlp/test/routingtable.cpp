@@ -0,0 +1,164 @@
+/*
+ * Test the routing table and its MRI index.
+ *
+ * $Id$
+ * $HeadURL$
+ */
+#include "test_suite.h"
+
+#include "routingtable.h"
+#include "mri_pc.h"
+#include "gist_conf.h"
+
+using namespace ntlp;
+
+
+class routingtable_test : public CppUnit::TestCase {
+
+  CPPUNIT_TEST_SUITE( routingtable_test );
+
+  CPPUNIT_TEST( test_lookup );
+  CPPUNIT_TEST( test_state_lifetime );
+  CPPUNIT_TEST( test_invalidate );
+  CPPUNIT_TEST( test_invalidate_session );
+  // Add more tests here.
+
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void setUp() {
+		// routing entries use the retry parameters
+		gconf.repository_init();
+		gconf.setRepository();
+
+		flow1 = new mri_pathcoupled(hostaddress("10.0.0.1"), 32,
+			hostaddress("10.0.0.2"), 32, true);
+		flow2 = new mri_pathcoupled(hostaddress("10.0.0.1"), 32,
+			hostaddress("10.0.0.3"), 32, true);
+	}
+
+	void tearDown() {
+		delete flow1;
+		delete flow2;
+	}
+
+	void test_lookup() {
+		routingtable rt;
+		routingkey *key = make_key(flow1, 1, 100);
+
+		CPPUNIT_ASSERT( !rt.exists(key) );
+		rt.add(key, new routingentry(false));
+		CPPUNIT_ASSERT( rt.exists(key) );
+		CPPUNIT_ASSERT_EQUAL( 1U, rt.size() );
+
+		// lookup with an equal key, but different objects
+		routingkey *key2 = make_key(flow1, 1, 100);
+		routingentry *entry = rt.lookup(key2);
+		CPPUNIT_ASSERT( entry != NULL );
+		// entry is locked now
+		CPPUNIT_ASSERT( rt.lookup(key2) == NULL );
+		rt.unlock(key2);
+		CPPUNIT_ASSERT( rt.lookup(key2) == entry );
+
+		CPPUNIT_ASSERT( rt.destroy_entry(key2) );
+		CPPUNIT_ASSERT( !rt.exists(key) );
+		CPPUNIT_ASSERT_EQUAL( 0U, rt.size() );
+		delete entry;
+		free_key(key);
+	}
+
+	void test_state_lifetime() {
+		routingtable rt;
+		routingkey *key1 = make_key(flow1, 1, 100);
+		routingkey *key2 = make_key(flow1, 2, 100);
+		routingkey *key3 = make_key(flow2, 3, 100);
+		routingkey *key4 = make_key(flow1, 4, 200);
+
+		rt.add(key1, new routingentry(false));
+		rt.add(key2, new routingentry(false));
+		rt.add(key3, new routingentry(false));
+		rt.add(key4, new routingentry(false));
+
+		rt.set_state_lifetime(flow1, 100, 4711);
+
+		CPPUNIT_ASSERT_EQUAL( 4711U, get_lifetime(rt, key1) );
+		CPPUNIT_ASSERT_EQUAL( 4711U, get_lifetime(rt, key2) );
+		CPPUNIT_ASSERT( get_lifetime(rt, key3) != 4711U );
+		CPPUNIT_ASSERT( get_lifetime(rt, key4) != 4711U );
+	}
+
+	void test_invalidate() {
+		routingtable rt;
+		routingkey *key1 = make_key(flow1, 1, 100);
+		routingkey *key2 = make_key(flow1, 2, 100);
+		routingkey *key3 = make_key(flow2, 3, 100);
+
+		rt.add(key1, new routingentry(false));
+		rt.add(key2, new routingentry(false));
+		rt.add(key3, new routingentry(false));
+
+		// remove the first key, the MRI index must not depend on its MRI
+		routingentry *entry = rt.lookup(key1);
+		CPPUNIT_ASSERT( rt.delete_entry(key1) );
+		delete entry;
+		free_key(key1);
+		CPPUNIT_ASSERT_EQUAL( 2U, rt.size() );
+
+		rt.invalidate_routing_state(flow1, 100, APIMsg::bad, false);
+		CPPUNIT_ASSERT( !rt.exists(key2) );
+		CPPUNIT_ASSERT( rt.exists(key3) );
+		CPPUNIT_ASSERT_EQUAL( 1U, rt.size() );
+
+		rt.invalidate_routing_state(flow2, 100, APIMsg::bad, false);
+		CPPUNIT_ASSERT( !rt.exists(key3) );
+		CPPUNIT_ASSERT_EQUAL( 0U, rt.size() );
+	}
+
+	void test_invalidate_session() {
+		routingtable rt;
+		routingkey *key1 = make_key(flow1, 1, 100);
+		routingkey *key2 = make_key(flow1, 2, 100);
+
+		rt.add(key1, new routingentry(false));
+		rt.add(key2, new routingentry(false));
+
+		// only the session given loses its routing state
+		rt.invalidate_routing_state(*key2, APIMsg::bad, false);
+		CPPUNIT_ASSERT( rt.exists(key1) );
+		CPPUNIT_ASSERT( !rt.exists(key2) );
+		CPPUNIT_ASSERT_EQUAL( 1U, rt.size() );
+
+		vector<routingkey> keys;
+		rt.find_keys(flow1, 100, keys);
+		CPPUNIT_ASSERT_EQUAL( (size_t) 1, keys.size() );
+		CPPUNIT_ASSERT( *keys[0].sid == *key1->sid );
+		routingtable::free_keys(keys);
+	}
+
+  private:
+	mri_pathcoupled *flow1;
+	mri_pathcoupled *flow2;
+
+	routingkey *make_key(const mri *mr, uint32 sid, uint32 nslpid) {
+		return new routingkey(mr->copy(), new sessionid(sid, 0, 0, sid),
+			nslpid);
+	}
+
+	void free_key(routingkey *key) {
+		delete key->mr;
+		delete key->sid;
+		delete key;
+	}
+
+	uint32 get_lifetime(routingtable &rt, routingkey *key) {
+		routingentry *entry = rt.lookup(key);
+		CPPUNIT_ASSERT( entry != NULL );
+		uint32 lifetime = entry->get_rs_validity_time();
+		rt.unlock(key);
+		return lifetime;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( routingtable_test );
+
+// EOF
@@ -0,0 +1,181 @@
+/*
+ * test/routingtable_bench.cpp - Measure concurrent routing table access.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ * Fills a routing table with N entries (four sessions per flow), then
+ * T threads look up and unlock random entries of their own part of the
+ * table. Afterwards InvalidateRoutingState and SetStateLifetime are
+ * applied to random flows, which must only touch the four sessions of
+ * the flow regardless of the table size. Run as
+ *
+ *   ./routingtable_bench [entries] [threads] [lookups per thread]
+ */
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+
+#include "logfile.h"
+#include "threadsafe_db.h"
+#include "routingtable.h"
+#include "mri_pc.h"
+#include "gist_conf.h"
+
+using namespace protlib;
+using namespace protlib::log;
+using namespace ntlp;
+
+// needed for linking
+logfile commonlog("", false, true);
+logfile &protlib::log::DefaultLog(commonlog);
+
+namespace ntlp {
+// configuration class
+gistconf gconf;
+}
+
+
+static const unsigned int sessions_per_flow = 4;
+
+static routingtable *rt;
+static std::vector<routingkey> keys;
+static unsigned int threads = 4;
+static unsigned long lookups = 1000000;
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static mri_pathcoupled *make_flow(unsigned long i) {
+	struct in_addr src, dst;
+	src.s_addr = htonl(0x0a000000 + i);
+	dst.s_addr = htonl(0xc0a80001);
+
+	return new mri_pathcoupled(hostaddress(src), 32, hostaddress(dst), 32,
+		true);
+}
+
+
+static void *lookup_thread(void *arg) {
+	unsigned long tid = (unsigned long) arg;
+	unsigned int seed = tid;
+	unsigned long failed = 0;
+
+	// every thread uses its own entries, so they are never found locked
+	unsigned long per_thread = keys.size() / threads;
+
+	for (unsigned long i = 0; i < lookups; i++) {
+		routingkey *key = &keys[tid + (rand_r(&seed) % per_thread) * threads];
+
+		if ( rt->lookup(key) != NULL )
+			rt->unlock(key);
+		else
+			failed++;
+	}
+
+	if ( failed )
+		std::cerr << "thread " << tid << ": " << failed
+			<< " lookups failed" << std::endl;
+
+	return NULL;
+}
+
+
+int main(int argc, char *argv[]) {
+	unsigned long entries = 1000000;
+
+	if ( argc > 1 )
+		entries = strtoul(argv[1], NULL, 10);
+	if ( argc > 2 )
+		threads = strtoul(argv[2], NULL, 10);
+	if ( argc > 3 )
+		lookups = strtoul(argv[3], NULL, 10);
+
+	if ( threads == 0 || entries < threads ) {
+		std::cerr << "usage: " << argv[0]
+			<< " [entries] [threads] [lookups per thread]"
+			<< std::endl;
+		return 1;
+	}
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	tsdb::init();
+	gconf.repository_init();
+	gconf.setRepository();
+
+	rt = new routingtable();
+	std::cout << std::fixed << std::setprecision(2);
+
+	// fill the table
+	unsigned long flows = (entries + sessions_per_flow - 1) / sessions_per_flow;
+	std::vector<mri *> flow(flows);
+	for (unsigned long i = 0; i < flows; i++)
+		flow[i] = make_flow(i);
+
+	keys.reserve(entries);
+	for (unsigned long i = 0; i < entries; i++) {
+		sessionid *sid = new sessionid();
+		sid->generate_random();
+		keys.push_back(routingkey(flow[i / sessions_per_flow], sid, 1));
+	}
+
+	double start = now();
+	for (unsigned long i = 0; i < entries; i++)
+		rt->add(&keys[i], new routingentry(false));
+	double secs = now() - start;
+
+	std::cout << "added " << rt->size() << " entries: "
+		<< entries / secs / 1000 << " k/s" << std::endl;
+
+	// concurrent lookups
+	std::vector<pthread_t> tids(threads);
+	start = now();
+	for (unsigned long i = 0; i < threads; i++)
+		pthread_create(&tids[i], NULL, lookup_thread, (void *) i);
+	for (unsigned int i = 0; i < threads; i++)
+		pthread_join(tids[i], NULL);
+	secs = now() - start;
+
+	std::cout << threads << " threads, lookup+unlock: "
+		<< threads * lookups / secs / 1000000 << " M/s" << std::endl;
+
+	// operations on all sessions of a flow
+	const unsigned int rounds = 10000;
+	unsigned int seed = 1;
+
+	start = now();
+	for (unsigned int i = 0; i < rounds; i++)
+		rt->set_state_lifetime(flow[rand_r(&seed) % flows], 1, 30000);
+	secs = now() - start;
+	std::cout << "SetStateLifetime: " << secs / rounds * 1e6
+		<< " us per flow" << std::endl;
+
+	start = now();
+	for (unsigned int i = 0; i < rounds; i++)
+		rt->invalidate_routing_state(flow[rand_r(&seed) % flows], 1,
+			APIMsg::tentative, false);
+	secs = now() - start;
+	std::cout << "InvalidateRoutingState: " << secs / rounds * 1e6
+		<< " us per flow" << std::endl;
+
+	tsdb::end();
+
+	return 0;
+}
+
+// EOF
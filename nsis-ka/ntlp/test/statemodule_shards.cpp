@@ -0,0 +1,104 @@
+/*
+ * Test the assignment of sessions to the shards of the state module.
+ *
+ * $Id$
+ * $HeadURL$
+ */
+#include "test_suite.h"
+
+#include <vector>
+
+#include "ntlp_statemodule.h"
+#include "routingtable.h"
+#include "mri_pc.h"
+
+using namespace ntlp;
+
+
+class statemodule_shards_test : public CppUnit::TestCase {
+
+  CPPUNIT_TEST_SUITE( statemodule_shards_test );
+
+  CPPUNIT_TEST( test_unsharded );
+  CPPUNIT_TEST( test_session );
+  CPPUNIT_TEST( test_spread );
+  CPPUNIT_TEST( test_messages );
+  // Add more tests here.
+
+  CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void test_unsharded() {
+		sessionid sid(1, 2, 3, 4);
+
+		CPPUNIT_ASSERT_EQUAL( 0U, Statemodule::get_shard(&sid, 1, 1) );
+		CPPUNIT_ASSERT_EQUAL( 0U, Statemodule::get_shard(&sid, 1, 0) );
+		CPPUNIT_ASSERT_EQUAL( 0U, Statemodule::get_shard(NULL, 1, 8) );
+	}
+
+	void test_session() {
+		sessionid sid1(0x12345678, 0xbad00, 0xc0ffee, 0xdeadbeef);
+		sessionid sid2(0x12345678, 0xbad00, 0xc0ffee, 0xdeadbeef);
+
+		for (uint32 shards = 2; shards <= 16; shards++) {
+			uint32 s = Statemodule::get_shard(&sid1, 1, shards);
+			CPPUNIT_ASSERT( s < shards );
+			CPPUNIT_ASSERT_EQUAL( s,
+				Statemodule::get_shard(&sid2, 1, shards) );
+		}
+	}
+
+	void test_spread() {
+		const uint32 shards = 8;
+		const uint32 sessions = 8000;
+		std::vector<uint32> count(shards, 0);
+
+		for (uint32 i = 0; i < sessions; i++) {
+			sessionid sid;
+			sid.generate_random();
+			count[Statemodule::get_shard(&sid, 1, shards)]++;
+		}
+
+		// every shard gets a fair part of the sessions
+		for (uint32 i = 0; i < shards; i++)
+			CPPUNIT_ASSERT( count[i] > sessions / shards / 2 );
+	}
+
+	void test_messages() {
+		const uint32 shards = 4;
+		sessionid sid(0x12345678, 0xbad00, 0xc0ffee, 0xdeadbeef);
+		mri_pathcoupled mr(hostaddress("10.0.0.1"), 32, hostaddress("10.0.0.2"), 32, true);
+		uint32 expected = Statemodule::get_shard(&sid, 7, shards);
+
+		// API calls and the timers of the resulting routing state
+		APIMsg *apimsg = new APIMsg();
+		apimsg->set_sendmessage(NULL, 0, 7, sid.copy(), mr.copy(),
+			0, tx_attr_t(), 1000, 0, 0);
+		CPPUNIT_ASSERT_EQUAL( expected,
+			Statemodule::get_shard(apimsg, shards) );
+		delete apimsg;
+
+		routingkey rk(&mr, &sid, 7);
+		RoutingTableTimerMsg timermsg(rk, noresponse, 1, 0);
+		CPPUNIT_ASSERT_EQUAL( expected,
+			Statemodule::get_shard(&timermsg, shards) );
+
+		// InvalidateRoutingState of an NSLP applies to the MRI, passed
+		// on between the shards it is for a single session
+		APIMsg invmsg;
+		invmsg.set_invalidateroutingstate(7, mr.copy(), APIMsg::bad, false);
+		CPPUNIT_ASSERT_EQUAL( 0U, Statemodule::get_shard(&invmsg, shards) );
+		APIMsg sessioninvmsg;
+		sessioninvmsg.set_invalidateroutingstate(7, mr.copy(), APIMsg::bad, false, sid.copy());
+		CPPUNIT_ASSERT_EQUAL( expected, Statemodule::get_shard(&sessioninvmsg, shards) );
+
+		// NSLP registration does not belong to a session
+		APIMsg regmsg;
+		regmsg.set_register(7, 0);
+		CPPUNIT_ASSERT_EQUAL( 0U, Statemodule::get_shard(&regmsg, shards) );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( statemodule_shards_test );
+
+// EOF
@@ -50,6 +50,9 @@
 #include <errno.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
 
                        /**** module interface ****/
 #include "fastqueue.h"
@@ -673,5 +676,398 @@ int signal_cond(queue_t *queuehead)
     return 0;
 }
 
+static void *dequeue_element_locked(queue_t *queuehead)
+/* remove the first element, expedited elements first.
+ * the mutex must be locked and the queue must not be empty.
+ */
+{
+  void *element= NULL;
+  queue_elblock_t *blockp;
+  int exp = (queuehead->exp_nr_of_elements!=0);
+
+  blockp = (exp ? (queuehead->exp_first_block) : (queuehead->first_block));
+  if (blockp == NULL)
+  {
+    qerr(QERR_QEMPTY);
+    return NULL;
+  }
+  element= blockp->element[blockp->read];
+  blockp->read++;
+
+  if (blockp->next_block == NULL) /* this is the last block */
+  {
+    if (blockp->read == blockp->write)
+    { /* the last block always remains allocated! */
+      blockp->read=  0;
+      blockp->write= 0;
+    }
+  }
+  else if (blockp->read == ELEMENT_BLOCKSIZE)
+  { /* block was completely dequeued, remove it */
+    if (exp) queuehead->exp_first_block= blockp->next_block;
+    else queuehead->first_block= blockp->next_block;
+    free(blockp);
+  }
+  if (exp) queuehead->exp_nr_of_elements--;
+  queuehead->nr_of_elements--;
+
+  return element;
+}
+
+unsigned int dequeue_elements_timedwait(queue_t *queuehead, void **elements, unsigned int max, const struct timespec *tspec)
+/* wait for the queue to contain an element, then remove up to max
+ * elements while holding the mutex only once.
+ * returns: number of elements stored in elements, 0 on timeout or error
+ * arguments: pointer to queue_t object, array for at least max elements,
+ *            tspec is the time interval to wait (NULL: wait forever,
+ *            0: do not wait at all)
+ */
+{
+  unsigned int num= 0;
+  struct timespec abs_tspec;
+  int result;
+
+  if (queuehead == NULL)
+  {
+    qerr(QERR_QINVALID);
+    return 0;
+  }
+
+  if (pthread_mutex_lock(&queuehead->mutex)!=0)
+  {
+    qerr(QERR_MUTEXLOCK); return 0;
+  }
+
+  if (tspec)
+  {
+    clock_gettime(CLOCK_REALTIME, &abs_tspec);
+    abs_tspec.tv_nsec+= tspec->tv_nsec;
+    abs_tspec.tv_sec+= tspec->tv_sec;
+    if (abs_tspec.tv_nsec >= NSEC_PER_SEC)
+    {
+      abs_tspec.tv_nsec%= NSEC_PER_SEC;
+      abs_tspec.tv_sec++;
+    }
+  }
+
+  while(queuehead->nr_of_elements==0)
+  {
+    if (tspec && tspec->tv_sec==0 && tspec->tv_nsec==0)
+      break;
+    result= tspec ? pthread_cond_timedwait(&queuehead->cond, &queuehead->mutex, &abs_tspec)
+                  : pthread_cond_wait(&queuehead->cond, &queuehead->mutex);
+    if (result == ETIMEDOUT)
+      break;
+    if (result != 0 && result != EINTR)
+      qerr(QERR_CONDWAIT);
+  }
+
+  /* begin critical section */
+  while (num < max && queuehead->nr_of_elements != 0)
+    elements[num++]= dequeue_element_locked(queuehead);
+  /* end critical section */
+
+  if (pthread_mutex_unlock(&queuehead->mutex)!=0)
+    qerr(QERR_MUTEXUNLOCK);
+
+  return num;
+}
+
+
+/******************************************************************************
+ * ring queue -- bounded lock-free variant for many producers and exactly one *
+ * consumer. Each slot carries a sequence number: seq == pos means the slot   *
+ * is free for the producer at position pos, seq == pos+1 means it holds the  *
+ * element for the consumer at position pos.                                  *
+ ******************************************************************************/
+
+static int ring_lane_init(ring_lane_t *lane, unsigned long size)
+{
+  unsigned long i;
+
+  if ((lane->slots= (ring_slot_t *) malloc(size * sizeof(ring_slot_t)))==NULL)
+    return -1;
+  for (i= 0; i < size; i++)
+  {
+    lane->slots[i].seq= i;
+    lane->slots[i].element= NULL;
+  }
+  lane->mask= size - 1;
+  lane->head= 0;
+  lane->tail= 0;
+  return 0;
+}
+
+static int ring_lane_put(ring_lane_t *lane, void *element)
+{
+  unsigned long pos= __atomic_load_n(&lane->tail, __ATOMIC_RELAXED);
+  ring_slot_t *slot;
+  long diff;
+
+  for (;;)
+  {
+    slot= &lane->slots[pos & lane->mask];
+    diff= (long) __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - (long) pos;
+    if (diff == 0)
+    { /* slot is free, try to claim it */
+      if (__atomic_compare_exchange_n(&lane->tail, &pos, pos + 1, 1,
+                                      __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        break;
+    }
+    else if (diff < 0) /* consumer did not free this slot yet: ring full */
+      return -1;
+    else
+      pos= __atomic_load_n(&lane->tail, __ATOMIC_RELAXED);
+  }
+  slot->element= element;
+  __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+static unsigned int ring_lane_take(ring_lane_t *lane, void **elements, unsigned int max)
+{
+  unsigned int num= 0;
+  ring_slot_t *slot;
+
+  while (num < max)
+  {
+    slot= &lane->slots[lane->head & lane->mask];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != lane->head + 1)
+      break;
+    elements[num++]= slot->element;
+    __atomic_store_n(&slot->seq, lane->head + lane->mask + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&lane->head, lane->head + 1, __ATOMIC_RELEASE);
+  }
+  return num;
+}
+
+static unsigned int ring_take(ring_queue_t *ring, void **elements, unsigned int max)
+{
+  unsigned int num= ring_lane_take(&ring->lane[1], elements, max);
+  return num + ring_lane_take(&ring->lane[0], elements + num, max - num);
+}
+
+ring_queue_t *create_ring_queue(const char *name, unsigned long size)
+/* initialization routine for a ring queue.
+ * returns: NULL if an error occured, or the ring queue object
+ * arguments: name, number of slots per lane (rounded up to a power of 2)
+ */
+{
+  void *mem= NULL;
+  ring_queue_t *ring;
+  unsigned long slots= 2;
+
+  while (slots < size) slots<<= 1;
+
+  /* keep head and tail on their own cache lines */
+  if (posix_memalign(&mem, 64, sizeof(ring_queue_t))!=0)
+  {
+    qerr(QERR_NOMEM);
+    return NULL;
+  }
+  ring= (ring_queue_t *) mem;
+  ring->lane[1].slots= NULL;
+  if (ring_lane_init(&ring->lane[0], slots) < 0 || ring_lane_init(&ring->lane[1], slots) < 0)
+  {
+    qerr(QERR_NOMEM);
+    free(ring->lane[0].slots);
+    free(ring->lane[1].slots);
+    free(ring);
+    return NULL;
+  }
+  if ((ring->efd= eventfd(0, EFD_NONBLOCK))<0)
+  {
+    qerr(QERR_CONDINIT);
+    free(ring->lane[0].slots);
+    free(ring->lane[1].slots);
+    free(ring);
+    return NULL;
+  }
+  ring->exp_enabled= 0;
+  ring->waiting= 0;
+  ring->rejected= 0;
+  if (name)
+  {
+    strncpy(ring->name, name, MAX_QUEUENAME_LENGTH);
+    ring->name[MAX_QUEUENAME_LENGTH]= '\0';
+  }
+  else
+    ring->name[0]= '\0';
+
+  return ring;
+}
+
+int ring_enqueue_element_expedited_signal(ring_queue_t *ring, void *element, int exp)
+/* add a new element into the ring and wake up the consumer if it sleeps.
+ * returns: -1 if the ring is full or invalid, 0 otherwise
+ * arguments: pointer to ring_queue_t object, pointer to an element
+ */
+{
+  uint64_t one= 1;
+
+  if (ring==NULL)
+  {
+    qerr(QERR_QINVALID);
+    return -1;
+  }
+
+  exp= (exp && __atomic_load_n(&ring->exp_enabled, __ATOMIC_RELAXED)) ? 1 : 0;
+  if (ring_lane_put(&ring->lane[exp], element) < 0)
+  {
+    __atomic_add_fetch(&ring->rejected, 1, __ATOMIC_RELAXED);
+    return -1;
+  }
+
+  /* pairs with the fence in ring_dequeue_elements_timedwait(): either the
+   * consumer sees the element or we see the waiting flag. Only the producer
+   * that clears the flag needs to wake up the consumer. */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&ring->waiting, 0, __ATOMIC_RELAXED))
+  {
+    if (write(ring->efd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+      qerr(QERR_CONDSIGNAL);
+  }
+  return 0;
+}
+
+unsigned int ring_dequeue_elements_timedwait(ring_queue_t *ring, void **elements, unsigned int max, const struct timespec *tspec)
+/* remove up to max elements, expedited elements first. Must only be called
+ * by one thread at a time.
+ * returns: number of elements stored in elements, 0 on timeout or error
+ * arguments: pointer to ring_queue_t object, array for at least max elements,
+ *            tspec is the time interval to wait (NULL: wait forever,
+ *            0: do not wait at all)
+ */
+{
+  unsigned int num;
+  struct timespec now, abs_tspec;
+  struct pollfd pfd;
+  uint64_t val;
+  int timeout= -1;
+
+  if (ring==NULL)
+  {
+    qerr(QERR_QINVALID);
+    return 0;
+  }
+
+  if ((num= ring_take(ring, elements, max)) != 0)
+    return num;
+  if (tspec && tspec->tv_sec==0 && tspec->tv_nsec==0)
+    return 0;
+
+  if (tspec)
+  {
+    clock_gettime(CLOCK_REALTIME, &abs_tspec);
+    abs_tspec.tv_nsec+= tspec->tv_nsec;
+    abs_tspec.tv_sec+= tspec->tv_sec;
+    if (abs_tspec.tv_nsec >= NSEC_PER_SEC)
+    {
+      abs_tspec.tv_nsec%= NSEC_PER_SEC;
+      abs_tspec.tv_sec++;
+    }
+  }
+
+  pfd.fd= ring->efd;
+  pfd.events= POLLIN;
+  for (;;)
+  {
+    __atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if ((num= ring_take(ring, elements, max)) != 0)
+      break;
+
+    if (tspec)
+    {
+      clock_gettime(CLOCK_REALTIME, &now);
+      timeout= (abs_tspec.tv_sec - now.tv_sec) * 1000
+	+ (abs_tspec.tv_nsec - now.tv_nsec + 999999) / 1000000;
+      if (timeout <= 0)
+        break;
+    }
+    if (poll(&pfd, 1, timeout) > 0)
+      while (read(ring->efd, &val, sizeof(val)) == sizeof(val));
+    __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+
+    if ((num= ring_take(ring, elements, max)) != 0)
+      break;
+  }
+  __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+
+  return num;
+}
+
+unsigned long ring_nr_of_elements(ring_queue_t *ring)
+/** Get number of elements in the ring, may be outdated immediately. */
+{
+  unsigned long result= 0;
+  int i;
+
+  if (ring==NULL)
+  {
+    qerr(QERR_QINVALID);
+    return 0;
+  }
+  for (i= 0; i < 2; i++)
+    result+= __atomic_load_n(&ring->lane[i].tail, __ATOMIC_ACQUIRE)
+      - __atomic_load_n(&ring->lane[i].head, __ATOMIC_ACQUIRE);
+  return result;
+}
+
+int ring_enable_expedited(ring_queue_t *ring, int exp)
+/** Set exp_enabled flag and return old value. */
+{
+  if (ring==NULL)
+  {
+    qerr(QERR_QINVALID);
+    return 0;
+  }
+  return __atomic_exchange_n(&ring->exp_enabled, exp ? 1 : 0, __ATOMIC_RELAXED);
+}
+
+int ring_signal(ring_queue_t *ring)
+/** Wake up the consumer without enqueueing anything. */
+{
+  uint64_t one= 1;
+
+  if (ring==NULL)
+  {
+    qerr(QERR_QINVALID);
+    return -1;
+  }
+  if (write(ring->efd, &one, sizeof(one)) != sizeof(one) && errno != EAGAIN)
+    qerr(QERR_CONDSIGNAL);
+  return 0;
+}
+
+int destroy_ring_queue(ring_queue_t *ring)
+/* destroys the ring and frees all resources, except the elements!
+ * the ring must be empty to destroy it.
+ * returns: -1 if an error occured, 0 otherwise
+ * arguments: pointer to ring_queue_t object
+ */
+{
+  if (ring==NULL)
+  {
+    qerr(QERR_QINVALID);
+    return -1;
+  }
+  if (ring_nr_of_elements(ring) != 0)
+  {
+    qerr(QERR_QNOTEMPTY);
+    return 0;
+  }
+#ifdef QUEUELEN
+  fprintf(stderr,"queue.c: ring queue (%s) rejected %lu elements\n",
+          ring->name, ring->rejected);
+#endif
+  close(ring->efd);
+  free(ring->lane[0].slots);
+  free(ring->lane[1].slots);
+  free(ring);
+  return 0;
+}
+
 
 //@}
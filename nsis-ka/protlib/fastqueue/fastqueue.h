@@ -38,6 +38,10 @@
  * The implementations allows for arbitrary long queues, but queues grow by
  * element blocks containing ELEMENT_BLOCKSIZE elements. This avoids frequent
  * malloc/free operations.
+ *
+ * The ring queue variant is bounded and lock-free: producers claim slots
+ * with compare-and-swap, the single consumer is woken up via an eventfd
+ * only if it is actually sleeping.
  */
 
 #ifndef QUEUE_TYPE
@@ -90,6 +94,48 @@ extern unsigned long queue_nr_of_elements(queue_t *queue);
 extern int queue_is_expedited_enabled(queue_t *queue);
 extern int queue_enable_expedited(queue_t *queue, int exp);
 extern int signal_cond(queue_t *queuehead);
+extern unsigned int dequeue_elements_timedwait(queue_t *queuehead, void **elements, unsigned int max, const struct timespec *tspec);
+
+
+/* lock-free ring queue: bounded, many producers, exactly one consumer */
+
+/* ring slot, seq tells whether the slot is free or holds an element */
+typedef struct ring_slot_struct
+  {
+    unsigned long seq;
+    void *element;
+  }
+ring_slot_t;
+
+/* one lane (normal or expedited) of a ring queue */
+typedef struct ring_lane_struct
+  {
+    ring_slot_t *slots;
+    unsigned long mask;
+    /* producer and consumer positions on separate cache lines */
+    unsigned long tail __attribute__ ((aligned (64)));
+    unsigned long head __attribute__ ((aligned (64)));
+  }
+ring_lane_t;
+
+typedef struct ring_queue_struct
+  {
+    ring_lane_t lane[2];        /* lane[1] holds expedited elements */
+    int exp_enabled;
+    int efd;                    /* eventfd used to wake up the consumer */
+    int waiting;                /* set while the consumer is sleeping */
+    unsigned long rejected;     /* enqueues that failed on a full ring */
+    char name[MAX_QUEUENAME_LENGTH +1];
+  }
+ring_queue_t;
+
+extern ring_queue_t *create_ring_queue(const char *name, unsigned long size);
+extern int ring_enqueue_element_expedited_signal(ring_queue_t *ring, void *element, int exp);
+extern unsigned int ring_dequeue_elements_timedwait(ring_queue_t *ring, void **elements, unsigned int max, const struct timespec *tspec);
+extern unsigned long ring_nr_of_elements(ring_queue_t *ring);
+extern int ring_enable_expedited(ring_queue_t *ring, int exp);
+extern int ring_signal(ring_queue_t *ring);
+extern int destroy_ring_queue(ring_queue_t *ring);
 #endif
 
 //@}
@@ -35,6 +35,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <pthread.h> /* Headers for POSIX-Threads */
+#include <sched.h>
 #include <time.h>    /* needed for getting Timestamps */
 
 #include "fastqueue.h"
@@ -80,9 +81,114 @@ void *consumertask(void * argp)
   return NULL;
 }
 
+
+/*** throughput/latency benchmark: 1..N producers, one batch consumer ***/
+
+#define BENCH_ELEMENTS 200000  /* per producer */
+#define BENCH_BATCH    64
+#define BENCH_RINGSIZE 4096
+
+queue_t         *bench_q;
+ring_queue_t    *bench_ring;
+int             bench_producers;
+struct timespec *bench_stamp;   /* enqueue time per element */
+
+static double ts_diff(const struct timespec *a, const struct timespec *b)
+{
+  return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec)*1E-9;
+}
+
+void *bench_producer(void *argp)
+{
+  long first= (long) argp * BENCH_ELEMENTS + 1;
+  long i;
+
+  for (i= first; i < first + BENCH_ELEMENTS; i++)
+  {
+    clock_gettime(CLOCK_MONOTONIC, &bench_stamp[i]);
+    if (bench_ring)
+    { /* ring is bounded, retry if full */
+      while (ring_enqueue_element_expedited_signal(bench_ring, (void *) i, 0) < 0)
+        sched_yield();
+    }
+    else
+      enqueue_element_signal(bench_q, (void *) i);
+  }
+  return NULL;
+}
+
+void *bench_consumer(void *argp)
+{
+  void *batch[BENCH_BATCH];
+  long total= (long) bench_producers * BENCH_ELEMENTS;
+  long received= 0;
+  double latency= 0, maxlatency= 0, l;
+  struct timespec now;
+  unsigned int n, k;
+
+  while (received < total)
+  {
+    n= bench_ring ? ring_dequeue_elements_timedwait(bench_ring, batch, BENCH_BATCH, NULL)
+                  : dequeue_elements_timedwait(bench_q, batch, BENCH_BATCH, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    for (k= 0; k < n; k++)
+    {
+      l= ts_diff(&bench_stamp[(long) batch[k]], &now);
+      latency+= l;
+      if (l > maxlatency) maxlatency= l;
+    }
+    received+= n;
+  }
+  fprintf(stderr,"  avg latency %.2fus, max latency %.2fus\n",
+          latency/total*1E6, maxlatency*1E6);
+  return NULL;
+}
+
+void bench_run(int producers, int use_ring)
+{
+  pthread_t cons, prod[producers];
+  struct timespec start, end;
+  long p;
+  double secs;
+
+  bench_producers= producers;
+  bench_stamp= calloc((long) producers * BENCH_ELEMENTS + 1, sizeof(struct timespec));
+  if (use_ring)
+    bench_ring= create_ring_queue("benchring", BENCH_RINGSIZE);
+  else
+    bench_q= create_queue("benchqueue");
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  pthread_create(&cons, NULL, bench_consumer, NULL);
+  for (p= 0; p < producers; p++)
+    pthread_create(&prod[p], NULL, bench_producer, (void *) p);
+  for (p= 0; p < producers; p++)
+    pthread_join(prod[p], NULL);
+  pthread_join(cons, NULL);
+  clock_gettime(CLOCK_MONOTONIC, &end);
+
+  secs= ts_diff(&start, &end);
+  fprintf(stderr,"%s, %d producer(s): %ld elements in %gs, %.0f elements/s\n",
+          use_ring ? "ring queue " : "mutex queue", producers,
+          (long) producers * BENCH_ELEMENTS, secs, producers * BENCH_ELEMENTS / secs);
+
+  if (use_ring)
+  {
+    destroy_ring_queue(bench_ring);
+    bench_ring= NULL;
+  }
+  else
+  {
+    destroy_queue(bench_q);
+    bench_q= NULL;
+  }
+  free(bench_stamp);
+}
+
 int
 main(int argc, char **argv)
 {
+  int producers, maxproducers= (argc > 1) ? atoi(argv[1]) : 4;
   void *exit_value;        /* for pthread_join */
 
   fprintf(stderr,"<program start>\n");
@@ -113,6 +219,12 @@ main(int argc, char **argv)
   status= destroy_queue(consumer_cmdq);
   error_check(status,"destroying consumer queue");
 
+  for (producers= 1; producers <= maxproducers; producers++)
+  {
+    bench_run(producers, 0);
+    bench_run(producers, 1);
+  }
+
   fprintf(stderr,"<program exited normally>\n");
    return 0;
 }
@@ -59,13 +59,18 @@ class message;
  * This is a fast and thread-safe message queue with expedited data
  * support. It is an object oriented wrapper around fastqueue.c.
  * The queue grows dynamically and has no built-in entry limit.
+ *
+ * If a ring size is given, the lock-free ring queue of fastqueue.c is
+ * used instead. It holds at most ring size normal plus ring size expedited
+ * messages and enqueue() fails if it is full. Any number of threads may
+ * enqueue, but only one thread may dequeue from a ring queue.
  */
 class FastQueue {
 public:
 	/// FastQueue error
 	class FQError{};
 	/// constructor
-	FastQueue(const char *qname = 0, bool exp = false);
+	FastQueue(const char *qname = 0, bool exp = false, unsigned long ringsize = 0);
 	/// destructor
 	~FastQueue();
 	/// enqueue message
@@ -76,6 +81,10 @@ public:
 	message *dequeue_timedwait(const struct timespec &tspec);
 	/// dequeue message, timed wait
 	message *dequeue_timedwait(const long int msec);
+	/// dequeue up to n messages at once
+	unsigned int dequeue_batch(message **msgs, unsigned int n, bool blocking = true);
+	/// dequeue up to n messages at once, timed wait
+	unsigned int dequeue_batch_timedwait(message **msgs, unsigned int n, const long int msec);
 	/// signal condition
 	void signal_queue();
 	/// is queue empty
@@ -92,9 +101,15 @@ public:
 	unsigned long cleanup();
 	/// Return the name of the queue.
 	const char* get_name() const { return queue_name.c_str(); }
+	/// is this a lock-free ring queue
+	bool is_ring() const { return ring != NULL; }
+	/// get number of messages rejected because the ring was full
+	unsigned long get_rejected() const { return ring ? ring->rejected : 0; }
 private:
 	/// C fastqueue
 	queue_t *queue;
+	/// C ring queue, used instead of queue if not NULL
+	ring_queue_t *ring;
 	/// name of the queue, also stored in the queue_t
 	string queue_name;
 	/// accept or reject messages
@@ -121,6 +136,13 @@ inline
 message *
 FastQueue::dequeue(bool blocking)
 {
+  if (ring)
+  {
+    void *element = NULL;
+    static const struct timespec nowait = {0,0};
+    ring_dequeue_elements_timedwait(ring, &element, 1, blocking ? NULL : &nowait);
+    return static_cast<message*>(element);
+  }
   return static_cast<message*>(blocking ? 
 			       dequeue_element_wait(queue) :
 			       dequeue_element_nonblocking(queue));
@@ -140,9 +162,40 @@ inline
 message *
 FastQueue::dequeue_timedwait(const struct timespec& tspec)
 {
+  if (ring)
+  {
+    void *element = NULL;
+    ring_dequeue_elements_timedwait(ring, &element, 1, &tspec);
+    return (message*)element;
+  }
   return (message*)dequeue_element_timedwait(queue, &tspec);
 }
 
+
+/**
+ * Remove up to n messages from the queue with a single lock operation
+ * (or none at all for a ring queue).
+ *
+ * Expedited messages are returned first, as with dequeue(). If blocking is
+ * set, wait until at least one message is available.
+ *
+ * @param msgs array for at least n messages
+ * @param n maximum number of messages to dequeue
+ * @param blocking if true, block until a message arrives
+ *
+ * @return the number of messages stored in msgs
+ */
+inline
+unsigned int
+FastQueue::dequeue_batch(message **msgs, unsigned int n, bool blocking)
+{
+  static const struct timespec nowait = {0,0};
+  const struct timespec *tspec = blocking ? NULL : &nowait;
+  return ring ?
+    ring_dequeue_elements_timedwait(ring, (void**)msgs, n, tspec) :
+    dequeue_elements_timedwait(queue, (void**)msgs, n, tspec);
+}
+
 //@}
 
 } // end namespace protlib
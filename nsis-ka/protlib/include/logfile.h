@@ -41,6 +41,9 @@
 
 #include "protlib_types.h"
 
+// lock-free ring queue of fastqueue.c, used by the asynchronous mode
+struct ring_queue_struct;
+
 namespace protlib {
 
   using namespace std;
@@ -188,6 +191,18 @@ extern volatile unsigned int stack_length;
 
 #endif
 
+/** The log file.
+ *
+ * In synchronous mode (the default) logstart() locks the log stream and
+ * logend() writes the record and unlocks it again.
+ *
+ * In asynchronous mode each thread formats its records into a buffer of
+ * its own and logend() pushes the record into a lock-free ring. A writer
+ * thread takes the records from the ring in batches and writes them with
+ * a single flush per batch. If the ring is full, records are dropped and
+ * counted, except for error records, which are written synchronously.
+ * The mode can be switched at any time with set_async().
+ */
 class logfile 
 {
  private:
@@ -199,7 +214,35 @@ class logfile
   bool usecolors;
   bool quiet_start;
 
-  const char* timenow();
+  /// size of a buffer for timenow()
+  static const unsigned int timestr_size= 32;
+  const char* timenow(char* timestr);
+
+  /// records are queued in ring (read without lock)
+  bool async;
+  /// ring of records (malloc()ed strings) for the writer thread
+  struct ring_queue_struct* ring;
+  /// protects switching between the modes
+  pthread_mutex_t asyncmutex;
+  pthread_t writer_thread;
+  bool writer_running;
+  bool writer_stop;
+  /// number of records dropped because the ring was full
+  unsigned long dropped;
+  /// number of records between logstart() and logend() that go into the ring
+  unsigned long async_records;
+  /// per thread record buffers of the asynchronous mode
+  pthread_key_t thread_key;
+  /// thread_key is usable (read without lock)
+  bool thread_key_valid;
+
+  void write_header(ostream& os, logclass_t logclass, loglevel_t severity_level, const string& modname);
+  void enqueue(const char* record, size_t length, logclass_t logclass);
+  void write_records(void** records, unsigned int n);
+  void drain();
+  void release_async();
+  static void* writer_starter(void* argp);
+  void writer();
 
  public:
  
@@ -220,6 +263,16 @@ class logfile
   void coloroff() { usecolors=false; for (int i= 0; i<num_colors; i++) {color[i]= ""; } } 
 
   void logend();
+
+  /// switch between synchronous and asynchronous mode
+  bool set_async(bool on, unsigned long ringsize= default_ring_size);
+  /// is the asynchronous mode active
+  bool is_async() const { return __atomic_load_n(&async, __ATOMIC_ACQUIRE); }
+  /// number of records dropped in asynchronous mode
+  unsigned long get_dropped() const { return __atomic_load_n(&dropped, __ATOMIC_RELAXED); }
+
+  /// default number of records the ring of the asynchronous mode can hold
+  static const unsigned long default_ring_size= 8192;
 }; // end class logfile
 
 extern 
@@ -229,11 +282,22 @@ logfile::logfile(const char* filename,  bool usecolors, bool quietstart)
   : logstream(0), 
     logmutex(initlogmutex), 
     usecolors(usecolors),
-    quiet_start(quietstart)
+    quiet_start(quietstart),
+    async(false),
+    ring(0),
+    writer_running(false),
+    writer_stop(false),
+    dropped(0),
+    async_records(0),
+    thread_key_valid(false)
 {
+  char timestr[timestr_size];
+
   for (int i= 0; i< LOG_TYPES; i++)
     logfilter[i]= LOG_ALL;
 
+  pthread_mutex_init(&asyncmutex, NULL);
+
   if (strlen(filename))
     logstream= new(nothrow) ofstream(filename);
   else
@@ -256,7 +320,7 @@ logfile::logfile(const char* filename,  bool usecolors, bool quietstart)
 
     if (!quiet_start && logstream)
     {
-      (*logstream) << color[blue] << timenow() 
+      (*logstream) << color[blue] << timenow(timestr) 
 		   << '[' << getpid() << "] >>>>>>>>>>>>>>>>>>>>>>>> *** LOG START *** >>>>>>>>>>>>>>>>>>>>>>>>" 
 		   << color[off] << endl;
     }
@@ -268,12 +332,17 @@ logfile::logfile(const char* filename,  bool usecolors, bool quietstart)
 inline
 logfile::~logfile()
 {
+  char timestr[timestr_size];
+
+  // write all queued records
+  release_async();
+
   if (logstream)
   {
     pthread_mutex_lock(&logmutex); 
 
     if ( ! quiet_start )
-	(*logstream) << color[blue] << timenow() << '[' << getpid()
+	(*logstream) << color[blue] << timenow(timestr) << '[' << getpid()
 	<< "] <<<<<<<<<<<<<<<<<<<<<<<< *** LOG  STOP *** <<<<<<<<<<<<<<<<<<<<<<<<" 
 	<< color[off] << endl;
     pthread_mutex_unlock(&logmutex); 
@@ -309,36 +378,26 @@ logfile::should_log(logclass_t logclass, loglevel_t severity_level)
 
 
 /**
- * returns current time in static char array
- * @return pointer to static character array that contains current time
+ * writes current time into timestr
+ * @param timestr buffer of at least timestr_size characters
+ * @return timestr
  */
 inline
-const char* logfile::timenow()
+const char* logfile::timenow(char* timestr)
 {
-  static time_t t;
-  static struct timeval now;
-  static char timestr[32]= "";
-  static char msecstr[6];
+  time_t t;
+  struct timeval now;
+  struct tm tm_now;
+  char msecstr[6];
 
   gettimeofday(&now,NULL);
   t= now.tv_sec;
-  strftime(timestr, sizeof(timestr)-sizeof(msecstr), "%Y-%m-%d %H:%M:%S.", localtime(&t));
+  strftime(timestr, timestr_size-sizeof(msecstr), "%Y-%m-%d %H:%M:%S.", localtime_r(&t, &tm_now));
   snprintf(msecstr,sizeof(msecstr),"%03lu",now.tv_usec/1000UL);
   strcat(timestr,msecstr);
   return timestr;
 }
 
-inline
-void logfile::logend() 
-{ 
-  if (logstream) 
-  { 
-    (*logstream) << color[off] << endl; 
-  }
-
-  pthread_mutex_unlock(&logmutex); 
-}
-
 
 extern logfile& DefaultLog;
 //@}
@@ -71,9 +71,33 @@ private:
 	static const char* const errstr[];
 }; // end NetMsgError
 
+/// reference counted buffer of the NetMsg buffer pool, see network_message.cpp
+struct netmsg_buffer;
+
+/// statistics of the NetMsg buffer pool
+struct netmsg_pool_stats_t {
+	/// buffers taken from a free list of the pool
+	uint64 hits;
+	/// buffers allocated from the heap
+	uint64 misses;
+	/// buffers put back into a free list
+	uint64 returned;
+	/// buffers freed because the free list was full or the buffer too large
+	uint64 freed;
+	/// NetMsgs that share the buffer of another NetMsg instead of copying it
+	uint64 shared;
+};
+
 /// network message
 /** This class is used to exchange data between signalling and transport
 * protocol.
+*
+* Buffers are taken from a pool with a few size classes and are reference
+* counted, so a slice of a NetMsg (e.g. the NSLP payload inside a GIST PDU)
+* can share the buffer instead of copying it. A shared buffer is freed or
+* returned to the pool when the last NetMsg using it is destroyed. Writing
+* into a NetMsg changes all slices sharing its buffer, so slices are meant
+* for data that is no longer modified.
 */
 class NetMsg {
 public:
@@ -84,6 +108,8 @@ public:
 	NetMsg(uchar *b, uint32 s, bool copy = true);
 	/// copy constructor
 	NetMsg(const NetMsg& n);
+	/// constructor for a slice of n, shares the buffer of n if possible
+	NetMsg(const NetMsg& n, uint32 start, uint32 len);
 	/// destructor
 	~NetMsg();
 	/// buffer 
@@ -109,6 +135,10 @@ public:
 	uint32 copy_to(uchar *b, uint32 start, uint32 n) const;
 	/// get pointer to buffer
 	uchar* get_buffer() const;
+	/// is the buffer shared with other NetMsgs
+	bool is_shared() const;
+	/// get statistics of the buffer pool
+	static netmsg_pool_stats_t get_pool_stats();
 	/// decode uint8
 	uint8 decode8(bool move = true);
 	/// decode uint16
@@ -187,8 +217,8 @@ private:
 	/** Pointer to the last byte of the buffer. */	
 	uchar *buf_end;
 
-	/// true if copied, used in destructor
-	bool allocated;
+	/// pool buffer that contains buf, NULL if buf is not owned by this NetMsg
+	netmsg_buffer* refbuf;
 
 	/// store type and position (in netmsg buffer)
 	TLP_list* tlp_list;
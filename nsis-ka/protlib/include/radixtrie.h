@@ -234,11 +234,11 @@ public:
 
 	node *lookup_node(const netaddress &key, bool lpfm = true,
 	    bool with_data = true) {
-		node *a, *b, *c, *lpfn;
+		node *a, *b, *lpfn;
 		int cmp, pos = 0;
 
 		lpfn = 0;
-		c = b = a = key.is_ipv4() ? v4head : v6head;
+		b = a = key.is_ipv4() ? v4head : v6head;
 		if (lpfm) {
 			if (!with_data)
 				lpfn = a;
@@ -287,7 +287,6 @@ public:
 			if (b->index <= a->index)
 				break;
 
-			c = a;
 			a = b;
 		}
 
@@ -29,11 +29,34 @@
 #ifndef READNL_H
 #define READNL_H
 
+#include "address.h"
+
+struct nlmsghdr;
+
 #define NL_BUFSIZE 8192
 namespace protlib {
 
 	namespace util {
 		int readnl(int sock, char *buf);
+
+		/// a route as described by an RTM_NEWROUTE or RTM_DELROUTE message
+		struct nlroute_t {
+			/// destination prefix, 0.0.0.0/0 or ::/0 for a default route
+			netaddress dst;
+			uint32 table;
+			/// RTN_UNICAST, RTN_LOCAL, ...
+			uint8 type;
+			/// outgoing interface, 0 if there is none or several
+			uint32 oif;
+			/// the route has several next hops
+			bool multipath;
+			/// the route specifies the source address
+			bool has_prefsrc;
+			/// a cached clone of a route, not part of the routing tables
+			bool cloned;
+		};
+
+		bool parse_route(const struct nlmsghdr *nlhdrp, nlroute_t &route);
 	}
 }
 #endif
@@ -5,8 +5,28 @@
 namespace protlib {
 
 	namespace util {
+		/// counters of the cache behind get_local_if() and get_src_addr()
+		struct route_cache_stats_t {
+			uint64 hits;
+			uint64 misses;
+			/// route, address or link changes seen on netlink
+			uint64 invalidations;
+			/// number of times the results of all prefixes were dropped
+			uint64 flushes;
+			/// number of route prefixes results are cached for
+			uint32 entries;
+			/// false if netlink events cannot be received, nothing is cached then
+			bool enabled;
+		};
+
 		uint16 get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress);
+		/// outgoing interface towards destaddress, for packets of any (also non-local) source
+		uint16 get_local_if(const hostaddress& destaddress);
 		netaddress * get_src_addr(const netaddress &dest);
+
+		route_cache_stats_t get_route_cache_stats();
+		/// drop all cached results (done automatically on netlink address/link changes)
+		void invalidate_route_cache();
 	}
 
 }
@@ -84,11 +84,21 @@ public:
 };
 
 /// Timer Manager
-/** Creates, sets, resets, stops, checks and deletes timers. */
+/** Creates, sets, resets, stops, checks and deletes timers.
+ * Active timers are kept either in a sorted list (O(n) insertion) or in a
+ * hierarchical timing wheel with 1ms resolution (O(1) start, restart and
+ * stop), depending on the backend chosen at construction time.
+ */
 class TimerManager {
 public:
+	/// data structure used for active timers
+	enum backend_t {
+		backend_list,
+		backend_wheel
+	}; // end backend_t
+
 	/// constructor
-	TimerManager();
+	TimerManager(backend_t b = backend_list);
 	/// destructor
         ~TimerManager();
 	/// start relative timer
@@ -107,6 +117,10 @@ public:
 	uint32 check_timers_wait(int32 msec);
 	/// stop all timers
 	uint32 stop_all();
+	/// get backend
+	backend_t get_backend() const { return backend; }
+	/// get number of active timers
+	uint32 get_num_active();
 private:
 	/// timer item
 	struct timer {
@@ -114,6 +128,13 @@ private:
 		struct timespec time;
 		TimerCallback* callback;
 		timer_callback_param_t param;
+		/// expiration tick (wheel backend only)
+		uint64 tick;
+		/// wheel slot (wheel backend only)
+		uint32 slot;
+		/// wheel slot links (wheel backend only)
+		timer* prev;
+		timer* next;
 		timer(struct timespec& ts, TimerCallback* tc, timer_callback_param_t tcp, bool get_id = true);
 		// compare two timers
 		bool operator<=(const timer& t);
@@ -131,10 +152,24 @@ private:
 
 	/// cleanup hashmap and list
 	uint32 cleanup();
+	/// insert into list or wheel
+	void schedule(timer* t);
+	/// delete from list or wheel
+	void unschedule(timer* t);
 	/// insert into list
 	void insert_into_list(timer* t);
 	/// delete timer from list
 	void delete_from_list(timer *t);
+	/// insert into timing wheel
+	void insert_into_wheel(timer* t);
+	/// delete timer from timing wheel
+	void delete_from_wheel(timer* t);
+	/// move all timers of a wheel slot one level down
+	bool cascade_wheel(uint32 level);
+	/// move timers from the wheel to the elapsed list up to the given tick
+	void advance_wheel(uint64 now);
+	/// earliest tick at which the wheel may hold an elapsed timer
+	bool next_wheel_event(struct timespec& ts);
 	/// collect elapsed timers
 	timer* collect_elapsed();
 	/// process elapsed timers
@@ -152,7 +187,25 @@ private:
         timerlist_t elapsed_timerlist;
 	/// return first element of active timer list 
         timer* first() { return active_timerlist.empty() ? 0 : active_timerlist.front(); }
+	/// alarm time of the earliest timer
+	bool next_event(struct timespec& ts);
 	timer_hashmap_t hashmap;
+
+	/// selected backend
+	const backend_t backend;
+	/// timing wheel geometry: 256 slots of 1ms, then 4 levels of 64 slots
+	static const uint32 wheel_root_bits = 8;
+	static const uint32 wheel_level_bits = 6;
+	static const uint32 wheel_levels = 5;
+	static const uint32 wheel_root_size = 1 << wheel_root_bits;
+	static const uint32 wheel_level_size = 1 << wheel_level_bits;
+	static const uint32 wheel_slots = wheel_root_size + (wheel_levels-1)*wheel_level_size;
+	/// slot heads, level 0 first
+	timer* wheel[wheel_slots];
+	/// number of timers per wheel level
+	uint32 wheel_count[wheel_levels];
+	/// next tick that has not been processed yet
+	uint64 wheel_tick;
 };
 
 //@}
@@ -190,12 +190,15 @@ TimerMsg::is_ok()
 struct TimerModuleParam : public ThreadParam 
 {
   TimerModuleParam(uint32 sleep_time = ThreadParam::default_sleep_time,
-		   bool sua = false, bool ser = true, bool sre = true);
+		   bool sua = false, bool ser = true, bool sre = true,
+		   TimerManager::backend_t tb = TimerManager::backend_list);
   /// send messages until abort
   const bool send_until_abort;
   const message::qaddr_t source;
   const bool send_error_expedited;
   const bool send_reply_expedited;
+  /// data structure used by the TimerManager
+  const TimerManager::backend_t timer_backend;
 }; // end TimerModuleParam
 
 /// timer module class
@@ -36,6 +36,9 @@
 
 #include "hashmap"
 
+#include <deque>
+#include <vector>
+
 #include "tp.h"
 #include "threads.h"
 #include "threadsafe_db.h"
@@ -49,6 +52,8 @@ namespace protlib
   * @param port - port number for master listener thread (server port)
   * @param sleep - time (in ms) that listener and receiver wait at a poll() call
   * @param d - destination module, where internal message are sent
+  * @param io_threads - 0 for one sender and one receiver thread per connection,
+  *                     otherwise number of epoll based I/O threads that serve all connections
   */
 struct TPoverTCPParam : public ThreadParam 
 {
@@ -62,7 +67,8 @@ struct TPoverTCPParam : public ThreadParam
 		 message::qaddr_t source = message::qaddr_transport,
 		 message::qaddr_t dest = message::qaddr_signaling,
 		 bool sendaborts = false,
-		 uint8 tos = 0x10) :
+		 uint8 tos = 0x10,
+		 uint32 io_threads = 0) :
     ThreadParam(sleep,threadname,1,1),
        port(p),
        debug_pdu(debug_pdu),
@@ -71,7 +77,8 @@ struct TPoverTCPParam : public ThreadParam
        common_header_length(common_header_length),
        getmsglength(getmsglength),
        terminate(false),
-       ip_tos(tos)
+       ip_tos(tos),
+       io_threads(io_threads)
         {};
 
 
@@ -91,6 +98,8 @@ struct TPoverTCPParam : public ThreadParam
   /// should master thread terminate?
   const bool terminate;
   const uint8 ip_tos;
+  /// number of I/O threads in event loop mode (0: thread per connection)
+  const uint32 io_threads;
 }; // end TPoverUDPParam
 
 
@@ -115,7 +124,8 @@ public:
   /// constructor
   TPoverTCP(const TPoverTCPParam& p) :
     TP(tsdb::get_tcp_id(),"tcp",p.name,p.common_header_length,p.getmsglength),
-    Thread(p), tpparam(p), already_aborted(false), msgqueue(NULL), debug_pdu(p.debug_pdu)
+    Thread(p), tpparam(p), already_aborted(false), msgqueue(NULL), debug_pdu(p.debug_pdu),
+    ioloops(NULL), next_ioloop(0)
   { 
     // perform some initializing actions
     // currently not required (SCTP had to init its library)
@@ -155,6 +165,40 @@ public:
       instance(instance), sender_thread_queue(sq) {};
   };
   
+  /// per connection state in event loop mode
+  struct evconn_t
+  {
+    AssocData* assoc;
+    /// index of the I/O thread that owns this connection
+    uint32 loop;
+    /// non-blocking connect() still in progress
+    bool connecting;
+    /// EPOLLOUT is armed for the socket
+    bool want_write;
+    /// shutdown (write) as soon as the write queue is drained
+    bool shutdown_pending;
+    /// receive buffer, grows up to NetMsg::max_size and shrinks again when drained
+    std::vector<uchar> rbuf;
+    uint32 rlen;
+    /// pending PDUs, woffset bytes of the first one are already written
+    std::deque< std::pair<NetMsg*, TPsentcallback_t> > wqueue;
+    uint32 woffset;
+
+    evconn_t(AssocData* a, uint32 l, bool c) :
+      assoc(a), loop(l), connecting(c), want_write(c), shutdown_pending(false), rlen(0), woffset(0) {};
+  };
+
+  /// an I/O thread with its epoll instance
+  struct ioloop_t
+  {
+    TPoverTCP* instance;
+    uint32 index;
+    int epfd;
+    pthread_t thread_ID;
+    /// protects the write queues of all connections of this loop
+    pthread_mutex_t mutex;
+  };
+
 private:
   /// sends a network message, spawns receiver thread if necessary
   void send_cb(NetMsg* msg,const address& addr, bool use_existing_connection, TPsentcallback_t sentcallbackfunc= NULL);
@@ -201,6 +245,36 @@ private:
   /// terminates all active receiver or sender threads
   void terminate_all_threads();
   
+  /// start the I/O threads of the event loop mode
+  void start_ioloops();
+
+  /// stop the I/O threads and close all connections of the event loop mode
+  void stop_ioloops();
+
+  /// static starter for an I/O thread
+  static void* ioloop_starter(void *argp);
+
+  /// I/O thread procedure, serves all connections registered at its epoll instance
+  void ioloop(ioloop_t* loop);
+
+  /// hands a connected socket over to an I/O thread (lock must be held)
+  evconn_t* ev_attach(AssocData* assoc, bool connecting);
+
+  /// non-blocking connect to addr (lock must be held)
+  evconn_t* ev_connect(const appladdress& addr);
+
+  /// queues a NetMsg for sending in event loop mode
+  void ev_send(NetMsg* netmsg, appladdress* addr, bool use_existing_connection, TPsentcallback_t sentcallbackfunc);
+
+  /// reads available data and delivers complete PDUs, returns false if the connection is gone
+  bool ev_read(evconn_t* conn);
+
+  /// writes queued PDUs with a single sendmsg() call, returns false on error
+  bool ev_write(evconn_t* conn);
+
+  /// removes a connection from all maps and closes its socket
+  void ev_close(evconn_t* conn);
+
   /// ConnectionMap instance for keeping track of all existing connections
   ConnectionMap connmap;
   
@@ -221,6 +295,15 @@ private:
   FastQueue* msgqueue;
   
   bool debug_pdu;
+
+  /// I/O threads in event loop mode (tpparam.io_threads entries)
+  ioloop_t* ioloops;
+  /// round robin assignment of new connections to I/O threads
+  uint32 next_ioloop;
+
+  /// connections of the event loop mode by socket
+  typedef hashmap_t<int, evconn_t*> evconnmap_t;
+  evconnmap_t evconnmap;
 }; // end class TPoverTCP
 
 /** A simple internal message for selfmessages
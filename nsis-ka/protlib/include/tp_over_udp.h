@@ -41,6 +41,7 @@
 #include "threadsafe_db.h"
 #include "connectionmap.h"
 #include "assocdata.h"
+#include "udp_sendbatch.h"
 
 namespace protlib 
 {
@@ -139,6 +140,19 @@ public:
   };
 
   int get_listener_socket() const { return master_listener_socket; }
+
+  /// batched sender for the listener socket, shared with TPqueryEncap
+  UDPSendBatch& get_sendbatch() { return sendbatch; }
+
+  /// counters of the batched send path
+  udp_batch_stats_t get_tx_stats() const { return sendbatch.get_stats(); }
+  /// counters of the batched receive path
+  udp_batch_stats_t get_rx_stats() const { return rx_stats.load(); }
+
+  /// maximum number of datagrams fetched by a single recvmmsg() call
+  static const unsigned int rx_batch_size= 32;
+  /// size of a receive buffer, the largest possible UDP payload
+  static const unsigned int rx_buffer_size= 65536;
   
 private:
 
@@ -146,6 +160,9 @@ private:
   /// send a message to the network via UDP
   void udpsend(NetMsg* msg, appladdress* addr, const hostaddress *local_addr);
   
+  /// socket setup before sending, resets the IPv4 options
+  static void setup_socket(int sockfd, int hop_limit, int rao, void* arg);
+
   /// a static starter method to invoke the listener thread
   static void* listener_thread_starter(void *argp);
 
@@ -167,6 +184,11 @@ private:
 
   int master_listener_socket;
 
+  /// sends on master_listener_socket
+  UDPSendBatch sendbatch;
+  /// written by the listener thread only, with count_atomic()
+  udp_batch_stats_t rx_stats;
+
 }; // end class TPoverUDP
 
 /** A simple internal message for selfmessages
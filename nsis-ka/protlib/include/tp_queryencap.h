@@ -66,7 +66,7 @@ struct TPqueryEncapParam : public ThreadParam
       bool (*const getmsglength) (NetMsg& m, uint32& clen_words),
       port_t p,
       vector<uint32>& raovec,
-      const TPoverUDP* tpoverudp,
+      TPoverUDP* tpoverudp,
       const bool &strict_rao,
       uint32 GIST_magic_num= 0,
       uint32 sleep = ThreadParam::default_sleep_time,
@@ -114,7 +114,7 @@ struct TPqueryEncapParam : public ThreadParam
 
     /// function pointer to function returning a pointer to an already established socket
     /// that we use as sending socket in udp send
-    const TPoverUDP* tpoverudp;
+    TPoverUDP* tpoverudp;
 }; // end TPqueryEncapParam
     
     
@@ -184,6 +184,8 @@ private:
 
   void setup_socket_ipv4(int sockfd, int hop_limit, int rao);
   void setup_socket_ipv6(int sockfd, int hop_limit, int rao);
+  /// socket setup called by the batched sender of TPoverUDP
+  static void setup_socket(int sockfd, int hop_limit, int rao, void* arg);
   
   /// ConnectionMap instance for keeping track of all existing connections
   ConnectionMap connmap;
@@ -0,0 +1,157 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file udp_sendbatch.h
+/// batched sending of UDP datagrams via sendmmsg()
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2007, all rights reserved by
+// - Institute of Telematics, Universitaet Karlsruhe (TH)
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+/** @ingroup tpudp
+ * @ file
+ * Batched UDP sending shared by TPoverUDP and TPqueryEncap
+ */
+
+#ifndef UDP_SENDBATCH_H
+#define UDP_SENDBATCH_H
+
+#include <pthread.h>
+#include <sys/socket.h>
+
+#include "protlib_types.h"
+
+namespace protlib
+{
+
+/// counters of a batched send or receive path
+struct udp_batch_stats_t
+{
+  /// number of sendmmsg() or recvmmsg() calls
+  uint64 batches;
+  /// number of datagrams sent or received by these calls
+  uint64 datagrams;
+  /// largest number of datagrams handled by a single call
+  uint32 max_batch;
+
+  udp_batch_stats_t() : batches(0), datagrams(0), max_batch(0) {};
+
+  void count(uint32 n) { batches++; datagrams+= n; if (n > max_batch) max_batch= n; }
+
+  /// count() for counters that a single thread updates while others load() them
+  void count_atomic(uint32 n) {
+    __atomic_fetch_add(&batches, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&datagrams, n, __ATOMIC_RELAXED);
+    if (n > __atomic_load_n(&max_batch, __ATOMIC_RELAXED))
+      __atomic_store_n(&max_batch, n, __ATOMIC_RELAXED);
+  }
+
+  /// copy of counters updated by count_atomic()
+  udp_batch_stats_t load() const {
+    udp_batch_stats_t s;
+    s.batches= __atomic_load_n(&batches, __ATOMIC_RELAXED);
+    s.datagrams= __atomic_load_n(&datagrams, __ATOMIC_RELAXED);
+    s.max_batch= __atomic_load_n(&max_batch, __ATOMIC_RELAXED);
+    return s;
+  }
+};
+
+
+/** Sends datagrams on a UDP socket with as few sendmmsg() calls as possible.
+ *
+ * send() is synchronous like sendmsg(): it returns after the datagram was
+ * handed to the kernel, together with the result of that operation. If
+ * several threads send at the same time, the first one becomes the flusher
+ * and sends all datagrams queued meanwhile by the others with a single
+ * sendmmsg() call, the others just wait for their result. A single sender
+ * therefore sees no additional latency.
+ *
+ * Socket options that apply to a datagram (e.g. the IPv4 RAO, which can
+ * only be set with setsockopt()) are given as setup function plus
+ * arguments. The flusher calls it before each run of datagrams with equal
+ * setup, so concurrent senders can no longer overwrite each other's options.
+ */
+class UDPSendBatch
+{
+public:
+  /// sets socket options for the following datagrams
+  typedef void (*setup_func_t)(int sock, int hop_limit, int rao, void* arg);
+
+  /// constructor
+  UDPSendBatch(unsigned int maxbatch= default_max_batch);
+  /// destructor
+  ~UDPSendBatch();
+
+  /// sends msg on sock, returns the number of bytes sent or -1 (errno is set)
+  int send(int sock, struct msghdr* msg, setup_func_t setup= NULL, void* setup_arg= NULL, int hop_limit= -1, int rao= -1);
+
+  /// get a copy of the counters
+  udp_batch_stats_t get_stats() const;
+
+  /// maximum number of datagrams passed to a single sendmmsg() call by default
+  static const unsigned int default_max_batch= 32;
+
+private:
+  /// a datagram waiting to be sent
+  struct entry_t
+  {
+    int sock;
+    struct msghdr* msg;
+    setup_func_t setup;
+    void* setup_arg;
+    int hop_limit;
+    int rao;
+    /// result of sendmmsg() for this datagram
+    int result;
+    int error;
+    bool done;
+    entry_t* next;
+  };
+
+  /// sends all datagrams of the list (called without lock)
+  void flush(entry_t* list);
+
+  /// sends the first n entries of run, which have equal socket and setup
+  void flush_run(unsigned int n);
+
+  const unsigned int maxbatch;
+  /// sendmmsg() argument and the matching entries, only used by the flusher
+  struct mmsghdr* mmsgs;
+  entry_t** run;
+
+  mutable pthread_mutex_t mutex;
+  pthread_cond_t cond;
+  /// queued datagrams, oldest first
+  entry_t* head;
+  entry_t* tail;
+  /// a thread is currently flushing
+  bool flushing;
+
+  udp_batch_stats_t stats;
+
+  // not copyable
+  UDPSendBatch(const UDPSendBatch&);
+  UDPSendBatch& operator=(const UDPSendBatch&);
+}; // end class UDPSendBatch
+
+} // end namespace protlib
+
+#endif
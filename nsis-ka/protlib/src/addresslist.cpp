@@ -1,5 +1,6 @@
 #include "addresslist.h"
 #include "rfc5014_hack.h"
+#include "routing_util.h"
 
 #include <netinet/in.h>
 #include <ifaddrs.h>
@@ -647,7 +648,6 @@ netaddress *
 AddressList::get_src_addr(const netaddress &dest, uint32_t *prefs)
 {
 	netaddress *res;
-	int sfd;
 
 	netaddress canonical_dest(dest);
 	
@@ -655,12 +655,6 @@ AddressList::get_src_addr(const netaddress &dest, uint32_t *prefs)
 	// either plain IPv4 or plain IPv6
 	canonical_dest.convert_to_ipv4();
 
-	sfd = socket(canonical_dest.is_ipv4() ? AF_INET : AF_INET6, SOCK_DGRAM, 0);
-	if (sfd == -1) {
-		err(1, "socket");
-		return NULL;
-	}
-
 #ifdef IPV6_ADDR_PREFERENCES
 	/* XXX: IPV6_PREFER_SRC_COA does not work */
 	if (prefs != NULL && (*prefs & IPV6_PREFER_SRC_COA)) {
@@ -683,50 +677,10 @@ AddressList::get_src_addr(const netaddress &dest, uint32_t *prefs)
 		}
 	}
 #endif
-	if (canonical_dest.is_ipv4()) {
-		struct sockaddr_in sin = {0};
-		socklen_t slen = sizeof(sin);
-		sin.sin_family = AF_INET;
-		sin.sin_port = htons(4);
-		canonical_dest.get_ip(sin.sin_addr);
-		if (connect(sfd, (struct sockaddr *)&sin, sizeof(sin)) == -1) {
-			err(1, "connect");
-			close(sfd);
-			return NULL;
-		}
-		if (getsockname(sfd, (struct sockaddr *)&sin, &slen) == -1) {
-			err(1, "getsockname");
-			close(sfd);
-			return NULL;
-		}
-		close(sfd);
-		res = new netaddress();
-		res->set_ip(sin.sin_addr);
-		res->set_pref_len(32);
-		return (res);
-	} else {
-		struct sockaddr_in6 sin6 = {0};
-		socklen_t slen = sizeof(sin6);
-		sin6.sin6_family = AF_INET6;
-		sin6.sin6_port = htons(4);
-		canonical_dest.get_ip(sin6.sin6_addr);
-		if (connect(sfd, (struct sockaddr *)&sin6,
-		    sizeof(sin6)) == -1) {
-			err(1, "connect");
-			close(sfd);
-			return NULL;
-		}
-		if (getsockname(sfd, (struct sockaddr *)&sin6, &slen) == -1) {
-			err(1, "getsockname");
-			close(sfd);
-			return NULL;
-		}
-		close(sfd);
-		res = new netaddress();
-		res->set_ip(sin6.sin6_addr);
-		res->set_pref_len(128);
-		return (res);
-	}
+	// ask the kernel (cached, see routing_util.cpp)
+	res = util::get_src_addr(canonical_dest);
+
+	return res;
 }
 
 void
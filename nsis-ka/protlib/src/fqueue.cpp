@@ -49,11 +49,21 @@ namespace protlib {
  *
  * @param qname the queue's name, or NULL
  * @param exp if true, expedited data support is enabled
+ * @param ringsize if not 0, use a lock-free ring queue with this capacity
  */
-FastQueue::FastQueue(const char *qname, bool exp)
-    : queue_name((qname == 0) ? "" : (char*)qname), shutdownflag(false)
+FastQueue::FastQueue(const char *qname, bool exp, unsigned long ringsize)
+    : queue(NULL), ring(NULL),
+      queue_name((qname == 0) ? "" : (char*)qname), shutdownflag(false)
 {
-  if ((queue = create_queue(qname)) == NULL)
+  if (ringsize)
+  {
+    if ((ring = create_ring_queue(qname, ringsize)) == NULL)
+    {
+      Log(ERROR_LOG, LOG_ALERT, "FastQueue", "Could not create ring queue " << queue_name);
+      throw FQError();
+    } else ring_enable_expedited(ring,exp);
+  }
+  else if ((queue = create_queue(qname)) == NULL)
   {
     Log(ERROR_LOG, LOG_ALERT, "FastQueue", "Could not create queue " << queue_name);
     throw FQError();
@@ -84,6 +94,15 @@ FastQueue::FastQueue(const char *qname, bool exp)
 bool FastQueue::enqueue(message *element, bool exp)
 {
   if (shutdownflag) return false;
+  if (ring)
+  {
+    if (ring_enqueue_element_expedited_signal(ring, (void*)element, exp) < 0)
+    {
+      Log(ERROR_LOG, LOG_ALERT, "FastQueue", "Ring queue " << queue_name << " is full, message rejected");
+      return false;
+    }
+    return true;
+  }
   if (enqueue_element_expedited_signal(queue, (void*)element, exp) < 0)
   {
     Log(ERROR_LOG, LOG_ALERT, "FastQueue", "Could not enqueue element in queue " << queue_name);
@@ -107,7 +126,27 @@ message *FastQueue::dequeue_timedwait(const long int msec)
   struct timespec tspec = {0,0};
   tspec.tv_sec = msec/1000;
   tspec.tv_nsec = (msec%1000)*1000000;
-  return (message*)dequeue_element_timedwait(queue, &tspec);
+  return dequeue_timedwait(tspec);
+}
+
+
+/**
+ * Wait up to msec milliseconds for messages and dequeue up to n of them.
+ *
+ * @param msgs array for at least n messages
+ * @param n maximum number of messages to dequeue
+ * @param msec the time to wait in milliseconds
+ *
+ * @return the number of messages stored in msgs, 0 on timeout
+ */
+unsigned int FastQueue::dequeue_batch_timedwait(message **msgs, unsigned int n, const long int msec)
+{
+  struct timespec tspec = {0,0};
+  tspec.tv_sec = msec/1000;
+  tspec.tv_nsec = (msec%1000)*1000000;
+  return ring ?
+    ring_dequeue_elements_timedwait(ring, (void**)msgs, n, &tspec) :
+    dequeue_elements_timedwait(queue, (void**)msgs, n, &tspec);
 }
 
 
@@ -127,6 +166,14 @@ FastQueue::~FastQueue()
       Log(ERROR_LOG, LOG_ALERT, "FastQueue", "Could not destroy queue " << queue_name);
     }
   }
+  if (ring)
+  {
+    cleanup();
+    if ((destroy_ring_queue(ring)) < 0)
+    {
+      Log(ERROR_LOG, LOG_ALERT, "FastQueue", "Could not destroy ring queue " << queue_name);
+    }
+  }
   DLog("FastQueue", "~FastQueue() - done for queue " << queue_name);
 }
 
@@ -137,7 +184,7 @@ FastQueue::~FastQueue()
  */
 bool FastQueue::is_empty() const
 {
-  if (queue_nr_of_elements(queue)==0)
+  if (size()==0)
     return true;
   else
     return false;
@@ -151,7 +198,7 @@ bool FastQueue::is_empty() const
  */
 unsigned long FastQueue::size() const
 {
-  return queue_nr_of_elements(queue);
+  return ring ? ring_nr_of_elements(ring) : queue_nr_of_elements(queue);
 }
 
 
@@ -162,6 +209,8 @@ unsigned long FastQueue::size() const
  */
 bool FastQueue::is_expedited_enabled() const
 {
+  if (ring)
+    return ring->exp_enabled != 0;
   if (queue_is_expedited_enabled(queue))
     return true;
   else
@@ -177,6 +226,8 @@ bool FastQueue::is_expedited_enabled() const
  */
 bool FastQueue::enable_expedited(bool exp)
 {
+  if (ring)
+    return ring_enable_expedited(ring,exp) != 0;
   if (queue_enable_expedited(queue,exp))
     return true;
   else
@@ -216,7 +267,8 @@ unsigned long FastQueue::cleanup()
 void 
 FastQueue::signal_queue()
 {
-   signal_cond(queue);
+   if (ring) ring_signal(ring);
+   else signal_cond(queue);
 }
 
 //@}
@@ -31,9 +31,17 @@
 #include <iomanip>
 #include <new>
 
+#include <streambuf>
+#include <vector>
+
+#include <stdlib.h>
 #include <time.h>
 #include <sys/time.h> // gettimeofday
 
+extern "C" {
+#include "fastqueue.h"
+}
+
 namespace protlib {
 
 using namespace std;
@@ -115,13 +123,15 @@ const char *const logseveritylevel_str[]=
 bool
 logfile::set_dest(const char* filename, bool quiet)
 {
+  char timestr[timestr_size];
+
   // lock everything
   pthread_mutex_lock(&logmutex); 
 
   if (logstream && !quiet)
   {
-    (*logstream) << color[blue] << timenow() << '[' << getpid() << "] Redirecting Log output to \"" << filename << '\"' << endl;
-    (*logstream) << color[blue] << timenow() 
+    (*logstream) << color[blue] << timenow(timestr) << '[' << getpid() << "] Redirecting Log output to \"" << filename << '\"' << endl;
+    (*logstream) << color[blue] << timenow(timestr) 
 		 << '[' << getpid() << "] <<<<<<<<<<<<<<<<<<<<<<<< *** LOG  STOP *** <<<<<<<<<<<<<<<<<<<<<<<<" 
 		 << color[off] << endl;
   }
@@ -145,7 +155,7 @@ logfile::set_dest(const char* filename, bool quiet)
   }
   else
   {
-    (*logstream) << color[blue] << timenow() 
+    (*logstream) << color[blue] << timenow(timestr) 
 		 << '[' << getpid() << "] >>>>>>>>>>>>>>>>>>>>>>>> *** LOG START *** >>>>>>>>>>>>>>>>>>>>>>>>" 
 		 << color[off] << endl;
   }
@@ -153,6 +163,92 @@ logfile::set_dest(const char* filename, bool quiet)
 }
 
 
+namespace {
+
+/// growing character buffer that is reused for every record of a thread
+class log_record_streambuf : public streambuf
+{
+public:
+  log_record_streambuf() : buf(256) { reset(); }
+
+  void reset() { setp(&buf[0], &buf[0] + buf.size()); }
+  const char* data() const { return pbase(); }
+  size_t length() const { return pptr() - pbase(); }
+
+protected:
+  virtual int_type overflow(int_type c)
+  {
+    size_t len= length();
+
+    buf.resize(2 * buf.size());
+    setp(&buf[0], &buf[0] + buf.size());
+    pbump(len);
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+      *pptr()= traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+private:
+  vector<char> buf;
+};
+
+/// buffer for a record in asynchronous mode
+struct log_record_buf_t
+{
+  log_record_streambuf sb;
+  ostream os;
+  /// record is queued by logend() (otherwise logmutex is held)
+  bool async;
+  logclass_t logclass;
+
+  log_record_buf_t() : os(&sb), async(false), logclass(ERROR_LOG) {}
+};
+
+/// record buffers of a thread, one per nesting level of logstart()
+struct log_thread_state_t
+{
+  vector<log_record_buf_t*> levels;
+  unsigned int depth;
+
+  log_thread_state_t() : depth(0) {}
+  ~log_thread_state_t()
+  {
+    for (unsigned int i= 0; i < levels.size(); i++)
+      delete levels[i];
+  }
+};
+
+extern "C" void free_log_thread_state(void* state)
+{
+  delete static_cast<log_thread_state_t*>(state);
+}
+
+/// maximum number of records the writer thread takes from the ring at once
+const unsigned int writer_batch= 64;
+
+} // end anonymous namespace
+
+
+void
+logfile::write_header(ostream& os, logclass_t logclass, loglevel_t severity_level, const string& modname)
+{
+  char timestr[timestr_size];
+
+  os << (logclass==ERROR_LOG ? color[bold_on] : "")
+     << (logclass==WARNING_LOG ? color[magenta] : 
+	 (logclass==ERROR_LOG ? color[red] : color[off])
+	)
+     << timenow(timestr)
+     << '-' << getpid() << (logclass!=ERROR_LOG ? '-' : '*')
+     << color[bold_on] << logclass_str[logclass>>4] << (logclass==ERROR_LOG ? color[bold_on] : color[bold_off])
+     << (logclass!=ERROR_LOG ? '/' : '*') << hex << severity_level << dec
+     << ": " << color[bold_on] << left << setfill(' ') << setw(15) << modname << color[bold_off] << right << " " << color[off];
+}
+
+
 ostream&
 logfile::logstart(logclass_t logclass, loglevel_t severity_level, 
 		  const string& modname,
@@ -160,6 +256,55 @@ logfile::logstart(logclass_t logclass, loglevel_t severity_level,
 		  const char* func, 
 		  int line)
 {  
+  log_thread_state_t* state= NULL;
+  log_record_buf_t* rec= NULL;
+
+  if (__atomic_load_n(&thread_key_valid, __ATOMIC_ACQUIRE))
+  {
+    state= static_cast<log_thread_state_t*>(pthread_getspecific(thread_key));
+    if (!state)
+    {
+      state= new(nothrow) log_thread_state_t;
+      if (state && pthread_setspecific(thread_key, state))
+      {
+	delete state;
+	state= NULL;
+      }
+    }
+    if (state)
+    {
+      if (state->depth == state->levels.size())
+      {
+	rec= new(nothrow) log_record_buf_t;
+	if (rec)
+	  state->levels.push_back(rec);
+      }
+      else
+	rec= state->levels[state->depth];
+    }
+    // logend() takes the mode of the record from its buffer
+    if (rec)
+    {
+      state->depth++;
+      rec->logclass= logclass;
+      // announce the record before looking at the mode, set_async(false)
+      // clears the mode before it waits for the announced records
+      __atomic_add_fetch(&async_records, 1, __ATOMIC_SEQ_CST);
+      rec->async= __atomic_load_n(&async, __ATOMIC_SEQ_CST);
+      if (!rec->async)
+	__atomic_sub_fetch(&async_records, 1, __ATOMIC_RELEASE);
+    }
+  }
+
+  // asynchronous mode: format into the buffer of this thread without locking
+  if (rec && rec->async)
+  {
+    rec->sb.reset();
+    rec->os.clear();
+    write_header(rec->os, logclass, severity_level, modname);
+    return rec->os;
+  }
+
   // lock logstream for writing, must be unlocked by logfile.end()
   int mtxlck_ret= 0;
   if ( (mtxlck_ret= pthread_mutex_lock(&logmutex)) )
@@ -168,22 +313,223 @@ logfile::logstart(logclass_t logclass, loglevel_t severity_level,
   }
 
   if ( logstream )
-  {
-    (*logstream) << (logclass==ERROR_LOG ? color[bold_on] : "")
-                 << (logclass==WARNING_LOG ? color[magenta] : 
-		     (logclass==ERROR_LOG ? color[red] : color[off])
-		    )
-                 << timenow()
-		 << '-' << getpid() << (logclass!=ERROR_LOG ? '-' : '*')
-		 << color[bold_on] << logclass_str[logclass>>4] << (logclass==ERROR_LOG ? color[bold_on] : color[bold_off])
-		 << (logclass!=ERROR_LOG ? '/' : '*') << hex << severity_level << dec
-		 << ": " << color[bold_on] << left << setfill(' ') << setw(15) << modname << color[bold_off] << right << " " << color[off];
-  }
+    write_header(*logstream, logclass, severity_level, modname);
   
   return (*logstream);
 }
 
 
+void
+logfile::logend() 
+{ 
+  log_thread_state_t* state= __atomic_load_n(&thread_key_valid, __ATOMIC_ACQUIRE) ?
+    static_cast<log_thread_state_t*>(pthread_getspecific(thread_key)) : NULL;
+  log_record_buf_t* rec= NULL;
+
+  if (state && state->depth > 0)
+  {
+    state->depth--;
+    rec= state->levels[state->depth];
+  }
+
+  if (rec && rec->async)
+  {
+    rec->os << color[off] << '\n';
+    enqueue(rec->sb.data(), rec->sb.length(), rec->logclass);
+    __atomic_sub_fetch(&async_records, 1, __ATOMIC_RELEASE);
+    return;
+  }
+
+  if (logstream) 
+  { 
+    (*logstream) << color[off] << endl; 
+  }
+
+  pthread_mutex_unlock(&logmutex); 
+}
+
+
+/** hand a formatted record over to the writer thread
+ * if the ring is full, the record is dropped, unless it is an error
+ */
+void
+logfile::enqueue(const char* record, size_t length, logclass_t logclass)
+{
+  char* r= static_cast<char*>(malloc(length+1));
+
+  if (r)
+  {
+    memcpy(r, record, length);
+    r[length]= '\0';
+    if (ring_enqueue_element_expedited_signal(ring, r, 0) == 0)
+      return;
+    free(r);
+  }
+
+  if (logclass == ERROR_LOG)
+  {
+    pthread_mutex_lock(&logmutex);
+    if (logstream)
+    {
+      logstream->write(record, length);
+      logstream->flush();
+    }
+    pthread_mutex_unlock(&logmutex);
+  }
+  else
+    __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+}
+
+
+/// write and free n records, flushing the stream only once
+void
+logfile::write_records(void** records, unsigned int n)
+{
+  pthread_mutex_lock(&logmutex);
+  for (unsigned int i= 0; i < n; i++)
+  {
+    char* r= static_cast<char*>(records[i]);
+    if (logstream)
+      logstream->write(r, strlen(r));
+    free(r);
+  }
+  if (logstream)
+    logstream->flush();
+  pthread_mutex_unlock(&logmutex);
+}
+
+
+/// write all records left in the ring, only called if no writer thread runs
+void
+logfile::drain()
+{
+  void* records[writer_batch];
+  struct timespec nowait= { 0, 0 };
+  unsigned int n;
+
+  if (!ring)
+    return;
+
+  while ((n= ring_dequeue_elements_timedwait(ring, records, writer_batch, &nowait)) > 0)
+    write_records(records, n);
+}
+
+
+void*
+logfile::writer_starter(void* argp)
+{
+  static_cast<logfile*>(argp)->writer();
+  return NULL;
+}
+
+
+/// writer thread: write records in batches until stopped and the ring is empty
+void
+logfile::writer()
+{
+  void* records[writer_batch];
+  // wake up regularly to notice a stop request
+  struct timespec timeout= { 0, 100000000 };
+  // after a partial batch, let records accumulate instead of being woken up for each one
+  struct timespec coalesce= { 0, 1000000 };
+  unsigned int n;
+
+  while (true)
+  {
+    n= ring_dequeue_elements_timedwait(ring, records, writer_batch, &timeout);
+    if (n > 0)
+    {
+      write_records(records, n);
+      if (n < writer_batch)
+	nanosleep(&coalesce, NULL);
+    }
+    else if (__atomic_load_n(&writer_stop, __ATOMIC_ACQUIRE))
+      break;
+  }
+}
+
+
+/** switch between synchronous and asynchronous mode
+ * when switching back to synchronous mode, the records already started in
+ * asynchronous mode are waited for and all queued records are written
+ * before this function returns
+ * @param on true for asynchronous mode
+ * @param ringsize number of records the ring can hold (only used when the ring is created)
+ * @return false if the asynchronous mode could not be started
+ */
+bool
+logfile::set_async(bool on, unsigned long ringsize)
+{
+  bool result= true;
+
+  pthread_mutex_lock(&asyncmutex);
+
+  if (on && !writer_running)
+  {
+    if (!thread_key_valid && pthread_key_create(&thread_key, free_log_thread_state) == 0)
+      __atomic_store_n(&thread_key_valid, true, __ATOMIC_RELEASE);
+
+    if (!ring && thread_key_valid)
+      ring= create_ring_queue("logfile", ringsize);
+
+    if (ring)
+    {
+      writer_stop= false;
+      if (pthread_create(&writer_thread, NULL, writer_starter, this) == 0)
+      {
+	writer_running= true;
+	__atomic_store_n(&async, true, __ATOMIC_RELEASE);
+      }
+      else
+	result= false;
+    }
+    else
+      result= false;
+  }
+  else if (!on && writer_running)
+  {
+    __atomic_store_n(&async, false, __ATOMIC_SEQ_CST);
+    // records started before are still queued by their logend()
+    struct timespec pause= { 0, 100000 };
+    while (__atomic_load_n(&async_records, __ATOMIC_SEQ_CST) > 0)
+      nanosleep(&pause, NULL);
+
+    __atomic_store_n(&writer_stop, true, __ATOMIC_RELEASE);
+    ring_signal(ring);
+    pthread_join(writer_thread, NULL);
+    writer_running= false;
+    // records completed while the writer was stopping
+    drain();
+  }
+
+  pthread_mutex_unlock(&asyncmutex);
+
+  return result;
+}
+
+
+/// stop the asynchronous mode and free its resources (called by the destructor)
+void
+logfile::release_async()
+{
+  set_async(false);
+
+  pthread_mutex_lock(&asyncmutex);
+  if (ring)
+  {
+    drain();
+    destroy_ring_queue(ring);
+    ring= 0;
+  }
+  if (thread_key_valid)
+  {
+    __atomic_store_n(&thread_key_valid, false, __ATOMIC_RELEASE);
+    pthread_key_delete(thread_key);
+  }
+  pthread_mutex_unlock(&asyncmutex);
+}
+
+
   } // end namespace log
 
 } // end namespace protlib
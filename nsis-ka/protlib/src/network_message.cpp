@@ -33,6 +33,7 @@
 
 #include <netinet/in.h> 
 #include <string.h>
+#include <pthread.h>
 #include <cctype>
 #include <fstream>
 #include <ostream>
@@ -73,14 +74,121 @@ const char* const NetMsgError::errstr[] =
  */
 const uint32 NetMsg::max_size = 128000;
 
+
+/***** NetMsg buffer pool *****/
+
+/** A reference counted buffer, the data directly follows this header.
+ * Buffers of a size class are kept in a free list of the pool after the
+ * last NetMsg released them.
+ */
+struct netmsg_buffer {
+	/// number of NetMsgs using this buffer
+	uint32 refcount;
+	/// index of the size class, num_size_classes if not pooled
+	uint32 sizeclass;
+	/// link in the free list
+	netmsg_buffer* next;
+
+	uchar* data() { return reinterpret_cast<uchar*>(this + 1); }
+};
+
+/// one size class of the pool
+struct netmsg_pool_class_t {
+	pthread_mutex_t mutex;
+	netmsg_buffer* freelist;
+	uint32 count;
+};
+
+/// buffer sizes of the size classes, the last one holds every NetMsg
+static const uint32 pool_class_size[] = { 256, 1024, 4096, 16384, 65536, 128000 };
+/// maximum number of free buffers kept per size class
+static const uint32 pool_class_cache[] = { 1024, 512, 256, 64, 16, 8 };
+static const uint32 num_size_classes = sizeof(pool_class_size) / sizeof(pool_class_size[0]);
+
+// statically initialized, NetMsgs may be created during static initialization
+static netmsg_pool_class_t pool[num_size_classes] = {
+	{ PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+	{ PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+	{ PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+	{ PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+	{ PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+	{ PTHREAD_MUTEX_INITIALIZER, NULL, 0 }
+};
+
+static netmsg_pool_stats_t pool_stats = { 0, 0, 0, 0, 0 };
+
+static inline void pool_count(uint64& counter) {
+	__atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+}
+
+/** Gets a buffer of at least s bytes with a reference count of 1.
+ * @return NULL if out of memory
+ */
+static netmsg_buffer* pool_alloc(uint32 s) {
+	uint32 c = 0;
+	while (c < num_size_classes && pool_class_size[c] < s)
+		c++;
+
+	netmsg_buffer* b = NULL;
+	if (c < num_size_classes) {
+		pthread_mutex_lock(&pool[c].mutex);
+		b = pool[c].freelist;
+		if (b) {
+			pool[c].freelist = b->next;
+			pool[c].count--;
+		}
+		pthread_mutex_unlock(&pool[c].mutex);
+	}
+
+	if (b) {
+		pool_count(pool_stats.hits);
+	} else {
+		pool_count(pool_stats.misses);
+		uchar* mem = new(nothrow) uchar[sizeof(netmsg_buffer) + (c < num_size_classes ? pool_class_size[c] : s)];
+		if (!mem)
+			return NULL;
+		b = reinterpret_cast<netmsg_buffer*>(mem);
+		b->sizeclass = c;
+	}
+	b->refcount = 1;
+	b->next = NULL;
+	return b;
+}
+
+/// Drops a reference, the last one returns the buffer to the pool.
+static void pool_release(netmsg_buffer* b) {
+	if (__atomic_sub_fetch(&b->refcount, 1, __ATOMIC_ACQ_REL) != 0)
+		return;
+
+	const uint32 c = b->sizeclass;
+	if (c < num_size_classes) {
+		pthread_mutex_lock(&pool[c].mutex);
+		if (pool[c].count < pool_class_cache[c]) {
+			b->next = pool[c].freelist;
+			pool[c].freelist = b;
+			pool[c].count++;
+			b = NULL;
+		}
+		pthread_mutex_unlock(&pool[c].mutex);
+	}
+
+	if (b) {
+		pool_count(pool_stats.freed);
+		delete[] reinterpret_cast<uchar*>(b);
+	} else
+		pool_count(pool_stats.returned);
+}
+
+
 /** Creates a network message object of the desired size if possible.
  * @param s buffer size.
  */
-	NetMsg::NetMsg(uint32 s) : buf(NULL), buf_len(0), pos(NULL), buf_end(NULL), allocated(true), tlp_list() {
+	NetMsg::NetMsg(uint32 s) : buf(NULL), buf_len(0), pos(NULL), buf_end(NULL), refbuf(NULL), tlp_list() {
   if (s>max_size) throw NetMsgError(NetMsgError::ERROR_TOO_LONG);
   if (s==0) throw NetMsgError(NetMsgError::ERROR_INVALID_BUFSIZE);
-  buf = new(nothrow) uchar[s];
-  if (!buf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
+  refbuf = pool_alloc(s);
+  if (!refbuf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
+  buf = refbuf->data();
   memset(buf,0,s);
   buf_len = s;
   pos = buf;
@@ -92,13 +200,13 @@ const uint32 NetMsg::max_size = 128000;
  * @param s buffer size
  * @param copy copy the buffer or use the buffer without copying.
  */
-NetMsg::NetMsg(uchar *b, uint32 s, bool copy) : buf(NULL), buf_len(0), pos(NULL), buf_end(NULL), allocated(false), tlp_list(NULL) {
+NetMsg::NetMsg(uchar *b, uint32 s, bool copy) : buf(NULL), buf_len(0), pos(NULL), buf_end(NULL), refbuf(NULL), tlp_list(NULL) {
   if (s>max_size) throw NetMsgError(NetMsgError::ERROR_TOO_LONG);
   if (s==0) throw NetMsgError(NetMsgError::ERROR_INVALID_BUFSIZE);
   if (copy) {
-    buf = new(nothrow) uchar[s];
-    if (!buf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
-    allocated= true;
+    refbuf = pool_alloc(s);
+    if (!refbuf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
+    buf = refbuf->data();
     memcpy(buf,b,s);
   } else {
     buf=b;
@@ -111,14 +219,14 @@ NetMsg::NetMsg(uchar *b, uint32 s, bool copy) : buf(NULL), buf_len(0), pos(NULL)
 
 
 // copy constructor
-NetMsg::NetMsg(const NetMsg& n) : buf(NULL), buf_len(n.buf_len), pos(NULL), buf_end(NULL), allocated(false), 
+NetMsg::NetMsg(const NetMsg& n) : buf(NULL), buf_len(n.buf_len), pos(NULL), buf_end(NULL), refbuf(NULL), 
 				  tlp_list(n.get_TLP_list()?new TLP_list(*(n.get_TLP_list())):NULL) {
   // only copy a buffer of length > 0, otherwise we initialize as empty buffer
   if (buf_len)
   {
-	  buf = new(nothrow) uchar[buf_len];
-	  if (!buf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
-	  allocated= true;
+	  refbuf = pool_alloc(buf_len);
+	  if (!refbuf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
+	  buf = refbuf->data();
 	  memcpy(buf,n.buf,buf_len);
 	  pos = buf+(n.pos-n.buf);
 	  buf_end = buf+(buf_len-1);
@@ -126,9 +234,36 @@ NetMsg::NetMsg(const NetMsg& n) : buf(NULL), buf_len(n.buf_len), pos(NULL), buf_
 } // end copy constructor
 
 
-/** Frees the message buffer if memory was actually allocated. */
+/** Creates a network message for len bytes of n, starting at offset start.
+ * If n owns its buffer, the new NetMsg shares it without copying,
+ * otherwise the bytes are copied.
+ * @param n NetMsg that contains the data
+ * @param start offset of the first byte in n
+ * @param len number of bytes
+ */
+NetMsg::NetMsg(const NetMsg& n, uint32 start, uint32 len) : buf(NULL), buf_len(0), pos(NULL), buf_end(NULL), refbuf(NULL), tlp_list(NULL) {
+  if (len==0) throw NetMsgError(NetMsgError::ERROR_INVALID_BUFSIZE);
+  if (start>n.buf_len || len>n.buf_len-start) throw NetMsgError(NetMsgError::ERROR_TOO_SHORT);
+  if (n.refbuf) {
+    __atomic_add_fetch(&n.refbuf->refcount, 1, __ATOMIC_RELAXED);
+    refbuf = n.refbuf;
+    buf = n.buf+start;
+    pool_count(pool_stats.shared);
+  } else {
+    refbuf = pool_alloc(len);
+    if (!refbuf) throw NetMsgError(NetMsgError::ERROR_NO_MEM);
+    buf = refbuf->data();
+    memcpy(buf,n.buf+start,len);
+  } // end if shared
+  buf_len = len;
+  pos = buf;
+  buf_end = buf+(len-1);
+} // end slice constructor
+
+
+/** Releases the message buffer if it is owned by this NetMsg. */
 NetMsg::~NetMsg() {
-  if (buf && allocated) { delete[] buf; buf= 0; }
+  if (refbuf) { pool_release(refbuf); refbuf= 0; buf= 0; }
   delete tlp_list;
 } // end destructor
 
@@ -251,6 +386,22 @@ uchar* NetMsg::get_buffer() const {
 	return buf;
 } // end get_buffer
 
+/** @return true if other NetMsgs use the same buffer */
+bool NetMsg::is_shared() const {
+	return refbuf && __atomic_load_n(&refbuf->refcount, __ATOMIC_RELAXED) > 1;
+} // end is_shared
+
+/** @return a snapshot of the buffer pool counters */
+netmsg_pool_stats_t NetMsg::get_pool_stats() {
+	netmsg_pool_stats_t s;
+	s.hits = __atomic_load_n(&pool_stats.hits, __ATOMIC_RELAXED);
+	s.misses = __atomic_load_n(&pool_stats.misses, __ATOMIC_RELAXED);
+	s.returned = __atomic_load_n(&pool_stats.returned, __ATOMIC_RELAXED);
+	s.freed = __atomic_load_n(&pool_stats.freed, __ATOMIC_RELAXED);
+	s.shared = __atomic_load_n(&pool_stats.shared, __ATOMIC_RELAXED);
+	return s;
+} // end get_pool_stats
+
 
 
 /** Decode an uint8 integer.
@@ -84,6 +84,68 @@ readnl(int sock, char *buf)
   return ntread;
 }
 
+
+// fill route from an RTM_NEWROUTE or RTM_DELROUTE message
+// returns false for other messages and for routes other than IPv4 or IPv6
+bool
+parse_route(const struct nlmsghdr *nlhdrp, nlroute_t &route)
+{
+  if ( (nlhdrp->nlmsg_type != RTM_NEWROUTE && nlhdrp->nlmsg_type != RTM_DELROUTE)
+       || nlhdrp->nlmsg_len < NLMSG_LENGTH(sizeof(struct rtmsg)) )
+    return false;
+
+  const struct rtmsg *rtmsg = (const struct rtmsg *)NLMSG_DATA(nlhdrp);
+
+  if (rtmsg->rtm_family == AF_INET)
+    route.dst= netaddress("0.0.0.0", (prefix_length_t)0);
+  else if (rtmsg->rtm_family == AF_INET6)
+    route.dst= netaddress("::", (prefix_length_t)0);
+  else
+    return false;
+
+  route.table= rtmsg->rtm_table;
+  route.type= rtmsg->rtm_type;
+  route.oif= 0;
+  route.multipath= false;
+  route.has_prefsrc= false;
+  route.cloned= (rtmsg->rtm_flags & RTM_F_CLONED) != 0;
+
+  const struct rtattr *attrp = RTM_RTA(rtmsg);
+  int attrlen = RTM_PAYLOAD(nlhdrp);
+
+  for ( ; RTA_OK(attrp, attrlen); attrp = RTA_NEXT(attrp, attrlen) )
+  {
+    switch (attrp->rta_type)
+    {
+      case RTA_DST:
+	if (rtmsg->rtm_family == AF_INET && RTA_PAYLOAD(attrp) >= sizeof(struct in_addr))
+	  route.dst.set_ip(*(const struct in_addr *)RTA_DATA(attrp));
+	else if (rtmsg->rtm_family == AF_INET6 && RTA_PAYLOAD(attrp) >= sizeof(struct in6_addr))
+	  route.dst.set_ip(*(const struct in6_addr *)RTA_DATA(attrp));
+	break;
+      case RTA_TABLE:
+	if (RTA_PAYLOAD(attrp) >= sizeof(uint32))
+	  route.table= *(const uint32 *)RTA_DATA(attrp);
+	break;
+      case RTA_OIF:
+	if (RTA_PAYLOAD(attrp) >= sizeof(int))
+	  route.oif= *(const int *)RTA_DATA(attrp);
+	break;
+      case RTA_MULTIPATH:
+	route.multipath= true;
+	break;
+      case RTA_PREFSRC:
+	route.has_prefsrc= true;
+	break;
+      default:
+	break;
+    }
+  }
+  route.dst.set_pref_len(rtmsg->rtm_dst_len);
+
+  return true;
+}
+
 	} // end namespace util
 
 } // end namespace protlib
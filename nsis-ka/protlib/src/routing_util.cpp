@@ -6,22 +6,745 @@
 #include <linux/rtnetlink.h>
 
 #include "readnl.h"
+#include "logfile.h"
 
 #include <cerrno>
 #include <err.h>
+#include <map>
+#include <pthread.h>
 
 namespace protlib {
 
+  using namespace log;
+
 	namespace util {
+
+namespace {
+
+/// outgoing interface for a destination and a source address
+struct route_cache_oif_t
+{
+  route_cache_oif_t() : oif(0) {}
+
+  hostaddress src;
+  uint16 oif;
+};
+
+/// maximum number of source addresses with an outgoing interface per prefix
+const unsigned int max_oif_sources= 8;
+
+/// a route prefix and the results cached for the destinations it covers
+struct route_cache_entry_t
+{
+  route_cache_entry_t() : per_destination(false), generation(0), has_src(false), oif_count(0), oif_next(0) {}
+
+  /// drop the cached results
+  void clear() { has_src= false; oif_count= 0; oif_next= 0; }
+
+  /// results may differ between destinations of the prefix (several next
+  /// hops, or a local route that sends from the destination address), so
+  /// they are not cached
+  bool per_destination;
+  /// flush generation the results belong to
+  uint32 generation;
+
+  /// source address the kernel selects for IPv4 destinations of the prefix
+  netaddress src;
+  bool has_src;
+  /// outgoing interfaces, one per source address
+  route_cache_oif_t oifs[max_oif_sources];
+  unsigned int oif_count;
+  /// slot replaced next if all are used
+  unsigned int oif_next;
+};
+
+
+/// a route prefix: address family, length and the address bits within it
+struct route_prefix_t
+{
+  route_prefix_t(const netaddress& addr);
+  route_prefix_t(const route_prefix_t& addr, prefix_length_t len);
+
+  bool operator<(const route_prefix_t& other) const;
+
+  bool ipv4;
+  prefix_length_t len;
+  /// host byte order, bits beyond len are 0
+  uint32 words[4];
+};
+
+
+route_prefix_t::route_prefix_t(const netaddress& addr)
+  : ipv4(addr.is_ipv4()), len(addr.get_pref_len())
+{
+  memset(words, 0, sizeof(words));
+  if (ipv4)
+  {
+    struct in_addr in;
+    addr.get_ip(in);
+    words[0]= ntohl(in.s_addr);
+  }
+  else
+  {
+    struct in6_addr in6;
+    addr.get_ip(in6);
+    for (unsigned int i= 0; i < 4; i++)
+      words[i]= ntohl(in6.s6_addr32[i]);
+  }
+  *this= route_prefix_t(*this, len);
+}
+
+
+/// addr shortened to len bits
+route_prefix_t::route_prefix_t(const route_prefix_t& addr, prefix_length_t len)
+  : ipv4(addr.ipv4), len(len)
+{
+  for (unsigned int i= 0; i < 4; i++)
+  {
+    if (len >= 32 * (i + 1))
+      words[i]= addr.words[i];
+    else if (len > 32 * i)
+      words[i]= addr.words[i] & ~(0xffffffffU >> (len - 32 * i));
+    else
+      words[i]= 0;
+  }
+}
+
+
+bool
+route_prefix_t::operator<(const route_prefix_t& other) const
+{
+  if (ipv4 != other.ipv4)
+    return ipv4;
+  if (len != other.len)
+    return len < other.len;
+  for (unsigned int i= 0; i < 4; i++)
+    if (words[i] != other.words[i])
+      return words[i] < other.words[i];
+  return false;
+}
+
+
+/** Cache of source addresses and outgoing interfaces, keyed by route prefix.
+ *
+ * The cache holds the prefixes of the routes in all routing tables, read
+ * from the kernel when it starts. A destination is looked up by longest
+ * prefix match, and all destinations with the same longest matching prefix
+ * share its results: any route of any table that matches one of them is no
+ * more specific than that prefix, so it matches the others as well.
+ * Outgoing interfaces are kept per source address, up to max_oif_sources
+ * sources for a prefix.
+ *
+ * A thread listens for route, address and link changes on a NETLINK_ROUTE
+ * socket. A new or deleted route only drops the results of its own prefix,
+ * and a new prefix those of the prefix that covered it before. Prefixes of
+ * deleted routes are kept, they merely split the results further. Address
+ * and link changes can remove routes without a notification, so they drop
+ * all results. If notifications were lost, the routes are read again.
+ * Lookups share a read lock, storing results and applying changes take the
+ * write lock. Without a working netlink listener, or with more than
+ * max_entries route prefixes, nothing is cached.
+ */
+class RouteCache
+{
+public:
+  static RouteCache& instance();
+
+  /// current generation, to be passed to the store functions
+  uint32 get_generation() const { return __atomic_load_n(&generation, __ATOMIC_ACQUIRE); }
+  void invalidate();
+
+  bool lookup_src(const netaddress& dest, netaddress& src);
+  void store_src(const netaddress& dest, const netaddress& src, uint32 gen);
+  bool lookup_oif(const netaddress& dest, const hostaddress& src, uint16& oif);
+  void store_oif(const netaddress& dest, const hostaddress& src, uint16 oif, uint32 gen);
+
+  route_cache_stats_t get_stats();
+
+  /// maximum number of route prefixes, the cache is disabled when exceeded
+  static const unsigned int max_entries= 65536;
+
+private:
+  /// the route prefixes, looked up by trying the prefix lengths in use
+  struct routes_t
+  {
+    routes_t() { memset(lengths, 0, sizeof(lengths)); }
+
+    route_cache_entry_t* longest_match(const route_prefix_t& key);
+    route_cache_entry_t* find(const route_prefix_t& prefix, route_cache_entry_t*& cover);
+    bool add(const nlroute_t& route, uint16 nlmsg_flags);
+    void remove(const nlroute_t& route);
+
+    typedef std::map<route_prefix_t, route_cache_entry_t> prefixes_t;
+    prefixes_t prefixes;
+    /// number of IPv4 and IPv6 prefixes of each length
+    unsigned int lengths[2][129];
+  };
+
+  RouteCache();
+  static void create();
+
+  const route_cache_entry_t* find(const netaddress& dest) const;
+  route_cache_entry_t* find_for_store(const netaddress& dest, uint32 gen);
+  void flush();
+  bool resync();
+  void disable();
+
+  static void* listener_starter(void* argp);
+  void listener();
+
+  /// read lock for lookups, write lock for changes of routes and results
+  pthread_rwlock_t lock;
+  routes_t* routes;
+  /// results of an entry are valid if they belong to this generation
+  uint32 flush_generation;
+  /// incremented on every change, read without the lock
+  uint32 generation;
+  /// netlink listener is running
+  bool enabled;
+  int nlsock;
+
+  /// updated atomically
+  route_cache_stats_t stats;
+};
+
+
+/// entry of the longest prefix that contains key, NULL if no route does
+route_cache_entry_t*
+RouteCache::routes_t::longest_match(const route_prefix_t& key)
+{
+  const unsigned int* used= lengths[key.ipv4 ? 0 : 1];
+
+  for (int len= key.len; len >= 0; len--)
+  {
+    if (used[len] == 0)
+      continue;
+
+    prefixes_t::iterator it= prefixes.find(route_prefix_t(key, len));
+    if (it != prefixes.end())
+      return &it->second;
+  }
+
+  return NULL;
+}
+
+
+/// entry of exactly prefix, NULL if there is none; cover is then set to the
+/// entry of the longest prefix containing it
+route_cache_entry_t*
+RouteCache::routes_t::find(const route_prefix_t& prefix, route_cache_entry_t*& cover)
+{
+  prefixes_t::iterator it= prefixes.find(prefix);
+
+  cover= NULL;
+  if (it != prefixes.end())
+    return &it->second;
+
+  cover= longest_match(prefix);
+  return NULL;
+}
+
+
+/// add the prefix of a new or changed route, dropping the results the route
+/// may change; false if there are too many prefixes
+bool
+RouteCache::routes_t::add(const nlroute_t& route, uint16 nlmsg_flags)
+{
+  route_prefix_t prefix(route.dst);
+  route_cache_entry_t* cover;
+  route_cache_entry_t* entry= find(prefix, cover);
+
+  if (entry == NULL)
+  {
+    if (prefixes.size() >= max_entries)
+      return false;
+
+    // destinations of the new prefix used the covering one so far, whose
+    // results may already stem from the new route
+    if (cover)
+      cover->clear();
+
+    entry= &prefixes[prefix];
+    lengths[prefix.ipv4 ? 0 : 1][prefix.len]++;
+  }
+
+  // a next hop appended to the route makes it a multipath route
+  if (route.multipath || (nlmsg_flags & NLM_F_APPEND)
+      || (route.type == RTN_LOCAL && !route.has_prefsrc))
+    entry->per_destination= true;
+  entry->clear();
+
+  return true;
+}
+
+
+/// drop the results of the prefix of a deleted route
+void
+RouteCache::routes_t::remove(const nlroute_t& route)
+{
+  route_cache_entry_t* cover;
+  route_cache_entry_t* entry= find(route_prefix_t(route.dst), cover);
+
+  if (entry)
+    entry->clear();
+}
+
+
+pthread_once_t route_cache_once= PTHREAD_ONCE_INIT;
+RouteCache* route_cache= NULL;
+
+void
+RouteCache::create()
+{
+  // never deleted, the netlink listener runs until the process exits
+  route_cache= new RouteCache();
+}
+
+
+RouteCache&
+RouteCache::instance()
+{
+  pthread_once(&route_cache_once, create);
+  return *route_cache;
+}
+
+
+RouteCache::RouteCache()
+  : routes(new routes_t()),
+    flush_generation(0),
+    generation(0),
+    enabled(false),
+    nlsock(-1)
+{
+  struct sockaddr_nl nladdr;
+  pthread_t tid;
+
+  pthread_rwlock_init(&lock, NULL);
+  memset(&stats, 0, sizeof(stats));
+
+  nlsock= socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (nlsock < 0)
+  {
+    ERRLog("RouteCache", "cannot open netlink socket, route cache disabled: " << strerror(errno));
+    return;
+  }
+
+  // subscribe before reading the routes, so that no change is missed
+  memset(&nladdr, 0, sizeof(nladdr));
+  nladdr.nl_family= AF_NETLINK;
+  nladdr.nl_groups= RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR | RTMGRP_IPV4_ROUTE | RTMGRP_IPV6_ROUTE;
+  if (bind(nlsock, (struct sockaddr *)&nladdr, sizeof(nladdr)) < 0)
+  {
+    ERRLog("RouteCache", "cannot subscribe to netlink route events, route cache disabled: " << strerror(errno));
+    close(nlsock);
+    nlsock= -1;
+    return;
+  }
+
+  if (!resync())
+  {
+    close(nlsock);
+    nlsock= -1;
+    return;
+  }
+
+  enabled= true;
+  if (pthread_create(&tid, NULL, listener_starter, this) != 0)
+  {
+    ERRLog("RouteCache", "cannot start netlink listener, route cache disabled");
+    enabled= false;
+    close(nlsock);
+    nlsock= -1;
+    return;
+  }
+  pthread_detach(tid);
+}
+
+
+void*
+RouteCache::listener_starter(void* argp)
+{
+  static_cast<RouteCache*>(argp)->listener();
+  return NULL;
+}
+
+
+/// read all routes from the kernel and replace the route prefixes by theirs
+bool
+RouteCache::resync()
+{
+  struct {
+    struct nlmsghdr n;
+    struct rtmsg r;
+  } req;
+  char buf[NL_BUFSIZE];
+  routes_t* fresh= new routes_t();
+  bool done= false;
+  bool ok= true;
+
+  int sock= socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (sock < 0)
+  {
+    ERRLog("RouteCache", "cannot open netlink socket to read routes, route cache disabled: " << strerror(errno));
+    delete fresh;
+    return false;
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.n.nlmsg_len= NLMSG_LENGTH(sizeof(req.r));
+  req.n.nlmsg_type= RTM_GETROUTE;
+  req.n.nlmsg_flags= NLM_F_REQUEST | NLM_F_DUMP;
+  req.r.rtm_family= AF_UNSPEC;
+  if (send(sock, &req, req.n.nlmsg_len, 0) < 0)
+  {
+    ERRLog("RouteCache", "cannot request routes, route cache disabled: " << strerror(errno));
+    ok= false;
+  }
+
+  while (ok && !done)
+  {
+    ssize_t len= recv(sock, buf, sizeof(buf), 0);
+    if (len < 0 && errno == EINTR)
+      continue;
+    if (len <= 0)
+    {
+      ERRLog("RouteCache", "cannot read routes, route cache disabled: " << strerror(errno));
+      ok= false;
+      break;
+    }
+
+    for (struct nlmsghdr* nlhdrp= (struct nlmsghdr *)buf; NLMSG_OK(nlhdrp, (uint32)len); nlhdrp= NLMSG_NEXT(nlhdrp, len))
+    {
+      nlroute_t route;
+
+      if (nlhdrp->nlmsg_type == NLMSG_DONE)
+      {
+	done= true;
+	break;
+      }
+      if (nlhdrp->nlmsg_type == NLMSG_ERROR)
+      {
+	ERRLog("RouteCache", "kernel refused to list routes, route cache disabled");
+	ok= false;
+	break;
+      }
+      if (parse_route(nlhdrp, route) && !route.cloned && !fresh->add(route, 0))
+      {
+	ERRLog("RouteCache", "more than " << max_entries << " route prefixes, route cache disabled");
+	ok= false;
+	break;
+      }
+    }
+  }
+  close(sock);
+
+  if (!ok)
+  {
+    delete fresh;
+    return false;
+  }
+
+  pthread_rwlock_wrlock(&lock);
+  delete routes;
+  routes= fresh;
+  flush();
+  pthread_rwlock_unlock(&lock);
+
+  return true;
+}
+
+
+/// stop caching for good
+void
+RouteCache::disable()
+{
+  __atomic_store_n(&enabled, false, __ATOMIC_RELEASE);
+  invalidate();
+}
+
+
+/// apply route changes to the prefixes and drop the results they affect
+void
+RouteCache::listener()
+{
+  char buf[NL_BUFSIZE];
+  ssize_t len;
+
+  while (true)
+  {
+    len= recv(nlsock, buf, sizeof(buf), 0);
+    if (len < 0)
+    {
+      if (errno == EINTR)
+	continue;
+      // ENOBUFS: notifications were lost, so any route may have changed
+      if (errno == ENOBUFS)
+      {
+	__atomic_fetch_add(&stats.invalidations, 1, __ATOMIC_RELAXED);
+	if (resync())
+	  continue;
+      }
+      else
+	ERRLog("RouteCache", "error reading netlink socket, route cache disabled: " << strerror(errno));
+      disable();
+      return;
+    }
+
+    bool too_many= false;
+
+    pthread_rwlock_wrlock(&lock);
+    for (struct nlmsghdr* nlhdrp= (struct nlmsghdr *)buf; NLMSG_OK(nlhdrp, (uint32)len); nlhdrp= NLMSG_NEXT(nlhdrp, len))
+    {
+      nlroute_t route;
+
+      switch (nlhdrp->nlmsg_type)
+      {
+	case RTM_NEWROUTE:
+	case RTM_DELROUTE:
+	  if (!parse_route(nlhdrp, route) || route.cloned)
+	    break;
+	  if (nlhdrp->nlmsg_type == RTM_DELROUTE)
+	    routes->remove(route);
+	  else if (!routes->add(route, nlhdrp->nlmsg_flags))
+	    too_many= true;
+	  __atomic_fetch_add(&generation, 1, __ATOMIC_ACQ_REL);
+	  __atomic_fetch_add(&stats.invalidations, 1, __ATOMIC_RELAXED);
+	  break;
+	case RTM_NEWADDR:
+	case RTM_DELADDR:
+	case RTM_NEWLINK:
+	case RTM_DELLINK:
+	  __atomic_fetch_add(&stats.invalidations, 1, __ATOMIC_RELAXED);
+	  flush();
+	  break;
+	default:
+	  break;
+      }
+    }
+    pthread_rwlock_unlock(&lock);
+
+    if (too_many)
+    {
+      ERRLog("RouteCache", "more than " << max_entries << " route prefixes, route cache disabled");
+      disable();
+      return;
+    }
+  }
+}
+
+
+void
+RouteCache::invalidate()
+{
+  __atomic_fetch_add(&stats.invalidations, 1, __ATOMIC_RELAXED);
+  pthread_rwlock_wrlock(&lock);
+  flush();
+  pthread_rwlock_unlock(&lock);
+}
+
+
+/// drop the results of all entries, write lock must be held
+void
+RouteCache::flush()
+{
+  flush_generation++;
+  __atomic_fetch_add(&generation, 1, __ATOMIC_ACQ_REL);
+  __atomic_fetch_add(&stats.flushes, 1, __ATOMIC_RELAXED);
+}
+
+
+/// entry with cached results for dest, NULL if there is none, lock must be held
+const route_cache_entry_t*
+RouteCache::find(const netaddress& dest) const
+{
+  const route_cache_entry_t* entry= routes->longest_match(route_prefix_t(dest));
+
+  if (entry == NULL || entry->per_destination || entry->generation != flush_generation)
+    return NULL;
+
+  return entry;
+}
+
+
+/// entry to store results for dest in, NULL if they cannot be cached or gen
+/// is outdated, write lock must be held
+route_cache_entry_t*
+RouteCache::find_for_store(const netaddress& dest, uint32 gen)
+{
+  // routes changed while the result was resolved
+  if (gen != get_generation())
+    return NULL;
+
+  route_cache_entry_t* entry= routes->longest_match(route_prefix_t(dest));
+
+  if (entry == NULL || entry->per_destination)
+    return NULL;
+
+  if (entry->generation != flush_generation)
+  {
+    entry->clear();
+    entry->generation= flush_generation;
+  }
+
+  return entry;
+}
+
+
+bool
+RouteCache::lookup_src(const netaddress& dest, netaddress& src)
+{
+  bool found= false;
+
+  if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+  {
+    __atomic_fetch_add(&stats.misses, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  pthread_rwlock_rdlock(&lock);
+  const route_cache_entry_t* entry= find(dest);
+  if (entry && entry->has_src)
+  {
+    src= entry->src;
+    found= true;
+  }
+  pthread_rwlock_unlock(&lock);
+
+  __atomic_fetch_add(found ? &stats.hits : &stats.misses, 1, __ATOMIC_RELAXED);
+
+  return found;
+}
+
+
+void
+RouteCache::store_src(const netaddress& dest, const netaddress& src, uint32 gen)
+{
+  if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+    return;
+
+  // IPv6 selects the source address by the destination itself (RFC 6724,
+  // rule 8), not by the route
+  if (!dest.is_ipv4())
+    return;
+
+  pthread_rwlock_wrlock(&lock);
+  route_cache_entry_t* entry= find_for_store(dest, gen);
+  if (entry)
+  {
+    entry->src= src;
+    entry->has_src= true;
+  }
+  pthread_rwlock_unlock(&lock);
+}
+
+
+bool
+RouteCache::lookup_oif(const netaddress& dest, const hostaddress& src, uint16& oif)
+{
+  bool found= false;
+
+  if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+  {
+    __atomic_fetch_add(&stats.misses, 1, __ATOMIC_RELAXED);
+    return false;
+  }
+
+  pthread_rwlock_rdlock(&lock);
+  const route_cache_entry_t* entry= find(dest);
+  for (unsigned int i= 0; entry && i < entry->oif_count; i++)
+  {
+    if (entry->oifs[i].src == src)
+    {
+      oif= entry->oifs[i].oif;
+      found= true;
+      break;
+    }
+  }
+  pthread_rwlock_unlock(&lock);
+
+  __atomic_fetch_add(found ? &stats.hits : &stats.misses, 1, __ATOMIC_RELAXED);
+
+  return found;
+}
+
+
+void
+RouteCache::store_oif(const netaddress& dest, const hostaddress& src, uint16 oif, uint32 gen)
+{
+  if (!__atomic_load_n(&enabled, __ATOMIC_ACQUIRE))
+    return;
+
+  pthread_rwlock_wrlock(&lock);
+  route_cache_entry_t* entry= find_for_store(dest, gen);
+  if (entry)
+  {
+    unsigned int i= 0;
+    while (i < entry->oif_count && !(entry->oifs[i].src == src))
+      i++;
+
+    // unknown source: use a free slot or replace the sources in turn
+    if (i == entry->oif_count)
+    {
+      if (entry->oif_count < max_oif_sources)
+	entry->oif_count++;
+      else
+      {
+	i= entry->oif_next;
+	entry->oif_next= (entry->oif_next + 1) % max_oif_sources;
+      }
+      entry->oifs[i].src= src;
+    }
+    entry->oifs[i].oif= oif;
+  }
+  pthread_rwlock_unlock(&lock);
+}
+
+
+route_cache_stats_t
+RouteCache::get_stats()
+{
+  route_cache_stats_t result;
+
+  result.hits= __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+  result.misses= __atomic_load_n(&stats.misses, __ATOMIC_RELAXED);
+  result.invalidations= __atomic_load_n(&stats.invalidations, __ATOMIC_RELAXED);
+  result.flushes= __atomic_load_n(&stats.flushes, __ATOMIC_RELAXED);
+  result.enabled= __atomic_load_n(&enabled, __ATOMIC_ACQUIRE);
+  pthread_rwlock_rdlock(&lock);
+  result.entries= routes->prefixes.size();
+  pthread_rwlock_unlock(&lock);
+
+  return result;
+}
+
+
+/// cache key for a destination: plain IPv4 or IPv6 host address
+netaddress
+route_cache_key(const hostaddress& dest)
+{
+  netaddress key(dest);
+
+  key.convert_to_ipv4();
+  key.set_pref_len(key.is_ipv4() ? 32 : 128);
+
+  return key;
+}
+
+} // end anonymous namespace
+
+
 /**
  * Returns the interface number the kernel would use for this address
  *
  * This depends on the Direction flag (upstream/downstream).
+ * If sourceaddress is unspecified, the route is looked up by destination
+ * only. Otherwise it must be a local address, the kernel rejects the
+ * lookup for any other source.
  *
  * TODO: Review and cleanup necessary.
  */
-uint16 
-get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
+static uint16 
+resolve_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
 {
     //#######################################################################
     //
@@ -37,6 +760,9 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
     // We must decide whether IPv4 or IPv6 is used
     bool ipv6 = destaddress.is_ipv6();
 
+    // the source address is optional
+    bool with_src = !sourceaddress.is_ip_unspec();
+
 
     // 2 sockaddr_in6?
     struct in6_addr dstaddr, srcaddr;
@@ -75,17 +801,18 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
 	if (ipv6) {
 
 	    destaddress.get_ip(dstaddr);
-	    sourceaddress.get_ip(srcaddr);
+	    if (with_src)
+		sourceaddress.get_ip(srcaddr);
 
 	    memset(&req, 0, sizeof(req));
 	    req.n.nlmsg_len =
 		NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))) +
-		RTA_LENGTH(sizeof(dstaddr)) + RTA_LENGTH(sizeof(srcaddr));
+		RTA_LENGTH(sizeof(dstaddr)) + (with_src ? RTA_LENGTH(sizeof(srcaddr)) : 0);
 	    req.n.nlmsg_flags = NLM_F_REQUEST;
 	    req.n.nlmsg_type = RTM_GETROUTE;
 	    req.r.rtm_family = AF_INET6;
 	    req.r.rtm_dst_len = 128;
-	    req.r.rtm_src_len = 128;
+	    req.r.rtm_src_len = with_src ? 128 : 0;
 
 	    attr = (rtattr*) (((char *) &req) + NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))));
 	    attr->rta_type = RTA_DST;
@@ -93,11 +820,13 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
 
 	    memcpy(RTA_DATA(attr), &dstaddr, sizeof(dstaddr));
 
-	    attr2 = (rtattr*) (((char*) &req) + NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))) + attr->rta_len);
-	    attr2->rta_type = RTA_SRC;
-	    attr2->rta_len = RTA_LENGTH(sizeof(srcaddr));
+	    if (with_src) {
+		attr2 = (rtattr*) (((char*) &req) + NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))) + attr->rta_len);
+		attr2->rta_type = RTA_SRC;
+		attr2->rta_len = RTA_LENGTH(sizeof(srcaddr));
 
-	    memcpy(RTA_DATA(attr2), &srcaddr, sizeof(srcaddr));
+		memcpy(RTA_DATA(attr2), &srcaddr, sizeof(srcaddr));
+	    }
 
 	    // Send to Kernel
 
@@ -117,30 +846,17 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
 	    if (read < 0) return 0;
 
 	    nlmsghdr* nlhdrp = (struct nlmsghdr *)returnbuf;
+	    nlroute_t route;
 
-	    rtmsg* rtmsg = (struct rtmsg*)NLMSG_DATA(nlhdrp);
-	    
-
-	    // Iterate through data area serachin
-
-	    rtattr* attrp = RTM_RTA(rtmsg);
-	    uint32 attrlen = RTM_PAYLOAD(nlhdrp);
-
-	    for( ; RTA_OK(attrp, attrlen); attrp = RTA_NEXT(attrp, attrlen) ){
+	    if (parse_route(nlhdrp, route) && route.oif) {
 
-		
-		if ((attrp->rta_type) == RTA_OIF) {
-		    
-		    char* ifname= new char[IF_NAMESIZE];
-		    if_indextoname(*(int *)RTA_DATA(attrp), ifname);
-
-		    Log(EVENT_LOG, LOG_NORMAL, "mri_pathcoupled",  "Kernel decided the outgoing interface index should be " << *(int *)RTA_DATA(attrp) << ", interface Name " << ifname);
-		
-		    outgoinginterface=*(int *)RTA_DATA(attrp);
-		    delete ifname;
-		}
+		char* ifname= new char[IF_NAMESIZE];
+		if_indextoname(route.oif, ifname);
 
+		Log(EVENT_LOG, LOG_NORMAL, "mri_pathcoupled",  "Kernel decided the outgoing interface index should be " << route.oif << ", interface Name " << ifname);
 
+		outgoinginterface=route.oif;
+		delete ifname;
 	    }
 
 	} //end if IPv6
@@ -149,19 +865,20 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
 	    //cout << "IPv4 used, query for IPv4" << endl;
 
 	    destaddress.get_ip(dstaddr4);
-	    sourceaddress.get_ip(srcaddr4);
+	    if (with_src)
+		sourceaddress.get_ip(srcaddr4);
 
 	    //cout << "Got socket addresses from data structures" << endl;
 	    
 	    memset(&req, 0, sizeof(req));
 	    req.n.nlmsg_len =
 		NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))) +
-		RTA_LENGTH(sizeof(dstaddr4)) + RTA_LENGTH(sizeof(srcaddr4));
+		RTA_LENGTH(sizeof(dstaddr4)) + (with_src ? RTA_LENGTH(sizeof(srcaddr4)) : 0);
 	    req.n.nlmsg_flags = NLM_F_REQUEST;
 	    req.n.nlmsg_type = RTM_GETROUTE;
 	    req.r.rtm_family = AF_INET;
 	    req.r.rtm_dst_len = 12;
-	    req.r.rtm_src_len = 12;
+	    req.r.rtm_src_len = with_src ? 12 : 0;
 
 	    attr = (rtattr*) (((char *) &req) + NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))));
 	    attr->rta_type = RTA_DST;
@@ -169,12 +886,14 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
 
 	    memcpy(RTA_DATA(attr), &dstaddr4, sizeof(dstaddr4));
 
-	    attr2 = (rtattr*) (((char*) &req) + NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))) + RTA_LENGTH(sizeof(dstaddr4)));
-	    attr2->rta_type = RTA_SRC;
-	    attr2->rta_len = RTA_LENGTH(sizeof(srcaddr4));
+	    if (with_src) {
+		attr2 = (rtattr*) (((char*) &req) + NLMSG_ALIGN(NLMSG_LENGTH(sizeof(req.r))) + RTA_LENGTH(sizeof(dstaddr4)));
+		attr2->rta_type = RTA_SRC;
+		attr2->rta_len = RTA_LENGTH(sizeof(srcaddr4));
 
 
-	    memcpy(RTA_DATA(attr2), &srcaddr4, sizeof(srcaddr4));
+		memcpy(RTA_DATA(attr2), &srcaddr4, sizeof(srcaddr4));
+	    }
 
 
 	    // Send to Kernel
@@ -193,27 +912,17 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
 	    if (read <0 ) return 0;
 
 	    nlmsghdr* nlhdrp = (struct nlmsghdr *)returnbuf;
+	    nlroute_t route;
 
-	    rtmsg* rtmsg = (struct rtmsg*)NLMSG_DATA(nlhdrp);
-	    
-	    // Iterate through data area serachin
-	    rtattr* attrp = RTM_RTA(rtmsg);
-	    uint32 attrlen = RTM_PAYLOAD(nlhdrp);
+	    if (parse_route(nlhdrp, route) && route.oif) {
 
-	    for( ; RTA_OK(attrp, attrlen); attrp = RTA_NEXT(attrp, attrlen) ){
-
-		if ((attrp->rta_type) == RTA_OIF) {
-		    
-		    char* ifname= new char[IF_NAMESIZE];
-		    if_indextoname(*(int *)RTA_DATA(attrp), ifname);
-
-		    Log(EVENT_LOG, LOG_NORMAL, "mri_pathcoupled",  "Linux Kernel decided the outgoing interface index should be " << *(int *)RTA_DATA(attrp) << ", interface Name " << ifname);
-		
-		    outgoinginterface=*(int *)RTA_DATA(attrp);
-		    delete ifname;
-		}
+		char* ifname= new char[IF_NAMESIZE];
+		if_indextoname(route.oif, ifname);
 
+		Log(EVENT_LOG, LOG_NORMAL, "mri_pathcoupled",  "Linux Kernel decided the outgoing interface index should be " << route.oif << ", interface Name " << ifname);
 
+		outgoinginterface=route.oif;
+		delete ifname;
 	    }
 
 	    if (returnbuf) delete returnbuf;
@@ -235,8 +944,8 @@ get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
  * returns a source address used for forwarding an outgoing 
  * packet with a given destination address
  **/
-netaddress *
-get_src_addr(const netaddress &dest)
+static netaddress *
+resolve_src_addr(const netaddress &dest)
 {
 	netaddress *res;
 	int sfd;
@@ -299,6 +1008,80 @@ get_src_addr(const netaddress &dest)
 	}
 }
 
+
+/**
+ * Returns the interface number the kernel would use for this address,
+ * answered from the route cache if possible.
+ * sourceaddress must be a local address or unspecified.
+ */
+uint16
+get_local_if(const hostaddress& sourceaddress, const hostaddress& destaddress)
+{
+	RouteCache& cache = RouteCache::instance();
+	netaddress key = route_cache_key(destaddress);
+	uint32 gen = cache.get_generation();
+	uint16 oif;
+
+	if (cache.lookup_oif(key, sourceaddress, oif))
+		return oif;
+
+	oif = resolve_local_if(sourceaddress, destaddress);
+	if (oif)
+		cache.store_oif(key, sourceaddress, oif, gen);
+
+	return oif;
+}
+
+
+/**
+ * Returns the interface number the kernel would use for packets to
+ * destaddress, whatever their source address, e.g. for forwarded packets.
+ */
+uint16
+get_local_if(const hostaddress& destaddress)
+{
+	return get_local_if(hostaddress(), destaddress);
+}
+
+
+/**
+ * returns a source address used for forwarding an outgoing 
+ * packet with a given destination address, answered from the 
+ * route cache if possible
+ **/
+netaddress *
+get_src_addr(const netaddress &dest)
+{
+	RouteCache& cache = RouteCache::instance();
+	netaddress key = route_cache_key(dest);
+	uint32 gen = cache.get_generation();
+	netaddress src;
+	netaddress *res;
+
+	if (cache.lookup_src(key, src))
+		return new netaddress(src);
+
+	res = resolve_src_addr(key);
+	if (res != NULL)
+		cache.store_src(key, *res, gen);
+
+	return res;
+}
+
+
+route_cache_stats_t
+get_route_cache_stats()
+{
+	return RouteCache::instance().get_stats();
+}
+
+
+void
+invalidate_route_cache()
+{
+	RouteCache::instance().invalidate();
+}
+
 	} // end namespace
 
 } // end namespace
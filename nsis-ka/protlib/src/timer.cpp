@@ -34,6 +34,12 @@
  * Timers are stored in an ordered list to ease checking for elapsed timers.
  * Additionally, their IDs are kept in a hash_map, so a pointer to a
  * timer object can be obtained very fast.
+ *
+ * For large numbers of timers the list can be replaced by a hierarchical
+ * timing wheel (backend_wheel). The wheel works on 1ms ticks: the root
+ * level holds the next 256 ticks, each further level covers 64 times the
+ * range of the one below. Timers in higher levels are cascaded down when
+ * the root level wraps around, so starting and stopping a timer is O(1).
  */
 
 //#define DEBUG_TIMER
@@ -94,8 +100,20 @@ static inline void gettimeofday_timespec(struct timespec& ts) {
 	ts.tv_nsec = now.tv_usec*1000;
 } // end gettimeofday_timespec
 
+/** Wheel tick of a timespec, rounded up so that timers never fire early. */
+static inline uint64 timespec_to_tick(const struct timespec& ts) {
+	return (uint64)ts.tv_sec*1000 + (ts.tv_nsec + 999999)/1000000;
+} // end timespec_to_tick
+
+static inline void tick_to_timespec(uint64 tick, struct timespec& ts) {
+	ts.tv_sec = tick/1000;
+	ts.tv_nsec = (tick%1000)*1000000;
+} // end tick_to_timespec
+
 /** Initialize a TimerManager object. */
-TimerManager::TimerManager() 
+TimerManager::TimerManager(backend_t b) 
+  : backend(b),
+    wheel_tick(0)
 {
   pthread_mutexattr_init(&mutex_attr);
 #ifdef _DEBUG
@@ -107,7 +125,13 @@ TimerManager::TimerManager()
   pthread_mutex_init(&mutex,&mutex_attr);
   pthread_cond_init(&cond,NULL);
 
-  Log(DEBUG_LOG,LOG_NORMAL, "Timer", "Creating TimerManager");
+  for (uint32 i = 0; i < wheel_slots; i++) wheel[i] = NULL;
+  for (uint32 l = 0; l < wheel_levels; l++) wheel_count[l] = 0;
+  struct timespec now;
+  gettimeofday_timespec(now);
+  wheel_tick = timespec_to_tick(now);
+
+  Log(DEBUG_LOG,LOG_NORMAL, "Timer", "Creating TimerManager (" << (backend==backend_wheel ? "timing wheel" : "sorted list") << ")");
 } // end constructor TimerManager
 
 /** Destroy TimerManager. */
@@ -144,8 +168,8 @@ TimerManager::start_relative(TimerCallback* tc, int32 sec, int32 msec, timer_cal
   t = new(nothrow) timer(alarm,tc,tcp);
   if (t) {
     result = t->id;
-    // insert into list
-    insert_into_list(t);
+    // insert into list or wheel
+    schedule(t);
     // insert into hash
     hashmap[result] = t;
     // wake up threads
@@ -173,8 +197,8 @@ TimerManager::start_absolute(TimerCallback* tc, int32 sec, int32 msec, timer_cal
   t = new(nothrow) timer(alarm,tc,tcp);
   if (t) {
     result = t->id;
-    // insert into list
-    insert_into_list(t);
+    // insert into list or wheel
+    schedule(t);
     // insert into hash
     hashmap[result] = t;
     // wake up threads
@@ -210,9 +234,9 @@ TimerManager::restart_relative(timer_id_t id, int32 sec, int32 msec)
   if ((hit=hashmap.find(id))!=hashmap.end()) t = hit->second; else t = NULL;
   if (t) {
     // delete from list, set new alarm and insert
-    delete_from_list(t);
+    unschedule(t);
     t->time = alarm;
-    insert_into_list(t);
+    schedule(t);
     // wake up threads
     pthread_cond_signal(&cond);
     result = true;
@@ -242,9 +266,9 @@ TimerManager::restart_absolute(timer_id_t id, int32 sec, int32 msec)
   if ((hit=hashmap.find(id))!=hashmap.end()) t = hit->second; else t = NULL;
   if (t) {
     // delete from list, set new alarm and insert
-    delete_from_list(t);
+    unschedule(t);
     t->time = alarm;
-    insert_into_list(t);
+    schedule(t);
     // wake up threads
     pthread_cond_signal(&cond);
     result = true;
@@ -270,7 +294,8 @@ bool TimerManager::stop(timer_id_t id)
   } else t = NULL;
   // delete from list if t exists
   if (t) {
-    delete_from_list(t);
+    unschedule(t);
+    delete t;
     // wake up threads
     pthread_cond_signal(&cond);
     result = true;
@@ -308,6 +333,7 @@ TimerManager::check_timers_wait(int32 msec)
   // calculate timespec for pthread_cond_timedwait()
   add_timespecs(now,reltime,abstime);
   timer maxwait(abstime,NULL,NULL,false);
+  timer next(abstime,NULL,NULL,false);
   // begin critical section
   pthread_mutex_lock(&mutex); // install_cleanup_mutex_lock(&mutex);
   // look for elapsed timers until timeout
@@ -316,7 +342,7 @@ TimerManager::check_timers_wait(int32 msec)
     // neither timeout nor elapsed timers
     // if there is a timer in the list, wait until it elapses.
     // otherwise wait abstime.
-    if (first() && ((*first())<=maxwait)) abstime = first()->time;
+    if (next_event(next.time) && (next<=maxwait)) abstime = next.time;
     else abstime = maxwait.time;
     // wait for condition or timeout
     wait_res = pthread_cond_timedwait(&cond,&mutex,&abstime);
@@ -350,6 +376,17 @@ TimerManager::stop_all()
   return result;
 } // end stop_all_timers
 
+/** Return the number of running timers. */
+uint32
+TimerManager::get_num_active()
+{
+  uint32 result = 0;
+  pthread_mutex_lock(&mutex);
+  result = hashmap.size();
+  pthread_mutex_unlock(&mutex);
+  return result;
+} // end get_num_active
+
 /** Stop all timers without locking the mutex.
  * So this can be called safely inside the TimerManager constructor.
  */
@@ -359,6 +396,21 @@ TimerManager::cleanup()
   uint32 num = 0;
   // clear hashmap
   hashmap.clear();
+
+  // delete all timers in the wheel
+  for (uint32 i = 0; i < wheel_slots; i++)
+  {
+    timer *t = wheel[i];
+    while (t)
+    {
+      timer *next = t->next;
+      delete t;
+      num++;
+      t = next;
+    }
+    wheel[i] = NULL;
+  } // end for
+  for (uint32 l = 0; l < wheel_levels; l++) wheel_count[l] = 0;
   
   // delete all timers
   timer *curr= 0;
@@ -374,6 +426,50 @@ TimerManager::cleanup()
   return num;
 } // end cleanup
 
+/** Insert a timer into the list or the wheel, depending on the backend. */
+inline
+void
+TimerManager::schedule(timer *t)
+{
+  if (backend == backend_wheel)
+  {
+    t->tick = timespec_to_tick(t->time);
+    insert_into_wheel(t);
+  }
+  else
+    insert_into_list(t);
+} // end schedule
+
+/** Remove a timer from the list or the wheel, depending on the backend.
+ * The timer object is NOT freed.
+ */
+inline
+void
+TimerManager::unschedule(timer *t)
+{
+  if (backend == backend_wheel)
+    delete_from_wheel(t);
+  else
+    delete_from_list(t);
+} // end unschedule
+
+/** Get the alarm time of the earliest timer. For the wheel backend this may
+ * be earlier than the real alarm time, namely when the next cascade is due.
+ * @return false if there are no timers.
+ */
+inline
+bool
+TimerManager::next_event(struct timespec& ts)
+{
+  if (backend == backend_wheel)
+    return next_wheel_event(ts);
+
+  if (!first())
+    return false;
+  ts = first()->time;
+  return true;
+} // end next_event
+
 /** Insert a timer object into the timer list.
  * Timers are stored in an ordered list, so when checking for elapsed timers
  * it's enough to check timers beginning at the front end until one is
@@ -435,6 +531,169 @@ TimerManager::delete_from_list(timer *t) {
 #endif
 } // end delete_from_list
 
+/** Link a timer into the wheel slot that matches its tick.
+ * Timers that are already due go into the slot processed next, timers
+ * further away than the wheel range are parked in the last level and
+ * cascaded again until they fit.
+ */
+void
+TimerManager::insert_into_wheel(timer *t)
+{
+  uint64 expires = t->tick;
+  uint32 level = 0;
+  uint32 slot = 0;
+
+  if (expires < wheel_tick)
+    expires = wheel_tick;
+  uint64 delta = expires - wheel_tick;
+
+  if (delta < wheel_root_size)
+    slot = expires & (wheel_root_size-1);
+  else
+  {
+    // find the lowest level covering delta
+    uint32 shift = wheel_root_bits;
+    for (level = 1; level < wheel_levels-1; level++, shift += wheel_level_bits)
+    {
+      if (delta < ((uint64)1 << (shift + wheel_level_bits)))
+	break;
+    }
+    if (delta >= ((uint64)1 << (shift + wheel_level_bits)))
+      expires = wheel_tick + ((uint64)1 << (shift + wheel_level_bits)) - 1;
+    slot = wheel_root_size + (level-1)*wheel_level_size
+      + ((expires >> shift) & (wheel_level_size-1));
+  }
+
+  t->slot = slot;
+  t->prev = NULL;
+  t->next = wheel[slot];
+  if (t->next)
+    t->next->prev = t;
+  wheel[slot] = t;
+  wheel_count[level]++;
+} // end insert_into_wheel
+
+/** Unlink a timer from its wheel slot.
+ * The timer object is NOT freed.
+ */
+void
+TimerManager::delete_from_wheel(timer *t)
+{
+  if (!t) return;
+
+  if (t->prev)
+    t->prev->next = t->next;
+  else
+    wheel[t->slot] = t->next;
+  if (t->next)
+    t->next->prev = t->prev;
+  t->prev = t->next = NULL;
+
+  uint32 level = (t->slot < wheel_root_size) ? 0 : 1 + (t->slot - wheel_root_size)/wheel_level_size;
+  wheel_count[level]--;
+} // end delete_from_wheel
+
+/** Re-insert all timers of the current slot of the given level (>0), so
+ * they move to lower levels.
+ * @return true if the level wrapped around and the next level must be
+ * cascaded as well.
+ */
+bool
+TimerManager::cascade_wheel(uint32 level)
+{
+  uint32 shift = wheel_root_bits + (level-1)*wheel_level_bits;
+  uint32 index = (wheel_tick >> shift) & (wheel_level_size-1);
+  uint32 slot = wheel_root_size + (level-1)*wheel_level_size + index;
+
+  timer *t = wheel[slot];
+  wheel[slot] = NULL;
+  while (t)
+  {
+    timer *next = t->next;
+    wheel_count[level]--;
+    insert_into_wheel(t);
+    t = next;
+  } // end while
+  return (index == 0);
+} // end cascade_wheel
+
+/** Process all wheel ticks up to and including now. Whole slots of elapsed
+ * timers are moved to the elapsed_timerlist and removed from the hashmap.
+ * Empty stretches of the root level are skipped up to the next cascade.
+ */
+void
+TimerManager::advance_wheel(uint64 now)
+{
+  while (wheel_tick <= now)
+  {
+    uint32 total = 0;
+    for (uint32 l = 0; l < wheel_levels; l++) total += wheel_count[l];
+    if (total == 0)
+    {
+      // nothing to do, just catch up
+      wheel_tick = now + 1;
+      break;
+    }
+
+    uint32 index = wheel_tick & (wheel_root_size-1);
+    if (index == 0)
+    {
+      uint32 level = 1;
+      while (level < wheel_levels && cascade_wheel(level))
+	level++;
+    }
+
+    timer *t = wheel[index];
+    wheel[index] = NULL;
+    while (t)
+    {
+      timer *next = t->next;
+      t->prev = t->next = NULL;
+      wheel_count[0]--;
+      hashmap.erase(t->id);
+      elapsed_timerlist.push_back(t);
+      t = next;
+    } // end while
+    wheel_tick++;
+
+    if (wheel_count[0] == 0)
+    {
+      // jump to the next cascade or past now
+      uint64 boundary = ((wheel_tick + wheel_root_size - 1) >> wheel_root_bits) << wheel_root_bits;
+      wheel_tick = (boundary > now) ? now + 1 : boundary;
+    }
+  } // end while
+} // end advance_wheel
+
+/** Compute the earliest point in time at which advance_wheel() may find
+ * an elapsed timer. Only the root level is scanned, higher levels are
+ * represented by the next cascade.
+ * @return false if the wheel is empty.
+ */
+bool
+TimerManager::next_wheel_event(struct timespec& ts)
+{
+  uint32 total = 0;
+  for (uint32 l = 0; l < wheel_levels; l++) total += wheel_count[l];
+  if (total == 0)
+    return false;
+
+  uint64 next = ((wheel_tick + wheel_root_size - 1) >> wheel_root_bits) << wheel_root_bits;
+  if (wheel_count[0])
+  {
+    for (uint64 tick = wheel_tick; tick < next; tick++)
+    {
+      if (wheel[tick & (wheel_root_size-1)])
+      {
+	next = tick;
+	break;
+      }
+    } // end for
+  }
+  tick_to_timespec(next, ts);
+  return true;
+} // end next_wheel_event
+
 /** Collect all elapsed timers in the elapsed_timerlist and delete them already
  * from the hashmap. The timers are deleted in process_elapsed().
  * You must lock the TimerManager mutex before collecting timers.
@@ -447,6 +706,9 @@ TimerManager::collect_elapsed()
   gettimeofday_timespec(tod);
   timer now(tod,NULL,NULL,false);
 
+  if (backend == backend_wheel)
+    advance_wheel((uint64)tod.tv_sec*1000 + tod.tv_nsec/1000000);
+
   timerlist_t::iterator currentit = active_timerlist.begin();
   timer* curr= first();
 #ifdef DEBUG_TIMER
@@ -519,6 +781,9 @@ TimerManager::timer::timer(struct timespec& ts, TimerCallback* tc, timer_callbac
   param(tcp)
 {
   if (get_id) while (id==0) id = next_id++;
+  tick = 0;
+  slot = 0;
+  prev = next = NULL;
 } // end constructor timer
 
 /** This holds the timer ID of the next timer. */
@@ -203,11 +203,12 @@ bool TimerMsg::is_relative() const { return relative; }
  * @param sua send messages until aborted or just until stopped
  * @param see send error messages as expedited data
  * @param sre send reply messages as expedited data
+ * @param tb timer backend, use backend_wheel for large numbers of timers
  */
-TimerModuleParam::TimerModuleParam(uint32 sleep_time, bool sua, bool see, bool sre)
+TimerModuleParam::TimerModuleParam(uint32 sleep_time, bool sua, bool see, bool sre, TimerManager::backend_t tb)
 	: ThreadParam(sleep_time, "TimerModule", 2), send_until_abort(sua),
 	source(message::qaddr_timer), 
-	send_error_expedited(see), send_reply_expedited(sre) {
+	send_error_expedited(see), send_reply_expedited(sre), timer_backend(tb) {
 	// nothing more to do
 } // end constructor TimerModuleParam
 
@@ -215,7 +216,7 @@ TimerModuleParam::TimerModuleParam(uint32 sleep_time, bool sua, bool see, bool s
 
 /** Set parameters. */
 TimerModule::TimerModule(const TimerModuleParam& p) 
-	: Thread(p), timerparam(p) {
+	: Thread(p), tm(p.timer_backend), timerparam(p) {
 	tmap.clear();
 	// register queue
 	QueueManager::instance()->register_queue(get_fqueue(),p.source);
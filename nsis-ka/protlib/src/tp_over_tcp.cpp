@@ -39,6 +39,8 @@ extern "C"
 
 #include <fcntl.h>
 #include <sys/poll.h>
+#include <sys/epoll.h>
+#include <sys/uio.h>
 }
 
 #include <iostream>
@@ -55,6 +57,7 @@ extern "C"
 #include "protlibconf.h"
 
 #include <set>
+#include <algorithm>
 
 #define TCP_SUCCESS 0
 #define TCP_SEND_FAILURE 1
@@ -316,6 +319,28 @@ TPoverTCP::terminate(const address& in_addr)
 
   lock(); // install_cleanup_thread_lock(TPoverTCP, this);
   assoc= connmap.lookup(*addr);
+  if (assoc && tpparam.io_threads)
+  { // event loop mode: queued PDUs are still sent, the I/O thread closes the
+    // connection when the peer closed its side, too
+    EVLog(tpparam.name,thisproc<<"got request to shutdown connection for peer " << *addr);
+    evconnmap_t::const_iterator it= evconnmap.find(assoc->socketfd);
+    if (!assoc->shutdown && it != evconnmap.end())
+    {
+      evconn_t* conn= it->second;
+      ioloop_t& loop= ioloops[conn->loop];
+      pthread_mutex_lock(&loop.mutex);
+      if (conn->want_write)
+	conn->shutdown_pending= true;
+      else
+      if (shutdown(assoc->socketfd,SHUT_WR))
+	ERRLog(tpparam.name,thisproc<<"shutdown (write) on socket for peer " << *addr << " returned error:" << strerror(errno));
+      pthread_mutex_unlock(&loop.mutex);
+    }
+    assoc->shutdown= true;
+    unlock();
+    delete addr;
+    return;
+  }
   if (assoc) 
   {
     EVLog(tpparam.name,thisproc<<"got request to shutdown connection for peer " << addr);
@@ -382,6 +407,13 @@ TPoverTCP::send_cb(NetMsg* netmsg, const address& in_addr, bool use_existing_con
   } 
   addr->convert_to_ipv6();
 
+  if (tpparam.io_threads)
+  { // event loop mode: no sender threads, just queue it
+    ev_send(netmsg, addr, use_existing_connection, sentcallbackfunc);
+    delete addr;
+    return;
+  }
+
   // lock due to sendermap access
   lock();
     
@@ -1563,8 +1595,9 @@ TPoverTCP::master_listener_thread()
     }
 
     // listen at the socket, 
-    // queuesize for pending connections= max_listen_queue_size
-    int listen_status = listen(master_listener_socket, max_listen_queue_size);
+    // queuesize for pending connections= max_listen_queue_size,
+    // event loop mode is meant for thousands of peers, so use the system maximum
+    int listen_status = listen(master_listener_socket, tpparam.io_threads ? SOMAXCONN : max_listen_queue_size);
     if (listen_status)
     {
       ERRCLog(tpparam.name, "Listen at socket " << master_listener_socket 
@@ -1726,8 +1759,16 @@ TPoverTCP::master_listener_thread()
 		
 	} //end __else(connmap.insert());__
 	
-	// create a new thread for each new connection
-	create_new_receiver_thread(peer_assoc);
+	if (tpparam.io_threads)
+	{
+	  // hand the connection over to an I/O thread
+	  lock();
+	  ev_attach(peer_assoc, false);
+	  unlock();
+	}
+	else
+	  // create a new thread for each new connection
+	  create_new_receiver_thread(peer_assoc);
       } // end __else (connsocket)__
       
       // get new thread state
@@ -1738,6 +1779,621 @@ TPoverTCP::master_listener_thread()
 } // end listen_for_connections()    
 
 
+/******* event loop mode *******/
+
+/** In event loop mode (tpparam.io_threads > 0) all connections are served by
+ *  a small fixed set of I/O threads instead of one sender and one receiver
+ *  thread per peer. Each I/O thread owns an epoll instance, connections are
+ *  assigned round robin. Sockets are non-blocking, send() only appends the
+ *  PDU to the write queue of the connection and arms EPOLLOUT, the I/O thread
+ *  then coalesces all queued PDUs into a single sendmsg() call.
+ *
+ *  Locking: lock() protects connmap and evconnmap, the mutex of an I/O thread
+ *  protects the write queues of its connections (always taken after lock()).
+ *  Connections are closed and freed by their I/O thread only.
+ */
+
+/// initial size of a per connection receive buffer
+const uint32 ev_rbuf_initial_size= 4096;
+/// maximum number of PDUs written by a single sendmsg() call
+const unsigned int ev_max_iov= 64;
+/// maximum number of events fetched by a single epoll_wait() call
+const int ev_max_events= 64;
+
+
+/**
+ * I/O thread starter:
+ * just a static starter method to allow starting the
+ * actual ioloop() method.
+ *
+ * @param argp - pointer to the ioloop_t structure of the thread
+ */
+void*
+TPoverTCP::ioloop_starter(void *argp)
+{
+  ioloop_t* loop= static_cast<ioloop_t*>(argp);
+  if (loop != 0 && loop->instance != 0)
+  {
+    loop->instance->ioloop(loop);
+  }
+  else
+  {
+    Log(ERROR_LOG,LOG_CRIT,"ioloop_starter","while starting I/O thread: 0 pointer to arg or object");
+  }
+  return 0;
+}
+
+
+/** starts tpparam.io_threads I/O threads, each one with its own epoll instance
+ */
+void
+TPoverTCP::start_ioloops()
+{
+  ioloops= new ioloop_t[tpparam.io_threads];
+
+  for (uint32 i= 0; i < tpparam.io_threads; i++)
+  {
+    ioloops[i].instance= this;
+    ioloops[i].index= i;
+    ioloops[i].thread_ID= 0;
+    pthread_mutex_init(&ioloops[i].mutex, NULL);
+
+    ioloops[i].epfd= epoll_create(ev_max_events);
+    if (ioloops[i].epfd < 0)
+    {
+      ERRCLog(tpparam.name, "Could not create epoll instance for I/O thread #" << i << ": " << strerror(errno));
+      continue;
+    }
+
+    int pthread_status= pthread_create(&ioloops[i].thread_ID,
+				       NULL,
+				       ioloop_starter,
+				       &ioloops[i]);
+    if (pthread_status)
+    {
+      ERRCLog(tpparam.name, "I/O thread #" << i << " could not be created: " << strerror(pthread_status));
+      // no connections will be assigned to this loop
+      close(ioloops[i].epfd);
+      ioloops[i].epfd= -1;
+      ioloops[i].thread_ID= 0;
+    }
+  }
+  ILog(tpparam.name, "Event loop mode, started " << tpparam.io_threads << " I/O threads");
+}
+
+
+/** waits for the I/O threads to terminate and closes all remaining connections
+ *  @note the thread state must already be STATE_STOP or STATE_ABORT
+ */
+void
+TPoverTCP::stop_ioloops()
+{
+  if (ioloops == NULL)
+    return;
+
+  for (uint32 i= 0; i < tpparam.io_threads; i++)
+  {
+    if (ioloops[i].thread_ID)
+      pthread_join(ioloops[i].thread_ID, 0);
+  }
+
+  std::vector<evconn_t*> conns;
+  lock();
+  for (evconnmap_t::const_iterator it= evconnmap.begin(); it != evconnmap.end(); ++it)
+    conns.push_back(it->second);
+  unlock();
+
+  for (std::vector<evconn_t*>::iterator it= conns.begin(); it != conns.end(); ++it)
+    ev_close(*it);
+
+  for (uint32 i= 0; i < tpparam.io_threads; i++)
+  {
+    if (ioloops[i].epfd >= 0)
+      close(ioloops[i].epfd);
+    pthread_mutex_destroy(&ioloops[i].mutex);
+  }
+
+  delete[] ioloops;
+  ioloops= NULL;
+}
+
+
+/** registers a connected (or connecting) socket with an I/O thread
+ *  @note lock() must be held, assoc must already be in connmap.
+ *        On failure assoc is erased from connmap and the socket is closed.
+ */
+TPoverTCP::evconn_t*
+TPoverTCP::ev_attach(AssocData* assoc, bool connecting)
+{
+  int fd= assoc->socketfd;
+
+  // pick the next running I/O thread
+  uint32 l= 0;
+  uint32 tries= 0;
+  do
+  {
+    l= next_ioloop++ % tpparam.io_threads;
+  }
+  while (ioloops[l].epfd < 0 && ++tries < tpparam.io_threads);
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  evconn_t* conn= new(nothrow) evconn_t(assoc, l, connecting);
+  if (conn)
+  {
+    conn->rbuf.resize(ev_rbuf_initial_size);
+
+    struct epoll_event ev;
+    ev.events= connecting ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.ptr= conn;
+    if (epoll_ctl(ioloops[l].epfd, EPOLL_CTL_ADD, fd, &ev) == 0)
+    {
+      evconnmap[fd]= conn;
+      return conn;
+    }
+    ERRCLog(tpparam.name, "Cannot register socket " << fd << " with I/O thread #" << l << ": " << strerror(errno));
+    delete conn;
+  }
+  else
+    ERRCLog(tpparam.name, "Cannot allocate connection state for socket " << fd);
+
+  // also frees assoc
+  connmap.erase(assoc);
+  close(fd);
+
+  return NULL;
+}
+
+
+/** starts a non-blocking connect to addr, the I/O thread completes it
+ *  @note lock() must be held
+ */
+TPoverTCP::evconn_t*
+TPoverTCP::ev_connect(const appladdress& addr)
+{
+  const bool ipv4_only= plibconf.getpar<bool>(protlibconf_ipv4_only);
+
+  int new_socket= socket(ipv4_only ? AF_INET : AF_INET6, SOCK_STREAM, IPPROTO_TCP);
+  if (new_socket == -1)
+  {
+    ERRCLog(tpparam.name, "Couldn't create a new socket: " << strerror(errno));
+    return NULL;
+  }
+
+  // Disable Nagle Algorithm, set (TCP_NODELAY)
+  int nodelayflag= 1;
+  if (setsockopt(new_socket, IPPROTO_TCP, TCP_NODELAY, &nodelayflag, sizeof(nodelayflag)))
+  {
+    ERRLog(tpparam.name, "Could not set socket option TCP_NODELAY:" << strerror(errno));
+  }
+
+  fcntl(new_socket, F_SETFL, O_NONBLOCK);
+
+  int connect_status;
+  if (ipv4_only)
+  {
+    struct sockaddr_in dest_address_v4;
+    addr.get_sockaddr(dest_address_v4);
+    connect_status= connect(new_socket, reinterpret_cast<const struct sockaddr*>(&dest_address_v4), sizeof(dest_address_v4));
+  }
+  else
+  {
+    struct sockaddr_in6 dest_address;
+    dest_address.sin6_flowinfo= 0;
+    dest_address.sin6_scope_id= 0;
+    addr.get_sockaddr(dest_address);
+    connect_status= connect(new_socket, reinterpret_cast<const struct sockaddr*>(&dest_address), sizeof(dest_address));
+  }
+
+  if (connect_status != 0 && errno != EINPROGRESS)
+  {
+    ERRLog(tpparam.name, "Connect to " << addr.get_ip_str() << " port #" << addr.get_port()
+	   << " failed: [" << color[red] << strerror(errno) << color[off] << "]");
+    close(new_socket);
+    return NULL;
+  }
+
+  // local address is already bound even if the connect is still in progress
+  struct sockaddr_in6 own_address;
+  struct sockaddr_in own_address_v4;
+  socklen_t own_address_len= ipv4_only ? sizeof(own_address_v4) : sizeof(own_address);
+  if (ipv4_only)
+    getsockname(new_socket, reinterpret_cast<struct sockaddr*>(&own_address_v4), &own_address_len);
+  else
+    getsockname(new_socket, reinterpret_cast<struct sockaddr*>(&own_address), &own_address_len);
+
+  AssocData* assoc= new(nothrow) AssocData(new_socket, addr,
+					   ipv4_only ? appladdress(own_address_v4,IPPROTO_TCP) : appladdress(own_address,IPPROTO_TCP));
+  if (assoc == NULL || connmap.insert(assoc) == false)
+  {
+    ERRCLog(tpparam.name, "Cannot insert AssocData for socket " << new_socket << ", "<< addr.get_ip_str()
+	    <<", port #" << addr.get_port() << " into connection map, aborting connection");
+    close(new_socket);
+    delete assoc;
+    return NULL;
+  }
+
+  DLog(tpparam.name, ">>--Connect-->> to " << addr.get_ip_str() << " port #" << addr.get_port()
+       << " via socket " << new_socket << (connect_status ? " (in progress)" : ""));
+
+  return ev_attach(assoc, connect_status != 0);
+}
+
+
+/** event loop mode counterpart of send_cb(): appends netmsg to the write
+ *  queue of the connection to addr, creating the connection if allowed
+ *  @note netmsg is deleted after it was sent or dropped, addr is not
+ */
+void
+TPoverTCP::ev_send(NetMsg* netmsg, appladdress* addr, bool use_existing_connection, TPsentcallback_t sentcallbackfunc)
+{
+  try
+  {
+    check_send_args(*netmsg,*addr);
+  }
+  catch(TPError& err)
+  {
+    ERRLog(tpparam.name, "send() - " << err.what() << " - dropping data");
+    delete netmsg;
+    return;
+  }
+
+  evconn_t* conn= NULL;
+
+  lock();
+  AssocData* assoc= connmap.lookup(*addr);
+  if (assoc)
+  {
+    if (assoc->shutdown)
+    {
+      WLog(tpparam.name, "send() - connection to " << *addr << " already half closed - dropping data");
+    }
+    else
+    {
+      evconnmap_t::const_iterator it= evconnmap.find(assoc->socketfd);
+      if (it != evconnmap.end())
+	conn= it->second;
+    }
+  }
+  else
+  {
+    if (use_existing_connection)
+      DLog(tpparam.name, "no connection found for peer " << *addr << " - but policy forbids to set up a new connection, will drop data");
+    else
+      conn= ev_connect(*addr);
+  }
+
+  if (conn)
+  {
+    ioloop_t& loop= ioloops[conn->loop];
+
+    pthread_mutex_lock(&loop.mutex);
+    conn->wqueue.push_back(std::make_pair(netmsg, sentcallbackfunc));
+    if (!conn->want_write)
+    {
+      struct epoll_event ev;
+      ev.events= EPOLLIN | EPOLLOUT;
+      ev.data.ptr= conn;
+      if (epoll_ctl(loop.epfd, EPOLL_CTL_MOD, conn->assoc->socketfd, &ev) == 0)
+	conn->want_write= true;
+      else
+	ERRLog(tpparam.name, "send() - cannot wait for socket " << conn->assoc->socketfd << " to become writable: " << strerror(errno));
+    }
+    pthread_mutex_unlock(&loop.mutex);
+  }
+  unlock();
+
+  if (!conn)
+    delete netmsg;
+}
+
+
+/** reads from the socket once and delivers all complete PDUs to tpparam.dest
+ *  @return false if the connection was closed by the peer or failed
+ */
+bool
+TPoverTCP::ev_read(evconn_t* conn)
+{
+#ifndef _NO_LOGGING
+  const char *const methodname="ioloop - ";
+#endif
+  const AssocData* assoc= conn->assoc;
+
+  if (conn->rlen == conn->rbuf.size())
+  {
+    if (conn->rbuf.size() >= NetMsg::max_size)
+    {
+      ERRCLog(tpparam.name, methodname << "during receive buffer space exhausted");
+      return false;
+    }
+    conn->rbuf.resize(std::min<uint32>(2 * conn->rbuf.size(), NetMsg::max_size));
+  }
+
+  ssize_t ret= recv(assoc->socketfd, &conn->rbuf[conn->rlen], conn->rbuf.size() - conn->rlen, MSG_DONTWAIT);
+  if (ret < 0)
+  {
+    if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+      return true;
+
+    ERRCLog(tpparam.name, methodname << "Receive at socket " << assoc->socketfd << " failed, error: " << strerror(errno));
+    return false;
+  }
+
+  if (ret == 0)
+  {
+    Log(DEBUG_LOG,LOG_UNIMP, tpparam.name, methodname << "Other side (" << assoc->peer << ") closed connection for socket " << assoc->socketfd);
+    if (conn->rlen > 0)
+    {
+      Log(WARNING_LOG,LOG_NORMAL, tpparam.name, methodname << "Attention! PDU incomplete, received bytes: " << conn->rlen);
+    }
+    return false;
+  }
+
+  Log(EVENT_LOG,LOG_UNIMP, tpparam.name, methodname << "<<--Received--<< packet (" << ret << " bytes) at socket " << assoc->socketfd << " from " << assoc->peer);
+  conn->rlen+= ret;
+
+  // deliver every complete PDU in the buffer
+  uint32 offset= 0;
+  while (conn->rlen - offset >= common_header_length)
+  {
+    // parse the common header in place
+    NetMsg header(&conn->rbuf[offset], common_header_length, false);
+    uint32 msgcontentlength= 0;
+    if (!getmsglength(header, msgcontentlength))
+    {
+      ERRCLog(tpparam.name, methodname << "Not a valid protocol header - closing connection to " << assoc->peer);
+      return false;
+    }
+
+    const uint32 pdulength= common_header_length + msgcontentlength;
+    if (pdulength > NetMsg::max_size)
+    {
+      ERRCLog(tpparam.name, methodname << "PDU of " << pdulength << " bytes exceeds maximum size - closing connection to " << assoc->peer);
+      return false;
+    }
+
+    if (conn->rlen - offset < pdulength)
+      break;
+
+    NetMsg* netmsg= new NetMsg(&conn->rbuf[offset], pdulength);
+    offset+= pdulength;
+
+    if (debug_pdu)
+    {
+      ostringstream hexdump;
+      netmsg->hexdump(hexdump,netmsg->get_buffer(),pdulength);
+      DLog(tpparam.name,"PDU debugging enabled - Received:" << hexdump.str());
+    }
+
+    // create TPMsg and send it to the signaling thread, it takes over netmsg
+    TPMsg* tpmsg= new(nothrow) TPMsg(netmsg, assoc->peer.copy(), assoc->ownaddr.copy());
+    if (!tpmsg
+	|| (!tpmsg->get_peeraddress())
+	|| (!tpmsg->send(message::qaddr_tp_over_tcp, tpparam.dest)))
+    {
+      ERRLog(tpparam.name, methodname << "Cannot allocate/send TPMsg");
+      if (tpmsg)
+	delete tpmsg;
+      else
+	delete netmsg;
+    }
+  }
+
+  if (offset > 0)
+  {
+    conn->rlen-= offset;
+    if (conn->rlen > 0)
+      memmove(&conn->rbuf[0], &conn->rbuf[offset], conn->rlen);
+    else
+    if (conn->rbuf.size() > ev_rbuf_initial_size)
+      std::vector<uchar>(ev_rbuf_initial_size).swap(conn->rbuf);
+  }
+
+  return true;
+}
+
+
+/** writes as much of the write queue as the socket takes with a single
+ *  sendmsg() call and disarms EPOLLOUT once the queue is empty
+ *  @return false on a fatal socket error
+ */
+bool
+TPoverTCP::ev_write(evconn_t* conn)
+{
+#ifndef _NO_LOGGING
+  const char *const methodname="ioloop - ";
+#endif
+  ioloop_t& loop= ioloops[conn->loop];
+  const int fd= conn->assoc->socketfd;
+
+  // completely sent PDUs, deleted and reported after the mutex was released
+  NetMsg* sent[ev_max_iov];
+  TPsentcallback_t callbacks[ev_max_iov];
+  unsigned int nsent= 0;
+  bool ok= true;
+
+  pthread_mutex_lock(&loop.mutex);
+
+  struct iovec iov[ev_max_iov];
+  unsigned int iovcnt= 0;
+  for (std::deque< std::pair<NetMsg*, TPsentcallback_t> >::const_iterator it= conn->wqueue.begin();
+       it != conn->wqueue.end() && iovcnt < ev_max_iov;
+       ++it, ++iovcnt)
+  {
+    const uint32 skip= (iovcnt == 0) ? conn->woffset : 0;
+    iov[iovcnt].iov_base= it->first->get_buffer() + skip;
+    iov[iovcnt].iov_len= it->first->get_size() - skip;
+  }
+
+  if (iovcnt > 0)
+  {
+    struct msghdr mh;
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov= iov;
+    mh.msg_iovlen= iovcnt;
+
+    ssize_t ret= sendmsg(fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+    if (ret < 0)
+    {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && errno != ENOBUFS)
+      {
+	ERRLog(tpparam.name, methodname << "TCP error on socket " << fd << ", error : " << strerror(errno));
+	ok= false;
+      }
+    }
+    else
+    {
+      size_t written= ret;
+      while (!conn->wqueue.empty())
+      {
+	NetMsg* netmsg= conn->wqueue.front().first;
+	const size_t left= netmsg->get_size() - conn->woffset;
+	if (written < left)
+	{
+	  conn->woffset+= written;
+	  break;
+	}
+	written-= left;
+	conn->woffset= 0;
+	sent[nsent]= netmsg;
+	callbacks[nsent]= conn->wqueue.front().second;
+	nsent++;
+	conn->wqueue.pop_front();
+      }
+    }
+  }
+
+  if (ok && conn->wqueue.empty())
+  {
+    if (conn->shutdown_pending)
+    {
+      conn->shutdown_pending= false;
+      if (shutdown(fd, SHUT_WR))
+	ERRLog(tpparam.name, methodname << "shutdown (write) on socket " << fd << " returned error:" << strerror(errno));
+    }
+
+    struct epoll_event ev;
+    ev.events= EPOLLIN;
+    ev.data.ptr= conn;
+    if (epoll_ctl(loop.epfd, EPOLL_CTL_MOD, fd, &ev) == 0)
+      conn->want_write= false;
+  }
+
+  pthread_mutex_unlock(&loop.mutex);
+
+  for (unsigned int i= 0; i < nsent; i++)
+  {
+    EVLog(tpparam.name, methodname << ">>----Sent---->> message (" << sent[i]->get_size() << " bytes) using socket " << fd  << " to " << conn->assoc->peer);
+    delete sent[i];
+    // no confirmation of arrival, see tcpsend()
+    if (callbacks[i])
+      (*callbacks[i])(true);
+  }
+
+  return ok;
+}
+
+
+/** removes a connection from connmap and evconnmap, closes its socket and
+ *  drops everything still queued for it
+ *  @note must not be called with lock() held; conn is deleted
+ */
+void
+TPoverTCP::ev_close(evconn_t* conn)
+{
+  const int fd= conn->assoc->socketfd;
+
+  DLog(tpparam.name, "ioloop - closing connection to " << conn->assoc->peer << " on socket " << fd);
+
+  lock();
+  evconnmap.erase(fd);
+  // also frees AssocData
+  connmap.erase(conn->assoc);
+  unlock();
+
+  // nobody else can reach conn anymore
+  epoll_ctl(ioloops[conn->loop].epfd, EPOLL_CTL_DEL, fd, NULL);
+  close(fd);
+
+  if (!conn->wqueue.empty())
+  {
+    WLog(tpparam.name, "ioloop - dropping " << conn->wqueue.size() << " unsent PDUs for socket " << fd);
+    while (!conn->wqueue.empty())
+    {
+      delete conn->wqueue.front().first;
+      conn->wqueue.pop_front();
+    }
+  }
+
+  delete conn;
+}
+
+
+/** I/O thread: waits on its epoll instance and serves connect completion,
+ *  reads and writes of all connections assigned to it
+ */
+void
+TPoverTCP::ioloop(ioloop_t* loop)
+{
+  EVLog(tpparam.name, "ioloop - I/O thread #" << loop->index << " started as thread <" << pthread_self() << ">");
+
+  struct epoll_event events[ev_max_events];
+  state_t currstate= get_state();
+
+  // check whether this thread is signaled for termination
+  while (currstate!=STATE_ABORT && currstate!=STATE_STOP)
+  {
+    int nfds= epoll_wait(loop->epfd, events, ev_max_events, tpparam.sleep_time);
+    if (nfds < 0)
+    {
+      if (errno != EINTR)
+      {
+	ERRCLog(tpparam.name, "ioloop - epoll_wait() failed: " << strerror(errno));
+	break;
+      }
+      nfds= 0;
+    }
+
+    for (int i= 0; i < nfds; i++)
+    {
+      evconn_t* conn= static_cast<evconn_t*>(events[i].data.ptr);
+      const uint32 ev= events[i].events;
+      bool alive= true;
+
+      if (conn->connecting && (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)))
+      {
+	int soerror= 0;
+	socklen_t soerror_len= sizeof(soerror);
+	if (getsockopt(conn->assoc->socketfd, SOL_SOCKET, SO_ERROR, &soerror, &soerror_len) || soerror)
+	{
+	  ERRLog(tpparam.name, "ioloop - Connect to " << conn->assoc->peer
+		 << " failed: [" << color[red] << strerror(soerror ? soerror : errno) << color[off] << "]");
+	  alive= false;
+	}
+	else
+	{
+	  conn->connecting= false;
+	  DLog(tpparam.name, "ioloop - Connected to " << conn->assoc->peer << " via socket " << conn->assoc->socketfd);
+	}
+      }
+
+      if (alive && !conn->connecting && (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)))
+	alive= ev_read(conn);
+
+      if (alive && !conn->connecting && (ev & EPOLLOUT))
+	alive= ev_write(conn);
+
+      if (!alive)
+	ev_close(conn);
+    }
+
+    currstate= get_state();
+  } // end while
+
+  EVLog(tpparam.name, "ioloop - I/O thread #" << loop->index << " terminated");
+}
+
+
 TPoverTCP::~TPoverTCP()
 {
   init= false;
@@ -1785,6 +2441,9 @@ TPoverTCP::main_loop(uint32 nr)
   else
     DLog(tpparam.name, "Master listener thread started");
 
+  if (tpparam.io_threads)
+    start_ioloops();
+
 
   // define max latency for thread reaction on termination/stop signal
   timespec wait_interval= { 0, 250000000L }; // 250ms
@@ -1839,6 +2498,8 @@ TPoverTCP::main_loop(uint32 nr)
 
   // do not accept any more messages
   fq->shutdown();
+  // stop the I/O threads in event loop mode
+  stop_ioloops();
   // terminate all receiver and sender threads that are still active 
   terminate_all_threads();
 }
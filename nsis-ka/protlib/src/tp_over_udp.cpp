@@ -59,6 +59,7 @@ extern "C"
 #include "linux/netfilter.h"
 
 #include <set>
+#include <vector>
 
 #define UDP_SUCCESS 0
 #define UDP_SEND_FAILURE 1
@@ -238,14 +239,10 @@ TPoverUDP::udpsend (NetMsg * netmsg, appladdress * addr, const hostaddress *loca
     nanosleep(&sleeptime,&remainingtime);
     DLog(tpparam.name, "retrying to send");
   }
-  // reset IP RAO option
-  ret = setsockopt(master_listener_socket, SOL_IP, IP_OPTIONS, 0, 0);
-  if ( ret != 0 )
-    ERRLog(tpparam.name, "unsetting IP options for IPv4 failed");
-
-  // send UDP packet
+  // send UDP packet, possibly together with datagrams of other senders,
+  // the IP RAO option is reset by setup_socket()
   DLog(tpparam.name, "SEND to " << *addr);
-  ret= sendmsg(master_listener_socket,&header,MSG_DONTWAIT);  
+  ret= sendbatch.send(master_listener_socket, &header, setup_socket, this);
 
   // free ancilliary data allocated by protlib::util::set_ancillary_data()
   free(header.msg_control);
@@ -294,6 +291,21 @@ TPoverUDP::udpsend (NetMsg * netmsg, appladdress * addr, const hostaddress *loca
 
 
 
+/**
+ * called by the batched sender before a run of datagrams is sent
+ * on the listener socket: resets the IP RAO option
+ *
+ * @param arg - pointer to the current TPoverUDP object instance
+ */
+void
+TPoverUDP::setup_socket(int sockfd, int hop_limit, int rao, void* arg)
+{
+  int ret = setsockopt(sockfd, SOL_IP, IP_OPTIONS, 0, 0);
+  if ( ret != 0 )
+    ERRLog(static_cast<TPoverUDP*>(arg)->tpparam.name, "unsetting IP options for IPv4 failed");
+}
+
+
 /**
  * IPv4 catcher thread starter: 
  * just a static starter method to allow starting the 
@@ -401,11 +413,28 @@ void TPoverUDP::listener_thread ()
   state_t currstate= get_state();
   int poll_status= 0;
   const unsigned int number_poll_sockets= 1; 
-  struct sockaddr_in6 peer_address;
-  struct sockaddr_in peer_address_v4;
-  socklen_t peer_address_len;
+  const bool ipv4_only= plibconf.getpar<bool>(protlibconf_ipv4_only);
+  const socklen_t peer_address_len= ipv4_only ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
   // int conn_socket;
 
+  // pre-allocated receive ring for recvmmsg(), received datagrams are
+  // copied into right-sized NetMsgs instead of NetMsg::max_size buffers
+  std::vector<uchar> rx_ring(rx_batch_size * rx_buffer_size);
+  struct mmsghdr rx_msgs[rx_batch_size];
+  struct iovec rx_iov[rx_batch_size];
+  // large enough for IPv4 peers, too
+  struct sockaddr_in6 rx_peers[rx_batch_size];
+  memset(rx_msgs, 0, sizeof(rx_msgs));
+  for (unsigned int i= 0; i < rx_batch_size; i++)
+  {
+    rx_iov[i].iov_base= &rx_ring[i * rx_buffer_size];
+    rx_iov[i].iov_len= rx_buffer_size;
+    rx_msgs[i].msg_hdr.msg_iov= &rx_iov[i];
+    rx_msgs[i].msg_hdr.msg_iovlen= 1;
+    rx_msgs[i].msg_hdr.msg_name= &rx_peers[i];
+    rx_msgs[i].msg_hdr.msg_namelen= peer_address_len;
+  }
+
   // check whether this thread is signaled for termination
   while(! (terminate= (currstate==STATE_ABORT || currstate==STATE_STOP) ) )
   {
@@ -471,83 +500,87 @@ void TPoverUDP::listener_thread ()
 
       if ((poll_fd.revents & POLLIN) || (poll_fd.revents & POLLPRI)) {
 
-	  
-	// in peer_address and the size of its address in addrlen
-	peer_address_len= plibconf.getpar<bool>(protlibconf_ipv4_only) ? sizeof(peer_address_v4) : sizeof(peer_address);
-	      	  
-	//Build us a NetMsg
-	NetMsg *netmsg=0;
-	netmsg = new NetMsg (NetMsg::max_size);
-	      
-	      
-	      
-	/// receive data from socket buffer (recv will not block)
-	int ret = recvfrom (master_listener_socket,
-			    netmsg->get_buffer (), NetMsg::max_size, 0, 
-			    plibconf.getpar<bool>(protlibconf_ipv4_only) ? reinterpret_cast<struct sockaddr *>(&peer_address_v4) : reinterpret_cast<struct sockaddr *>(&peer_address),
-			    &peer_address_len);
-	  
-	if (ret) 
+	/// receive all queued datagrams up to rx_batch_size (recvmmsg will not block)
+	int ret = recvmmsg(master_listener_socket, rx_msgs, rx_batch_size, MSG_DONTWAIT, NULL);
+	if (ret < 0)
 	{
-	  DLog(tpparam.name, "received " << ret << " bytes of UDP data");
-
-	  // truncate netmsg buffer
-	  netmsg->truncate(ret);
-	}
-
-	/**************************************************************
-	 *  The following restrictions should apply:                  *
-	 *                                                            *
-	 *  This is UDP, messages are contained in ONE datagram       *
-	 *  datagrams CANNOT fragment, as otherwise TCP is used       *
-	 *  so we now build a TPMsg, send it to signaling and         *
-	 *  all should be well. At least until now.                   *
-	 **************************************************************/
-	      
-	// Build peer_adr and own_addr
-	appladdress* peer_addr = new appladdress;
-	if (plibconf.getpar<bool>(protlibconf_ipv4_only))
-	{
-		peer_addr->set_ip(peer_address_v4.sin_addr);
-		peer_addr->set_port(ntohs(peer_address_v4.sin_port));
+	  if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+	    ERRLog(tpparam.name, "Receiving UDP data failed, error: " << strerror(errno));
+	  ret= 0;
 	}
 	else
-	{
-		peer_addr->set_ip(peer_address.sin6_addr);
-		peer_addr->set_port(ntohs(peer_address.sin6_port));
-	}
-	peer_addr->set_protocol(get_underlying_protocol());
+	  rx_stats.count_atomic(ret);
 
-	appladdress* own_addr = new appladdress();
-	      
-	// Log the sender peer and write to peer_addr
-	char source_addr[INET6_ADDRSTRLEN+1];
-	if (plibconf.getpar<bool>(protlibconf_ipv4_only))
-		inet_ntop(AF_INET, &peer_address_v4.sin_addr, source_addr, INET6_ADDRSTRLEN);
-	else
-		inet_ntop(AF_INET6, &peer_address.sin6_addr, source_addr, INET6_ADDRSTRLEN);
+	for (int i= 0; i < ret; i++) {
 
+	  const uint32 len= rx_msgs[i].msg_len;
+	  const bool truncated= rx_msgs[i].msg_hdr.msg_flags & MSG_TRUNC;
 
-	DLog(tpparam.name, "Peer: [" << *peer_addr << "]");
+	  // re-arm the ring slot for the next recvmmsg()
+	  rx_msgs[i].msg_hdr.msg_namelen= peer_address_len;
+	  rx_msgs[i].msg_hdr.msg_flags= 0;
 
-	// create TPMsg and send it to the signaling thread
-	//fprintf (stderr, "Before TPMsg creation\n");
-	TPMsg *tpmsg=
-	  new (nothrow) TPMsg (netmsg, peer_addr, own_addr);
-	      
-	DLog (tpparam.name,
-	     "recvthread - receipt of GIST PDU now complete, sending msg#" << tpmsg->get_id() << " to signaling module");	      
-	      
-	if (tpmsg == NULL || !tpmsg->send(tpparam.source, tpparam.dest))
+	  DLog(tpparam.name, "received " << len << " bytes of UDP data");
+	  if (len == 0 || truncated)
+	  {
+	    ERRLog(tpparam.name, "Dropping " << (truncated ? "truncated" : "empty") << " UDP datagram");
+	    continue;
+	  }
+
+	  //Build us a right-sized NetMsg, the data is copied out of the ring
+	  NetMsg *netmsg= new NetMsg(&rx_ring[i * rx_buffer_size], len);
+
+	  /**************************************************************
+	   *  The following restrictions should apply:                  *
+	   *                                                            *
+	   *  This is UDP, messages are contained in ONE datagram       *
+	   *  datagrams CANNOT fragment, as otherwise TCP is used       *
+	   *  so we now build a TPMsg, send it to signaling and         *
+	   *  all should be well. At least until now.                   *
+	   **************************************************************/
+
+	  // Build peer_adr and own_addr
+	  appladdress* peer_addr = new appladdress;
+	  if (ipv4_only)
+	  {
+	    const struct sockaddr_in* peer_address_v4= reinterpret_cast<const struct sockaddr_in *>(&rx_peers[i]);
+	    peer_addr->set_ip(peer_address_v4->sin_addr);
+	    peer_addr->set_port(ntohs(peer_address_v4->sin_port));
+	  }
+	  else
+	  {
+	    peer_addr->set_ip(rx_peers[i].sin6_addr);
+	    peer_addr->set_port(ntohs(rx_peers[i].sin6_port));
+	  }
+	  peer_addr->set_protocol(get_underlying_protocol());
+
+	  appladdress* own_addr = new appladdress();
+
+	  DLog(tpparam.name, "Peer: [" << *peer_addr << "]");
+
+	  // create TPMsg and send it to the signaling thread
+	  TPMsg *tpmsg=
+	    new (nothrow) TPMsg (netmsg, peer_addr, own_addr);
+
+	  if (tpmsg)
+	    DLog (tpparam.name,
+		  "recvthread - receipt of GIST PDU now complete, sending msg#" << tpmsg->get_id() << " to signaling module");
+
+	  if (tpmsg == NULL || !tpmsg->send(tpparam.source, tpparam.dest))
 	  {
 	    ERRLog(tpparam.name, "rcvthread" << "Cannot allocate/send TPMsg");
 	    if (tpmsg)
 	      delete tpmsg;
-	    if (netmsg)
+	    else
+	    {
 	      delete netmsg;
-		  
-	  } 
-	   
+	      delete peer_addr;
+	      delete own_addr;
+	    }
+	  }
+
+	} // end for (received datagrams)
+
       }
       
       // get new thread state
@@ -194,6 +194,24 @@ void TPqueryEncap::setup_socket_ipv6(int sockfd, int hop_limit, int rao) {
 }
 
 
+/**
+ * Set socket options for the next datagrams, called by the batched sender
+ * of TPoverUDP before a run of datagrams with equal hop_limit and rao.
+ *
+ * @param sockfd a socket descriptor, returned by a successful call to socket()
+ * @param hop_limit a value between 0 and 255, or -1 to use the route's default
+ * @param rao the RAO in host byte order (a 16 bit value, or -1)
+ * @param arg pointer to the TPqueryEncap instance
+ */
+void TPqueryEncap::setup_socket(int sockfd, int hop_limit, int rao, void* arg) {
+	TPqueryEncap* qe= static_cast<TPqueryEncap*>(arg);
+
+	qe->setup_socket_ipv4(sockfd, hop_limit, rao);
+	if ( ! plibconf.getpar<bool>(protlibconf_ipv4_only) )
+		qe->setup_socket_ipv6(sockfd, hop_limit, rao);
+}
+
+
 
 /**
  * Send the given NetMsg via UDP to the given address.
@@ -279,9 +297,8 @@ TPqueryEncap::udpsend(NetMsg *netmsg, appladdress *addr, const hostaddress *own_
 	 "Using UDP socket " << sock << " for sending");
   }
 
-  setup_socket_ipv4(sock, hop_limit, rao);
-  if ( ! plibconf.getpar<bool>(protlibconf_ipv4_only) ) 
-    setup_socket_ipv6(sock, hop_limit, rao);
+  // the socket options for hop_limit and rao are set by setup_socket()
+  // right before the datagram is sent
 
 
   /*
@@ -332,7 +349,8 @@ TPqueryEncap::udpsend(NetMsg *netmsg, appladdress *addr, const hostaddress *own_
    */
 
   // return code will be checked below
-  int ret = sendmsg(sock, &msg, MSG_DONTWAIT);
+  // the socket is shared with TPoverUDP, so use its batched sender
+  int ret = tpparam.tpoverudp->get_sendbatch().send(sock, &msg, setup_socket, this, hop_limit, rao);
 
   if ( debug_pdu ) {
     ostringstream out;
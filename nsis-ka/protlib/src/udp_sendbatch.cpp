@@ -0,0 +1,231 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file udp_sendbatch.cpp
+/// batched sending of UDP datagrams via sendmmsg()
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2007, all rights reserved by
+// - Institute of Telematics, Universitaet Karlsruhe (TH)
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along
+// with this program; if not, write to the Free Software Foundation, Inc.,
+// 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+//
+// ===========================================================
+
+extern "C"
+{
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <string.h>
+}
+
+#include "udp_sendbatch.h"
+
+namespace protlib
+{
+
+/** @addtogroup tpudp
+ * @{
+ */
+
+UDPSendBatch::UDPSendBatch(unsigned int maxbatch) :
+  maxbatch(maxbatch ? maxbatch : 1),
+  mmsgs(new struct mmsghdr[this->maxbatch]),
+  run(new entry_t*[this->maxbatch]),
+  head(NULL), tail(NULL), flushing(false)
+{
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&cond, NULL);
+}
+
+
+UDPSendBatch::~UDPSendBatch()
+{
+  pthread_cond_destroy(&cond);
+  pthread_mutex_destroy(&mutex);
+  delete[] mmsgs;
+  delete[] run;
+}
+
+
+/** sends a datagram, possibly together with datagrams of other threads
+ *
+ * @param sock      UDP socket
+ * @param msg       complete sendmsg() argument, must stay valid until send() returns
+ * @param setup     if not NULL, called before sending to set socket options
+ * @param setup_arg passed to setup
+ * @param hop_limit passed to setup
+ * @param rao       passed to setup
+ *
+ * @return number of bytes sent, or -1 on error with errno set like sendmsg()
+ */
+int
+UDPSendBatch::send(int sock, struct msghdr* msg, setup_func_t setup, void* setup_arg, int hop_limit, int rao)
+{
+  entry_t e;
+  e.sock= sock;
+  e.msg= msg;
+  e.setup= setup;
+  e.setup_arg= setup_arg;
+  e.hop_limit= hop_limit;
+  e.rao= rao;
+  e.result= -1;
+  e.error= 0;
+  e.done= false;
+  e.next= NULL;
+
+  pthread_mutex_lock(&mutex);
+  if (tail)
+    tail->next= &e;
+  else
+    head= &e;
+  tail= &e;
+
+  while (!e.done)
+  {
+    if (flushing)
+    {
+      // somebody else sends, maybe our datagram, too
+      pthread_cond_wait(&cond, &mutex);
+      continue;
+    }
+
+    // become the flusher for everything queued so far
+    entry_t* list= head;
+    head= tail= NULL;
+    flushing= true;
+    pthread_mutex_unlock(&mutex);
+
+    flush(list);
+
+    pthread_mutex_lock(&mutex);
+    // entries belong to the waiting threads, so do not touch them after done was set
+    while (list)
+    {
+      entry_t* next= list->next;
+      list->done= true;
+      list= next;
+    }
+    flushing= false;
+    pthread_cond_broadcast(&cond);
+  }
+  pthread_mutex_unlock(&mutex);
+
+  errno= e.error;
+  return e.result;
+}
+
+
+/** splits the list into runs with equal socket and setup and sends each of them
+ */
+void
+UDPSendBatch::flush(entry_t* list)
+{
+  unsigned int n= 0;
+
+  for (entry_t* e= list; e != NULL; e= e->next)
+  {
+    if (n > 0
+	&& (n == maxbatch
+	    || e->sock != run[0]->sock
+	    || e->setup != run[0]->setup
+	    || e->setup_arg != run[0]->setup_arg
+	    || e->hop_limit != run[0]->hop_limit
+	    || e->rao != run[0]->rao))
+    {
+      flush_run(n);
+      n= 0;
+    }
+    run[n++]= e;
+  }
+
+  if (n > 0)
+    flush_run(n);
+}
+
+
+/** sends the first n datagrams of run with a single sendmmsg() call if possible
+ *
+ * If sendmmsg() stops at a failing datagram, that one gets the error and
+ * the remaining datagrams are sent with the next call.
+ */
+void
+UDPSendBatch::flush_run(unsigned int n)
+{
+  const int sock= run[0]->sock;
+
+  if (run[0]->setup)
+    run[0]->setup(sock, run[0]->hop_limit, run[0]->rao, run[0]->setup_arg);
+
+  for (unsigned int i= 0; i < n; i++)
+  {
+    mmsgs[i].msg_hdr= *run[i]->msg;
+    mmsgs[i].msg_len= 0;
+  }
+
+  unsigned int calls= 0;
+  unsigned int sent= 0;
+  unsigned int largest= 0;
+  unsigned int i= 0;
+  while (i < n)
+  {
+    int ret= sendmmsg(sock, &mmsgs[i], n - i, MSG_DONTWAIT);
+    calls++;
+    if (ret < 0)
+    {
+      if (errno == EINTR)
+	continue;
+
+      run[i]->result= -1;
+      run[i]->error= errno;
+      i++;
+      continue;
+    }
+
+    for (int j= 0; j < ret; j++, i++)
+    {
+      run[i]->result= mmsgs[i].msg_len;
+      run[i]->error= 0;
+    }
+    sent+= ret;
+    if ((unsigned int) ret > largest)
+      largest= ret;
+  }
+
+  pthread_mutex_lock(&mutex);
+  stats.batches+= calls;
+  stats.datagrams+= sent;
+  if (largest > stats.max_batch)
+    stats.max_batch= largest;
+  pthread_mutex_unlock(&mutex);
+}
+
+
+udp_batch_stats_t
+UDPSendBatch::get_stats() const
+{
+  pthread_mutex_lock(&mutex);
+  udp_batch_stats_t s= stats;
+  pthread_mutex_unlock(&mutex);
+  return s;
+}
+
+//@}
+
+} // end namespace protlib
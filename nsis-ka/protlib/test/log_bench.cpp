@@ -0,0 +1,106 @@
+/*
+ * test/log_bench.cpp - Compare the synchronous and asynchronous logfile.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ * T threads write N INFO records each into a log file, first in the
+ * synchronous mode, then in the asynchronous mode. For every mode the
+ * records/s seen by the logging threads, the total time including writing
+ * all queued records, and the number of dropped records are reported.
+ * Run as
+ *
+ *   ./log_bench [threads] [records] [logfile]
+ *
+ * The log file defaults to /tmp/log_bench.log and is overwritten.
+ */
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "logfile.h"
+
+using namespace protlib;
+using namespace protlib::log;
+
+// needed for linking
+logfile commonlog("", false, true);
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+static unsigned long records = 100000;
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static void *log_thread(void *arg) {
+	double *secs = static_cast<double *>(arg);
+	double start = now();
+
+	for (unsigned long i = 0; i < records; i++)
+		ILog("log_bench", "record " << i << " of thread " << pthread_self());
+
+	*secs = now() - start;
+	return NULL;
+}
+
+
+static void run(const char *name, unsigned int threads) {
+	std::vector<pthread_t> tids(threads);
+	std::vector<double> secs(threads);
+	unsigned long dropped = commonlog.get_dropped();
+	double start = now();
+	double logging = 0;
+
+	for (unsigned int t = 0; t < threads; t++)
+		pthread_create(&tids[t], NULL, log_thread, &secs[t]);
+	for (unsigned int t = 0; t < threads; t++) {
+		pthread_join(tids[t], NULL);
+		if (secs[t] > logging)
+			logging = secs[t];
+	}
+	// write everything still queued
+	commonlog.set_async(false);
+	double total = now() - start;
+
+	unsigned long n = threads * records;
+	std::cout << std::setw(6) << name << std::setw(4) << threads
+		<< std::setw(10) << n << std::setw(14) << std::fixed
+		<< std::setprecision(0) << (logging > 0 ? n / logging : 0.0)
+		<< " rec/s" << std::setw(10) << std::setprecision(3) << total
+		<< " s total" << std::setw(10)
+		<< commonlog.get_dropped() - dropped << " dropped" << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+	unsigned int threads = (argc > 1) ? strtoul(argv[1], NULL, 10) : 4;
+	const char *filename = (argc > 3) ? argv[3] : "/tmp/log_bench.log";
+
+	if (argc > 2)
+		records = strtoul(argv[2], NULL, 10);
+
+	if ( !commonlog.set_dest(filename, true) )
+		return 1;
+
+	run("sync", threads);
+
+	if ( !commonlog.set_async(true) ) {
+		std::cerr << "could not start asynchronous mode" << std::endl;
+		return 1;
+	}
+	run("async", threads);
+
+	return 0;
+}
+
+// EOF
@@ -28,6 +28,8 @@ class NetMsgTest : public CppUnit::TestCase {
         CPPUNIT_TEST( testNetMsgPos );
         CPPUNIT_TEST( testNetMsgCoding );
         CPPUNIT_TEST( testNetMsgWeirdCoding );
+        CPPUNIT_TEST( testNetMsgSlice );
+        CPPUNIT_TEST( testNetMsgPool );
 
 	CPPUNIT_TEST_SUITE_END();
 private:
@@ -153,6 +155,61 @@ private:
 		newmsgp->encode(buf,0, false);		
 
 	}
+
+        void testNetMsgSlice() {
+		newmsgp->to_start();
+		for (unsigned int i= 0; i < testsize; i++)
+			newmsgp->encode8(i);
+
+		netmsg_pool_stats_t before= NetMsg::get_pool_stats();
+		NetMsg* slice= new NetMsg(*newmsgp, 16, 32);
+
+		// shared, not copied
+		CPPUNIT_ASSERT( slice->get_buffer() == newmsgp->get_buffer() + 16 );
+		CPPUNIT_ASSERT( slice->get_size() == 32 );
+		CPPUNIT_ASSERT( slice->is_shared() );
+		CPPUNIT_ASSERT( newmsgp->is_shared() );
+		CPPUNIT_ASSERT( slice->decode8() == 16 );
+		CPPUNIT_ASSERT( NetMsg::get_pool_stats().shared == before.shared + 1 );
+
+		// the buffer survives the original NetMsg
+		delete newmsgp;
+		newmsgp= new NetMsg(testsize);
+		CPPUNIT_ASSERT( !slice->is_shared() );
+		CPPUNIT_ASSERT( slice->decode8() == 17 );
+
+		// a slice of a slice
+		NetMsg slice2(*slice, 2, 4);
+		CPPUNIT_ASSERT( slice2.decode8() == 18 );
+		delete slice;
+		CPPUNIT_ASSERT( slice2.decode8() == 19 );
+
+		// slices of foreign buffers are copied
+		NetMsg foreign(reinterpret_cast<uchar*>(buffer), sizeof(buffer), false);
+		NetMsg slice3(foreign, 0, 8);
+		CPPUNIT_ASSERT( slice3.get_buffer() != foreign.get_buffer() );
+		CPPUNIT_ASSERT( !slice3.is_shared() );
+
+		CPPUNIT_ASSERT_THROW( NetMsg(*newmsgp, testsize - 1, 2), NetMsgError );
+		CPPUNIT_ASSERT_THROW( NetMsg(*newmsgp, 0, 0), NetMsgError );
+	}
+
+        void testNetMsgPool() {
+		// a released buffer is reused for a message of the same size class
+		uchar* first= newmsgp->get_buffer();
+		delete newmsgp;
+
+		netmsg_pool_stats_t before= NetMsg::get_pool_stats();
+		newmsgp= new NetMsg(testsize - 10);
+		netmsg_pool_stats_t after= NetMsg::get_pool_stats();
+
+		CPPUNIT_ASSERT( newmsgp->get_buffer() == first );
+		CPPUNIT_ASSERT( after.hits == before.hits + 1 );
+		CPPUNIT_ASSERT( after.misses == before.misses );
+		// still zeroed
+		CPPUNIT_ASSERT( newmsgp->decode32() == 0 );
+	}
+
 	void tearDown() {
 	  // Executed after each of the test methods.
 	  delete newmsgp;
@@ -0,0 +1,134 @@
+/*
+ * test/route_cache.cpp - Test the cache behind util::get_src_addr() and
+ *                       util::get_local_if().
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include "routing_util.h"
+
+using namespace protlib;
+using namespace protlib::util;
+
+
+class RouteCacheTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( RouteCacheTest );
+
+	CPPUNIT_TEST( testHit );
+	CPPUNIT_TEST( testInvalidate );
+	CPPUNIT_TEST( testMappedAddress );
+	CPPUNIT_TEST( testInterfaceSources );
+	CPPUNIT_TEST( testSharedPrefix );
+
+	CPPUNIT_TEST_SUITE_END();
+
+	netaddress *lookup(const char *dest) {
+		netaddress na(dest);
+		netaddress *src = get_src_addr(na);
+		CPPUNIT_ASSERT( src != NULL );
+		return src;
+	}
+
+  public:
+	void setUp() {
+		invalidate_route_cache();
+	}
+
+	void testHit() {
+		route_cache_stats_t before = get_route_cache_stats();
+
+		netaddress *first = lookup("127.0.0.1");
+		netaddress *second = lookup("127.0.0.1");
+
+		CPPUNIT_ASSERT( *first == netaddress("127.0.0.1", (prefix_length_t) 32) );
+		CPPUNIT_ASSERT( *first == *second );
+
+		route_cache_stats_t after = get_route_cache_stats();
+		CPPUNIT_ASSERT_EQUAL( (uint64) 2,
+			after.hits + after.misses - before.hits - before.misses );
+		if ( after.enabled ) {
+			CPPUNIT_ASSERT_EQUAL( (uint64) 1, after.hits - before.hits );
+			CPPUNIT_ASSERT( after.entries >= 1 );
+		}
+
+		delete first;
+		delete second;
+	}
+
+	void testInvalidate() {
+		delete lookup("127.0.0.2");
+
+		route_cache_stats_t before = get_route_cache_stats();
+		invalidate_route_cache();
+		delete lookup("127.0.0.2");
+		route_cache_stats_t after = get_route_cache_stats();
+
+		CPPUNIT_ASSERT( after.invalidations > before.invalidations );
+		CPPUNIT_ASSERT_EQUAL( (uint64) 1, after.misses - before.misses );
+		CPPUNIT_ASSERT_EQUAL( before.hits, after.hits );
+	}
+
+	void testMappedAddress() {
+		// IPv4 mapped and plain IPv4 destinations share an entry
+		delete lookup("127.0.0.3");
+
+		route_cache_stats_t before = get_route_cache_stats();
+		netaddress *src = lookup("::ffff:127.0.0.3");
+		route_cache_stats_t after = get_route_cache_stats();
+
+		CPPUNIT_ASSERT( src->is_ipv4() );
+		if ( after.enabled )
+			CPPUNIT_ASSERT_EQUAL( (uint64) 1, after.hits - before.hits );
+
+		delete src;
+	}
+
+	void testInterfaceSources() {
+		hostaddress dest("127.0.0.4");
+		hostaddress src1("127.0.0.1");
+		hostaddress src2("127.0.0.2");
+
+		uint16 oif1 = get_local_if(src1, dest);
+		uint16 oif2 = get_local_if(src2, dest);
+		CPPUNIT_ASSERT( oif1 != 0 && oif2 != 0 );
+
+		// different sources to the same destination do not evict each other
+		route_cache_stats_t before = get_route_cache_stats();
+		CPPUNIT_ASSERT_EQUAL( oif1, get_local_if(src1, dest) );
+		CPPUNIT_ASSERT_EQUAL( oif2, get_local_if(src2, dest) );
+		CPPUNIT_ASSERT_EQUAL( oif1, get_local_if(src1, dest) );
+		route_cache_stats_t after = get_route_cache_stats();
+
+		if ( after.enabled )
+			CPPUNIT_ASSERT_EQUAL( (uint64) 3, after.hits - before.hits );
+	}
+
+	void testSharedPrefix() {
+		// destinations of one route (local 127.0.0.0/8) share its entry
+		uint16 oif = get_local_if(hostaddress("127.0.0.5"));
+		delete lookup("127.0.0.5");
+		CPPUNIT_ASSERT( oif != 0 );
+
+		route_cache_stats_t before = get_route_cache_stats();
+		CPPUNIT_ASSERT_EQUAL( oif, get_local_if(hostaddress("127.0.0.6")) );
+		netaddress *src = lookup("127.0.0.7");
+		route_cache_stats_t after = get_route_cache_stats();
+
+		CPPUNIT_ASSERT( *src == netaddress("127.0.0.1", (prefix_length_t) 32) );
+		if ( after.enabled ) {
+			CPPUNIT_ASSERT_EQUAL( (uint64) 2, after.hits - before.hits );
+			CPPUNIT_ASSERT_EQUAL( before.entries, after.entries );
+		}
+
+		delete src;
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( RouteCacheTest );
+
+// EOF
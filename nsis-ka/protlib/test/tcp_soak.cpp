@@ -0,0 +1,280 @@
+/*
+ * test/tcp_soak.cpp - Soak test for TPoverTCP with many associations.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ * Opens N associations over loopback to the listener of a TPoverTCP
+ * instance, from plain client sockets bound to 127.0.x.y so that every
+ * association has a distinct peer address. Every client then sends M PDUs
+ * (receive path), afterwards TPoverTCP sends M PDUs back to every peer over
+ * the existing associations (send path). For both directions the number of
+ * messages/s, the RSS and the number of threads are reported. Run as
+ *
+ *   ./tcp_soak [associations] [io_threads] [messages]
+ *
+ * io_threads = 0 selects the classic mode with one sender and one receiver
+ * thread per connection. The open file limit is raised to the hard limit,
+ * every association needs two sockets.
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "network_message.h"
+#include "tp_over_tcp.h"
+#include "logfile.h"
+#include "queuemanager.h"
+#include "threadsafe_db.h"
+#include "protlibconf.h"
+
+using namespace protlib;
+using namespace protlib::log;
+
+namespace protlib {
+	protlibconf plibconf;
+}
+
+// needed for linking
+logfile commonlog("", false, true);
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+const uint16 magic = 0xbc3a;
+const uint32 commonheaderlen = 4;
+const uint16 payloadlen = 124;
+const port_t port = 41555;
+
+
+// read length from common header
+static bool getmsglength(NetMsg& m, uint32& clen_bytes) {
+	bool ok = (m.decode16() == magic);
+	if ( ok )
+		clen_bytes = m.decode16();
+	m.to_start();
+	return ok;
+}
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// resident set size in kB
+static unsigned long rss_kb() {
+	unsigned long size = 0, resident = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if ( f ) {
+		if ( fscanf(f, "%lu %lu", &size, &resident) != 2 )
+			resident = 0;
+		fclose(f);
+	}
+	return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+
+static unsigned long num_threads() {
+	unsigned long threads = 0;
+	char line[128];
+	FILE *f = fopen("/proc/self/status", "r");
+	if ( f ) {
+		while ( fgets(line, sizeof(line), f) != NULL )
+			if ( sscanf(line, "Threads: %lu", &threads) == 1 )
+				break;
+		fclose(f);
+	}
+	return threads;
+}
+
+
+static NetMsg *make_msg() {
+	NetMsg *msg = new NetMsg(commonheaderlen + payloadlen);
+	msg->encode16(magic);
+	msg->encode16(payloadlen);
+	return msg;
+}
+
+
+static bool write_all(int fd, const uchar *buf, size_t len) {
+	while ( len > 0 ) {
+		ssize_t ret = write(fd, buf, len);
+		if ( ret <= 0 )
+			return false;
+		buf += ret;
+		len -= ret;
+	}
+	return true;
+}
+
+
+/*
+ * Wait until n messages arrived at the signaling queue, give up after
+ * 30s without progress. Returns the number of messages received, the
+ * peer addresses are collected if peers is not NULL.
+ */
+static unsigned long receive(FastQueue *fq, unsigned long n,
+		std::vector<appladdress> *peers = NULL) {
+	unsigned long received = 0;
+	double last = now();
+
+	while ( received < n && now() - last < 30 ) {
+		message *msg = fq->dequeue_timedwait(1000);
+		if ( msg ) {
+			TPMsg *tpmsg = dynamic_cast<TPMsg *>(msg);
+			if ( tpmsg && peers && tpmsg->get_peeraddress() )
+				peers->push_back(*static_cast<const appladdress *>(
+					tpmsg->get_peeraddress()));
+			received++;
+			last = now();
+			delete msg;
+		}
+	}
+	return received;
+}
+
+
+static void report(const char *phase, unsigned long n, unsigned long ok,
+		double secs) {
+	std::cout << std::setw(8) << phase << std::setw(10) << ok << "/" << n
+		<< std::setw(12) << std::fixed << std::setprecision(0)
+		<< (secs > 0 ? ok / secs : 0.0) << " msgs/s"
+		<< std::setw(10) << rss_kb() << " kB RSS"
+		<< std::setw(8) << num_threads() << " threads" << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+	unsigned long assocs = (argc > 1) ? strtoul(argv[1], NULL, 10) : 5000;
+	uint32 io_threads = (argc > 2) ? strtoul(argv[2], NULL, 10) : 4;
+	unsigned long msgs = (argc > 3) ? strtoul(argv[3], NULL, 10) : 20;
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	struct rlimit rl;
+	if ( getrlimit(RLIMIT_NOFILE, &rl) == 0 ) {
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &rl);
+		if ( rl.rlim_cur < 2 * assocs + 64 )
+			std::cerr << "warning: open file limit " << rl.rlim_cur
+				<< " is too low for " << assocs
+				<< " associations" << std::endl;
+	}
+
+	plibconf.repository_init();
+	plibconf.setRepository();
+	protlib::tsdb::init(true);
+
+	FastQueue *fq = new FastQueue("tcp_soak");
+	QueueManager::instance()->register_queue(fq, message::qaddr_signaling);
+
+	TPoverTCPParam tppar(commonheaderlen, getmsglength, port, "TPoverTCP",
+		ThreadParam::default_sleep_time, false,
+		message::qaddr_transport, message::qaddr_signaling,
+		false, 0x10, io_threads);
+	ThreadStarter<TPoverTCP, TPoverTCPParam> tpthread(1, tppar);
+	tpthread.start_processing();
+	while ( !tpthread.is_running() )
+		usleep(1000);
+	// give the listener some time to bind
+	sleep(1);
+
+	TPoverTCP *tp = tpthread.get_thread_object();
+
+	std::cout << assocs << " associations, " << io_threads
+		<< " I/O threads, " << msgs << " messages each" << std::endl;
+
+	NetMsg *pdu = make_msg();
+	const uint32 pdulen = pdu->get_size();
+	std::vector<uchar> burst(msgs * pdulen);
+	for (unsigned long m = 0; m < msgs; m++)
+		memcpy(&burst[m * pdulen], pdu->get_buffer(), pdulen);
+
+	// connect the clients, each one announces itself with a first PDU
+	std::vector<int> clients;
+	double start = now();
+	for (unsigned long i = 0; i < assocs; i++) {
+		struct sockaddr_in src, dst;
+		memset(&src, 0, sizeof(src));
+		src.sin_family = AF_INET;
+		src.sin_addr.s_addr = htonl(0x7f000000 + ((i / 250) << 8)
+			+ (i % 250) + 1);
+		dst = src;
+		dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		dst.sin_port = htons(port);
+
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if ( fd < 0 || bind(fd, (struct sockaddr *) &src, sizeof(src))
+				|| connect(fd, (struct sockaddr *) &dst, sizeof(dst))
+				|| !write_all(fd, pdu->get_buffer(), pdulen) ) {
+			std::cerr << "client " << i << ": " << strerror(errno)
+				<< std::endl;
+			if ( fd >= 0 )
+				close(fd);
+			break;
+		}
+		clients.push_back(fd);
+	}
+	std::vector<appladdress> peers;
+	report("setup", assocs, receive(fq, clients.size(), &peers),
+		now() - start);
+
+	// receive path: every client sends a burst of PDUs
+	start = now();
+	for (unsigned long i = 0; i < clients.size(); i++)
+		write_all(clients[i], &burst[0], burst.size());
+	report("receive", clients.size() * msgs,
+		receive(fq, clients.size() * msgs), now() - start);
+
+	// send path: TPoverTCP answers every peer with a burst of PDUs
+	start = now();
+	for (unsigned long m = 0; m < msgs; m++)
+		for (unsigned long i = 0; i < peers.size(); i++)
+			tp->send(make_msg(), peers[i], true, NULL);
+	unsigned long sent = 0;
+	for (unsigned long i = 0; i < clients.size(); i++) {
+		size_t got = 0;
+		struct timeval tv = { 10, 0 };
+		setsockopt(clients[i], SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		while ( got < burst.size() ) {
+			ssize_t ret = read(clients[i], &burst[got],
+				burst.size() - got);
+			if ( ret <= 0 )
+				break;
+			got += ret;
+		}
+		sent += got / pdulen;
+	}
+	report("send", peers.size() * msgs, sent, now() - start);
+
+	for (unsigned long i = 0; i < clients.size(); i++)
+		close(clients[i]);
+	delete pdu;
+
+	tpthread.stop_processing();
+	tpthread.wait_until_stopped();
+
+	QueueManager::clear();
+	protlib::tsdb::end();
+
+	return 0;
+}
+
+// EOF
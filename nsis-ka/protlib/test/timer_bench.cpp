@@ -0,0 +1,109 @@
+/*
+ * test/timer_bench.cpp - Compare the TimerManager backends.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ * Starts, restarts and stops N timers with random alarm times between
+ * 1 and 60 seconds, then lets N short timers expire. Run as
+ *
+ *   ./timer_bench [max_timers]
+ *
+ * The sorted list backend is skipped for more than 10000 timers unless
+ * LIST_BENCH is set in the environment, since its insertion is O(n).
+ */
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <sys/time.h>
+
+#include "timer.h"
+#include "logfile.h"
+
+using namespace protlib;
+using namespace protlib::log;
+
+// needed for linking
+logfile commonlog("", false, true);
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+class NullCallback : public TimerCallback {
+  public:
+	NullCallback() : num(0) { }
+	virtual void timer_expired(timer_id_t, timer_callback_param_t) { num++; }
+	unsigned long num;
+};
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static void report(const char *name, const char *op, unsigned long n, double secs) {
+	std::cout << std::setw(6) << name << std::setw(10) << n
+		<< std::setw(10) << op << std::setw(14) << std::fixed
+		<< std::setprecision(0) << (secs > 0 ? n / secs : 0.0)
+		<< " ops/s" << std::endl;
+}
+
+
+static void run(TimerManager::backend_t backend, unsigned long n) {
+	const char *name = (backend == TimerManager::backend_wheel) ? "wheel" : "list";
+	TimerManager tm(backend);
+	NullCallback cb;
+	std::vector<timer_id_t> ids(n);
+	double start;
+
+	srandom(42);
+
+	start = now();
+	for (unsigned long i = 0; i < n; i++)
+		ids[i] = tm.start_relative(&cb, 1, random() % 59000);
+	report(name, "start", n, now() - start);
+
+	start = now();
+	for (unsigned long i = 0; i < n; i++)
+		tm.restart_relative(ids[i], 1, random() % 59000);
+	report(name, "restart", n, now() - start);
+
+	start = now();
+	for (unsigned long i = 0; i < n; i++)
+		tm.stop(ids[i]);
+	report(name, "stop", n, now() - start);
+
+	// expiry: all timers go off within 500ms, count CPU time only
+	for (unsigned long i = 0; i < n; i++)
+		tm.start_relative(&cb, 0, random() % 500);
+	clock_t cpu = clock();
+	while ( cb.num < n )
+		tm.check_timers_wait(100);
+	report(name, "expire", n, double(clock() - cpu) / CLOCKS_PER_SEC);
+}
+
+
+int main(int argc, char *argv[]) {
+	unsigned long max = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	for (unsigned long n = 10000; n <= max; n *= 10) {
+		if ( n <= 10000 || getenv("LIST_BENCH") != NULL )
+			run(TimerManager::backend_list, n);
+		run(TimerManager::backend_wheel, n);
+	}
+
+	return 0;
+}
+
+// EOF
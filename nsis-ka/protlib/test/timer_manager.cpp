@@ -0,0 +1,108 @@
+/*
+ * test/timer_manager.cpp - Test the TimerManager backends.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <vector>
+
+#include "timer.h"
+
+using namespace protlib;
+
+
+class CountingCallback : public TimerCallback {
+  public:
+	CountingCallback() : num(0), last(0) { }
+	virtual void timer_expired(timer_id_t id, timer_callback_param_t) {
+		num++;
+		last = id;
+	}
+	uint32 num;
+	timer_id_t last;
+};
+
+
+class TimerManagerTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( TimerManagerTest );
+
+	CPPUNIT_TEST( testList );
+	CPPUNIT_TEST( testWheel );
+	CPPUNIT_TEST( testWheelCascade );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void testList() {
+		runBasic(TimerManager::backend_list);
+	}
+
+	void testWheel() {
+		runBasic(TimerManager::backend_wheel);
+	}
+
+	void runBasic(TimerManager::backend_t backend) {
+		TimerManager tm(backend);
+		CountingCallback cb;
+
+		timer_id_t t1 = tm.start_relative(&cb, 0, 50);
+		timer_id_t t2 = tm.start_relative(&cb, 0, 100);
+		timer_id_t t3 = tm.start_relative(&cb, 60);
+		CPPUNIT_ASSERT( t1 != 0 && t2 != 0 && t3 != 0 );
+		CPPUNIT_ASSERT( tm.get_num_active() == 3 );
+
+		// t2 is stopped, t3 moved far away, only t1 goes off
+		CPPUNIT_ASSERT( tm.stop(t2) );
+		CPPUNIT_ASSERT( !tm.stop(t2) );
+		CPPUNIT_ASSERT( tm.restart_relative(t3, 3600) );
+
+		uint32 num = 0;
+		for (int i = 0; i < 10 && num == 0; i++)
+			num += tm.check_timers_wait(100);
+
+		CPPUNIT_ASSERT( num == 1 );
+		CPPUNIT_ASSERT( cb.num == 1 );
+		CPPUNIT_ASSERT( cb.last == t1 );
+		CPPUNIT_ASSERT( tm.get_num_active() == 1 );
+
+		CPPUNIT_ASSERT( tm.stop_all() == 1 );
+		CPPUNIT_ASSERT( tm.get_num_active() == 0 );
+	}
+
+	/*
+	 * Timers beyond the root level of the wheel (256ms) must be cascaded
+	 * down and still go off in order and not early.
+	 */
+	void testWheelCascade() {
+		TimerManager tm(TimerManager::backend_wheel);
+		CountingCallback cb;
+
+		std::vector<timer_id_t> ids;
+		for (int32 msec = 100; msec <= 700; msec += 150)
+			ids.push_back(tm.start_relative(&cb, 0, msec));
+
+		struct timeval start, now;
+		gettimeofday(&start, NULL);
+		while ( cb.num < ids.size() ) {
+			uint32 before = cb.num;
+			tm.check_timers_wait(1000);
+			gettimeofday(&now, NULL);
+			long elapsed = (now.tv_sec - start.tv_sec) * 1000
+				+ (now.tv_usec - start.tv_usec) / 1000;
+
+			if ( cb.num > before ) {
+				CPPUNIT_ASSERT( cb.last == ids[cb.num-1] );
+				CPPUNIT_ASSERT( elapsed >= 100 + 150 * long(cb.num-1) - 5 );
+			}
+			CPPUNIT_ASSERT( elapsed < 5000 );
+		}
+		CPPUNIT_ASSERT( tm.get_num_active() == 0 );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( TimerManagerTest );
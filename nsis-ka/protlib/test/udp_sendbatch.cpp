@@ -0,0 +1,151 @@
+/*
+ * test/udp_sendbatch.cpp - Test the UDPSendBatch class.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <cstring>
+#include <unistd.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "udp_sendbatch.h"
+
+using namespace protlib;
+
+
+static const int num_threads = 8;
+static const int msgs_per_thread = 200;
+
+struct sender_arg {
+	UDPSendBatch *batch;
+	int sock;
+	struct sockaddr_in *dest;
+	int failed;
+};
+
+static void *sender(void *argp) {
+	sender_arg *arg = static_cast<sender_arg *>(argp);
+	char payload[32];
+	memset(payload, 'x', sizeof(payload));
+
+	for (int i = 0; i < msgs_per_thread; i++) {
+		struct iovec iov;
+		iov.iov_base = payload;
+		iov.iov_len = sizeof(payload);
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = arg->dest;
+		msg.msg_namelen = sizeof(*arg->dest);
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+
+		if ( arg->batch->send(arg->sock, &msg)
+				!= (int) sizeof(payload) )
+			arg->failed++;
+	}
+	return 0;
+}
+
+
+class UDPSendBatchTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( UDPSendBatchTest );
+
+	CPPUNIT_TEST( testSingle );
+	CPPUNIT_TEST( testConcurrent );
+	CPPUNIT_TEST( testError );
+
+	CPPUNIT_TEST_SUITE_END();
+
+	int rx, tx;
+	struct sockaddr_in dest;
+
+	int drain() {
+		char buf[64];
+		int n = 0;
+		while ( recv(rx, buf, sizeof(buf), MSG_DONTWAIT) > 0 )
+			n++;
+		return n;
+	}
+
+  public:
+	void setUp() {
+		rx = socket(AF_INET, SOCK_DGRAM, 0);
+		tx = socket(AF_INET, SOCK_DGRAM, 0);
+
+		int size = 4 * 1024 * 1024;
+		setsockopt(rx, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+		memset(&dest, 0, sizeof(dest));
+		dest.sin_family = AF_INET;
+		dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		dest.sin_port = 0;
+		CPPUNIT_ASSERT( bind(rx, (struct sockaddr *) &dest,
+			sizeof(dest)) == 0 );
+		socklen_t len = sizeof(dest);
+		getsockname(rx, (struct sockaddr *) &dest, &len);
+	}
+
+	void tearDown() {
+		close(rx);
+		close(tx);
+	}
+
+	void testSingle() {
+		UDPSendBatch batch;
+		sender_arg arg = { &batch, tx, &dest, 0 };
+
+		sender(&arg);
+
+		CPPUNIT_ASSERT_EQUAL( 0, arg.failed );
+		CPPUNIT_ASSERT_EQUAL( msgs_per_thread, drain() );
+
+		udp_batch_stats_t stats = batch.get_stats();
+		CPPUNIT_ASSERT_EQUAL( (uint64) msgs_per_thread, stats.datagrams );
+		CPPUNIT_ASSERT_EQUAL( (uint64) msgs_per_thread, stats.batches );
+	}
+
+	void testConcurrent() {
+		UDPSendBatch batch;
+		pthread_t threads[num_threads];
+		sender_arg args[num_threads];
+
+		for (int i = 0; i < num_threads; i++) {
+			sender_arg arg = { &batch, tx, &dest, 0 };
+			args[i] = arg;
+			pthread_create(&threads[i], NULL, sender, &args[i]);
+		}
+		for (int i = 0; i < num_threads; i++) {
+			pthread_join(threads[i], NULL);
+			CPPUNIT_ASSERT_EQUAL( 0, args[i].failed );
+		}
+
+		udp_batch_stats_t stats = batch.get_stats();
+		CPPUNIT_ASSERT_EQUAL( (uint64) num_threads * msgs_per_thread,
+			stats.datagrams );
+		CPPUNIT_ASSERT( stats.batches <= stats.datagrams );
+		CPPUNIT_ASSERT( stats.max_batch
+				<= UDPSendBatch::default_max_batch );
+		CPPUNIT_ASSERT_EQUAL( num_threads * msgs_per_thread, drain() );
+	}
+
+	void testError() {
+		UDPSendBatch batch;
+		sender_arg arg = { &batch, -1, &dest, 0 };
+
+		sender(&arg);
+
+		// every datagram reports its own error
+		CPPUNIT_ASSERT_EQUAL( msgs_per_thread, arg.failed );
+		CPPUNIT_ASSERT_EQUAL( (uint64) 0, batch.get_stats().datagrams );
+	}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( UDPSendBatchTest );
@@ -66,13 +66,18 @@ struct ProcessingModuleParam : public ThreadParam {
 			AddressList &addresses,
 			Flowinfo &fi_service,
 			bool see = true,
-			bool sre = true
+			bool sre = true,
+			uint32 workers = 1
 	);
 	const  message::qaddr_t source;
 	AddressList &addresses;
 	Flowinfo &fi_service;
 	const  bool send_error_expedited;
 	const  bool send_reply_expedited;
+	/// number of session partitions, each processed by a worker thread of its own (1: no workers)
+	const  uint32 workers;
+	/// number of threads the processing module needs
+	uint32 get_thread_count() const { return workers > 1 ? workers + 4 : 4; }
 }; // end ProcessingModuleParam
 
 /// @class ProcessingModule
@@ -102,12 +107,18 @@ class ProcessingModule : public Thread {
 				uint32 timeout=15,
 				uint16 ip_ttl=103,
 				uint32 ghc=100);	// GIST hop count
+		/// worker owning the state of session sid
+		static uint32 get_worker(const uint128& sid, uint32 workers);
+		/// worker owning the session msg refers to (0 for messages without session)
+		static uint32 get_worker(const message* msg, uint32 workers);
 	protected:
 		void process_timer_message(message* msg);
 		void process_gist_api_msg(ntlp::APIMsg* apimsg);
 		void process_appl_msg(QoS_Appl_Msg* applmsg);
         void process_sig_msg(SignalingMsg* msg);
         void process_est_sig_msg(ExplicitSignalingMsg* msg);
+		void process_message(message* msg);
+		void process_due_refreshes(uint32 partition);
 
 	private:
 		/// module parameters
@@ -116,11 +127,23 @@ class ProcessingModule : public Thread {
 		state_manager *statemodule;
 		// reference to nslp_session_context_map
 		NSLP_Session_Context_Map* session_context_map;
+		/// input queues of the workers (empty if sessions are not partitioned)
+		vector<FastQueue*> worker_fq;
+		/// serialization buffer of the refresh passes of each partition
+		vector<NetMsg*> refresh_buffer;
+		/// size of the refresh buffers, larger RESERVEs get a NetMsg of their own
+		static const uint32 refresh_buffer_size = 4096;
+		/// refreshes sent in a row without workers before the sessions are unlocked for other messages
+		static const uint32 refresh_lock_batch = 64;
 		static const char* const errstr[];
 		void process_queue();
 		void rcv_appl_messages();
 		void rcv_gist_messages();
 		void process_elapsed_timers();
+		void process_worker_queue(uint32 nr);
+		bool send_to_worker(message* msg);
+		void lock_sessions();
+		void unlock_sessions();
 }; // end class ProcessingModule
 
 
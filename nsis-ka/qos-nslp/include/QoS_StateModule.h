@@ -108,7 +108,7 @@ public:
   void process_tp_recv_est_msg(NetMsg& msg, const ntlp::sessionid* sid, const ntlp::mri_explicitsigtarget* rcvd_mri);
 
   error_t process_outgoing(known_nslp_pdu& rsppdu, NetMsg*& msg, bool down, 
-			   const ntlp::sessionid* rcvd_sid, ntlp::mri_pathcoupled** rcvd_mri);
+			   const ntlp::sessionid* rcvd_sid, ntlp::mri_pathcoupled** rcvd_mri, NetMsg* buffer = NULL);
 
   error_t process_outgoing_est_msg(known_nslp_pdu& rsppdu, NetMsg*& msg, const ntlp::sessionid* rcvd_sid,
 		  		ntlp::mri_explicitsigtarget** rcvd_mri);
@@ -128,7 +128,7 @@ public:
   error_t  process_rii(NSLP_Session_Context* context, reservereq* reservemsg, const ntlp::sessionid* rcvd_sid, 
 		       TimerMsg* rii_tmsg, bool is_qni, bool is_qnr, const ntlp::mri_pathcoupled* rcvd_pc_mri, bool down, bool is_merging_node);
 
-  error_t  process_qspec(reservereq* reservemsg, qspec_object *&qspec_obj);
+  error_t  process_qspec(reservereq* reservemsg, qspec_object *&qspec_obj, uint16 oif);
 
   void send_response_with_rii(const rii* rii, const ntlp::sessionid* sid, const ntlp::mri* mri, bool down,
 			      info_spec::errorclass_t err_class, info_spec::errorcode_t err_code, const session_auth_object* sauth_object= NULL, const vlsp_object* vlsp_obj= NULL);
@@ -139,6 +139,10 @@ public:
   void send_refreshing_reserve(const ntlp::sessionid &sid, const ntlp::mri_pathcoupled &mri,
 		  NSLP_Session_Context *session_context, NSLP_Flow_Context *flow_context);
 
+  reservereq* create_refreshing_reserve(NSLP_Session_Context *session_context, NSLP_Flow_Context *flow_context, bool &down);
+
+  void schedule_refresh(const ntlp::sessionid &sid, const ntlp::mri_pathcoupled &mri, NSLP_Flow_Context *flow_context, uint32 wait);
+
   void process_response_msg(known_nslp_pdu* known_pdu, const ntlp::sessionid* rcvd_sid, const ntlp::mri* rcvd_mri, bool down);
 
   void process_notify_msg(known_nslp_pdu* known_pdu, const ntlp::sessionid* rcvd_sid, const ntlp::mri_pathcoupled* rcvd_mri, bool down, error_t& nslpres);
@@ -224,7 +228,7 @@ private:
   bool is_flow_destination(const ntlp::mri_pathcoupled* mri) const;
   static const char *const errstr[];
 
-  error_t generate_pdu(const known_nslp_pdu& pdu, NetMsg*& msg);
+  error_t generate_pdu(const known_nslp_pdu& pdu, NetMsg*& msg, NetMsg* buffer = NULL);
 }; // end class state_manager
 
 
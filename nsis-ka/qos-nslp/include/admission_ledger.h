@@ -0,0 +1,125 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file admission_ledger.h
+/// QoS NSLP admission control ledger
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2010, all rights reserved by
+// - Institute of Telematics, Karlsruhe Institute of Technology
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA.
+//
+// ===========================================================
+/** @ingroup iermf
+ * @file
+ * Bandwidth admitted per outgoing interface and traffic class
+ */
+
+#ifndef _NSLP__ADMISSION_LEDGER_H_
+#define _NSLP__ADMISSION_LEDGER_H_
+
+#include <vector>
+
+#include "protlib_types.h"
+
+using namespace protlib;
+
+namespace qos_nslp {
+
+/** @addtogroup iermf Resource Management Function
+ * @{
+ */
+
+/// Bandwidth admitted per outgoing interface and traffic class
+/** Every interface has a capacity and the sum of the admitted
+ * reservations for each class. Reservations and releases only update
+ * these counters with atomic operations (compare-and-swap for
+ * reservations), so any number of threads may admit flows concurrently
+ * without a lock and without ever exceeding the capacity of a class.
+ *
+ * Interfaces are added on first use with the default capacities and
+ * are never removed. The number of interfaces is limited by the size
+ * of the table given to the constructor.
+ */
+class admission_ledger {
+public:
+	/// traffic classes, numbered like the Y.2171 admission priorities
+	enum traffic_class_t {
+		tc_best_effort	= 0,
+		tc_af		= 1,
+		tc_ef		= 2,
+		tc_max
+	};
+
+	/// usage of one class of an interface
+	struct utilization_t {
+		uint16 interface;
+		traffic_class_t tclass;
+		/// in bit/s
+		uint64 capacity;
+		/// in bit/s
+		uint64 reserved;
+	};
+
+	admission_ledger(uint32 max_interfaces = 256);
+	~admission_ledger();
+
+	/// capacity of the class on interfaces that are not yet known
+	void set_default_capacity(traffic_class_t tclass, uint64 bandwidth);
+	/// set the capacity of the class on one interface
+	bool set_capacity(uint16 interface, traffic_class_t tclass, uint64 bandwidth);
+
+	/// admit bandwidth, fails if it would exceed the capacity
+	bool reserve(uint16 interface, traffic_class_t tclass, uint64 bandwidth);
+	/// give back bandwidth admitted by reserve()
+	void release(uint16 interface, traffic_class_t tclass, uint64 bandwidth);
+
+	/// usage of one class of an interface, false for unknown interfaces
+	bool get_utilization(uint16 interface, traffic_class_t tclass, uint64& capacity, uint64& reserved) const;
+	/// usage of all classes of all known interfaces
+	void get_utilization(std::vector<utilization_t>& result) const;
+
+private:
+	struct interface_entry {
+		/// interface number + 1, 0 if the entry is unused
+		uint32 key;
+		/// set once the capacities are initialized
+		uint32 ready;
+		uint64 capacity[tc_max];
+		uint64 reserved[tc_max];
+	};
+
+	interface_entry* find(uint16 interface) const;
+	interface_entry* find_or_add(uint16 interface);
+
+	const uint32 size;
+	interface_entry* entries;
+	uint64 default_capacity[tc_max];
+
+	// not copyable
+	admission_ledger(const admission_ledger&);
+	admission_ledger& operator=(const admission_ledger&);
+}; // end admission_ledger
+
+//@}
+
+} // end namespace qos_nslp
+
+#endif // _NSLP__ADMISSION_LEDGER_H_
@@ -96,6 +96,10 @@ public:
     void set_qspec(const qspec_object &qspec);
     const qspec_object &get_qspec() const;
 
+    // outgoing interface the resources of the QSPEC are reserved on
+    void set_outgoing_interface(uint16 oif);
+    uint16 get_outgoing_interface() const;
+
 
     // methods to handle the refreshing of reservations
     void set_refresh_period(uint32 refr_per);
@@ -103,6 +107,10 @@ public:
 
     void set_reduced_refresh(bool red_refr);
     bool get_reduced_refresh() const;
+
+    // sequence number of the refresh scheduled last, see refresh_scheduler
+    uint32 next_refresh_seq();
+    uint32 get_refresh_seq() const;
     
     // Stored value never used. So this methods aren't useful anymore.
     //void set_refresh_timer(timer_t sec);
@@ -177,12 +185,20 @@ private:
     // Determines whether reduced refreshes are used or not
     bool reduced_refresh;
 
+    // Sequence number of the refresh scheduled last. Refreshes scheduled
+    // earlier carry a smaller number, they are stale and are not sent.
+    uint32 refresh_seq;
+
     // Stored value is never used.
     //time_t refresh_timer;
 
     // TRUE if the reservation for this flow is already set up
     bool reserved;
 
+    // The RMF admitted the QSPEC on this interface. Releases must
+    // use it even if the route of the flow changed meanwhile.
+    uint16 outgoing_interface;
+
     // If an outgoing reserve message has the replace bit set
     // and is after this waiting for a response which tears
     // down old reservations, this flag is set.
@@ -44,6 +44,11 @@ using namespace protlib;
 namespace qos_nslp {
 
 
+// The session contexts are spread over shards by their session ID, each
+// shard with a lock of its own, so threads working on different sessions
+// rarely wait for each other. The logical MRIs of the flows are indexed in
+// hash maps, spread over the shards by the MRI. A lookup holds at most one
+// shard lock at a time.
 class NSLP_Session_Context_Map {
 public:
     // rii_hashmap maps RII numbers to pointers of RII objects
@@ -56,19 +61,20 @@ public:
         search_context() { sidlist = NULL; };
         ~search_context() { delete sidlist; };
 
-        list<simple_sid> *sidlist;
-        list<simple_sid>::iterator slit;
+        list<uint128> *sidlist;
+        list<uint128>::iterator slit;
     };
 
 
     // constructor
-    NSLP_Session_Context_Map();
+    NSLP_Session_Context_Map(uint32 shards = default_shards);
 
     // destructor
     ~NSLP_Session_Context_Map();
 
 
     NSLP_Session_Context *find_session_context(const sessionid &sid);
+    // the reference is valid only until erase(sid), see there
     NSLP_Session_Context_Map::riimap_t &get_rii_hashmap(const sessionid &sid);
 
     void insert_mri2context_map(const sessionid &sid, const ntlp::mri_pathcoupled &lmri);
@@ -81,50 +87,98 @@ public:
     typedef void (state_manager::*proc_func_t)(NSLP_Session_Context *, void *, void *);
     void traverse_contexts(state_manager *sm, proc_func_t func, void *param1, void *param2);
 
+    static const uint32 default_shards = 64;
+
 private:
+    static const uint32 rii_buckets = 5;
+
+    // a hash function for the full session ID
+    struct hash_sid {
+        size_t operator()(const uint128 &sid) const {
+            uint64 h = ((uint64)sid.w1 << 32 | sid.w2) ^ ((uint64)sid.w3 << 32 | sid.w4);
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdULL;
+            h ^= h >> 33;
+            return (size_t)h;
+        }
+    };
+
+    // everything stored for a session
+    struct session_entry {
+        // a session rarely waits for more than a few RESPONSEs, the
+        // default bucket table would make up most of the entry
+        session_entry() : context(NULL), rii_hashmap(rii_buckets) {}
+
+        // NULL while only RIIs of the session are known
+        NSLP_Session_Context *context;
+
+        // RII objects of the requests of this session waiting for a RESPONSE
+        riimap_t rii_hashmap;
+
+        // logical MRIs the session is indexed under in mri2context_map
+        vector<ntlp::mri_pathcoupled> logical_mris;
+    };
+
     // session_context_map stores all NSLP_Session_Contexts (session states)
-    typedef hashmap_t<simple_sid, NSLP_Session_Context *> session_context_map_t;
+    typedef hashmap_t<uint128, session_entry, hash_sid> session_context_map_t;
     typedef session_context_map_t::iterator session_context_map_it_t;
     typedef session_context_map_t::const_iterator session_context_map_const_it_t;
-    session_context_map_t session_context_map;
 
-    // context multimap that stores flows with a logical mri associated
-    typedef multimap<const ntlp::mri_pathcoupled *, simple_sid, ntlp::mri_pathcoupled::ltmri> mri2contextmap_t;
+    // index of the sessions that have flows with a logical MRI associated
+    typedef hashmap_t<const ntlp::mri_pathcoupled, vector<uint128>,
+            NSLP_Session_Context::hash_pc_mri, NSLP_Session_Context::equal_to_pc_mri> mri2contextmap_t;
     typedef mri2contextmap_t::iterator mri2context_map_it_t;
-    typedef mri2contextmap_t::const_iterator mri2context_map_const_it_t;
-    mri2contextmap_t mri2context_map;
 
-    // map which maps a SID to a pointers of a rii_hashmap
-    typedef hashmap_t<simple_sid, riimap_t *> session_rii_map_t;
-    typedef session_rii_map_t::iterator session_rii_map_it_t;
-    typedef session_rii_map_t::const_iterator session_rii_map_const_it_t;
-    session_rii_map_t session_to_rii_hashmap;
+    struct shard_t {
+        session_context_map_t session_context_map;
+        mri2contextmap_t mri2context_map;
 
+        // This mutex is used to lock the maps of the shard
+        pthread_mutex_t mutex;
+    };
 
-    // This mutex is used to lock the context map 
-    pthread_mutex_t mutex;
+    vector<shard_t *> shards;
 
     // mutex attribute for setting mutex kind
     pthread_mutexattr_t mutex_attr;
 
 
-    // lock mutex
-    void lock();
+    shard_t &get_shard(const uint128 &sid) const;
+    shard_t &get_shard(const ntlp::mri_pathcoupled &mri) const;
 
-    // unlock mutex
-    void unlock();
+    // lock mutex of a shard
+    void lock(shard_t &shard);
+
+    // unlock mutex of a shard
+    void unlock(shard_t &shard);
+
+    // not copyable
+    NSLP_Session_Context_Map(const NSLP_Session_Context_Map&);
+    NSLP_Session_Context_Map& operator=(const NSLP_Session_Context_Map&);
 }; // end class NSLP_Session_Context_Map
 
 
-inline void NSLP_Session_Context_Map::lock() {
-    if (pthread_mutex_lock(&mutex)) {
+inline NSLP_Session_Context_Map::shard_t &NSLP_Session_Context_Map::get_shard(const uint128 &sid) const {
+    return *shards[hash_sid()(sid) % shards.size()];
+}
+
+
+inline NSLP_Session_Context_Map::shard_t &NSLP_Session_Context_Map::get_shard(const ntlp::mri_pathcoupled &mri) const {
+    uint64 h = NSLP_Session_Context::hash_pc_mri()(mri);
+    h *= 0x9e3779b97f4a7c15ULL;
+    return *shards[(h >> 32) % shards.size()];
+}
+
+
+inline void NSLP_Session_Context_Map::lock(shard_t &shard) {
+    if (pthread_mutex_lock(&shard.mutex)) {
         ERRLog("NSLP_Session_Context_Map", "Error while locking mutex");
     }
 }
 
 
-inline void NSLP_Session_Context_Map::unlock() {
-    pthread_mutex_unlock(&mutex);
+inline void NSLP_Session_Context_Map::unlock(shard_t &shard) {
+    pthread_mutex_unlock(&shard.mutex);
 }
 
 } // end namespace qos_nslp
@@ -54,6 +54,8 @@ enum qos_nslp_configpar_id_t {
 	qosnslpconf_rmf_vlsp_link_down_script_drain,
 	qosnslpconf_rmf_vlsp_link_down_script_source,
 	qosnslpconf_sauth_hmac_verify,
+	qosnslpconf_processing_workers,
+	qosnslpconf_reduced_refreshes,
 	qosnslpconf_maxparno
 };
 
@@ -0,0 +1,138 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_scheduler.h
+/// QoS NSLP refresh scheduler
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2010, all rights reserved by
+// - Institute of Telematics, Karlsruhe Institute of Technology
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA.
+//
+// ===========================================================
+/** @ingroup QoS_StateModule
+ * @file
+ * Refreshes of reservations, collected by their due time
+ */
+
+#ifndef _NSLP__REFRESH_SCHEDULER_H_
+#define _NSLP__REFRESH_SCHEDULER_H_
+
+#include <pthread.h>
+#include <time.h>
+#include <map>
+#include <vector>
+
+#include "protlib_types.h"
+#include "mri_pc.h"
+
+using namespace protlib;
+
+namespace qos_nslp {
+
+/** @addtogroup QoS_StateModule NSLP protocol state machine
+ * @{
+ */
+
+/// Refreshes of reservations, collected by their due time
+/** Instead of starting a timer for every reservation, the refreshes are
+ * put into buckets of one second by their (jittered) due time. A bucket
+ * that is due is taken out as a whole and refreshed in one pass by the
+ * thread owning its sessions, see ProcessingModule::process_due_refreshes().
+ *
+ * The sessions are split into the same partitions as among the processing
+ * workers, so a worker only gets the refreshes of its own sessions.
+ * Entries are never removed before they are due: every refresh of a flow
+ * gets the next sequence number of its flow context, an entry whose number
+ * no longer matches the one saved there (the reservation was torn down or
+ * rescheduled) is dropped when its bucket is refreshed.
+ */
+class refresh_scheduler {
+public:
+	/// a refresh of a flow of a session
+	struct entry_t {
+		uint128 sid;
+		ntlp::mri_pathcoupled mri;
+		time_t due;
+		/// sequence number of the refresh in its flow context
+		uint32 seq;
+	};
+
+	/// counters, summed up over all passes
+	struct stats_t {
+		/// refreshes put into a bucket
+		uint64 scheduled;
+		/// passes over due buckets
+		uint64 passes;
+		/// refreshing RESERVEs sent
+		uint64 sent;
+		/// of those, RESERVEs without QSPEC
+		uint64 reduced;
+		/// entries dropped because their reservation is gone or was rescheduled
+		uint64 stale;
+		/// CPU time of the threads in the passes, in microseconds
+		uint64 cpu_usec;
+	};
+
+	static refresh_scheduler& instance();
+
+	/// split the sessions into this many partitions (number of processing workers)
+	void set_partitions(uint32 n);
+	uint32 get_partitions() const { return partitions.size(); }
+	/// partition the refreshes of session sid are put into
+	uint32 get_partition(const uint128& sid) const;
+
+	/// refresh the flow mri of session sid at time due, seq from NSLP_Flow_Context::next_refresh_seq()
+	void schedule(const uint128& sid, const ntlp::mri_pathcoupled& mri, time_t due, uint32 seq);
+	/// take the entries of all buckets of a partition due at time now, false if there are none
+	bool get_due(uint32 partition, time_t now, std::vector<entry_t>& due);
+	/// milliseconds until the next bucket of a partition is due, at most wait
+	uint32 get_wait(uint32 partition, uint32 wait) const;
+
+	/// add the outcome of a pass to the counters
+	void count_pass(uint32 sent, uint32 reduced, uint32 stale, uint64 cpu_usec);
+	stats_t get_stats() const;
+
+	refresh_scheduler(uint32 n = 1);
+	~refresh_scheduler();
+
+private:
+	typedef std::map<time_t, std::vector<entry_t> > bucketmap_t;
+
+	struct partition_t {
+		mutable pthread_mutex_t mutex;
+		bucketmap_t buckets;
+	};
+
+	std::vector<partition_t*> partitions;
+	stats_t stats;
+
+	static refresh_scheduler* scheduler_p;
+
+	// not copyable
+	refresh_scheduler(const refresh_scheduler&);
+	refresh_scheduler& operator=(const refresh_scheduler&);
+}; // end refresh_scheduler
+
+//@}
+
+} // end namespace qos_nslp
+
+#endif // _NSLP__REFRESH_SCHEDULER_H_
@@ -39,6 +39,8 @@
 #include "qspec.h"
 #include "qspec_pdu.h"
 #include "vlsp_object.h"
+#include "mri_pc.h"
+#include "admission_ledger.h"
 
 using namespace protlib;
 using namespace qspec;
@@ -55,9 +57,9 @@ class rmf {
 public:
 	static const uint32 max_avail_bandwidth_default;
 	static const uint32 reserved_default;
+	/// capacity of each outgoing interface for the class, in bit/s
 	long static AF_available_bandwidth;
 	long static EF_available_bandwidth;
-	long static EF_res_avg_rate;
 	long static BE_available_bandwidth;
 	// @{
 	/// constructor
@@ -86,8 +88,14 @@ public:
 
 	/// process qspec from QUERY msg
 	void process_qspec_in_query(qspec_pdu* q);
-	bool reserve_resources(const qspec_pdu* q);
-	void release_resources(const qspec_pdu* q);
+	bool reserve_resources(const qspec_pdu* q, uint16 oif = 0);
+	void release_resources(const qspec_pdu* q, uint16 oif = 0);
+	/// give back reserved resources without tearing down the reservation
+	void rollback_resources(const qspec_pdu* q, uint16 oif = 0);
+	/// outgoing interface of the data flow, to be passed to reserve_resources()
+	static uint16 get_outgoing_interface(const ntlp::mri_pathcoupled& flow);
+	/// bandwidth admitted on all outgoing interfaces
+	static void get_utilization(std::vector<admission_ledger::utilization_t>& result);
 //	void set_AF_available_bandwidth(long a);
 
 	/// process VLSP object
@@ -96,6 +104,11 @@ public:
 	void process_vlsp_object_teardown(const vlsp_object* vlspobj);
 
 private:
+	/// reservations of all flows, shared by all processing workers
+	static admission_ledger ledger;
+
+	static bool get_admission(const qspec_pdu* q, admission_ledger::traffic_class_t& tclass, uint64& bandwidth);
+
 	uint32 max_available_bandwidth;
 	uint32 reserved_bandwidth;
 	uint32 available_bandwidth;
@@ -36,6 +36,8 @@
 #include <iostream>
 #include <string>
 #include <sstream>
+#include <algorithm>
+#include <time.h>
 
 // for setting the epoch id with gettimeofday
 #include "sys/time.h"
@@ -59,6 +61,7 @@
 #include "ProcessingModule.h"
 #include "nslp_session_context_map.h"
 #include "context_manager.h"
+#include "refresh_scheduler.h"
 
 #include "qos_nslp_conf.h"
 
@@ -93,14 +96,16 @@ pthread_mutexattr_t session_mutex_attr;
   ProcessingModuleParam::ProcessingModuleParam(uint32 sleep_time,
 			       AddressList &addresses,
 			       Flowinfo &fi_service,
-			       bool see, bool sre
+			       bool see, bool sre,
+			       uint32 workers
 			       )
   : ThreadParam(sleep_time,"QoSProcessing"),
     source(message::qaddr_qos_nslp_signaling),
     addresses(addresses),
     fi_service(fi_service),
     send_error_expedited(see),
-    send_reply_expedited(sre)
+    send_reply_expedited(sre),
+    workers(workers > 0 ? workers : 1)
 {
 	// we have to set the epoch id at system start time
 	struct timeval timenow;
@@ -132,6 +137,20 @@ ProcessingModule::ProcessingModule(const ProcessingModuleParam& p)
 	Context_Manager::instance()->add_context_map();
 	session_context_map = Context_Manager::instance()->get_scm();
 	statemodule = new state_manager(param.addresses, param.fi_service);
+
+	// worker queues are not known to the QueueManager, messages reach them
+	// via the threads reading the signaling, GIST API and timer queues
+	if (p.workers > 1) {
+		for (uint32 i = 0; i < p.workers; i++) {
+			ostringstream name;
+			name << message::get_qaddr_name(p.source) << " worker " << i;
+			worker_fq.push_back(new FastQueue(name.str().c_str(), true));
+		}
+		ILog(param.name, "Sessions are partitioned among " << p.workers << " workers");
+	}
+	// refreshes are sent by the thread owning their session
+	refresh_scheduler::instance().set_partitions(p.workers);
+	refresh_buffer.resize(p.workers, NULL);
 	// TEST
 	pthread_mutexattr_init(&session_mutex_attr);
 #ifdef _DEBUG
@@ -151,6 +170,12 @@ ProcessingModule::~ProcessingModule()
 	DLog(param.name, "Destroying ProcessingModule object");
 	QueueManager::instance()->unregister_queue(param.source);
 	delete statemodule;
+	for (uint32 i = 0; i < worker_fq.size(); i++)
+		delete worker_fq[i];
+	worker_fq.clear();
+	for (uint32 i = 0; i < refresh_buffer.size(); i++)
+		delete refresh_buffer[i];
+	refresh_buffer.clear();
 	// TEST
 	pthread_mutex_destroy(&session_mutex);
 	pthread_mutexattr_destroy(&session_mutex_attr);
@@ -180,6 +205,8 @@ void ProcessingModule::main_loop(uint32 nr)
 		process_elapsed_timers();
 		break;
 	default: 
+		if (nr - 5 < worker_fq.size())
+			process_worker_queue(nr - 5);
 		break;
 	} // end switch for threads
 
@@ -195,8 +222,6 @@ void
 ProcessingModule::process_queue()
 { 
 	message* msg = NULL;
-	SignalingMsg* sigmsg = NULL;
-	ExplicitSignalingMsg* explsigmsg = NULL;
 
 	FastQueue* fq = QueueManager::instance()->get_queue(param.source);
 	if (!fq) {
@@ -213,38 +238,10 @@ ProcessingModule::process_queue()
 		if (!msg)
 			continue;
 
-		switch (msg->get_type()) {
-		case message::type_signaling:
-			sigmsg = dynamic_cast<SignalingMsg*>(msg);
-			if (sigmsg)
-				// outgoing signaling message, sent to GIST
-				process_sig_msg(sigmsg);
-			else {
-				ERRLog(param.name, "Cannot cast message from source " << 
-						msg->get_qaddr_name() << " of type " << 
-						msg->get_type_name() << " to SignalingMsg");
-				delete msg;
-			}
-			break;
-		case message::type_explicit_signaling:
-			explsigmsg = dynamic_cast<ExplicitSignalingMsg*>(msg);
-			if (explsigmsg) {
-				// outgoing explicit signaling message, sent to GIST
-				process_est_sig_msg(explsigmsg);
-			}
-			else {
-				ERRLog(param.name, "Cannot cast message from source " << 
-						msg->get_qaddr_name() << " of type " << 
-						msg->get_type_name() << " to ExplicitSignalingMsg");
-				delete msg;
-			}
-			break;
-		default:
-			ERRLog(param.name, "Received a message from " << msg->get_qaddr_name() << 
-					" of type " << msg->get_type_name() << 
-					" that cannot be processed here, TYPE: " << msg->get_type());
-			delete msg;
-		} // end switch
+		if (worker_fq.empty())
+			process_message(msg);
+		else
+			send_to_worker(msg);
 	} // end while running
 
 	// signal other threads for faster termination
@@ -258,6 +255,198 @@ ProcessingModule::process_queue()
 } // end process_queue
 
 
+/**
+ * process the messages of the sessions owned by a worker
+ * @param nr -- number of the worker
+ */
+void
+ProcessingModule::process_worker_queue(uint32 nr)
+{
+	const unsigned int batchsize = 64;
+	message* msgs[batchsize];
+	FastQueue* fq = worker_fq[nr];
+
+	// max. waiting time at internal msg queue
+	const uint32 wait = param.sleep_time * 1000;
+
+	ILog(param.name, "Worker " << nr << " started");
+	while (get_state() == STATE_RUN) {
+		unsigned int n = fq->dequeue_batch_timedwait(msgs, batchsize,
+				refresh_scheduler::instance().get_wait(nr, wait));
+		for (unsigned int i = 0; i < n; i++)
+			process_message(msgs[i]);
+
+		process_due_refreshes(nr);
+	} // end while running
+} // end process_worker_queue
+
+
+/**
+ * process a message that refers to (at most) one session: outgoing
+ * signaling messages, GIST API messages and elapsed timers
+ */
+void
+ProcessingModule::process_message(message* msg)
+{
+	SignalingMsg* sigmsg = NULL;
+	ExplicitSignalingMsg* explsigmsg = NULL;
+	ntlp::APIMsg* apimsg = NULL;
+
+	switch (msg->get_type()) {
+	case message::type_signaling:
+		sigmsg = dynamic_cast<SignalingMsg*>(msg);
+		if (sigmsg)
+			// outgoing signaling message, sent to GIST
+			process_sig_msg(sigmsg);
+		else {
+			ERRLog(param.name, "Cannot cast message from source " << 
+					msg->get_qaddr_name() << " of type " << 
+					msg->get_type_name() << " to SignalingMsg");
+			delete msg;
+		}
+		break;
+	case message::type_explicit_signaling:
+		explsigmsg = dynamic_cast<ExplicitSignalingMsg*>(msg);
+		if (explsigmsg) {
+			// outgoing explicit signaling message, sent to GIST
+			process_est_sig_msg(explsigmsg);
+		}
+		else {
+			ERRLog(param.name, "Cannot cast message from source " << 
+					msg->get_qaddr_name() << " of type " << 
+					msg->get_type_name() << " to ExplicitSignalingMsg");
+			delete msg;
+		}
+		break;
+	case message::type_API:
+		apimsg = dynamic_cast<ntlp::APIMsg*>(msg);
+		if (apimsg)
+			// incoming GIST API message
+			process_gist_api_msg(apimsg);
+		else {
+			ERRLog(param.name, "Cannot cast message from source " << 
+					msg->get_qaddr_name() << " of type " << 
+					msg->get_type_name() << " to APIMsg");
+			delete msg;
+		}
+		break;
+	case message::type_timer:
+		process_timer_message(msg);
+		break;
+	default:
+		ERRLog(param.name, "Received a message from " << msg->get_qaddr_name() << 
+				" of type " << msg->get_type_name() << 
+				" that cannot be processed here, TYPE: " << msg->get_type());
+		delete msg;
+	} // end switch
+} // end process_message
+
+
+/**
+ * Worker owning the state of a session. All messages and timers of the
+ * session are processed by this worker and keep their order.
+ */
+uint32
+ProcessingModule::get_worker(const uint128& sid, uint32 workers)
+{
+	if (workers <= 1)
+		return 0;
+
+	// spread the bits of the session id before reducing it
+	uint32 h = sid.w1 ^ sid.w2 ^ sid.w3 ^ sid.w4;
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+
+	return h % workers;
+}
+
+
+/**
+ * Worker owning the session a message refers to. Messages without a
+ * session (e.g. mobility notifications from GIST) are processed by
+ * worker 0.
+ */
+uint32
+ProcessingModule::get_worker(const message* msg, uint32 workers)
+{
+	if (workers <= 1 || msg == NULL)
+		return 0;
+
+	switch (msg->get_type()) {
+	case message::type_signaling:
+		{
+			const SignalingMsg* sigmsg = dynamic_cast<const SignalingMsg*>(msg);
+			if (sigmsg)
+				return get_worker(sigmsg->get_sid(), workers);
+		}
+		break;
+	case message::type_explicit_signaling:
+		{
+			const ExplicitSignalingMsg* explsigmsg = dynamic_cast<const ExplicitSignalingMsg*>(msg);
+			if (explsigmsg)
+				return get_worker(explsigmsg->get_sid(), workers);
+		}
+		break;
+	case message::type_API:
+		{
+			const ntlp::APIMsg* apimsg = dynamic_cast<const ntlp::APIMsg*>(msg);
+			if (apimsg && apimsg->get_sessionid())
+				return get_worker(*apimsg->get_sessionid(), workers);
+		}
+		break;
+	case message::type_timer:
+		{
+			// all QoS NSLP timers carry the session id as first parameter
+			const TimerMsg* tmsg = dynamic_cast<const TimerMsg*>(msg);
+			if (tmsg && tmsg->get_param1())
+				return get_worker(*static_cast<const sessionid*>(tmsg->get_param1()), workers);
+		}
+		break;
+	default:
+		break;
+	}
+
+	return 0;
+}
+
+
+/**
+ * pass a message on to the queue of the worker owning its session
+ */
+bool
+ProcessingModule::send_to_worker(message* msg)
+{
+	if (msg->send_to(worker_fq[get_worker(msg, worker_fq.size())]))
+		return true;
+
+	ERRLog(param.name, "Cannot pass message from " << msg->get_qaddr_name() << " to its worker, dropping it");
+	delete msg;
+	return false;
+}
+
+
+/**
+ * Serialize the processing of sessions. If the sessions are partitioned
+ * among workers, a session is only processed by the worker owning it,
+ * so no lock is needed.
+ */
+void
+ProcessingModule::lock_sessions()
+{
+	if (worker_fq.empty())
+		pthread_mutex_lock(&session_mutex);
+}
+
+
+void
+ProcessingModule::unlock_sessions()
+{
+	if (worker_fq.empty())
+		pthread_mutex_unlock(&session_mutex);
+}
+
+
 /** This function processes internal message from Signaling Application.
  * @param applmsg received internal message from Signaling Application.
  */
@@ -531,14 +720,14 @@ void ProcessingModule::process_gist_api_msg(ntlp::APIMsg* apimsg)
 	// assertion: rcvd_sid != NULL
 	if(r_mri->get_mrm() == mri::mri_t_pathcoupled) {
 		if (nslp_data == NULL) {
-			pthread_mutex_lock(&session_mutex);
+			lock_sessions();
 			DLog(param.name, "SII handle is " << sii);
 			DLog("ProcessingModule", "NN status is: " << apimsg->get_msgstatus());
 			if (apimsg_subtype == APIMsg::NetworkNotification) {
 				bool down = rcvd_mri->get_downstream();
 				statemodule.process_sii_handle(rcvd_sid, rcvd_mri, down, sii, apimsg->get_msgstatus());
 			}
-			pthread_mutex_unlock(&session_mutex);
+			unlock_sessions();
 		}
 		else {
 			uchar* nslp_buf = nslp_data->get_buffer();
@@ -553,7 +742,7 @@ void ProcessingModule::process_gist_api_msg(ntlp::APIMsg* apimsg)
 			ntlp::sessionid* my_sid = new ntlp::sessionid(*rcvd_sid);
 	      
 	
-			pthread_mutex_lock(&session_mutex);
+			lock_sessions();
 			DLog(param.name, "process_gist_api_msg() - received PDU now parsing...");
 	
 			bool down = rcvd_mri->get_downstream();
@@ -602,7 +791,7 @@ void ProcessingModule::process_gist_api_msg(ntlp::APIMsg* apimsg)
 			// are not deleted by calling tpmsg destructor now
 			delete apimsg;
 			DLog(param.name,"process_gist_api_msg() - done.");
-			pthread_mutex_unlock(&session_mutex);
+			unlock_sessions();
 		} // end if nslp_data in APIMsg existing
 	}
 	else if(r_mri->get_mrm() == mri::mri_t_explicitsigtarget) {
@@ -619,7 +808,7 @@ void ProcessingModule::process_gist_api_msg(ntlp::APIMsg* apimsg)
 			ntlp::sessionid* my_sid = new ntlp::sessionid(*rcvd_sid);
 	      
 	
-			pthread_mutex_lock(&session_mutex);
+			lock_sessions();
 			DLog(param.name, "process_gist_api_msg() - received PDU now parsing...");
 	
 
@@ -640,7 +829,7 @@ void ProcessingModule::process_gist_api_msg(ntlp::APIMsg* apimsg)
 			// are not deleted by calling tpmsg destructor now
 			delete apimsg;
 			DLog(param.name,"process_gist_api_msg() - done.");
-			pthread_mutex_unlock(&session_mutex);
+			unlock_sessions();
 		} // end if nslp_data in APIMsg existing
 	}
 	else {
@@ -665,7 +854,7 @@ ProcessingModule::process_sig_msg(SignalingMsg* sigmsg)
   assert(sigmsg!=NULL);
 
   sessionid* process_sid = new sessionid( sigmsg->get_sid() );
-  pthread_mutex_lock(&session_mutex);
+  lock_sessions();
 
   if (sigmsg->get_pdu())
   {
@@ -727,7 +916,7 @@ ProcessingModule::process_sig_msg(SignalingMsg* sigmsg)
     apimsg->set_invalidateroutingstate(1, nslp_mri, APIMsg::bad, false);
     apimsg->send_to(message::qaddr_coordination);
   }
-  pthread_mutex_unlock(&session_mutex);
+  unlock_sessions();
 
 } // end process_sig_msg
 
@@ -751,7 +940,7 @@ ProcessingModule::process_est_sig_msg(ExplicitSignalingMsg* sigmsg)
 	pdu = sigmsg->get_pdu();
 	if(pdu) {
 		sessionid* sid = new sessionid(sigmsg->get_sid());
-		pthread_mutex_lock(&session_mutex);
+		lock_sessions();
 
 		ntlp::mri_explicitsigtarget* sig_mri = sigmsg->get_sig_mri()->copy();
 
@@ -775,7 +964,7 @@ ProcessingModule::process_est_sig_msg(ExplicitSignalingMsg* sigmsg)
 		
 			SendMessage(buffer, buffer_size, sid, sig_mri, sii_handle);
 		}
-		pthread_mutex_unlock(&session_mutex);
+		unlock_sessions();
 	}
 } // end process_est_sig_msg
 
@@ -1013,7 +1202,10 @@ void ProcessingModule::rcv_gist_messages()
 			}
 
 			// process incoming GIST API messages
-			process_gist_api_msg(apimsg);
+			if (worker_fq.empty())
+				process_gist_api_msg(apimsg);
+			else
+				send_to_worker(apimsg);
 			apimsg = NULL;
 		} else {
 			ERRLog("GISTmsg receiver", "cannot cast message of type " << msg->get_type_name() << " to APIMsg");
@@ -1045,7 +1237,13 @@ void ProcessingModule::process_elapsed_timers()
 
 	EVLog("Timerchecker", "Timerchecker started");
 	while ( !done && (get_state() == STATE_RUN) ) {
-		msg = fq->dequeue_timedwait(wait);
+		// without workers, this thread also sends the refreshes
+		if (worker_fq.empty()) {
+			msg = fq->dequeue_timedwait(refresh_scheduler::instance().get_wait(0, wait));
+			process_due_refreshes(0);
+		}
+		else
+			msg = fq->dequeue_timedwait(wait);
 		if (!msg)
 			continue;
 
@@ -1053,7 +1251,10 @@ void ProcessingModule::process_elapsed_timers()
 		if (msg->get_type() != message::type_timer)
 			continue;
 
-		process_timer_message(msg);
+		if (worker_fq.empty())
+			process_timer_message(msg);
+		else
+			send_to_worker(msg);
 
 		// delete msg;
 		msg = NULL;
@@ -1078,7 +1279,6 @@ ProcessingModule::SendMessage(uchar* nslp_data, uint32 nslp_data_size, sessionid
 	state_manager::error_t nslpres = state_manager::error_ok;
 
 	uint32 size = nslp_data_size + sizeof(size);
-	NetMsg* netmsg = NULL;
 
 	if (size > NetMsg::max_size) {
 		ERRLog(param.name, "state_manager::generate_pdu()."
@@ -1087,13 +1287,9 @@ ProcessingModule::SendMessage(uchar* nslp_data, uint32 nslp_data_size, sessionid
 		nslpres = state_manager::error_pdu_too_big;
 	}
 	else {
-		// allocate a netmsg with the corresponding buffer size
-		netmsg = new(nothrow) NetMsg(size);
-		if (netmsg) {
-			netmsg->encode32(size / 4);
-			netmsg->encode(nslp_data, nslp_data_size);
-			
-			ntlp::nslpdata* data = new ntlp::nslpdata(nslp_data, nslp_data_size);
+		// the NSLP data is copied only once, into a pooled NetMsg buffer
+		ntlp::nslpdata* data = new(nothrow) ntlp::nslpdata(nslp_data, nslp_data_size);
+		if (data) {
 			const uint32 nslpid = 1;
 
 			ntlp::APIMsg* msg = new ntlp::APIMsg();
@@ -1109,14 +1305,177 @@ ProcessingModule::SendMessage(uchar* nslp_data, uint32 nslp_data_size, sessionid
 			msg->send_to(message::qaddr_coordination);
 		}
 		else {
-			ERRLog(param.name, "state_manager::SendMessage() memory allocation failed for NetMsg");
-			delete netmsg;
+			ERRLog(param.name, "state_manager::SendMessage() memory allocation failed for NSLP data");
 		}
 	}
 
 	return nslpres;
 }
 
+/**
+ * Refresh the reservations of the due buckets of a partition of the
+ * refresh_scheduler in one pass. The refreshing RESERVEs are serialized
+ * into the same buffer and handed to GIST ordered by the SII handle of
+ * their next hop, so the refreshes for one peer leave in a row.
+ * Without workers, the sessions are unlocked after every
+ * refresh_lock_batch entries, so a large pass does not hold up the
+ * signaling; an entry is checked against its flow again before it is sent.
+ * @param partition -- partition owned by the calling thread
+ */
+void
+ProcessingModule::process_due_refreshes(uint32 partition)
+{
+	refresh_scheduler& refreshes = refresh_scheduler::instance();
+	vector<refresh_scheduler::entry_t> due;
+
+	if (!refreshes.get_due(partition, time(NULL), due))
+		return;
+
+	struct timespec cpu_start, cpu_end;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_start);
+
+	uint32 sent = 0, reduced = 0, stale = 0;
+	// (SII handle of the next hop, index into due)
+	vector< pair<uint32, uint32> > order;
+	order.reserve(due.size());
+
+	lock_sessions();
+
+	for (uint32 i = 0; i < due.size(); i++) {
+		// let the messages waiting for the sessions in between
+		if (i > 0 && i % refresh_lock_batch == 0) {
+			unlock_sessions();
+			lock_sessions();
+		}
+
+		NSLP_Session_Context *session_context = session_context_map->find_session_context(due[i].sid);
+		NSLP_Flow_Context *flow_context = NULL;
+		uint32 sii = 0;
+
+		if (session_context != NULL) {
+			session_context->lock();
+			flow_context = session_context->find_flow_context(due[i].mri);
+			if (session_context->get_sender_initiated())
+				session_context->get_successor_sii(due[i].mri, sii);
+			else
+				session_context->get_predecessor_sii(due[i].mri, sii);
+			session_context->unlock();
+		}
+
+		bool current = false;
+		if (flow_context != NULL) {
+			flow_context->lock();
+			current = flow_context->get_refresh_seq() == due[i].seq;
+			flow_context->unlock();
+		}
+
+		if (current)
+			order.push_back(make_pair(sii, i));
+		else
+			stale++;
+	}
+
+	unlock_sessions();
+
+	sort(order.begin(), order.end());
+
+	if (refresh_buffer[partition] == NULL)
+		refresh_buffer[partition] = new NetMsg(refresh_buffer_size);
+
+	lock_sessions();
+
+	for (uint32 n = 0; n < order.size(); n++) {
+		if (n > 0 && n % refresh_lock_batch == 0) {
+			unlock_sessions();
+			lock_sessions();
+		}
+
+		const refresh_scheduler::entry_t& e = due[order[n].second];
+		sessionid sid(e.sid);
+
+		// the reservation may have been torn down or rescheduled in the meantime
+		NSLP_Session_Context *session_context = session_context_map->find_session_context(sid);
+		NSLP_Flow_Context *flow_context = NULL;
+		if (session_context != NULL) {
+			session_context->lock();
+			flow_context = session_context->find_flow_context(e.mri);
+			session_context->unlock();
+		}
+		bool current = false;
+		if (flow_context != NULL) {
+			flow_context->lock();
+			current = flow_context->get_refresh_seq() == e.seq;
+			flow_context->unlock();
+		}
+		if (!current) {
+			stale++;
+			continue;
+		}
+
+		bool down;
+		reservereq* reserve = statemodule->create_refreshing_reserve(session_context, flow_context, down);
+
+		// schedule the next refresh first, sending may tear down the reservation
+		uint32 refresh_p, wait;
+		flow_context->lock();
+		flow_context->get_refresh_period(refresh_p);
+		flow_context->unlock();
+		rp(refresh_p).get_rand_wait(refresh_p, wait);
+		statemodule->schedule_refresh(sid, e.mri, flow_context, wait);
+
+#ifdef USE_AHO
+		ntlp::mri_explicitsigtarget fwd_est_mri;
+		if (statemodule->is_new_access_router_and_flow_matches(sid, e.mri, &fwd_est_mri)) {
+			ExplicitSignalingMsg *sigmsg = new ExplicitSignalingMsg();
+			sigmsg->set_pdu(reserve);
+			sigmsg->set_sig_mri(&fwd_est_mri);
+			sigmsg->set_sid(sid);
+			sigmsg->send_or_delete();
+			sent++;
+			continue;
+		}
+#endif
+
+		NetMsg* netmsg = NULL;
+		ntlp::mri_pathcoupled* mri_copy = e.mri.copy();
+		ntlp::mri_pathcoupled* sig_mri = mri_copy;
+		state_manager::error_t nslperror = statemodule->process_outgoing(*reserve, netmsg, down,
+				&sid, &sig_mri, refresh_buffer[partition]);
+
+		if (nslperror == state_manager::error_ok) {
+			// process_outgoing() adds the QSPEC again if the RSN changed
+			if (reserve->get_qspec() == NULL)
+				reduced++;
+
+			if (down != sig_mri->get_downstream())
+				sig_mri->invertDirection();
+
+			uint32 size = (netmsg == refresh_buffer[partition]) ? netmsg->get_pos() : netmsg->get_size();
+			SendMessage(netmsg->get_buffer(), size, new sessionid(sid), sig_mri);
+			sent++;
+
+			if (netmsg != refresh_buffer[partition])
+				delete netmsg;
+		}
+		else {
+			delete mri_copy;
+		}
+
+		delete reserve;
+	}
+
+	unlock_sessions();
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu_end);
+	uint64 cpu_usec = (uint64) (cpu_end.tv_sec - cpu_start.tv_sec) * 1000000
+		+ cpu_end.tv_nsec / 1000 - cpu_start.tv_nsec / 1000;
+	refreshes.count_pass(sent, reduced, stale, cpu_usec);
+
+	ILog(param.name, "Refreshed " << sent << " reservations (" << reduced << " without QSPEC, "
+		<< stale << " stale entries) in " << cpu_usec << " us");
+} // end process_due_refreshes
+
+
 /** Used to process timer after it was received from timer queue  */
 void ProcessingModule::process_timer_message(message* msg)
 {
@@ -1153,10 +1512,10 @@ void ProcessingModule::process_timer_message(message* msg)
 
 	DLog("Timerchecker", "SID in TIMER_MSG is - [" << sid->to_string() << "]");
 
-	pthread_mutex_lock(&session_mutex);
+	lock_sessions();
 	NSLP_Session_Context *session_context = session_context_map->find_session_context(*sid);
 		if (session_context == NULL) {
-		pthread_mutex_unlock(&session_mutex);
+		unlock_sessions();
 		return;
 	}
 
@@ -1193,7 +1552,7 @@ void ProcessingModule::process_timer_message(message* msg)
 
 				msg = NULL;
 				tmsg = NULL;
-				pthread_mutex_unlock(&session_mutex);
+				unlock_sessions();
 				return;
 			}
 
@@ -1387,6 +1746,20 @@ void ProcessingModule::process_timer_message(message* msg)
 			// deleting NSLP_Session_Context for SID
 			ILog(param.name, "Timeout - deleting NSLP_Session_Context with SID [" << sid->to_string() << "]");
 
+			// release the flows left, e.g. of a bound session expired on mobility
+			session_context->lock();
+			NSLP_Session_Context::flowcontext_const_it_t it = session_context->flowcontext.begin();
+			while (it != session_context->flowcontext.end()) {
+				const ntlp::mri_pathcoupled flow = it->first;
+				NSLP_Flow_Context *flow_context = it->second;
+
+				// delete_flow_context() removes the current pair
+				++it;
+
+				statemodule.delete_flow_context(sid, &flow, session_context, flow_context);
+			}
+			session_context->unlock();
+
 			session_context_map->erase(*sid);
 			delete session_context;
 		}
@@ -1398,7 +1771,7 @@ void ProcessingModule::process_timer_message(message* msg)
 	// delete tmsg;
 	tmsg = NULL;
 
-	pthread_mutex_unlock(&session_mutex);
+	unlock_sessions();
 }
 
 }  //end namespace qos_nslp
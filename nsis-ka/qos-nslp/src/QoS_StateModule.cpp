@@ -43,6 +43,7 @@
 #include "qos_nslp_aho_contextmap.h"
 #include "nslp_session_context_map.h"
 #include "context_manager.h"
+#include "refresh_scheduler.h"
 
 #include "benchmark_journal.h"
 
@@ -363,11 +364,13 @@ void state_manager::process_tp_recv_est_msg(NetMsg& netmsg, const ntlp::sessioni
 * @return internal NSLP_error_t errorcode, usually error_ok for success.
 * @param rcvd_sid the session id the current message belongs to.
 * @param rcvd_mri the MRI of the current session.
+* @param buffer if given and large enough, the PDU is serialized into it instead of a new
+* NetMsg; netbuffer then points to buffer and must not be deleted.
 *
 * @note this method is called by the ProcessingModule
 */
 state_manager::error_t state_manager::process_outgoing(known_nslp_pdu& pdu, NetMsg*& netbuffer, bool down, 
-		const ntlp::sessionid* rcvd_sid, ntlp::mri_pathcoupled** rcvd_mri)
+		const ntlp::sessionid* rcvd_sid, ntlp::mri_pathcoupled** rcvd_mri, NetMsg* buffer)
 {
 	error_t nslpres = error_ok;
 	error_t ret_nslpres = error_ok;
@@ -604,7 +607,7 @@ state_manager::error_t state_manager::process_outgoing(known_nslp_pdu& pdu, NetM
 	
 
 	// now serialize
-	nslpres = generate_pdu(pdu,netbuffer);
+	nslpres = generate_pdu(pdu,netbuffer,buffer);
 	if (nslpres != error_ok) {
 		if (netbuffer) {
 			delete netbuffer;
@@ -2009,10 +2012,11 @@ state_manager::create_flow_context(reservereq *reservemessage, const ntlp::sessi
 
 	qspec_object *qspec_obj=NULL;
 	error_t ret;
+	const uint16 oif = rmf::get_outgoing_interface(*rcvd_pc_mri);
 
 	qspec_object* rcvd_qspec = reservemessage->get_qspec();
 	if (rcvd_qspec) {
-		ret = process_qspec(reservemessage, qspec_obj);
+		ret = process_qspec(reservemessage, qspec_obj, oif);
 		assert((ret == error_ok) || (ret == error_no_bandwidth));
 
 		if (ret == error_no_bandwidth) {
@@ -2115,6 +2119,9 @@ state_manager::create_flow_context(reservereq *reservemessage, const ntlp::sessi
 			nslpres = error_ok;
 		}
 		else if (ret == error_nothing_to_do) {
+			// no flow context is created, so nobody would release the resources
+			rmf_admin.rollback_resources(qspec_obj->get_qspec_data(), oif);
+			delete qspec_obj;
 			return_on_error= true;
 			return error_nothing_to_do;
 		}
@@ -2148,6 +2155,7 @@ state_manager::create_flow_context(reservereq *reservemessage, const ntlp::sessi
 	// Create new NSLP_Flow_Context
 	//================================================================================================================
 	flow_context = new NSLP_Flow_Context(*rcvd_pc_mri, *qspec_obj);
+	flow_context->set_outgoing_interface(oif);
 
 
 	//================================================================================================================
@@ -2276,7 +2284,6 @@ state_manager::create_flow_context(reservereq *reservemessage, const ntlp::sessi
 	//================================================================================================================
 	// Process REFRESH_PERIOD
 	//================================================================================================================
-	rp *refr_period = NULL;
 	uint32 refresh_period, new_refr_p, new_lifetime;
 
 	rp *r_p = reservemessage->get_rp();
@@ -2287,9 +2294,9 @@ state_manager::create_flow_context(reservereq *reservemessage, const ntlp::sessi
 		refresh_period = qosnslpconf.getpar<uint32>(qosnslpconf_refresh_period);
 	}
 
-	refr_period = new rp(refresh_period);
-	refr_period->get_rand_wait(refresh_period, new_refr_p);
-	refr_period->get_rand_lifetime(refresh_period, new_lifetime);
+	rp refr_period(refresh_period);
+	refr_period.get_rand_wait(refresh_period, new_refr_p);
+	refr_period.get_rand_lifetime(refresh_period, new_lifetime);
 
 	flow_context->lock();
 	flow_context->set_refresh_period(refresh_period);
@@ -2338,35 +2345,12 @@ state_manager::create_flow_context(reservereq *reservemessage, const ntlp::sessi
 
 
 	//================================================================================================================
-	// Start refresh timer
+	// Schedule refresh
 	//================================================================================================================
-#ifndef NSIS_OMNETPP_SIM
-	timer_t t_refresh = time(NULL) + new_refr_p;
-#else
-    timer_t t_refresh = (int32)(simTime().dbl()+1) + new_refr_p;
-#endif
-		
 	if (!is_anticipated_reservation) {
-		// if the node is QNI or QNE and the SCOPING flag is not set, start refresh timer for RESERVE message
+		// if the node is QNI or QNE and the SCOPING flag is not set, schedule refreshing RESERVE message
 		if ((qn_type == NSLP_Session_Context::QNI) || ((qn_type == NSLP_Session_Context::QNE) && (!(reservemessage->is_scoping_flag())))) {
-			TimerMsg *tmsg = new TimerMsg(message::qaddr_qos_nslp_timerprocessing);
-				
-			reservereq *timer_reserve = new reservereq();
-			copy_reserve_message(reservemessage, timer_reserve);
-				
-			timer_reserve->set_rii(NULL);
-			timer_reserve->set_rp(refr_period);
-			timer_reserve->set_bool_rii(false);
-			timer_reserve->set_bool_rp(true);
-				
-			// start timer with three parameters: (SID, MRI, PDU)
-			const int32 msec = 0;
-			tmsg->start_absolute(t_refresh, msec, rcvd_sid->copy(), rcvd_pc_mri->copy(), timer_reserve);
-			if (tmsg->send_to(message::qaddr_timer)) {
-				DLog(state_manager::modname, "Starting refresh timer with ID " << tmsg->get_id() <<  " for flow ("
-				     << rcvd_pc_mri->get_sourceaddress() << ", " << rcvd_pc_mri->get_destaddress()
-				     << "). Refresh time set to " << t_refresh << " s");
-			}
+			schedule_refresh(*rcvd_sid, *rcvd_pc_mri, flow_context, new_refr_p);
 		}
 	}
 
@@ -2574,7 +2558,12 @@ state_manager::update_existing_flow_context(reservereq *reservemessage, const nt
 			forward = true;
 				
 			const qspec_pdu *q_pdu = rcvd_qspec->get_qspec_data();
-			if ( rmf_admin.reserve_resources(q_pdu) == false ) {
+			flow_context->lock();
+			const uint16 oif = flow_context->get_outgoing_interface();
+			qspec_object old_qspec = flow_context->get_qspec();
+			flow_context->unlock();
+
+			if ( rmf_admin.reserve_resources(q_pdu, oif) == false ) {
 				// resource reservation failed
 
 				ILog(state_manager::modname, "update_existing_flow_context() - Changing the Reservation for flow ("
@@ -2613,6 +2602,10 @@ state_manager::update_existing_flow_context(reservereq *reservemessage, const nt
 				flow_context->lock();
 				flow_context->set_qspec(*rcvd_qspec);
 				flow_context->unlock();
+
+				// the new QSPEC replaces the one admitted before
+				if (old_qspec.get_qspec_data())
+					rmf_admin.rollback_resources(old_qspec.get_qspec_data(), oif);
 			}
 			
 			if (reservemessage->get_sessionauth())
@@ -2826,7 +2819,6 @@ state_manager::update_existing_flow_context(reservereq *reservemessage, const nt
 	//================================================================================================================
 	// Process REFRESH_PERIOD
 	//================================================================================================================
-	rp *refr_period = NULL;
 	uint32 refresh_period, new_refr_p, new_lifetime;
 
 	rp *r_p = reservemessage->get_rp();
@@ -2837,9 +2829,9 @@ state_manager::update_existing_flow_context(reservereq *reservemessage, const nt
 		refresh_period = qosnslpconf.getpar<uint32>(qosnslpconf_refresh_period);
 	}
 
-	refr_period = new rp(refresh_period);
-	refr_period->get_rand_wait(refresh_period, new_refr_p);
-	refr_period->get_rand_lifetime(refresh_period, new_lifetime);
+	rp refr_period(refresh_period);
+	refr_period.get_rand_wait(refresh_period, new_refr_p);
+	refr_period.get_rand_lifetime(refresh_period, new_lifetime);
 
 	flow_context->lock();
 	flow_context->set_refresh_period(refresh_period);
@@ -2867,14 +2859,8 @@ state_manager::update_existing_flow_context(reservereq *reservemessage, const nt
 
 #ifdef USE_AHO
 	//================================================================================================================
-	// Start refresh timer for an anticipated reservation
+	// Schedule refresh for an anticipated reservation
 	//================================================================================================================
-#ifndef NSIS_OMNETPP_SIM
-    timer_t t_refresh = time(NULL) + new_refr_p;
-#else
-    timer_t t_refresh = (int32)(simTime().dbl()+1) + new_refr_p;
-#endif
-
 	flow_context->lock();
 	bool is_anticipated_reservation = flow_context->get_anticipated_reservation();
 	flow_context->unlock();
@@ -2887,26 +2873,9 @@ state_manager::update_existing_flow_context(reservereq *reservemessage, const nt
 		flow_context->set_anticipated_reservation(false);
 		flow_context->unlock();
 
-		// if the node is QNI or QNE and the SCOPING flag is not set, start refresh timer for RESERVE message
+		// if the node is QNI or QNE and the SCOPING flag is not set, schedule refreshing RESERVE message
 		if ((qn_type == NSLP_Session_Context::QNI) || ((qn_type == NSLP_Session_Context::QNE) && (!(reservemessage->is_scoping_flag())))) {
-			TimerMsg *tmsg = new TimerMsg(message::qaddr_qos_nslp_timerprocessing);
-				
-			reservereq *timer_reserve = new reservereq();
-			copy_reserve_message(reservemessage, timer_reserve);
-				
-			timer_reserve->set_rii(NULL);
-			timer_reserve->set_rp(refr_period);
-			timer_reserve->set_bool_rii(false);
-			timer_reserve->set_bool_rp(true);
-				
-			// start timer with three parameters: (SID, MRI, PDU)
-			const int32 msec = 0;
-			tmsg->start_absolute(t_refresh, msec, rcvd_sid->copy(), rcvd_pc_mri->copy(), timer_reserve);
-			if (tmsg->send_to(message::qaddr_timer)) {
-				DLog(state_manager::modname, "Starting refresh timer with ID " << tmsg->get_id() <<  " for flow ("
-				     << rcvd_pc_mri->get_sourceaddress() << ", " << rcvd_pc_mri->get_destaddress()
-				     << "). Refresh time set to " << t_refresh << " s");
-			}
+			schedule_refresh(*rcvd_sid, *rcvd_pc_mri, flow_context, new_refr_p);
 		}
 	}
 
@@ -2945,59 +2914,16 @@ state_manager::update_existing_flow_context(reservereq *reservemessage, const nt
 
 
 
-/** This function sends a refreshing RESERVE message.
+/** This function sends a refreshing RESERVE message and schedules the next one.
  * @param context RESERVE message will be constructed from this NSLP_Session_Context.
  */
 void state_manager::send_refreshing_reserve(const ntlp::sessionid &sid, const ntlp::mri_pathcoupled &mri,
 		NSLP_Session_Context *session_context, NSLP_Flow_Context *flow_context)
 {
 	ILog(state_manager::modname, "send_refreshing_reserve()");
-	
-
-	reservereq *res = new reservereq();
 
-	// RSN
-	session_context->lock();
-	res->set_rsn(session_context->get_own_rsn().copy());
-	session_context->unlock();	
-
-	// originator flag
-	session_context->lock();
-	NSLP_Session_Context::qn_type_t qn_type = session_context->get_qn_type();
-	session_context->unlock();
-	if (qn_type == NSLP_Session_Context::QNI) {
-	        res->set_originator(true);
-	}
-	
-
-	// QSPEC
-	flow_context->lock();
-//	if ((!flow_context->get_reduced_refresh())) {
-	        qspec_object *qspec_obj = flow_context->get_qspec().copy();
-	        res->set_qspec(qspec_obj);
-//	}
-	flow_context->unlock();
-
-
-	// BOUND_SID
-	uint128 saved_b_sid;
-	session_context->lock();
-	bool found = session_context->get_bound_sid(saved_b_sid);
-	session_context->unlock();
-	if (found) {
-	        bound_sessionid *send_bs = new bound_sessionid();
-	        send_bs->set(saved_b_sid);
-	        res->set_bound_sid(send_bs);
-	}
-	
-
-	known_nslp_pdu *pdu = dynamic_cast<known_nslp_pdu*>(res);
-
-
-	// D-Bit
-	session_context->lock();
-	bool down = session_context->get_sender_initiated();
-	session_context->unlock();
+	bool down;
+	known_nslp_pdu *pdu = create_refreshing_reserve(session_context, flow_context, down);
 
 
 #ifdef USE_AHO
@@ -3030,23 +2956,92 @@ void state_manager::send_refreshing_reserve(const ntlp::sessionid &sid, const nt
 #endif
 	
 
-	// start timer for next refreshing RESERVE
+	// schedule next refreshing RESERVE
 	uint32 refresh_p, new_refr_p;
 	flow_context->lock();
 	flow_context->get_refresh_period(refresh_p);
 	flow_context->unlock();
 
-	rp *refr_period = new rp(refresh_p);
-	refr_period->get_rand_wait(refresh_p, new_refr_p);
+	rp refr_period(refresh_p);
+	refr_period.get_rand_wait(refresh_p, new_refr_p);
+	schedule_refresh(sid, mri, flow_context, new_refr_p);
+
+	ILog(state_manager::modname, "END send_refreshing_reserve()");
+}
+
+
+/** This function builds a refreshing RESERVE message from the saved state of a flow.
+ * The QSPEC is left out if reduced refreshes are configured and the reservation
+ * was confirmed; process_outgoing() adds it again if the RSN changed meanwhile.
+ * @param down set to the direction the RESERVE message has to be sent to.
+ * @return the RESERVE message, to be deleted by the caller.
+ */
+reservereq* state_manager::create_refreshing_reserve(NSLP_Session_Context *session_context, NSLP_Flow_Context *flow_context, bool &down)
+{
+	reservereq *res = new reservereq();
+
+	session_context->lock();
+	// RSN
+	res->set_rsn(session_context->get_own_rsn().copy());
+
+	// originator flag
+	if (session_context->get_qn_type() == NSLP_Session_Context::QNI) {
+	        res->set_originator(true);
+	}
+
+	// BOUND_SID
+	uint128 saved_b_sid;
+	if (session_context->get_bound_sid(saved_b_sid)) {
+	        bound_sessionid *send_bs = new bound_sessionid();
+	        send_bs->set(saved_b_sid);
+	        res->set_bound_sid(send_bs);
+	}
+
+	// D-Bit
+	down = session_context->get_sender_initiated();
+	session_context->unlock();
+
+
+	// QSPEC
+	flow_context->lock();
+	if (!(flow_context->get_reduced_refresh() && qosnslpconf.getpar<bool>(qosnslpconf_reduced_refreshes))) {
+	        qspec_object *qspec_obj = flow_context->get_qspec().copy();
+	        res->set_qspec(qspec_obj);
+	}
+	flow_context->unlock();
+
+	return res;
+}
+
+
+/** This function schedules the next refreshing RESERVE message of a flow.
+ * Refreshes scheduled before for the flow are superseded.
+ * @param wait seconds from now on, already randomized with rp::get_rand_wait().
+ */
+void state_manager::schedule_refresh(const ntlp::sessionid &sid, const ntlp::mri_pathcoupled &mri, NSLP_Flow_Context *flow_context, uint32 wait)
+{
 #ifndef NSIS_OMNETPP_SIM
-    timer_t t_refresh = time(NULL) + new_refr_p;
+	time_t t_refresh = time(NULL) + wait;
+
+	flow_context->lock();
+	uint32 seq = flow_context->next_refresh_seq();
+	flow_context->unlock();
+
+	refresh_scheduler::instance().schedule(sid, mri, t_refresh, seq);
+
+	DLog(state_manager::modname, "Scheduled refresh for flow (" << mri.get_sourceaddress() << ", "
+	     << mri.get_destaddress() << ") at " << t_refresh << " s");
 #else
-    timer_t t_refresh = (int32)(simTime().dbl()+1) + new_refr_p;
-#endif
+	// the simulation has no processing threads to poll the refresh_scheduler
+	timer_t t_refresh = (int32)(simTime().dbl()+1) + wait;
+
+	uint32 refresh_p;
+	flow_context->lock();
+	flow_context->get_refresh_period(refresh_p);
+	flow_context->unlock();
 
 	reservereq* timer_reserve = new reservereq();
-	copy_reserve_message(res, timer_reserve);
-	timer_reserve->set_rp(refr_period);
+	timer_reserve->set_rp(new rp(refresh_p));
 	timer_reserve->set_bool_rii(false);
 	timer_reserve->set_bool_rp(true);
 
@@ -3056,8 +3051,7 @@ void state_manager::send_refreshing_reserve(const ntlp::sessionid &sid, const nt
 	if (tmsg_refresh->send_to(message::qaddr_timer)) {
 		ILog(state_manager::modname, "Timer for refreshing RESERVE msg with ID " << tmsg_refresh->get_id() << " set to " << t_refresh << " s");
 	}
-
-	ILog(state_manager::modname, "END send_refreshing_reserve()");
+#endif
 }
 
 
@@ -3382,7 +3376,7 @@ void state_manager::create_and_send_reserve_msg_as_response_to_query(bool send_r
 	uint32 n;
 
 	if (qspec) {
-		bool success_reserve = rmf_admin.reserve_resources(qspec->get_qspec_data());
+		bool success_reserve = rmf_admin.reserve_resources(qspec->get_qspec_data(), rmf::get_outgoing_interface(*rcvd_mri));
 		
 		if (!success_reserve) {
 			return;
@@ -3920,9 +3914,10 @@ state_manager::copy_notify_message(const notifymsg* source, notifymsg* dest)
 /** This function processes the QSPEC object from a received message or for the message to be sent.
  * @param reservemsg received RESERVE message.
  * @param qspec_obj points to a copy of the QSPEC object contained in the reserve message.
+ * @param oif outgoing interface of the flow the resources are reserved on.
  * @return error_ok | error_no_bandwidth
  */
-state_manager::error_t  state_manager::process_qspec(reservereq* reservemsg, qspec_object *&qspec_obj)
+state_manager::error_t  state_manager::process_qspec(reservereq* reservemsg, qspec_object *&qspec_obj, uint16 oif)
 {
 	error_t nslpres = error_ok;
 	qspec_object* rcvd_qspec = reservemsg->get_qspec();
@@ -3930,7 +3925,7 @@ state_manager::error_t  state_manager::process_qspec(reservereq* reservemsg, qsp
 
 	qspec_obj = rcvd_qspec->copy();
 
-	if (!(rmf_admin.reserve_resources(rcvd_qspec->get_qspec_data()))) {
+	if (!(rmf_admin.reserve_resources(rcvd_qspec->get_qspec_data(), oif))) {
 		nslpres = error_no_bandwidth;
 
 		Log(ERROR_LOG, LOG_NORMAL, state_manager::modname, "not enough bandwidth!");
@@ -3951,13 +3946,14 @@ void state_manager::delete_flow_context(const ntlp::sessionid *sid, const ntlp::
 {
 	flow_context->lock();
 	qspec_object qspec_obj = flow_context->get_qspec();
+	const uint16 oif = flow_context->get_outgoing_interface();
 	flow_context->unlock();
 
 	// release resources
 	const qspec_pdu *q_pdu = qspec_obj.get_qspec_data();
 	if (q_pdu) {
 		MP(benchmark_journal::PRE_VLSP_SETDOWN_SCRIPT_SOURCE);
-		rmf_admin.release_resources(q_pdu);
+		rmf_admin.release_resources(q_pdu, oif);
 		MP(benchmark_journal::POST_VLSP_SETDOWN_SCRIPT_SOURCE);
 	}
 
@@ -5594,26 +5590,20 @@ state_manager::send_mobility_refresh(NSLP_Session_Context *session_context, NSLP
 			session_context->unset_bound_sid();
 			session_context->unlock();
 
-			// Tear down bound session
+			// Tear down bound session. Its state may be owned by another
+			// worker, so it is only expired here and torn down by its owner
+			// when the lifetime timer started below elapses.
 			ntlp::sessionid sid(my_sid);
 			NSLP_Session_Context *bound_session_context = session_context_map->find_session_context(sid);
 			if (bound_session_context != NULL) {
 				bound_session_context->lock();
-				NSLP_Session_Context::flowcontext_const_it_t it;
-				it = bound_session_context->flowcontext.begin();
-				while (it != bound_session_context->flowcontext.end()) {
-					const ntlp::mri_pathcoupled flow = it->first;
-					NSLP_Flow_Context *flow_context = it->second;
-				
-					// Since the following code deletes the current (key, value) pair,
-					// we jump to the next pair in advance.
-					++it;
-				
-					delete_flow_context(&sid, &flow, bound_session_context, flow_context);
-				}
+				bound_session_context->set_time_to_live(0);
 				bound_session_context->unlock();
 
-				session_context_map->erase(sid);
+				// start timer with one parameter (SID)
+				TimerMsg* tmsg = new TimerMsg(message::qaddr_qos_nslp_timerprocessing);
+				tmsg->start_absolute(time(NULL), 0, sid.copy());
+				tmsg->send_to(message::qaddr_timer);
 			}
 		} else {
 			session_context->unlock();
@@ -5896,10 +5886,12 @@ void state_manager::create_query_message_from_context(NSLP_Context *context, que
  * generates actual network pdu from first parameter
  * @param pdu from this NSLP PDU a network message will be generated.
  * @return error code or error_ok on successful encoding
- * @return netmsg pointer to netmsg buffer (which is allocated by this method)
+ * @param buffer NetMsg to serialize into if the PDU fits, NULL to allocate one
+ * @return netmsg pointer to netmsg buffer (which is allocated by this method,
+ * or buffer if the PDU was serialized into it; its size is then the position)
  */
 state_manager::error_t
-state_manager::generate_pdu(const known_nslp_pdu& pdu, NetMsg*& netmsg)
+state_manager::generate_pdu(const known_nslp_pdu& pdu, NetMsg*& netmsg, NetMsg* buffer)
 {
 	error_t nslpres = error_ok;
 	try {
@@ -5912,6 +5904,18 @@ state_manager::generate_pdu(const known_nslp_pdu& pdu, NetMsg*& netmsg)
 			<< " PDU too big for NetMsg maxsize " << NetMsg::max_size);
 			nslpres = error_pdu_too_big;
 		}
+		else if (buffer && buffer->get_size() >= pdusize) {
+			// reuse the buffer of the caller, the PDU ends at its position
+			netmsg = buffer;
+			netmsg->to_start();
+
+			uint32 nbytes;
+			pdu.serialize(*netmsg, coding, nbytes);
+			if (nbytes!=pdusize || netmsg->get_pos()!=pdusize) {
+				ERRCLog(state_manager::modname, "state_manager::generate_pdu() unspecified serialization error");
+				nslpres = error_serialize;
+			} // end if serialization error
+		}
 		else {
 			// allocate a netmsg with the corresponding buffer size
 			// TODO: make sure netmsg is deleted if no error occured
@@ -5946,7 +5950,8 @@ state_manager::generate_pdu(const known_nslp_pdu& pdu, NetMsg*& netmsg)
 
 	// delete and cleanup netmsg if error occured
 	if ((nslpres != error_ok) && netmsg) {
-		delete netmsg;
+		if (netmsg != buffer)
+			delete netmsg;
 		netmsg = NULL;
 	} // end if delete netmsg
 
@@ -0,0 +1,255 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file admission_ledger.cpp
+/// QoS NSLP admission control ledger
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2010, all rights reserved by
+// - Institute of Telematics, Karlsruhe Institute of Technology
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA.
+//
+// ===========================================================
+
+#include <sched.h>
+
+#include "admission_ledger.h"
+#include "logfile.h"
+
+using namespace protlib::log;
+
+namespace qos_nslp {
+
+/** @addtogroup iermf Resource Management Function
+ * @{
+ */
+
+/***** class admission_ledger *****/
+
+/** Constructor.
+  * @param max_interfaces number of interfaces the ledger can hold.
+  */
+admission_ledger::admission_ledger(uint32 max_interfaces)
+	: size(max_interfaces > 0 ? max_interfaces : 1),
+	  entries(new interface_entry[size])
+{
+	for (uint32 i = 0; i < size; i++) {
+		entries[i].key = 0;
+		entries[i].ready = 0;
+		for (int c = 0; c < tc_max; c++) {
+			entries[i].capacity[c] = 0;
+			entries[i].reserved[c] = 0;
+		}
+	}
+	for (int c = 0; c < tc_max; c++)
+		default_capacity[c] = 0;
+}
+
+
+admission_ledger::~admission_ledger()
+{
+	delete[] entries;
+}
+
+
+/** This function sets the capacity of a class for interfaces used from now on.
+  * @param tclass the traffic class.
+  * @param bandwidth capacity in bit/s.
+  */
+void
+admission_ledger::set_default_capacity(traffic_class_t tclass, uint64 bandwidth)
+{
+	if (tclass < tc_max)
+		__atomic_store_n(&default_capacity[tclass], bandwidth, __ATOMIC_RELAXED);
+}
+
+
+/** This function sets the capacity of a class on one interface. Reservations
+  * already admitted are kept, even if they exceed the new capacity.
+  * @return false if the interface could not be added to the ledger.
+  */
+bool
+admission_ledger::set_capacity(uint16 interface, traffic_class_t tclass, uint64 bandwidth)
+{
+	interface_entry* e = find_or_add(interface);
+
+	if (e == NULL || tclass >= tc_max)
+		return false;
+
+	__atomic_store_n(&e->capacity[tclass], bandwidth, __ATOMIC_RELAXED);
+	return true;
+}
+
+
+/** This function admits bandwidth for a class on an interface, if the
+  * reservations of the class stay within its capacity.
+  * @return true if the bandwidth was admitted.
+  */
+bool
+admission_ledger::reserve(uint16 interface, traffic_class_t tclass, uint64 bandwidth)
+{
+	interface_entry* e = find_or_add(interface);
+
+	if (e == NULL || tclass >= tc_max)
+		return false;
+
+	uint64 reserved = __atomic_load_n(&e->reserved[tclass], __ATOMIC_RELAXED);
+	do {
+		uint64 capacity = __atomic_load_n(&e->capacity[tclass], __ATOMIC_RELAXED);
+		if (reserved > capacity || bandwidth > capacity - reserved)
+			return false;
+	} while (!__atomic_compare_exchange_n(&e->reserved[tclass], &reserved,
+			reserved + bandwidth, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+
+	return true;
+}
+
+
+/** This function releases bandwidth previously admitted by reserve().
+  */
+void
+admission_ledger::release(uint16 interface, traffic_class_t tclass, uint64 bandwidth)
+{
+	interface_entry* e = find(interface);
+
+	if (e == NULL || tclass >= tc_max) {
+		ERRLog("QoS RMF", "releasing " << bandwidth << " bit/s on interface "
+		       << interface << " that were never reserved");
+		return;
+	}
+
+	uint64 reserved = __atomic_load_n(&e->reserved[tclass], __ATOMIC_RELAXED);
+	uint64 remaining;
+	do {
+		if (bandwidth > reserved) {
+			ERRLog("QoS RMF", "releasing " << bandwidth << " bit/s on interface "
+			       << interface << ", but only " << reserved << " bit/s are reserved");
+			remaining = 0;
+		}
+		else
+			remaining = reserved - bandwidth;
+	} while (!__atomic_compare_exchange_n(&e->reserved[tclass], &reserved,
+			remaining, true, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED));
+}
+
+
+/** This function gets capacity and reserved bandwidth of a class on an interface.
+  * @return false if nothing was reserved on the interface yet.
+  */
+bool
+admission_ledger::get_utilization(uint16 interface, traffic_class_t tclass,
+				  uint64& capacity, uint64& reserved) const
+{
+	interface_entry* e = find(interface);
+
+	if (e == NULL || tclass >= tc_max)
+		return false;
+
+	capacity = __atomic_load_n(&e->capacity[tclass], __ATOMIC_RELAXED);
+	reserved = __atomic_load_n(&e->reserved[tclass], __ATOMIC_RELAXED);
+	return true;
+}
+
+
+/** This function gets capacity and reserved bandwidth of all classes on all
+  * interfaces known to the ledger.
+  */
+void
+admission_ledger::get_utilization(std::vector<utilization_t>& result) const
+{
+	result.clear();
+
+	for (uint32 i = 0; i < size; i++) {
+		interface_entry& e = entries[i];
+
+		if (__atomic_load_n(&e.ready, __ATOMIC_ACQUIRE) == 0)
+			continue;
+
+		for (int c = 0; c < tc_max; c++) {
+			utilization_t u;
+			u.interface = e.key - 1;
+			u.tclass = static_cast<traffic_class_t>(c);
+			u.capacity = __atomic_load_n(&e.capacity[c], __ATOMIC_RELAXED);
+			u.reserved = __atomic_load_n(&e.reserved[c], __ATOMIC_RELAXED);
+			result.push_back(u);
+		}
+	}
+}
+
+
+/** Entry of an interface, NULL if the interface is unknown.
+  */
+admission_ledger::interface_entry*
+admission_ledger::find(uint16 interface) const
+{
+	const uint32 key = interface + 1;
+
+	for (uint32 n = 0, i = interface % size; n < size; n++, i = (i + 1) % size) {
+		interface_entry* e = &entries[i];
+		uint32 k = __atomic_load_n(&e->key, __ATOMIC_ACQUIRE);
+
+		if (k == 0)
+			return NULL;
+		if (k == key) {
+			// the entry is being added by another thread right now
+			while (__atomic_load_n(&e->ready, __ATOMIC_ACQUIRE) == 0)
+				sched_yield();
+			return e;
+		}
+	}
+
+	return NULL;
+}
+
+
+/** Entry of an interface, added with the default capacities if the
+  * interface is unknown. NULL if the ledger is full.
+  */
+admission_ledger::interface_entry*
+admission_ledger::find_or_add(uint16 interface)
+{
+	const uint32 key = interface + 1;
+
+	for (uint32 n = 0, i = interface % size; n < size; n++, i = (i + 1) % size) {
+		interface_entry* e = &entries[i];
+		uint32 k = __atomic_load_n(&e->key, __ATOMIC_ACQUIRE);
+
+		if (k == 0 && __atomic_compare_exchange_n(&e->key, &k, key,
+				false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+			for (int c = 0; c < tc_max; c++)
+				e->capacity[c] = __atomic_load_n(&default_capacity[c], __ATOMIC_RELAXED);
+			__atomic_store_n(&e->ready, 1, __ATOMIC_RELEASE);
+			return e;
+		}
+		if (k == key) {
+			while (__atomic_load_n(&e->ready, __ATOMIC_ACQUIRE) == 0)
+				sched_yield();
+			return e;
+		}
+	}
+
+	ERRLog("QoS RMF", "no room for interface " << interface
+	       << " in the admission ledger, all " << size << " entries are used");
+	return NULL;
+}
+
+//@}
+
+} // end namespace qos_nslp
@@ -0,0 +1,206 @@
+/*
+ * contextbench.cpp - Measure the session context map under concurrent access.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ * T threads work on S sessions of their own in NSLP_Session_Context_Map,
+ * one phase after the other: each thread inserts its sessions together with
+ * a logical MRI, looks every session up by its ID and by its MRI (the way a
+ * RESPONSE and a mobility event find their session), and erases them again.
+ * Reports the operations per second of each phase:
+ *
+ *   ./contextbench [sessions] [threads] [shards]
+ *
+ * The sessions share a pool of contexts, only the map is measured.
+ */
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "logfile.h"
+#include "protlibconf.h"
+#include "gist_conf.h"
+
+#include "qos_nslp_conf.h"
+#include "nslp_session_context_map.h"
+
+using namespace protlib;
+using namespace protlib::log;
+using namespace ntlp;
+using namespace qos_nslp;
+
+namespace protlib {
+	protlibconf plibconf;
+}
+
+namespace ntlp {
+	gistconf gconf;
+}
+
+namespace qos_nslp {
+	qos_nslp_conf qosnslpconf;
+}
+
+logfile commonlog("", false, true);
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+// first word of the session ids, the last word is the session number
+static const uint32 sid_tag = 0x43545842;
+static const unsigned int pool_size = 1024;
+
+static unsigned long sessions = 1000000;
+static unsigned int threads = 8;
+static unsigned int shards = NSLP_Session_Context_Map::default_shards;
+
+static NSLP_Session_Context_Map *contexts;
+static std::vector<NSLP_Session_Context *> pool;
+
+enum phase_t { ph_insert, ph_lookup, ph_erase };
+
+struct worker_arg {
+	pthread_t tid;
+	unsigned int nr;
+	phase_t phase;
+	unsigned long misses;
+};
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+static sessionid make_sid(unsigned long i) {
+	return sessionid(sid_tag, 0, i >> 16, i + 1);
+}
+
+
+// the logical MRI of session i, sessions share an MRI in pairs
+static mri_pathcoupled make_mri(unsigned long i) {
+	struct in_addr src, dst;
+	src.s_addr = htonl(0x0a000000 | (i / 2 & 0xffffff));
+	dst.s_addr = htonl(0xac100001);
+
+	return mri_pathcoupled(hostaddress(src), 32, hostaddress(dst), 32, true);
+}
+
+
+static void *work(void *p) {
+	worker_arg *arg = static_cast<worker_arg *>(p);
+	unsigned long first = sessions * arg->nr / threads;
+	unsigned long last = sessions * (arg->nr + 1) / threads;
+	NSLP_Session_Context_Map::search_context sc;
+
+	for (unsigned long i = first; i < last; i++) {
+		sessionid sid = make_sid(i);
+
+		switch ( arg->phase ) {
+			case ph_insert:
+				if ( !contexts->insert_session_context(sid, pool[i % pool_size]) )
+					arg->misses++;
+				contexts->insert_mri2context_map(sid, make_mri(i));
+				break;
+
+			case ph_lookup:
+				if ( contexts->find_session_context(sid) != pool[i % pool_size] )
+					arg->misses++;
+				if ( contexts->find_first(make_mri(i), sc) == NULL )
+					arg->misses++;
+				break;
+
+			case ph_erase:
+				contexts->erase(sid);
+				break;
+		}
+	}
+
+	return NULL;
+}
+
+
+static void run(phase_t phase, const char *name, unsigned int ops) {
+	std::vector<worker_arg> args(threads);
+	unsigned long misses = 0;
+
+	double start = now();
+	for (unsigned int i = 0; i < threads; i++) {
+		args[i].nr = i;
+		args[i].phase = phase;
+		args[i].misses = 0;
+		pthread_create(&args[i].tid, NULL, work, &args[i]);
+	}
+	for (unsigned int i = 0; i < threads; i++) {
+		pthread_join(args[i].tid, NULL);
+		misses += args[i].misses;
+	}
+	double secs = now() - start;
+
+	std::cout << "  " << std::setw(7) << std::left << name << std::right
+		<< std::setw(9) << secs * 1000 << " ms, "
+		<< std::setw(9) << sessions * ops / secs / 1000 << " k ops/s";
+	if ( misses )
+		std::cout << ", " << misses << " misses";
+	std::cout << std::endl;
+}
+
+
+int main(int argc, char *argv[]) {
+	if ( argc > 1 )
+		sessions = strtoul(argv[1], NULL, 10);
+	if ( argc > 2 )
+		threads = strtoul(argv[2], NULL, 10);
+	if ( argc > 3 )
+		shards = strtoul(argv[3], NULL, 10);
+
+	if ( sessions == 0 || threads == 0 || shards == 0 ) {
+		std::cerr << "usage: " << argv[0]
+			<< " [sessions] [threads] [shards]" << std::endl;
+		return 1;
+	}
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	for (unsigned int i = 0; i < pool_size; i++)
+		pool.push_back(new NSLP_Session_Context(make_sid(i), NSLP_Session_Context::QNE, true));
+
+	contexts = new NSLP_Session_Context_Map(shards);
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << sessions << " sessions, " << threads << " threads, "
+		<< shards << " shards" << std::endl;
+
+	// insert: context and logical MRI, lookup: by session ID and by MRI
+	run(ph_insert, "insert", 2);
+	run(ph_lookup, "lookup", 2);
+	run(ph_erase, "erase", 1);
+
+	// nothing is left behind by erase
+	NSLP_Session_Context_Map::search_context sc;
+	unsigned long left = 0;
+	for (unsigned long i = 0; i < sessions; i += sessions / 100 + 1)
+		if ( contexts->find_session_context(make_sid(i)) || contexts->find_first(make_mri(i), sc) )
+			left++;
+	if ( left )
+		std::cout << "  " << left << " sessions left after erase" << std::endl;
+
+	delete contexts;
+	for (unsigned int i = 0; i < pool_size; i++)
+		delete pool[i];
+
+	return left ? 1 : 0;
+}
+
+// EOF
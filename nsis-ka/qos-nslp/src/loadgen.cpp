@@ -0,0 +1,305 @@
+/*
+ * loadgen.cpp - Drive concurrent reservations through the QoS NSLP.
+ *
+ * $Id$
+ * $HeadURL$
+ *
+ * Runs the processing module on top of a loopback GIST: RESERVE messages
+ * for R sessions are put into the GIST API queue as if GIST had received
+ * them from an upstream QNE, with this node as QNR of every flow, and the
+ * RESPONSEs the QoS NSLP hands to GIST are collected from the queue of
+ * GIST. All reservations are outstanding at the same time. Reports the
+ * throughput and the time from injecting a RESERVE until its RESPONSE
+ * leaves the QoS NSLP. Compare runs with 1 (the single processing thread)
+ * and N processing workers:
+ *
+ *   ./loadgen [reservations] [workers] [refresh period]
+ *
+ * With a refresh period (in seconds), the flows end behind this node, so
+ * it is a QNE that forwards the RESERVEs (the first message to GIST is
+ * taken as response) and refreshes the reservations. After they are set
+ * up, the refreshes of two periods are counted.
+ */
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "logfile.h"
+#include "protlibconf.h"
+#include "queuemanager.h"
+#include "threadsafe_db.h"
+#include "timer_module.h"
+#include "apimessage.h"
+#include "nslpdata.h"
+#include "gist_conf.h"
+#include "flowinfo.h"
+
+#include "qos_nslp.h"
+#include "qos_nslp_conf.h"
+#include "ProcessingModule.h"
+#include "rmf.h"
+#include "refresh_scheduler.h"
+#include "reservemsg.h"
+#include "qspec.h"
+
+using namespace protlib;
+using namespace protlib::log;
+using namespace ntlp;
+using namespace qos_nslp;
+
+namespace protlib {
+	protlibconf plibconf;
+}
+
+namespace ntlp {
+	gistconf gconf;
+}
+
+namespace qos_nslp {
+	qos_nslp_conf qosnslpconf;
+}
+
+logfile commonlog("", false, true);
+logfile &protlib::log::DefaultLog(commonlog);
+
+
+// flows are sent from upstream_addr to local_addr, this node is their QNR
+static const char *local_addr = "10.0.0.1";
+static const char *upstream_addr = "10.0.0.2";
+// destination of the flows if this node is a QNE
+static const char *downstream_addr = "10.0.0.3";
+// first word of the session ids, the last word is the reservation number
+static const uint32 sid_tag = 0x4c4f4144;
+// bandwidth of a reservation, in bit/s
+static const uint32 bandwidth = 1000;
+
+static unsigned long reservations = 100000;
+static unsigned int workers = 1;
+static unsigned int refresh = 0;
+
+static std::vector<double> injected;
+static std::vector<double> latency;
+static unsigned long responses = 0;
+static unsigned long refreshes = 0;
+static bool stop = false;
+
+
+static double now() {
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+
+// the RESERVE an upstream QNE sends for a new reservation, asking for a RESPONSE
+// (which a QNE could not get, so it is not asked for if refreshes are measured)
+static nslpdata *make_reserve() {
+	qspec::qspec_pdu *q_pdu = new qspec::qspec_pdu(qspec::ms_sender_initiated_reservations, 1);
+	qspec::qspec_object *qos_desired = new qspec::qspec_object(qspec::ot_qos_desired);
+	qos_desired->set_parameter(new qspec::t_mod(bandwidth, 100000, bandwidth, 1500));
+	qos_desired->set_parameter(new qspec::admission_priority(qspec::ap_high_priority_flow));
+	q_pdu->set_object(qos_desired);
+
+	rii *r = NULL;
+	if ( refresh == 0 ) {
+		r = new rii();
+		r->generate_new();
+	}
+
+	reservereq res(new rsn(), new packet_classifier(), r, new rp(refresh ? refresh : 3600));
+	res.set_qspec(new qos_nslp::qspec_object(q_pdu));
+	delete q_pdu;
+
+	uint32 nbytes;
+	NetMsg msg(res.get_serialized_size(IE::nslp_v1));
+	res.serialize(msg, IE::nslp_v1, nbytes);
+
+	return new nslpdata(msg.get_buffer(), nbytes);
+}
+
+
+static void inject(unsigned long i, const nslpdata &reserve) {
+	hostaddress src(upstream_addr), dst(refresh ? downstream_addr : local_addr);
+	mri_pathcoupled *mr = new mri_pathcoupled(src, 32, 1024 + i % 60000, dst, 32, 5000, "udp", 0, 0, 0, true);
+	sessionid *sid = new sessionid(uint128(sid_tag, 0, i >> 16, i + 1));
+
+	APIMsg *msg = new APIMsg();
+	msg->set_source(message::qaddr_coordination);
+	msg->set_recvmessage(new nslpdata(reserve), 1, sid, mr, false, 1, tx_attr_t(), 100, 1, 100);
+
+	injected[i] = now();
+	if ( !msg->send_to(message::qaddr_api_1) ) {
+		std::cerr << "cannot inject RESERVE " << i << std::endl;
+		delete msg;
+	}
+}
+
+
+// GIST side of the loopback, collects the messages the QoS NSLP sends
+static void *loopback_gist(void *arg) {
+	FastQueue *fq = static_cast<FastQueue *>(arg);
+	const unsigned int batchsize = 64;
+	message *msgs[batchsize];
+
+	while ( !__atomic_load_n(&stop, __ATOMIC_ACQUIRE) ) {
+		unsigned int n = fq->dequeue_batch_timedwait(msgs, batchsize, 100);
+		double t = now();
+
+		for (unsigned int i = 0; i < n; i++) {
+			APIMsg *apimsg = dynamic_cast<APIMsg *>(msgs[i]);
+			if ( apimsg && apimsg->get_subtype() == APIMsg::SendMessage
+					&& apimsg->get_sessionid() ) {
+				uint128 sid = *apimsg->get_sessionid();
+				unsigned long r = sid.w4 - 1;
+
+				if ( sid.w1 == sid_tag && r < reservations
+						&& latency[r] < 0 ) {
+					latency[r] = t - injected[r];
+					__atomic_add_fetch(&responses, 1, __ATOMIC_RELEASE);
+				}
+				else if ( sid.w1 == sid_tag && r < reservations )
+					__atomic_add_fetch(&refreshes, 1, __ATOMIC_RELAXED);
+			}
+			delete msgs[i];
+		}
+	}
+
+	return NULL;
+}
+
+
+int main(int argc, char *argv[]) {
+	if ( argc > 1 )
+		reservations = strtoul(argv[1], NULL, 10);
+	if ( argc > 2 )
+		workers = strtoul(argv[2], NULL, 10);
+	if ( argc > 3 )
+		refresh = strtoul(argv[3], NULL, 10);
+
+	if ( reservations == 0 || workers == 0 ) {
+		std::cerr << "usage: " << argv[0]
+			<< " [reservations] [workers] [refresh period]" << std::endl;
+		return 1;
+	}
+
+	commonlog.set_filter(ERROR_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(WARNING_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(EVENT_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(INFO_LOG, LOG_EMERG + 1);
+	commonlog.set_filter(DEBUG_LOG, LOG_EMERG + 1);
+
+	tsdb::init(true);
+	qos_nslp::register_ies();
+	qosnslpconf.repository_init();
+	qosnslpconf.setRepository();
+	gconf.setRepository();
+	// no refreshes (unless measured) and no admission failures during the run
+	qosnslpconf.setpar<uint32>(qosnslpconf_refresh_period, refresh ? refresh : 3600);
+	rmf::EF_available_bandwidth = (long) bandwidth * reservations + 1;
+
+	// the loopback GIST receives everything sent to GIST and to applications
+	FastQueue *gist_fq = new FastQueue("loopback GIST", true);
+	QueueManager::instance()->register_queue(gist_fq, message::qaddr_coordination);
+	QueueManager::instance()->register_queue(gist_fq, message::qaddr_qos_appl_signaling);
+
+	FastQueue *timerchecker_fq = new FastQueue("timerchecker", true);
+	QueueManager::instance()->register_queue(timerchecker_fq, message::qaddr_qos_nslp_timerprocessing);
+	FastQueue *applmsgrecv_fq = new FastQueue("applmsgchecker", true);
+	QueueManager::instance()->register_queue(applmsgrecv_fq, message::qaddr_appl_qos_signaling);
+	FastQueue *apimsgrecv_fq = new FastQueue("apimsgchecker", true);
+	QueueManager::instance()->register_queue(apimsgrecv_fq, message::qaddr_api_1);
+
+	TimerModuleParam tmpar;
+	ThreadStarter<TimerModule, TimerModuleParam> timer_module(1, tmpar);
+	timer_module.start_processing();
+
+	AddressList addresses;
+	addresses.add_property(hostaddress(local_addr), AddressList::ConfiguredAddr_P);
+	Flowinfo *fi_service = NULL;
+#ifdef USE_FLOWINFO
+	FlowinfoParam fiparam;
+	ThreadStarter<Flowinfo, FlowinfoParam> fithread(1, fiparam);
+	fithread.start_processing();
+	fi_service = fithread.get_thread_object();
+#endif
+
+	ProcessingModuleParam pmpar(ThreadParam::default_sleep_time,
+			addresses, *fi_service, true, true, workers);
+	ThreadStarter<ProcessingModule, ProcessingModuleParam> processing_module(pmpar.get_thread_count(), pmpar);
+	processing_module.start_processing();
+
+	injected.resize(reservations);
+	latency.assign(reservations, -1);
+	nslpdata *reserve = make_reserve();
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << reservations << " reservations, " << workers
+		<< " workers, " << reserve->get_size()
+		<< " byte RESERVE" << std::endl;
+
+	pthread_t gist_thread;
+	pthread_create(&gist_thread, NULL, loopback_gist, gist_fq);
+
+	double start = now();
+	for (unsigned long i = 0; i < reservations; i++)
+		inject(i, *reserve);
+	double injecting = now() - start;
+	while ( __atomic_load_n(&responses, __ATOMIC_ACQUIRE) < reservations )
+		usleep(1000);
+	double secs = now() - start;
+
+	std::sort(latency.begin(), latency.end());
+	std::cout << "  injected in " << injecting * 1000 << " ms, "
+		<< "all RESPONSEs after " << secs * 1000 << " ms, "
+		<< reservations / secs / 1000 << " k reservations/s" << std::endl;
+	std::cout << "  RESERVE to RESPONSE: median "
+		<< latency[reservations / 2] * 1000 << " ms, 99% "
+		<< latency[reservations * 99 / 100] * 1000 << " ms, max "
+		<< latency[reservations - 1] * 1000 << " ms" << std::endl;
+
+	std::vector<admission_ledger::utilization_t> usage;
+	rmf::get_utilization(usage);
+	for (unsigned int i = 0; i < usage.size(); i++)
+		if ( usage[i].reserved > 0 )
+			std::cout << "  interface " << usage[i].interface << ", class "
+				<< usage[i].tclass << ": " << usage[i].reserved
+				<< " of " << usage[i].capacity << " bit/s admitted"
+				<< std::endl;
+
+	if ( refresh ) {
+		refresh_scheduler::stats_t before = refresh_scheduler::instance().get_stats();
+		unsigned long refreshes_before = __atomic_load_n(&refreshes, __ATOMIC_RELAXED);
+		double refresh_start = now();
+		sleep(2 * refresh);
+		double refresh_secs = now() - refresh_start;
+		refresh_scheduler::stats_t after = refresh_scheduler::instance().get_stats();
+		unsigned long sent = __atomic_load_n(&refreshes, __ATOMIC_RELAXED) - refreshes_before;
+
+		std::cout << "  refreshes in " << refresh_secs << " s: " << sent
+			<< " RESERVEs to GIST, " << sent / refresh_secs
+			<< " messages/s, " << after.passes - before.passes
+			<< " passes, " << after.reduced - before.reduced
+			<< " without QSPEC, " << after.stale - before.stale
+			<< " stale, " << (after.cpu_usec - before.cpu_usec) / 1000.0
+			<< " ms CPU" << std::endl;
+	}
+
+	__atomic_store_n(&stop, true, __ATOMIC_RELEASE);
+	pthread_join(gist_thread, NULL);
+
+	delete reserve;
+
+	processing_module.stop_processing();
+	timer_module.stop_processing();
+	processing_module.abort_processing();
+	timer_module.abort_processing();
+
+	return 0;
+}
+
+// EOF
@@ -54,8 +54,10 @@ NSLP_Flow_Context::NSLP_Flow_Context(const ntlp::mri_pathcoupled &mri, const qsp
 
 
     reserved = false;
+    outgoing_interface = 0;
     replace_set = false;
     reduced_refresh = false;
+    refresh_seq = 0;
 
     merging_node = false;
     branching_node = false;
@@ -185,6 +187,20 @@ const qspec_object &NSLP_Flow_Context::get_qspec() const {
     return flow_qspec;
 }
 
+/** This function sets the outgoing interface the QSPEC was admitted on.
+  * @param oif interface number as returned by rmf::get_outgoing_interface().
+  */
+void NSLP_Flow_Context::set_outgoing_interface(uint16 oif) {
+    outgoing_interface = oif;
+}
+
+/** This function gets the outgoing interface the QSPEC was admitted on.
+  * @return interface number to pass to the RMF when releasing resources.
+  */
+uint16 NSLP_Flow_Context::get_outgoing_interface() const {
+    return outgoing_interface;
+}
+
 
 
 /** Set function for the REFRESH_PERIOD of the current NSLP_Flow_Context.
@@ -219,6 +235,23 @@ bool NSLP_Flow_Context::get_reduced_refresh() const {
 
 
 
+/** This function starts a new refresh of this flow, superseding the
+  * refreshes scheduled before.
+  * @return the sequence number to be given to the refresh_scheduler.
+  */
+uint32 NSLP_Flow_Context::next_refresh_seq() {
+    return ++refresh_seq;
+}
+
+/** This function gets the sequence number of the refresh scheduled last.
+  * @return the sequence number, 0 if no refresh was scheduled.
+  */
+uint32 NSLP_Flow_Context::get_refresh_seq() const {
+    return refresh_seq;
+}
+
+
+
 /** This function sets the value of the refresh timer.
   * @param sec the value of the refresh timer.
   */
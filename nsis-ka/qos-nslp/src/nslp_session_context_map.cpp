@@ -28,25 +28,45 @@
 //
 // ===========================================================
 
+#include <algorithm>
+
 #include "nslp_session_context_map.h"
 
 namespace qos_nslp {
 
 
-NSLP_Session_Context_Map::NSLP_Session_Context_Map() {
+/**
+ * constructor
+ * @param n number of shards, rounded up to a power of two
+ */
+NSLP_Session_Context_Map::NSLP_Session_Context_Map(uint32 n) {
     pthread_mutexattr_init(&mutex_attr);
 #ifdef _DEBUG
     pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_ERRORCHECK);
 #else
     pthread_mutexattr_settype(&mutex_attr, PTHREAD_MUTEX_NORMAL);
 #endif
-    
-    pthread_mutex_init(&mutex, &mutex_attr);  
+
+    uint32 count = 1;
+    while (count < n)
+        count <<= 1;
+
+    // every shard in its own allocation, so the locks of different shards
+    // do not share cache lines
+    shards.reserve(count);
+    for (uint32 i = 0; i < count; i++) {
+        shard_t *shard = new shard_t;
+        pthread_mutex_init(&shard->mutex, &mutex_attr);
+        shards.push_back(shard);
+    }
 }
 
 
 NSLP_Session_Context_Map::~NSLP_Session_Context_Map() {
-    pthread_mutex_destroy(&mutex);
+    for (uint32 i = 0; i < shards.size(); i++) {
+        pthread_mutex_destroy(&shards[i]->mutex);
+        delete shards[i];
+    }
     pthread_mutexattr_destroy(&mutex_attr);
 }
 
@@ -55,176 +75,203 @@ NSLP_Session_Context_Map::~NSLP_Session_Context_Map() {
  * finds context for given sessionid
  */
 NSLP_Session_Context* NSLP_Session_Context_Map::find_session_context(const sessionid &sid) {
-    lock();
-    
-    session_context_map_const_it_t it = session_context_map.find(sid.get_hash());
-    NSLP_Session_Context* context = (it != session_context_map.end()) ? it->second : NULL;
-    
-    unlock();
-    
+    const uint128 key = sid;
+    shard_t &shard = get_shard(key);
+
+    lock(shard);
+
+    session_context_map_const_it_t it = shard.session_context_map.find(key);
+    NSLP_Session_Context* context = (it != shard.session_context_map.end()) ? it->second.context : NULL;
+
+    unlock(shard);
+
     return context;
 }
 
 
 /**
- * finds rii_hashmap for given sessionid
+ * finds rii_hashmap for given sessionid, an empty one is created if the
+ * session is not known yet. The reference is valid only until erase() of
+ * the session, so it may only be used by the thread owning the session
+ * (the worker of its SID, see ProcessingModule::get_worker()).
  */
 NSLP_Session_Context_Map::riimap_t &NSLP_Session_Context_Map::get_rii_hashmap(const sessionid &sid) {
-    lock();
+    const uint128 key = sid;
+    shard_t &shard = get_shard(key);
 
-    riimap_t *rii_hashmap;
+    lock(shard);
 
-    session_rii_map_const_it_t it;
-    if ((it = session_to_rii_hashmap.find(sid.get_hash())) != session_to_rii_hashmap.end()) {
-        rii_hashmap = it->second;
-    }
-    else {
-        rii_hashmap = new NSLP_Session_Context_Map::riimap_t();
+    // the entries are allocated one by one, so the reference stays valid
+    // when the map grows
+    riimap_t &rii_hashmap = shard.session_context_map[key].rii_hashmap;
 
-        pair<simple_sid, riimap_t *> tmppair;
+    unlock(shard);
 
-        tmppair.first = sid.get_hash();
-        tmppair.second = rii_hashmap;
-        
-        session_to_rii_hashmap.insert(tmppair);
-    }
-
-    assert(rii_hashmap != NULL);
-    
-    unlock();
-    
-    return *rii_hashmap;
+    return rii_hashmap;
 }
 
 
 void NSLP_Session_Context_Map::insert_mri2context_map(const sessionid &sid, const ntlp::mri_pathcoupled &lmri) {
-    lock();
+    const uint128 key = sid;
+    shard_t &mri_shard = get_shard(lmri);
+
+    lock(mri_shard);
 
-    mri2context_map.insert(pair<const mri_pathcoupled *, simple_sid>(lmri.copy(), sid.get_hash()));
-    
-    unlock();
+    vector<uint128> &sids = mri_shard.mri2context_map[lmri];
+    bool known = find(sids.begin(), sids.end(), key) != sids.end();
+    if (!known)
+        sids.push_back(key);
+
+    unlock(mri_shard);
+
+    if (known)
+        return;
+
+    // remember the MRI with the session, so erase() finds the index entry
+    shard_t &shard = get_shard(key);
+
+    lock(shard);
+
+    shard.session_context_map[key].logical_mris.push_back(lmri);
+
+    unlock(shard);
 }
 
 
 NSLP_Session_Context* NSLP_Session_Context_Map::find_first(const mri_pathcoupled &mri, search_context &sc) {
-    NSLP_Session_Context *context = NULL;
-    
-    lock();
-    
+    shard_t &mri_shard = get_shard(mri);
+
     if (sc.sidlist)
         sc.sidlist->clear();
     else
-        sc.sidlist = new list<simple_sid>;
-    
-    mri2context_map_it_t lb, ub, it;
-    lb = mri2context_map.lower_bound(&mri);
-    ub = mri2context_map.upper_bound(&mri);
-    for (it = lb; it != ub && it != mri2context_map.end(); it++)
-        sc.sidlist->push_front((*it).second);
-    
+        sc.sidlist = new list<uint128>;
+
+    lock(mri_shard);
+
+    mri2context_map_it_t it = mri_shard.mri2context_map.find(mri);
+    if (it != mri_shard.mri2context_map.end())
+        sc.sidlist->insert(sc.sidlist->end(), it->second.rbegin(), it->second.rend());
+
+    unlock(mri_shard);
+
     sc.slit = sc.sidlist->begin();
-    while (sc.slit != sc.sidlist->end() && context == NULL) {
-        session_context_map_const_it_t hit = session_context_map.find((*sc.slit));
-        context = (hit != session_context_map.end()) ? hit->second : NULL;
-        sc.slit++;
-    }
-    
-    unlock();
-    
-    return context;
+
+    return find_next(sc);
 }
 
 
 NSLP_Session_Context* NSLP_Session_Context_Map::find_next(search_context &sc) {
     NSLP_Session_Context *context = NULL;
-    
+
     if (sc.sidlist == NULL)
         return NULL;
 
-    lock();
-    
+    // the sessions are looked up one by one, each in its own shard
     while (sc.slit != sc.sidlist->end() && context == NULL) {
-        session_context_map_const_it_t hit = session_context_map.find((*sc.slit));
-        context = (hit != session_context_map.end()) ? hit->second : NULL;
+        shard_t &shard = get_shard(*sc.slit);
+
+        lock(shard);
+
+        session_context_map_const_it_t hit = shard.session_context_map.find(*sc.slit);
+        context = (hit != shard.session_context_map.end()) ? hit->second.context : NULL;
+
+        unlock(shard);
+
         sc.slit++;
     }
-    
-    unlock();
-    
+
     return context;
 }
 
 
 /**
  * inserts context for given sessionid
+ * @return false if the session already has a context
  */
 bool NSLP_Session_Context_Map::insert_session_context(const sessionid &sid, NSLP_Session_Context *context) {
-    pair<uint64, NSLP_Session_Context *> tmppair;
-    pair<session_context_map_it_t, bool> tmpiterator;
-
-    tmppair.first = sid.get_hash();
-    tmppair.second = context;
-    
-    lock();
-    
-    tmpiterator = session_context_map.insert(tmppair);
-    
-    unlock();
-
-    /*
-    lock();
-    context_hashmap_it_t hit= context_hashmap.insert(make_pair(r_hash,context));
-    context_hashmap[r_hash] = context;
-    unlock();
-    
-    // hit.first now points to the newly inserted element
-    // return success or failure
-    return hit.second;
-    */
-    
-    // hit.first now points to the newly inserted element
-    // return success or failure
-
-    return tmpiterator.second;
+    const uint128 key = sid;
+    shard_t &shard = get_shard(key);
+    bool inserted = false;
+
+    lock(shard);
+
+    // the entry may exist already with the RIIs of the session only
+    session_entry &entry = shard.session_context_map[key];
+    if (entry.context == NULL) {
+        entry.context = context;
+        inserted = true;
+    }
+
+    unlock(shard);
+
+    return inserted;
 }
 
 
+/**
+ * removes the context, the RII map and the logical MRIs of given sessionid.
+ * References from get_rii_hashmap() become invalid, so only the thread
+ * owning the session may erase it.
+ */
 void NSLP_Session_Context_Map::erase(const sessionid &sid) {
-    lock();
-    
-    session_context_map.erase(sid.get_hash());
-
-    mri2context_map_it_t it = mri2context_map.begin();
-    while (it != mri2context_map.end()) {
-        if ((*it).second == sid.get_hash())
-            mri2context_map.erase(it);
-        
-        it++;
+    const uint128 key = sid;
+    shard_t &shard = get_shard(key);
+    vector<ntlp::mri_pathcoupled> logical_mris;
+
+    lock(shard);
+
+    session_context_map_it_t it = shard.session_context_map.find(key);
+    if (it != shard.session_context_map.end()) {
+        logical_mris.swap(it->second.logical_mris);
+        shard.session_context_map.erase(it);
+    }
+
+    unlock(shard);
+
+    // only the MRIs of this session are visited, not the whole index
+    for (uint32 i = 0; i < logical_mris.size(); i++) {
+        shard_t &mri_shard = get_shard(logical_mris[i]);
+
+        lock(mri_shard);
+
+        mri2context_map_it_t mit = mri_shard.mri2context_map.find(logical_mris[i]);
+        if (mit != mri_shard.mri2context_map.end()) {
+            vector<uint128> &sids = mit->second;
+            sids.erase(remove(sids.begin(), sids.end(), key), sids.end());
+            if (sids.empty())
+                mri_shard.mri2context_map.erase(mit);
+        }
+
+        unlock(mri_shard);
     }
-    
-    unlock();
 }
 
 
 /*
  * Traverses all contexts of the NSLP_Session_Context_Map executing func on them. The parameters
  * param1 and param2 are passed unchanged to the function "func".
- * Because of locking reasons func should run as short as possible.
+ * Because of locking reasons func should run as short as possible. Only the shard
+ * of the context func is called with is locked.
  */
 void
 NSLP_Session_Context_Map::traverse_contexts(state_manager *sm, proc_func_t func, void *param1, void *param2)
 {
-    lock();
-    
-    session_context_map_const_it_t it=session_context_map.begin();
-    while(it != session_context_map.end()) {
-        // execute function "func"
-        (sm->*func)(it->second, param1, param2);
-        
-        it++;
+    for (uint32 i = 0; i < shards.size(); i++) {
+        shard_t &shard = *shards[i];
+
+        lock(shard);
+
+        session_context_map_const_it_t it=shard.session_context_map.begin();
+        while(it != shard.session_context_map.end()) {
+            // execute function "func"
+            if (it->second.context != NULL)
+                (sm->*func)(it->second.context, param1, param2);
+
+            it++;
+        }
+
+        unlock(shard);
     }
-    
-    unlock();
 }
 
 } // end namespace qos_nslp
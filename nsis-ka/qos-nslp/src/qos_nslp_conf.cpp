@@ -78,6 +78,8 @@ qos_nslp_conf::registerAllPars()
 	cfp_rep->registerPar( new configpar<string>(qos_nslp_realm, qosnslpconf_rmf_vlsp_link_down_script_drain, "rmf-vlsp-vlink-down-script-drain", "Script to be called when getting a link tear down request at the drain side", true) );
 	cfp_rep->registerPar( new configpar<string>(qos_nslp_realm, qosnslpconf_rmf_vlsp_link_down_script_source, "rmf-vlsp-vlink-down-script-source", "Script to be called when getting a link tear down response at the source side", true) );
 	cfp_rep->registerPar( new configpar<bool>(qos_nslp_realm, qosnslpconf_sauth_hmac_verify, "session-auth-hmac-verify", "Enable verification of an incoming session authorization object", true, true) );
+	cfp_rep->registerPar( new configpar<uint32>(qos_nslp_realm, qosnslpconf_processing_workers, "processing-workers", "Number of processing threads, each owning a partition of the sessions (1: single thread)", true, 1));
+	cfp_rep->registerPar( new configpar<bool>(qos_nslp_realm, qosnslpconf_reduced_refreshes, "reduced-refreshes", "Leave out the QSPEC of refreshing RESERVEs once the reservation is confirmed", true, false) );
 
 	DLog("qosnslp::registerAllPars", "finished registering qos nslp parameters.");
 }
@@ -92,6 +94,8 @@ qos_nslp_conf::to_string()
 	os << parname(qosnslpconf_refresh_period) << "= " << getpar<uint32>(qosnslpconf_refresh_period) <<  parunitinfo(qosnslpconf_refresh_period) << endl;
 	os << parname(qosnslpconf_request_retry) << "= " << getpar<uint32>(qosnslpconf_request_retry) <<  parunitinfo(qosnslpconf_request_retry) << endl;
 	os << parname(qosnslpconf_max_retry) << "= " << getpar<uint32>(qosnslpconf_max_retry) << endl;
+	os << parname(qosnslpconf_processing_workers) << "= " << getpar<uint32>(qosnslpconf_processing_workers) << endl;
+	os << parname(qosnslpconf_reduced_refreshes) << "= " << (getpar<bool>(qosnslpconf_reduced_refreshes) ? "true" : "false") << endl;
 
 	return os.str();
 }
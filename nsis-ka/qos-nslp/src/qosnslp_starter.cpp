@@ -33,6 +33,7 @@
 #include "queuemanager.h"
 
 #include "gist_conf.h"
+#include "qos_nslp_conf.h"
 
 using namespace qos_nslp;
 using namespace ntlp;
@@ -71,11 +72,12 @@ void QoSNSLPStarter::main_loop(uint32 n)
 		FastQueue* applmsgrecv_fq= new FastQueue("applmsgchecker",true);
 		QueueManager::instance()->register_queue(applmsgrecv_fq, message::qaddr_appl_qos_signaling);
 			
-		// start ProcessingModule (will need four threads)
+		// start ProcessingModule (will need four threads and one per worker)
 		ProcessingModuleParam sim_cl_par(ThreadParam::default_sleep_time,
-						 *param.addresses, *param.fi_service);
+						 *param.addresses, *param.fi_service, true, true,
+						 qosnslpconf.getpar<uint32>(qosnslpconf_processing_workers));
 
-		ThreadStarter<ProcessingModule, ProcessingModuleParam> processing_module(4, sim_cl_par);
+		ThreadStarter<ProcessingModule, ProcessingModuleParam> processing_module(sim_cl_par.get_thread_count(), sim_cl_par);
 
 		FastQueue* apimsgrecv_fq = new FastQueue("apimsgchecker", true);
 		QueueManager::instance()->register_queue(apimsgrecv_fq, message::qaddr_api_1);
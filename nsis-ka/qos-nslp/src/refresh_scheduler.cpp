@@ -0,0 +1,234 @@
+/// ----------------------------------------*- mode: C++; -*--
+/// @file refresh_scheduler.cpp
+/// QoS NSLP refresh scheduler
+/// ----------------------------------------------------------
+/// $Id$
+/// $HeadURL$
+// ===========================================================
+//
+// Copyright (C) 2005-2010, all rights reserved by
+// - Institute of Telematics, Karlsruhe Institute of Technology
+//
+// More information and contact:
+// https://projekte.tm.uka.de/trac/NSIS
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License as
+// published by the Free Software Foundation; version 2 of the License
+//
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+// General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+// 02110-1301 USA.
+//
+// ===========================================================
+
+#include <sys/time.h>
+
+#include "refresh_scheduler.h"
+#include "ProcessingModule.h"
+
+namespace qos_nslp {
+
+/** @addtogroup QoS_StateModule NSLP protocol state machine
+ * @{
+ */
+
+/***** class refresh_scheduler *****/
+
+refresh_scheduler* refresh_scheduler::scheduler_p = NULL;
+
+/** The scheduler of the QoS NSLP, created with one partition on first use.
+  */
+refresh_scheduler&
+refresh_scheduler::instance()
+{
+	if (scheduler_p == NULL)
+		scheduler_p = new refresh_scheduler();
+
+	return *scheduler_p;
+}
+
+
+/** Constructor.
+  * @param n number of partitions.
+  */
+refresh_scheduler::refresh_scheduler(uint32 n)
+{
+	stats.scheduled = 0;
+	stats.passes = 0;
+	stats.sent = 0;
+	stats.reduced = 0;
+	stats.stale = 0;
+	stats.cpu_usec = 0;
+
+	set_partitions(n);
+}
+
+
+refresh_scheduler::~refresh_scheduler()
+{
+	for (uint32 i = 0; i < partitions.size(); i++) {
+		pthread_mutex_destroy(&partitions[i]->mutex);
+		delete partitions[i];
+	}
+}
+
+
+/** This function changes the number of partitions, the refreshes already
+  * scheduled are moved to their new partitions. It must not be called
+  * while other threads use the scheduler.
+  */
+void
+refresh_scheduler::set_partitions(uint32 n)
+{
+	if (n == 0)
+		n = 1;
+	if (n == partitions.size())
+		return;
+
+	std::vector<partition_t*> old;
+	old.swap(partitions);
+
+	for (uint32 i = 0; i < n; i++) {
+		partition_t* p = new partition_t;
+		pthread_mutex_init(&p->mutex, NULL);
+		partitions.push_back(p);
+	}
+
+	for (uint32 i = 0; i < old.size(); i++) {
+		for (bucketmap_t::iterator b = old[i]->buckets.begin(); b != old[i]->buckets.end(); ++b)
+			for (uint32 e = 0; e < b->second.size(); e++)
+				partitions[get_partition(b->second[e].sid)]->buckets[b->first].push_back(b->second[e]);
+
+		pthread_mutex_destroy(&old[i]->mutex);
+		delete old[i];
+	}
+}
+
+
+/** Partition of a session, the same as the processing worker owning it.
+  */
+uint32
+refresh_scheduler::get_partition(const uint128& sid) const
+{
+	return ProcessingModule::get_worker(sid, partitions.size());
+}
+
+
+/** This function adds a refresh to the bucket of its due time.
+  * @param due time the refresh is due, in seconds since the epoch.
+  * @param seq sequence number of the refresh in the flow context.
+  */
+void
+refresh_scheduler::schedule(const uint128& sid, const ntlp::mri_pathcoupled& mri, time_t due, uint32 seq)
+{
+	partition_t* p = partitions[get_partition(sid)];
+
+	pthread_mutex_lock(&p->mutex);
+	std::vector<entry_t>& bucket = p->buckets[due];
+	bucket.resize(bucket.size() + 1);
+	entry_t& e = bucket.back();
+	e.sid = sid;
+	e.mri = mri;
+	e.due = due;
+	e.seq = seq;
+	pthread_mutex_unlock(&p->mutex);
+
+	__atomic_add_fetch(&stats.scheduled, 1, __ATOMIC_RELAXED);
+}
+
+
+/** This function takes the entries of the due buckets out of a partition.
+  * @param due the entries are appended to this vector.
+  * @return true if any bucket was due.
+  */
+bool
+refresh_scheduler::get_due(uint32 partition, time_t now, std::vector<entry_t>& due)
+{
+	if (partition >= partitions.size())
+		return false;
+
+	partition_t* p = partitions[partition];
+	bool found = false;
+
+	pthread_mutex_lock(&p->mutex);
+	while (!p->buckets.empty() && p->buckets.begin()->first <= now) {
+		std::vector<entry_t>& bucket = p->buckets.begin()->second;
+		if (due.empty())
+			due.swap(bucket);
+		else
+			due.insert(due.end(), bucket.begin(), bucket.end());
+		p->buckets.erase(p->buckets.begin());
+		found = true;
+	}
+	pthread_mutex_unlock(&p->mutex);
+
+	return found;
+}
+
+
+/** This function gets how long the thread owning a partition may wait for
+  * messages before it must refresh the next bucket.
+  * @param wait the maximum waiting time in milliseconds.
+  */
+uint32
+refresh_scheduler::get_wait(uint32 partition, uint32 wait) const
+{
+	if (partition >= partitions.size())
+		return wait;
+
+	partition_t* p = partitions[partition];
+	time_t next = 0;
+
+	pthread_mutex_lock(&p->mutex);
+	bool empty = p->buckets.empty();
+	if (!empty)
+		next = p->buckets.begin()->first;
+	pthread_mutex_unlock(&p->mutex);
+
+	if (empty)
+		return wait;
+
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	if (next <= now.tv_sec)
+		return 0;
+
+	uint64 ms = (uint64) (next - now.tv_sec) * 1000 - now.tv_usec / 1000;
+	return ms < wait ? (uint32) ms : wait;
+}
+
+
+void
+refresh_scheduler::count_pass(uint32 sent, uint32 reduced, uint32 stale, uint64 cpu_usec)
+{
+	__atomic_add_fetch(&stats.passes, 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats.sent, sent, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats.reduced, reduced, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats.stale, stale, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&stats.cpu_usec, cpu_usec, __ATOMIC_RELAXED);
+}
+
+
+refresh_scheduler::stats_t
+refresh_scheduler::get_stats() const
+{
+	stats_t s;
+	s.scheduled = __atomic_load_n(&stats.scheduled, __ATOMIC_RELAXED);
+	s.passes = __atomic_load_n(&stats.passes, __ATOMIC_RELAXED);
+	s.sent = __atomic_load_n(&stats.sent, __ATOMIC_RELAXED);
+	s.reduced = __atomic_load_n(&stats.reduced, __ATOMIC_RELAXED);
+	s.stale = __atomic_load_n(&stats.stale, __ATOMIC_RELAXED);
+	s.cpu_usec = __atomic_load_n(&stats.cpu_usec, __ATOMIC_RELAXED);
+	return s;
+}
+
+//@}
+
+} // end namespace qos_nslp
@@ -31,6 +31,7 @@
 #include "rmf.h"
 #include "logfile.h"
 #include "qos_nslp_conf.h"
+#include "routing_util.h"
 
 #include <iomanip>
 #include <sstream>
@@ -53,9 +54,10 @@ const uint32 rmf::reserved_default = 0;
 
 long rmf::AF_available_bandwidth= 400000000;	// in bit/s
 long rmf::EF_available_bandwidth= 600000000;	// in bit/s
-long rmf::EF_res_avg_rate= 0;				// in bit/s
 long rmf::BE_available_bandwidth= 600000000;	// in bit/s
 
+admission_ledger rmf::ledger;
+
 	
 /** Default constructor for RMF function without any params. All values will be set to the default values.
   */
@@ -63,6 +65,9 @@ rmf::rmf() {
 	set_max_avail_bandwidth(10000000);
 	set_default_reserved();
 	get_avail_bandwidth(available_bandwidth);
+	ledger.set_default_capacity(admission_ledger::tc_af, AF_available_bandwidth);
+	ledger.set_default_capacity(admission_ledger::tc_ef, EF_available_bandwidth);
+	ledger.set_default_capacity(admission_ledger::tc_best_effort, BE_available_bandwidth);
 	} // end constructor
 
 
@@ -120,91 +125,89 @@ void rmf::process_qspec_in_query(qspec_pdu* q)
 
 }
 
-/** This function reserves resources as specified in QSPEC object.
-  * @param q current QSPEC containing resources to be reserved.
+/** This function determines class and bandwidth a QSPEC asks for. AF and EF
+  * flows are admitted with their peak data rate, best effort flows with their
+  * average rate.
+  * @return false if the QSPEC does not ask for any bandwidth.
   */
-bool 
-rmf::reserve_resources(const qspec_pdu* q)
+bool
+rmf::get_admission(const qspec_pdu* q, admission_ledger::traffic_class_t& tclass, uint64& bandwidth)
 {
-    
-  	bool result = false;
-	
 	qspec::qspec_object *ob = q->get_object(0);
-	
-	admission_priority *ad_pr = (admission_priority*) ob->get_parameter(9);
-	t_mod *tmd = (t_mod*) ob->get_parameter(1);
-	long *afb = &AF_available_bandwidth;
-	long *efb = &EF_available_bandwidth;
-	long *ef_avg_rate = &EF_res_avg_rate;
-	long *beb = &BE_available_bandwidth;
-	
-	
+	if (ob == NULL)
+		return false;
+
+	admission_priority *ad_pr = dynamic_cast<admission_priority*>(ob->get_parameter(9));
+	t_mod *tmd = dynamic_cast<t_mod*>(ob->get_parameter(1));
+	if (tmd == NULL)
+		return false;
+
 	EVLog("QoS RMF", "QoS-desired average rate: " << tmd->get_rate());
 	EVLog("QoS RMF", "QoS-desired peak data rate: " << tmd->get_peak_data_rate());
 	EVLog("QoS RMF", "QoS-desired bucket depth: " << tmd->get_bucket_depth());
 	EVLog("QoS RMF", "QoS-desired mpu: " << tmd->get_min_policed_unit());
-	
-	if ( ad_pr->get_y2171value() == 1) {	
-			
-		if ((AF_available_bandwidth - tmd->get_peak_data_rate())>0) {	
-			EVLog("QoS RMF", "RESERVE resources for AF");	
-			*afb -= tmd->get_peak_data_rate();
-			result = true;
-		
-			}
+
+	switch (ad_pr ? ad_pr->get_y2171value() : ap_best_effort_priority_flow) {
+	case ap_normal_priority_flow:
+		tclass = admission_ledger::tc_af;
+		bandwidth = (uint64) tmd->get_peak_data_rate();
+		break;
+	case ap_high_priority_flow:
+		tclass = admission_ledger::tc_ef;
+		bandwidth = (uint64) tmd->get_peak_data_rate();
+		break;
+	default:
+		tclass = admission_ledger::tc_best_effort;
+		bandwidth = (uint64) tmd->get_rate();
+		break;
 	}
-	
-	
-	if ( (ad_pr->get_y2171value()) == 2) {
-		if((EF_available_bandwidth - tmd->get_peak_data_rate())>0) {
-			EVLog("QoS RMF", "RESERVE resources for EF");
-			*efb -= tmd->get_peak_data_rate();		
-			*ef_avg_rate += tmd->get_rate(); 
-			result = true;
-		}
+
+	return true;
+}
+
+/** This function reserves resources as specified in QSPEC object.
+  * @param q current QSPEC containing resources to be reserved.
+  * @param oif outgoing interface of the flow, see get_outgoing_interface().
+  */
+bool 
+rmf::reserve_resources(const qspec_pdu* q, uint16 oif)
+{
+	admission_ledger::traffic_class_t tclass;
+	uint64 bandwidth;
+
+	if (!get_admission(q, tclass, bandwidth))
+		return true;
+
+	if (!ledger.reserve(oif, tclass, bandwidth))
+		return false;
+
+	EVLog("QoS RMF", "RESERVE " << bandwidth << " bit/s for class " << tclass << " on interface " << oif);
+   	return true;
+}
+
+/** This function gives back the bandwidth reserved by reserve_resources(),
+  * e.g. if the reservation cannot be installed or is replaced by another one.
+  * @param q QSPEC the resources were reserved for.
+  * @param oif outgoing interface the resources were reserved on.
+  */
+void rmf::rollback_resources(const qspec_pdu* q, uint16 oif)
+{
+	admission_ledger::traffic_class_t tclass;
+	uint64 bandwidth;
+
+	if (get_admission(q, tclass, bandwidth)) {
+		EVLog("QoS RMF", "RELEASE " << bandwidth << " bit/s for class " << tclass << " on interface " << oif);
+		ledger.release(oif, tclass, bandwidth);
 	}
-	
-	 if ( (ad_pr->get_y2171value()) == 0) {
-	 	if (BE_available_bandwidth - EF_res_avg_rate - tmd->get_rate()) {	
-			EVLog("QoS RMF", "RESERVE resources for BE");	
-			*beb -= *ef_avg_rate - tmd->get_rate();
-			result = true;
-	 	}
-	 }
-	 	
-  
-   	return result;
 }
 
 /** This function releases resources as specified in QSPEC object.
   * @param q current QSPEC containing resources to be released.
+  * @param oif outgoing interface the resources were reserved on.
   */
-void rmf::release_resources(const qspec_pdu* q)
+void rmf::release_resources(const qspec_pdu* q, uint16 oif)
 {
-  EVLog("QoS RMF", "RELEASE resources");
-    	qspec::qspec_object *ob = q->get_object(0);
-	admission_priority *ad_pr = (admission_priority*) ob->get_parameter(9);
-	t_mod *tmd = (t_mod*) ob->get_parameter(1);
-	long *afb = &AF_available_bandwidth;
-	long *efb = &EF_available_bandwidth;
-	long *ef_avg_rate = &EF_res_avg_rate;
-	long *beb = &BE_available_bandwidth;	
-	
-	if (( ad_pr->get_y2171value())==1) {
-		EVLog("QoS RMF", "RELEASE resources for AF");			
-		*afb += tmd->get_peak_data_rate();
-	}
-	
-	if ( (ad_pr->get_y2171value())==2) {
-		EVLog("QoS RMF", "RELEASE resources for EF");
-		*efb += tmd->get_peak_data_rate();
-		*ef_avg_rate -= tmd->get_rate();
-	}
-	
-	if ( (ad_pr->get_y2171value())==0) {
-		EVLog("QoS RMF", "RELEASE resources for BE");
-		*beb -= *ef_avg_rate + tmd->get_rate();
-	} 
+	rollback_resources(q, oif);
 
 	string command = qosnslpconf.getpar<string>(qosnslpconf_rmf_vlsp_link_down_script_source);
 
@@ -222,6 +225,29 @@ void rmf::release_resources(const qspec_pdu* q)
 	}
 }
 
+/** This function determines the interface the packets of a flow leave this
+  * node on. 0 if it is unknown, reservations are then accounted to interface 0.
+  * The route is looked up by destination only, on a QNE or QNR the source of
+  * the flow is not a local address. The MRI always describes the data flow
+  * from source to destination, its direction flag is the one of the
+  * signaling messages. So an upstream MRI (receiver-initiated reservation)
+  * leads to the same interface as the downstream MRI of the flow.
+  * @param flow MRI of the flow.
+  */
+uint16
+rmf::get_outgoing_interface(const ntlp::mri_pathcoupled& flow)
+{
+	return protlib::util::get_local_if(flow.get_destaddress());
+}
+
+/** This function gets the bandwidth admitted per outgoing interface and class.
+  */
+void
+rmf::get_utilization(std::vector<admission_ledger::utilization_t>& result)
+{
+	ledger.get_utilization(result);
+}
+
 // process incoming vlink setup request (incoming RESERVE)
 void 
 rmf::process_vlsp_object_setup_req(const vlsp_object* vlspobj)
@@ -0,0 +1,232 @@
+/*
+ * Test the admission control ledger of the RMF.
+ *
+ * $Id$
+ * $HeadURL$
+ */
+#include "test_suite.h"
+
+#include <cstdlib>
+#include <pthread.h>
+#include <vector>
+
+#include "admission_ledger.h"
+#include "rmf.h"
+#include "routing_util.h"
+
+using namespace qos_nslp;
+
+
+namespace {
+
+const unsigned int threads = 8;
+const unsigned int attempts = 20000;
+const uint64 unit = 1000;
+const uint64 capacity = 1000 * unit;
+
+struct stress_arg {
+	admission_ledger *ledger;
+	unsigned int seed;
+	unsigned long admitted;
+	bool over_admitted;
+};
+
+/*
+ * Reserves units until it has 200 and then releases them again, checking
+ * that the ledger never shows more than the capacity.
+ */
+void *stress(void *p) {
+	stress_arg *arg = static_cast<stress_arg *>(p);
+	unsigned int held = 0;
+
+	for (unsigned int i = 0; i < attempts; i++) {
+		uint64 cap, reserved;
+
+		if ( held < 200 && rand_r(&arg->seed) % 3 != 0 ) {
+			if ( arg->ledger->reserve(1, admission_ledger::tc_ef, unit) ) {
+				held++;
+				arg->admitted++;
+			}
+		}
+		else if ( held > 0 ) {
+			arg->ledger->release(1, admission_ledger::tc_ef, unit);
+			held--;
+		}
+
+		arg->ledger->get_utilization(1, admission_ledger::tc_ef, cap, reserved);
+		if ( reserved > cap )
+			arg->over_admitted = true;
+	}
+
+	while ( held-- > 0 )
+		arg->ledger->release(1, admission_ledger::tc_ef, unit);
+
+	return NULL;
+}
+
+/*
+ * Reserves as much as it can, without releasing anything.
+ */
+void *fill(void *p) {
+	stress_arg *arg = static_cast<stress_arg *>(p);
+
+	for (unsigned int i = 0; i < attempts; i++)
+		if ( arg->ledger->reserve(2, admission_ledger::tc_af, unit) )
+			arg->admitted++;
+
+	return NULL;
+}
+
+}
+
+
+class test_admission_ledger : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( test_admission_ledger );
+
+	CPPUNIT_TEST( test_reserve_release );
+	CPPUNIT_TEST( test_interfaces );
+	CPPUNIT_TEST( test_concurrent_fill );
+	CPPUNIT_TEST( test_concurrent_churn );
+	CPPUNIT_TEST( test_outgoing_interface );
+
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void test_reserve_release() {
+			admission_ledger ledger;
+			uint64 cap, reserved;
+
+			ledger.set_default_capacity(admission_ledger::tc_af, 1000);
+			ledger.set_default_capacity(admission_ledger::tc_ef, 500);
+
+			CPPUNIT_ASSERT( !ledger.get_utilization(3, admission_ledger::tc_af, cap, reserved) );
+			CPPUNIT_ASSERT( ledger.reserve(3, admission_ledger::tc_af, 600) );
+			CPPUNIT_ASSERT( ledger.reserve(3, admission_ledger::tc_af, 400) );
+			CPPUNIT_ASSERT( !ledger.reserve(3, admission_ledger::tc_af, 1) );
+
+			// the classes do not share their capacity
+			CPPUNIT_ASSERT( ledger.reserve(3, admission_ledger::tc_ef, 500) );
+			CPPUNIT_ASSERT( !ledger.reserve(3, admission_ledger::tc_best_effort, 1) );
+
+			CPPUNIT_ASSERT( ledger.get_utilization(3, admission_ledger::tc_af, cap, reserved) );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 1000, cap );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 1000, reserved );
+
+			ledger.release(3, admission_ledger::tc_af, 600);
+			CPPUNIT_ASSERT( ledger.reserve(3, admission_ledger::tc_af, 500) );
+			CPPUNIT_ASSERT( !ledger.reserve(3, admission_ledger::tc_af, 101) );
+
+			// releasing more than reserved does not wrap around
+			ledger.release(3, admission_ledger::tc_ef, 501);
+			ledger.get_utilization(3, admission_ledger::tc_ef, cap, reserved);
+			CPPUNIT_ASSERT_EQUAL( (uint64) 0, reserved );
+
+			// a smaller capacity keeps the reservations, but admits no more
+			CPPUNIT_ASSERT( ledger.set_capacity(3, admission_ledger::tc_af, 100) );
+			ledger.get_utilization(3, admission_ledger::tc_af, cap, reserved);
+			CPPUNIT_ASSERT_EQUAL( (uint64) 100, cap );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 900, reserved );
+			CPPUNIT_ASSERT( !ledger.reserve(3, admission_ledger::tc_af, 1) );
+		}
+
+		void test_interfaces() {
+			admission_ledger ledger(4);
+			std::vector<admission_ledger::utilization_t> usage;
+
+			ledger.set_default_capacity(admission_ledger::tc_ef, 100);
+
+			// interfaces are independent, also if they hash alike
+			for (uint16 i = 0; i < 4; i++)
+				CPPUNIT_ASSERT( ledger.reserve(i * 4, admission_ledger::tc_ef, 100) );
+			for (uint16 i = 0; i < 4; i++)
+				CPPUNIT_ASSERT( !ledger.reserve(i * 4, admission_ledger::tc_ef, 1) );
+
+			// the ledger is full, nothing is admitted on further interfaces
+			CPPUNIT_ASSERT( !ledger.reserve(1, admission_ledger::tc_ef, 1) );
+
+			ledger.get_utilization(usage);
+			CPPUNIT_ASSERT_EQUAL( (size_t) 4 * admission_ledger::tc_max, usage.size() );
+			for (unsigned int i = 0; i < usage.size(); i++) {
+				CPPUNIT_ASSERT( usage[i].interface % 4 == 0 );
+				if ( usage[i].tclass == admission_ledger::tc_ef )
+					CPPUNIT_ASSERT_EQUAL( (uint64) 100, usage[i].reserved );
+				else
+					CPPUNIT_ASSERT_EQUAL( (uint64) 0, usage[i].reserved );
+			}
+		}
+
+		void test_concurrent_fill() {
+			admission_ledger ledger;
+			pthread_t tid[threads];
+			stress_arg args[threads];
+			unsigned long admitted = 0;
+			uint64 cap, reserved;
+
+			ledger.set_default_capacity(admission_ledger::tc_af, capacity);
+
+			for (unsigned int i = 0; i < threads; i++) {
+				args[i].ledger = &ledger;
+				args[i].seed = i;
+				args[i].admitted = 0;
+				args[i].over_admitted = false;
+				pthread_create(&tid[i], NULL, fill, &args[i]);
+			}
+			for (unsigned int i = 0; i < threads; i++) {
+				pthread_join(tid[i], NULL);
+				admitted += args[i].admitted;
+			}
+
+			// exactly as much as fits is admitted
+			CPPUNIT_ASSERT_EQUAL( capacity / unit, (uint64) admitted );
+			ledger.get_utilization(2, admission_ledger::tc_af, cap, reserved);
+			CPPUNIT_ASSERT_EQUAL( capacity, reserved );
+		}
+
+		void test_concurrent_churn() {
+			admission_ledger ledger;
+			pthread_t tid[threads];
+			stress_arg args[threads];
+			uint64 cap, reserved;
+
+			// less than the threads together would like to hold
+			ledger.set_default_capacity(admission_ledger::tc_ef, capacity);
+
+			for (unsigned int i = 0; i < threads; i++) {
+				args[i].ledger = &ledger;
+				args[i].seed = i;
+				args[i].admitted = 0;
+				args[i].over_admitted = false;
+				pthread_create(&tid[i], NULL, stress, &args[i]);
+			}
+			for (unsigned int i = 0; i < threads; i++) {
+				pthread_join(tid[i], NULL);
+				CPPUNIT_ASSERT( !args[i].over_admitted );
+				CPPUNIT_ASSERT( args[i].admitted > 0 );
+			}
+
+			// everything was given back
+			ledger.get_utilization(1, admission_ledger::tc_ef, cap, reserved);
+			CPPUNIT_ASSERT_EQUAL( (uint64) 0, reserved );
+		}
+
+		void test_outgoing_interface() {
+			hostaddress sender("192.0.2.1");
+			hostaddress receiver("127.0.0.1");
+			uint16 oif = protlib::util::get_local_if(receiver);
+
+			CPPUNIT_ASSERT( oif != 0 );
+
+			// the sender of a forwarded flow is not a local address
+			ntlp::mri_pathcoupled down(sender, 32, receiver, 32, true);
+			CPPUNIT_ASSERT_EQUAL( oif, rmf::get_outgoing_interface(down) );
+
+			// signaling upstream, the data still leaves towards the receiver
+			ntlp::mri_pathcoupled up(sender, 32, receiver, 32, false);
+			CPPUNIT_ASSERT_EQUAL( oif, rmf::get_outgoing_interface(up) );
+		}
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( test_admission_ledger );
+
+// EOF
@@ -0,0 +1,97 @@
+/*
+ * Test the assignment of sessions to the processing workers.
+ *
+ * $Id$
+ * $HeadURL$
+ */
+#include "test_suite.h"
+
+#include <vector>
+
+#include "ProcessingModule.h"
+#include "timer_module.h"
+
+using namespace qos_nslp;
+using namespace ntlp;
+
+
+class test_processing_workers : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( test_processing_workers );
+
+	CPPUNIT_TEST( test_single );
+	CPPUNIT_TEST( test_session );
+	CPPUNIT_TEST( test_spread );
+	CPPUNIT_TEST( test_messages );
+
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void test_single() {
+			uint128 sid(1, 2, 3, 4);
+
+			CPPUNIT_ASSERT_EQUAL( 0U, ProcessingModule::get_worker(sid, 1) );
+			CPPUNIT_ASSERT_EQUAL( 0U, ProcessingModule::get_worker(sid, 0) );
+			CPPUNIT_ASSERT_EQUAL( 0U, ProcessingModule::get_worker((const message *) NULL, 8) );
+		}
+
+		void test_session() {
+			uint128 sid1(0x12345678, 0xbad00, 0xc0ffee, 0xdeadbeef);
+			uint128 sid2(0x12345678, 0xbad00, 0xc0ffee, 0xdeadbeef);
+
+			for (uint32 workers = 2; workers <= 16; workers++) {
+				uint32 w = ProcessingModule::get_worker(sid1, workers);
+				CPPUNIT_ASSERT( w < workers );
+				CPPUNIT_ASSERT_EQUAL( w,
+					ProcessingModule::get_worker(sid2, workers) );
+			}
+		}
+
+		void test_spread() {
+			const uint32 workers = 8;
+			const uint32 sessions = 8000;
+			std::vector<uint32> count(workers, 0);
+
+			// consecutive session ids, as the load generator uses them
+			for (uint32 i = 0; i < sessions; i++)
+				count[ProcessingModule::get_worker(uint128(0x4c4f4144, 0, 0, i + 1), workers)]++;
+
+			// every worker gets a fair part of the sessions
+			for (uint32 i = 0; i < workers; i++)
+				CPPUNIT_ASSERT( count[i] > sessions / workers / 2 );
+		}
+
+		void test_messages() {
+			const uint32 workers = 4;
+			sessionid sid(0x12345678, 0xbad00, 0xc0ffee, 0xdeadbeef);
+			uint32 expected = ProcessingModule::get_worker(sid, workers);
+
+			// messages from GIST, from the signaling module and timers
+			APIMsg *apimsg = new APIMsg();
+			apimsg->set_recvmessage(NULL, 1, sid.copy(), NULL, false, 1,
+				tx_attr_t(), 100, 1, 100);
+			CPPUNIT_ASSERT_EQUAL( expected,
+				ProcessingModule::get_worker(apimsg, workers) );
+			delete apimsg;
+
+			SignalingMsg sigmsg;
+			sigmsg.set_sid(sid);
+			CPPUNIT_ASSERT_EQUAL( expected,
+				ProcessingModule::get_worker(&sigmsg, workers) );
+
+			TimerMsg timermsg(message::qaddr_qos_nslp_timerprocessing);
+			timermsg.start_relative(30, 0, &sid);
+			CPPUNIT_ASSERT_EQUAL( expected,
+				ProcessingModule::get_worker(&timermsg, workers) );
+
+			// messages without session go to the first worker
+			APIMsg nosession;
+			CPPUNIT_ASSERT_EQUAL( 0U,
+				ProcessingModule::get_worker(&nosession, workers) );
+		}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( test_processing_workers );
+
+// EOF
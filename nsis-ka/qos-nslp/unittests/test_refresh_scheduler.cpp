@@ -0,0 +1,149 @@
+/*
+ * Test the buckets of the refresh scheduler.
+ *
+ * $Id$
+ * $HeadURL$
+ */
+#include "test_suite.h"
+
+#include <vector>
+
+#include "refresh_scheduler.h"
+#include "ProcessingModule.h"
+#include "nslp_flow_context.h"
+
+using namespace qos_nslp;
+using namespace ntlp;
+
+
+class test_refresh_scheduler : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( test_refresh_scheduler );
+
+	CPPUNIT_TEST( test_buckets );
+	CPPUNIT_TEST( test_wait );
+	CPPUNIT_TEST( test_partitions );
+	CPPUNIT_TEST( test_stats );
+	CPPUNIT_TEST( test_sequence );
+
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void test_buckets() {
+			refresh_scheduler scheduler;
+			mri_pathcoupled mri(hostaddress("10.0.0.1"), 32, hostaddress("10.0.0.2"), 32, true);
+			std::vector<refresh_scheduler::entry_t> due;
+
+			scheduler.schedule(uint128(0, 0, 0, 1), mri, 1000, 0);
+			scheduler.schedule(uint128(0, 0, 0, 2), mri, 1002, 0);
+			scheduler.schedule(uint128(0, 0, 0, 3), mri, 1000, 0);
+			scheduler.schedule(uint128(0, 0, 0, 4), mri, 1001, 0);
+
+			CPPUNIT_ASSERT( !scheduler.get_due(0, 999, due) );
+			CPPUNIT_ASSERT( due.empty() );
+
+			// a bucket is taken out as a whole
+			CPPUNIT_ASSERT( scheduler.get_due(0, 1000, due) );
+			CPPUNIT_ASSERT_EQUAL( (size_t) 2, due.size() );
+			CPPUNIT_ASSERT( due[0].sid == uint128(0, 0, 0, 1) );
+			CPPUNIT_ASSERT( due[1].sid == uint128(0, 0, 0, 3) );
+			CPPUNIT_ASSERT( due[0].due == 1000 );
+			CPPUNIT_ASSERT( due[0].mri == mri );
+			CPPUNIT_ASSERT( !scheduler.get_due(0, 1000, due) );
+
+			// buckets missed are refreshed late, but in order
+			due.clear();
+			CPPUNIT_ASSERT( scheduler.get_due(0, 1005, due) );
+			CPPUNIT_ASSERT_EQUAL( (size_t) 2, due.size() );
+			CPPUNIT_ASSERT( due[0].sid == uint128(0, 0, 0, 4) );
+			CPPUNIT_ASSERT( due[1].sid == uint128(0, 0, 0, 2) );
+		}
+
+		void test_wait() {
+			refresh_scheduler scheduler;
+			mri_pathcoupled mri;
+			time_t now = time(NULL);
+
+			CPPUNIT_ASSERT_EQUAL( 5000U, scheduler.get_wait(0, 5000) );
+
+			scheduler.schedule(uint128(0, 0, 0, 1), mri, now + 60, 0);
+			CPPUNIT_ASSERT_EQUAL( 5000U, scheduler.get_wait(0, 5000) );
+
+			scheduler.schedule(uint128(0, 0, 0, 2), mri, now + 2, 0);
+			uint32 wait = scheduler.get_wait(0, 5000);
+			CPPUNIT_ASSERT( wait > 0 && wait <= 2000 );
+
+			scheduler.schedule(uint128(0, 0, 0, 3), mri, now - 1, 0);
+			CPPUNIT_ASSERT_EQUAL( 0U, scheduler.get_wait(0, 5000) );
+		}
+
+		void test_partitions() {
+			const uint32 workers = 4;
+			const uint32 sessions = 100;
+			refresh_scheduler scheduler;
+			mri_pathcoupled mri;
+			std::vector<refresh_scheduler::entry_t> due;
+
+			for (uint32 i = 0; i < sessions; i++)
+				scheduler.schedule(uint128(1, 2, 3, i), mri, 1000 + i % 3, 0);
+
+			// scheduled refreshes move to the partition of their worker
+			scheduler.set_partitions(workers);
+			CPPUNIT_ASSERT_EQUAL( workers, scheduler.get_partitions() );
+
+			uint32 total = 0;
+			for (uint32 p = 0; p < workers; p++) {
+				due.clear();
+				scheduler.get_due(p, 2000, due);
+				for (uint32 i = 0; i < due.size(); i++)
+					CPPUNIT_ASSERT_EQUAL( p,
+						ProcessingModule::get_worker(due[i].sid, workers) );
+				total += due.size();
+			}
+			CPPUNIT_ASSERT_EQUAL( sessions, total );
+
+			CPPUNIT_ASSERT( !scheduler.get_due(workers, 2000, due) );
+		}
+
+		void test_stats() {
+			refresh_scheduler scheduler;
+			mri_pathcoupled mri;
+
+			scheduler.schedule(uint128(0, 0, 0, 1), mri, 1000, 0);
+			scheduler.schedule(uint128(0, 0, 0, 2), mri, 1000, 0);
+			scheduler.count_pass(10, 4, 1, 250);
+			scheduler.count_pass(5, 5, 0, 50);
+
+			refresh_scheduler::stats_t stats = scheduler.get_stats();
+			CPPUNIT_ASSERT_EQUAL( (uint64) 2, stats.scheduled );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 2, stats.passes );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 15, stats.sent );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 9, stats.reduced );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 1, stats.stale );
+			CPPUNIT_ASSERT_EQUAL( (uint64) 300, stats.cpu_usec );
+		}
+
+		void test_sequence() {
+			refresh_scheduler scheduler;
+			mri_pathcoupled mri(hostaddress("10.0.0.1"), 32, hostaddress("10.0.0.2"), 32, true);
+			qos_nslp::qspec_object qspec;
+			NSLP_Flow_Context flow(mri, qspec);
+			std::vector<refresh_scheduler::entry_t> due;
+
+			CPPUNIT_ASSERT_EQUAL( 0U, flow.get_refresh_seq() );
+
+			// a flow rescheduled within the same second is refreshed once
+			scheduler.schedule(uint128(0, 0, 0, 1), mri, 1000, flow.next_refresh_seq());
+			scheduler.schedule(uint128(0, 0, 0, 1), mri, 1000, flow.next_refresh_seq());
+
+			CPPUNIT_ASSERT( scheduler.get_due(0, 1000, due) );
+			CPPUNIT_ASSERT_EQUAL( (size_t) 2, due.size() );
+			CPPUNIT_ASSERT( due[0].seq != flow.get_refresh_seq() );
+			CPPUNIT_ASSERT( due[1].seq == flow.get_refresh_seq() );
+		}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( test_refresh_scheduler );
+
+// EOF
@@ -0,0 +1,189 @@
+/*
+ * Test the sharded session context map.
+ *
+ * $Id$
+ * $HeadURL$
+ */
+#include "test_suite.h"
+
+#include <pthread.h>
+#include <vector>
+
+#include "nslp_session_context_map.h"
+
+using namespace qos_nslp;
+using namespace ntlp;
+
+
+namespace {
+
+const unsigned int threads = 8;
+const unsigned int sessions = 2000;
+
+struct churn_arg {
+	NSLP_Session_Context_Map *map;
+	NSLP_Session_Context *context;
+	unsigned int nr;
+	unsigned long misses;
+};
+
+mri_pathcoupled make_mri(const char *src) {
+	return mri_pathcoupled(hostaddress(src), 32, hostaddress("10.0.0.100"), 32, true);
+}
+
+/*
+ * Inserts, finds and erases sessions of its own, all of them with the
+ * same logical MRI as the sessions of the other threads.
+ */
+void *churn(void *p) {
+	churn_arg *arg = static_cast<churn_arg *>(p);
+	mri_pathcoupled mri = make_mri("10.0.0.1");
+
+	for (unsigned int i = 0; i < sessions; i++) {
+		sessionid sid(arg->nr, 0, 0, i);
+
+		arg->map->insert_session_context(sid, arg->context);
+		arg->map->insert_mri2context_map(sid, mri);
+		if ( arg->map->find_session_context(sid) != arg->context )
+			arg->misses++;
+		if ( i % 2 )
+			arg->map->erase(sid);
+	}
+
+	return NULL;
+}
+
+}
+
+
+class test_session_context_map : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( test_session_context_map );
+
+	CPPUNIT_TEST( test_sessions );
+	CPPUNIT_TEST( test_rii_hashmap );
+	CPPUNIT_TEST( test_mri_index );
+	CPPUNIT_TEST( test_concurrent );
+
+	CPPUNIT_TEST_SUITE_END();
+
+	public:
+		void test_sessions() {
+			NSLP_Session_Context_Map map(4);
+			NSLP_Session_Context c1(uint128(1, 2, 3, 4), NSLP_Session_Context::QNI, true);
+			NSLP_Session_Context c2(uint128(4, 3, 2, 1), NSLP_Session_Context::QNI, true);
+
+			CPPUNIT_ASSERT( map.find_session_context(sessionid(1, 2, 3, 4)) == NULL );
+			CPPUNIT_ASSERT( map.insert_session_context(sessionid(1, 2, 3, 4), &c1) );
+			CPPUNIT_ASSERT( !map.insert_session_context(sessionid(1, 2, 3, 4), &c2) );
+
+			// these two IDs have the same simple hash, but are different sessions
+			CPPUNIT_ASSERT( map.find_session_context(sessionid(4, 3, 2, 1)) == NULL );
+			CPPUNIT_ASSERT( map.insert_session_context(sessionid(4, 3, 2, 1), &c2) );
+
+			CPPUNIT_ASSERT( map.find_session_context(sessionid(1, 2, 3, 4)) == &c1 );
+			CPPUNIT_ASSERT( map.find_session_context(sessionid(4, 3, 2, 1)) == &c2 );
+
+			map.erase(sessionid(1, 2, 3, 4));
+			CPPUNIT_ASSERT( map.find_session_context(sessionid(1, 2, 3, 4)) == NULL );
+			CPPUNIT_ASSERT( map.find_session_context(sessionid(4, 3, 2, 1)) == &c2 );
+
+			// erasing an unknown session does nothing
+			map.erase(sessionid(1, 2, 3, 4));
+		}
+
+		void test_rii_hashmap() {
+			NSLP_Session_Context_Map map;
+			NSLP_Session_Context c(uint128(0, 0, 0, 1), NSLP_Session_Context::QNI, true);
+			rii r;
+			sessionid sid(0, 0, 0, 1);
+
+			// the RIIs of a session may be known before its context
+			NSLP_Session_Context_Map::riimap_t &riis = map.get_rii_hashmap(sid);
+			CPPUNIT_ASSERT( riis.empty() );
+			riis[7] = &r;
+			CPPUNIT_ASSERT( map.find_session_context(sid) == NULL );
+
+			CPPUNIT_ASSERT( map.insert_session_context(sid, &c) );
+			CPPUNIT_ASSERT( &map.get_rii_hashmap(sid) == &riis );
+			CPPUNIT_ASSERT( map.get_rii_hashmap(sid)[7] == &r );
+			CPPUNIT_ASSERT( map.get_rii_hashmap(sessionid(0, 0, 0, 2)).empty() );
+
+			// they go with the session
+			map.erase(sid);
+			CPPUNIT_ASSERT( map.get_rii_hashmap(sid).empty() );
+		}
+
+		void test_mri_index() {
+			NSLP_Session_Context_Map map;
+			NSLP_Session_Context c1(uint128(0, 0, 0, 1), NSLP_Session_Context::QNE, true);
+			NSLP_Session_Context c2(uint128(0, 0, 0, 2), NSLP_Session_Context::QNE, true);
+			NSLP_Session_Context_Map::search_context sc;
+			mri_pathcoupled mri = make_mri("10.0.0.1");
+
+			CPPUNIT_ASSERT( map.find_first(mri, sc) == NULL );
+			CPPUNIT_ASSERT( map.find_next(sc) == NULL );
+
+			map.insert_session_context(sessionid(0, 0, 0, 1), &c1);
+			map.insert_session_context(sessionid(0, 0, 0, 2), &c2);
+			map.insert_mri2context_map(sessionid(0, 0, 0, 1), mri);
+			map.insert_mri2context_map(sessionid(0, 0, 0, 2), mri);
+			map.insert_mri2context_map(sessionid(0, 0, 0, 1), mri);
+			map.insert_mri2context_map(sessionid(0, 0, 0, 1), make_mri("10.0.0.2"));
+
+			// both sessions are found, each of them once
+			NSLP_Session_Context *first = map.find_first(mri, sc);
+			NSLP_Session_Context *second = map.find_next(sc);
+			CPPUNIT_ASSERT( first != NULL && second != NULL && first != second );
+			CPPUNIT_ASSERT( map.find_next(sc) == NULL );
+
+			// ports and protocol are not part of the index
+			mri_pathcoupled flow(hostaddress("10.0.0.1"), 32, 1234,
+				hostaddress("10.0.0.100"), 32, 5000, "udp", 0, 0, 0, true);
+			CPPUNIT_ASSERT( map.find_first(flow, sc) != NULL );
+
+			map.erase(sessionid(0, 0, 0, 1));
+			CPPUNIT_ASSERT( map.find_first(mri, sc) == &c2 );
+			CPPUNIT_ASSERT( map.find_next(sc) == NULL );
+			CPPUNIT_ASSERT( map.find_first(make_mri("10.0.0.2"), sc) == NULL );
+
+			map.erase(sessionid(0, 0, 0, 2));
+			CPPUNIT_ASSERT( map.find_first(mri, sc) == NULL );
+		}
+
+		void test_concurrent() {
+			NSLP_Session_Context_Map map(4);
+			NSLP_Session_Context c(uint128(0, 0, 0, 1), NSLP_Session_Context::QNE, true);
+			NSLP_Session_Context_Map::search_context sc;
+			pthread_t tid[threads];
+			churn_arg args[threads];
+
+			for (unsigned int i = 0; i < threads; i++) {
+				args[i].map = &map;
+				args[i].context = &c;
+				args[i].nr = i + 1;
+				args[i].misses = 0;
+				pthread_create(&tid[i], NULL, churn, &args[i]);
+			}
+			for (unsigned int i = 0; i < threads; i++) {
+				pthread_join(tid[i], NULL);
+				CPPUNIT_ASSERT_EQUAL( 0UL, args[i].misses );
+			}
+
+			// the sessions not erased are all left in the index
+			unsigned int found = 0;
+			for (NSLP_Session_Context *ctx = map.find_first(make_mri("10.0.0.1"), sc);
+					ctx != NULL; ctx = map.find_next(sc))
+				found++;
+			CPPUNIT_ASSERT_EQUAL( threads * sessions / 2, found );
+
+			for (unsigned int i = 0; i < threads; i++)
+				for (unsigned int s = 0; s < sessions; s += 2)
+					CPPUNIT_ASSERT( map.find_session_context(sessionid(i + 1, 0, 0, s)) == &c );
+		}
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( test_session_context_map );
+
+// EOF
@@ -4,6 +4,7 @@
 #include "pdu_deserialize.h"
 #include "pdu_deserialize_with_hmac_check_in_ntlp.h"
 #include "measure_all.h"
+#include "hmac_throughput.h"
 #include <iostream>
 #include <cstdlib>
 
@@ -53,6 +54,9 @@ int main(int argc, char *argv[]) {
 
 	nslp_auth::pdu_deserialize_with_hmac_check_in_ntlp pdwhcinf(false);
 	pdwhcinf.run("Deserialize NTLPDATA_PDU (with AuthSessionObject & failed HMAC Check in NTLP)", num_runs);*/
+	nslp_auth::hmac_throughput ht(qspec_param_count);
+	ht.run("Sign and verify HMAC", num_runs);
+
 	nslp_auth::measure_all mall(keyid_count, qspec_param_count);
 	mall.run("Run all micro measurements", num_runs);
 
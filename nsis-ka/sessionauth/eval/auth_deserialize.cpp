@@ -20,13 +20,13 @@ auth_deserialize::auth_deserialize(bool do_Hmac)
 	auth_obj->serialize(*msg,protlib::IE::protocol_v1,bytes_written);
 	if(do_hmac) {
 		nslp_auth::sign_key_registry.storeKey(1, "123", 3, 2);
-		auth_session_object::serialize_hmac(*msg,protlib::IE::protocol_v1,true);
+		session_auth_object::serialize_hmac(*msg,protlib::IE::protocol_v1,true);
 	}
 	if(auth_obj->get_serialized_size(protlib::IE::protocol_v1) != bytes_written )
 		cout<<"Serialize Error because of unexpected size "<<endl;
 	delete auth_obj;
 	register_auth_attr_ies();
-	auth_obj = new auth_session_object();
+	auth_obj = new session_auth_object();
 }
 
 auth_deserialize::~auth_deserialize(){
@@ -43,7 +43,7 @@ void auth_deserialize::performTask(){
 	MP(benchmark_journal::POST_DESERIALIZE_SESSIONAUTH);
 	if(do_hmac) {
 		
-		if(!auth_session_object::check_hmac(*msg, IE::protocol_v1))
+		if(!session_auth_object::check_hmac(*msg, IE::protocol_v1))
 			cout<<"HMac failed"<<endl;
 	}
 	if( bytes_read != bytes_written )
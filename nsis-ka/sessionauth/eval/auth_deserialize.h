@@ -13,7 +13,7 @@ class auth_deserialize : public Benchmark {
 	virtual void performTask();
   
   private:	
-	auth_session_object* auth_obj;
+	session_auth_object* auth_obj;
 	NetMsg* msg;
 	uint32 bytes_written;
 	bool do_hmac;
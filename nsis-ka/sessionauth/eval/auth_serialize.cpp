@@ -32,8 +32,8 @@ void auth_serialize::performTask(){
 	auth_obj->serialize(*msg,protlib::IE::protocol_v1,bytes_written);
 	MP(benchmark_journal::POST_SERIALIZE_SESSIONAUTH);
 	if(do_hmac) {
-		auth_session_object::serialize_hmac(*msg,protlib::IE::protocol_v1,true);
-		if(!auth_session_object::check_hmac(*msg, IE::protocol_v1))
+		session_auth_object::serialize_hmac(*msg,protlib::IE::protocol_v1,true);
+		if(!session_auth_object::check_hmac(*msg, IE::protocol_v1))
 			cout<<"HMac failed"<<endl;
 	}
 	if(auth_obj->get_serialized_size(protlib::IE::protocol_v1) != bytes_written )
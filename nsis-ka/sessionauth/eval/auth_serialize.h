@@ -13,7 +13,7 @@ class auth_serialize : public Benchmark {
 	virtual void performTask();
   
   private:	
-	auth_session_object* auth_obj;
+	session_auth_object* auth_obj;
 	NetMsg* msg;
 	bool do_hmac;
 };
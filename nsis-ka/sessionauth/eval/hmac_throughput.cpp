@@ -0,0 +1,77 @@
+#include "hmac_throughput.h"
+#include <iostream>
+#include <sys/time.h>
+#include "session_auth_object.h"
+
+
+namespace nslp_auth {
+  using namespace std;
+
+static double now() {
+	struct timeval tp;
+	gettimeofday(&tp, NULL);
+	return tp.tv_sec + tp.tv_usec / 1E6;
+}
+
+hmac_throughput::hmac_throughput(uint16 qspec_param_count)
+	: data_pdu(create_NTLP_PDU(true, 1, true, qspec_param_count)), msg(new protlib::NetMsg(20000)), failures(0)
+{
+	register_NTLP_ies();
+
+	uint32 bytes_written = 0;
+	data_pdu->serialize(*msg,protlib::IE::protocol_v1,bytes_written);
+
+	// the TLP list is filled once, as GIST does for a received PDU
+	msg->set_pos(0);
+	if ( !session_auth_object::serialize_hmac(*msg, protlib::IE::protocol_v1, true) )
+		failures++;
+}
+
+hmac_throughput::~hmac_throughput() {
+	delete data_pdu;
+	delete msg;
+}
+
+void hmac_throughput::sign() {
+	msg->set_pos(0);
+	if ( !session_auth_object::serialize_hmac(*msg, protlib::IE::protocol_v1, false) )
+		failures++;
+}
+
+void hmac_throughput::verify() {
+	msg->set_pos(0);
+	if ( !session_auth_object::check_hmac(*msg, protlib::IE::protocol_v1, false) )
+		failures++;
+}
+
+void hmac_throughput::performTask() {
+	sign();
+	verify();
+}
+
+/**
+ * Run the benchmark: @a num_times signs, then @a num_times verifies.
+ */
+void hmac_throughput::run(const std::string &name, unsigned long num_times) {
+	cout << "Running benchmark '" << name << "' ("
+		<< num_times << " iterations) ...\n";
+
+	double start = now();
+	for ( unsigned long i = 0; i < num_times; i++ )
+		sign();
+	double sign_time = now() - start;
+
+	start = now();
+	for ( unsigned long i = 0; i < num_times; i++ )
+		verify();
+	double verify_time = now() - start;
+
+	cout << "PDU length: " << data_pdu->get_serialized_size(protlib::IE::protocol_v1) << " bytes\n";
+	cout << "Signs per second: " << (unsigned long) (num_times / sign_time) << "\n";
+	cout << "Verifies per second: " << (unsigned long) (num_times / verify_time) << "\n";
+	if ( failures )
+		cout << "Error: " << failures << " signs or verifies failed\n";
+	cout << "\n";
+}
+
+}
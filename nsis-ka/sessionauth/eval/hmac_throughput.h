@@ -0,0 +1,31 @@
+#include "utils.h"
+#include "Benchmark.h"
+#include "data.h"
+
+namespace nslp_auth {
+
+/*
+ * Signs and verifies the HMAC of one PDU over and over, the signs and
+ * the verifies are timed separately.
+ */
+class hmac_throughput : public Benchmark {
+
+  public:
+	hmac_throughput(uint16 qspec_param_count=1);
+	~hmac_throughput();
+
+	virtual void run(const std::string &name, unsigned long num_times);
+
+  protected:
+	virtual void performTask();
+
+  private:
+	void sign();
+	void verify();
+
+	ntlp::data* data_pdu;
+	NetMsg* msg;
+	unsigned long failures;
+};
+
+}
@@ -44,7 +44,7 @@ void measure_all::performTask() {
 	IEErrorList err;
 	
 	MP(benchmark_journal::PRE_HMAC_CREATE);
-	auth_session_object::serialize_hmac(*msg, protlib::IE::protocol_v1);
+	session_auth_object::serialize_hmac(*msg, protlib::IE::protocol_v1);
 	MP(benchmark_journal::POST_HMAC_CREATE);
 	
 	msg->set_pos(0);
@@ -55,17 +55,17 @@ void measure_all::performTask() {
 	
 	msg->set_pos(0);
 	MP(benchmark_journal::PRE_HMAC_VERIFY);
-	auth_session_object::check_hmac(*msg, protlib::IE::protocol_v1,false);
+	session_auth_object::check_hmac(*msg, protlib::IE::protocol_v1,false);
 	MP(benchmark_journal::POST_HMAC_VERIFY);
 /*
-	const TLP_list::position_list_t *entry = msg->get_TLP_list()->get_list(ntlp::ntlp_pdu::tlplist_nslp_object_type,nslp_auth::auth_session_object::NSLP_TYPE);
+	const TLP_list::position_list_t *entry = msg->get_TLP_list()->get_list(ntlp::ntlp_pdu::tlplist_nslp_object_type,nslp_auth::session_auth_object::NSLP_TYPE);
 	uint8 *in_hmac = msg->get_buffer() + entry->front() + ntlp::ntlp_object::getLengthFromTLVHeader(msg->get_buffer()+entry->front()) - 10;
 	if(*in_hmac) *in_hmac = 0;
 	else *in_hmac = 1;
 */
 	msg->set_pos(0);
 	MP(benchmark_journal::PRE_DESERIALIZE_NTLP_HMAC_FAIL);
-	auth_session_object::check_hmac(*msg, protlib::IE::protocol_v1,true);
+	session_auth_object::check_hmac(*msg, protlib::IE::protocol_v1,true);
 //	ie = ntlp::NTLP_IEManager::instance()->deserialize(*msg, ntlp::NTLP_IE::cat_known_pdu, protlib::IE::protocol_v1, err, bytes_read, false);
 	MP(benchmark_journal::POST_DESERIALIZE_NTLP_HMAC_FAIL);
 //	delete ie; // unnecessary
@@ -14,8 +14,8 @@ pdu_deserialize_ntlp_hmac_check::pdu_deserialize_ntlp_hmac_check(bool hmac_corre
 	if( bytes_written != expected_size )
 		cout<<"Error: unexpected pdu size"<<endl;
 	if(!hmac_correct){
-		uint32 auth_pos = *(msg->get_TLP_list()->get_list(ntlp::ntlp_pdu::tlplist_nslp_object_type, auth_session_object::NSLP_TYPE)->begin());
-		uint32 hmac_pos = data_pdu->get_serialized_size(IE::protocol_v1) - auth_session_object::HMAC_size;
+		uint32 auth_pos = *(msg->get_TLP_list()->get_list(ntlp::ntlp_pdu::tlplist_nslp_object_type, session_auth_object::NSLP_TYPE)->begin());
+		uint32 hmac_pos = data_pdu->get_serialized_size(IE::protocol_v1) - session_auth_object::HMAC_size;
   		// set hmac wrong
   		msg->get_buffer()[hmac_pos+8]=0;
 	}
@@ -14,7 +14,7 @@ pdu_deserialize_with_hmac_check_in_ntlp::pdu_deserialize_with_hmac_check_in_ntlp
 	if( bytes_written != expected_size )
 		cout<<"Error: unexpected pdu size"<<endl;
 	if(!hmac_correct){
-		uint32 hmac_pos = data_pdu->get_serialized_size(IE::protocol_v1) - auth_session_object::HMAC_size;
+		uint32 hmac_pos = data_pdu->get_serialized_size(IE::protocol_v1) - session_auth_object::HMAC_size;
   		// set hmac wrong
   		msg->get_buffer()[hmac_pos+8]=0;
 	}
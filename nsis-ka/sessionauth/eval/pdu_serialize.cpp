@@ -8,8 +8,8 @@ namespace nslp_auth {
 
 extern class benchmark_journal journal;
 
-pdu_serialize::pdu_serialize(bool auth_session_object) 
-	: expected_size(0), data_pdu(create_NTLP_PDU(auth_session_object)), msg(new protlib::NetMsg(1000)) 
+pdu_serialize::pdu_serialize(bool session_auth_object) 
+	: expected_size(0), data_pdu(create_NTLP_PDU(session_auth_object)), msg(new protlib::NetMsg(1000)) 
 {
 	expected_size = data_pdu->get_serialized_size(protlib::IE::protocol_v1);
 }
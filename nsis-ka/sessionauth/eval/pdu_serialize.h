@@ -7,7 +7,7 @@ namespace nslp_auth {
 class pdu_serialize : public Benchmark {
 
   public:
-	pdu_serialize(bool auth_session_object);
+	pdu_serialize(bool session_auth_object);
 	~pdu_serialize();
 
   protected:
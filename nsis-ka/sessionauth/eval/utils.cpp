@@ -29,7 +29,7 @@ using namespace qspec;
 
 extern class benchmark_journal journal;
 
-auth_session_object* createAuthObj(uint32 keyid) {
+session_auth_object* createAuthObj(uint32 keyid) {
 		auth_attr_addr *a1 = new auth_attr_addr(DEST_ADDR,IPV4_ADDRESS);
 
 		hostaddress ip("192.168.2.1");
@@ -40,10 +40,10 @@ auth_session_object* createAuthObj(uint32 keyid) {
 
 		auth_attr_data *a3 = new auth_attr_data();
 		a3->set_key_id(keyid);
-		uint8* hmac = new uint8[auth_session_object::HMAC_size];
+		uint8* hmac = new uint8[session_auth_object::HMAC_size];
 		// use memset to zero all bytes in the HMAC (this will be faster than an explicit for loop)
-		memset(hmac, auth_session_object::HMAC_size, 0);
-		a3->set_hmac(hmac, auth_session_object::HMAC_size);
+		memset(hmac, session_auth_object::HMAC_size, 0);
+		a3->set_hmac(hmac, session_auth_object::HMAC_size);
 
 		auth_attr_hmac_trans_id *a4 = new auth_attr_hmac_trans_id();
 		a4->set_id(2);
@@ -62,9 +62,9 @@ auth_session_object* createAuthObj(uint32 keyid) {
 		a7->set_value(time(NULL)+6000);
 
 		auth_nslp_object_list *a8 = new auth_nslp_object_list();
-		a8->insert(known_nslp_object::AUTH_SESSION);
+		a8->insert(known_nslp_object::SESSION_AUTH_OBJECT);
 
-		auth_session_object *auth_obj = new auth_session_object();
+		session_auth_object *auth_obj = new session_auth_object();
 		auth_obj->insert_attr(a1);
 		auth_obj->insert_attr(a2);
 		auth_obj->insert_attr(a3);
@@ -77,7 +77,7 @@ auth_session_object* createAuthObj(uint32 keyid) {
 		return auth_obj;
 }
 
-auth_session_object* createAuthObj() {
+session_auth_object* createAuthObj() {
 	return createAuthObj(1);
 }
 
@@ -96,13 +96,13 @@ qos_nslp::reservereq* create_NSLP_PDU(bool with_sessionauth, uint32 keyid, bool
 
 	if (with_sessionauth)
 	{
-		auth_session_object *p1 = createAuthObj(keyid);
+		session_auth_object *p1 = createAuthObj(keyid);
 		auth_nslp_object_list *nslp_obj_list =dynamic_cast<auth_nslp_object_list*>(p1->get_attr(AUTH_NSLP_OBJECT_LIST, 0));
 		nslp_obj_list->insert(known_nslp_object::RII);
 		nslp_obj_list->insert(known_nslp_object::RSN);
 		nslp_obj_list->insert(known_nslp_object::PACKET_CLASSIFIER);
 		nslp_obj_list->insert(known_nslp_object::QSPEC);
-		new_res->set_authsession(p1);
+		new_res->set_sessionauth_hmac_signed(p1);
 	}
     
   packet_classifier* new_pc = new packet_classifier();
@@ -1,11 +1,11 @@
-#include "auth_session_object.h"
+#include "session_auth_object.h"
 #include "data.h"
 #include "reservemsg.h"
 
 namespace nslp_auth {
 
-auth_session_object* createAuthObj(uint32 keyid);
-auth_session_object* createAuthObj();
+session_auth_object* createAuthObj(uint32 keyid);
+session_auth_object* createAuthObj();
 ntlp::data* create_NTLP_PDU(bool with_sessionauth, uint32 keyid, bool storekey, uint16 qspec_param_count);
 ntlp::data* create_NTLP_PDU(bool with_sessionauth);
 qos_nslp::reservereq* create_NSLP_PDU(bool with_sessionauth, uint32 keyid, bool storekey, uint16 qspec_param_count);
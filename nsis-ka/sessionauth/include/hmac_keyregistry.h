@@ -3,6 +3,9 @@
 
 #include "protlib_types.h"
 #include <string.h>
+#include <pthread.h>
+
+#include <openssl/evp.h>
 
 #include "hashmap"
 
@@ -13,38 +16,79 @@ namespace nslp_auth {
 typedef uint32 key_id_t;
 
 class signkey_context {
- 
+
  public:
- signkey_context() : sign_key(0), sign_keylen(0), hash_algo(0) {};
-  
- signkey_context(uchar *sign_key, uint16 sign_keylen, uint16 hash_algo) : sign_key(sign_key), sign_keylen(sign_keylen), hash_algo(hash_algo) {};
-  ~signkey_context() { delete sign_key; }
+ signkey_context() : sign_key(0), sign_keylen(0), hash_algo(0), inner(0), outer(0) {};
+
+ signkey_context(uchar *sign_key, uint16 sign_keylen, uint16 hash_algo);
+  ~signkey_context();
 
  const uchar* getKey() const { return sign_key; }
  uint16 getKeyLen() const { return sign_keylen; }
 
+ /// HMAC contexts after hashing key^ipad and key^opad
+ const EVP_MD_CTX* getInner() const { return inner; }
+ const EVP_MD_CTX* getOuter() const { return outer; }
+
  private:
     uchar *sign_key;
     uint16 sign_keylen;
     uint16 hash_algo;
+    EVP_MD_CTX* inner;
+    EVP_MD_CTX* outer;
+
+    // not copyable
+    signkey_context(const signkey_context&);
+    signkey_context& operator=(const signkey_context&);
 };
 
-class hmac_keyregistry 
+/**
+ * Keys for HMAC signed session authorization objects. For every key the
+ * HMAC key schedule is done once when it is stored, signing and verifying
+ * start from the saved states. Any number of threads may compute HMACs
+ * while keys are stored or deleted.
+ */
+class hmac_keyregistry
 {
  public:
 
   typedef hashmap_t<key_id_t, signkey_context*> keyregistry_t;
 
+  /// a range of bytes covered by an HMAC
+  struct hmac_range_t {
+    const uchar* data;
+    uint32 len;
+  };
+
+  hmac_keyregistry();
+  ~hmac_keyregistry();
+
   void storeKey(key_id_t key_id, const void* key, uint16 keylen, uint16 mdalgo= default_hash_algo);
+  /// the returned pointers are only valid until the key is stored again or deleted
   const uchar* getKey(key_id_t key_id) const;
   const signkey_context* getKeyContext(key_id_t key_id) const;
   void deleteKey(key_id_t key_id);
 
+  /// HMAC of the ranges (in the given order) with key key_id into out, EVP_MAX_MD_SIZE byte suffice
+  /// @return false if there is no key key_id
+  bool computeHMAC(key_id_t key_id, const hmac_range_t* ranges, uint32 count, uchar* out, uint32* outlen= NULL) const;
+
  private:
   keyregistry_t key_registry;
 
+  /// taken for reading to look up keys and compute HMACs, for writing to change keys
+  mutable pthread_rwlock_t lock;
+
+  /// per thread EVP_MD_CTX, avoids an allocation per HMAC
+  pthread_key_t ctx_key;
+
+  EVP_MD_CTX* get_ctx() const;
+
   static const uint16 default_hash_algo;
 
+  // not copyable
+  hmac_keyregistry(const hmac_keyregistry&);
+  hmac_keyregistry& operator=(const hmac_keyregistry&);
 };
 
 // this is a singleton
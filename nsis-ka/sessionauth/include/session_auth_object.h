@@ -99,8 +99,12 @@ public:
   	static bool serialize_hmac(NetMsg &msg, coding_t coding, bool fill_data=false);
   	static uint16 get_tlplist_nslp_object_type(const uint8* buf);
   	static uint16 get_tlplist_ntlp_object_type(const uint8* buf);  	
+  	/// maximum number of objects an HMAC covers
+  	static const uint32 max_hmac_objects = 64;
   private:
-  	static bool calc_HMAC(NetMsg &msg, uint8*& msg_digest, nslp_auth::auth_attr_data*& auth_data, uint32 auth_pos, coding_t coding);
+  	/// outcome of calc_HMAC()
+  	enum hmac_result_t { hmac_not_signed, hmac_ok, hmac_error };
+  	static hmac_result_t calc_HMAC(NetMsg &msg, uint8* msg_digest, uint32& hmac_pos, uint32 auth_pos, coding_t coding);
 
 
 };
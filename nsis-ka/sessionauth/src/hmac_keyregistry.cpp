@@ -1,6 +1,16 @@
+#include <cstdlib>
+#include <vector>
+
+#include <openssl/crypto.h>
+
 #include "hmac_keyregistry.h"
 #include "session_auth_object.h"
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_new EVP_MD_CTX_create
+#define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#endif
+
 namespace nslp_auth {
 
 // global repository holding signing keys
@@ -8,6 +18,102 @@ hmac_keyregistry sign_key_registry;
 
 const uint16 hmac_keyregistry::default_hash_algo= session_auth_object::TRANS_ID_AUTH_HMAC_SHA1_96;
 
+
+namespace {
+
+/// free the scratch context of a terminating thread
+void free_thread_ctx(void* ctx)
+{
+  EVP_MD_CTX_free(static_cast<EVP_MD_CTX*>(ctx));
+}
+
+} // end anonymous namespace
+
+
+/**
+ * takes over sign_key and prepares the HMAC states for it
+ * (always HMAC-SHA1, the only transform supported so far)
+ */
+signkey_context::signkey_context(uchar *sign_key, uint16 sign_keylen, uint16 hash_algo)
+  : sign_key(sign_key), sign_keylen(sign_keylen), hash_algo(hash_algo),
+    inner(EVP_MD_CTX_new()), outer(EVP_MD_CTX_new())
+{
+  const EVP_MD* md= EVP_sha1();
+
+  // RFC 2104: keys longer than a block are hashed first
+  uint32 blocksize= EVP_MD_block_size(md);
+  std::vector<uchar> pad(blocksize, 0);
+  if (sign_keylen > blocksize)
+    EVP_Digest(sign_key, sign_keylen, &pad[0], NULL, md, NULL);
+  else
+    memcpy(&pad[0], sign_key, sign_keylen);
+
+  for (uint32 i= 0; i < blocksize; i++)
+    pad[i]^= 0x36;
+  EVP_DigestInit_ex(inner, md, NULL);
+  EVP_DigestUpdate(inner, &pad[0], blocksize);
+
+  for (uint32 i= 0; i < blocksize; i++)
+    pad[i]^= 0x36 ^ 0x5c;
+  EVP_DigestInit_ex(outer, md, NULL);
+  EVP_DigestUpdate(outer, &pad[0], blocksize);
+
+  OPENSSL_cleanse(&pad[0], blocksize);
+}
+
+
+signkey_context::~signkey_context()
+{
+  if (inner)
+    EVP_MD_CTX_free(inner);
+  if (outer)
+    EVP_MD_CTX_free(outer);
+  // don't leave copies of the key behind
+  if (sign_key)
+    OPENSSL_cleanse(sign_key, sign_keylen);
+  delete[] sign_key;
+}
+
+
+hmac_keyregistry::hmac_keyregistry()
+{
+  pthread_rwlock_init(&lock, NULL);
+  if (pthread_key_create(&ctx_key, free_thread_ctx) != 0)
+    abort();
+}
+
+
+hmac_keyregistry::~hmac_keyregistry()
+{
+  // contexts of other threads are freed when these terminate
+  EVP_MD_CTX* ctx= static_cast<EVP_MD_CTX*>(pthread_getspecific(ctx_key));
+  if (ctx)
+  {
+    pthread_setspecific(ctx_key, NULL);
+    EVP_MD_CTX_free(ctx);
+  }
+  pthread_key_delete(ctx_key);
+
+  for (keyregistry_t::iterator hm_iter= key_registry.begin(); hm_iter != key_registry.end(); ++hm_iter)
+    delete (*hm_iter).second;
+
+  pthread_rwlock_destroy(&lock);
+}
+
+
+EVP_MD_CTX*
+hmac_keyregistry::get_ctx() const
+{
+  EVP_MD_CTX* ctx= static_cast<EVP_MD_CTX*>(pthread_getspecific(ctx_key));
+  if (ctx == NULL)
+  {
+    ctx= EVP_MD_CTX_new();
+    pthread_setspecific(ctx_key, ctx);
+  }
+  return ctx;
+}
+
+
 /**
  * this function stores or updates an existing key
  *
@@ -15,58 +121,111 @@ const uint16 hmac_keyregistry::default_hash_algo= session_auth_object::TRANS_ID_
 void
 hmac_keyregistry::storeKey(key_id_t key_id, const void* key, uint16 keylen, uint16 algo)
 {
-  // if key already found, delete the key
-  deleteKey(key_id);
-  // store key under key id
+  // store key under key id, the key schedule is done outside of the lock
   uchar* keydata= new uchar[keylen];
   memcpy(keydata, key, keylen);
 
   signkey_context* keycontext_p= new signkey_context(keydata, keylen, algo);
-  key_registry[key_id]= keycontext_p;
+  signkey_context* old_p= NULL;
+
+  pthread_rwlock_wrlock(&lock);
+  signkey_context*& entry= key_registry[key_id];
+  old_p= entry;
+  entry= keycontext_p;
+  pthread_rwlock_unlock(&lock);
+
+  // if key already found, delete the old key
+  delete old_p;
 }
 
 
 const signkey_context*
 hmac_keyregistry::getKeyContext(key_id_t key_id) const
 {
+  const signkey_context* keycontext_p= NULL;
   keyregistry_t::const_iterator hm_iter;
 
+  pthread_rwlock_rdlock(&lock);
   hm_iter= key_registry.find(key_id);
   if ( hm_iter != key_registry.end() )
   {
-    return (*hm_iter).second;
+    keycontext_p= (*hm_iter).second;
   }
-  else // not found
-    return NULL;
+  pthread_rwlock_unlock(&lock);
+
+  return keycontext_p;
 }
 
 
-const uchar* 
+const uchar*
 hmac_keyregistry::getKey(key_id_t key_id) const
 {
-  keyregistry_t::const_iterator hm_iter;
+  const signkey_context* keycontext_p= getKeyContext(key_id);
 
-  hm_iter= key_registry.find(key_id);
-  if ( hm_iter != key_registry.end() && ((*hm_iter).second) != NULL )
-  {    
-    return ((*hm_iter).second)->getKey();
-  }
-  else // not found
-    return NULL;
+  return keycontext_p ? keycontext_p->getKey() : NULL;
 }
 
 
 void
 hmac_keyregistry::deleteKey(key_id_t key_id)
 {
+  signkey_context* old_p= NULL;
   keyregistry_t::iterator hm_iter;
 
+  pthread_rwlock_wrlock(&lock);
   hm_iter= key_registry.find(key_id);
   if ( hm_iter != key_registry.end() )
   {
-    delete (*hm_iter).second;
-    (*hm_iter).second= NULL;
-  }  
+    old_p= (*hm_iter).second;
+    key_registry.erase(hm_iter);
+  }
+  pthread_rwlock_unlock(&lock);
+
+  delete old_p;
+}
+
+
+/**
+ * computes H(key^opad, H(key^ipad, ranges)) starting from the states saved
+ * with the key, the ranges are hashed where they are
+ * @param outlen -- if not NULL, receives the length of the HMAC
+ */
+bool
+hmac_keyregistry::computeHMAC(key_id_t key_id, const hmac_range_t* ranges, uint32 count, uchar* out, uint32* outlen) const
+{
+  EVP_MD_CTX* ctx= get_ctx();
+  uchar inner_md[EVP_MAX_MD_SIZE];
+  unsigned int inner_len= 0;
+  unsigned int out_len= 0;
+
+  // the key must not go away while its states are used
+  pthread_rwlock_rdlock(&lock);
+
+  keyregistry_t::const_iterator hm_iter= key_registry.find(key_id);
+  if ( hm_iter == key_registry.end() || (*hm_iter).second == NULL )
+  {
+    pthread_rwlock_unlock(&lock);
+    return false;
+  }
+  const signkey_context* keycontext_p= (*hm_iter).second;
+
+  EVP_MD_CTX_copy_ex(ctx, keycontext_p->getInner());
+  for (uint32 i= 0; i < count; i++)
+    EVP_DigestUpdate(ctx, ranges[i].data, ranges[i].len);
+  EVP_DigestFinal_ex(ctx, inner_md, &inner_len);
+
+  EVP_MD_CTX_copy_ex(ctx, keycontext_p->getOuter());
+
+  pthread_rwlock_unlock(&lock);
+
+  EVP_DigestUpdate(ctx, inner_md, inner_len);
+  EVP_DigestFinal_ex(ctx, out, &out_len);
+
+  OPENSSL_cleanse(inner_md, sizeof(inner_md));
+  if (outlen)
+    *outlen= out_len;
+
+  return true;
 }
 
 } // end namespace
@@ -9,7 +9,8 @@
 extern "C"
 {
 // hashing functions from OpenSSL
-#include <openssl/hmac.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
 }
 
 //ToDo: hmac error derived from protlib::IEError 
@@ -37,6 +38,8 @@ const size_t session_auth_object::HMAC_size = EVP_MD_size(EVP_sha1());
 
 const uint16 session_auth_object::TRANS_ID_AUTH_HMAC_SHA1_96= 2;
 
+const uint32 session_auth_object::max_hmac_objects;
+
 
 /**
  * Extract the Length.
@@ -587,28 +590,27 @@ bool session_auth_object::check_hmac(NetMsg &msg, coding_t coding, bool fill_dat
 
 		TLP_list::position_list_t::const_iterator auth_it = auth_list->begin();	
 		while(auth_it != auth_list->end()) {
-			uint8 *msg_digest = NULL;
-			auth_attr_data* auth_data = NULL;
-			if(!calc_HMAC(msg,msg_digest,auth_data,*auth_it,coding)) 
+			uint8 msg_digest[EVP_MAX_MD_SIZE];
+			uint32 hmac_pos = 0;
+			hmac_result_t result = calc_HMAC(msg,msg_digest,hmac_pos,*auth_it,coding);
+			if (result == hmac_not_signed)
+			{
+				// ignore this session auth object since it is not of type HMAC signed
+				auth_it++;
+				continue;
+			}
+			if (result == hmac_error)
 			{
-				if (msg_digest == NULL && auth_data == NULL)
-				{
-					// ignore this session auth object since it is not of type HMAC signed
-					auth_it++;
-					continue;
-				}
-
 				DLog("session_auth_obj", "error occured during HMAC calculation");
 
+				msg.set_pos(saved_pos);
 				return false;
 			}
 
-			// compare hmacs
-			const uint8* other_mac = auth_data->get_hmac();
-	  		if( memcmp(msg_digest, other_mac, session_auth_object::HMAC_size) != 0 ) {
+			// compare hmacs, in constant time
+			const uint8* other_mac = msg.get_buffer() + hmac_pos;
+	  		if( CRYPTO_memcmp(msg_digest, other_mac, session_auth_object::HMAC_size) != 0 ) {
 	  			msg.set_pos(saved_pos);
-				delete msg_digest;			
-				delete auth_data;
 
 				DLog("session_auth_obj", "HMAC comparison failed");
 
@@ -617,8 +619,6 @@ bool session_auth_object::check_hmac(NetMsg &msg, coding_t coding, bool fill_dat
 			else
 			  DLog("session_auth_obj", color[green] << "HMAC succesfully verified" << color[off]);
 
-			delete msg_digest;			
-			delete auth_data;
 			auth_it++;
 		} // end while AuthObj_type in linked list
 
@@ -632,179 +632,194 @@ bool session_auth_object::check_hmac(NetMsg &msg, coding_t coding, bool fill_dat
 	return true;
 } 
 
-// auth_data and msg_digest will be allocated, but not destroyed in this function
-bool session_auth_object::calc_HMAC(NetMsg &msg, uint8*& msg_digest, auth_attr_data*& auth_data, uint32 auth_pos, coding_t coding) {
+/**
+ * Calculates the HMAC of an HMAC signed session authorization object. The
+ * covered objects are hashed in place in msg, nothing is copied or allocated.
+ * @param msg_digest -- receives the HMAC (HMAC_size byte)
+ * @param hmac_pos -- receives the position of the HMAC carried in the
+ * AUTHENTICATION_DATA attribute
+ * @param auth_pos -- position of the session authorization object in msg
+ * @return hmac_ok if the HMAC was calculated, hmac_not_signed if the object
+ * is well-formed but not HMAC signed, hmac_error if the object is malformed
+ * or the HMAC cannot be calculated (the message must be rejected then)
+ */
+session_auth_object::hmac_result_t
+session_auth_object::calc_HMAC(NetMsg &msg, uint8* msg_digest, uint32& hmac_pos, uint32 auth_pos, coding_t coding) {
 	//DLog("session_auth_obj","calc_HMAC() start - msglen:" << msg.get_size() << ", authpos=" << auth_pos);
 
-	delete msg_digest;
-	msg_digest = NULL;
-	delete auth_data;
-	auth_data = NULL;
+	hmac_pos = 0;
 	TLP_list* tlp = msg.get_TLP_list();
-	
-	auth_attr_hmac_trans_id* transId= NULL;
-	auth_nslp_object_list* obj_list = NULL;
+	const uint8* buf = msg.get_buffer();
+
+	// positions of the attributes needed, read in place
+	uint32 trans_id_pos = 0, obj_list_pos = 0, auth_data_pos = 0;
+	uint16 obj_list_count = 0, auth_data_len = 0;
 	msg.set_pos(auth_pos+2);
 	uint32 auth_obj_len=msg.decode16()& 0xFFF; // in words
 	uint32 obj_end_pos = auth_pos + 4*auth_obj_len + session_auth_object::HEADER_LENGTH; // in bytes
+	if (obj_end_pos > msg.get_size()) {
+		ERRCLog("ntlp_pdu::auth_hmac_check::check_hmac", "session authorization object exceeds the message");
+		return hmac_error;
+	}
 
-	while( msg.get_pos() < obj_end_pos) {
-
+	while( msg.get_pos() + 4 <= obj_end_pos) {
+		uint32 attr_pos = msg.get_pos();
 		uint16 tmp_len= msg.decode16(); // does not contain padding
 		uint16 tmp_attr_len= round_up4(tmp_len);
 		uint8 attr_xtype,attr_subtype;
 		attr_xtype = msg.decode8();
 		attr_subtype = msg.decode8();
-		if( attr_xtype==AUTH_ENT_ID  && attr_subtype==subtype_auth_ent_hmac_signed ){
-			msg.set_pos_r(-4);
-			transId = new auth_attr_hmac_trans_id();
-			uint32 attr_bytes_read = 0;
-			IEErrorList err;
-			transId->deserialize(msg, coding, err, attr_bytes_read, false);
-			msg.set_pos_r(-attr_bytes_read+4);
-
+		if (tmp_len < 4 || attr_pos + tmp_len > obj_end_pos) {
+			ERRCLog("ntlp_pdu::auth_hmac_check::check_hmac", "malformed attribute in session authorization object");
+			return hmac_error;
 		}
-		if( attr_xtype==AUTH_NSLP_OBJECT_LIST && attr_subtype==0 ){
-			msg.set_pos_r(-4);
-			obj_list = new auth_nslp_object_list();
-			uint32 attr_bytes_read = 0;
-			IEErrorList err;
-			obj_list->deserialize(msg, coding, err, attr_bytes_read, false);
-			msg.set_pos_r(-attr_bytes_read+4);
-
+		if( attr_xtype==AUTH_ENT_ID  && attr_subtype==subtype_auth_ent_hmac_signed && tmp_len >= 8 )
+			trans_id_pos = attr_pos;
+		if( attr_xtype==AUTH_NSLP_OBJECT_LIST && attr_subtype==0 && tmp_len >= 6 ){
+			obj_list_pos = attr_pos;
+			obj_list_count = msg.decode16();
+			if (6 + 2*(uint32)obj_list_count > tmp_len)
+				obj_list_count = (tmp_len - 6) / 2;
+			msg.set_pos_r(-2);
 		}
-		if( attr_xtype==AUTHENTICATION_DATA && attr_subtype==0 ){
-			msg.set_pos_r(-4);
-			auth_data = new auth_attr_data();
-			uint32 attr_bytes_read = 0;
-			IEErrorList err;
-			auth_data->deserialize(msg, coding, err, attr_bytes_read, false);
-			msg.set_pos_r(-attr_bytes_read+4);
+		if( attr_xtype==AUTHENTICATION_DATA && attr_subtype==0 && tmp_len >= 8 ){
+			auth_data_pos = attr_pos;
+			auth_data_len = tmp_len;
 		}
 		msg.set_pos_r(tmp_attr_len-4);
 	}
 
-	if (!transId) {
+	if (!trans_id_pos) {
 		DLog("ntlp_pdu::auth_hmac_check::check_hmac","not an HMAC signed session authorization object - ignoring");
-		delete obj_list;
-		delete auth_data;
-		auth_data=NULL;
-		return false;
+		return hmac_not_signed;
 	}
 
-		
 	// check conditions
-	if( !(transId && auth_data) || (obj_list && !auth_data) ) {
+	if( !auth_data_pos ) {
 		ERRCLog("ntlp_pdu::auth_hmac_check::check_hmac", "hmac conditions failed");
-		delete transId;
-		delete obj_list;
-		delete auth_data;
-		auth_data=NULL;
-		return false;
+		return hmac_error;
 	}
-	
-	// copy obj_types (pos and len)
-	vector<pair<uint32,uint32> > hmac_obj_types(0);
+
+	// collect the objects (pos and len)
+	pair<uint32,uint32> hmac_obj_types[max_hmac_objects];
+	uint32 hmac_obj_count = 0;
+	bool overflow = false;
 	const TLP_list::position_list_t *obj_pos_list;
 	TLP_list::position_list_t::const_iterator obj_entry;
-	if (obj_list) {	
-		vector<uint16>::const_iterator iter;
-		for(iter=obj_list->get_list().begin();iter!=obj_list->get_list().end();iter++) {
-			if(!(obj_pos_list=tlp->get_list(ntlp_pdu::tlplist_nslp_object_type,*iter))) {
-				ERRLog("ntlp_pdu::auth_hmac_check::check_hmac","Objtype not found in PDU, but in auth_nslp_obj_list");
-			} else {
-				if(((*iter)!=session_auth_object::NSLP_TYPE) && ((*iter)!= ntlp::known_ntlp_object::SessionID) && ((*iter)!=ntlp::known_ntlp_object::MRI)) {
-					obj_entry = obj_pos_list->begin();
-					while(obj_entry!=obj_pos_list->end()){
-						uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(msg.get_buffer()+*obj_entry);
-						hmac_obj_types.push_back(make_pair(*obj_entry,obj_length));
-						obj_entry++;
+	for (uint32 i = 0; i < obj_list_count; i++) {
+		msg.set_pos(obj_list_pos + 6 + 2*i);
+		uint16 obj_type = msg.decode16() & 0xFFF;
+		if(!(obj_pos_list=tlp->get_list(ntlp_pdu::tlplist_nslp_object_type,obj_type))) {
+			ERRLog("ntlp_pdu::auth_hmac_check::check_hmac","Objtype not found in PDU, but in auth_nslp_obj_list");
+		} else {
+			if((obj_type!=session_auth_object::NSLP_TYPE) && (obj_type!= ntlp::known_ntlp_object::SessionID) && (obj_type!=ntlp::known_ntlp_object::MRI)) {
+				for (obj_entry = obj_pos_list->begin(); obj_entry!=obj_pos_list->end(); obj_entry++) {
+					if (hmac_obj_count == max_hmac_objects) {
+						overflow = true;
+						break;
 					}
+					uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(buf+*obj_entry);
+					hmac_obj_types[hmac_obj_count++] = make_pair(*obj_entry,obj_length);
 				}
 			}
 		}
-	} // else there is no obj_list
-			
+	}
+
 	// even if there is no obj_list
 	// have to insert MRI, SessionId, AuthObj
 	// to include to hmac
 	if (!(obj_pos_list=tlp->get_list(ntlp_pdu::tlplist_ntlp_object_type,ntlp::known_ntlp_object::MRI))){
 		ERRLog("session_auth_object::check_hmac","MRI Object not found in PDU");
 	} else {
-		obj_entry = obj_pos_list->begin();
-		while(obj_entry!=obj_pos_list->end()){
-			uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(msg.get_buffer()+*obj_entry);
-			hmac_obj_types.push_back(make_pair(*obj_entry,obj_length));
-			obj_entry++;
+		for (obj_entry = obj_pos_list->begin(); obj_entry!=obj_pos_list->end() && !overflow; obj_entry++) {
+			if (hmac_obj_count == max_hmac_objects) {
+				overflow = true;
+				break;
+			}
+			uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(buf+*obj_entry);
+			hmac_obj_types[hmac_obj_count++] = make_pair(*obj_entry,obj_length);
 		}
 	}
 	if (!(obj_pos_list=tlp->get_list(ntlp_pdu::tlplist_ntlp_object_type,ntlp::known_ntlp_object::SessionID))){
 		ERRLog("session_auth_object::check_hmac","SessionID Object not found in PDU");
 	} else {
-		obj_entry = obj_pos_list->begin();
-		while(obj_entry!=obj_pos_list->end()){
-			uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(msg.get_buffer()+*obj_entry);
-			hmac_obj_types.push_back(make_pair(*obj_entry,obj_length));
-			obj_entry++;
+		for (obj_entry = obj_pos_list->begin(); obj_entry!=obj_pos_list->end() && !overflow; obj_entry++) {
+			if (hmac_obj_count == max_hmac_objects) {
+				overflow = true;
+				break;
+			}
+			uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(buf+*obj_entry);
+			hmac_obj_types[hmac_obj_count++] = make_pair(*obj_entry,obj_length);
 		}
 	}
 	if (!(obj_pos_list=tlp->get_list(ntlp_pdu::tlplist_nslp_object_type,NSLP_TYPE))){
-		ERRLog("session_auth_object::check_hmac","SessionAuth Object not found in PDU");	
+		ERRLog("session_auth_object::check_hmac","SessionAuth Object not found in PDU");
 	} else {
-		obj_entry = obj_pos_list->begin();
-		while(obj_entry!=obj_pos_list->end()){
-			uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(msg.get_buffer()+*obj_entry);
-			hmac_obj_types.push_back(make_pair(*obj_entry, obj_length-session_auth_object::HMAC_size));
-			obj_entry++;
+		for (obj_entry = obj_pos_list->begin(); obj_entry!=obj_pos_list->end() && !overflow; obj_entry++) {
+			if (hmac_obj_count == max_hmac_objects) {
+				overflow = true;
+				break;
+			}
+			uint32 obj_length = ntlp::ntlp_object::getLengthFromTLVHeader(buf+*obj_entry);
+			hmac_obj_types[hmac_obj_count++] = make_pair(*obj_entry, obj_length-session_auth_object::HMAC_size);
 		}
 	}
 
-	// sort obj_list (in order of msg_pos) 
+	if (overflow) {
+		ERRLog("session_auth_object::check_hmac","more than " << max_hmac_objects << " objects to be covered by the HMAC");
+		return hmac_error;
+	}
+
+	// sort obj_list (in order of msg_pos)
 	// operator<(pair,pair) is in utility defined (uses first element)
-	sort(hmac_obj_types.begin(),hmac_obj_types.end());
-			
-	// copy to buffer
-	uint8 *hmac_buffer  = new uint8[msg.get_size()];
-	msg.copy_to(hmac_buffer,4,2); // copy NSLPID
-  	uint32 hmac_bufferlen = 2;
-  	uint32 last_pos = 0; // to find duplicated obj_types
-  	vector<pair<uint32,uint32> >::iterator iter;
-	for(iter=hmac_obj_types.begin();iter!=hmac_obj_types.end();iter++) {
-		uint32 pos = iter->first;
-		uint32 len = iter->second;
+	sort(hmac_obj_types, hmac_obj_types + hmac_obj_count);
+
+	// the ranges to hash: NSLPID and the objects, each object once
+	hmac_keyregistry::hmac_range_t ranges[max_hmac_objects + 1];
+	ranges[0].data = buf + 4; // NSLPID
+	ranges[0].len = 2;
+	uint32 range_count = 1;
+	uint32 last_pos = 0; // to find duplicated obj_types
+	for (uint32 i = 0; i < hmac_obj_count; i++) {
+		uint32 pos = hmac_obj_types[i].first;
+		uint32 len = hmac_obj_types[i].second;
 		if(pos != last_pos) {
-			msg.copy_to(hmac_buffer+hmac_bufferlen,pos,len);
-			hmac_bufferlen+=len;
-		} // else this obj_type is already in the hmac_buffer 
+			if (pos + len > msg.get_size()) {
+				ERRLog("session_auth_object::check_hmac","object covered by the HMAC exceeds the message");
+				return hmac_error;
+			}
+			ranges[range_count].data = buf + pos;
+			ranges[range_count].len = len;
+			range_count++;
+		} // else this obj_type is already covered
 		last_pos = pos;
 	}
-#ifdef PRINT_HMAC_BUF_LEN
-    cout<<"HMAC buffer length (only used space) : "<<hmac_bufferlen<<endl;
-#endif
-			
+
 	// calc hmac
-  	const signkey_context* signkey_info= sign_key_registry.getKeyContext(auth_data->get_key_id());
-  	if (signkey_info)
-  	{
-	        DLog("session_auth_obj", "got key ID 0x" << hex << auth_data->get_key_id() << dec);
-		msg_digest= new unsigned char[session_auth_object::HMAC_size];
-		memset(msg_digest,0,session_auth_object::HMAC_size);
-		unsigned int mdlen= 0;
-		// TODO: translate transform ID to SSL algo
-		if ( transId->get_id() != TRANS_ID_AUTH_HMAC_SHA1_96 )
-		  ERRLog("session_auth_obj", "unsupported Integrity Algorithm Transform ID, using SHA-1 anyway");
-		// do the HMAC calculation
-		HMAC(EVP_sha1(), signkey_info->getKey(), signkey_info->getKeyLen(), hmac_buffer, hmac_bufferlen, msg_digest, &mdlen);
-  	} 
-	else {
-  		WLog("session_auth_obj","no key found for the corresponding keyId");
-  		return false;
+	msg.set_pos(auth_data_pos + 4);
+	key_id_t key_id = msg.decode32();
+	msg.set_pos(trans_id_pos + 6);
+	uint16 trans_id = msg.decode16();
+
+	// TODO: translate transform ID to SSL algo
+	if ( trans_id != TRANS_ID_AUTH_HMAC_SHA1_96 )
+		ERRLog("session_auth_obj", "unsupported Integrity Algorithm Transform ID, using SHA-1 anyway");
+
+	// do the HMAC calculation, starting from the key states of the registry
+	if (!sign_key_registry.computeHMAC(key_id, ranges, range_count, msg_digest)) {
+		WLog("session_auth_obj","no key found for the corresponding keyId");
+		return hmac_error;
+	}
+	DLog("session_auth_obj", "got key ID 0x" << hex << key_id << dec);
+
+	// the HMAC carried must have the full length
+	if (auth_data_len != 8 + session_auth_object::HMAC_size) {
+		ERRLog("session_auth_obj", "HMAC in AUTHENTICATION_DATA has wrong length " << auth_data_len - 8);
+		return hmac_error;
 	}
+	hmac_pos = auth_data_pos + 8;
 
-	delete obj_list;
-	delete transId;
-	delete hmac_buffer;
-	return true;	
+	return hmac_ok;
 }
 
 /**
@@ -853,20 +868,21 @@ session_auth_object::serialize_hmac(NetMsg &msg, coding_t coding, bool fill_data
 
 		TLP_list::position_list_t::const_iterator it = sauth_objects->begin();
 		while (it != sauth_objects->end()) {
-			uint8 *msg_digest = NULL;
-			auth_attr_data* auth_data = NULL;
-			if(!calc_HMAC(msg,msg_digest,auth_data,*it,coding))
+			uint8 msg_digest[EVP_MAX_MD_SIZE];
+			uint32 hmac_pos = 0;
+			hmac_result_t result = calc_HMAC(msg,msg_digest,hmac_pos,*it,coding);
+			if (result == hmac_not_signed)
+			{
+				// ignore this session auth object since it is not of type HMAC signed
+				it++;
+				continue;
+			}
+			if (result == hmac_error)
 			{
-				if (msg_digest == NULL && auth_data == NULL)
-				{
-					// ignore this session auth object since it is not of type HMAC signed
-					it++;
-					continue;
-				}
-
 				// HMAC calculation failed
 				DLog("session_auth_obj", "in serialize_hmac() - error occured during HMAC calculation");
 
+				msg.set_pos(saved_pos);
 				return false;
 			}
 			
@@ -876,8 +892,6 @@ session_auth_object::serialize_hmac(NetMsg &msg, coding_t coding, bool fill_data
 
 			DLog("session_auth_obj", "serialize_hmac() - calculated HMAC successfully");
 			
-			delete msg_digest;			
-			delete auth_data;
 			it++;
 		} // end while AuthObj_type in linked list
 	    
@@ -53,6 +53,7 @@ class SessionAuthObjectTest : public CppUnit::TestCase {
 	CPPUNIT_TEST( testReadWrite );
 	CPPUNIT_TEST( testReadWriteWithObjects );
 	CPPUNIT_TEST( testReadWriteWithPDU );
+	CPPUNIT_TEST( testMalformedHMAC );
 	
 	CPPUNIT_TEST_SUITE_END();
 
@@ -69,6 +70,7 @@ class SessionAuthObjectTest : public CppUnit::TestCase {
 	void testReadWrite();
 	void testReadWriteWithObjects();
 	void testReadWriteWithPDU();
+	void testMalformedHMAC();
 	
         void insert_all_attr(session_auth_object *obj, key_id_t key_id);
 	void register_NTLP_ies();
@@ -582,6 +584,51 @@ void SessionAuthObjectTest::testReadWrite() {
 	delete sauth_obj_token;
 }
 
+void SessionAuthObjectTest::testMalformedHMAC() {
+
+	session_auth_object *p1 = new session_auth_object();
+	insert_all_attr(p1, pskey_id1);
+	uint32 expected_size= p1->get_serialized_size(IE::protocol_v1);
+
+	// a malformed HMAC signed object must neither be signed nor pass the check
+	for (int corruption = 0; corruption < 2; corruption++) {
+		NetMsg msg(expected_size+20);
+		uint32 bytes_written = 0;
+
+		msg.encode32(0x4e04bda5); // GIST magic
+		msg.encode32(0x0100001A); // NTLP HEADER  = version | Gist Hops | Message Length 
+		msg.encode32(0x12340000); // NSLPID & offcut of the NSLP HEADER
+		msg.encode16(0x0008); // NSLPDATA_Object = Action & Type
+		msg.encode16((expected_size/4)+1); // NSLPDATA_Object = RSV & length (in 32 bit)
+		msg.encode32(0x01000000); // NSLP HEADER ?
+		p1->serialize(msg, IE::protocol_v1, bytes_written);
+
+		msg.to_start();
+		msg.set_pos_r(4); // skip magic number
+		CPPUNIT_ASSERT( session_auth_object::serialize_hmac(msg, IE::protocol_v1, true) );
+		msg.set_pos(4);
+		CPPUNIT_ASSERT( session_auth_object::check_hmac(msg, IE::protocol_v1) );
+
+		uint32 auth_pos = *(msg.get_TLP_list()->get_list(ntlp_pdu::tlplist_nslp_object_type, session_auth_object::NSLP_TYPE)->begin());
+		if (corruption == 0) {
+			// length of the first attribute beyond the object
+			msg.get_buffer()[auth_pos+4] = 0xFF;
+		}
+		else {
+			// length of the object beyond the message
+			msg.get_buffer()[auth_pos+2] |= 0x0F;
+			msg.get_buffer()[auth_pos+3] = 0xFF;
+		}
+
+		msg.set_pos(4);
+		CPPUNIT_ASSERT( !session_auth_object::check_hmac(msg, IE::protocol_v1) );
+		msg.set_pos(4);
+		CPPUNIT_ASSERT( !session_auth_object::serialize_hmac(msg, IE::protocol_v1, true) );
+	}
+
+	delete p1;
+}
+
 void SessionAuthObjectTest::testReadWriteWithObjects() {
 
     session_auth_object *p1 = new session_auth_object();
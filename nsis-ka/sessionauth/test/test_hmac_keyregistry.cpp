@@ -0,0 +1,77 @@
+/*
+ * test_hmac_keyregistry - test the HMAC computation of the key registry
+ *
+ * $Id:$
+ * $HeadURL:$
+ *
+ */
+#include <cppunit/TestCase.h>
+#include <cppunit/extensions/HelperMacros.h>
+
+#include <string.h>
+
+#include "hmac_keyregistry.h"
+#include "openssl/evp.h"
+#include "openssl/hmac.h"
+
+using namespace nslp_auth;
+using namespace protlib;
+
+class HmacKeyRegistryTest : public CppUnit::TestCase {
+
+	CPPUNIT_TEST_SUITE( HmacKeyRegistryTest );
+
+	CPPUNIT_TEST( test_keyregistry );
+
+	CPPUNIT_TEST_SUITE_END();
+
+  public:
+	void test_keyregistry();
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION( HmacKeyRegistryTest );
+
+
+void
+HmacKeyRegistryTest::test_keyregistry()
+{
+  hmac_keyregistry registry;
+  uint32 key_id= 0x1234;
+  const char *key= "ASJDFHASLJDFKHRC)PQreiuqqnriuw$%&prunweiopurcnwo";
+  // longer than a SHA-1 block, hashed first
+  const char *longkey= "SDFLKJAHSETRKLWNFLKASUERPWIOEUTRNPOIEURVPQNUERPOUNSDFLKJAHSETRKLWNFLKASUERPWIOEUTRN";
+  const char *data= "The objects covered by an HMAC are hashed where they are.";
+
+  uchar expected[EVP_MAX_MD_SIZE];
+  uchar mac[EVP_MAX_MD_SIZE];
+  unsigned int expected_len= 0;
+  uint32 mac_len= 0;
+
+  hmac_keyregistry::hmac_range_t ranges[3];
+  ranges[0].data= reinterpret_cast<const uchar*>(data);
+  ranges[0].len= 2;
+  ranges[1].data= reinterpret_cast<const uchar*>(data) + 2;
+  ranges[1].len= 0;
+  ranges[2].data= reinterpret_cast<const uchar*>(data) + 2;
+  ranges[2].len= strlen(data) - 2;
+
+  CPPUNIT_ASSERT( !registry.computeHMAC(key_id, ranges, 3, mac) );
+
+  // the ranges give the same HMAC as the data in one piece
+  registry.storeKey(key_id, key, strlen(key));
+  HMAC(EVP_sha1(), key, strlen(key), reinterpret_cast<const uchar*>(data), strlen(data), expected, &expected_len);
+  CPPUNIT_ASSERT( registry.computeHMAC(key_id, ranges, 3, mac, &mac_len) );
+  CPPUNIT_ASSERT_EQUAL( expected_len, mac_len );
+  CPPUNIT_ASSERT( memcmp(expected, mac, mac_len) == 0 );
+  CPPUNIT_ASSERT( memcmp(registry.getKey(key_id), key, strlen(key)) == 0 );
+
+  // a key stored again replaces the old one
+  registry.storeKey(key_id, longkey, strlen(longkey));
+  HMAC(EVP_sha1(), longkey, strlen(longkey), reinterpret_cast<const uchar*>(data), strlen(data), expected, &expected_len);
+  CPPUNIT_ASSERT( registry.computeHMAC(key_id, ranges, 3, mac) );
+  CPPUNIT_ASSERT( memcmp(expected, mac, expected_len) == 0 );
+
+  registry.deleteKey(key_id);
+  CPPUNIT_ASSERT( registry.getKey(key_id) == NULL );
+  CPPUNIT_ASSERT( !registry.computeHMAC(key_id, ranges, 3, mac) );
+}
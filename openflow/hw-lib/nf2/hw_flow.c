@@ -213,11 +213,11 @@ nf2_uninstall_flow(struct datapath *dpinst, struct sw_table *flowtab,
 			nf2flow = flow->private;
 
 			if (nf2flow != NULL) {
-				flow->packet_count
-					+= nf2_get_packet_count(dev,
-								nf2flow);
-				flow->byte_count += nf2_get_byte_count(dev,
-								       nf2flow);
+				flow_add_counts(flow,
+						nf2_get_packet_count(dev,
+								     nf2flow),
+						nf2_get_byte_count(dev,
+								   nf2flow));
 			}
 			count += do_uninstall(flow, &deleted);
 			if (keep_flow == KEEP_FLOW) {
@@ -265,13 +265,12 @@ nf2_flow_timeout(struct sw_table *flowtab, struct list *deleted)
 	LIST_FOR_EACH_SAFE (flow, n, struct sw_flow, node, &nf2flowtab->flows) {
 		nf2flow = flow->private;
 		if (nf2flow != NULL) {
-			num_forw_packets = flow->packet_count
-				+ nf2_get_packet_count(dev, nf2flow);
-			flow->byte_count += nf2_get_byte_count(dev, nf2flow);
-		}
-		if (num_forw_packets > flow->packet_count) {
-			flow->packet_count = num_forw_packets;
-			flow->used = now;
+			num_forw_packets = nf2_get_packet_count(dev, nf2flow);
+			flow_add_counts(flow, num_forw_packets,
+					nf2_get_byte_count(dev, nf2flow));
+			if (num_forw_packets > 0) {
+				flow->used = now;
+			}
 		}
 
 		if (flow_timeout(flow)) {
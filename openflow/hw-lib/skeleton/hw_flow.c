@@ -126,8 +126,8 @@ of_hw_sw_flow_stat_update(struct sw_flow *flow, int *used, int force_sync)
         }
         FIXME_update proper hw_flow counters;
     }
-    flow->packet_count = hw_flow->hw_packet_count;
-    flow->byte_count = hw_flow->hw_byte_count;
+    flow_add_counts(flow, hw_flow->hw_packet_count - flow->packet_count,
+                    hw_flow->hw_byte_count - flow->byte_count);
 
     return 0;
 }
@@ -37,6 +37,7 @@
 #define NO_RETURN __attribute__((__noreturn__))
 #define UNUSED __attribute__((__unused__))
 #define PACKED __attribute__((__packed__))
+#define ALIGNED(N) __attribute__((__aligned__(N)))
 #define PRINTF_FORMAT(FMT, ARG1) __attribute__((__format__(printf, FMT, ARG1)))
 #define STRFTIME_FORMAT(FMT) __attribute__((__format__(__strftime__, FMT, 0)))
 #define MALLOC_LIKE __attribute__((__malloc__))
@@ -79,11 +79,15 @@ static inline void hmap_insert_fast(struct hmap *,
 static inline void hmap_insert(struct hmap *, struct hmap_node *, size_t hash);
 static inline void hmap_remove(struct hmap *, struct hmap_node *);
 
-/* Search. */
+/* Search.
+ *
+ * The loop conditions compare NODE against CONTAINER_OF(NULL, ...) instead of
+ * testing &NODE->MEMBER against NULL, which compilers may assume to be always
+ * true. */
 #define HMAP_FOR_EACH_WITH_HASH(NODE, STRUCT, MEMBER, HASH, HMAP)       \
     for ((NODE) = CONTAINER_OF(hmap_first_with_hash(HMAP, HASH),        \
                                STRUCT, MEMBER);                         \
-         &(NODE)->MEMBER != NULL;                                       \
+         (NODE) != CONTAINER_OF(NULL, STRUCT, MEMBER);                  \
          (NODE) = CONTAINER_OF(hmap_next_with_hash(&(NODE)->MEMBER),    \
                                STRUCT, MEMBER))
 
@@ -98,13 +102,13 @@ static inline struct hmap_node *hmap_next_with_hash(const struct hmap_node *);
  * intact. */
 #define HMAP_FOR_EACH(NODE, STRUCT, MEMBER, HMAP)                   \
     for ((NODE) = CONTAINER_OF(hmap_first(HMAP), STRUCT, MEMBER);   \
-         &(NODE)->MEMBER != NULL;                                   \
+         (NODE) != CONTAINER_OF(NULL, STRUCT, MEMBER);              \
          (NODE) = CONTAINER_OF(hmap_next(HMAP, &(NODE)->MEMBER),    \
                                STRUCT, MEMBER))
 
 #define HMAP_FOR_EACH_SAFE(NODE, NEXT, STRUCT, MEMBER, HMAP)        \
     for ((NODE) = CONTAINER_OF(hmap_first(HMAP), STRUCT, MEMBER);   \
-         (&(NODE)->MEMBER != NULL                                   \
+         ((NODE) != CONTAINER_OF(NULL, STRUCT, MEMBER)              \
           ? (NEXT) = CONTAINER_OF(hmap_next(HMAP, &(NODE)->MEMBER), \
                                   STRUCT, MEMBER), 1                \
           : 0);                                                     \
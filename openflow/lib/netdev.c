@@ -58,19 +58,22 @@
 #endif
 
 #include <linux/ethtool.h>
+#include <linux/pkt_sched.h>
 #include <linux/rtnetlink.h>
 #include <linux/sockios.h>
 #include <linux/version.h>
 #include <sys/types.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
 #include <sys/socket.h>
-#include <netpacket/packet.h>
+#include <linux/if_packet.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <net/if_arp.h>
-#include <net/if_packet.h>
 #include <net/route.h>
 #include <netinet/in.h>
+#include <stdarg.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -127,6 +130,17 @@ struct netdev {
 
     int save_flags;             /* Initial device flags. */
     int changed_flags;          /* Flags that we changed. */
+
+    /* Memory-mapped RX and TX rings shared with the kernel, for devices
+     * opened with the "mmap:" prefix.  Null if the device uses ordinary
+     * socket I/O. */
+    uint8_t *ring;              /* RX ring, followed by the TX ring. */
+    size_t ring_size;           /* Size of both rings together, in bytes. */
+    unsigned int frame_size;    /* Bytes per frame, a power of 2. */
+    unsigned int n_frames;      /* Frames per ring, a power of 2. */
+    unsigned int rx_head;       /* Next RX frame to receive. */
+    unsigned int tx_head;       /* Next TX frame to fill. */
+    unsigned int tx_pending;    /* TX frames filled but not yet kicked. */
 };
 
 /* All open network devices. */
@@ -142,6 +156,7 @@ static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(5, 20);
 static void init_netdev(void);
 static int do_open_netdev(const char *name, int ethertype, int tap_fd,
                           struct netdev **netdev_);
+static int setup_rings(struct netdev *);
 static int restore_flags(struct netdev *netdev);
 static int get_flags(const char *netdev_name, int *flagsp);
 static int set_flags(const char *netdev_name, int flags);
@@ -194,35 +209,275 @@ get_ipv6_address(const char *name, struct in6_addr *in6)
  * without any bandwidth guarantees */
 #define TC_DEFAULT_CLASS 0xfffe
 #define TC_MIN_RATE 1
-/* This configures an HTB qdisc under the defined device. */
+/* Largest packet that a class is expected to send, as tc assumes. */
+#define TC_MTU 1600
+
+/* Queues are configured over rtnetlink.  Only if the rtnetlink socket cannot
+ * be opened do we fall back to running tc with these commands, which forks
+ * a process for each of them. */
 #define COMMAND_ADD_DEV_QDISC "/sbin/tc qdisc add dev %s " \
                               "root handle %x: htb default %x"
 #define COMMAND_DEL_DEV_QDISC "/sbin/tc qdisc del dev %s root"
 #define COMMAND_ADD_CLASS "/sbin/tc class add dev %s parent %x:%x " \
-                          "classid %x:%x htb rate %dkbit ceil %dkbit"
+                          "classid %x:%x htb rate %"PRIu64"kbit " \
+                          "ceil %"PRIu64"kbit"
 #define COMMAND_CHANGE_CLASS "/sbin/tc class change dev %s parent %x:%x " \
-                             "classid %x:%x htb rate %dkbit ceil %dkbit"
+                             "classid %x:%x htb rate %"PRIu64"kbit " \
+                             "ceil %"PRIu64"kbit"
 #define COMMAND_DEL_CLASS "/sbin/tc class del dev %s parent %x:%x classid %x:%x"
 
+static struct nl_sock *rtnl_sock;
+static bool rtnl_unavailable;
+
+/* Packet scheduler clock, as read from /proc/net/psched. */
+static double tc_ticks_per_usec;
+static unsigned int tc_hz;
+
+/* Returns the rtnetlink socket for configuring queues, or a null pointer if
+ * queues must be configured with tc instead. */
+static struct nl_sock *
+get_rtnl_sock(void)
+{
+    if (!rtnl_sock && !rtnl_unavailable) {
+        int error = nl_sock_create(NETLINK_ROUTE, 0, 0, 0, &rtnl_sock);
+        if (error) {
+            VLOG_WARN("could not create rtnetlink socket (%s), configuring "
+                      "queues with /sbin/tc instead", strerror(error));
+            rtnl_unavailable = true;
+        }
+    }
+    return rtnl_sock;
+}
+
+/* Reads the resolution of the packet scheduler clock, in which HTB expects
+ * its rate tables and bucket sizes, the same way as tc. */
+static void
+read_psched(void)
+{
+    unsigned int t2us, us2t, clock_res, hz;
+    FILE *stream;
+    int n;
+
+    if (tc_ticks_per_usec) {
+        return;
+    }
+
+    stream = fopen("/proc/net/psched", "r");
+    n = stream ? fscanf(stream, "%x %x %x %x", &t2us, &us2t, &clock_res, &hz)
+               : 0;
+    if (stream) {
+        fclose(stream);
+    }
+    if (n < 3 || !t2us || !us2t || !clock_res) {
+        VLOG_WARN("could not read /proc/net/psched, assuming 1 tick/us");
+        t2us = us2t = 1;
+        clock_res = 1000000;
+    }
+    if (clock_res == 1000000000) {
+        t2us = us2t;
+    }
+    tc_ticks_per_usec = (double) t2us / us2t * clock_res / 1000000;
+    tc_hz = n == 4 && clock_res == 1000000 ? hz : sysconf(_SC_CLK_TCK);
+}
+
+/* Returns the time to send 'size' bytes at 'Bps' bytes per second, in
+ * packet scheduler ticks. */
+static uint32_t
+tc_xmit_ticks(uint64_t Bps, unsigned int size)
+{
+    return tc_ticks_per_usec * 1000000.0 * size / Bps;
+}
+
+static struct ofpbuf *
+tc_make_request(const struct netdev *netdev, int type, unsigned int flags,
+                uint32_t handle, uint32_t parent)
+{
+    struct ofpbuf *request = ofpbuf_new(0);
+    struct tcmsg *tcmsg;
+
+    nl_msg_put_nlmsghdr(request, rtnl_sock, sizeof *tcmsg + 2 * 1024, type,
+                        NLM_F_REQUEST | flags);
+    tcmsg = nl_msg_put_uninit(request, sizeof *tcmsg);
+    memset(tcmsg, 0, sizeof *tcmsg);
+    tcmsg->tcm_family = AF_UNSPEC;
+    tcmsg->tcm_ifindex = netdev->ifindex;
+    tcmsg->tcm_handle = handle;
+    tcmsg->tcm_parent = parent;
+    return request;
+}
+
+/* Returns a request to replace the root qdisc of 'netdev' by an HTB qdisc
+ * that puts unclassified traffic into TC_DEFAULT_CLASS. */
+static struct ofpbuf *
+tc_make_qdisc_request(const struct netdev *netdev)
+{
+    struct tc_htb_glob glob;
+    struct ofpbuf *request;
+    size_t options;
+
+    request = tc_make_request(netdev, RTM_NEWQDISC, NLM_F_CREATE | NLM_F_EXCL,
+                              TC_H_MAKE(TC_QDISC << 16, 0), TC_H_ROOT);
+    nl_msg_put_string(request, TCA_KIND, "htb");
+
+    memset(&glob, 0, sizeof glob);
+    glob.version = TC_HTB_PROTOVER;
+    glob.rate2quantum = 10;
+    glob.defcls = TC_DEFAULT_CLASS;
+    options = nl_msg_start_nested(request, TCA_OPTIONS);
+    nl_msg_put_unspec(request, TCA_HTB_INIT, &glob, sizeof glob);
+    nl_msg_end_nested(request, options);
+    return request;
+}
+
+static struct ofpbuf *
+tc_make_del_qdisc_request(const struct netdev *netdev)
+{
+    return tc_make_request(netdev, RTM_DELQDISC, 0, 0, TC_H_ROOT);
+}
+
+/* Fills in 'rate' for 'Bps' bytes per second.  A rate that does not fit in
+ * its 32 bits is clamped; tc_put_rate64() then supplies the real one. */
+static void
+tc_fill_rate(struct tc_ratespec *rate, uint64_t Bps)
+{
+    memset(rate, 0, sizeof *rate);
+    rate->rate = MIN(Bps, UINT32_MAX);
+    rate->cell_align = -1;
+    while ((TC_MTU >> rate->cell_log) > 255) {
+        rate->cell_log++;
+    }
+}
+
+/* Appends to 'request' an attribute of the given 'type' with the table of
+ * transmit times for each packet size at 'Bps' bytes per second, which
+ * 'rate' describes, for kernels that need it. */
+static void
+tc_put_rtab(struct ofpbuf *request, uint16_t type,
+            const struct tc_ratespec *rate, uint64_t Bps)
+{
+    uint32_t *rtab;
+    int i;
+
+    rtab = nl_msg_put_unspec_uninit(request, type, 256 * sizeof *rtab);
+    for (i = 0; i < 256; i++) {
+        rtab[i] = tc_xmit_ticks(Bps, (i + 1) << rate->cell_log);
+    }
+}
+
+/* Appends to 'request' a 64-bit attribute of the given 'type' with 'Bps' if
+ * tc_fill_rate() had to clamp it.  Older kernels ignore the attribute and
+ * use the clamped rate. */
+static void
+tc_put_rate64(struct ofpbuf *request, uint16_t type, uint64_t Bps)
+{
+    if (Bps > UINT32_MAX) {
+        nl_msg_put_u64(request, type, Bps);
+    }
+}
+
+/* Returns a request to add (if 'flags' includes NLM_F_CREATE) or change HTB
+ * class 'class_id' under class 'parent' of 'netdev', guaranteeing it 'rate'
+ * kbit/s and allowing it up to the full speed of 'netdev'. */
+static struct ofpbuf *
+tc_make_class_request(const struct netdev *netdev, unsigned int flags,
+                      uint16_t parent, uint16_t class_id, uint64_t rate)
+{
+    uint64_t rate_Bps = rate * 1000 / 8;
+    uint64_t ceil_Bps = (uint64_t) netdev->speed * 1000 * 1000 / 8;
+    struct tc_htb_opt opt;
+    struct ofpbuf *request;
+    size_t options;
+
+    read_psched();
+    memset(&opt, 0, sizeof opt);
+    tc_fill_rate(&opt.rate, rate_Bps);
+    tc_fill_rate(&opt.ceil, ceil_Bps);
+    opt.buffer = tc_xmit_ticks(rate_Bps, rate_Bps / tc_hz + TC_MTU);
+    opt.cbuffer = tc_xmit_ticks(ceil_Bps, ceil_Bps / tc_hz + TC_MTU);
+
+    request = tc_make_request(netdev, RTM_NEWTCLASS, flags,
+                              TC_H_MAKE(TC_QDISC << 16, class_id),
+                              TC_H_MAKE(TC_QDISC << 16, parent));
+    nl_msg_put_string(request, TCA_KIND, "htb");
+    options = nl_msg_start_nested(request, TCA_OPTIONS);
+    nl_msg_put_unspec(request, TCA_HTB_PARMS, &opt, sizeof opt);
+    tc_put_rtab(request, TCA_HTB_RTAB, &opt.rate, rate_Bps);
+    tc_put_rtab(request, TCA_HTB_CTAB, &opt.ceil, ceil_Bps);
+    tc_put_rate64(request, TCA_HTB_RATE64, rate_Bps);
+    tc_put_rate64(request, TCA_HTB_CEIL64, ceil_Bps);
+    nl_msg_end_nested(request, options);
+    return request;
+}
+
+static struct ofpbuf *
+tc_make_del_class_request(const struct netdev *netdev, uint16_t class_id)
+{
+    return tc_make_request(netdev, RTM_DELTCLASS, 0,
+                           TC_H_MAKE(TC_QDISC << 16, class_id),
+                           TC_H_MAKE(TC_QDISC << 16, TC_ROOT_CLASS));
+}
+
+/* Sends the 'n' requests in 'requests' to the kernel at once, waits until
+ * it has carried them out, and frees them.  Stores 0 into errors[i] if
+ * requests[i] succeeded, otherwise a positive errno value, which is ENOBUFS
+ * if it is not known whether requests[i] succeeded. */
+static void
+tc_transact(struct ofpbuf *requests[], size_t n, int errors[])
+{
+    size_t i;
+
+    nl_sock_transact_batch(rtnl_sock, requests, n, errors);
+    for (i = 0; i < n; i++) {
+        ofpbuf_delete(requests[i]);
+    }
+}
+
+/* Sends the single 'request' to the kernel and frees it.  Returns 0 if
+ * successful, otherwise a positive errno value. */
+static int
+tc_transact_one(struct ofpbuf *request)
+{
+    int error;
+
+    tc_transact(&request, 1, &error);
+    return error;
+}
+
+static int run_tc_command(const char *format, ...) PRINTF_FORMAT(1, 2);
+
+/* Runs the tc command formatted from 'format'.  Returns 0 if successful,
+ * otherwise a positive errno value. */
 static int
-netdev_setup_root_class(const struct netdev *netdev, uint16_t class_id,
-                        uint16_t rate)
+run_tc_command(const char *format, ...)
 {
     char command[1024];
-    int actual_rate;
+    va_list args;
+
+    va_start(args, format);
+    vsnprintf(command, sizeof command, format, args);
+    va_end(args);
+
+    return system(command) ? EPROTO : 0;
+}
 
+/* Adds (if 'flags' includes NLM_F_CREATE) or changes class 'class_id' under
+ * class 'parent' of 'netdev', with a minimum rate of 'rate' in .1% of the
+ * speed of 'netdev'. */
+static int
+do_setup_class(const struct netdev *netdev, unsigned int flags,
+               uint16_t parent, uint16_t class_id, uint16_t rate)
+{
     /* we need to translate from .1% to kbps */
-    actual_rate = rate*netdev->speed;
+    uint64_t actual_rate = (uint64_t) rate * netdev->speed;
 
-    snprintf(command, sizeof(command), COMMAND_ADD_CLASS, netdev->name,
-             TC_QDISC,0,TC_QDISC, class_id, actual_rate, netdev->speed*1000);
-    if (system(command) != 0) {
-        VLOG_ERR("Problem configuring root class %d for device %s",
-                 class_id, netdev->name);
-        return -1;
+    if (get_rtnl_sock()) {
+        return tc_transact_one(tc_make_class_request(netdev, flags, parent,
+                                                     class_id, actual_rate));
     }
-
-    return 0;
+    return run_tc_command(flags & NLM_F_CREATE ? COMMAND_ADD_CLASS
+                          : COMMAND_CHANGE_CLASS,
+                          netdev->name, TC_QDISC, parent, TC_QDISC, class_id,
+                          actual_rate, (uint64_t) netdev->speed * 1000);
 }
 
 /** Defines a class for the specific queue discipline. A class
@@ -233,29 +488,21 @@ netdev_setup_root_class(const struct netdev *netdev, uint16_t class_id,
  * so we need to keep an internal mapping between class_id and OpenFlow
  * queue_id
  * @param rate the minimum rate for this queue in kbps
- * @return 0 on success, non-zero value when the configuration was not
- * successful.
+ * @return 0 on success, otherwise a positive errno value.
  */
 int
 netdev_setup_class(const struct netdev *netdev, uint16_t class_id,
                    uint16_t rate)
 {
-    char command[1024];
-    int actual_rate;
-
-    /* we need to translate from .1% to kbps */
-    actual_rate = rate*netdev->speed;
+    int error;
 
-    snprintf(command, sizeof(command), COMMAND_ADD_CLASS, netdev->name,
-             TC_QDISC, TC_ROOT_CLASS, TC_QDISC, class_id, actual_rate,
-             netdev->speed*1000);
-    if (system(command) != 0) {
-        VLOG_ERR("Problem configuring class %d for device %s",class_id,
-                 netdev->name);
-        return -1;
+    error = do_setup_class(netdev, NLM_F_CREATE | NLM_F_EXCL, TC_ROOT_CLASS,
+                           class_id, rate);
+    if (error) {
+        VLOG_ERR("Problem configuring class %d for device %s: %s",
+                 class_id, netdev->name, strerror(error));
     }
-
-    return 0;
+    return error;
 }
 
 /** Changes a class already defined.
@@ -265,52 +512,43 @@ netdev_setup_class(const struct netdev *netdev, uint16_t class_id,
  * so we need to keep an internal mapping between class_id and OpenFlow
  * queue_id
  * @param rate the minimum rate for this queue in kbps
- * @return 0 on success, non-zero value when the configuration was not
- * successful.
+ * @return 0 on success, otherwise a positive errno value.
  */
 int
 netdev_change_class(const struct netdev *netdev, uint16_t class_id, uint16_t rate)
 {
-    char command[1024];
-    int actual_rate;
-
-    /* we need to translate from .1% to kbps */
-    actual_rate = rate*netdev->speed;
+    int error;
 
-    snprintf(command, sizeof(command), COMMAND_CHANGE_CLASS, netdev->name,
-             TC_QDISC, TC_ROOT_CLASS, TC_QDISC, class_id, actual_rate,
-             netdev->speed*1000 );
-    if (system(command) != 0) {
-        VLOG_ERR("Problem configuring class %d for device %s",
-                 class_id, netdev->name);
-        return -1;
+    error = do_setup_class(netdev, 0, TC_ROOT_CLASS, class_id, rate);
+    if (error) {
+        VLOG_ERR("Problem configuring class %d for device %s: %s",
+                 class_id, netdev->name, strerror(error));
     }
-
-    return 0;
+    return error;
 }
 
 /** Deletes a class already defined to represent an OpenFlow queue.
  *
  * @param netdev the device under configuration
  * @param class_id unique identifier for this queue.
- * @param rate the minimum rate for this queue in kbps
- * @return 0 on success, non-zero value when the configuration was not
- * successful.
+ * @return 0 on success, otherwise a positive errno value.
  */
 int
 netdev_delete_class(const struct netdev *netdev, uint16_t class_id)
 {
-    char command[1024];
+    int error;
 
-    snprintf(command, sizeof(command), COMMAND_DEL_CLASS, netdev->name,
-             TC_QDISC, TC_ROOT_CLASS, TC_QDISC, class_id);
-    if (system(command) != 0) {
-        VLOG_ERR("Problem deleting class %d for device %s",class_id,
-                 netdev->name);
-        return -1;
+    if (get_rtnl_sock()) {
+        error = tc_transact_one(tc_make_del_class_request(netdev, class_id));
+    } else {
+        error = run_tc_command(COMMAND_DEL_CLASS, netdev->name, TC_QDISC,
+                               TC_ROOT_CLASS, TC_QDISC, class_id);
     }
-
-    return 0;
+    if (error) {
+        VLOG_ERR("Problem deleting class %d for device %s: %s",
+                 class_id, netdev->name, strerror(error));
+    }
+    return error;
 }
 
 static int
@@ -369,6 +607,30 @@ open_queue_socket(const char * name, uint16_t class_id, int * fd)
 }
 
 
+/* Replaces any previous queue configuration of 'netdev' by an HTB qdisc with
+ * a root class and a default class, in a single batch of requests.  Returns 0
+ * if successful, otherwise a positive errno value. */
+static int
+tc_setup_qdisc(const struct netdev *netdev)
+{
+    struct ofpbuf *requests[4];
+    int errors[4];
+
+    requests[0] = tc_make_del_qdisc_request(netdev);
+    requests[1] = tc_make_qdisc_request(netdev);
+    requests[2] = tc_make_class_request(netdev, NLM_F_CREATE | NLM_F_EXCL,
+                                        0, TC_ROOT_CLASS,
+                                        (uint64_t) 1000 * netdev->speed);
+    requests[3] = tc_make_class_request(netdev, NLM_F_CREATE | NLM_F_EXCL,
+                                        TC_ROOT_CLASS, TC_DEFAULT_CLASS,
+                                        (uint64_t) netdev->speed);
+    tc_transact(requests, 4, errors);
+
+    /* There is no need for a device to already be configured, so the
+     * result of removing the old qdisc does not matter. */
+    return errors[1] ? errors[1] : errors[2] ? errors[2] : errors[3];
+}
+
 /** Setup a classful queue for the specific device. Configured according to
  * HTB protocol. Note that this is linux specific. You will need to replace
  * this with the appropriate abstraction for different OS.
@@ -385,44 +647,57 @@ open_queue_socket(const char * name, uint16_t class_id, int * fd)
  * http://luxik.cdi.cz/~devik/qos/htb/
  * http://luxik.cdi.cz/~devik/qos/htb/manual/userg.htm
  *
- * @param netdev_name the device to be configured
- * @return 0 on success, non-zero value when the configuration was not
- * successful.
+ * Any previous queue configuration of the device is removed first.  Over
+ * rtnetlink, all of this takes a single batch of requests.
+ *
+ * @param netdev the device to be configured
+ * @return 0 on success, otherwise a positive errno value.
  */
 static int
-do_setup_qdisc(const char *netdev_name)
+do_setup_qdisc(const struct netdev *netdev)
 {
-    char command[1024];
     int error;
 
-    snprintf(command, sizeof(command), COMMAND_ADD_DEV_QDISC, netdev_name,
-             TC_QDISC, TC_DEFAULT_CLASS);
-    error = system(command);
-    if (error) {
-        VLOG_WARN("Problem configuring qdisc for device %s",netdev_name);
-        return error;
-    }
-    return 0;
-}
+    if (get_rtnl_sock()) {
+        int tries = 0;
 
-/** Remove current queue disciplines from a net device
- * @param netdev_name the device under configuration
- */
-static int
-do_remove_qdisc(const char *netdev_name)
-{
-    char command[1024];
-
-    snprintf(command, sizeof(command), COMMAND_DEL_DEV_QDISC, netdev_name);
-    system(command);
+        /* If the kernel dropped acknowledgments, it is not known which of
+         * the requests it carried out, and they cannot simply be sent again:
+         * a repeated delete would remove the new qdisc, and the repeated
+         * creates would fail.  The batch as a whole starts from scratch,
+         * though, so it can be repeated. */
+        do {
+            error = tc_setup_qdisc(netdev);
+        } while (error == ENOBUFS && ++tries < 3);
+    } else {
+        run_tc_command(COMMAND_DEL_DEV_QDISC, netdev->name);
+        error = run_tc_command(COMMAND_ADD_DEV_QDISC, netdev->name,
+                               TC_QDISC, TC_DEFAULT_CLASS);
+
+        /* This define a root class for the queue disc. In order to allow
+         * spare bandwidth to be used efficiently, we need all the classes
+         * under a root class. For details, refer to :
+         * http://luxik.cdi.cz/~devik/qos/htb/ */
+        if (!error) {
+            error = do_setup_class(netdev, NLM_F_CREATE, 0, TC_ROOT_CLASS,
+                                   1000);
+        }
 
-    /* There is no need for a device to already be configured. Therefore no
-     * need to indicate any error */
-    return 0;
+        /* we configure a default class. This would be the best-effort,
+         * getting everything that remains from the other queues.tc requires
+         * a min-rate to configure a class, we put a min_rate here */
+        if (!error) {
+            error = do_setup_class(netdev, NLM_F_CREATE, TC_ROOT_CLASS,
+                                   TC_DEFAULT_CLASS, 1);
+        }
+    }
+    if (error) {
+        VLOG_WARN("Problem configuring qdisc for device %s: %s",
+                  netdev->name, strerror(error));
+    }
+    return error;
 }
 
-
-
 /** Configures a port to support slicing
  * @param netdev_name the device under configuration
  * @return 0 on success
@@ -436,30 +711,8 @@ netdev_setup_slicing(struct netdev *netdev, uint16_t num_queues)
 
     netdev->num_queues = num_queues;
 
-    /* remove any previous queue configuration for this device */
-    error = do_remove_qdisc(netdev->name);
-    if (error) {
-        return error;
-    }
-
     /* Configure tc queue discipline to allow slicing queues */
-    error = do_setup_qdisc(netdev->name);
-    if (error) {
-        return error;
-    }
-
-    /* This define a root class for the queue disc. In order to allow spare
-     * bandwidth to be used efficiently, we need all the classes under a root
-     * class. For details, refer to :
-     * http://luxik.cdi.cz/~devik/qos/htb/ */
-    error = netdev_setup_root_class(netdev, TC_ROOT_CLASS,1000);
-    if (error) {
-        return error;
-    }
-    /* we configure a default class. This would be the best-effort, getting
-     * everything that remains from the other queues.tc requires a min-rate
-     * to configure a class, we put a min_rate here */
-    error = netdev_setup_class(netdev,TC_DEFAULT_CLASS,1);
+    error = do_setup_qdisc(netdev);
     if (error) {
         return error;
     }
@@ -623,12 +876,28 @@ do_ethtool(struct netdev *netdev)
  * 'ethertype' may be a 16-bit Ethernet protocol value in host byte order to
  * capture frames of that type received on the device.  It may also be one of
  * the 'enum netdev_pseudo_ethertype' values to receive frames in one of those
- * categories. */
+ * categories.
+ *
+ * If 'name' has the prefix "mmap:", packets are received and transmitted
+ * through memory-mapped rings shared with the kernel, which saves a system
+ * call per packet.  Packets sent on such a device are queued until
+ * netdev_flush() is called or enough of them accumulate.  If the kernel does
+ * not support the rings, the device falls back to ordinary socket I/O. */
 int
 netdev_open(const char *name, int ethertype, struct netdev **netdevp)
 {
     if (!strncmp(name, "tap:", 4)) {
         return netdev_open_tap(name + 4, netdevp);
+    } else if (!strncmp(name, "mmap:", 5)) {
+        int error = do_open_netdev(name + 5, ethertype, -1, netdevp);
+        if (!error && ethertype != NETDEV_ETH_TYPE_NONE) {
+            int ring_error = setup_rings(*netdevp);
+            if (ring_error) {
+                VLOG_WARN("%s: cannot set up packet rings, falling back to "
+                          "socket I/O: %s", name + 5, strerror(ring_error));
+            }
+        }
+        return error;
     } else {
         return do_open_netdev(name, ethertype, -1, netdevp);
     }
@@ -788,6 +1057,7 @@ do_open_netdev(const char *name, int ethertype, int tap_fd,
     netdev->mtu = mtu;
     netdev->in6 = in6;
     netdev->num_queues = 0;
+    netdev->ring = NULL;
 
     /* Get speed, features. */
     do_ethtool(netdev);
@@ -845,6 +1115,9 @@ netdev_close(struct netdev *netdev)
         for (i =1; i <= netdev->num_queues; i++) {
             close(netdev->queue_fd[i]);
         }
+        if (netdev->ring) {
+            munmap(netdev->ring, netdev->ring_size);
+        }
         free(netdev);
     }
 }
@@ -859,6 +1132,266 @@ pad_to_minimum_length(struct ofpbuf *buffer)
     }
 }
 
+#ifdef PACKET_TX_RING
+/* Memory-mapped packet rings (PACKET_MMAP with TPACKET_V2).
+ *
+ * The RX and TX rings each hold NETDEV_RING_FRAMES frames of 'frame_size'
+ * bytes.  The status word in the header of each frame tells whether the
+ * kernel or the user owns the frame, so that both sides can hand frames back
+ * and forth without system calls.  Only sending needs one, to tell the kernel
+ * that frames are ready, and netdev_send() batches up to NETDEV_TX_BATCH
+ * frames per call. */
+#define NETDEV_RING_FRAMES 512
+#define NETDEV_TX_BATCH 32
+
+/* Offset of the packet data in a TX frame, as expected by the kernel. */
+#define TX_DATA_OFFSET (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+static struct tpacket2_hdr *
+rx_frame(const struct netdev *netdev, unsigned int idx)
+{
+    return (struct tpacket2_hdr *) (netdev->ring
+                                    + (size_t) idx * netdev->frame_size);
+}
+
+static struct tpacket2_hdr *
+tx_frame(const struct netdev *netdev, unsigned int idx)
+{
+    return rx_frame(netdev, netdev->n_frames + idx);
+}
+
+static int
+set_packet_option(int fd, int option, const void *value, socklen_t len)
+{
+    return setsockopt(fd, SOL_PACKET, option, value, len) < 0 ? errno : 0;
+}
+
+/* Sets up memory-mapped RX and TX rings on 'netdev''s socket.  Returns 0 if
+ * successful, otherwise a positive errno value, in which case 'netdev' keeps
+ * using ordinary socket I/O. */
+static int
+setup_rings(struct netdev *netdev)
+{
+    int fd = netdev->netdev_fd;
+    struct tpacket_req req;
+    unsigned int frame_size;
+    int version = TPACKET_V2;
+    int loss = 1;
+    void *ring;
+    int error;
+
+    /* Each frame holds the frame header, the sockaddr_ll that follows it, and
+     * a VLAN-tagged frame of MTU size.  A power of 2 that is at least a page
+     * or divides a page keeps frames from straddling the kernel's blocks. */
+    for (frame_size = TPACKET_ALIGNMENT;
+         frame_size < (TPACKET_ALIGN(TPACKET2_HDRLEN) + VLAN_ETH_HEADER_LEN
+                       + netdev->mtu);
+         frame_size <<= 1) {
+        continue;
+    }
+
+    error = set_packet_option(fd, PACKET_VERSION, &version, sizeof version);
+    if (error) {
+        return error;
+    }
+
+    /* Have the kernel skip malformed TX frames instead of stopping. */
+    error = set_packet_option(fd, PACKET_LOSS, &loss, sizeof loss);
+    if (error) {
+        return error;
+    }
+
+    memset(&req, 0, sizeof req);
+    req.tp_frame_size = frame_size;
+    req.tp_block_size = MAX(frame_size, getpagesize());
+    req.tp_frame_nr = NETDEV_RING_FRAMES;
+    req.tp_block_nr = (NETDEV_RING_FRAMES
+                       / (req.tp_block_size / req.tp_frame_size));
+    error = set_packet_option(fd, PACKET_RX_RING, &req, sizeof req);
+    if (!error) {
+        error = set_packet_option(fd, PACKET_TX_RING, &req, sizeof req);
+    }
+    if (error) {
+        return error;
+    }
+
+#ifdef PACKET_IGNORE_OUTGOING
+    /* Packets that we (or anybody else) send on the device are discarded on
+     * receive anyway, so don't let them occupy RX frames. */
+    set_packet_option(fd, PACKET_IGNORE_OUTGOING, &loss, sizeof loss);
+#endif
+
+    netdev->ring_size = 2 * (size_t) req.tp_block_size * req.tp_block_nr;
+    ring = mmap(NULL, netdev->ring_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+        /* The rings stay allocated in the kernel, but unused. */
+        return errno;
+    }
+
+    netdev->ring = ring;
+    netdev->frame_size = frame_size;
+    netdev->n_frames = NETDEV_RING_FRAMES;
+    netdev->rx_head = 0;
+    netdev->tx_head = 0;
+    netdev->tx_pending = 0;
+    VLOG_DBG("%s: %u-frame RX and TX rings of %u-byte frames",
+             netdev->name, netdev->n_frames, frame_size);
+    return 0;
+}
+
+/* Hands RX frame 'hdr' back to the kernel. */
+static void
+release_rx_frame(struct netdev *netdev, struct tpacket2_hdr *hdr)
+{
+    __sync_synchronize();
+    hdr->tp_status = TP_STATUS_KERNEL;
+    netdev->rx_head = (netdev->rx_head + 1) & (netdev->n_frames - 1);
+}
+
+/* Copies the next packet in 'netdev''s RX ring into 'buffer' and hands its
+ * frame back to the kernel.  A VLAN tag that the device stripped off is put
+ * back in place. */
+static int
+ring_recv(struct netdev *netdev, struct ofpbuf *buffer)
+{
+    for (;;) {
+        struct tpacket2_hdr *hdr = rx_frame(netdev, netdev->rx_head);
+        const struct sockaddr_ll *sll;
+        const uint8_t *data;
+        size_t len;
+        bool vlan;
+
+        if (!(hdr->tp_status & TP_STATUS_USER)) {
+            return EAGAIN;
+        }
+        __sync_synchronize();
+
+        sll = (const struct sockaddr_ll *) ((uint8_t *) hdr
+                                            + TPACKET_ALIGN(sizeof *hdr));
+        data = (const uint8_t *) hdr + hdr->tp_mac;
+        len = hdr->tp_snaplen;
+        vlan = (hdr->tp_status & TP_STATUS_VLAN_VALID) != 0;
+        if (sll->sll_pkttype == PACKET_OUTGOING || len < ETH_HEADER_LEN) {
+            release_rx_frame(netdev, hdr);
+            continue;
+        }
+        if (hdr->tp_status & TP_STATUS_COPY
+            || len + (vlan ? VLAN_HEADER_LEN : 0) > ofpbuf_tailroom(buffer)) {
+            VLOG_WARN_RL(&rl, "dropping %u-byte packet received on %s",
+                         hdr->tp_len, netdev->name);
+            release_rx_frame(netdev, hdr);
+            continue;
+        }
+
+        if (vlan) {
+            uint16_t tag[2];
+
+            tag[0] = htons(ETH_TYPE_VLAN);
+            tag[1] = htons(hdr->tp_vlan_tci);
+            ofpbuf_put(buffer, data, ETH_ADDR_LEN * 2);
+            ofpbuf_put(buffer, tag, sizeof tag);
+            ofpbuf_put(buffer, data + ETH_ADDR_LEN * 2,
+                       len - ETH_ADDR_LEN * 2);
+        } else {
+            ofpbuf_put(buffer, data, len);
+        }
+        release_rx_frame(netdev, hdr);
+
+        pad_to_minimum_length(buffer);
+        return 0;
+    }
+}
+
+/* Hands all received frames in 'netdev''s RX ring back to the kernel. */
+static void
+ring_drain(struct netdev *netdev)
+{
+    struct tpacket2_hdr *hdr;
+
+    while ((hdr = rx_frame(netdev, netdev->rx_head))->tp_status
+           & TP_STATUS_USER) {
+        release_rx_frame(netdev, hdr);
+    }
+}
+
+/* Asks the kernel to transmit all frames queued in 'netdev''s TX ring. */
+static void
+ring_flush(struct netdev *netdev)
+{
+    netdev->tx_pending = 0;
+    if (send(netdev->netdev_fd, NULL, 0, MSG_DONTWAIT) < 0
+        && errno != EAGAIN && errno != ENOBUFS) {
+        VLOG_WARN_RL(&rl, "error sending Ethernet packets on %s: %s",
+                     netdev->name, strerror(errno));
+    }
+}
+
+/* Copies 'buffer' into the next free frame of 'netdev''s TX ring. */
+static int
+ring_send(struct netdev *netdev, const struct ofpbuf *buffer)
+{
+    struct tpacket2_hdr *hdr = tx_frame(netdev, netdev->tx_head);
+
+    if (buffer->size > netdev->frame_size - TX_DATA_OFFSET) {
+        VLOG_WARN_RL(&rl, "cannot send %zu-byte packet on %s",
+                     buffer->size, netdev->name);
+        return EMSGSIZE;
+    }
+    if (hdr->tp_status != TP_STATUS_AVAILABLE) {
+        /* The kernel still owns the oldest frame, so the ring is full.
+         * Kicking the kernel may free it up. */
+        if (netdev->tx_pending) {
+            ring_flush(netdev);
+        }
+        if (hdr->tp_status != TP_STATUS_AVAILABLE) {
+            return EAGAIN;
+        }
+    }
+
+    memcpy((uint8_t *) hdr + TX_DATA_OFFSET, buffer->data, buffer->size);
+    hdr->tp_len = buffer->size;
+    __sync_synchronize();
+    hdr->tp_status = TP_STATUS_SEND_REQUEST;
+    netdev->tx_head = (netdev->tx_head + 1) & (netdev->n_frames - 1);
+
+    if (++netdev->tx_pending >= NETDEV_TX_BATCH) {
+        ring_flush(netdev);
+    }
+    return 0;
+}
+#else  /* !PACKET_TX_RING */
+static int
+setup_rings(struct netdev *netdev UNUSED)
+{
+    return EOPNOTSUPP;
+}
+
+static int
+ring_recv(struct netdev *netdev UNUSED, struct ofpbuf *buffer UNUSED)
+{
+    NOT_REACHED();
+}
+
+static void
+ring_drain(struct netdev *netdev UNUSED)
+{
+    NOT_REACHED();
+}
+
+static void
+ring_flush(struct netdev *netdev UNUSED)
+{
+    NOT_REACHED();
+}
+
+static int
+ring_send(struct netdev *netdev UNUSED, const struct ofpbuf *buffer UNUSED)
+{
+    NOT_REACHED();
+}
+#endif /* !PACKET_TX_RING */
+
 /* Attempts to receive a packet from 'netdev' into 'buffer', which the caller
  * must have initialized with sufficient room for the packet.  The space
  * required to receive any packet is ETH_HEADER_LEN bytes, plus VLAN_HEADER_LEN
@@ -881,6 +1414,10 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer)
     assert(buffer->size == 0);
     assert(ofpbuf_tailroom(buffer) >= ETH_TOTAL_MIN);
 
+    if (netdev->ring) {
+        return ring_recv(netdev, buffer);
+    }
+
     /* prepare to call recvfrom */
     memset(&sll,0,sizeof sll);
     sll_len = sizeof sll;
@@ -931,14 +1468,28 @@ netdev_recv(struct netdev *netdev, struct ofpbuf *buffer)
 void
 netdev_recv_wait(struct netdev *netdev)
 {
+    /* Nothing may stay queued for transmission while the caller sleeps. */
+    netdev_flush(netdev);
     poll_fd_wait(netdev->tap_fd, POLLIN);
 }
 
+/* Returns the file descriptor that becomes readable when a packet is ready to
+ * be received on 'netdev', for callers that poll() it themselves, e.g. in a
+ * thread other than the one running the poll loop. */
+int
+netdev_get_fd(const struct netdev *netdev)
+{
+    return netdev->tap_fd;
+}
+
 /* Discards all packets waiting to be received from 'netdev'. */
 int
 netdev_drain(struct netdev *netdev)
 {
-    if (netdev->tap_fd != netdev->netdev_fd) {
+    if (netdev->ring) {
+        ring_drain(netdev);
+        return drain_rcvbuf(netdev->netdev_fd);
+    } else if (netdev->tap_fd != netdev->netdev_fd) {
         drain_fd(netdev->tap_fd, netdev->txqlen);
         return 0;
     } else {
@@ -967,6 +1518,10 @@ netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
 
     assert(class_id <= NETDEV_MAX_QUEUES);
 
+    if (netdev->ring && !class_id) {
+        return ring_send(netdev, buffer);
+    }
+
     do {
         n_bytes = write(netdev->queue_fd[class_id], buffer->data, buffer->size);
     } while (n_bytes < 0 && errno == EINTR);
@@ -992,6 +1547,17 @@ netdev_send(struct netdev *netdev, const struct ofpbuf *buffer,
     }
 }
 
+/* Hands the packets queued by netdev_send() on 'netdev' to the kernel for
+ * transmission.  Only devices with memory-mapped rings queue packets, so this
+ * does nothing for other devices. */
+void
+netdev_flush(struct netdev *netdev)
+{
+    if (netdev->ring && netdev->tx_pending) {
+        ring_flush(netdev);
+    }
+}
+
 /* Registers with the poll loop to wake up from the next call to poll_block()
  * when the packet transmission queue has sufficient room to transmit a packet
  * with netdev_send().
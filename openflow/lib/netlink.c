@@ -426,6 +426,130 @@ recv:
     return 0;
 }
 
+/* Maximum number of bytes of requests that nl_sock_transact_batch() sends to
+ * the kernel in a single system call. */
+#define NL_BATCH_MAX_BYTES 65536
+
+/* Sends the requests that have no result yet in 'errors' (those whose
+ * element is -1) from the 'n' in 'requests' to the kernel via 'sock', in
+ * as few system calls as possible.  Returns 0 if successful, otherwise a
+ * positive errno value. */
+static int
+send_batch(struct nl_sock *sock, struct ofpbuf *requests[], size_t n,
+           const int errors[], struct iovec iov[])
+{
+    size_t n_iov, n_bytes, i;
+    int retval;
+
+    n_iov = n_bytes = 0;
+    for (i = 0; i < n; i++) {
+        if (errors[i] != -1) {
+            continue;
+        }
+        if (n_iov && n_bytes + requests[i]->size > NL_BATCH_MAX_BYTES) {
+            retval = nl_sock_sendv(sock, iov, n_iov, true);
+            if (retval) {
+                return retval;
+            }
+            n_iov = n_bytes = 0;
+        }
+        iov[n_iov].iov_base = requests[i]->data;
+        iov[n_iov].iov_len = requests[i]->size;
+        n_iov++;
+        n_bytes += requests[i]->size;
+    }
+    return n_iov ? nl_sock_sendv(sock, iov, n_iov, true) : 0;
+}
+
+/* Sends the 'n' requests in 'requests' to the kernel via 'sock', all of them
+ * at once rather than one by one, and then waits for the kernel to
+ * acknowledge them.  The kernel carries out each request independently of
+ * the others, in order.  Stores into errors[i] 0 if the kernel carried out
+ * requests[i], otherwise a positive errno value.
+ *
+ * Returns 0 if every request was acknowledged, otherwise a positive errno
+ * value, in which case the requests without an acknowledgment have that
+ * value in 'errors'.
+ *
+ * Unlike nl_sock_transact(), this does not resend requests whose
+ * acknowledgments the kernel had to drop, because batched requests usually
+ * depend on each other and so cannot simply be repeated.  Instead it stops
+ * and returns ENOBUFS, with which the caller cannot tell whether the kernel
+ * carried out the requests that have ENOBUFS in 'errors'.  Any replies other
+ * than acknowledgments are discarded. */
+int
+nl_sock_transact_batch(struct nl_sock *sock, struct ofpbuf *requests[],
+                       size_t n, int errors[])
+{
+    struct iovec *iov;
+    size_t n_pending, i;
+    int retval;
+
+    for (i = 0; i < n; i++) {
+        struct nlmsghdr *nlmsghdr = nl_msg_nlmsghdr(requests[i]);
+        nlmsghdr->nlmsg_flags |= NLM_F_ACK;
+        nlmsghdr->nlmsg_len = requests[i]->size;
+        errors[i] = -1;
+    }
+    n_pending = n;
+
+    iov = xmalloc(n * sizeof *iov);
+    retval = send_batch(sock, requests, n, errors, iov);
+    while (!retval && n_pending) {
+        struct ofpbuf *reply;
+        size_t offset, len;
+
+        retval = nl_sock_recv(sock, &reply, true);
+        if (retval) {
+            if (retval == ENOBUFS) {
+                VLOG_DBG_RL(&rl, "receive buffer overflow, "
+                            "acknowledgments lost");
+            }
+            break;
+        }
+
+        /* A reply may hold several messages. */
+        for (offset = 0; offset + NLMSG_HDRLEN <= reply->size;
+             offset += NLMSG_ALIGN(len)) {
+            struct nlmsghdr *nlmsghdr = ofpbuf_at_assert(reply, offset,
+                                                         NLMSG_HDRLEN);
+            const struct nlmsgerr *err;
+
+            len = nlmsghdr->nlmsg_len;
+            if (len < NLMSG_HDRLEN || len > reply->size - offset) {
+                break;
+            }
+            if (nlmsghdr->nlmsg_type != NLMSG_ERROR
+                || len < NLMSG_HDRLEN + sizeof *err) {
+                continue;
+            }
+            err = (const struct nlmsgerr *) ((char *) nlmsghdr + NLMSG_HDRLEN);
+            for (i = 0; i < n; i++) {
+                if (errors[i] == -1
+                    && nl_msg_nlmsghdr(requests[i])->nlmsg_seq
+                       == nlmsghdr->nlmsg_seq) {
+                    errors[i] = -err->error;
+                    if (errors[i]) {
+                        VLOG_DBG_RL(&rl, "received NAK error=%d (%s)",
+                                    errors[i], strerror(errors[i]));
+                    }
+                    n_pending--;
+                    break;
+                }
+            }
+        }
+        ofpbuf_delete(reply);
+    }
+    free(iov);
+
+    for (i = 0; i < n; i++) {
+        if (errors[i] == -1) {
+            errors[i] = retval;
+        }
+    }
+    return retval;
+}
+
 /* Causes poll_block() to wake up when any of the specified 'events' (which is
  * a OR'd combination of POLLIN, POLLOUT, etc.) occur on 'sock'. */
 void
@@ -666,6 +790,27 @@ nl_msg_put_nested(struct ofpbuf *msg,
     nl_msg_put_unspec(msg, type, nested_msg->data, nested_msg->size);
 }
 
+/* Appends the header of a Netlink attribute of the given 'type' to 'msg',
+ * for attributes nested within it, and returns the offset of the header,
+ * which must be passed to nl_msg_end_nested() after the nested attributes
+ * have been appended. */
+size_t
+nl_msg_start_nested(struct ofpbuf *msg, uint16_t type)
+{
+    size_t offset = msg->size;
+    nl_msg_put_unspec_uninit(msg, type, 0);
+    return offset;
+}
+
+/* Finishes the nested attribute of 'msg' that nl_msg_start_nested() began at
+ * 'offset', by setting its length to cover everything appended since. */
+void
+nl_msg_end_nested(struct ofpbuf *msg, size_t offset)
+{
+    struct nlattr *nla = ofpbuf_at_assert(msg, offset, sizeof *nla);
+    nla->nla_len = msg->size - offset;
+}
+
 /* Returns the first byte in the payload of attribute 'nla'. */
 const void *
 nl_attr_get(const struct nlattr *nla) 
@@ -64,6 +64,8 @@ int nl_sock_sendv(struct nl_sock *sock, const struct iovec iov[], size_t n_iov,
 int nl_sock_recv(struct nl_sock *, struct ofpbuf **, bool wait);
 int nl_sock_transact(struct nl_sock *, const struct ofpbuf *request,
                      struct ofpbuf **reply);
+int nl_sock_transact_batch(struct nl_sock *, struct ofpbuf *requests[],
+                           size_t n, int errors[]);
 
 void nl_sock_wait(const struct nl_sock *, short int events);
 
@@ -95,6 +97,8 @@ void nl_msg_put_u32(struct ofpbuf *, uint16_t type, uint32_t value);
 void nl_msg_put_u64(struct ofpbuf *, uint16_t type, uint64_t value);
 void nl_msg_put_string(struct ofpbuf *, uint16_t type, const char *value);
 void nl_msg_put_nested(struct ofpbuf *, uint16_t type, struct ofpbuf *);
+size_t nl_msg_start_nested(struct ofpbuf *, uint16_t type);
+void nl_msg_end_nested(struct ofpbuf *, size_t offset);
 
 /* Netlink attribute types. */
 enum nl_attr_type
@@ -96,6 +96,12 @@ AC_DEFUN([OFP_CHECK_FAULT_LIBS],
   [AC_CHECK_LIB([dl], [dladdr], [FAULT_LIBS=-ldl])
    AC_SUBST([FAULT_LIBS])])
 
+dnl Checks for the threads library needed by the forwarding threads of
+dnl udatapath.
+AC_DEFUN([OFP_CHECK_PTHREAD_LIBS],
+  [AC_CHECK_LIB([pthread], [pthread_create], [PTHREAD_LIBS=-lpthread])
+   AC_SUBST([PTHREAD_LIBS])])
+
 dnl Checks for libraries needed by lib/socket-util.c.
 AC_DEFUN([OFP_CHECK_SOCKET_LIBS],
   [AC_CHECK_LIB([socket], [connect])
@@ -14,6 +14,111 @@ noinst_PROGRAMS += tests/test-list
 tests_test_list_SOURCES = tests/test-list.c
 tests_test_list_LDADD = lib/libopenflow.a
 
+TESTS += tests/test-table-tss
+noinst_PROGRAMS += tests/test-table-tss
+tests_test_table_tss_SOURCES = \
+	tests/test-table-tss.c \
+	udatapath/switch-flow.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_test_table_tss_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_test_table_tss_LDADD = lib/libopenflow.a
+
+TESTS += tests/test-table-cuckoo
+noinst_PROGRAMS += tests/test-table-cuckoo
+tests_test_table_cuckoo_SOURCES = \
+	tests/test-table-cuckoo.c \
+	udatapath/switch-flow.c \
+	udatapath/table-cuckoo.c
+tests_test_table_cuckoo_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_test_table_cuckoo_LDADD = lib/libopenflow.a
+
+TESTS += tests/test-flow-expiry
+noinst_PROGRAMS += tests/test-flow-expiry
+tests_test_flow_expiry_SOURCES = \
+	tests/test-flow-expiry.c \
+	udatapath/switch-flow.c
+tests_test_flow_expiry_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_test_flow_expiry_LDADD = lib/libopenflow.a
+
+TESTS += tests/test-flow-match
+noinst_PROGRAMS += tests/test-flow-match
+tests_test_flow_match_SOURCES = \
+	tests/test-flow-match.c \
+	udatapath/switch-flow.c
+tests_test_flow_match_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_test_flow_match_LDADD = lib/libopenflow.a
+
+TESTS += tests/test-dp-buffer
+noinst_PROGRAMS += tests/test-dp-buffer
+tests_test_dp_buffer_SOURCES = \
+	tests/test-dp-buffer.c \
+	udatapath/dp_buffer.c
+tests_test_dp_buffer_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_test_dp_buffer_LDADD = lib/libopenflow.a
+
+TESTS += tests/test-chain-cache
+noinst_PROGRAMS += tests/test-chain-cache
+tests_test_chain_cache_SOURCES = \
+	tests/test-chain-cache.c \
+	udatapath/chain.c \
+	udatapath/switch-flow.c \
+	udatapath/table-cuckoo.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_test_chain_cache_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_test_chain_cache_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-tables
+tests_bench_tables_SOURCES = \
+	tests/bench-tables.c \
+	udatapath/crc32.c \
+	udatapath/switch-flow.c \
+	udatapath/table-cuckoo.c \
+	udatapath/table-hash.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_bench_tables_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_bench_tables_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-netdev
+tests_bench_netdev_SOURCES = tests/bench-netdev.c
+tests_bench_netdev_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-queues
+tests_bench_queues_SOURCES = tests/bench-queues.c
+tests_bench_queues_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-flow-cache
+tests_bench_flow_cache_SOURCES = \
+	tests/bench-flow-cache.c \
+	udatapath/chain.c \
+	udatapath/switch-flow.c \
+	udatapath/table-cuckoo.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_bench_flow_cache_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_bench_flow_cache_LDADD = lib/libopenflow.a
+
+noinst_PROGRAMS += tests/bench-stats-dump
+tests_bench_stats_dump_SOURCES = \
+	tests/bench-stats-dump.c \
+	udatapath/chain.c \
+	udatapath/crc32.c \
+	udatapath/datapath.c \
+	udatapath/dp_act.c \
+	udatapath/dp_buffer.c \
+	udatapath/dp_worker.c \
+	udatapath/of_ext_msg.c \
+	udatapath/private-msg.c \
+	udatapath/switch-flow.c \
+	udatapath/table-cuckoo.c \
+	udatapath/table-hash.c \
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
+tests_bench_stats_dump_CPPFLAGS = $(AM_CPPFLAGS) -I$(srcdir)/udatapath
+tests_bench_stats_dump_LDADD = lib/libopenflow.a $(SSL_LIBS) $(PTHREAD_LIBS)
+
 TESTS += tests/test-type-props
 noinst_PROGRAMS += tests/test-type-props
 tests_test_type_props_SOURCES = tests/test-type-props.c
@@ -0,0 +1,171 @@
+/* Measures the effect of the microflow cache of a udatapath chain.
+ *
+ * Installs R wildcarded rules into a chain, then looks up a trace of packets
+ * from F distinct microflows whose popularity follows a Zipf distribution
+ * with exponent 1, as in typical traffic mixes, once with the cache disabled
+ * and once with it enabled.  Run as
+ *
+ *   tests/bench-flow-cache [rules] [microflows] [packets]
+ */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chain.h"
+#include "datapath.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "random.h"
+#include "switch-flow.h"
+#include "table.h"
+#include "timeval.h"
+#include "util.h"
+
+void
+dp_send_flow_end(struct datapath *dp UNUSED, struct sw_flow *flow UNUSED,
+                 enum ofp_flow_removed_reason reason UNUSED)
+{
+}
+
+/* Fills 'match' with a rule on the IP protocol, a destination prefix of 8 to
+ * 32 bits and possibly the destination port. */
+static void
+random_rule(struct ofp_match *match)
+{
+    uint32_t w;
+
+    memset(match, 0, sizeof *match);
+    match->dl_type = htons(ETH_TYPE_IP);
+    match->nw_proto = random_range(2) ? IPPROTO_TCP : IPPROTO_UDP;
+    match->nw_dst = htonl(0x0a000000 | random_range(1 << 16) << 8);
+    match->tp_dst = htons(random_range(64));
+
+    w = OFPFW_ALL & ~(OFPFW_DL_TYPE | OFPFW_NW_PROTO | OFPFW_NW_DST_MASK);
+    w |= random_range(25) << OFPFW_NW_DST_SHIFT;
+    if (random_range(2))
+        w &= ~OFPFW_TP_DST;
+    match->wildcards = htonl(w);
+}
+
+/* Returns a random microflow that is likely to match rule 'match'. */
+static void
+random_microflow(struct sw_flow_key *key, const struct ofp_match *match)
+{
+    memset(key, 0, sizeof *key);
+    key->flow.in_port = htons(random_range(8) + 1);
+    key->flow.dl_type = match->dl_type;
+    key->flow.nw_proto = match->nw_proto;
+    key->flow.nw_src = htonl(0xc0a80000 | random_range(1 << 16));
+    key->flow.nw_dst = match->nw_dst;
+    key->flow.tp_src = htons(1024 + random_range(60000));
+    key->flow.tp_dst = match->tp_dst;
+}
+
+/* Fills 'trace' with 'n' indexes into 'n_flows' microflows, of which the
+ * i-th is chosen with a probability proportional to 1 / (i + 1). */
+static void
+zipf_trace(unsigned int *trace, unsigned long int n, unsigned int n_flows)
+{
+    double *cdf = xmalloc(n_flows * sizeof *cdf);
+    double sum = 0;
+    unsigned long int i;
+
+    for (i = 0; i < n_flows; i++) {
+        sum += 1.0 / (i + 1);
+        cdf[i] = sum;
+    }
+    for (i = 0; i < n; i++) {
+        double x = random_uint32() / (double) UINT32_MAX * sum;
+        unsigned int lo = 0, hi = n_flows - 1;
+
+        while (lo < hi) {
+            unsigned int mid = (lo + hi) / 2;
+            if (cdf[mid] < x)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        trace[i] = lo;
+    }
+    free(cdf);
+}
+
+static void
+run(struct sw_chain *chain, const char *name, const struct sw_flow_key *flows,
+    const unsigned int *trace, unsigned long int n_packets)
+{
+    struct sw_table_stats stats;
+    unsigned long int i, n_matched;
+    long long int start, elapsed;
+
+    n_matched = 0;
+    time_refresh();
+    start = time_msec();
+    for (i = 0; i < n_packets; i++)
+        n_matched += chain_lookup(chain, &flows[trace[i]], 0) != NULL;
+    time_refresh();
+    elapsed = MAX(time_msec() - start, 1);
+
+    printf("%-10s %12.0f lookups/s  (%lu%% matched", name,
+           n_packets * 1000.0 / elapsed, n_matched * 100 / n_packets);
+    if (chain->cache) {
+        chain_cache_stats(chain, chain->cache, &stats);
+        printf(", %.1f%% cache hits",
+               stats.n_matched * 100.0 / MAX(stats.n_lookup, 1));
+    }
+    printf(")\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int n_rules = argc > 1 ? atoi(argv[1]) : 10000;
+    unsigned int n_flows = argc > 2 ? atoi(argv[2]) : 100000;
+    unsigned long int n_packets = argc > 3 ? atol(argv[3]) : 5000000;
+    struct ofp_match *rules;
+    struct sw_flow_key *flows;
+    struct sw_chain *chain;
+    unsigned int *trace;
+    unsigned int i;
+
+    if (!n_rules || !n_flows || !n_packets)
+        ofp_fatal(0, "usage: %s [rules] [microflows] [packets]", argv[0]);
+
+    time_init();
+    random_init();
+
+    chain = chain_create(NULL);
+    rules = xmalloc(n_rules * sizeof *rules);
+    for (i = 0; i < n_rules; i++) {
+        struct sw_flow *flow = flow_alloc(0);
+
+        random_rule(&rules[i]);
+        flow_extract_match(&flow->key, &rules[i]);
+        flow->priority = random_range(65535) + 1;
+        flow_setup_actions(flow, NULL, 0);
+        if (chain_insert(chain, flow, 0))
+            flow_free(flow);
+    }
+
+    flows = xmalloc(n_flows * sizeof *flows);
+    for (i = 0; i < n_flows; i++)
+        random_microflow(&flows[i], &rules[random_range(n_rules)]);
+    trace = xmalloc(n_packets * sizeof *trace);
+    zipf_trace(trace, n_packets, n_flows);
+
+    printf("%u rules, %u microflows, %lu packets\n",
+           n_rules, n_flows, n_packets);
+    chain_set_cache_size(chain, 0);
+    run(chain, "no cache", flows, trace, n_packets);
+    chain_set_cache_size(chain, CHAIN_CACHE_ENTRIES);
+    run(chain, "cache", flows, trace, n_packets);
+
+    chain_destroy(chain);
+    free(rules);
+    free(flows);
+    free(trace);
+    return 0;
+}
@@ -0,0 +1,117 @@
+/* Measures the packet rate between two network devices, typically the two
+ * ends of a veth pair, with ordinary socket I/O or with memory-mapped packet
+ * rings (by giving the device names an "mmap:" prefix).  Run as root, e.g. in
+ * a network namespace of its own:
+ *
+ *   unshare -n sh -c 'ip link add a type veth peer name b &&
+ *                     tests/bench-netdev a b &&
+ *                     tests/bench-netdev mmap:a mmap:b'
+ *
+ * Sends minimum-size frames on the first device as fast as it accepts them
+ * and receives them on the second. */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "netdev.h"
+#include "ofpbuf.h"
+#include "packets.h"
+#include "timeval.h"
+#include "util.h"
+
+/* IEEE 802 local experimental Ethertype, which the host stack ignores. */
+#define ETH_TYPE_BENCH 0x88b5
+
+#define BURST 64
+
+static struct netdev *
+open_netdev(const char *name)
+{
+    struct netdev *netdev;
+    int error;
+
+    error = netdev_open(name, NETDEV_ETH_TYPE_ANY, &netdev);
+    if (error) {
+        ofp_fatal(error, "%s: open failed", name);
+    }
+    error = netdev_turn_flags_on(netdev, NETDEV_UP | NETDEV_PROMISC, false);
+    if (error) {
+        ofp_fatal(error, "%s: failed to bring up device", name);
+    }
+    return netdev;
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned long int n_packets, n_sent, n_dropped, n_received;
+    struct netdev *tx, *rx;
+    struct eth_header *eh;
+    struct ofpbuf packet, *buffer;
+    long long int start, last_busy, elapsed;
+
+    if (argc < 3) {
+        ofp_fatal(0, "usage: %s TX-NETDEV RX-NETDEV [packets]", argv[0]);
+    }
+    n_packets = argc > 3 ? atol(argv[3]) : 2000000;
+
+    time_init();
+    tx = open_netdev(argv[1]);
+    rx = open_netdev(argv[2]);
+    netdev_drain(rx);
+
+    ofpbuf_init(&packet, ETH_TOTAL_MIN);
+    eh = ofpbuf_put_zeros(&packet, ETH_TOTAL_MIN);
+    memset(eh->eth_dst, 0xff, ETH_ADDR_LEN);
+    memcpy(eh->eth_src, netdev_get_etheraddr(tx), ETH_ADDR_LEN);
+    eh->eth_type = htons(ETH_TYPE_BENCH);
+
+    buffer = ofpbuf_new(VLAN_ETH_HEADER_LEN + netdev_get_mtu(rx));
+    n_sent = n_dropped = n_received = 0;
+    time_refresh();
+    start = last_busy = time_msec();
+    for (;;) {
+        unsigned long int n_before = n_received;
+        int i, error;
+
+        for (i = 0; i < BURST && n_sent + n_dropped < n_packets; i++) {
+            if (!netdev_send(tx, &packet, 0)) {
+                n_sent++;
+            } else {
+                n_dropped++;
+            }
+        }
+        netdev_flush(tx);
+
+        while (!(error = netdev_recv(rx, buffer))) {
+            n_received++;
+            ofpbuf_clear(buffer);
+        }
+        if (error != EAGAIN) {
+            ofp_fatal(error, "%s: receive failed", argv[2]);
+        }
+
+        /* Stop when everything has been sent and either received or lost. */
+        time_refresh();
+        if (i || n_received != n_before) {
+            last_busy = time_msec();
+        } else if (n_received >= n_sent || time_msec() - last_busy > 100) {
+            break;
+        }
+    }
+    elapsed = MAX(last_busy - start, 1);
+
+    printf("%s -> %s: %lu sent (%.0f pps), %lu refused, "
+           "%lu received (%.0f pps)\n",
+           argv[1], argv[2], n_sent, n_sent * 1000.0 / elapsed, n_dropped,
+           n_received, n_received * 1000.0 / elapsed);
+
+    ofpbuf_delete(buffer);
+    ofpbuf_uninit(&packet);
+    netdev_close(tx);
+    netdev_close(rx);
+    return 0;
+}
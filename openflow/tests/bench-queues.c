@@ -0,0 +1,104 @@
+/* Measures how long it takes to configure OpenFlow queues (HTB classes) on
+ * network devices, as the userspace datapath does when it adds ports and
+ * when a controller adds, changes and deletes queues.  Run as root, e.g. in
+ * a network namespace of its own:
+ *
+ *   unshare -n sh -c 'ip link add a type veth peer name b &&
+ *                     tests/bench-queues a b'
+ *
+ * The queues are left configured, so that the result can be checked with
+ * "tc class show". */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include "netdev.h"
+#include "timeval.h"
+#include "util.h"
+
+#define N_QUEUES 8
+
+static long long int
+elapsed_usec(const struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) * 1000000LL
+           + (now.tv_usec - start->tv_usec);
+}
+
+int
+main(int argc, char *argv[])
+{
+    long long int setup, add, change, delete;
+    struct netdev **netdevs;
+    struct timeval start;
+    int n_ops, n_replaced, i, j;
+
+    if (argc < 2) {
+        ofp_fatal(0, "usage: %s NETDEV...", argv[0]);
+    }
+
+    time_init();
+    netdevs = xmalloc((argc - 1) * sizeof *netdevs);
+    for (i = 1; i < argc; i++) {
+        int error = netdev_open(argv[i], NETDEV_ETH_TYPE_NONE,
+                                &netdevs[i - 1]);
+        if (error) {
+            ofp_fatal(error, "%s: open failed", argv[i]);
+        }
+    }
+
+    setup = add = change = delete = 0;
+    n_replaced = 0;
+    for (i = 0; i < argc - 1; i++) {
+        gettimeofday(&start, NULL);
+        if (netdev_setup_slicing(netdevs[i], N_QUEUES)) {
+            ofp_fatal(0, "%s: failed to set up queues", argv[i + 1]);
+        }
+        setup += elapsed_usec(&start);
+
+        /* Add every queue, change it, delete half of them and add them
+         * back. */
+        gettimeofday(&start, NULL);
+        for (j = 1; j < N_QUEUES; j++) {
+            if (netdev_setup_class(netdevs[i], j, 100)) {
+                ofp_fatal(0, "%s: failed to add queue %d", argv[i + 1], j);
+            }
+        }
+        add += elapsed_usec(&start);
+
+        gettimeofday(&start, NULL);
+        for (j = 1; j < N_QUEUES; j++) {
+            if (netdev_change_class(netdevs[i], j, 50 + j)) {
+                ofp_fatal(0, "%s: failed to change queue %d", argv[i + 1], j);
+            }
+        }
+        change += elapsed_usec(&start);
+
+        gettimeofday(&start, NULL);
+        for (j = 1; j < N_QUEUES; j += 2) {
+            if (netdev_delete_class(netdevs[i], j)
+                || netdev_setup_class(netdevs[i], j, 100)) {
+                ofp_fatal(0, "%s: failed to replace queue %d",
+                          argv[i + 1], j);
+            }
+            n_replaced++;
+        }
+        delete += elapsed_usec(&start);
+    }
+
+    n_ops = (argc - 1) * (N_QUEUES - 1);
+    printf("%d devices: %.0f us per device setup, %.0f us per queue add, "
+           "%.0f us per change, %.0f us per delete and re-add\n",
+           argc - 1, (double) setup / (argc - 1), (double) add / n_ops,
+           (double) change / n_ops, (double) delete / n_replaced);
+
+    for (i = 0; i < argc - 1; i++) {
+        netdev_close(netdevs[i]);
+    }
+    free(netdevs);
+    return 0;
+}
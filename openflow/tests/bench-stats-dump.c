@@ -0,0 +1,216 @@
+/* Measures how much a large flow statistics dump holds up packet forwarding
+ * in udatapath.
+ *
+ * Installs F exact-match flows, connects to the datapath over a Unix domain
+ * socket and asks for flow and aggregate statistics, once over all flows and
+ * once over the few flows that come in on one port, while the datapath keeps
+ * running.  Since the main loop forwards packets in between the calls to
+ * dp_run(), the longest calls and their 99th percentile show the delay that
+ * packets see while a reply is composed.  Each request runs with a dump
+ * budget of B flows per call, then without a budget.  Run as
+ *
+ *   tests/bench-stats-dump [flows] [budget]
+ */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "chain.h"
+#include "datapath.h"
+#include "ofpbuf.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "poll-loop.h"
+#include "switch-flow.h"
+#include "timeval.h"
+#include "util.h"
+#include "vconn.h"
+
+char mfr_desc[DESC_STR_LEN] = "Stanford University";
+char hw_desc[DESC_STR_LEN] = "Reference Userspace Switch";
+char sw_desc[DESC_STR_LEN] = VERSION BUILDNR;
+char dp_desc[DESC_STR_LEN] = "";
+char serial_num[SERIAL_NUM_LEN] = "None";
+
+/* Flows come in on this many ports, evenly. */
+#define N_PORTS 64
+
+static long long int
+clock_usec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+static void
+add_flows(struct datapath *dp, unsigned int n_flows)
+{
+    unsigned int i;
+
+    for (i = 0; i < n_flows; i++) {
+        struct sw_flow *flow = flow_alloc(0);
+
+        flow->key.flow.in_port = htons(i % N_PORTS + 1);
+        flow->key.flow.dl_type = htons(ETH_TYPE_IP);
+        flow->key.flow.nw_proto = IPPROTO_UDP;
+        flow->key.flow.nw_src = htonl(0xc0a80000 | (i >> 16));
+        flow->key.flow.nw_dst = htonl(0x0a000000 | (i & 0xffff));
+        flow->key.flow.tp_src = htons(1024);
+        flow->key.flow.tp_dst = htons(53);
+        flow->priority = OFP_DEFAULT_PRIORITY;
+        flow_setup_actions(flow, NULL, 0);
+        flow->created = flow->used = time_msec();
+        if (chain_insert(dp->chain, flow, 0))
+            ofp_fatal(0, "could not insert flow %u", i);
+        flow_add_counts(flow, 1, 64);
+    }
+}
+
+static int
+compare_llongs(const void *a_, const void *b_)
+{
+    const long long int *a = a_, *b = b_;
+    return *a < *b ? -1 : *a > *b;
+}
+
+/* Sends a request of 'type' for the flows that come in on 'in_port', or for
+ * all flows if 'in_port' is OFPP_NONE, and keeps the datapath running until
+ * the reply is complete. */
+static void
+run(struct datapath *dp, struct vconn *vconn, uint16_t type, uint16_t in_port,
+    const char *name)
+{
+    struct ofp_flow_stats_request *fsr;
+    struct ofp_stats_request *osr;
+    long long int *turns, start;
+    unsigned int n_turns, max_turns, n_flows;
+    struct ofpbuf *request;
+    bool done;
+
+    osr = make_openflow(sizeof *osr + sizeof *fsr, OFPT_STATS_REQUEST,
+                        &request);
+    osr->type = htons(type);
+    osr->flags = 0;
+    fsr = (struct ofp_flow_stats_request *) osr->body;
+    memset(fsr, 0, sizeof *fsr);
+    fsr->match.wildcards = htonl(OFPFW_ALL);
+    if (in_port != OFPP_NONE) {
+        fsr->match.wildcards = htonl(OFPFW_ALL & ~OFPFW_IN_PORT);
+        fsr->match.in_port = htons(in_port);
+    }
+    fsr->table_id = 0xff;
+    fsr->out_port = htons(OFPP_NONE);
+    if (vconn_send(vconn, request))
+        ofp_fatal(0, "could not send request");
+
+    max_turns = 1024;
+    turns = xmalloc(max_turns * sizeof *turns);
+    n_turns = n_flows = 0;
+    done = false;
+    start = clock_usec();
+    while (!done) {
+        struct ofpbuf *reply;
+        long long int turn = clock_usec();
+
+        dp_run(dp);
+        if (n_turns >= max_turns) {
+            max_turns *= 2;
+            turns = xrealloc(turns, max_turns * sizeof *turns);
+        }
+        turns[n_turns++] = clock_usec() - turn;
+        dp_wait(dp);
+        vconn_recv_wait(vconn);
+        poll_block();
+
+        while (!vconn_recv(vconn, &reply)) {
+            struct ofp_stats_reply *rpy = reply->data;
+            struct ofp_aggregate_stats_reply *asr;
+
+            if (rpy->header.type == OFPT_STATS_REPLY) {
+                size_t body_len = reply->size - sizeof *rpy;
+                if (type == OFPST_FLOW) {
+                    n_flows += body_len / sizeof(struct ofp_flow_stats);
+                } else if (body_len >= sizeof *asr) {
+                    asr = (struct ofp_aggregate_stats_reply *) rpy->body;
+                    n_flows = ntohl(asr->flow_count);
+                }
+                done = !(ntohs(rpy->flags) & OFPSF_REPLY_MORE);
+            }
+            ofpbuf_delete(reply);
+        }
+    }
+
+    qsort(turns, n_turns, sizeof *turns, compare_llongs);
+    printf("%-28s %7u flows in %7.1f ms, %5u turns, "
+           "99%% %6lld us, max %6lld us\n",
+           name, n_flows, (clock_usec() - start) / 1000.0, n_turns,
+           turns[n_turns * 99 / 100], turns[n_turns - 1]);
+    free(turns);
+}
+
+static void
+run_all(struct datapath *dp, struct vconn *vconn, unsigned int budget)
+{
+    dp_set_dump_budget(dp, budget, 0);
+    printf("%s:\n", budget ? "with budget" : "without budget");
+    run(dp, vconn, OFPST_FLOW, OFPP_NONE, "  flow stats, all flows");
+    run(dp, vconn, OFPST_FLOW, 1, "  flow stats, one port");
+    run(dp, vconn, OFPST_AGGREGATE, OFPP_NONE, "  aggregate, all flows");
+    run(dp, vconn, OFPST_AGGREGATE, 1, "  aggregate, one port");
+}
+
+int
+main(int argc, char *argv[])
+{
+    unsigned int n_flows = argc > 1 ? atoi(argv[1]) : 100000;
+    unsigned int budget = argc > 2 ? atoi(argv[2]) : DP_DUMP_FLOWS;
+    char pvconn_name[64], vconn_name[64];
+    struct pvconn *pvconn;
+    struct datapath *dp;
+    struct vconn *vconn;
+    int error;
+
+    if (!n_flows || !budget)
+        ofp_fatal(0, "usage: %s [flows] [budget]", argv[0]);
+
+    time_init();
+    error = dp_new(&dp, 0);
+    if (error)
+        ofp_fatal(error, "could not create datapath");
+    add_flows(dp, n_flows);
+
+    snprintf(pvconn_name, sizeof pvconn_name,
+             "punix:/tmp/bench-stats-dump.%ld", (long int) getpid());
+    error = pvconn_open(pvconn_name, &pvconn);
+    if (error)
+        ofp_fatal(error, "%s: could not listen", pvconn_name);
+    dp_add_pvconn(dp, pvconn);
+    snprintf(vconn_name, sizeof vconn_name, "%s", pvconn_name + 1);
+    error = vconn_open(vconn_name, OFP_VERSION, &vconn);
+    if (error)
+        ofp_fatal(error, "%s: could not connect", vconn_name);
+    while ((error = vconn_connect(vconn)) == EAGAIN) {
+        dp_run(dp);
+        dp_wait(dp);
+        vconn_connect_wait(vconn);
+        poll_block();
+    }
+    if (error)
+        ofp_fatal(error, "%s: could not connect", vconn_name);
+
+    printf("%u flows, dump budget of %u flows\n", n_flows, budget);
+    run_all(dp, vconn, budget);
+    run_all(dp, vconn, 0);
+
+    vconn_close(vconn);
+    unlink(pvconn_name + 6);
+    return 0;
+}
@@ -0,0 +1,190 @@
+/* Measures the lookup rate of the udatapath flow tables.
+ *
+ * Fills a wildcard table (linear, tss) with N ACL-style rules drawn from a
+ * few dozen distinct wildcard masks, or an exact-match table (hash2, cuckoo)
+ * with N microflows, and looks up packets of which about half hit a rule.
+ * Run as
+ *
+ *   tests/bench-tables [linear|tss|hash2|cuckoo] [rules] [lookups]
+ *
+ * Without arguments all tables are measured with 100, 10000 and 100000
+ * rules. */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "datapath.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "random.h"
+#include "switch-flow.h"
+#include "table.h"
+#include "timeval.h"
+#include "util.h"
+
+#define N_PACKETS 4096
+
+void
+dp_send_flow_end(struct datapath *dp UNUSED, struct sw_flow *flow UNUSED,
+                 enum ofp_flow_removed_reason reason UNUSED)
+{
+}
+
+/* Fills 'match' with a rule that matches on the IP protocol, a prefix of the
+ * source and destination addresses, and possibly the input port and the
+ * transport ports.  The choice of fields and prefix lengths yields 48
+ * different masks. */
+static void
+random_rule(struct ofp_match *match)
+{
+    static const int src_bits[] = { 8, 16, 24, 32 };
+    static const int dst_bits[] = { 16, 24, 32 };
+    uint32_t w;
+
+    memset(match, 0, sizeof *match);
+    match->in_port = htons(random_range(48) + 1);
+    match->dl_type = htons(ETH_TYPE_IP);
+    match->nw_proto = random_range(2) ? IPPROTO_TCP : IPPROTO_UDP;
+    match->nw_src = htonl(0x0a000000 | random_range(1 << 24));
+    match->nw_dst = htonl(0xc0000000 | random_range(1 << 24));
+    match->tp_src = htons(random_range(65536));
+    match->tp_dst = htons(random_range(1024));
+
+    w = OFPFW_ALL & ~(OFPFW_DL_TYPE | OFPFW_NW_PROTO | OFPFW_NW_SRC_MASK
+                      | OFPFW_NW_DST_MASK);
+    w |= (32 - src_bits[random_range(ARRAY_SIZE(src_bits))])
+         << OFPFW_NW_SRC_SHIFT;
+    w |= (32 - dst_bits[random_range(ARRAY_SIZE(dst_bits))])
+         << OFPFW_NW_DST_SHIFT;
+    switch (random_range(4)) {
+    case 0:
+        break;
+    case 1:
+        w &= ~OFPFW_IN_PORT;
+        break;
+    case 2:
+        w &= ~OFPFW_TP_DST;
+        break;
+    case 3:
+        w &= ~(OFPFW_IN_PORT | OFPFW_TP_SRC | OFPFW_TP_DST);
+        break;
+    }
+    match->wildcards = htonl(w);
+}
+
+static void
+packet_from_match(struct sw_flow_key *key, const struct ofp_match *match)
+{
+    memset(key, 0, sizeof *key);
+    key->flow.in_port = match->in_port;
+    key->flow.dl_type = match->dl_type;
+    key->flow.nw_proto = match->nw_proto;
+    key->flow.nw_src = match->nw_src;
+    key->flow.nw_dst = match->nw_dst;
+    key->flow.tp_src = match->tp_src;
+    key->flow.tp_dst = match->tp_dst;
+}
+
+static struct sw_table *
+create_table(const char *type, unsigned int n_rules)
+{
+    if (!strcmp(type, "linear"))
+        return table_linear_create(n_rules);
+    else if (!strcmp(type, "tss"))
+        return table_tss_create(n_rules);
+    else if (!strcmp(type, "hash2"))
+        /* As in chain_create() before the cuckoo table. */
+        return table_hash2_create(0x1EDC6F41, 65536, 0x741B8CD7, 65536);
+    else if (!strcmp(type, "cuckoo"))
+        return table_cuckoo_create(4096, n_rules);
+    ofp_fatal(0, "unknown table type %s", type);
+}
+
+static void
+run(const char *type, unsigned int n_rules, unsigned long int n_lookups)
+{
+    struct sw_flow_key *packets;
+    struct sw_table *table;
+    unsigned long int i, n_matched, n_refused;
+    long long int start, elapsed;
+    bool exact;
+
+    table = create_table(type, n_rules);
+    exact = !strcmp(type, "hash2") || !strcmp(type, "cuckoo");
+    packets = xmalloc(N_PACKETS * sizeof *packets);
+
+    n_refused = 0;
+    for (i = 0; i < n_rules; i++) {
+        struct ofp_match match;
+        struct sw_flow *flow;
+
+        random_rule(&match);
+        if (exact)
+            match.wildcards = 0;
+        flow = flow_alloc(0);
+        flow_extract_match(&flow->key, &match);
+        flow->priority = random_range(65535) + 1;
+        flow_setup_actions(flow, NULL, 0);
+        if (!table->insert(table, flow)) {
+            flow_free(flow);
+            n_refused++;
+        }
+
+        /* Every other packet is a hit, the others are most likely misses. */
+        if (i < N_PACKETS) {
+            if (i % 2)
+                random_rule(&match);
+            packet_from_match(&packets[i], &match);
+        }
+    }
+    for (; i < N_PACKETS; i++)
+        packets[i] = packets[i % n_rules];
+
+    n_matched = 0;
+    time_refresh();
+    start = time_msec();
+    for (i = 0; i < n_lookups; i++)
+        n_matched += table->lookup(table, &packets[i % N_PACKETS]) != NULL;
+    time_refresh();
+    elapsed = MAX(time_msec() - start, 1);
+
+    printf("%-8s %7u rules %12.0f lookups/s  (%lu%% hit, %lu refused)\n",
+           type, n_rules, n_lookups * 1000.0 / elapsed,
+           n_matched * 100 / n_lookups, n_refused);
+
+    table->destroy(table);
+    free(packets);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const unsigned int sizes[] = { 100, 10000, 100000 };
+    size_t i;
+
+    time_init();
+    random_init();
+
+    if (argc > 1) {
+        unsigned int n_rules = argc > 2 ? atoi(argv[2]) : 10000;
+        unsigned long int n_lookups = argc > 3 ? atol(argv[3]) : 1000000;
+        if (!n_rules || !n_lookups) {
+            ofp_fatal(0, "usage: %s [linear|tss|hash2|cuckoo] [rules] "
+                      "[lookups]", argv[0]);
+        }
+        run(argv[1], n_rules, n_lookups);
+        return 0;
+    }
+
+    for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+        /* The linear table is too slow for as many lookups. */
+        run("linear", sizes[i], 100000000 / sizes[i]);
+        run("tss", sizes[i], 2000000);
+        run("hash2", sizes[i], 10000000);
+        run("cuckoo", sizes[i], 10000000);
+    }
+    return 0;
+}
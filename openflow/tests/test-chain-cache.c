@@ -0,0 +1,286 @@
+/* Tests that the microflow cache of a udatapath chain never returns a flow
+ * that a lookup in the tables would not return. */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "chain.h"
+#include "datapath.h"
+#include "list.h"
+#include "ofpbuf.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "switch-flow.h"
+#include "table.h"
+#include "timeval.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+/* Flows are not reported to anybody here. */
+void
+dp_send_flow_end(struct datapath *dp UNUSED, struct sw_flow *flow UNUSED,
+                 enum ofp_flow_removed_reason reason UNUSED)
+{
+}
+
+static void
+make_packet(struct sw_flow_key *key, uint16_t tp_dst)
+{
+    memset(key, 0, sizeof *key);
+    key->flow.in_port = htons(1);
+    key->flow.dl_type = htons(ETH_TYPE_IP);
+    key->flow.nw_proto = IPPROTO_TCP;
+    key->flow.nw_src = htonl(0xc0a80001);
+    key->flow.nw_dst = htonl(0x0a010203);
+    key->flow.tp_src = htons(12345);
+    key->flow.tp_dst = htons(tp_dst);
+}
+
+/* Inserts a flow into 'chain' that matches packets to 10.0.0.0/8 and, if
+ * 'tp_dst' is nonzero, to that TCP port. */
+static struct sw_flow *
+insert_rule(struct sw_chain *chain, uint16_t tp_dst, uint16_t priority)
+{
+    struct ofp_match match;
+    struct sw_flow *flow;
+    uint32_t w;
+
+    memset(&match, 0, sizeof match);
+    match.dl_type = htons(ETH_TYPE_IP);
+    match.nw_proto = IPPROTO_TCP;
+    match.nw_dst = htonl(0x0a000000);
+    match.tp_dst = htons(tp_dst);
+    w = OFPFW_ALL & ~(OFPFW_DL_TYPE | OFPFW_NW_PROTO | OFPFW_NW_DST_MASK);
+    w |= 24 << OFPFW_NW_DST_SHIFT;
+    if (tp_dst)
+        w &= ~OFPFW_TP_DST;
+    match.wildcards = htonl(w);
+
+    flow = flow_alloc(0);
+    flow_extract_match(&flow->key, &match);
+    flow->priority = priority;
+    flow_setup_actions(flow, NULL, 0);
+    assert(!chain_insert(chain, flow, 0));
+    return flow;
+}
+
+static struct sw_flow *
+insert_exact(struct sw_chain *chain, const struct sw_flow_key *key)
+{
+    struct sw_flow *flow = flow_alloc(0);
+
+    flow->key = *key;
+    flow->priority = OFP_DEFAULT_PRIORITY;
+    flow_setup_actions(flow, NULL, 0);
+    assert(!chain_insert(chain, flow, 0));
+    return flow;
+}
+
+/* Looks up 'key' twice in 'chain', checking that the second lookup hits the
+ * cache, and returns the result. */
+static struct sw_flow *
+lookup(struct sw_chain *chain, const struct sw_flow_key *key)
+{
+    unsigned long long int n_hit;
+    struct sw_flow *flow;
+
+    flow = chain_lookup(chain, key, 0);
+    n_hit = chain->cache->n_hit;
+    assert(chain_lookup(chain, key, 0) == flow);
+    assert(chain->cache->n_hit == n_hit + (flow != NULL));
+    return flow;
+}
+
+/* Replaces 'flow' in 'chain' by a copy whose hard timeout has already
+ * passed, since tables take note of the timeouts on insertion, and returns
+ * the copy. */
+static struct sw_flow *
+make_expired(struct sw_chain *chain, struct sw_flow *flow)
+{
+    struct sw_flow *copy = flow_alloc(0);
+
+    copy->key = flow->key;
+    copy->priority = flow->priority;
+    flow_setup_actions(copy, NULL, 0);
+    copy->hard_timeout = 1;
+    copy->created = time_msec() - 5000;
+    assert(!chain_insert(chain, copy, 0));
+    return copy;
+}
+
+static void
+expire(struct sw_chain *chain, struct sw_flow *flow)
+{
+    struct list deleted = LIST_INITIALIZER(&deleted);
+    struct sw_flow *f, *n;
+    int n_deleted = 0;
+
+    chain_timeout(chain, &deleted);
+    LIST_FOR_EACH_SAFE (f, n, struct sw_flow, node, &deleted) {
+        assert(f == flow);
+        list_remove(&f->node);
+        flow_free(f);
+        n_deleted++;
+    }
+    assert(n_deleted == 1);
+}
+
+static void
+test_invalidation(void)
+{
+    struct sw_chain *chain = chain_create(NULL);
+    struct sw_flow *low, *high, *exact;
+    struct sw_flow_key key, other;
+
+    make_packet(&key, 80);
+    make_packet(&other, 443);
+    assert(lookup(chain, &key) == NULL);
+
+    low = insert_rule(chain, 0, 100);
+    assert(lookup(chain, &key) == low);
+    assert(lookup(chain, &other) == low);
+
+    /* A new flow of higher priority takes over. */
+    high = insert_rule(chain, 80, 200);
+    assert(lookup(chain, &key) == high);
+    assert(lookup(chain, &other) == low);
+
+    /* And so does an exact-match flow. */
+    exact = insert_exact(chain, &key);
+    assert(lookup(chain, &key) == exact);
+
+    /* Deleting it uncovers the wildcarded flow again. */
+    assert(chain_delete(chain, &key, htons(OFPP_NONE), 0, 1, 0) == 1);
+    assert(lookup(chain, &key) == high);
+
+    /* Modifications keep the flow. */
+    assert(chain_modify(chain, &high->key, 200, 1, NULL, 0, 0) == 1);
+    assert(lookup(chain, &key) == high);
+
+    /* Timeouts remove it. */
+    high = make_expired(chain, high);
+    assert(lookup(chain, &key) == high);
+    expire(chain, high);
+    assert(lookup(chain, &key) == low);
+    low = make_expired(chain, low);
+    assert(lookup(chain, &key) == low);
+    expire(chain, low);
+    assert(lookup(chain, &key) == NULL);
+    assert(lookup(chain, &other) == NULL);
+
+    chain_destroy(chain);
+}
+
+/* The table statistics are the same without a cache, with the chain's own
+ * cache, and with a private cache as forwarding threads use, once its
+ * counts have been folded into the tables. */
+static void
+test_table_stats(void)
+{
+    struct chain_cache *private = chain_cache_create(CHAIN_CACHE_ENTRIES);
+    struct sw_chain *chains[3];
+    int i, j;
+
+    for (i = 0; i < 3; i++) {
+        struct sw_flow_key key;
+
+        chains[i] = chain_create(NULL);
+        if (!i)
+            chain_set_cache_size(chains[i], 0);
+        insert_rule(chains[i], 0, 50);
+        insert_rule(chains[i], 80, 100);
+        make_packet(&key, 22);
+        insert_exact(chains[i], &key);
+        for (j = 0; j < 1000; j++) {
+            make_packet(&key, j % 100);
+            if (i < 2)
+                chain_lookup(chains[i], &key, 0);
+            else
+                chain_lookup_cached(chains[i], private, &key);
+        }
+    }
+    assert(chains[1]->cache->n_hit > 850);
+    assert(private->n_hit == chains[1]->cache->n_hit);
+    assert(chains[2]->cache->n_lookup == 0);
+
+    /* A private cache leaves the tables alone until it is folded. */
+    for (i = 0; i < chains[2]->n_tables; i++)
+        assert(chains[2]->tables[i]->n_lookup == 0);
+    chain_cache_fold(chains[2], private);
+
+    for (i = 0; i < chains[0]->n_tables; i++) {
+        struct sw_table_stats stats[3];
+
+        for (j = 0; j < 3; j++) {
+            struct sw_table *t = chains[j]->tables[i];
+            t->stats(t, &stats[j]);
+        }
+        for (j = 1; j < 3; j++) {
+            assert(stats[0].n_lookup == stats[j].n_lookup);
+            assert(stats[0].n_matched == stats[j].n_matched);
+        }
+    }
+
+    for (i = 0; i < 3; i++)
+        chain_destroy(chains[i]);
+    chain_cache_destroy(private);
+}
+
+/* The running totals of the tables follow the flows as they are used and
+ * removed. */
+static void
+test_totals(void)
+{
+    struct sw_chain *chain = chain_create(NULL);
+    struct sw_flow *rule, *exact;
+    struct sw_flow_key key;
+    struct ofpbuf packet;
+    int i;
+
+    make_packet(&key, 80);
+    rule = insert_rule(chain, 0, 100);
+    exact = insert_exact(chain, &key);
+    assert(rule->totals && exact->totals && rule->totals != exact->totals);
+
+    ofpbuf_init(&packet, 0);
+    ofpbuf_put_zeros(&packet, 100);
+    for (i = 0; i < 3; i++)
+        flow_used(rule, &packet);
+    flow_used(exact, &packet);
+    flow_add_counts(exact, 10, 1000);
+    assert(rule->totals->packet_count == 3);
+    assert(rule->totals->byte_count == 300);
+    assert(exact->totals->packet_count == 11);
+    assert(exact->totals->byte_count == 1100);
+
+    /* A replacement starts from zero. */
+    insert_exact(chain, &key);
+    assert(chain->tables[0]->totals.packet_count == 0);
+    assert(chain->tables[0]->totals.byte_count == 0);
+
+    assert(chain_delete(chain, &rule->key, htons(OFPP_NONE), 100, 1, 0) == 1);
+    for (i = 0; i < chain->n_tables; i++) {
+        assert(chain->tables[i]->totals.packet_count == 0);
+        assert(chain->tables[i]->totals.byte_count == 0);
+    }
+
+    ofpbuf_uninit(&packet);
+    chain_destroy(chain);
+}
+
+int
+main(void)
+{
+    time_init();
+
+    test_invalidation();
+    test_table_stats();
+    test_totals();
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/* Tests the store of packets that udatapath buffers for the controller. */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "dp_buffer.h"
+#include "ofpbuf.h"
+#include "timeval.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+/* Not a multiple of the slab size, to exercise the last, partial slab. */
+#define N_BUFFERS 1000
+
+static struct ofpbuf *
+make_packet(unsigned int n)
+{
+    struct ofpbuf *packet = ofpbuf_new(64);
+
+    ofpbuf_put(packet, &n, sizeof n);
+    ofpbuf_put_zeros(packet, 60 - sizeof n);
+    return packet;
+}
+
+static unsigned int
+packet_number(const struct ofpbuf *packet)
+{
+    unsigned int n;
+
+    assert(packet->size == 60);
+    memcpy(&n, packet->data, sizeof n);
+    return n;
+}
+
+static void
+check_stats(const struct dp_buffers *b, unsigned int n_used,
+            unsigned long long int n_refused,
+            unsigned long long int n_evicted,
+            unsigned long long int n_missed)
+{
+    struct dp_buffer_stats s;
+
+    dp_buffers_get_stats(b, &s);
+    assert(s.n_buffers == N_BUFFERS);
+    assert(s.n_slots <= N_BUFFERS);
+    assert(s.n_used == n_used);
+    assert(s.n_refused == n_refused);
+    assert(s.n_evicted == n_evicted);
+    assert(s.n_missed == n_missed);
+}
+
+int
+main(void)
+{
+    uint32_t ids[N_BUFFERS + 1];
+    struct dp_buffer_stats s;
+    struct dp_buffers *b;
+    struct ofpbuf *packet;
+    long long int deadline;
+    unsigned int i;
+
+    time_init();
+
+    b = dp_buffers_create(N_BUFFERS);
+    assert(dp_buffers_capacity(b) == N_BUFFERS);
+
+    /* The store grows only as far as needed. */
+    for (i = 0; i < 10; i++) {
+        packet = make_packet(i);
+        ids[i] = dp_buffers_save(b, packet);
+        assert(ids[i] != UINT32_MAX);
+        ofpbuf_delete(packet);
+    }
+    dp_buffers_get_stats(b, &s);
+    assert(s.n_slots < N_BUFFERS);
+    check_stats(b, 10, 0, 0, 0);
+
+    /* Packets come back once, by their own ids only. */
+    packet = dp_buffers_retrieve(b, ids[3]);
+    assert(packet_number(packet) == 3);
+    ofpbuf_delete(packet);
+    assert(!dp_buffers_retrieve(b, ids[3]));
+    assert(!dp_buffers_retrieve(b, UINT32_MAX));
+    assert(!dp_buffers_retrieve(b, N_BUFFERS + 1));
+    check_stats(b, 9, 0, 0, 3);
+
+    /* A slot that takes a new packet does not answer to its old id. */
+    packet = make_packet(100);
+    ids[3] = dp_buffers_save(b, packet);
+    ofpbuf_delete(packet);
+    dp_buffers_discard(b, ids[4]);
+    assert(!dp_buffers_retrieve(b, ids[4]));
+    packet = make_packet(101);
+    ids[4] = dp_buffers_save(b, packet);
+    ofpbuf_delete(packet);
+    packet = dp_buffers_retrieve(b, ids[3]);
+    assert(packet_number(packet) == 100);
+    ofpbuf_delete(packet);
+    packet = dp_buffers_retrieve(b, ids[4]);
+    assert(packet_number(packet) == 101);
+    ofpbuf_delete(packet);
+    check_stats(b, 8, 0, 0, 4);
+
+    /* Fill the store.  Recent packets are not evicted. */
+    for (i = 0; i < N_BUFFERS - 8; i++) {
+        packet = make_packet(1000 + i);
+        ids[i] = dp_buffers_save(b, packet);
+        assert(ids[i] != UINT32_MAX);
+        ofpbuf_delete(packet);
+    }
+    packet = make_packet(0);
+    assert(dp_buffers_save(b, packet) == UINT32_MAX);
+    check_stats(b, N_BUFFERS, 1, 0, 4);
+
+    /* Once they are old enough, the oldest are evicted first, which are the
+     * eight left from the start. */
+    for (deadline = time_msec() + DP_BUFFER_TIMEOUT_MS + 1;
+         time_msec() < deadline; time_refresh())
+        usleep(10000);
+    for (i = 0; i < 8; i++)
+        assert(dp_buffers_save(b, packet) != UINT32_MAX);
+    ofpbuf_delete(packet);
+    check_stats(b, N_BUFFERS, 1, 8, 4);
+    packet = dp_buffers_retrieve(b, ids[0]);
+    assert(packet_number(packet) == 1000);
+    ofpbuf_delete(packet);
+
+    dp_buffers_destroy(b);
+    return 0;
+}
@@ -0,0 +1,138 @@
+/* Tests the timing wheel that udatapath tables use to find expired flows,
+ * on a simulated clock. */
+
+#include <config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "openflow/openflow.h"
+#include "random.h"
+#include "switch-flow.h"
+#include "timeval.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define N_FLOWS 2000
+
+/* Simulated time step, in milliseconds. */
+#define STEP 250
+
+struct test_flow {
+    struct sw_flow *flow;
+    uint64_t last_use;          /* Flow is used until then, 0 for never. */
+    uint64_t expired;           /* When the wheel returned the flow. */
+};
+
+static uint64_t
+deadline(const struct sw_flow *flow)
+{
+    uint64_t d = UINT64_MAX;
+
+    if (flow->idle_timeout != OFP_FLOW_PERMANENT)
+        d = flow->used + flow->idle_timeout * 1000;
+    if (flow->hard_timeout != OFP_FLOW_PERMANENT)
+        d = MIN(d, flow->created + flow->hard_timeout * 1000);
+    return d;
+}
+
+static struct sw_flow *
+make_flow(uint64_t now, uint16_t idle_timeout, uint16_t hard_timeout)
+{
+    struct sw_flow *flow = flow_alloc(0);
+
+    flow_setup_actions(flow, NULL, 0);
+    flow->used = flow->created = now;
+    flow->idle_timeout = idle_timeout;
+    flow->hard_timeout = hard_timeout;
+    return flow;
+}
+
+int
+main(void)
+{
+    struct test_flow *flows;
+    struct flow_expiry fe;
+    struct sw_flow *freed;
+    uint64_t start, now, end;
+    int i, n_expired;
+
+    time_init();
+    random_init();
+
+    start = time_msec();
+    flow_expiry_init(&fe);
+
+    /* Flows with idle and hard timeouts, some of them far beyond one turn of
+     * the wheel, some used for a while, and a few permanent ones. */
+    flows = xcalloc(N_FLOWS, sizeof *flows);
+    end = start;
+    for (i = 0; i < N_FLOWS; i++) {
+        struct test_flow *tf = &flows[i];
+        uint16_t idle = random_range(4) ? random_range(120) + 1 : 0;
+        uint16_t hard = random_range(3) ? 0 : random_range(3000) + 1;
+
+        if (i == 0)
+            idle = hard = 0;
+        tf->flow = make_flow(start, idle, hard);
+        if (random_range(2))
+            tf->last_use = start + random_range(600) * 1000;
+        flow_expiry_insert(&fe, tf->flow);
+        if (idle || hard)
+            end = MAX(end, (tf->last_use ? tf->last_use : start)
+                      + MAX(idle, hard) * 1000);
+    }
+
+    /* Freeing a flow takes it out of the wheel. */
+    freed = make_flow(start, 1, 0);
+    flow_expiry_insert(&fe, freed);
+    flow_free(freed);
+
+    n_expired = 0;
+    for (now = start; now <= end + 2 * FLOW_EXPIRY_TICK_MS; now += STEP) {
+        struct sw_flow *flow;
+
+        for (i = 0; i < N_FLOWS; i++) {
+            struct test_flow *tf = &flows[i];
+            if (!tf->expired && now <= tf->last_use)
+                tf->flow->used = now;
+        }
+
+        while ((flow = flow_expiry_next(&fe, now)) != NULL) {
+            struct test_flow *tf = NULL;
+
+            for (i = 0; i < N_FLOWS; i++) {
+                if (flows[i].flow == flow) {
+                    tf = &flows[i];
+                    break;
+                }
+            }
+            assert(tf && !tf->expired);
+            tf->expired = now;
+            n_expired++;
+
+            /* Never early, at most a tick late. */
+            assert(now > deadline(flow));
+            assert(now <= deadline(flow) + FLOW_EXPIRY_TICK_MS + STEP);
+            assert(flow->reason
+                   == (flow->idle_timeout != OFP_FLOW_PERMANENT
+                       && now > flow->used + flow->idle_timeout * 1000
+                       ? OFPRR_IDLE_TIMEOUT : OFPRR_HARD_TIMEOUT));
+        }
+    }
+
+    /* Exactly the flows with timeouts expired. */
+    for (i = 0; i < N_FLOWS; i++) {
+        struct sw_flow *flow = flows[i].flow;
+        bool permanent = (flow->idle_timeout == OFP_FLOW_PERMANENT
+                          && flow->hard_timeout == OFP_FLOW_PERMANENT);
+        assert(!flows[i].expired == permanent);
+        flow_free(flow);
+    }
+    printf("%d of %d flows expired over %llu simulated seconds\n",
+           n_expired, N_FLOWS, (unsigned long long) (end - start) / 1000);
+
+    free(flows);
+    return 0;
+}
@@ -0,0 +1,110 @@
+/* Tests that the word-wise masked match of udatapath flows agrees with the
+ * field-by-field comparison of flow_matches_1wild(). */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "random.h"
+#include "switch-flow.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define N_RULES 2000
+#define N_PACKETS 200
+
+/* Values drawn from a small set, so that packets often match rules. */
+static uint32_t
+random_value(int bits)
+{
+    uint32_t x = random_range(4);
+    return bits < 32 ? x & ((1u << bits) - 1) : x;
+}
+
+static void
+random_key(struct flow *f)
+{
+    memset(f, 0, sizeof *f);
+    f->in_port = htons(random_value(16));
+    f->dl_vlan = htons(random_value(12));
+    f->dl_vlan_pcp = random_value(3);
+    f->dl_src[5] = random_value(8);
+    f->dl_dst[5] = random_value(8);
+    f->dl_type = htons(random_range(2) ? ETH_TYPE_IP : random_value(16));
+    f->nw_src = htonl(random_value(32) << 24 | random_value(32));
+    f->nw_dst = htonl(random_value(32) << 8 | random_value(32));
+    f->nw_proto = random_value(8);
+    f->nw_tos = random_value(8) << 2;
+    f->tp_src = htons(random_value(16));
+    f->tp_dst = htons(random_value(16));
+}
+
+static void
+random_rule(struct ofp_match *match)
+{
+    struct flow f;
+
+    random_key(&f);
+    memset(match, 0, sizeof *match);
+    match->wildcards = htonl(random_uint32() & OFPFW_ALL);
+    match->in_port = f.in_port;
+    memcpy(match->dl_src, f.dl_src, ETH_ADDR_LEN);
+    memcpy(match->dl_dst, f.dl_dst, ETH_ADDR_LEN);
+    match->dl_vlan = f.dl_vlan;
+    match->dl_vlan_pcp = f.dl_vlan_pcp;
+    match->dl_type = f.dl_type;
+    match->nw_tos = f.nw_tos;
+    match->nw_proto = f.nw_proto;
+    match->nw_src = f.nw_src;
+    match->nw_dst = f.nw_dst;
+    match->tp_src = f.tp_src;
+    match->tp_dst = f.tp_dst;
+}
+
+int
+main(void)
+{
+    struct sw_flow_key packets[N_PACKETS];
+    int i, j, n_matches;
+
+    random_init();
+
+    for (i = 0; i < N_PACKETS; i++) {
+        memset(&packets[i], 0, sizeof packets[i]);
+        random_key(&packets[i].flow);
+    }
+
+    n_matches = 0;
+    for (i = 0; i < N_RULES; i++) {
+        struct sw_flow_match m;
+        struct ofp_match match;
+        struct sw_flow_key rule;
+
+        random_rule(&match);
+        if (i % 10 == 0)
+            match.wildcards = 0;
+        flow_extract_match(&rule, &match);
+        flow_match_init(&m, &rule);
+
+        for (j = 0; j < N_PACKETS; j++) {
+            bool expected = flow_matches_1wild(&packets[j], &rule);
+            assert(flow_match_packet(&m, &packets[j]) == expected);
+            n_matches += expected;
+        }
+
+        /* A packet made from an exact-match rule matches it. */
+        if (!rule.wildcards)
+            assert(flow_match_packet(&m, &rule));
+    }
+
+    /* Make sure the test is not vacuous. */
+    assert(n_matches > N_RULES);
+    printf("%d matches in %d comparisons\n", n_matches, N_RULES * N_PACKETS);
+    return 0;
+}
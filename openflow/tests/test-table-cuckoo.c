@@ -0,0 +1,260 @@
+/* Tests the cuckoo hash exact-match table of udatapath, in particular while
+ * it grows. */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "datapath.h"
+#include "list.h"
+#include "openflow/openflow.h"
+#include "random.h"
+#include "switch-flow.h"
+#include "table.h"
+#include "timeval.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define N_FLOWS 50000
+
+/* Flows are not reported to anybody here. */
+void
+dp_send_flow_end(struct datapath *dp UNUSED, struct sw_flow *flow UNUSED,
+                 enum ofp_flow_removed_reason reason UNUSED)
+{
+}
+
+/* Returns the exact-match key of flow number 'i'. */
+static void
+make_key(struct sw_flow_key *key, unsigned int i)
+{
+    memset(key, 0, sizeof *key);
+    key->flow.in_port = htons(i % 7 + 1);
+    key->flow.dl_type = htons(0x0800);
+    key->flow.nw_proto = 6;
+    key->flow.nw_src = htonl(0x0a000000 | i);
+    key->flow.nw_dst = htonl(0xc0a80001);
+    key->flow.tp_src = htons(1024 + i % 30000);
+    key->flow.tp_dst = htons(80);
+}
+
+static struct sw_flow *
+make_flow(unsigned int i)
+{
+    struct sw_flow *flow = flow_alloc(0);
+
+    make_key(&flow->key, i);
+    flow->priority = OFP_DEFAULT_PRIORITY;
+    flow_setup_actions(flow, NULL, 0);
+
+    /* A third of the flows get a hard timeout that has already passed, which
+     * the timeout test relies on. */
+    if (ntohl(flow->key.flow.nw_src) % 3 == 0) {
+        flow->hard_timeout = 1;
+        flow->created = time_msec() - 5000;
+    }
+    return flow;
+}
+
+static struct sw_flow *
+lookup(struct sw_table *table, unsigned int i)
+{
+    struct sw_flow_key key;
+
+    make_key(&key, i);
+    return table->lookup(table, &key);
+}
+
+static int
+count_flow(struct sw_flow *flow UNUSED, void *count_)
+{
+    unsigned int *count = count_;
+
+    /* Interrupt now and then to exercise resuming the iteration, as flow
+     * statistics replies do. */
+    return ++*count % 500 == 0;
+}
+
+static unsigned int
+count_flows(struct sw_table *table)
+{
+    struct sw_table_position position;
+    struct sw_flow_key key;
+    unsigned int count = 0;
+
+    memset(&key, 0, sizeof key);
+    key.wildcards = OFPFW_ALL;
+    memset(&position, 0, sizeof position);
+    while (table->iterate(table, &key, htons(OFPP_NONE), &position,
+                          count_flow, &count))
+        continue;
+    return count;
+}
+
+/* The flows that an iteration visited, in order, by number. */
+struct visit {
+    unsigned int *order;
+    unsigned int n;
+    unsigned int stop;          /* Interrupt after this many, 0 for never. */
+};
+
+static int
+visit_flow(struct sw_flow *flow, void *visit_)
+{
+    struct visit *v = visit_;
+
+    v->order[v->n++] = ntohl(flow->key.flow.nw_src) & 0xffffff;
+    return v->n == v->stop;
+}
+
+/* An interrupted iteration resumes at the right flow even if that flow was
+ * replaced and then deleted in the meantime. */
+static void
+test_resume(struct sw_table *table)
+{
+    unsigned int i, k = N_FLOWS / 3;
+    struct sw_table_position position;
+    struct sw_flow_key key;
+    struct visit all, part;
+
+    memset(&key, 0, sizeof key);
+    key.wildcards = OFPFW_ALL;
+    all.order = xmalloc(N_FLOWS * sizeof *all.order);
+    all.n = all.stop = 0;
+    memset(&position, 0, sizeof position);
+    assert(!table->iterate(table, &key, htons(OFPP_NONE), &position,
+                           visit_flow, &all));
+    assert(all.n == N_FLOWS);
+
+    part.order = xmalloc(N_FLOWS * sizeof *part.order);
+    part.n = 0;
+    part.stop = k;
+    memset(&position, 0, sizeof position);
+    assert(table->iterate(table, &key, htons(OFPP_NONE), &position,
+                          visit_flow, &part));
+
+    assert(table->insert(table, make_flow(all.order[k])));
+    make_key(&key, all.order[k]);
+    assert(table->delete(NULL, table, &key, htons(OFPP_NONE), 0, 0) == 1);
+
+    memset(&key, 0, sizeof key);
+    key.wildcards = OFPFW_ALL;
+    part.stop = 0;
+    assert(!table->iterate(table, &key, htons(OFPP_NONE), &position,
+                           visit_flow, &part));
+    assert(part.n == N_FLOWS - 1);
+    for (i = 0; i < part.n; i++)
+        assert(part.order[i] == all.order[i + (i >= k)]);
+
+    /* Put the flow back for the tests that follow. */
+    assert(table->insert(table, make_flow(all.order[k])));
+    free(all.order);
+    free(part.order);
+}
+
+int
+main(void)
+{
+    struct sw_table_cuckoo_stats cs;
+    struct sw_table_stats stats;
+    struct sw_flow_key key;
+    struct sw_table *table;
+    struct sw_flow *flow;
+    unsigned int i, n;
+
+    time_init();
+    random_init();
+
+    /* Start small, so that the table grows several times. */
+    table = table_cuckoo_create(4, N_FLOWS);
+    assert(table != NULL);
+
+    for (i = 0; i < N_FLOWS; i++) {
+        assert(table->insert(table, make_flow(i)));
+
+        /* Flows must be found while they are being moved around. */
+        if (i % 97 == 0) {
+            unsigned int j = random_range(i + 1);
+            flow = lookup(table, j);
+            assert(flow && ntohl(flow->key.flow.nw_src) == (0x0a000000 | j));
+        }
+    }
+    for (i = 0; i < N_FLOWS; i++)
+        assert(lookup(table, i) != NULL);
+    for (i = N_FLOWS; i < N_FLOWS + 1000; i++)
+        assert(lookup(table, i) == NULL);
+
+    table_cuckoo_get_stats(table, &cs);
+    assert(cs.n_flows == N_FLOWS);
+    assert(cs.n_resizes > 5);
+    assert(cs.n_flows <= cs.n_buckets * cs.n_entries);
+    printf("%u flows in %u buckets of %u, %llu displacements (max %u), "
+           "%u resizes\n", cs.n_flows, cs.n_buckets, cs.n_entries,
+           cs.n_displaced, cs.max_displaced, cs.n_resizes);
+
+    /* Wildcarded flows are refused, and so are flows beyond the capacity,
+     * unless they replace an existing flow. */
+    flow = make_flow(N_FLOWS);
+    flow->key.wildcards = OFPFW_IN_PORT;
+    assert(!table->insert(table, flow));
+    flow->key.wildcards = 0;
+    assert(!table->insert(table, flow));
+    flow_free(flow);
+    flow = make_flow(17);
+    assert(table->insert(table, flow));
+    assert(lookup(table, 17) == flow);
+    table->stats(table, &stats);
+    assert(stats.n_flows == N_FLOWS);
+
+    /* Iteration visits every flow once. */
+    assert(count_flows(table) == N_FLOWS);
+    test_resume(table);
+
+    /* Exact and wildcarded deletion and modification. */
+    make_key(&key, 42);
+    assert(table->delete(NULL, table, &key, htons(OFPP_NONE), 0, 0) == 1);
+    assert(table->delete(NULL, table, &key, htons(OFPP_NONE), 0, 0) == 0);
+    assert(lookup(table, 42) == NULL);
+    make_key(&key, 43);
+    assert(table->modify(table, &key, OFP_DEFAULT_PRIORITY, 1, NULL, 0) == 1);
+    assert(table->has_conflict(table, &key, OFP_DEFAULT_PRIORITY, 1));
+
+    memset(&key, 0, sizeof key);
+    key.wildcards = OFPFW_ALL & ~OFPFW_IN_PORT;
+    key.flow.in_port = htons(3);
+    n = table->delete(NULL, table, &key, htons(OFPP_NONE), 0, 0);
+    assert(n > N_FLOWS / 8 && n < N_FLOWS / 6);
+    for (i = 0; i < N_FLOWS; i++)
+        assert((lookup(table, i) == NULL) == (i % 7 == 2 || i == 42));
+    table->stats(table, &stats);
+    assert(stats.n_flows == N_FLOWS - 1 - n);
+
+    /* Timeout. */
+    {
+        struct sw_flow *next;
+        struct list deleted;
+
+        list_init(&deleted);
+        table->timeout(table, &deleted);
+        LIST_FOR_EACH_SAFE (flow, next, struct sw_flow, node, &deleted) {
+            list_remove(&flow->node);
+            flow_free(flow);
+        }
+    }
+    for (i = 0; i < N_FLOWS; i++)
+        assert((lookup(table, i) == NULL)
+               == (i % 7 == 2 || i == 42 || (0x0a000000 | i) % 3 == 0));
+    table->stats(table, &stats);
+    assert(count_flows(table) == stats.n_flows);
+
+    /* Removed flows make room for new ones. */
+    for (i = N_FLOWS; i < N_FLOWS + 1000; i++)
+        assert(table->insert(table, make_flow(i)));
+
+    table->destroy(table);
+
+    return 0;
+}
@@ -0,0 +1,293 @@
+/* Compares the tuple space search table of udatapath against the linear
+ * table, which is simple enough to serve as reference. */
+
+#include <config.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "datapath.h"
+#include "list.h"
+#include "openflow/openflow.h"
+#include "packets.h"
+#include "random.h"
+#include "switch-flow.h"
+#include "table.h"
+#include "timeval.h"
+#include "util.h"
+
+#undef NDEBUG
+#include <assert.h>
+
+#define N_RULES 2000
+#define N_PACKETS 20000
+
+/* Flows are not reported to anybody here. */
+void
+dp_send_flow_end(struct datapath *dp UNUSED, struct sw_flow *flow UNUSED,
+                 enum ofp_flow_removed_reason reason UNUSED)
+{
+}
+
+static uint32_t
+random_ip(void)
+{
+    /* 10.0-3.0-3.0-3, so that rules overlap a lot. */
+    return htonl(0x0a000000 | random_range(4) << 16 | random_range(4) << 8
+                 | random_range(4));
+}
+
+static uint16_t
+random_port(void)
+{
+    static const uint16_t ports[] = { 22, 53, 80, 443 };
+    return htons(ports[random_range(ARRAY_SIZE(ports))]);
+}
+
+static uint8_t
+random_proto(void)
+{
+    static const uint8_t protos[] = { IPPROTO_TCP, IPPROTO_UDP, IPPROTO_ICMP };
+    return protos[random_range(ARRAY_SIZE(protos))];
+}
+
+/* Fills 'match' with a random ACL-style rule of one of a few shapes. */
+static void
+random_match(struct ofp_match *match)
+{
+    uint32_t w = OFPFW_ALL;
+
+    memset(match, 0, sizeof *match);
+    match->in_port = htons(random_range(4) + 1);
+    match->dl_src[5] = random_range(4);
+    match->dl_type = htons(ETH_TYPE_IP);
+    match->nw_proto = random_proto();
+    match->nw_src = random_ip();
+    match->nw_dst = random_ip();
+    match->tp_src = random_port();
+    match->tp_dst = random_port();
+
+    switch (random_range(6)) {
+    case 0:
+        w &= ~(OFPFW_DL_TYPE | OFPFW_NW_PROTO | OFPFW_TP_DST
+               | OFPFW_NW_SRC_MASK);
+        w |= 8 << OFPFW_NW_SRC_SHIFT;
+        break;
+    case 1:
+        w &= ~(OFPFW_DL_TYPE | OFPFW_NW_DST_MASK);
+        w |= 16 << OFPFW_NW_DST_SHIFT;
+        break;
+    case 2:
+        w &= ~(OFPFW_IN_PORT | OFPFW_DL_TYPE | OFPFW_NW_PROTO | OFPFW_TP_SRC
+               | OFPFW_TP_DST | OFPFW_NW_SRC_MASK | OFPFW_NW_DST_MASK);
+        break;
+    case 3:
+        w &= ~(OFPFW_DL_TYPE | OFPFW_NW_PROTO | OFPFW_NW_SRC_MASK);
+        w |= 24 << OFPFW_NW_SRC_SHIFT;
+        break;
+    case 4:
+        w &= ~OFPFW_IN_PORT;
+        break;
+    case 5:
+        w &= ~(OFPFW_DL_SRC | OFPFW_IN_PORT);
+        break;
+    }
+    match->wildcards = htonl(w);
+}
+
+static struct sw_flow *
+make_flow(const struct ofp_match *match, uint16_t priority)
+{
+    struct sw_flow *flow = flow_alloc(0);
+
+    flow_extract_match(&flow->key, match);
+    flow->priority = priority;
+    flow_setup_actions(flow, NULL, 0);
+
+    /* Flows whose priority is a multiple of 3 get a hard timeout that has
+     * already passed, which the timeout test below relies on. */
+    if (priority % 3 == 0) {
+        flow->hard_timeout = 1;
+        flow->created = time_msec() - 5000;
+    }
+    return flow;
+}
+
+static void
+random_packet(struct sw_flow_key *key)
+{
+    memset(key, 0, sizeof *key);
+    key->flow.in_port = htons(random_range(4) + 1);
+    key->flow.dl_src[5] = random_range(4);
+    key->flow.dl_type = htons(random_range(8) ? ETH_TYPE_IP : ETH_TYPE_ARP);
+    key->flow.nw_proto = random_proto();
+    key->flow.nw_src = random_ip();
+    key->flow.nw_dst = random_ip();
+    key->flow.tp_src = random_port();
+    key->flow.tp_dst = random_port();
+}
+
+static uint16_t
+priority_of(const struct sw_flow *flow)
+{
+    return flow ? flow->priority : 0;
+}
+
+/* Looks up the same packets in both tables and checks that the same rule
+ * (identified by its unique priority) is found. */
+static void
+compare_lookups(struct sw_table *linear, struct sw_table *tss)
+{
+    int i;
+
+    for (i = 0; i < N_PACKETS; i++) {
+        struct sw_flow_key key;
+
+        random_packet(&key);
+        assert(priority_of(linear->lookup(linear, &key))
+               == priority_of(tss->lookup(tss, &key)));
+    }
+}
+
+static unsigned int
+n_flows(struct sw_table *table)
+{
+    struct sw_table_stats stats;
+
+    table->stats(table, &stats);
+    return stats.n_flows;
+}
+
+struct flow_count {
+    unsigned int n;
+    bool interrupt;
+};
+
+static int
+count_flow(struct sw_flow *flow UNUSED, void *count_)
+{
+    struct flow_count *count = count_;
+
+    /* Interrupt every 7th flow to exercise resuming the iteration. */
+    return ++count->n % 7 == 0 && count->interrupt;
+}
+
+static unsigned int
+count_flows(struct sw_table *table, const struct sw_flow_key *key,
+            bool interrupt)
+{
+    struct sw_table_position position;
+    struct flow_count count;
+
+    memset(&position, 0, sizeof position);
+    count.n = 0;
+    count.interrupt = interrupt;
+    while (table->iterate(table, key, htons(OFPP_NONE), &position,
+                          count_flow, &count))
+        continue;
+    return count.n;
+}
+
+int
+main(void)
+{
+    struct sw_table *linear, *tss;
+    struct ofp_match matches[N_RULES];
+    struct sw_flow_key key;
+    unsigned int n_expired[2] = { 0, 0 };
+    int i;
+
+    time_init();
+    random_init();
+
+    linear = table_linear_create(N_RULES);
+    tss = table_tss_create(N_RULES);
+
+    /* Unique priorities make the expected result of a lookup unambiguous. */
+    for (i = 0; i < N_RULES; i++) {
+        uint16_t priority = (i * 7919) % N_RULES + 1;
+
+        random_match(&matches[i]);
+        assert(linear->insert(linear, make_flow(&matches[i], priority)));
+        assert(tss->insert(tss, make_flow(&matches[i], priority)));
+    }
+    assert(n_flows(tss) == N_RULES);
+    compare_lookups(linear, tss);
+
+    /* The table is full, but replacing a flow still works. */
+    {
+        struct sw_flow *flow;
+        struct ofp_match match;
+        uint16_t priority = (7 * 7919) % N_RULES + 1;
+
+        flow = make_flow(&matches[7], priority);
+        assert(tss->insert(tss, flow));
+        assert(n_flows(tss) == N_RULES);
+
+        random_match(&match);
+        flow = make_flow(&match, N_RULES + 1);
+        assert(!tss->insert(tss, flow));
+        flow_free(flow);
+    }
+
+    /* Iteration visits all flows, also when interrupted. */
+    memset(&key, 0, sizeof key);
+    key.wildcards = OFPFW_ALL;
+    assert(count_flows(tss, &key, true) == N_RULES);
+    for (i = 0; i < 50; i++) {
+        flow_extract_match(&key, &matches[i]);
+        assert(count_flows(tss, &key, true)
+               == count_flows(linear, &key, false));
+    }
+
+    /* Strict and non-strict modification and deletion.  Non-strict
+     * deletion with a broad rule can empty most of the table, so there are
+     * only a few of those. */
+    for (i = 0; i < 200; i++) {
+        uint16_t priority = (i * 7919) % N_RULES + 1;
+        int strict = i % 2 || i >= 20;
+
+        flow_extract_match(&key, &matches[i]);
+        if (i % 4 < 2) {
+            assert(linear->modify(linear, &key, priority, strict, NULL, 0)
+                   == tss->modify(tss, &key, priority, strict, NULL, 0));
+            assert(linear->has_conflict(linear, &key, priority, strict)
+                   == tss->has_conflict(tss, &key, priority, strict));
+        } else {
+            assert(linear->delete(NULL, linear, &key, htons(OFPP_NONE),
+                                  priority, strict)
+                   == tss->delete(NULL, tss, &key, htons(OFPP_NONE),
+                                  priority, strict));
+        }
+    }
+    assert(n_flows(linear) == n_flows(tss));
+    compare_lookups(linear, tss);
+
+    /* Timeout removes the same flows, which also makes the tss table
+     * recompute the priorities of its subtables. */
+    memset(&key, 0, sizeof key);
+    key.wildcards = OFPFW_ALL;
+    for (i = 0; i < 2; i++) {
+        struct sw_table *table = i ? tss : linear;
+        struct sw_flow *flow, *next;
+        struct list deleted;
+
+        list_init(&deleted);
+        table->timeout(table, &deleted);
+        LIST_FOR_EACH_SAFE (flow, next, struct sw_flow, node, &deleted) {
+            assert(flow->priority % 3 == 0);
+            list_remove(&flow->node);
+            flow_free(flow);
+            n_expired[i]++;
+        }
+    }
+    assert(n_expired[0] > 0 && n_expired[0] == n_expired[1]);
+    assert(n_flows(linear) == n_flows(tss));
+    compare_lookups(linear, tss);
+
+    linear->destroy(linear);
+    tss->destroy(tss);
+
+    return 0;
+}
@@ -14,6 +14,10 @@ udatapath_ofdatapath_SOURCES = \
 	udatapath/datapath.h \
 	udatapath/dp_act.c \
 	udatapath/dp_act.h \
+	udatapath/dp_buffer.c \
+	udatapath/dp_buffer.h \
+	udatapath/dp_worker.c \
+	udatapath/dp_worker.h \
 	udatapath/of_ext_msg.c \
 	udatapath/of_ext_msg.h \
 	udatapath/udatapath.c \
@@ -22,10 +26,13 @@ udatapath_ofdatapath_SOURCES = \
 	udatapath/switch-flow.c \
 	udatapath/switch-flow.h \
 	udatapath/table.h \
+	udatapath/table-cuckoo.c \
 	udatapath/table-hash.c \
-	udatapath/table-linear.c
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
 
-udatapath_ofdatapath_LDADD = lib/libopenflow.a $(SSL_LIBS) $(FAULT_LIBS)
+udatapath_ofdatapath_LDADD = lib/libopenflow.a $(SSL_LIBS) $(FAULT_LIBS) \
+	$(PTHREAD_LIBS)
 udatapath_ofdatapath_CPPFLAGS = $(AM_CPPFLAGS)
 
 EXTRA_DIST += udatapath/ofdatapath.8.in
@@ -58,6 +65,10 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/datapath.h \
 	udatapath/dp_act.c \
 	udatapath/dp_act.h \
+	udatapath/dp_buffer.c \
+	udatapath/dp_buffer.h \
+	udatapath/dp_worker.c \
+	udatapath/dp_worker.h \
 	udatapath/of_ext_msg.c \
 	udatapath/of_ext_msg.h \
 	udatapath/udatapath.c \
@@ -66,8 +77,10 @@ udatapath_libudatapath_a_SOURCES = \
 	udatapath/switch-flow.c \
 	udatapath/switch-flow.h \
 	udatapath/table.h \
+	udatapath/table-cuckoo.c \
 	udatapath/table-hash.c \
-	udatapath/table-linear.c
+	udatapath/table-linear.c \
+	udatapath/table-tss.c
 
 udatapath_libudatapath_a_CPPFLAGS = $(AM_CPPFLAGS)
 udatapath_libudatapath_a_CPPFLAGS += -DOF_HW_PLAT -DUDATAPATH_AS_LIB -g
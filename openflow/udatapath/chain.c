@@ -36,6 +36,8 @@
 #include <assert.h>
 #include <errno.h>
 #include <stdlib.h>
+#include <string.h>
+#include "list.h"
 #include "switch-flow.h"
 #include "table.h"
 #include "datapath.h"
@@ -59,6 +61,7 @@ static int add_table(struct sw_chain *chain, struct sw_table *table, int emerg)
         table->destroy(table);
         return -ENOBUFS;
     }
+    memset(&table->totals, 0, sizeof table->totals);
     if (emerg)
         chain->emerg_table = table;
     else
@@ -75,6 +78,7 @@ struct sw_chain *chain_create(struct datapath *dp)
         return NULL;
 
     chain->dp = dp;
+    chain->generation = 1;
 #if defined(OF_HW_PLAT)
     if (dp && dp->hw_drv) {
         if (add_table(chain, (struct sw_table *)dp->hw_drv, 0) != 0) {
@@ -82,20 +86,198 @@ struct sw_chain *chain_create(struct datapath *dp)
         }
     }
 #endif
-    if (add_table(chain, table_hash2_create(0x1EDC6F41, TABLE_HASH_MAX_FLOWS,
-                                            0x741B8CD7, TABLE_HASH_MAX_FLOWS),
-                                            0)
-        || add_table(chain, table_linear_create(TABLE_LINEAR_MAX_FLOWS), 0)
+    if (add_table(chain, table_cuckoo_create(TABLE_CUCKOO_BUCKETS,
+                                             TABLE_CUCKOO_MAX_FLOWS), 0)
+        || add_table(chain, table_tss_create(TABLE_TSS_MAX_FLOWS), 0)
         || add_table(chain, table_linear_create(TABLE_LINEAR_MAX_FLOWS), 1)) {
         chain_destroy(chain);
         return NULL;
     }
+    chain_set_cache_size(chain, CHAIN_CACHE_ENTRIES);
 
     return chain;
 }
 
+/* Creates and returns an empty microflow cache with room for 'n_entries'
+ * flows, rounded down to a power of 2.  Returns a null pointer if 'n_entries'
+ * is less than 2 or memory is short. */
+struct chain_cache *
+chain_cache_create(unsigned int n_entries)
+{
+    struct chain_cache *cache;
+    unsigned int n_sets = 1;
+
+    if (n_entries < 2)
+        return NULL;
+    while (n_sets * 2 <= n_entries / 2)
+        n_sets *= 2;
+
+    cache = calloc(1, sizeof *cache);
+    if (cache == NULL)
+        return NULL;
+    cache->entries = calloc(n_sets * 2, sizeof *cache->entries);
+    if (cache->entries == NULL) {
+        free(cache);
+        return NULL;
+    }
+    cache->mask = n_sets - 1;
+    return cache;
+}
+
+void
+chain_cache_destroy(struct chain_cache *cache)
+{
+    if (cache) {
+        free(cache->entries);
+        free(cache);
+    }
+}
+
+/* Replaces the microflow cache of 'chain' by an empty one with room for
+ * 'n_entries' flows, rounded down to a power of 2.  0 disables the cache. */
+void
+chain_set_cache_size(struct sw_chain *chain, unsigned int n_entries)
+{
+    chain_cache_destroy(chain->cache);
+    chain->cache = chain_cache_create(n_entries);
+    if (chain->cache == NULL && n_entries >= 2)
+        VLOG_WARN("failed to allocate microflow cache");
+}
+
+/* Invalidates the entries of all the microflow caches of 'chain'. */
+static void
+chain_flush_cache(struct sw_chain *chain)
+{
+    chain->generation++;
+}
+
+/* Dumps statistics for microflow cache 'cache' of 'chain' into 'stats'.  The
+ * active flows are the cache entries that are currently valid. */
+void
+chain_cache_stats(const struct sw_chain *chain, const struct chain_cache *cache,
+                  struct sw_table_stats *stats)
+{
+    unsigned int n_entries = (cache->mask + 1) * 2;
+    unsigned int i;
+
+    stats->name = "microflow cache";
+    stats->wildcards = 0;
+    stats->n_flows = 0;
+    for (i = 0; i < n_entries; i++) {
+        if (cache->entries[i].generation == chain->generation)
+            stats->n_flows++;
+    }
+    stats->max_flows = n_entries;
+    stats->n_lookup = cache->n_lookup;
+    stats->n_matched = cache->n_hit;
+}
+
+/* Counts a lookup that searched the first 'n_searched' working tables of
+ * 'chain' and, if 'matched', found a flow in the last of them.  Lookups
+ * through the chain's own cache, or without a cache, count directly in the
+ * tables; other caches keep the counts until chain_cache_fold(). */
+static void
+count_lookup(struct sw_chain *chain, struct chain_cache *cache,
+             int n_searched, bool matched)
+{
+    int i;
+
+    if (cache && cache != chain->cache) {
+        for (i = 0; i < n_searched; i++)
+            cache->n_table_lookup[i]++;
+        if (matched)
+            cache->n_table_matched[n_searched - 1]++;
+    } else {
+        for (i = 0; i < n_searched; i++)
+            chain->tables[i]->n_lookup++;
+        if (matched)
+            chain->tables[n_searched - 1]->n_matched++;
+    }
+}
+
+/* Adds the table statistics kept by 'cache' to the tables of 'chain' and
+ * resets them.  The caller must ensure that no lookup through 'cache' runs
+ * at the same time. */
+void
+chain_cache_fold(struct sw_chain *chain, struct chain_cache *cache)
+{
+    int i;
+
+    for (i = 0; i < chain->n_tables; i++) {
+        chain->tables[i]->n_lookup += cache->n_table_lookup[i];
+        chain->tables[i]->n_matched += cache->n_table_matched[i];
+        cache->n_table_lookup[i] = cache->n_table_matched[i] = 0;
+    }
+}
+
+/* Searches the working tables of 'chain' in order for a flow matching 'key'.
+ * Stores the index of the matching table in '*table_idx'. */
+static struct sw_flow *
+lookup_tables(struct sw_chain *chain, struct chain_cache *cache,
+              const struct sw_flow_key *key, int *table_idx)
+{
+    int i;
+
+    for (i = 0; i < chain->n_tables; i++) {
+        struct sw_table *t = chain->tables[i];
+        struct sw_flow *flow = t->lookup(t, key);
+        if (flow) {
+            count_lookup(chain, cache, i + 1, true);
+            *table_idx = i;
+            return flow;
+        }
+    }
+    count_lookup(chain, cache, chain->n_tables, false);
+    return NULL;
+}
+
+/* Looks up 'key' in microflow cache 'cache', falling back to the working
+ * tables of 'chain' on a miss. */
+static struct sw_flow *
+cached_lookup(struct sw_chain *chain, struct chain_cache *cache,
+              const struct sw_flow_key *key)
+{
+    struct chain_cache_entry *set, tmp;
+    struct sw_flow *flow;
+    int i;
+
+    set = &cache->entries[(flow_hash(&key->flow, 0) & cache->mask) * 2];
+    cache->n_lookup++;
+    for (i = 0; i < 2; i++) {
+        struct chain_cache_entry *e = &set[i];
+        if (e->generation == chain->generation
+            && flow_equal(&e->key, &key->flow)) {
+            /* Count the lookup in the tables as if they had been searched,
+             * so that their statistics do not depend on the cache. */
+            count_lookup(chain, cache, e->table_idx + 1, true);
+            cache->n_hit++;
+
+            /* Keep the most recently used entry first. */
+            if (i) {
+                tmp = set[0];
+                set[0] = set[1];
+                set[1] = tmp;
+            }
+            return set[0].flow;
+        }
+    }
+
+    flow = lookup_tables(chain, cache, key, &i);
+    if (flow) {
+        /* Evict the least recently used entry. */
+        set[1] = set[0];
+        set[0].key = key->flow;
+        set[0].generation = chain->generation;
+        set[0].table_idx = i;
+        set[0].flow = flow;
+    }
+    return flow;
+}
+
 /* Searches 'chain' for a flow matching 'key', which must not have any wildcard
- * fields.  Returns the flow if successful, otherwise a null pointer. */
+ * fields.  Returns the flow if successful, otherwise a null pointer.
+ *
+ * Lookups in the working tables go through the microflow cache, if any. */
 struct sw_flow *
 chain_lookup(struct sw_chain *chain, const struct sw_flow_key *key, int emerg)
 {
@@ -111,21 +293,32 @@ chain_lookup(struct sw_chain *chain, const struct sw_flow_key *key, int emerg)
             t->n_matched++;
             return flow;
         }
+    } else if (chain->cache) {
+        return cached_lookup(chain, chain->cache, key);
     } else {
-        for (i = 0; i < chain->n_tables; i++) {
-            struct sw_table *t = chain->tables[i];
-            struct sw_flow *flow = t->lookup(t, key);
-            t->n_lookup++;
-            if (flow) {
-                t->n_matched++;
-                return flow;
-            }
-        }
+        return lookup_tables(chain, NULL, key, &i);
     }
 
     return NULL;
 }
 
+/* Searches the working tables of 'chain' for a flow matching 'key', which must
+ * not have any wildcard fields, through microflow cache 'cache'.  Returns the
+ * flow if successful, otherwise a null pointer.
+ *
+ * Unlike chain_lookup(), this does not write to 'chain' at all, so several
+ * threads may look up flows at the same time, each through a cache of its
+ * own, as long as 'chain' does not change meanwhile. */
+struct sw_flow *
+chain_lookup_cached(struct sw_chain *chain, struct chain_cache *cache,
+                    const struct sw_flow_key *key)
+{
+    assert(!key->wildcards);
+    assert(cache != chain->cache);
+
+    return cached_lookup(chain, cache, key);
+}
+
 /* Inserts 'flow' into 'chain', replacing any duplicate flow.  Returns 0 if
  * successful or a negative error.
  *
@@ -138,13 +331,18 @@ chain_insert(struct sw_chain *chain, struct sw_flow *flow, int emerg)
 
     if (emerg) {
         struct sw_table *t = chain->emerg_table;
-        if (t->insert(t, flow))
+        if (t->insert(t, flow)) {
+            flow->totals = &t->totals;
             return 0;
+        }
     } else {
         for (i = 0; i < chain->n_tables; i++) {
             struct sw_table *t = chain->tables[i];
-            if (t->insert(t, flow))
+            if (t->insert(t, flow)) {
+                flow->totals = &t->totals;
+                chain_flush_cache(chain);
                 return 0;
+            }
         }
     }
 
@@ -174,6 +372,8 @@ chain_modify(struct sw_chain *chain, const struct sw_flow_key *key,
             struct sw_table *t = chain->tables[i];
             count += t->modify(t, key, priority, strict, actions, actions_len);
         }
+        if (count)
+            chain_flush_cache(chain);
     }
 
     return count;
@@ -223,6 +423,8 @@ chain_delete(struct sw_chain *chain, const struct sw_flow_key *key,
             struct sw_table *t = chain->tables[i];
             count += t->delete(chain->dp, t, key, out_port, priority, strict);
         }
+        if (count)
+            chain_flush_cache(chain);
     }
 
     return count;
@@ -236,12 +438,15 @@ chain_delete(struct sw_chain *chain, const struct sw_flow_key *key,
 void
 chain_timeout(struct sw_chain *chain, struct list *deleted)
 {
+    struct list *last = deleted->prev;
     int i;
 
     for (i = 0; i < chain->n_tables; i++) {
         struct sw_table *t = chain->tables[i];
         t->timeout(t, deleted);
     }
+    if (deleted->prev != last)
+        chain_flush_cache(chain);
 }
 
 /* Destroys 'chain', which must not have any users. */
@@ -257,5 +462,6 @@ chain_destroy(struct sw_chain *chain)
     }
     t = chain->emerg_table;
     t->destroy(t);
+    chain_cache_destroy(chain->cache);
     free(chain);
 }
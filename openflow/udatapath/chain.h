@@ -36,26 +36,62 @@
 
 #include <stddef.h>
 #include <stdint.h>
+#include "flow.h"
 
 struct sw_flow;
 struct sw_flow_key;
+struct sw_table_stats;
 struct ofp_action_header;
 struct list;
 struct datapath;
 
 #define TABLE_LINEAR_MAX_FLOWS  100
+#define TABLE_TSS_MAX_FLOWS     131072
 #define TABLE_HASH_MAX_FLOWS    65536
+#define TABLE_CUCKOO_BUCKETS    4096
+#define TABLE_CUCKOO_MAX_FLOWS  262144
 #define TABLE_MAC_MAX_FLOWS      1024
 #define TABLE_MAC_NUM_BUCKETS   1024
+#define CHAIN_CACHE_ENTRIES     8192
 
-/* Set of tables chained together in sequence from cheap to expensive. */
 #define CHAIN_MAX_TABLES 4
+
+/* Result of a lookup in the working tables of a chain, remembered by a
+ * microflow cache. */
+struct chain_cache_entry {
+    struct flow key;            /* Fully specified flow that was looked up. */
+    unsigned long long generation; /* sw_chain 'generation' at lookup. */
+    int table_idx;              /* Index of the table that had 'flow'. */
+    struct sw_flow *flow;       /* Flow that matched 'key'. */
+};
+
+/* Microflow cache in front of the working tables of a chain, organized in
+ * sets of two entries.  Entries are only valid if their generation equals the
+ * chain's 'generation', which changes whenever a flow is added, modified or
+ * removed.
+ *
+ * A chain has a cache of its own.  Each forwarding thread has another one,
+ * which also keeps the lookup statistics of the tables while the thread must
+ * not write to the tables; see chain_lookup_cached(). */
+struct chain_cache {
+    struct chain_cache_entry *entries;
+    unsigned int mask;           /* Number of sets minus 1. */
+    unsigned long long n_lookup;
+    unsigned long long n_hit;
+    unsigned long long n_table_lookup[CHAIN_MAX_TABLES];
+    unsigned long long n_table_matched[CHAIN_MAX_TABLES];
+};
+
+/* Set of tables chained together in sequence from cheap to expensive. */
 struct sw_chain {
     int n_tables;                /* Number of working tables, not includes
                                   * protection (emergency) table. */
     struct sw_table *tables[CHAIN_MAX_TABLES];
     struct sw_table *emerg_table;
 
+    struct chain_cache *cache;   /* Null if disabled. */
+    unsigned long long generation; /* Never wraps around. */
+
     struct datapath *dp;
 };
 
@@ -69,6 +105,15 @@ int chain_has_conflict(struct sw_chain *, const struct sw_flow_key *,
 int chain_delete(struct sw_chain *, const struct sw_flow_key *, uint16_t,
                  uint16_t, int, int);
 void chain_timeout(struct sw_chain *, struct list *deleted);
+void chain_set_cache_size(struct sw_chain *, unsigned int n_entries);
+
+struct chain_cache *chain_cache_create(unsigned int n_entries);
+void chain_cache_destroy(struct chain_cache *);
+struct sw_flow *chain_lookup_cached(struct sw_chain *, struct chain_cache *,
+                                    const struct sw_flow_key *);
+void chain_cache_fold(struct sw_chain *, struct chain_cache *);
+void chain_cache_stats(const struct sw_chain *, const struct chain_cache *,
+                       struct sw_table_stats *);
 void chain_destroy(struct sw_chain *);
 
 #endif /* chain.h */
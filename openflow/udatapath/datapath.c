@@ -38,6 +38,7 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include "chain.h"
 #include "csum.h"
@@ -58,13 +59,14 @@
 #include "private-msg.h"
 #include "of_ext_msg.h"
 #include "dp_act.h"
+#include "dp_buffer.h"
+#include "dp_worker.h"
 
 #define THIS_MODULE VLM_datapath
 #include "vlog.h"
 
 #if defined(OF_HW_PLAT)
 #include <openflow/of_hw_api.h>
-#include <pthread.h>
 #endif
 
 #if defined(OF_HW_PLAT) && !defined(USE_NETDEV)
@@ -188,27 +190,12 @@ static void remote_destroy(struct remote *);
 static void update_port_flags(struct datapath *, const struct ofp_port_mod *);
 static void send_port_status(struct sw_port *p, uint8_t status);
 
-/* Buffers are identified by a 31-bit opaque ID.  We divide the ID
- * into a buffer number (low bits) and a cookie (high bits).  The buffer number
- * is an index into an array of buffers.  The cookie distinguishes between
- * different packets that have occupied a single buffer.  Thus, the more
- * buffers we have, the lower-quality the cookie... */
-#define PKT_BUFFER_BITS 8
-#define N_PKT_BUFFERS (1 << PKT_BUFFER_BITS)
-#define PKT_BUFFER_MASK (N_PKT_BUFFERS - 1)
-
-#define PKT_COOKIE_BITS (32 - PKT_BUFFER_BITS)
-
 int run_flow_through_tables(struct datapath *, struct ofpbuf *,
                             struct sw_port *);
 void fwd_port_input(struct datapath *, struct ofpbuf *, struct sw_port *);
 int fwd_control_input(struct datapath *, const struct sender *,
                       const void *, size_t);
 
-uint32_t save_buffer(struct ofpbuf *);
-static struct ofpbuf *retrieve_buffer(uint32_t id);
-static void discard_buffer(uint32_t id);
-
 struct sw_port *
 dp_lookup_port(struct datapath *dp, uint16_t port_no)
 {
@@ -350,10 +337,12 @@ dp_new(struct datapath **dp_, uint64_t dpid)
         free(dp);
         return ENOMEM;
     }
+    dp->buffers = dp_buffers_create(DP_DEFAULT_BUFFERS);
 
     list_init(&dp->port_list);
     dp->flags = 0;
     dp->miss_send_len = OFP_DEFAULT_MISS_SEND_LEN;
+    dp->dump_max_flows = DP_DUMP_FLOWS;
 
     if(strlen(&dp_desc) > 0)	/* use the comment, if specified */
 	    strncpy(dp->dp_desc, &dp_desc, sizeof dp->dp_desc);
@@ -368,6 +357,32 @@ dp_new(struct datapath **dp_, uint64_t dpid)
     return 0;
 }
 
+/* Sets the number of packets that 'dp' can buffer for the controller to
+ * 'n_buffers', dropping any packets buffered so far.  Returns 0 if
+ * successful, otherwise EINVAL if 'n_buffers' is out of range. */
+int
+dp_set_n_buffers(struct datapath *dp, unsigned int n_buffers)
+{
+    if (!n_buffers || n_buffers > DP_MAX_BUFFERS) {
+        return EINVAL;
+    }
+    dp_buffers_destroy(dp->buffers);
+    dp->buffers = dp_buffers_create(n_buffers);
+    return 0;
+}
+
+/* Limits the flow statistics dumps of 'dp' to looking at 'max_flows' flows
+ * and to spending 'max_usecs' microseconds per call to dp_run(), so that
+ * dumping a large flow table does not hold up forwarding for long.  Zero
+ * means no limit. */
+void
+dp_set_dump_budget(struct datapath *dp, unsigned int max_flows,
+                   unsigned int max_usecs)
+{
+    dp->dump_max_flows = max_flows;
+    dp->dump_max_usecs = max_usecs;
+}
+
 static int
 new_port(struct datapath *dp, struct sw_port *port, uint16_t port_no,
          const char *netdev_name, const uint8_t *new_mac, uint16_t num_queues)
@@ -425,6 +440,7 @@ new_port(struct datapath *dp, struct sw_port *port, uint16_t port_no,
     memset(port, '\0', sizeof *port);
 
     list_init(&port->queue_list);
+    pthread_mutex_init(&port->tx_lock, NULL);
     port->dp = dp;
     port->flags |= SWP_USED;
     port->netdev = netdev;
@@ -524,6 +540,24 @@ dp_add_pvconn(struct datapath *dp, struct pvconn *pvconn)
     dp->listeners[dp->n_listeners++] = pvconn;
 }
 
+/* Logs the packet buffer counters of 'dp' if packets have been refused,
+ * evicted or missed since the last call. */
+static void
+log_buffer_stats(struct datapath *dp)
+{
+    static unsigned long long int n_lost;
+    struct dp_buffer_stats s;
+
+    dp_buffers_get_stats(dp->buffers, &s);
+    if (s.n_refused + s.n_evicted + s.n_missed != n_lost) {
+        n_lost = s.n_refused + s.n_evicted + s.n_missed;
+        VLOG_DBG("packet buffers: %u of %u in use, %llu saved, "
+                 "%llu refused, %llu evicted, %llu missed",
+                 s.n_used, s.n_buffers, s.n_saved,
+                 s.n_refused, s.n_evicted, s.n_missed);
+    }
+}
+
 void
 dp_run(struct datapath *dp)
 {
@@ -537,12 +571,14 @@ dp_run(struct datapath *dp)
         struct list deleted = LIST_INITIALIZER(&deleted);
         struct sw_flow *f, *n;
 
+        dp_quiesce(dp);
         chain_timeout(dp->chain, &deleted);
         LIST_FOR_EACH_SAFE (f, n, struct sw_flow, node, &deleted) {
             dp_send_flow_end(dp, f, f->reason);
             list_remove(&f->node);
             flow_free(f);
         }
+        log_buffer_stats(dp);
         dp->last_timeout = now;
     }
     poll_timer_wait(1000);
@@ -562,36 +598,21 @@ dp_run(struct datapath *dp)
     }
 #endif
 
-    LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {
-        int error;
-
-        if (IS_HW_PORT(p)) {
-            continue;
-        }
-        if (!buffer) {
-            /* Allocate buffer with some headroom to add headers in forwarding
-             * to the controller or adding a vlan tag, plus an extra 2 bytes to
-             * allow IP headers to be aligned on a 4-byte boundary.  */
-            const int headroom = 128 + 2;
-            const int hard_header = VLAN_ETH_HEADER_LEN;
-            const int mtu = netdev_get_mtu(p->netdev);
-            buffer = ofpbuf_new(headroom + hard_header + mtu);
-            buffer->data = (char*)buffer->data + headroom;
-        }
-        error = netdev_recv(p->netdev, buffer);
-        if (!error) {
-            p->rx_packets++;
-            p->rx_bytes += buffer->size;
-            fwd_port_input(dp, buffer, p);
-            buffer = NULL;
-        } else if (error != EAGAIN) {
-            VLOG_ERR_RL(&rl, "error receiving data from %s: %s",
-                        netdev_get_name(p->netdev), strerror(error));
+    if (dp_workers_active(dp)) {
+        /* The forwarding threads receive from the ports. */
+        dp_workers_run(dp);
+    } else {
+        LIST_FOR_EACH_SAFE (p, pn, struct sw_port, node, &dp->port_list) {
+            if (!IS_HW_PORT(p)) {
+                dp_recv_batch(dp, p, &buffer);
+            }
         }
     }
     ofpbuf_delete(buffer);
 
-    /* Talk to remotes. */
+    /* Talk to remotes, with a fresh budget for dumps. */
+    dp->dump_n_flows = 0;
+    dp->dump_deadline = 0;
     LIST_FOR_EACH_SAFE (r, rn, struct remote, node, &dp->remotes) {
         remote_run(dp, r);
     }
@@ -609,6 +630,102 @@ dp_run(struct datapath *dp)
         }
         i++;
     }
+
+    dp_flush_ports(dp);
+    dp_unquiesce(dp);
+}
+
+/* Receives up to DP_RECV_BATCH packets from 'p' and forwards them, instead of
+ * going through poll() for every packet.  '*bufferp' is a receive buffer
+ * that is allocated as needed and kept for the next call if unused.  Returns
+ * the number of packets received. */
+int
+dp_recv_batch(struct datapath *dp, struct sw_port *p, struct ofpbuf **bufferp)
+{
+    int n;
+
+    for (n = 0; n < DP_RECV_BATCH; n++) {
+        struct ofpbuf *buffer = *bufferp;
+        int error;
+
+        if (!buffer) {
+            /* Allocate buffer with some headroom to add headers in
+             * forwarding to the controller or adding a vlan tag, plus an
+             * extra 2 bytes to allow IP headers to be aligned on a 4-byte
+             * boundary.  */
+            const int headroom = 128 + 2;
+            const int hard_header = VLAN_ETH_HEADER_LEN;
+            const int mtu = netdev_get_mtu(p->netdev);
+            buffer = *bufferp = ofpbuf_new(headroom + hard_header + mtu);
+            buffer->data = (char*)buffer->data + headroom;
+        }
+        error = netdev_recv(p->netdev, buffer);
+        if (error) {
+            if (error != EAGAIN) {
+                VLOG_ERR_RL(&rl, "error receiving data from %s: %s",
+                            netdev_get_name(p->netdev), strerror(error));
+            }
+            break;
+        }
+        p->rx_packets++;
+        p->rx_bytes += buffer->size;
+        *bufferp = NULL;
+        fwd_port_input(dp, buffer, p);
+    }
+    return n;
+}
+
+/* Transmits the packets that ports with packet rings have queued. */
+void
+dp_flush_ports(struct datapath *dp)
+{
+    struct sw_port *p;
+
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        if (!IS_HW_PORT(p)) {
+            pthread_mutex_lock(&p->tx_lock);
+            netdev_flush(p->netdev);
+            pthread_mutex_unlock(&p->tx_lock);
+        }
+    }
+}
+
+static long long int
+clock_usec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+}
+
+/* Number of flows that dumps look at between readings of the clock, which
+ * costs more than looking at a flow. */
+#define DUMP_CLOCK_FLOWS 32
+
+/* Returns true if dumps have used up their budget for this call to
+ * dp_run(). */
+static bool
+dump_budget_spent(const struct datapath *dp)
+{
+    return ((dp->dump_max_flows && dp->dump_n_flows >= dp->dump_max_flows)
+            || (dp->dump_deadline && clock_usec() >= dp->dump_deadline));
+}
+
+/* Charges a dump for looking at one more flow.  Returns true if the dump
+ * should stop after this flow and yield until the next call to dp_run(). */
+static bool
+dump_budget_charge(struct datapath *dp)
+{
+    if (dp->dump_max_usecs && !dp->dump_deadline) {
+        dp->dump_deadline = clock_usec() + dp->dump_max_usecs;
+    }
+    dp->dump_n_flows++;
+    if (dp->dump_max_flows && dp->dump_n_flows >= dp->dump_max_flows) {
+        return true;
+    }
+    return (dp->dump_deadline && dp->dump_n_flows % DUMP_CLOCK_FLOWS == 0
+            && clock_usec() >= dp->dump_deadline);
 }
 
 static void
@@ -642,7 +759,7 @@ remote_run(struct datapath *dp, struct remote *r)
             }
             ofpbuf_delete(buffer);
         } else {
-            if (r->n_txq < TXQ_LIMIT) {
+            if (r->n_txq < TXQ_LIMIT && !dump_budget_spent(dp)) {
                 int error = r->cb_dump(dp, r->cb_aux);
                 if (error <= 0) {
                     if (error) {
@@ -668,6 +785,11 @@ remote_wait(struct remote *r)
 {
     rconn_run_wait(r->rconn);
     rconn_recv_wait(r->rconn);
+    if (r->cb_dump && r->n_txq < TXQ_LIMIT) {
+        /* The dump yielded to forwarding and continues in the next call to
+         * dp_run(). */
+        poll_immediate_wake();
+    }
 }
 
 static void
@@ -727,11 +849,14 @@ dp_wait(struct datapath *dp)
     struct remote *r;
     size_t i;
 
-    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
-        if (IS_HW_PORT(p)) {
-            continue;
+    if (dp_workers_active(dp)) {
+        dp_workers_wait(dp);
+    } else {
+        LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+            if (!IS_HW_PORT(p)) {
+                netdev_recv_wait(p->netdev);
+            }
         }
-        netdev_recv_wait(p->netdev);
     }
     LIST_FOR_EACH (r, struct remote, node, &dp->remotes) {
         remote_wait(r);
@@ -825,6 +950,7 @@ output_packet(struct datapath *dp, struct ofpbuf *buffer, uint16_t out_port,
                 }
             }
 
+            pthread_mutex_lock(&p->tx_lock);
             if (!netdev_send(p->netdev, buffer, class_id)) {
                 p->tx_packets++;
                 p->tx_bytes += buffer->size;
@@ -835,6 +961,7 @@ output_packet(struct datapath *dp, struct ofpbuf *buffer, uint16_t out_port,
             } else {
                 p->tx_dropped++;
             }
+            pthread_mutex_unlock(&p->tx_lock);
         }
         ofpbuf_delete(buffer);
         return;
@@ -950,7 +1077,11 @@ dp_output_control(struct datapath *dp, struct ofpbuf *buffer, int in_port,
     size_t total_len;
     uint32_t buffer_id;
 
-    buffer_id = save_buffer(buffer);
+    if (dp_worker_output_control(dp, buffer, in_port, max_len, reason)) {
+        return;
+    }
+
+    buffer_id = dp_buffers_save(dp->buffers, buffer);
     total_len = buffer->size;
     if (buffer_id != UINT32_MAX && buffer->size > max_len) {
         buffer->size = max_len;
@@ -1042,7 +1173,7 @@ dp_send_features_reply(struct datapath *dp, const struct sender *sender)
                                sender, &buffer);
     ofr->datapath_id  = htonll(dp->id);
     ofr->n_tables     = dp->chain->n_tables;
-    ofr->n_buffers    = htonl(N_PKT_BUFFERS);
+    ofr->n_buffers    = htonl(dp_buffers_capacity(dp->buffers));
     ofr->capabilities = htonl(OFP_SUPPORTED_CAPABILITIES);
     ofr->actions      = htonl(OFP_SUPPORTED_ACTIONS);
     LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
@@ -1181,6 +1312,7 @@ fill_flow_stats(struct ofpbuf *buffer, struct sw_flow *flow,
 int run_flow_through_tables(struct datapath *dp, struct ofpbuf *buffer,
                             struct sw_port *p)
 {
+    struct chain_cache *cache;
     struct sw_flow_key key;
     struct sw_flow *flow;
 
@@ -1199,7 +1331,10 @@ int run_flow_through_tables(struct datapath *dp, struct ofpbuf *buffer,
         return 0;
     }
 
-    flow = chain_lookup(dp->chain, &key, 0);
+    cache = dp_worker_cache();
+    flow = (cache
+            ? chain_lookup_cached(dp->chain, cache, &key)
+            : chain_lookup(dp->chain, &key, 0));
     if (flow != NULL) {
         flow_used(flow, buffer);
         execute_actions(dp, buffer, &key, flow->sf_acts->actions,
@@ -1302,7 +1437,7 @@ recv_packet_out(struct datapath *dp, const struct sender *sender,
         buffer = ofpbuf_new(data_len);
         ofpbuf_put(buffer, (uint8_t *)opo->actions + actions_len, data_len);
     } else {
-        buffer = retrieve_buffer(ntohl(opo->buffer_id));
+        buffer = dp_buffers_retrieve(dp->buffers, ntohl(opo->buffer_id));
         if (!buffer) {
             return -ESRCH;
         }
@@ -1405,7 +1540,8 @@ add_flow(struct datapath *dp, const struct sender *sender,
 
     error = 0;
     if (ntohl(ofm->buffer_id) != UINT32_MAX) {
-        struct ofpbuf *buffer = retrieve_buffer(ntohl(ofm->buffer_id));
+        struct ofpbuf *buffer = dp_buffers_retrieve(dp->buffers,
+                                                    ntohl(ofm->buffer_id));
         if (buffer) {
             struct sw_flow_key key;
             uint16_t in_port = ntohs(ofm->match.in_port);
@@ -1423,7 +1559,7 @@ error_free_flow:
     flow_free(flow);
 error:
     if (ntohl(ofm->buffer_id) != (uint32_t) -1)
-        discard_buffer(ntohl(ofm->buffer_id));
+        dp_buffers_discard(dp->buffers, ntohl(ofm->buffer_id));
     return error;
 }
 
@@ -1480,7 +1616,8 @@ mod_flow(struct datapath *dp, const struct sender *sender,
 
     error = 0;
     if (ntohl(ofm->buffer_id) != UINT32_MAX) {
-      struct ofpbuf *buffer = retrieve_buffer(ntohl(ofm->buffer_id));
+      struct ofpbuf *buffer = dp_buffers_retrieve(dp->buffers,
+                                                  ntohl(ofm->buffer_id));
       if (buffer) {
             struct sw_flow_key skb_key;
             uint16_t in_port = ntohs(ofm->match.in_port);
@@ -1497,7 +1634,7 @@ error_free_flow:
     flow_free(flow);
 error:
     if (ntohl(ofm->buffer_id) != (uint32_t) -1)
-        discard_buffer(ntohl(ofm->buffer_id));
+        dp_buffers_discard(dp->buffers, ntohl(ofm->buffer_id));
     return error;
 }
 
@@ -1508,6 +1645,9 @@ recv_flow(struct datapath *dp, const struct sender *sender,
     const struct ofp_flow_mod *ofm = msg;
     uint16_t command = ntohs(ofm->command);
 
+    /* The forwarding threads must not look at the tables while they
+     * change. */
+    dp_quiesce(dp);
     if (command == OFPFC_ADD) {
         return add_flow(dp, sender, ofm);
     } else if ((command == OFPFC_MODIFY) || (command == OFPFC_MODIFY_STRICT)) {
@@ -1546,12 +1686,74 @@ desc_stats_dump(struct datapath *dp UNUSED, void *state UNUSED,
     return 0;
 }
 
+/* The flows that a flow or aggregate statistics request asks about.
+ *
+ * Dumps look at the flows a budget at a time (see dump_budget_charge()), so
+ * unless the match is exact, which hash tables look up directly, the tables
+ * pass every flow to the dump to filter.  Otherwise a dump that matched few
+ * flows could scan an entire table without yielding. */
+struct stats_filter {
+    struct sw_flow_key key;       /* Flows to report. */
+    uint16_t out_port;            /* Output port to report, network order. */
+    struct sw_flow_key iter_key;  /* Key and output port to iterate with. */
+    uint16_t iter_out_port;
+};
+
+static void
+stats_filter_init(struct stats_filter *f, const struct ofp_match *match,
+                  uint16_t out_port)
+{
+    flow_extract_match(&f->key, match);
+    f->out_port = out_port;
+    if (f->key.wildcards) {
+        struct ofp_match all;
+
+        memset(&all, 0, sizeof all);
+        all.wildcards = htonl(OFPFW_ALL);
+        flow_extract_match(&f->iter_key, &all);
+        f->iter_out_port = htons(OFPP_NONE);
+    } else {
+        f->iter_key = f->key;
+        f->iter_out_port = out_port;
+    }
+}
+
+static bool
+stats_filter_match(const struct stats_filter *f, struct sw_flow *flow)
+{
+    return (flow_matches_2wild(&f->key, &flow->key)
+            && flow_has_out_port(flow, f->out_port));
+}
+
+/* Returns true if 'f' asks about every flow. */
+static bool
+stats_filter_is_all(const struct stats_filter *f)
+{
+    static const struct flow zero;
+    struct flow mask;
+
+    flow_key_mask(&mask, &f->key);
+    return (!memcmp(&mask, &zero, sizeof mask)
+            && f->out_port == htons(OFPP_NONE));
+}
+
+static int
+stats_filter_iterate(struct sw_table *table, struct stats_filter *f,
+                     struct sw_table_position *position,
+                     int (*callback)(struct sw_flow *, void *), void *aux)
+{
+    return table->iterate(table, &f->iter_key, f->iter_out_port, position,
+                          callback, aux);
+}
+
 struct flow_stats_state {
     int table_idx;
     struct sw_table_position position;
     struct ofp_flow_stats_request rq;
+    struct stats_filter filter;
     uint64_t now;                  /* Current time in milliseconds */
 
+    struct datapath *dp;
     struct ofpbuf *buffer;
 };
 
@@ -1566,6 +1768,7 @@ flow_stats_init(const void *body, int body_len UNUSED, void **state)
     s->table_idx = fsr->table_id == 0xff ? 0 : fsr->table_id;
     memset(&s->position, 0, sizeof s->position);
     s->rq = *fsr;
+    stats_filter_init(&s->filter, &fsr->match, fsr->out_port);
     *state = s;
     return 0;
 }
@@ -1573,40 +1776,41 @@ flow_stats_init(const void *body, int body_len UNUSED, void **state)
 static int flow_stats_dump_callback(struct sw_flow *flow, void *private)
 {
     struct flow_stats_state *s = private;
-    fill_flow_stats(s->buffer, flow, s->table_idx, s->now);
-    return s->buffer->size >= MAX_FLOW_STATS_BYTES;
+    if (stats_filter_match(&s->filter, flow))
+        fill_flow_stats(s->buffer, flow, s->table_idx, s->now);
+    return (dump_budget_charge(s->dp)
+            || s->buffer->size >= MAX_FLOW_STATS_BYTES);
 }
 
 static int flow_stats_dump(struct datapath *dp, void *state,
                            struct ofpbuf *buffer)
 {
     struct flow_stats_state *s = state;
-    struct sw_flow_key match_key;
 
-    flow_extract_match(&match_key, &s->rq.match);
+    s->dp = dp;
     s->buffer = buffer;
     s->now = time_msec();
 
     if (s->rq.table_id == EMERG_TABLE_ID_FOR_STATS) {
         struct sw_table *table = dp->chain->emerg_table;
 
-        table->iterate(table, &match_key, s->rq.out_port,
-                       &s->position, flow_stats_dump_callback, s);
+        return stats_filter_iterate(table, &s->filter, &s->position,
+                                    flow_stats_dump_callback, s) != 0;
     } else {
         while (s->table_idx < dp->chain->n_tables
                && (s->rq.table_id == 0xff || s->rq.table_id == s->table_idx))
         {
             struct sw_table *table = dp->chain->tables[s->table_idx];
 
-            if (table->iterate(table, &match_key, s->rq.out_port,
-                               &s->position, flow_stats_dump_callback, s))
-                break;
+            if (stats_filter_iterate(table, &s->filter, &s->position,
+                                     flow_stats_dump_callback, s))
+                return 1;
 
             s->table_idx++;
             memset(&s->position, 0, sizeof s->position);
         }
     }
-    return s->buffer->size >= MAX_FLOW_STATS_BYTES;
+    return 0;
 }
 
 static void flow_stats_done(void *state)
@@ -1616,25 +1820,57 @@ static void flow_stats_done(void *state)
 
 struct aggregate_stats_state {
     struct ofp_aggregate_stats_request rq;
+    struct stats_filter filter;
+    int table_idx;
+    struct sw_table_position position;
+    struct datapath *dp;
+
+    /* Sums over the flows looked at so far. */
+    uint64_t packet_count;
+    uint64_t byte_count;
+    uint32_t flow_count;
 };
 
 static int
 aggregate_stats_init(const void *body, int body_len UNUSED, void **state)
 {
     const struct ofp_aggregate_stats_request *rq = body;
-    struct aggregate_stats_state *s = xmalloc(sizeof *s);
+    struct aggregate_stats_state *s = xcalloc(1, sizeof *s);
     s->rq = *rq;
+    stats_filter_init(&s->filter, &rq->match, rq->out_port);
+    s->table_idx = rq->table_id == 0xff ? 0 : rq->table_id;
     *state = s;
     return 0;
 }
 
 static int aggregate_stats_dump_callback(struct sw_flow *flow, void *private)
 {
-    struct ofp_aggregate_stats_reply *rpy = private;
-    rpy->packet_count += flow->packet_count;
-    rpy->byte_count += flow->byte_count;
-    rpy->flow_count++;
-    return 0;
+    struct aggregate_stats_state *s = private;
+    if (stats_filter_match(&s->filter, flow)) {
+        s->packet_count += flow->packet_count;
+        s->byte_count += flow->byte_count;
+        s->flow_count++;
+    }
+    return dump_budget_charge(s->dp);
+}
+
+/* Adds the flows of 'table' to the sums in 's'.  Returns nonzero if the dump
+ * has to yield before it is done with 'table'. */
+static int
+aggregate_table(struct aggregate_stats_state *s, struct sw_table *table)
+{
+    if (stats_filter_is_all(&s->filter)) {
+        /* The running totals of the table answer this directly. */
+        struct sw_table_stats stats;
+
+        table->stats(table, &stats);
+        s->packet_count += table->totals.packet_count;
+        s->byte_count += table->totals.byte_count;
+        s->flow_count += stats.n_flows;
+        return 0;
+    }
+    return stats_filter_iterate(table, &s->filter, &s->position,
+                                aggregate_stats_dump_callback, s);
 }
 
 static int aggregate_stats_dump(struct datapath *dp, void *state,
@@ -1643,44 +1879,28 @@ static int aggregate_stats_dump(struct datapath *dp, void *state,
     struct aggregate_stats_state *s = state;
     struct ofp_aggregate_stats_request *rq = &s->rq;
     struct ofp_aggregate_stats_reply *rpy;
-    struct sw_table_position position;
-    struct sw_flow_key match_key;
-    int table_idx;
-    int error;
-
-    rpy = ofpbuf_put_uninit(buffer, sizeof *rpy);
-    memset(rpy, 0, sizeof *rpy);
-
-    flow_extract_match(&match_key, &rq->match);
-    table_idx = rq->table_id == 0xff ? 0 : rq->table_id;
-    memset(&position, 0, sizeof position);
 
+    s->dp = dp;
     if (rq->table_id == EMERG_TABLE_ID_FOR_STATS) {
-        struct sw_table *table = dp->chain->emerg_table;
-
-        error = table->iterate(table, &match_key, rq->out_port, &position,
-                               aggregate_stats_dump_callback, rpy);
-        if (error)
-            return error;
+        if (aggregate_table(s, dp->chain->emerg_table))
+            return 1;
     } else {
-        while (table_idx < dp->chain->n_tables
-               && (rq->table_id == 0xff || rq->table_id == table_idx))
+        while (s->table_idx < dp->chain->n_tables
+               && (rq->table_id == 0xff || rq->table_id == s->table_idx))
         {
-            struct sw_table *table = dp->chain->tables[table_idx];
-
-            error = table->iterate(table, &match_key, rq->out_port, &position,
-                                   aggregate_stats_dump_callback, rpy);
-            if (error)
-                return error;
+            if (aggregate_table(s, dp->chain->tables[s->table_idx]))
+                return 1;
 
-            table_idx++;
-            memset(&position, 0, sizeof position);
+            s->table_idx++;
+            memset(&s->position, 0, sizeof s->position);
         }
     }
 
-    rpy->packet_count = htonll(rpy->packet_count);
-    rpy->byte_count = htonll(rpy->byte_count);
-    rpy->flow_count = htonl(rpy->flow_count);
+    rpy = ofpbuf_put_uninit(buffer, sizeof *rpy);
+    memset(rpy, 0, sizeof *rpy);
+    rpy->packet_count = htonll(s->packet_count);
+    rpy->byte_count = htonll(s->byte_count);
+    rpy->flow_count = htonl(s->flow_count);
     return 0;
 }
 
@@ -1689,23 +1909,41 @@ static void aggregate_stats_done(void *state)
     free(state);
 }
 
+static void
+put_table_stats(struct ofpbuf *buffer, int table_id,
+                const struct sw_table_stats *stats)
+{
+    struct ofp_table_stats *ots = ofpbuf_put_uninit(buffer, sizeof *ots);
+    strncpy(ots->name, stats->name, sizeof ots->name);
+    ots->table_id = table_id;
+    ots->wildcards = htonl(stats->wildcards);
+    memset(ots->pad, 0, sizeof ots->pad);
+    ots->max_entries = htonl(stats->max_flows);
+    ots->active_count = htonl(stats->n_flows);
+    ots->lookup_count = htonll(stats->n_lookup);
+    ots->matched_count = htonll(stats->n_matched);
+}
+
 static int
 table_stats_dump(struct datapath *dp, void *state UNUSED,
                  struct ofpbuf *buffer)
 {
+    struct sw_table_stats stats;
     int i;
+
+    /* Parking the forwarding threads folds their counts into the tables. */
+    dp_quiesce(dp);
     for (i = 0; i < dp->chain->n_tables; i++) {
-        struct ofp_table_stats *ots = ofpbuf_put_uninit(buffer, sizeof *ots);
-        struct sw_table_stats stats;
         dp->chain->tables[i]->stats(dp->chain->tables[i], &stats);
-        strncpy(ots->name, stats.name, sizeof ots->name);
-        ots->table_id = i;
-        ots->wildcards = htonl(stats.wildcards);
-        memset(ots->pad, 0, sizeof ots->pad);
-        ots->max_entries = htonl(stats.max_flows);
-        ots->active_count = htonl(stats.n_flows);
-        ots->lookup_count = htonll(stats.n_lookup);
-        ots->matched_count = htonll(stats.n_matched);
+        put_table_stats(buffer, i, &stats);
+    }
+
+    /* The microflow caches follow the real tables.  Their lookup and matched
+     * counts give the cache hit rate. */
+    if (dp->chain->cache) {
+        chain_cache_stats(dp->chain, dp->chain->cache, &stats);
+        dp_workers_cache_stats(dp, &stats);
+        put_table_stats(buffer, i, &stats);
     }
     return 0;
 }
@@ -2061,6 +2299,11 @@ stats_dump(struct datapath *dp, void *cb_)
     osr->flags = 0;
 
     err = cb->s->dump(dp, cb->state, buffer);
+    if (err > 0 && buffer->size == sizeof *osr) {
+        /* The dump yielded before it found anything to send. */
+        ofpbuf_delete(buffer);
+        return err;
+    }
     if (err >= 0) {
         int err2;
         if (!err) {
@@ -2306,70 +2549,3 @@ fwd_control_input(struct datapath *dp, const struct sender *sender,
     return handler(dp, sender, msg);
 }
 
-/* Packet buffering. */
-
-#define OVERWRITE_SECS  1
-
-struct packet_buffer {
-    struct ofpbuf *buffer;
-    uint32_t cookie;
-    time_t timeout;
-};
-
-static struct packet_buffer buffers[N_PKT_BUFFERS];
-static unsigned int buffer_idx;
-
-uint32_t save_buffer(struct ofpbuf *buffer)
-{
-    struct packet_buffer *p;
-    uint32_t id;
-
-    buffer_idx = (buffer_idx + 1) & PKT_BUFFER_MASK;
-    p = &buffers[buffer_idx];
-    if (p->buffer) {
-        /* Don't buffer packet if existing entry is less than
-         * OVERWRITE_SECS old. */
-        if (time_now() < p->timeout) { /* FIXME */
-                return (uint32_t)-1;
-        } else {
-            ofpbuf_delete(p->buffer);
-        }
-    }
-    /* Don't use maximum cookie value since the all-bits-1 id is
-     * special. */
-    if (++p->cookie >= (1u << PKT_COOKIE_BITS) - 1)
-        p->cookie = 0;
-    p->buffer = ofpbuf_clone(buffer);      /* FIXME */
-    p->timeout = time_now() + OVERWRITE_SECS; /* FIXME */
-    id = buffer_idx | (p->cookie << PKT_BUFFER_BITS);
-
-    return id;
-}
-
-static struct ofpbuf *retrieve_buffer(uint32_t id)
-{
-    struct ofpbuf *buffer = NULL;
-    struct packet_buffer *p;
-
-    p = &buffers[id & PKT_BUFFER_MASK];
-    if (p->cookie == id >> PKT_BUFFER_BITS) {
-        buffer = p->buffer;
-        p->buffer = NULL;
-    } else {
-        printf("cookie mismatch: %x != %x\n",
-               id >> PKT_BUFFER_BITS, p->cookie);
-    }
-
-    return buffer;
-}
-
-static void discard_buffer(uint32_t id)
-{
-    struct packet_buffer *p;
-
-    p = &buffers[id & PKT_BUFFER_MASK];
-    if (p->cookie == id >> PKT_BUFFER_BITS) {
-        ofpbuf_delete(p->buffer);
-        p->buffer = NULL;
-    }
-}
@@ -36,6 +36,7 @@
 #ifndef DATAPATH_H
 #define DATAPATH_H 1
 
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include "openflow/nicira-ext.h"
@@ -53,6 +54,8 @@ struct rconn;
 struct pvconn;
 struct sw_flow;
 struct sender;
+struct dp_buffers;
+struct dp_workers;
 
 struct sw_queue {
     struct list node; /* element in port.queues */
@@ -96,6 +99,8 @@ struct sw_port {
     uint16_t num_queues;
     struct sw_queue queues[NETDEV_MAX_QUEUES];
     struct list queue_list; /* list of all queues for this port */
+    pthread_mutex_t tx_lock; /* Serializes transmission and its counters
+                              * among forwarding threads. */
 };
 
 #if defined(OF_HW_PLAT)
@@ -110,6 +115,13 @@ struct hw_pkt_q_entry {
 #define DP_MAX_PORTS 255
 BUILD_ASSERT_DECL(DP_MAX_PORTS <= OFPP_MAX);
 
+/* Maximum number of packets received from one port per call to dp_run(). */
+#define DP_RECV_BATCH 64
+
+/* Default number of flows that statistics dumps look at per call to
+ * dp_run(). */
+#define DP_DUMP_FLOWS 1024
+
 struct datapath {
     /* Remote connections. */
     struct list remotes;        /* All connections (including controller). */
@@ -135,6 +147,20 @@ struct datapath {
     struct sw_port *local_port;  /* OFPP_LOCAL port, if any. */
     struct list port_list; /* All ports, including local_port. */
 
+    /* Packets buffered for the controller. */
+    struct dp_buffers *buffers;
+
+    /* Forwarding threads, null if the main thread forwards packets. */
+    struct dp_workers *workers;
+
+    /* How much work flow statistics dumps may do per call to dp_run() before
+     * they yield to forwarding, in flows looked at and in microseconds, zero
+     * for no limit, and how much they have done in the current call. */
+    unsigned int dump_max_flows;
+    unsigned int dump_max_usecs;
+    unsigned int dump_n_flows;
+    long long int dump_deadline;  /* In microseconds, 0 if not yet set. */
+
 #if defined(OF_HW_PLAT)
     /* Although the chain maintains the pointer to the HW driver
      * for flow operations, the datapath needs the port functions
@@ -146,11 +172,16 @@ struct datapath {
 };
 
 int dp_new(struct datapath **, uint64_t dpid);
+int dp_set_n_buffers(struct datapath *, unsigned int n_buffers);
+void dp_set_dump_budget(struct datapath *, unsigned int max_flows,
+                        unsigned int max_usecs);
 int dp_add_port(struct datapath *, const char *netdev, uint16_t);
 int dp_add_local_port(struct datapath *, const char *netdev, uint16_t);
 void dp_add_pvconn(struct datapath *, struct pvconn *);
 void dp_run(struct datapath *);
 void dp_wait(struct datapath *);
+int dp_recv_batch(struct datapath *, struct sw_port *, struct ofpbuf **);
+void dp_flush_ports(struct datapath *);
 void dp_send_error_msg(struct datapath *, const struct sender *,
                   uint16_t, uint16_t, const void *, size_t);
 void dp_send_flow_end(struct datapath *, struct sw_flow *,
@@ -0,0 +1,264 @@
+/* Copyright (c) 2008 The Board of Trustees of The Leland Stanford
+ * Junior University
+ * 
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+#include <config.h>
+#include "dp_buffer.h"
+#include <assert.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include "list.h"
+#include "ofpbuf.h"
+#include "timeval.h"
+#include "util.h"
+
+#define THIS_MODULE VLM_datapath
+#include "vlog.h"
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+/* Slots are allocated this many at a time, so that growing the store never
+ * moves them. */
+#define DP_BUFFER_SLAB_BITS 8
+#define DP_BUFFER_SLAB_SIZE (1 << DP_BUFFER_SLAB_BITS)
+
+struct dp_buffer {
+    struct list node;           /* In 'free' or 'used' of dp_buffers. */
+    struct ofpbuf *packet;      /* Buffered packet, or a spare one. */
+    long long int expires;      /* Packet may be evicted from then on. */
+    uint32_t cookie;
+    uint32_t idx;               /* Index of this slot. */
+    bool used;                  /* Does 'packet' hold a buffered packet? */
+};
+
+struct dp_buffers {
+    struct dp_buffer **slabs;
+    unsigned int n_buffers;     /* Maximum number of slots. */
+    unsigned int n_slots;       /* Slots allocated so far. */
+    unsigned int n_used;
+    int idx_bits;               /* Bits of a buffer id that index a slot. */
+    struct list free;           /* Empty slots, most recently used first. */
+    struct list used;           /* Slots with packets, oldest first. */
+
+    unsigned long long int n_saved;
+    unsigned long long int n_refused;
+    unsigned long long int n_evicted;
+    unsigned long long int n_missed;
+};
+
+/* Creates and returns a store for up to 'n_buffers' packets, which must be
+ * between 1 and DP_MAX_BUFFERS. */
+struct dp_buffers *
+dp_buffers_create(unsigned int n_buffers)
+{
+    struct dp_buffers *b;
+
+    assert(n_buffers > 0 && n_buffers <= DP_MAX_BUFFERS);
+    b = xcalloc(1, sizeof *b);
+    b->slabs = xcalloc(ROUND_UP(n_buffers, DP_BUFFER_SLAB_SIZE)
+                       / DP_BUFFER_SLAB_SIZE,
+                       sizeof *b->slabs);
+    b->n_buffers = n_buffers;
+    for (b->idx_bits = DP_BUFFER_SLAB_BITS; (1u << b->idx_bits) < n_buffers;
+         b->idx_bits++)
+        continue;
+    list_init(&b->free);
+    list_init(&b->used);
+    return b;
+}
+
+/* Destroys 'b' and frees all the packets in it. */
+void
+dp_buffers_destroy(struct dp_buffers *b)
+{
+    unsigned int i, j;
+
+    if (!b)
+        return;
+    for (i = 0; i < b->n_slots; i += DP_BUFFER_SLAB_SIZE) {
+        struct dp_buffer *slab = b->slabs[i >> DP_BUFFER_SLAB_BITS];
+        for (j = 0; j < DP_BUFFER_SLAB_SIZE && i + j < b->n_slots; j++)
+            ofpbuf_delete(slab[j].packet);
+        free(slab);
+    }
+    free(b->slabs);
+    free(b);
+}
+
+/* Returns the maximum number of packets that 'b' buffers. */
+unsigned int
+dp_buffers_capacity(const struct dp_buffers *b)
+{
+    return b->n_buffers;
+}
+
+void
+dp_buffers_get_stats(const struct dp_buffers *b, struct dp_buffer_stats *s)
+{
+    s->n_buffers = b->n_buffers;
+    s->n_slots = b->n_slots;
+    s->n_used = b->n_used;
+    s->n_saved = b->n_saved;
+    s->n_refused = b->n_refused;
+    s->n_evicted = b->n_evicted;
+    s->n_missed = b->n_missed;
+}
+
+/* Adds a slab of empty slots to 'b', which must not have reached its
+ * maximum size yet. */
+static void
+add_slab(struct dp_buffers *b)
+{
+    unsigned int n = MIN(b->n_buffers - b->n_slots, DP_BUFFER_SLAB_SIZE);
+    struct dp_buffer *slab = xcalloc(n, sizeof *slab);
+    unsigned int i;
+
+    for (i = 0; i < n; i++) {
+        slab[i].idx = b->n_slots + i;
+        list_push_back(&b->free, &slab[i].node);
+    }
+    b->slabs[b->n_slots >> DP_BUFFER_SLAB_BITS] = slab;
+    b->n_slots += n;
+}
+
+/* Empties 'p', keeping its packet's memory for the next packet. */
+static void
+release(struct dp_buffers *b, struct dp_buffer *p)
+{
+    list_remove(&p->node);
+    p->used = false;
+    b->n_used--;
+    if (p->packet)
+        ofpbuf_clear(p->packet);
+    list_push_front(&b->free, &p->node);
+}
+
+/* Returns a slot of 'b' for a new packet, or a null pointer if all of them
+ * hold packets that are too recent to evict. */
+static struct dp_buffer *
+get_slot(struct dp_buffers *b)
+{
+    struct dp_buffer *p;
+
+    if (list_is_empty(&b->free)) {
+        if (b->n_slots < b->n_buffers) {
+            add_slab(b);
+        } else {
+            p = CONTAINER_OF(list_front(&b->used), struct dp_buffer, node);
+            if (time_msec() < p->expires)
+                return NULL;
+            release(b, p);
+            b->n_evicted++;
+        }
+    }
+    return CONTAINER_OF(list_pop_front(&b->free), struct dp_buffer, node);
+}
+
+/* Buffers a copy of 'packet' in 'b' and returns its buffer id, or UINT32_MAX
+ * if 'b' has no room for it. */
+uint32_t
+dp_buffers_save(struct dp_buffers *b, const struct ofpbuf *packet)
+{
+    uint32_t cookie_mask = UINT32_MAX >> b->idx_bits;
+    struct dp_buffer *p;
+    uint32_t id;
+
+    p = get_slot(b);
+    if (!p) {
+        b->n_refused++;
+        VLOG_DBG_RL(&rl, "all %u packet buffers in use", b->n_buffers);
+        return UINT32_MAX;
+    }
+
+    /* The all-bits-1 id means "no buffer", so skip the cookie that yields
+     * it. */
+    do {
+        p->cookie = (p->cookie + 1) & cookie_mask;
+        id = p->idx | (p->cookie << b->idx_bits);
+    } while (id == UINT32_MAX);
+
+    if (p->packet)
+        ofpbuf_put(p->packet, packet->data, packet->size);
+    else
+        p->packet = ofpbuf_clone(packet);
+    p->expires = time_msec() + DP_BUFFER_TIMEOUT_MS;
+    p->used = true;
+    list_push_back(&b->used, &p->node);
+    b->n_used++;
+    b->n_saved++;
+    return id;
+}
+
+/* Returns the slot of 'b' that holds the packet with the given 'id', or a
+ * null pointer if there is none. */
+static struct dp_buffer *
+lookup(struct dp_buffers *b, uint32_t id)
+{
+    uint32_t idx = id & ((1u << b->idx_bits) - 1);
+    struct dp_buffer *p;
+
+    if (idx >= b->n_slots)
+        return NULL;
+    p = &b->slabs[idx >> DP_BUFFER_SLAB_BITS][idx & (DP_BUFFER_SLAB_SIZE - 1)];
+    return p->used && p->cookie == id >> b->idx_bits ? p : NULL;
+}
+
+/* Removes the packet with the given 'id' from 'b' and returns it, or returns
+ * a null pointer if 'b' does not hold it (any longer).  The caller takes
+ * ownership of the packet. */
+struct ofpbuf *
+dp_buffers_retrieve(struct dp_buffers *b, uint32_t id)
+{
+    struct dp_buffer *p = lookup(b, id);
+    struct ofpbuf *packet;
+
+    if (!p) {
+        b->n_missed++;
+        VLOG_DBG_RL(&rl, "no buffered packet with id %#"PRIx32, id);
+        return NULL;
+    }
+    packet = p->packet;
+    p->packet = NULL;
+    release(b, p);
+    return packet;
+}
+
+/* Drops the packet with the given 'id' from 'b', if it is there. */
+void
+dp_buffers_discard(struct dp_buffers *b, uint32_t id)
+{
+    struct dp_buffer *p = lookup(b, id);
+
+    if (p)
+        release(b, p);
+}
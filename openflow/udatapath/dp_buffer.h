@@ -0,0 +1,82 @@
+/* Copyright (c) 2008 The Board of Trustees of The Leland Stanford
+ * Junior University
+ * 
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+#ifndef DP_BUFFER_H
+#define DP_BUFFER_H 1
+
+#include <stdint.h>
+
+struct ofpbuf;
+
+/* Packets buffered for the controller.
+ *
+ * A packet sent to the controller in a packet_in message is kept in the
+ * switch, so that the controller can refer to it by a buffer id in a later
+ * packet_out or flow_mod instead of sending it back.  The store starts
+ * small and grows on demand, a slab of slots at a time, up to the number of
+ * buffers it was created with.  A buffer id encodes the index of the slot
+ * (low bits) and a cookie (high bits) that the slot changes each time it
+ * takes a new packet, so that stale ids are recognized.
+ *
+ * A packet is kept for at least DP_BUFFER_TIMEOUT_MS.  When the store is at
+ * its maximum size, the oldest packet is evicted if it is older than that,
+ * otherwise the new packet is not buffered. */
+
+/* Default and maximum number of buffers. */
+#define DP_DEFAULT_BUFFERS 4096
+#define DP_MAX_BUFFERS (1 << 24)
+
+/* Minimum time that a packet stays buffered, in milliseconds. */
+#define DP_BUFFER_TIMEOUT_MS 1000
+
+struct dp_buffer_stats {
+    unsigned int n_buffers;     /* Maximum number of packets buffered. */
+    unsigned int n_slots;       /* Slots allocated so far. */
+    unsigned int n_used;        /* Slots that hold a packet. */
+    unsigned long long int n_saved;   /* Packets buffered. */
+    unsigned long long int n_refused; /* Packets not buffered, store full. */
+    unsigned long long int n_evicted; /* Packets dropped, never retrieved. */
+    unsigned long long int n_missed;  /* Lookups of unknown or stale ids. */
+};
+
+struct dp_buffers *dp_buffers_create(unsigned int n_buffers);
+void dp_buffers_destroy(struct dp_buffers *);
+unsigned int dp_buffers_capacity(const struct dp_buffers *);
+void dp_buffers_get_stats(const struct dp_buffers *,
+                          struct dp_buffer_stats *);
+
+uint32_t dp_buffers_save(struct dp_buffers *, const struct ofpbuf *);
+struct ofpbuf *dp_buffers_retrieve(struct dp_buffers *, uint32_t id);
+void dp_buffers_discard(struct dp_buffers *, uint32_t id);
+
+#endif /* dp_buffer.h */
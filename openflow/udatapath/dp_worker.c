@@ -0,0 +1,425 @@
+/* Copyright (c) 2008 The Board of Trustees of The Leland Stanford
+ * Junior University
+ * 
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+#include <config.h>
+#include "dp_worker.h"
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "chain.h"
+#include "datapath.h"
+#include "list.h"
+#include "netdev.h"
+#include "ofpbuf.h"
+#include "poll-loop.h"
+#include "socket-util.h"
+#include "table.h"
+#include "util.h"
+
+#define THIS_MODULE VLM_datapath
+#include "vlog.h"
+
+/* Maximum number of packets queued for the controller by forwarding
+ * threads.  More are dropped, as the controller connections could not keep
+ * up with them anyway. */
+#define DP_MAX_UPCALLS 1024
+
+static struct vlog_rate_limit rl = VLOG_RATE_LIMIT_INIT(60, 60);
+
+/* A packet that a forwarding thread sends to the controller. */
+struct dp_upcall {
+    struct list node;           /* Element in dp_workers 'upcalls'. */
+    struct ofpbuf *buffer;
+    int in_port;
+    size_t max_len;
+    int reason;
+};
+
+/* A forwarding thread. */
+struct dp_worker {
+    struct dp_workers *workers;
+    pthread_t thread;
+    struct sw_port **ports;     /* Ports that this thread receives from. */
+    size_t n_ports;
+    struct chain_cache *cache;  /* Microflow cache private to this thread. */
+    int wake_fds[2];            /* Pipe to wake up the thread for parking. */
+};
+
+/* All the forwarding threads of a datapath. */
+struct dp_workers {
+    struct datapath *dp;
+    struct dp_worker *threads;
+    size_t n_threads;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;        /* Signaled when 'pause' or 'n_parked'
+                                 * change. */
+
+    /* Parking.  Forwarding threads check 'pause' between batches of
+     * packets without taking 'mutex', which protects all the rest. */
+    volatile bool pause;        /* Main thread wants the threads parked? */
+    size_t n_parked;            /* Number of threads parked. */
+
+    /* Packets for the controller. */
+    struct list upcalls;        /* Contains "struct dp_upcall"s. */
+    size_t n_upcalls;
+    int upcall_fds[2];          /* Pipe to wake up the main thread. */
+};
+
+/* The forwarding thread that is running, null in the main thread. */
+static __thread struct dp_worker *current_worker;
+
+static void *worker_main(void *);
+
+static void
+make_pipe(int fds[2])
+{
+    if (pipe(fds)) {
+        ofp_fatal(errno, "could not create pipe");
+    }
+    set_nonblocking(fds[0]);
+    set_nonblocking(fds[1]);
+}
+
+static void
+wake(int fd)
+{
+    /* A full pipe wakes up the reader just as well. */
+    write(fd, "", 1);
+}
+
+static void
+drain_pipe(int fd)
+{
+    char buffer[128];
+
+    while (read(fd, buffer, sizeof buffer) > 0) {
+        continue;
+    }
+}
+
+/* Starts 'n_threads' forwarding threads for 'dp', among which the ports of
+ * 'dp' are distributed round-robin.  There are never more threads than ports.
+ * Must be called after all the ports have been added to 'dp'.  Returns 0 if
+ * successful, otherwise a positive errno value. */
+int
+dp_workers_start(struct datapath *dp, int n_threads)
+{
+    struct dp_workers *workers;
+    struct sw_port *p;
+    sigset_t all, old;
+    size_t n_ports, i;
+
+    assert(!dp->workers);
+
+    n_ports = 0;
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        n_ports += !IS_HW_PORT(p);
+    }
+    n_threads = MIN(n_threads, n_ports);
+    if (n_threads <= 0) {
+        return 0;
+    }
+
+    workers = xcalloc(1, sizeof *workers);
+    workers->dp = dp;
+    workers->threads = xcalloc(n_threads, sizeof *workers->threads);
+    workers->n_threads = n_threads;
+    pthread_mutex_init(&workers->mutex, NULL);
+    pthread_cond_init(&workers->cond, NULL);
+    list_init(&workers->upcalls);
+    make_pipe(workers->upcall_fds);
+
+    i = 0;
+    LIST_FOR_EACH (p, struct sw_port, node, &dp->port_list) {
+        struct dp_worker *w;
+
+        if (IS_HW_PORT(p)) {
+            continue;
+        }
+        w = &workers->threads[i++ % n_threads];
+        w->ports = xrealloc(w->ports, (w->n_ports + 1) * sizeof *w->ports);
+        w->ports[w->n_ports++] = p;
+    }
+
+    /* Signals, including the timer that timeval relies on, go to the main
+     * thread only. */
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    dp->workers = workers;
+    for (i = 0; i < n_threads; i++) {
+        struct dp_worker *w = &workers->threads[i];
+        int error;
+
+        w->workers = workers;
+        w->cache = chain_cache_create(CHAIN_CACHE_ENTRIES);
+        if (!w->cache) {
+            ofp_fatal(0, "failed to allocate microflow cache");
+        }
+        make_pipe(w->wake_fds);
+        error = pthread_create(&w->thread, NULL, worker_main, w);
+        if (error) {
+            ofp_fatal(error, "failed to start forwarding thread");
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    VLOG_INFO("forwarding %zu ports with %d threads", n_ports, n_threads);
+    return 0;
+}
+
+/* Returns true if forwarding threads receive the packets of 'dp''s ports,
+ * false if the main thread does. */
+bool
+dp_workers_active(const struct datapath *dp)
+{
+    return dp->workers != NULL;
+}
+
+/* Parks the calling forwarding thread until the main thread lets it go. */
+static void
+park(struct dp_workers *workers)
+{
+    pthread_mutex_lock(&workers->mutex);
+    workers->n_parked++;
+    pthread_cond_broadcast(&workers->cond);
+    while (workers->pause) {
+        pthread_cond_wait(&workers->cond, &workers->mutex);
+    }
+    workers->n_parked--;
+    pthread_mutex_unlock(&workers->mutex);
+}
+
+static void *
+worker_main(void *worker_)
+{
+    struct dp_worker *w = worker_;
+    struct dp_workers *workers = w->workers;
+    struct datapath *dp = workers->dp;
+    struct ofpbuf *buffer = NULL;
+    struct pollfd *pollfds;
+    size_t i;
+
+    current_worker = w;
+
+    pollfds = xmalloc((w->n_ports + 1) * sizeof *pollfds);
+    for (i = 0; i < w->n_ports; i++) {
+        pollfds[i].fd = netdev_get_fd(w->ports[i]->netdev);
+        pollfds[i].events = POLLIN;
+    }
+    pollfds[w->n_ports].fd = w->wake_fds[0];
+    pollfds[w->n_ports].events = POLLIN;
+
+    for (;;) {
+        int n_received = 0;
+
+        if (workers->pause) {
+            park(workers);
+        }
+
+        for (i = 0; i < w->n_ports; i++) {
+            n_received += dp_recv_batch(dp, w->ports[i], &buffer);
+        }
+        if (n_received) {
+            dp_flush_ports(dp);
+            continue;
+        }
+
+        if (poll(pollfds, w->n_ports + 1, -1) < 0 && errno != EINTR) {
+            VLOG_ERR_RL(&rl, "poll failed: %s", strerror(errno));
+        }
+        if (pollfds[w->n_ports].revents) {
+            drain_pipe(w->wake_fds[0]);
+        }
+    }
+    return NULL;
+}
+
+/* Waits until all the forwarding threads of 'dp' are parked, if there are any
+ * and they are not parked already, so that the main thread may change what
+ * they read.  Also adds the table statistics that the threads kept to the
+ * tables.  Must be called from the main thread. */
+void
+dp_quiesce(struct datapath *dp)
+{
+    struct dp_workers *workers = dp->workers;
+    size_t i;
+
+    if (!workers || workers->pause) {
+        return;
+    }
+    assert(!current_worker);
+
+    pthread_mutex_lock(&workers->mutex);
+    workers->pause = true;
+    pthread_mutex_unlock(&workers->mutex);
+    for (i = 0; i < workers->n_threads; i++) {
+        wake(workers->threads[i].wake_fds[1]);
+    }
+
+    pthread_mutex_lock(&workers->mutex);
+    while (workers->n_parked < workers->n_threads) {
+        pthread_cond_wait(&workers->cond, &workers->mutex);
+    }
+    pthread_mutex_unlock(&workers->mutex);
+
+    for (i = 0; i < workers->n_threads; i++) {
+        chain_cache_fold(dp->chain, workers->threads[i].cache);
+    }
+}
+
+/* Lets the forwarding threads of 'dp' that dp_quiesce() parked go again. */
+void
+dp_unquiesce(struct datapath *dp)
+{
+    struct dp_workers *workers = dp->workers;
+
+    if (workers && workers->pause) {
+        pthread_mutex_lock(&workers->mutex);
+        workers->pause = false;
+        pthread_cond_broadcast(&workers->cond);
+        pthread_mutex_unlock(&workers->mutex);
+    }
+}
+
+/* Returns the microflow cache of the calling forwarding thread, or a null
+ * pointer when called from the main thread. */
+struct chain_cache *
+dp_worker_cache(void)
+{
+    return current_worker ? current_worker->cache : NULL;
+}
+
+/* If called from a forwarding thread, takes ownership of 'buffer', queues it
+ * for the main thread to pass to dp_output_control() with the other
+ * arguments, and returns true.  Otherwise returns false without doing
+ * anything. */
+bool
+dp_worker_output_control(struct datapath *dp, struct ofpbuf *buffer,
+                         int in_port, size_t max_len, int reason)
+{
+    struct dp_workers *workers = dp->workers;
+    struct dp_upcall *upcall;
+
+    if (!current_worker) {
+        return false;
+    }
+
+    pthread_mutex_lock(&workers->mutex);
+    if (workers->n_upcalls >= DP_MAX_UPCALLS) {
+        pthread_mutex_unlock(&workers->mutex);
+        VLOG_WARN_RL(&rl, "dropping packet for controller: queue full");
+        ofpbuf_delete(buffer);
+        return true;
+    }
+    upcall = xmalloc(sizeof *upcall);
+    upcall->buffer = buffer;
+    upcall->in_port = in_port;
+    upcall->max_len = max_len;
+    upcall->reason = reason;
+    list_push_back(&workers->upcalls, &upcall->node);
+    if (!workers->n_upcalls++) {
+        wake(workers->upcall_fds[1]);
+    }
+    pthread_mutex_unlock(&workers->mutex);
+    return true;
+}
+
+/* Sends the packets that the forwarding threads of 'dp' queued for the
+ * controller.  Must be called from the main thread. */
+void
+dp_workers_run(struct datapath *dp)
+{
+    struct dp_workers *workers = dp->workers;
+    struct dp_upcall *upcall, *next;
+    struct list upcalls;
+
+    if (!workers) {
+        return;
+    }
+
+    drain_pipe(workers->upcall_fds[0]);
+    pthread_mutex_lock(&workers->mutex);
+    if (list_is_empty(&workers->upcalls)) {
+        list_init(&upcalls);
+    } else {
+        list_replace(&upcalls, &workers->upcalls);
+        list_init(&workers->upcalls);
+    }
+    workers->n_upcalls = 0;
+    pthread_mutex_unlock(&workers->mutex);
+
+    LIST_FOR_EACH_SAFE (upcall, next, struct dp_upcall, node, &upcalls) {
+        dp_output_control(dp, upcall->buffer, upcall->in_port,
+                          upcall->max_len, upcall->reason);
+        free(upcall);
+    }
+}
+
+/* Registers with the poll loop to wake up when forwarding threads of 'dp'
+ * queue packets for the controller. */
+void
+dp_workers_wait(struct datapath *dp)
+{
+    if (dp->workers) {
+        poll_fd_wait(dp->workers->upcall_fds[0], POLLIN);
+    }
+}
+
+/* Adds the statistics of the microflow caches of the forwarding threads of
+ * 'dp' to 'stats'.  The forwarding threads must be parked. */
+void
+dp_workers_cache_stats(const struct datapath *dp, struct sw_table_stats *stats)
+{
+    struct dp_workers *workers = dp->workers;
+    size_t i;
+
+    if (!workers) {
+        return;
+    }
+    assert(workers->pause);
+    for (i = 0; i < workers->n_threads; i++) {
+        struct sw_table_stats s;
+
+        chain_cache_stats(dp->chain, workers->threads[i].cache, &s);
+        stats->n_flows += s.n_flows;
+        stats->max_flows += s.max_flows;
+        stats->n_lookup += s.n_lookup;
+        stats->n_matched += s.n_matched;
+    }
+}
@@ -0,0 +1,75 @@
+/* Copyright (c) 2008 The Board of Trustees of The Leland Stanford
+ * Junior University
+ * 
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ * 
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+#ifndef DP_WORKER_H
+#define DP_WORKER_H 1
+
+#include <stdbool.h>
+#include <stddef.h>
+
+struct chain_cache;
+struct datapath;
+struct ofpbuf;
+struct sw_table_stats;
+
+/* Forwarding threads.
+ *
+ * By default a datapath does all its work in a single thread.
+ * dp_workers_start() hands receiving packets from the switch ports, looking
+ * them up in the flow tables and executing their actions over to forwarding
+ * threads, each of which serves its own share of the ports.  The main thread
+ * keeps talking to the controllers, changing the flow tables and expiring
+ * flows.  Packets that forwarding threads send to the controller are queued
+ * for the main thread.
+ *
+ * Forwarding threads read the flow tables without taking any locks.  Before
+ * the main thread changes the flow tables or anything else that forwarding
+ * threads read, it calls dp_quiesce(), which waits until each forwarding
+ * thread has finished its current batch of packets and then parks it.
+ * dp_run() lets them go again when it returns, so that changes made in one
+ * run of the main loop share one pause. */
+
+int dp_workers_start(struct datapath *, int n_threads);
+bool dp_workers_active(const struct datapath *);
+void dp_workers_run(struct datapath *);
+void dp_workers_wait(struct datapath *);
+void dp_workers_cache_stats(const struct datapath *, struct sw_table_stats *);
+
+void dp_quiesce(struct datapath *);
+void dp_unquiesce(struct datapath *);
+
+struct chain_cache *dp_worker_cache(void);
+bool dp_worker_output_control(struct datapath *, struct ofpbuf *, int in_port,
+                              size_t max_len, int reason);
+
+#endif /* dp_worker.h */
@@ -37,6 +37,7 @@
 #include "of_ext_msg.h"
 #include "netdev.h"
 #include "datapath.h"
+#include "dp_worker.h"
 
 #define THIS_MODULE VLM_experimental
 #include "vlog.h"
@@ -46,6 +47,8 @@ new_queue(struct sw_port * port, struct sw_queue * queue,
           uint32_t queue_id, uint16_t class_id,
           struct ofp_queue_prop_min_rate * mr)
 {
+    /* Forwarding threads look up queues while they send packets. */
+    dp_quiesce(port->dp);
     memset(queue, '\0', sizeof *queue);
     queue->port = port;
     queue->queue_id = queue_id;
@@ -78,8 +81,9 @@ port_add_queue(struct sw_port *p, uint32_t queue_id,
 }
 
 static int
-port_delete_queue(struct sw_port *p UNUSED, struct sw_queue *q)
+port_delete_queue(struct sw_port *p, struct sw_queue *q)
 {
+    dp_quiesce(p->dp);
     list_remove(&q->node);
     memset(q,'\0', sizeof *q);
     return 0;
@@ -37,6 +37,7 @@
 
 #include "chain.h"
 #include "datapath.h"
+#include "dp_worker.h"
 #include "switch-flow.h"
 #include "table.h"
 #include "private-msg.h"
@@ -125,6 +126,7 @@ private_recv_msg(struct datapath *dp, const struct sender *sender UNUSED,
 	case PRIVATEOPT_PROTOCOL_STATS_REPLY:
 		break;
 	case PRIVATEOPT_EMERG_FLOW_PROTECTION:
+		dp_quiesce(dp);
 		flush_working(dp);
 		do_protection(dp);
 		break;
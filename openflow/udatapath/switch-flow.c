@@ -183,6 +183,58 @@ flow_extract_match(struct sw_flow_key* to, const struct ofp_match* from)
 	to->nw_dst_mask = make_nw_mask(to->wildcards >> OFPFW_NW_DST_SHIFT);
 }
 
+/* Fills 'mask' with the bits that flow_matches_1wild() compares for 'key'. */
+void
+flow_key_mask(struct flow *mask, const struct sw_flow_key *key)
+{
+    uint32_t w = key->wildcards;
+
+    memset(mask, 0, sizeof *mask);
+    if (!(w & OFPFW_IN_PORT))
+        mask->in_port = 0xffff;
+    if (!(w & OFPFW_DL_VLAN))
+        mask->dl_vlan = 0xffff;
+    if (!(w & OFPFW_DL_VLAN_PCP))
+        mask->dl_vlan_pcp = 0xff;
+    if (!(w & OFPFW_DL_SRC))
+        memset(mask->dl_src, 0xff, sizeof mask->dl_src);
+    if (!(w & OFPFW_DL_DST))
+        memset(mask->dl_dst, 0xff, sizeof mask->dl_dst);
+    if (!(w & OFPFW_DL_TYPE))
+        mask->dl_type = 0xffff;
+    if (!(w & OFPFW_NW_TOS))
+        mask->nw_tos = 0xff;
+    if (!(w & OFPFW_NW_PROTO))
+        mask->nw_proto = 0xff;
+    if (!(w & OFPFW_TP_SRC))
+        mask->tp_src = 0xffff;
+    if (!(w & OFPFW_TP_DST))
+        mask->tp_dst = 0xffff;
+    if (w) {
+        mask->nw_src = key->nw_src_mask;
+        mask->nw_dst = key->nw_dst_mask;
+    } else {
+        /* Exact-match keys need not have the masks filled in. */
+        mask->nw_src = mask->nw_dst = 0xffffffff;
+    }
+}
+
+/* Fills 'm' with the mask and masked value of 'key', for
+ * flow_match_packet(). */
+void
+flow_match_init(struct sw_flow_match *m, const struct sw_flow_key *key)
+{
+    const uint32_t *k = (const uint32_t *) &key->flow;
+    struct flow mask;
+    int i;
+
+    memset(m, 0, sizeof *m);
+    flow_key_mask(&mask, key);
+    memcpy(m->mask, &mask, sizeof mask);
+    for (i = 0; i < sizeof mask / sizeof(uint32_t); i++)
+        m->value[i] = k[i] & m->mask[i];
+}
+
 /* Allocates and returns a new flow with room for 'actions_len' actions. 
  * Returns the new flow or a null pointer on failure. */
 struct sw_flow *
@@ -201,6 +253,7 @@ flow_alloc(size_t actions_len)
     }
     sfa->actions_len = actions_len;
     flow->sf_acts = sfa;
+    list_init(&flow->expiry_node);
     return flow;
 }
 
@@ -224,13 +277,18 @@ flow_setup_actions(struct sw_flow *                    flow,
 	memcpy(flow->sf_acts->actions, actions, actions_len);
 }
 
-/* Frees 'flow' immediately. */
+/* Frees 'flow' immediately, removing it from its expiry wheel, if any. */
 void
 flow_free(struct sw_flow *flow)
 {
     if (!flow) {
         return; 
     }
+    list_remove(&flow->expiry_node);
+    if (flow->totals) {
+        __sync_fetch_and_sub(&flow->totals->packet_count, flow->packet_count);
+        __sync_fetch_and_sub(&flow->totals->byte_count, flow->byte_count);
+    }
     free(flow->sf_acts);
     free(flow);
 }
@@ -288,9 +346,11 @@ print_flow(const struct sw_flow_key *key)
            f->pad[0], f->pad[1], f->pad[2]);
 }
 
-bool flow_timeout(struct sw_flow *flow)
+/* Returns true if 'flow' has expired at time 'now', setting its reason for
+ * removal. */
+static bool
+flow_expired(struct sw_flow *flow, uint64_t now)
 {
-    uint64_t now = time_msec();
     if (flow->idle_timeout != OFP_FLOW_PERMANENT
             && now > flow->used + flow->idle_timeout * 1000) {
         flow->reason = OFPRR_IDLE_TIMEOUT;
@@ -304,6 +364,25 @@ bool flow_timeout(struct sw_flow *flow)
     }
 }
 
+bool flow_timeout(struct sw_flow *flow)
+{
+    return flow_expired(flow, time_msec());
+}
+
+/* Returns the time at which 'flow' expires unless it is used meanwhile, or
+ * UINT64_MAX if it is permanent. */
+static uint64_t
+flow_deadline(const struct sw_flow *flow)
+{
+    uint64_t deadline = UINT64_MAX;
+
+    if (flow->idle_timeout != OFP_FLOW_PERMANENT)
+        deadline = flow->used + flow->idle_timeout * 1000;
+    if (flow->hard_timeout != OFP_FLOW_PERMANENT)
+        deadline = MIN(deadline, flow->created + flow->hard_timeout * 1000);
+    return deadline;
+}
+
 /* Returns nonzero if 'flow' contains an output action to 'out_port' or
  * has the value OFPP_NONE. 'out_port' is in network-byte order. */
 int flow_has_out_port(struct sw_flow *flow, uint16_t out_port)
@@ -335,7 +414,140 @@ int flow_has_out_port(struct sw_flow *flow, uint16_t out_port)
 void flow_used(struct sw_flow *flow, struct ofpbuf *buffer)
 {
     flow->used = time_msec();
+    flow_add_counts(flow, 1, buffer->size);
+}
 
-    flow->packet_count++;
-    flow->byte_count += buffer->size;
+/* Adds 'n_packets' and 'n_bytes' to the counts of 'flow' and to the totals of
+ * its table. */
+void
+flow_add_counts(struct sw_flow *flow, uint64_t n_packets, uint64_t n_bytes)
+{
+    /* Forwarding threads may count packets of the same flow at once. */
+    __sync_fetch_and_add(&flow->packet_count, n_packets);
+    __sync_fetch_and_add(&flow->byte_count, n_bytes);
+    if (flow->totals) {
+        __sync_fetch_and_add(&flow->totals->packet_count, n_packets);
+        __sync_fetch_and_add(&flow->totals->byte_count, n_bytes);
+    }
+}
+
+void
+flow_expiry_init(struct flow_expiry *fe)
+{
+    int i;
+
+    for (i = 0; i < FLOW_EXPIRY_SLOTS; i++)
+        list_init(&fe->slots[i]);
+    fe->tick = time_msec() / FLOW_EXPIRY_TICK_MS;
+    list_init(&fe->due);
+}
+
+/* Puts 'flow' into the slot of 'tick'.  A flow has expired by the end of the
+ * tick that contains its deadline, so the flow's tick is the next one. */
+static void
+schedule(struct flow_expiry *fe, struct sw_flow *flow, uint64_t tick)
+{
+    list_push_back(&fe->slots[tick % FLOW_EXPIRY_SLOTS], &flow->expiry_node);
+}
+
+/* Registers 'flow', which must not be in any wheel, with 'fe' if it has a
+ * timeout. */
+void
+flow_expiry_insert(struct flow_expiry *fe, struct sw_flow *flow)
+{
+    uint64_t deadline = flow_deadline(flow);
+    uint64_t tick;
+
+    if (deadline == UINT64_MAX)
+        return;
+
+    tick = deadline / FLOW_EXPIRY_TICK_MS + 1;
+    if (tick < fe->tick)
+        list_push_back(&fe->due, &flow->expiry_node);
+    else
+        schedule(fe, flow, tick);
+}
+
+/* Returns a flow of 'fe' that has expired at time 'now', after removing it
+ * from 'fe' and setting its reason for removal, or a null pointer if there
+ * are no more. */
+struct sw_flow *
+flow_expiry_next(struct flow_expiry *fe, uint64_t now)
+{
+    for (;;) {
+        struct sw_flow *flow;
+        uint64_t tick;
+
+        if (list_is_empty(&fe->due)) {
+            struct list *slot = &fe->slots[fe->tick % FLOW_EXPIRY_SLOTS];
+
+            if (fe->tick * FLOW_EXPIRY_TICK_MS > now)
+                return NULL;
+            list_splice(&fe->due, slot->next, slot);
+            fe->tick++;
+            continue;
+        }
+
+        flow = CONTAINER_OF(list_pop_front(&fe->due),
+                            struct sw_flow, expiry_node);
+        list_init(&flow->expiry_node);
+        if (flow_expired(flow, now))
+            return flow;
+
+        /* Used since, or a later turn of the wheel. */
+        tick = flow_deadline(flow) / FLOW_EXPIRY_TICK_MS + 1;
+        schedule(fe, flow, MAX(tick, fe->tick));
+    }
+}
+
+void
+flow_iter_hint_init(struct flow_iter_hint *h)
+{
+    h->start = 0;
+    h->next = NULL;
+}
+
+/* Returns the element of 'flows' at which to resume an iteration over the
+ * flows whose serial is at most 'start'. */
+struct list *
+flow_iter_hint_resume(const struct flow_iter_hint *h, struct list *flows,
+                      unsigned long int start)
+{
+    return h->next && h->start == start ? &h->next->iter_node : flows->next;
+}
+
+static struct sw_flow *
+next_iter_flow(struct list *flows, struct sw_flow *flow)
+{
+    return (flow->iter_node.next != flows
+            ? CONTAINER_OF(flow->iter_node.next, struct sw_flow, iter_node)
+            : NULL);
+}
+
+/* Notes that an iteration over 'flows' stopped after 'flow', to resume with
+ * the flows of lower serial numbers. */
+void
+flow_iter_hint_stop(struct flow_iter_hint *h, struct list *flows,
+                    struct sw_flow *flow)
+{
+    h->start = flow->serial - 1;
+    h->next = next_iter_flow(flows, flow);
+}
+
+/* Notes that 'flow' is about to be removed from 'flows'. */
+void
+flow_iter_hint_remove(struct flow_iter_hint *h, struct list *flows,
+                      struct sw_flow *flow)
+{
+    if (h->next == flow)
+        h->next = next_iter_flow(flows, flow);
+}
+
+/* Notes that 'new' takes the place of 'old', with the same serial. */
+void
+flow_iter_hint_replace(struct flow_iter_hint *h, struct sw_flow *old,
+                       struct sw_flow *new)
+{
+    if (h->next == old)
+        h->next = new;
 }
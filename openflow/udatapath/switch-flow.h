@@ -34,7 +34,12 @@
 #ifndef SWITCH_FLOW_H
 #define SWITCH_FLOW_H 1
 
+#include <stdbool.h>
 #include <time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "compiler.h"
 #include "openflow/openflow.h"
 #include "flow.h"
 #include "list.h"
@@ -49,6 +54,28 @@ struct sw_flow_key {
     uint32_t nw_dst_mask;       /* 1-bit in each significant nw_dst bit. */
 };
 
+/* Number of 32-bit words in a struct sw_flow_key, which is a whole number of
+ * 16-byte vectors, so that a packet's key can be loaded a vector at a time
+ * starting at its struct flow. */
+#define FLOW_MATCH_WORDS 12
+BUILD_ASSERT_DECL(sizeof(struct sw_flow_key) == FLOW_MATCH_WORDS * 4);
+
+/* A wildcarded flow key in the form that flow_match_packet() compares with
+ * packets: the bits that the flow matches on and their values, padded with
+ * zeros to FLOW_MATCH_WORDS. */
+struct sw_flow_match {
+    uint32_t mask[FLOW_MATCH_WORDS];
+    uint32_t value[FLOW_MATCH_WORDS];   /* Key with 'mask' applied. */
+} ALIGNED(16);
+
+/* Running packet and byte counts of all the flows in a table, kept up to date
+ * as flows are used and freed, so that aggregate statistics over a whole
+ * table need not visit every flow. */
+struct sw_flow_totals {
+    uint64_t packet_count;
+    uint64_t byte_count;
+};
+
 struct sw_flow_actions {
     size_t actions_len;
     struct ofp_action_header actions[0];
@@ -56,6 +83,8 @@ struct sw_flow_actions {
 
 struct sw_flow {
     struct sw_flow_key key;
+    struct sw_flow_match match; /* Set up from 'key' by tables that use
+                                 * flow_match_packet(). */
 
     uint64_t cookie;            /* Opaque controller-issued identifier. */
     uint16_t priority;          /* Only used on entries with wildcards. */
@@ -70,10 +99,13 @@ struct sw_flow {
     uint8_t emerg_flow;         /* Emergency flow indicator */
 
     struct sw_flow_actions *sf_acts;
+    struct sw_flow_totals *totals; /* Totals of the table that holds the
+                                    * flow, if any. */
 
     /* Private to table implementations. */
     struct list node;
     struct list iter_node;
+    struct list expiry_node;    /* Element in a struct flow_expiry. */
     unsigned long int serial;
 
     void *private;              /* Cookie for tables */
@@ -92,9 +124,97 @@ void flow_free(struct sw_flow *);
 void flow_replace_acts(struct sw_flow *, const struct ofp_action_header *, 
         size_t);
 void flow_extract_match(struct sw_flow_key* to, const struct ofp_match* from);
+void flow_key_mask(struct flow *mask, const struct sw_flow_key *);
+void flow_match_init(struct sw_flow_match *, const struct sw_flow_key *);
 
 void print_flow(const struct sw_flow_key *);
 bool flow_timeout(struct sw_flow *flow);
 void flow_used(struct sw_flow *flow, struct ofpbuf *buffer);
+void flow_add_counts(struct sw_flow *, uint64_t n_packets, uint64_t n_bytes);
+
+/* An index of the flows of a table that have timeouts, by the time at which
+ * they could expire at the earliest: a timing wheel of one-second ticks, so
+ * that timeout processing does not have to look at every flow.
+ *
+ * A table registers each flow that it takes over with flow_expiry_insert()
+ * and, on timeout processing, removes the flows that flow_expiry_next()
+ * returns.  Freeing a flow takes it out of its wheel.
+ *
+ * flow_used() only updates the time of last use.  When the tick of a flow
+ * comes, the wheel checks whether the flow really expired and otherwise
+ * moves it to its new expiry time, so that a busy flow is looked at about
+ * once per idle timeout.  Expiry times beyond the span of the wheel come
+ * around once per turn of the wheel. */
+#define FLOW_EXPIRY_TICK_MS 1000
+#define FLOW_EXPIRY_SLOTS 1024  /* Ticks per turn of the wheel. */
+
+struct flow_expiry {
+    struct list slots[FLOW_EXPIRY_SLOTS]; /* Flows by tick, modulo the
+                                           * number of slots. */
+    uint64_t tick;              /* Next tick to process. */
+    struct list due;            /* Flows whose tick has passed. */
+};
+
+void flow_expiry_init(struct flow_expiry *);
+void flow_expiry_insert(struct flow_expiry *, struct sw_flow *);
+struct sw_flow *flow_expiry_next(struct flow_expiry *, uint64_t now);
+
+/* Where the last iteration over the flows of a table stopped, for tables that
+ * keep their flows on a list through 'iter_node' in descending order of
+ * 'serial' and resume an iteration at the first flow whose serial is at most
+ * a given one.  Without it, every resumption skips over all the flows that
+ * were visited before, so that dumping a large table a few flows at a time
+ * takes quadratic time.
+ *
+ * A table tells the hint about flows that it takes off the list, so that
+ * the hint never points to a freed flow. */
+struct flow_iter_hint {
+    unsigned long int start;    /* Serial that 'next' resumes at. */
+    struct sw_flow *next;       /* First flow with serial <= 'start'. */
+};
+
+void flow_iter_hint_init(struct flow_iter_hint *);
+struct list *flow_iter_hint_resume(const struct flow_iter_hint *,
+                                   struct list *flows,
+                                   unsigned long int start);
+void flow_iter_hint_stop(struct flow_iter_hint *, struct list *flows,
+                         struct sw_flow *);
+void flow_iter_hint_remove(struct flow_iter_hint *, struct list *flows,
+                           struct sw_flow *);
+void flow_iter_hint_replace(struct flow_iter_hint *, struct sw_flow *old,
+                            struct sw_flow *new);
+
+/* Returns true if 'key', which must not have any wildcard fields, matches
+ * 'm', that is, if it equals 'm' in all the bits that 'm' matches on.  For a
+ * key from flow_extract_match(), this gives the same result as
+ * flow_matches_1wild(), but compares a vector at a time instead of field by
+ * field. */
+static inline bool
+flow_match_packet(const struct sw_flow_match *m, const struct sw_flow_key *key)
+{
+#ifdef __SSE2__
+    const __m128i *k = (const __m128i *) key;
+    const __m128i *mask = (const __m128i *) m->mask;
+    const __m128i *value = (const __m128i *) m->value;
+    __m128i diff;
+
+    diff = _mm_xor_si128(_mm_and_si128(_mm_loadu_si128(&k[0]), mask[0]),
+                         value[0]);
+    diff = _mm_or_si128(diff, _mm_xor_si128(_mm_and_si128(
+                                  _mm_loadu_si128(&k[1]), mask[1]), value[1]));
+    diff = _mm_or_si128(diff, _mm_xor_si128(_mm_and_si128(
+                                  _mm_loadu_si128(&k[2]), mask[2]), value[2]));
+    return _mm_movemask_epi8(_mm_cmpeq_epi32(diff, _mm_setzero_si128()))
+           == 0xffff;
+#else
+    const uint32_t *k = (const uint32_t *) key;
+    uint32_t diff = 0;
+    int i;
+
+    for (i = 0; i < FLOW_MATCH_WORDS; i++)
+        diff |= (k[i] & m->mask[i]) ^ m->value[i];
+    return !diff;
+#endif
+}
 
 #endif /* switch-flow.h */
@@ -0,0 +1,671 @@
+/* Copyright (c) 2008 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+/* Exact-match table based on bucketized cuckoo hashing.
+ *
+ * Every flow can live in one of two buckets, both derived from the 32-bit hash
+ * of its key, which is also kept next to the flow as its signature.  A bucket
+ * fills one cache line and holds the signatures of all its flows in front of
+ * the flow pointers, so a lookup touches at most two cache lines before it
+ * compares a flow key and almost never compares one that does not match.
+ *
+ * The second bucket is computed from the first one and the signature alone,
+ * so flows can be moved to their other bucket, and into a larger array, without
+ * looking at their keys.  When both buckets of a new flow are full, a
+ * breadth-first search finds the shortest chain of such moves that frees an
+ * entry.
+ *
+ * The table grows by doubling the bucket array once it is 90% full or an
+ * insertion finds no room.  The flows are moved over to the new array a few
+ * buckets at a time on every insertion and timeout run, and lookups check the
+ * old array as well until that is done. */
+
+#include <config.h>
+#include "table.h"
+#include <assert.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include "compiler.h"
+#include "flow.h"
+#include "list.h"
+#include "openflow/openflow.h"
+#include "switch-flow.h"
+#include "datapath.h"
+
+#define THIS_MODULE VLM_chain
+#include "vlog.h"
+
+#define CACHE_LINE_SIZE 64
+
+/* As many entries as fit into a cache line: 5 on 64-bit, 8 on 32-bit. */
+#define CUCKOO_ENTRIES \
+    (CACHE_LINE_SIZE / (sizeof(uint32_t) + sizeof(struct sw_flow *)))
+
+/* Maximum number of buckets that an insertion examines. */
+#define CUCKOO_MAX_SEARCH 256
+
+/* Number of old buckets moved to the new array on each insertion and on each
+ * timeout run during a resize. */
+#define CUCKOO_MIGRATE_STEP 4
+#define CUCKOO_MIGRATE_TIMEOUT 1024
+
+struct cuckoo_bucket {
+    uint32_t sigs[CUCKOO_ENTRIES];          /* Hashes of the flow keys. */
+    struct sw_flow *flows[CUCKOO_ENTRIES];  /* Null if entry is free. */
+} ALIGNED(CACHE_LINE_SIZE);
+
+struct sw_table_cuckoo {
+    struct sw_table swt;
+
+    unsigned int max_flows;
+    unsigned int n_flows;
+    struct cuckoo_bucket *buckets;
+    unsigned int bucket_mask;       /* Number of buckets minus 1. */
+
+    /* During a resize, the previous bucket array, of which all buckets below
+     * 'migrate_pos' have been moved over to 'buckets' already. */
+    struct cuckoo_bucket *old_buckets;
+    unsigned int old_mask;
+    unsigned int migrate_pos;
+
+    /* Flows that found no room while being moved to a new bucket array.  This
+     * is not expected to ever happen, because the new array is only half as
+     * full as the old one. */
+    struct list stash;
+
+    struct list iter_flows;
+    unsigned long int next_serial;
+    struct flow_iter_hint iter_hint;
+    struct flow_expiry expiry;
+
+    /* Statistics. */
+    unsigned long long int n_displaced;
+    unsigned int max_displaced;
+    unsigned int n_resizes;
+};
+
+/* A bucket visited by make_room(). */
+struct cuckoo_node {
+    unsigned int bucket;
+    int parent;                 /* Index of the node we came from, or -1. */
+    int entry;                  /* Entry in the parent that leads here. */
+};
+
+static inline uint32_t
+flow_sig(const struct flow *flow)
+{
+    return flow_hash(flow, 0);
+}
+
+/* Returns the other bucket of a flow with signature 'sig' that may be stored
+ * in 'bucket'.  Applied twice, it gives back 'bucket'. */
+static inline unsigned int
+alt_bucket(unsigned int bucket, uint32_t sig, unsigned int mask)
+{
+    return (bucket ^ (((sig >> 16) * 0x5bd1e995) | 1)) & mask;
+}
+
+static struct cuckoo_bucket *
+alloc_buckets(unsigned int n_buckets)
+{
+    void *buckets;
+
+    if (posix_memalign(&buckets, CACHE_LINE_SIZE,
+                       n_buckets * sizeof(struct cuckoo_bucket)))
+        return NULL;
+    memset(buckets, 0, n_buckets * sizeof(struct cuckoo_bucket));
+    return buckets;
+}
+
+static struct sw_flow **
+bucket_find(struct cuckoo_bucket *b, uint32_t sig, const struct flow *key)
+{
+    int i;
+
+    for (i = 0; i < CUCKOO_ENTRIES; i++) {
+        struct sw_flow *flow = b->flows[i];
+        if (b->sigs[i] == sig && flow && !flow_compare(&flow->key.flow, key))
+            return &b->flows[i];
+    }
+    return NULL;
+}
+
+static struct sw_flow **
+array_find(struct cuckoo_bucket *buckets, unsigned int mask, uint32_t sig,
+           const struct flow *key)
+{
+    unsigned int b1 = sig & mask;
+    unsigned int b2 = alt_bucket(b1, sig, mask);
+    struct sw_flow **slot;
+
+    __builtin_prefetch(&buckets[b2]);
+    slot = bucket_find(&buckets[b1], sig, key);
+    return slot ? slot : bucket_find(&buckets[b2], sig, key);
+}
+
+/* Returns the entry of the flow with the given 'key' and 'sig', or a null
+ * pointer if there is no such flow or if it is in the stash. */
+static struct sw_flow **
+find_slot(struct sw_table_cuckoo *tc, const struct flow *key, uint32_t sig)
+{
+    struct sw_flow **slot;
+
+    slot = array_find(tc->buckets, tc->bucket_mask, sig, key);
+    if (!slot && unlikely(tc->old_buckets != NULL))
+        slot = array_find(tc->old_buckets, tc->old_mask, sig, key);
+    return slot;
+}
+
+static struct sw_flow *
+find_stashed(struct sw_table_cuckoo *tc, const struct flow *key)
+{
+    struct sw_flow *flow;
+
+    LIST_FOR_EACH (flow, struct sw_flow, node, &tc->stash) {
+        if (!flow_compare(&flow->key.flow, key))
+            return flow;
+    }
+    return NULL;
+}
+
+static struct sw_flow *
+find_flow(struct sw_table_cuckoo *tc, const struct flow *key)
+{
+    struct sw_flow **slot = find_slot(tc, key, flow_sig(key));
+
+    if (slot)
+        return *slot;
+    if (unlikely(!list_is_empty(&tc->stash)))
+        return find_stashed(tc, key);
+    return NULL;
+}
+
+/* Returns true if node 'parent' or one of its ancestors is 'bucket'. */
+static bool
+on_path(const struct cuckoo_node *nodes, int parent, unsigned int bucket)
+{
+    for (; parent >= 0; parent = nodes[parent].parent) {
+        if (nodes[parent].bucket == bucket)
+            return true;
+    }
+    return false;
+}
+
+/* Makes room for a flow with signature 'sig' in 'tc->buckets', moving other
+ * flows to their alternate buckets if necessary.  The search is
+ * breadth-first, so that as few flows as possible move.  Returns the free
+ * entry, or a null pointer if none was found within CUCKOO_MAX_SEARCH
+ * buckets, in which case nothing has changed. */
+static struct sw_flow **
+make_room(struct sw_table_cuckoo *tc, uint32_t sig, uint32_t **sigp)
+{
+    struct cuckoo_node nodes[CUCKOO_MAX_SEARCH];
+    unsigned int mask = tc->bucket_mask;
+    int head, tail;
+
+    nodes[0].bucket = sig & mask;
+    nodes[1].bucket = alt_bucket(nodes[0].bucket, sig, mask);
+    nodes[0].parent = nodes[1].parent = -1;
+    tail = 2;
+
+    for (head = 0; head < tail; head++) {
+        struct cuckoo_bucket *b = &tc->buckets[nodes[head].bucket];
+        unsigned int n_moved;
+        int i, n;
+
+        for (i = 0; i < CUCKOO_ENTRIES; i++) {
+            if (!b->flows[i])
+                break;
+        }
+        if (i >= CUCKOO_ENTRIES) {
+            /* Full: queue the other buckets of its flows. */
+            for (i = 0; i < CUCKOO_ENTRIES && tail < CUCKOO_MAX_SEARCH; i++) {
+                unsigned int alt = alt_bucket(nodes[head].bucket, b->sigs[i],
+                                              mask);
+                if (!on_path(nodes, head, alt)) {
+                    nodes[tail].bucket = alt;
+                    nodes[tail].parent = head;
+                    nodes[tail].entry = i;
+                    tail++;
+                }
+            }
+            continue;
+        }
+
+        /* Entry 'i' of bucket 'head' is free.  Shift the flows along the path
+         * towards it, freeing an entry in one of the two original buckets. */
+        n_moved = 0;
+        for (n = head; nodes[n].parent >= 0; n = nodes[n].parent) {
+            struct cuckoo_bucket *from = &tc->buckets[nodes[nodes[n].parent]
+                                                      .bucket];
+            struct cuckoo_bucket *to = &tc->buckets[nodes[n].bucket];
+            int entry = nodes[n].entry;
+
+            to->sigs[i] = from->sigs[entry];
+            to->flows[i] = from->flows[entry];
+            from->flows[entry] = NULL;
+            i = entry;
+            n_moved++;
+        }
+        tc->n_displaced += n_moved;
+        if (n_moved > tc->max_displaced)
+            tc->max_displaced = n_moved;
+
+        b = &tc->buckets[nodes[n].bucket];
+        *sigp = &b->sigs[i];
+        return &b->flows[i];
+    }
+    return NULL;
+}
+
+/* Stores 'flow', whose signature is 'sig', in 'tc->buckets'.  Returns false
+ * if there is no room. */
+static bool
+place_flow(struct sw_table_cuckoo *tc, struct sw_flow *flow, uint32_t sig)
+{
+    struct sw_flow **slot;
+    uint32_t *sigp;
+
+    slot = make_room(tc, sig, &sigp);
+    if (slot == NULL)
+        return false;
+    *sigp = sig;
+    *slot = flow;
+    return true;
+}
+
+static bool
+can_grow(const struct sw_table_cuckoo *tc)
+{
+    /* Stop at a load factor of 50% or less at full capacity. */
+    return (tc->bucket_mask + 1) * CUCKOO_ENTRIES < tc->max_flows * 2;
+}
+
+/* Moves up to 'n_buckets' buckets of the old bucket array to the new one. */
+static void
+migrate(struct sw_table_cuckoo *tc, unsigned int n_buckets)
+{
+    while (tc->old_buckets && n_buckets-- > 0) {
+        struct cuckoo_bucket *b = &tc->old_buckets[tc->migrate_pos];
+        int i;
+
+        for (i = 0; i < CUCKOO_ENTRIES; i++) {
+            struct sw_flow *flow = b->flows[i];
+            if (flow) {
+                b->flows[i] = NULL;
+                if (!place_flow(tc, flow, b->sigs[i]))
+                    list_push_back(&tc->stash, &flow->node);
+            }
+        }
+
+        if (tc->migrate_pos++ == tc->old_mask) {
+            struct sw_flow *flow, *next;
+
+            free(tc->old_buckets);
+            tc->old_buckets = NULL;
+            LIST_FOR_EACH_SAFE (flow, next, struct sw_flow, node,
+                                &tc->stash) {
+                list_remove(&flow->node);
+                if (!place_flow(tc, flow, flow_sig(&flow->key.flow)))
+                    list_push_back(&tc->stash, &flow->node);
+            }
+            VLOG_DBG("exact-match table resized to %u buckets: %u flows, "
+                     "%llu displacements", tc->bucket_mask + 1, tc->n_flows,
+                     tc->n_displaced);
+        }
+    }
+}
+
+/* Starts moving the flows to a bucket array of twice the size.  Returns false
+ * if that cannot be allocated. */
+static bool
+start_resize(struct sw_table_cuckoo *tc)
+{
+    unsigned int n_buckets = (tc->bucket_mask + 1) * 2;
+    struct cuckoo_bucket *buckets;
+
+    if (tc->old_buckets)
+        migrate(tc, UINT_MAX);
+
+    buckets = alloc_buckets(n_buckets);
+    if (buckets == NULL)
+        return false;
+    tc->old_buckets = tc->buckets;
+    tc->old_mask = tc->bucket_mask;
+    tc->migrate_pos = 0;
+    tc->buckets = buckets;
+    tc->bucket_mask = n_buckets - 1;
+    tc->n_resizes++;
+    return true;
+}
+
+/* Removes 'flow' from 'tc' without freeing it. */
+static void
+remove_flow(struct sw_table_cuckoo *tc, struct sw_flow *flow)
+{
+    struct sw_flow **slot;
+
+    slot = find_slot(tc, &flow->key.flow, flow_sig(&flow->key.flow));
+    if (slot)
+        *slot = NULL;
+    else
+        list_remove(&flow->node);
+    flow_iter_hint_remove(&tc->iter_hint, &tc->iter_flows, flow);
+    list_remove(&flow->iter_node);
+    tc->n_flows--;
+}
+
+static struct sw_flow *table_cuckoo_lookup(struct sw_table *swt,
+                                           const struct sw_flow_key *key)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    return find_flow(tc, &key->flow);
+}
+
+static int table_cuckoo_insert(struct sw_table *swt, struct sw_flow *flow)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    uint32_t sig;
+
+    if (flow->key.wildcards != 0)
+        return 0;
+
+    /* Replace an existing flow with the same key. */
+    sig = flow_sig(&flow->key.flow);
+    {
+        struct sw_flow **slot = find_slot(tc, &flow->key.flow, sig);
+        struct sw_flow *old = slot ? *slot : NULL;
+
+        if (!old && !list_is_empty(&tc->stash)) {
+            old = find_stashed(tc, &flow->key.flow);
+            if (old)
+                list_replace(&flow->node, &old->node);
+        }
+        if (old) {
+            if (slot)
+                *slot = flow;
+            flow->serial = old->serial;
+            list_replace(&flow->iter_node, &old->iter_node);
+            flow_iter_hint_replace(&tc->iter_hint, old, flow);
+            flow_free(old);
+            flow_expiry_insert(&tc->expiry, flow);
+            return 1;
+        }
+    }
+
+    if (tc->n_flows >= tc->max_flows)
+        return 0;
+
+    if (tc->old_buckets)
+        migrate(tc, CUCKOO_MIGRATE_STEP);
+    else if ((tc->n_flows + 1) * 10 > (tc->bucket_mask + 1) * CUCKOO_ENTRIES * 9
+             && can_grow(tc))
+        start_resize(tc);
+
+    if (!place_flow(tc, flow, sig)
+        && (!can_grow(tc) || !start_resize(tc)
+            || !place_flow(tc, flow, sig)))
+        return 0;
+
+    tc->n_flows++;
+    flow->serial = tc->next_serial++;
+    list_push_front(&tc->iter_flows, &flow->iter_node);
+    flow_expiry_insert(&tc->expiry, flow);
+    return 1;
+}
+
+static int table_cuckoo_modify(struct sw_table *swt,
+        const struct sw_flow_key *key, uint16_t priority, int strict,
+        const struct ofp_action_header *actions, size_t actions_len)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    struct sw_flow *flow;
+    unsigned int count = 0;
+
+    if (key->wildcards == 0) {
+        flow = find_flow(tc, &key->flow);
+        if (flow && flow_matches_desc(&flow->key, key, strict)
+                && (!strict || (flow->priority == priority))) {
+            flow_replace_acts(flow, actions, actions_len);
+            count = 1;
+        }
+        return count;
+    }
+
+    LIST_FOR_EACH (flow, struct sw_flow, iter_node, &tc->iter_flows) {
+        if (flow_matches_desc(&flow->key, key, strict)
+                && (!strict || (flow->priority == priority))) {
+            flow_replace_acts(flow, actions, actions_len);
+            count++;
+        }
+    }
+    return count;
+}
+
+static int table_cuckoo_has_conflict(struct sw_table *swt,
+                                     const struct sw_flow_key *key,
+                                     uint16_t priority, int strict)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    struct sw_flow *flow;
+
+    if (key->wildcards == 0) {
+        flow = find_flow(tc, &key->flow);
+        return (flow && flow_matches_2desc(&flow->key, key, strict)
+                && flow->priority == priority);
+    }
+
+    LIST_FOR_EACH (flow, struct sw_flow, iter_node, &tc->iter_flows) {
+        if (flow_matches_2desc(&flow->key, key, strict)
+                && flow->priority == priority)
+            return true;
+    }
+    return false;
+}
+
+/* Returns number of deleted flows.  We ignore the priority argument, since
+ * all exact-match entries are the same (highest) priority. */
+static int table_cuckoo_delete(struct datapath *dp, struct sw_table *swt,
+                               const struct sw_flow_key *key,
+                               uint16_t out_port,
+                               uint16_t priority UNUSED, int strict)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    struct sw_flow *flow, *n;
+    unsigned int count = 0;
+
+    if (key->wildcards == 0) {
+        flow = find_flow(tc, &key->flow);
+        if (flow && flow_has_out_port(flow, out_port)) {
+            dp_send_flow_end(dp, flow, OFPRR_DELETE);
+            remove_flow(tc, flow);
+            flow_free(flow);
+            count = 1;
+        }
+        return count;
+    }
+
+    LIST_FOR_EACH_SAFE (flow, n, struct sw_flow, iter_node, &tc->iter_flows) {
+        if (flow_matches_desc(&flow->key, key, strict)
+                && flow_has_out_port(flow, out_port)) {
+            dp_send_flow_end(dp, flow, OFPRR_DELETE);
+            remove_flow(tc, flow);
+            flow_free(flow);
+            count++;
+        }
+    }
+    return count;
+}
+
+static void table_cuckoo_timeout(struct sw_table *swt, struct list *deleted)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    uint64_t now = time_msec();
+    struct sw_flow *flow;
+
+    while ((flow = flow_expiry_next(&tc->expiry, now)) != NULL) {
+        remove_flow(tc, flow);
+        list_push_back(deleted, &flow->node);
+    }
+
+    /* Also make progress with a resize while there are no insertions. */
+    migrate(tc, CUCKOO_MIGRATE_TIMEOUT);
+}
+
+static void table_cuckoo_destroy(struct sw_table *swt)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+
+    while (!list_is_empty(&tc->iter_flows)) {
+        struct sw_flow *flow = CONTAINER_OF(list_pop_front(&tc->iter_flows),
+                                            struct sw_flow, iter_node);
+        flow_free(flow);
+    }
+    free(tc->old_buckets);
+    free(tc->buckets);
+    free(tc);
+}
+
+static int table_cuckoo_iterate(struct sw_table *swt,
+                                const struct sw_flow_key *key,
+                                uint16_t out_port,
+                                struct sw_table_position *position,
+                                int (*callback)(struct sw_flow *, void *),
+                                void *private)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    struct sw_flow *flow;
+    struct list *node;
+    unsigned long start;
+
+    /* Iterating in order of the serial numbers, instead of over the buckets,
+     * keeps the position valid while flows move between buckets. */
+    start = ~position->private[0];
+    if (key->wildcards == 0) {
+        flow = find_flow(tc, &key->flow);
+        if (flow && flow->serial <= start
+                && flow_has_out_port(flow, out_port)) {
+            int error = callback(flow, private);
+            if (error) {
+                position->private[0] = ~(flow->serial - 1);
+                return error;
+            }
+        }
+        return 0;
+    }
+
+    for (node = flow_iter_hint_resume(&tc->iter_hint, &tc->iter_flows, start);
+         node != &tc->iter_flows; node = node->next) {
+        flow = CONTAINER_OF(node, struct sw_flow, iter_node);
+        if (flow->serial <= start
+                && flow_matches_1wild(&flow->key, key)
+                && flow_has_out_port(flow, out_port)) {
+            int error = callback(flow, private);
+            if (error) {
+                position->private[0] = ~(flow->serial - 1);
+                flow_iter_hint_stop(&tc->iter_hint, &tc->iter_flows, flow);
+                return error;
+            }
+        }
+    }
+    return 0;
+}
+
+static void table_cuckoo_stats(struct sw_table *swt,
+                               struct sw_table_stats *stats)
+{
+    struct sw_table_cuckoo *tc = (struct sw_table_cuckoo *) swt;
+    stats->name = "cuckoo";
+    stats->wildcards = 0;        /* No wildcards are supported. */
+    stats->n_flows   = tc->n_flows;
+    stats->max_flows = tc->max_flows;
+    stats->n_lookup  = swt->n_lookup;
+    stats->n_matched = swt->n_matched;
+}
+
+void table_cuckoo_get_stats(const struct sw_table *swt,
+                            struct sw_table_cuckoo_stats *stats)
+{
+    const struct sw_table_cuckoo *tc = (const struct sw_table_cuckoo *) swt;
+
+    stats->n_buckets = tc->bucket_mask + 1;
+    stats->n_entries = CUCKOO_ENTRIES;
+    stats->n_flows = tc->n_flows;
+    stats->n_stashed = list_size(&tc->stash);
+    stats->resizing = tc->old_buckets != NULL;
+    stats->n_resizes = tc->n_resizes;
+    stats->n_displaced = tc->n_displaced;
+    stats->max_displaced = tc->max_displaced;
+}
+
+struct sw_table *table_cuckoo_create(unsigned int n_buckets,
+                                     unsigned int max_flows)
+{
+    struct sw_table_cuckoo *tc;
+    struct sw_table *swt;
+
+    tc = calloc(1, sizeof *tc);
+    if (tc == NULL)
+        return NULL;
+
+    assert(n_buckets && !(n_buckets & (n_buckets - 1)));
+    tc->buckets = alloc_buckets(n_buckets);
+    if (tc->buckets == NULL) {
+        free(tc);
+        return NULL;
+    }
+    tc->bucket_mask = n_buckets - 1;
+    tc->max_flows = max_flows;
+
+    swt = &tc->swt;
+    swt->lookup = table_cuckoo_lookup;
+    swt->insert = table_cuckoo_insert;
+    swt->modify = table_cuckoo_modify;
+    swt->has_conflict = table_cuckoo_has_conflict;
+    swt->delete = table_cuckoo_delete;
+    swt->timeout = table_cuckoo_timeout;
+    swt->destroy = table_cuckoo_destroy;
+    swt->iterate = table_cuckoo_iterate;
+    swt->stats = table_cuckoo_stats;
+
+    list_init(&tc->stash);
+    list_init(&tc->iter_flows);
+    flow_iter_hint_init(&tc->iter_hint);
+    /* Serial 0 would make the resume position of table_cuckoo_iterate() wrap
+     * around if iteration stopped at the oldest flow. */
+    tc->next_serial = 1;
+    flow_expiry_init(&tc->expiry);
+
+    return swt;
+}
@@ -48,6 +48,7 @@ struct sw_table_hash {
     unsigned int n_flows;
     unsigned int bucket_mask; /* Number of buckets minus 1. */
     struct sw_flow **buckets;
+    struct flow_expiry expiry;
 };
 
 static struct sw_flow **find_bucket(struct sw_table *swt,
@@ -90,6 +91,8 @@ static int table_hash_insert(struct sw_table *swt, struct sw_flow *flow)
             retval = 0;
         }
     }
+    if (retval)
+        flow_expiry_insert(&th->expiry, flow);
     return retval;
 }
 
@@ -201,16 +204,13 @@ static int table_hash_delete(struct datapath *dp, struct sw_table *swt,
 static void table_hash_timeout(struct sw_table *swt, struct list *deleted)
 {
     struct sw_table_hash *th = (struct sw_table_hash *) swt;
-    unsigned int i;
+    uint64_t now = time_msec();
+    struct sw_flow *flow;
 
-    for (i = 0; i <= th->bucket_mask; i++) {
-        struct sw_flow **bucket = &th->buckets[i];
-        struct sw_flow *flow = *bucket;
-        if (flow && flow_timeout(flow)) {
-            list_push_back(deleted, &flow->node);
-            *bucket = NULL;
-            th->n_flows--;
-        }
+    while ((flow = flow_expiry_next(&th->expiry, now)) != NULL) {
+        *find_bucket(swt, &flow->key) = NULL;
+        list_push_back(deleted, &flow->node);
+        th->n_flows--;
     }
 }
 
@@ -295,6 +295,7 @@ struct sw_table *table_hash_create(unsigned int polynomial,
     }
     th->n_flows = 0;
     th->bucket_mask = n_buckets - 1;
+    flow_expiry_init(&th->expiry);
 
     swt = &th->swt;
     swt->lookup = table_hash_lookup;
@@ -49,6 +49,7 @@ struct sw_table_linear {
     struct list flows;
     struct list iter_flows;
     unsigned long int next_serial;
+    struct flow_expiry expiry;
 };
 
 static struct sw_flow *table_linear_lookup(struct sw_table *swt,
@@ -57,7 +58,7 @@ static struct sw_flow *table_linear_lookup(struct sw_table *swt,
     struct sw_table_linear *tl = (struct sw_table_linear *) swt;
     struct sw_flow *flow;
     LIST_FOR_EACH (flow, struct sw_flow, node, &tl->flows) {
-        if (flow_matches_1wild(key, &flow->key))
+        if (flow_match_packet(&flow->match, key))
             return flow;
     }
     return NULL;
@@ -68,6 +69,8 @@ static int table_linear_insert(struct sw_table *swt, struct sw_flow *flow)
     struct sw_table_linear *tl = (struct sw_table_linear *) swt;
     struct sw_flow *f;
 
+    flow_match_init(&flow->match, &flow->key);
+
     /* Loop through the existing list of entries.  New entries will
      * always be placed behind those with equal priority.  Just replace 
      * any flows that match exactly.
@@ -80,6 +83,7 @@ static int table_linear_insert(struct sw_table *swt, struct sw_flow *flow)
             list_replace(&flow->node, &f->node);
             list_replace(&flow->iter_node, &f->iter_node);
             flow_free(f);
+            flow_expiry_insert(&tl->expiry, flow);
             return 1;
         }
 
@@ -97,6 +101,7 @@ static int table_linear_insert(struct sw_table *swt, struct sw_flow *flow)
     flow->serial = tl->next_serial++;
     list_insert(&f->node, &flow->node);
     list_push_front(&tl->iter_flows, &flow->iter_node);
+    flow_expiry_insert(&tl->expiry, flow);
 
     return 1;
 }
@@ -168,15 +173,14 @@ static int table_linear_delete(struct datapath *dp, struct sw_table *swt,
 static void table_linear_timeout(struct sw_table *swt, struct list *deleted)
 {
     struct sw_table_linear *tl = (struct sw_table_linear *) swt;
-    struct sw_flow *flow, *n;
+    uint64_t now = time_msec();
+    struct sw_flow *flow;
 
-    LIST_FOR_EACH_SAFE (flow, n, struct sw_flow, node, &tl->flows) {
-        if (flow_timeout(flow)) {
-            list_remove(&flow->node);
-            list_remove(&flow->iter_node);
-            list_push_back(deleted, &flow->node);
-            tl->n_flows--;
-        }
+    while ((flow = flow_expiry_next(&tl->expiry, now)) != NULL) {
+        list_remove(&flow->node);
+        list_remove(&flow->iter_node);
+        list_push_back(deleted, &flow->node);
+        tl->n_flows--;
     }
 }
 
@@ -257,6 +261,7 @@ struct sw_table *table_linear_create(unsigned int max_flows)
     list_init(&tl->flows);
     list_init(&tl->iter_flows);
     tl->next_serial = 0;
+    flow_expiry_init(&tl->expiry);
 
     return swt;
 }
@@ -0,0 +1,545 @@
+/* Copyright (c) 2008 The Board of Trustees of The Leland Stanford
+ * Junior University
+ *
+ * We are making the OpenFlow specification and associated documentation
+ * (Software) available for public use and benefit with the expectation
+ * that others will use, modify and enhance the Software and contribute
+ * those enhancements back to the community. However, since we would
+ * like to make the Software available for broadest use, with as few
+ * restrictions as possible permission is hereby granted, free of
+ * charge, to any person obtaining a copy of this Software to deal in
+ * the Software under the copyrights without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT.  IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * The name and trademarks of copyright holder(s) may NOT be used in
+ * advertising or publicity pertaining to the Software or any
+ * derivatives without specific, written prior permission.
+ */
+
+/* Wildcard table based on tuple space search.
+ *
+ * Flows are grouped by the set of bits they match on (their "mask").  Each
+ * group is a subtable that hashes its flows on the masked flow key, so a
+ * lookup costs one hash probe per distinct mask instead of one comparison
+ * per flow.  Subtables are probed in order of the highest priority they
+ * contain and the search stops as soon as no remaining subtable can hold a
+ * flow of higher priority than the best match found so far.
+ *
+ * Which of several overlapping flows of equal priority matches a packet is
+ * left open by OpenFlow.  Here it is the one in the subtable probed first,
+ * while table-linear returns the one inserted first. */
+
+#include <config.h>
+#include "table.h"
+#include <stdlib.h>
+#include "flow.h"
+#include "hmap.h"
+#include "list.h"
+#include "openflow/openflow.h"
+#include "switch-flow.h"
+#include "datapath.h"
+
+/* All the flows that match on the same bits. */
+struct tss_subtable {
+    struct list list_node;      /* In sw_table_tss 'subtables'. */
+    struct hmap_node hmap_node; /* In sw_table_tss 'masks'. */
+    struct flow mask;           /* 1-bit in each significant bit. */
+    struct hmap flows;          /* Contains "struct tss_entry"s. */
+    uint16_t max_priority;      /* No flow in 'flows' has higher priority. */
+};
+
+/* A flow in a subtable, pointed to by the flow's 'private' member. */
+struct tss_entry {
+    struct hmap_node node;      /* In tss_subtable 'flows'. */
+    struct flow masked;         /* Flow key with subtable 'mask' applied. */
+    struct sw_flow *flow;
+    struct tss_subtable *subtable;
+};
+
+struct sw_table_tss {
+    struct sw_table swt;
+
+    unsigned int max_flows;
+    unsigned int n_flows;
+    struct list subtables;      /* In descending order of max_priority. */
+    struct hmap masks;          /* Subtables hashed on their mask. */
+    bool stale_priorities;      /* Some max_priority may be too high. */
+    struct list iter_flows;
+    unsigned long int next_serial;
+    struct flow_iter_hint iter_hint;
+    struct flow_expiry expiry;
+};
+
+#define FLOW_WORDS (sizeof(struct flow) / sizeof(uint32_t))
+
+static inline void
+flow_apply_mask(struct flow *dst, const struct flow *src,
+                const struct flow *mask)
+{
+    const uint32_t *s = (const uint32_t *) src;
+    const uint32_t *m = (const uint32_t *) mask;
+    uint32_t *d = (uint32_t *) dst;
+    int i;
+
+    for (i = 0; i < FLOW_WORDS; i++)
+        d[i] = s[i] & m[i];
+}
+
+static struct tss_subtable *
+find_subtable(const struct sw_table_tss *tt, const struct flow *mask)
+{
+    struct tss_subtable *st;
+
+    HMAP_FOR_EACH_WITH_HASH (st, struct tss_subtable, hmap_node,
+                             flow_hash(mask, 0), &tt->masks) {
+        if (flow_equal(&st->mask, mask))
+            return st;
+    }
+    return NULL;
+}
+
+/* Moves 'st' to its place in the subtable list according to max_priority.
+ * Subtables of equal max_priority keep the order of their creation. */
+static void
+sort_subtable(struct sw_table_tss *tt, struct tss_subtable *st)
+{
+    struct tss_subtable *pos;
+
+    list_remove(&st->list_node);
+    LIST_FOR_EACH (pos, struct tss_subtable, list_node, &tt->subtables) {
+        if (pos->max_priority < st->max_priority)
+            break;
+    }
+    list_insert(&pos->list_node, &st->list_node);
+}
+
+static struct tss_subtable *
+create_subtable(struct sw_table_tss *tt, const struct flow *mask)
+{
+    struct tss_subtable *st = xmalloc(sizeof *st);
+
+    st->mask = *mask;
+    hmap_init(&st->flows);
+    st->max_priority = 0;
+    hmap_insert(&tt->masks, &st->hmap_node, flow_hash(mask, 0));
+    list_push_back(&tt->subtables, &st->list_node);
+    sort_subtable(tt, st);
+    return st;
+}
+
+static void
+destroy_subtable(struct sw_table_tss *tt, struct tss_subtable *st)
+{
+    list_remove(&st->list_node);
+    hmap_remove(&tt->masks, &st->hmap_node);
+    hmap_destroy(&st->flows);
+    free(st);
+}
+
+/* Returns the flow in 'st' of highest priority that matches 'masked', a flow
+ * key with the subtable's mask already applied. */
+static struct sw_flow *
+subtable_lookup(const struct tss_subtable *st, const struct flow *masked)
+{
+    struct sw_flow *best = NULL;
+    struct tss_entry *e;
+
+    HMAP_FOR_EACH_WITH_HASH (e, struct tss_entry, node,
+                             flow_hash(masked, 0), &st->flows) {
+        if (flow_equal(&e->masked, masked)
+                && (!best || e->flow->priority > best->priority
+                    || (e->flow->priority == best->priority
+                        && e->flow->serial < best->serial)))
+            best = e->flow;
+    }
+    return best;
+}
+
+/* Removes 'flow' from 'tt' without freeing it. */
+static void
+tss_remove(struct sw_table_tss *tt, struct sw_flow *flow)
+{
+    struct tss_entry *e = flow->private;
+    struct tss_subtable *st = e->subtable;
+
+    hmap_remove(&st->flows, &e->node);
+    if (hmap_is_empty(&st->flows))
+        destroy_subtable(tt, st);
+    else if (flow->priority == st->max_priority)
+        tt->stale_priorities = true;
+
+    flow_iter_hint_remove(&tt->iter_hint, &tt->iter_flows, flow);
+    list_remove(&flow->iter_node);
+    flow->private = NULL;
+    free(e);
+    tt->n_flows--;
+}
+
+/* Recomputes the max_priority of every subtable and sorts them again. */
+static void
+update_priorities(struct sw_table_tss *tt)
+{
+    struct tss_subtable *st, *next;
+    struct list subtables;
+
+    list_init(&subtables);
+    LIST_FOR_EACH_SAFE (st, next, struct tss_subtable, list_node,
+                        &tt->subtables) {
+        struct tss_entry *e;
+
+        st->max_priority = 0;
+        HMAP_FOR_EACH (e, struct tss_entry, node, &st->flows) {
+            if (e->flow->priority > st->max_priority)
+                st->max_priority = e->flow->priority;
+        }
+        list_remove(&st->list_node);
+        list_push_back(&subtables, &st->list_node);
+    }
+
+    LIST_FOR_EACH_SAFE (st, next, struct tss_subtable, list_node,
+                        &subtables) {
+        list_push_back(&tt->subtables, &st->list_node);
+        sort_subtable(tt, st);
+    }
+    tt->stale_priorities = false;
+}
+
+static struct sw_flow *table_tss_lookup(struct sw_table *swt,
+                                        const struct sw_flow_key *key)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct tss_subtable *st;
+    struct sw_flow *best = NULL;
+
+    LIST_FOR_EACH (st, struct tss_subtable, list_node, &tt->subtables) {
+        struct sw_flow *flow;
+        struct flow masked;
+
+        /* No flow left that could beat 'best'. */
+        if (best && best->priority >= st->max_priority)
+            break;
+
+        flow_apply_mask(&masked, &key->flow, &st->mask);
+        flow = subtable_lookup(st, &masked);
+        if (flow && (!best || flow->priority > best->priority))
+            best = flow;
+    }
+    return best;
+}
+
+static int table_tss_insert(struct sw_table *swt, struct sw_flow *flow)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct tss_subtable *st;
+    struct tss_entry *e;
+    struct flow mask;
+    size_t hash;
+
+    flow_key_mask(&mask, &flow->key);
+    st = find_subtable(tt, &mask);
+    if (st == NULL) {
+        if (tt->n_flows >= tt->max_flows)
+            return 0;
+        st = create_subtable(tt, &mask);
+    }
+
+    e = xmalloc(sizeof *e);
+    flow_apply_mask(&e->masked, &flow->key.flow, &mask);
+    hash = flow_hash(&e->masked, 0);
+
+    /* Just replace any flow that matches exactly. */
+    {
+        struct tss_entry *old;
+
+        HMAP_FOR_EACH_WITH_HASH (old, struct tss_entry, node, hash,
+                                 &st->flows) {
+            struct sw_flow *f = old->flow;
+            if (f->priority == flow->priority
+                    && f->key.wildcards == flow->key.wildcards
+                    && flow_matches_2wild(&f->key, &flow->key)) {
+                flow->serial = f->serial;
+                flow->private = old;
+                list_replace(&flow->iter_node, &f->iter_node);
+                flow_iter_hint_replace(&tt->iter_hint, f, flow);
+                old->flow = flow;
+                flow_free(f);
+                free(e);
+                flow_expiry_insert(&tt->expiry, flow);
+                return 1;
+            }
+        }
+    }
+
+    /* Make sure there's room in the table. */
+    if (tt->n_flows >= tt->max_flows) {
+        free(e);
+        if (hmap_is_empty(&st->flows))
+            destroy_subtable(tt, st);
+        return 0;
+    }
+    tt->n_flows++;
+
+    e->flow = flow;
+    e->subtable = st;
+    hmap_insert(&st->flows, &e->node, hash);
+    flow->private = e;
+    flow->serial = tt->next_serial++;
+    list_push_front(&tt->iter_flows, &flow->iter_node);
+    flow_expiry_insert(&tt->expiry, flow);
+
+    if (flow->priority > st->max_priority || hmap_count(&st->flows) == 1) {
+        st->max_priority = flow->priority;
+        sort_subtable(tt, st);
+    }
+
+    return 1;
+}
+
+/* Returns the subtable that holds the flows with the wildcards of 'key', if
+ * a strict operation on 'key' only needs to look at the flows whose masked
+ * key equals that of 'key'. */
+static struct tss_subtable *
+strict_subtable(struct sw_table_tss *tt, const struct sw_flow_key *key,
+                struct flow *masked)
+{
+    struct tss_subtable *st;
+    struct flow mask;
+
+    flow_key_mask(&mask, key);
+    st = find_subtable(tt, &mask);
+    if (st)
+        flow_apply_mask(masked, &key->flow, &mask);
+    return st;
+}
+
+static int table_tss_modify(struct sw_table *swt,
+                const struct sw_flow_key *key, uint16_t priority, int strict,
+                const struct ofp_action_header *actions, size_t actions_len)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct sw_flow *flow;
+    unsigned int count = 0;
+
+    if (strict) {
+        struct tss_subtable *st;
+        struct tss_entry *e;
+        struct flow masked;
+
+        st = strict_subtable(tt, key, &masked);
+        if (st == NULL)
+            return 0;
+        HMAP_FOR_EACH_WITH_HASH (e, struct tss_entry, node,
+                                 flow_hash(&masked, 0), &st->flows) {
+            if (flow_matches_desc(&e->flow->key, key, strict)
+                    && e->flow->priority == priority) {
+                flow_replace_acts(e->flow, actions, actions_len);
+                count++;
+            }
+        }
+        return count;
+    }
+
+    LIST_FOR_EACH (flow, struct sw_flow, iter_node, &tt->iter_flows) {
+        if (flow_matches_desc(&flow->key, key, strict)) {
+            flow_replace_acts(flow, actions, actions_len);
+            count++;
+        }
+    }
+    return count;
+}
+
+static int table_tss_has_conflict(struct sw_table *swt,
+                                  const struct sw_flow_key *key,
+                                  uint16_t priority, int strict)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct tss_subtable *st;
+
+    /* Flows of lower priority than 'priority' cannot conflict. */
+    LIST_FOR_EACH (st, struct tss_subtable, list_node, &tt->subtables) {
+        struct tss_entry *e;
+
+        if (st->max_priority < priority)
+            break;
+        HMAP_FOR_EACH (e, struct tss_entry, node, &st->flows) {
+            if (flow_matches_2desc(&e->flow->key, key, strict)
+                    && e->flow->priority == priority)
+                return true;
+        }
+    }
+    return false;
+}
+
+static int table_tss_delete(struct datapath *dp, struct sw_table *swt,
+                            const struct sw_flow_key *key,
+                            uint16_t out_port,
+                            uint16_t priority, int strict)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct sw_flow *flow, *n;
+    unsigned int count = 0;
+
+    if (strict) {
+        struct list victims = LIST_INITIALIZER(&victims);
+        struct tss_subtable *st;
+        struct tss_entry *e;
+        struct flow masked;
+
+        st = strict_subtable(tt, key, &masked);
+        if (st == NULL)
+            return 0;
+
+        /* Collect the victims first, removing them would break the hash
+         * iteration and the last one also destroys the subtable. */
+        HMAP_FOR_EACH_WITH_HASH (e, struct tss_entry, node,
+                                 flow_hash(&masked, 0), &st->flows) {
+            flow = e->flow;
+            if (flow_matches_desc(&flow->key, key, strict)
+                    && flow_has_out_port(flow, out_port)
+                    && flow->priority == priority)
+                list_push_back(&victims, &flow->node);
+        }
+        LIST_FOR_EACH_SAFE (flow, n, struct sw_flow, node, &victims) {
+            list_remove(&flow->node);
+            dp_send_flow_end(dp, flow, OFPRR_DELETE);
+            tss_remove(tt, flow);
+            flow_free(flow);
+            count++;
+        }
+        return count;
+    }
+
+    LIST_FOR_EACH_SAFE (flow, n, struct sw_flow, iter_node, &tt->iter_flows) {
+        if (flow_matches_desc(&flow->key, key, strict)
+                && flow_has_out_port(flow, out_port)) {
+            dp_send_flow_end(dp, flow, OFPRR_DELETE);
+            tss_remove(tt, flow);
+            flow_free(flow);
+            count++;
+        }
+    }
+    return count;
+}
+
+static void table_tss_timeout(struct sw_table *swt, struct list *deleted)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    uint64_t now = time_msec();
+    struct sw_flow *flow;
+
+    while ((flow = flow_expiry_next(&tt->expiry, now)) != NULL) {
+        tss_remove(tt, flow);
+        list_push_back(deleted, &flow->node);
+    }
+
+    /* Deleting flows only ever lowers the priorities, so it is enough to
+     * restore the search order here once a second. */
+    if (tt->stale_priorities)
+        update_priorities(tt);
+}
+
+static void table_tss_destroy(struct sw_table *swt)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+
+    while (!list_is_empty(&tt->iter_flows)) {
+        struct sw_flow *flow = CONTAINER_OF(list_front(&tt->iter_flows),
+                                            struct sw_flow, iter_node);
+        tss_remove(tt, flow);
+        flow_free(flow);
+    }
+    hmap_destroy(&tt->masks);
+    free(tt);
+}
+
+static int table_tss_iterate(struct sw_table *swt,
+                             const struct sw_flow_key *key,
+                             uint16_t out_port,
+                             struct sw_table_position *position,
+                             int (*callback)(struct sw_flow *, void *),
+                             void *private)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    struct list *node;
+    unsigned long start;
+
+    start = ~position->private[0];
+    for (node = flow_iter_hint_resume(&tt->iter_hint, &tt->iter_flows, start);
+         node != &tt->iter_flows; node = node->next) {
+        struct sw_flow *flow = CONTAINER_OF(node, struct sw_flow, iter_node);
+        if (flow->serial <= start
+                && flow_matches_2wild(key, &flow->key)
+                && flow_has_out_port(flow, out_port)) {
+            int error = callback(flow, private);
+            if (error) {
+                position->private[0] = ~(flow->serial - 1);
+                flow_iter_hint_stop(&tt->iter_hint, &tt->iter_flows, flow);
+                return error;
+            }
+        }
+    }
+    return 0;
+}
+
+static void table_tss_stats(struct sw_table *swt,
+                            struct sw_table_stats *stats)
+{
+    struct sw_table_tss *tt = (struct sw_table_tss *) swt;
+    stats->name = "tss";
+    stats->wildcards = OFPFW_ALL;
+    stats->n_flows   = tt->n_flows;
+    stats->max_flows = tt->max_flows;
+    stats->n_lookup  = swt->n_lookup;
+    stats->n_matched = swt->n_matched;
+}
+
+
+struct sw_table *table_tss_create(unsigned int max_flows)
+{
+    struct sw_table_tss *tt;
+    struct sw_table *swt;
+
+    tt = calloc(1, sizeof *tt);
+    if (tt == NULL)
+        return NULL;
+
+    swt = &tt->swt;
+    swt->lookup = table_tss_lookup;
+    swt->insert = table_tss_insert;
+    swt->modify = table_tss_modify;
+    swt->has_conflict = table_tss_has_conflict;
+    swt->delete = table_tss_delete;
+    swt->timeout = table_tss_timeout;
+    swt->destroy = table_tss_destroy;
+    swt->iterate = table_tss_iterate;
+    swt->stats = table_tss_stats;
+
+    tt->max_flows = max_flows;
+    tt->n_flows = 0;
+    list_init(&tt->subtables);
+    hmap_init(&tt->masks);
+    tt->stale_priorities = false;
+    list_init(&tt->iter_flows);
+    flow_iter_hint_init(&tt->iter_hint);
+    /* Serial 0 would make the resume position of table_tss_iterate() wrap
+     * around if iteration stopped at the oldest flow. */
+    tt->next_serial = 1;
+    flow_expiry_init(&tt->expiry);
+
+    return swt;
+}
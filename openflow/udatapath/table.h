@@ -37,8 +37,10 @@
 #ifndef TABLE_H
 #define TABLE_H 1
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include "switch-flow.h"
 
 struct datapath; /* Forward declaration for delete operation */
 struct sw_flow;
@@ -73,6 +75,10 @@ struct sw_table {
     unsigned long long n_lookup;
     unsigned long long n_matched;
 
+    /* Packet and byte counts of the flows in the table, which the chain
+     * points the flows to when it inserts them. */
+    struct sw_flow_totals totals;
+
     /* Searches 'table' for a flow matching 'key', which must not have any
      * wildcard fields.  Returns the flow if successful, a null pointer
      * otherwise. */
@@ -146,5 +152,24 @@ struct sw_table *table_hash_create(unsigned int polynomial,
 struct sw_table *table_hash2_create(unsigned int poly0, unsigned int buckets0,
                                     unsigned int poly1, unsigned int buckets1);
 struct sw_table *table_linear_create(unsigned int max_flows);
+struct sw_table *table_tss_create(unsigned int max_flows);
+
+/* Statistics specific to the cuckoo hash table.  The load factor is
+ * 'n_flows' / ('n_buckets' * 'n_entries'). */
+struct sw_table_cuckoo_stats {
+    unsigned int n_buckets;      /* Size of the bucket array. */
+    unsigned int n_entries;      /* Flows per bucket. */
+    unsigned int n_flows;        /* Number of flows, including stashed. */
+    unsigned int n_stashed;      /* Flows that are in no bucket. */
+    bool resizing;               /* Flows are being moved to a new array. */
+    unsigned int n_resizes;      /* Number of times the table has grown. */
+    unsigned long long n_displaced; /* Flows moved to make room. */
+    unsigned int max_displaced;  /* Most flows moved for one insertion. */
+};
+
+struct sw_table *table_cuckoo_create(unsigned int n_buckets,
+                                     unsigned int max_flows);
+void table_cuckoo_get_stats(const struct sw_table *,
+                            struct sw_table_cuckoo_stats *);
 
 #endif /* table.h */
@@ -43,6 +43,8 @@
 #include "command-line.h"
 #include "daemon.h"
 #include "datapath.h"
+#include "dp_buffer.h"
+#include "dp_worker.h"
 #include "fault.h"
 #include "openflow/openflow.h"
 #include "poll-loop.h"
@@ -78,6 +80,10 @@ static uint64_t dpid = UINT64_MAX;
 static char *port_list;
 static char *local_port = "tap:";
 static uint16_t num_queues = NETDEV_MAX_QUEUES;
+static int n_threads;
+static unsigned int n_buffers = DP_DEFAULT_BUFFERS;
+static unsigned int dump_flows = DP_DUMP_FLOWS;
+static unsigned int dump_usecs;
 
 static void add_ports(struct datapath *dp, char *port_list);
 
@@ -119,6 +125,11 @@ udatapath_cmd(int argc, char *argv[])
     }
 
     error = dp_new(&dp, dpid);
+    if (error) {
+        OFP_FATAL(error, "could not create datapath");
+    }
+    dp_set_n_buffers(dp, n_buffers);
+    dp_set_dump_budget(dp, dump_flows, dump_usecs);
 
     n_listeners = 0;
     for (i = optind; i < argc; i++) {
@@ -156,6 +167,14 @@ udatapath_cmd(int argc, char *argv[])
     die_if_already_running();
     daemonize();
 
+    /* Threads do not survive daemonize(), so start them afterward. */
+    if (n_threads) {
+        error = dp_workers_start(dp, n_threads);
+        if (error) {
+            OFP_FATAL(error, "failed to start forwarding threads");
+        }
+    }
+
     for (;;) {
         dp_run(dp);
         dp_wait(dp);
@@ -194,7 +213,11 @@ parse_options(int argc, char *argv[])
         OPT_SERIAL_NUM,
         OPT_BOOTSTRAP_CA_CERT,
         OPT_NO_LOCAL_PORT,
-        OPT_NO_SLICING
+        OPT_NO_SLICING,
+        OPT_THREADS,
+        OPT_BUFFERS,
+        OPT_DUMP_FLOWS,
+        OPT_DUMP_USECS
     };
 
     static struct option long_options[] = {
@@ -206,6 +229,10 @@ parse_options(int argc, char *argv[])
         {"help",        no_argument, 0, 'h'},
         {"version",     no_argument, 0, 'V'},
         {"no-slicing",  no_argument, 0, OPT_NO_SLICING},
+        {"threads",     required_argument, 0, OPT_THREADS},
+        {"buffers",     required_argument, 0, OPT_BUFFERS},
+        {"dump-flows",  required_argument, 0, OPT_DUMP_FLOWS},
+        {"dump-usecs",  required_argument, 0, OPT_DUMP_USECS},
         {"mfr-desc",    required_argument, 0, OPT_MFR_DESC},
         {"hw-desc",     required_argument, 0, OPT_HW_DESC},
         {"sw-desc",     required_argument, 0, OPT_SW_DESC},
@@ -295,6 +322,29 @@ parse_options(int argc, char *argv[])
             num_queues = 0;
             break;
 
+        case OPT_THREADS:
+            n_threads = atoi(optarg);
+            if (n_threads < 0) {
+                ofp_fatal(0, "argument to --threads must not be negative");
+            }
+            break;
+
+        case OPT_BUFFERS:
+            n_buffers = atoi(optarg);
+            if (!n_buffers || n_buffers > DP_MAX_BUFFERS) {
+                ofp_fatal(0, "argument to --buffers must be between 1 and %d",
+                          DP_MAX_BUFFERS);
+            }
+            break;
+
+        case OPT_DUMP_FLOWS:
+            dump_flows = atoi(optarg);
+            break;
+
+        case OPT_DUMP_USECS:
+            dump_usecs = atoi(optarg);
+            break;
+
         DAEMON_OPTION_HANDLERS
 
 #ifdef HAVE_OPENSSL
@@ -332,6 +382,10 @@ usage(void)
            "  -d, --datapath-id=ID    Use ID as the OpenFlow switch ID\n"
            "                          (ID must consist of 12 hex digits)\n"
            "  --no-slicing            disable slicing\n"
+           "  --threads=N             forward packets in N threads\n"
+           "  --buffers=N             buffer N packets for the controller\n"
+           "  --dump-flows=N          look at N flows per turn in stats dumps\n"
+           "  --dump-usecs=N          spend N us per turn in stats dumps\n"
            "\nOther options:\n"
            "  -D, --detach            run in background as daemon\n"
            "  -P, --pidfile[=FILE]    create pidfile (default: %s/ofdatapath.pid)\n"